@@ -20,3 +20,52 @@ target_link_libraries(benchmark_unified PRIVATE
     ${CMAKE_DL_LIBS}
 )
 add_dependencies(benchmark_unified libuv xxhash llhttp)
+
+# WebSocket payload codec microbenchmark (unmasking + UTF-8 validation)
+if(BUILD_WITH_WEBSOCKET)
+    add_executable(benchmark_ws_codec
+        benchmark/benchmark_ws_codec.c
+    )
+
+    target_link_libraries(benchmark_ws_codec PRIVATE
+        uvhttp
+        libuv
+        xxhash
+        llhttp
+        ${MBEDTLS_LIBS}
+        ${CMAKE_DL_LIBS}
+    )
+    add_dependencies(benchmark_ws_codec libuv xxhash llhttp)
+endif()
+
+# Router lookup microbenchmark (2,000 static / parameter / catch-all routes)
+add_executable(benchmark_router
+    benchmark/benchmark_router.c
+)
+
+target_link_libraries(benchmark_router PRIVATE
+    uvhttp
+    libuv
+    xxhash
+    llhttp
+    ${CMAKE_DL_LIBS}
+)
+add_dependencies(benchmark_router libuv xxhash llhttp)
+
+# Static file cache policy benchmark (LRU vs W-TinyLFU hit rates on Zipf and
+# scan traces)
+if(BUILD_WITH_STATIC_FILES)
+    add_executable(benchmark_cache_policy
+        benchmark/benchmark_cache_policy.c
+    )
+
+    target_link_libraries(benchmark_cache_policy PRIVATE
+        uvhttp
+        libuv
+        xxhash
+        llhttp
+        m
+        ${CMAKE_DL_LIBS}
+    )
+    add_dependencies(benchmark_cache_policy libuv xxhash llhttp)
+endif()
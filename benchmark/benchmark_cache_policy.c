@@ -0,0 +1,169 @@
+/**
+ * @file benchmark_cache_policy.c
+ * @brief Static file cache policy benchmark (LRU vs W-TinyLFU)
+ *
+ * Replays request traces against an LRU cache manager the way the static
+ * file service drives it (a lookup, and a put on a miss) and reports the
+ * hit rate and ns/request of each policy at several cache sizes:
+ *
+ *   zipf       requests for a fixed set of files, Zipf-distributed
+ *   zipf+scan  the same, interrupted by sequential scans of files that are
+ *              requested once (a crawler, a backup, a directory listing)
+ *
+ * Usage:
+ *   ./benchmark_cache_policy [files] [requests] [zipf_exponent]
+ */
+
+#include <uvhttp_lru_cache.h>
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_FILES 10000
+#define DEFAULT_REQUESTS 1000000
+#define DEFAULT_EXPONENT 0.9
+#define SCAN_EVERY 100000 /* requests between scans */
+#define SCAN_LENGTH 20000 /* one-off files per scan */
+#define CONTENT_SIZE 64
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint64_t rng_state = 0x2545F4914F6CDD1DULL;
+
+static double next_uniform(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (double)(rng_state >> 11) / (double)(1ULL << 53);
+}
+
+/* Zipf-distributed file indexes: cdf[i] is P(index <= i) */
+static int next_zipf(const double* cdf, int files) {
+    double u = next_uniform();
+    int low = 0, high = files - 1;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (cdf[mid] < u) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/* file indexes to request; scanned files are numbered from files on */
+static int* make_trace(int files, int requests, double exponent, int scans) {
+    double* cdf = malloc(sizeof(double) * (size_t)files);
+    int* trace = malloc(sizeof(int) * (size_t)requests);
+    if (!cdf || !trace) {
+        free(cdf);
+        free(trace);
+        return NULL;
+    }
+    double sum = 0;
+    for (int i = 0; i < files; i++) {
+        sum += 1.0 / pow(i + 1, exponent);
+        cdf[i] = sum;
+    }
+    for (int i = 0; i < files; i++) {
+        cdf[i] /= sum;
+    }
+
+    int scanned = files;
+    for (int i = 0; i < requests;) {
+        if (scans && i > 0 && i % SCAN_EVERY == 0) {
+            for (int n = 0; n < SCAN_LENGTH && i < requests; n++) {
+                trace[i++] = scanned++;
+            }
+            if (i >= requests) {
+                break;
+            }
+        }
+        trace[i++] = next_zipf(cdf, files);
+    }
+    free(cdf);
+    return trace;
+}
+
+/* replay trace against a cache of capacity files: hit rate, ns/request */
+static int replay(const int* trace, int requests, int capacity,
+                  uvhttp_cache_policy_t policy, double* hit_rate,
+                  double* ns) {
+    cache_manager_t* cache = NULL;
+    if (uvhttp_lru_cache_create((size_t)1 << 30, capacity, 0, &cache) !=
+            UVHTTP_OK ||
+        uvhttp_lru_cache_set_policy(cache, policy) != UVHTTP_OK) {
+        uvhttp_lru_cache_free(cache);
+        return -1;
+    }
+
+    char content[CONTENT_SIZE];
+    memset(content, 'x', sizeof(content));
+    char path[64];
+    double start = now_sec();
+    for (int i = 0; i < requests; i++) {
+        snprintf(path, sizeof(path), "/static/file%d.html", trace[i]);
+        if (!uvhttp_lru_cache_find(cache, path)) {
+            uvhttp_lru_cache_put(cache, path, content, sizeof(content),
+                                 "text/html", 0, NULL);
+        }
+    }
+    *ns = (now_sec() - start) * 1e9 / requests;
+    *hit_rate = uvhttp_lru_cache_get_hit_rate(cache);
+    uvhttp_lru_cache_free(cache);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int files = argc > 1 ? atoi(argv[1]) : DEFAULT_FILES;
+    int requests = argc > 2 ? atoi(argv[2]) : DEFAULT_REQUESTS;
+    double exponent = argc > 3 ? atof(argv[3]) : DEFAULT_EXPONENT;
+    if (files <= 0 || requests <= 0 || exponent <= 0) {
+        fprintf(stderr, "usage: %s [files] [requests] [zipf_exponent]\n",
+                argv[0]);
+        return 1;
+    }
+
+    printf("uvhttp cache policy benchmark: %d files, %d requests, zipf %.2f\n",
+           files, requests, exponent);
+    const char* names[] = {"zipf", "zipf+scan"};
+    const int percents[] = {1, 5, 10};
+    for (int scans = 0; scans < 2; scans++) {
+        int* trace = make_trace(files, requests, exponent, scans);
+        if (!trace) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        printf("  %s:\n", names[scans]);
+        for (size_t p = 0; p < sizeof(percents) / sizeof(percents[0]); p++) {
+            int capacity = files * percents[p] / 100;
+            if (capacity < 1) {
+                capacity = 1;
+            }
+            double lru_rate, lru_ns, tinylfu_rate, tinylfu_ns;
+            if (replay(trace, requests, capacity, UVHTTP_CACHE_POLICY_LRU,
+                       &lru_rate, &lru_ns) != 0 ||
+                replay(trace, requests, capacity, UVHTTP_CACHE_POLICY_TINYLFU,
+                       &tinylfu_rate, &tinylfu_ns) != 0) {
+                fprintf(stderr, "cache creation failed\n");
+                free(trace);
+                return 1;
+            }
+            printf("    %6d entries: LRU %5.1f%% (%6.1f ns)  W-TinyLFU "
+                   "%5.1f%% (%6.1f ns)\n",
+                   capacity, lru_rate * 100, lru_ns, tinylfu_rate * 100,
+                   tinylfu_ns);
+        }
+        free(trace);
+    }
+    return 0;
+}
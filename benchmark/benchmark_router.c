@@ -0,0 +1,190 @@
+/**
+ * @file benchmark_router.c
+ * @brief Router lookup microbenchmark
+ *
+ * Registers 2,000 routes in a REST-like shape (static paths, ":name"
+ * parameters and "*rest" catch-alls sharing long prefixes) and reports
+ * ns/lookup for uvhttp_router_find_handler and uvhttp_router_match on hits
+ * and misses, then again after uvhttp_router_freeze() moves the static
+ * routes into a perfect hash. Builds with UVHTTP_FEATURE_ROUTER_MATCH_CACHE
+ * also report the match cache hit rate.
+ *
+ * Usage:
+ *   ./benchmark_router [routes] [iterations]
+ */
+
+#include <uvhttp.h>
+#include <uvhttp_router.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_ROUTES 2000
+#define DEFAULT_ITERATIONS 2000000
+#define PATH_COUNT 64
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int bench_handler(uvhttp_request_t* request,
+                         uvhttp_response_t* response) {
+    (void)request;
+    (void)response;
+    return 0;
+}
+
+/* route i and a request path that should hit it */
+static void make_route(int i, char* route, char* path, size_t size) {
+    int service = i / 40;
+    int resource = i % 40;
+    switch (i % 4) {
+    case 0:
+        snprintf(route, size, "/api/v1/service%d/resource%d", service,
+                 resource);
+        snprintf(path, size, "/api/v1/service%d/resource%d", service,
+                 resource);
+        break;
+    case 1:
+        snprintf(route, size, "/api/v1/service%d/resource%d/:id", service,
+                 resource);
+        snprintf(path, size, "/api/v1/service%d/resource%d/%d", service,
+                 resource, i * 7);
+        break;
+    case 2:
+        snprintf(route, size,
+                 "/api/v1/service%d/resource%d/:id/items/:item_id", service,
+                 resource);
+        snprintf(path, size, "/api/v1/service%d/resource%d/%d/items/%d",
+                 service, resource, i, i + 1);
+        break;
+    default:
+        snprintf(route, size, "/files/service%d/resource%d/*rest", service,
+                 resource);
+        snprintf(path, size, "/files/service%d/resource%d/a/b/c.txt",
+                 service, resource);
+        break;
+    }
+}
+
+static double bench_find(uvhttp_router_t* router, char paths[][256],
+                         int iterations, int* hits) {
+    int found = 0;
+    double start = now_sec();
+    for (int i = 0; i < iterations; i++) {
+        if (uvhttp_router_find_handler(router, paths[i % PATH_COUNT], "GET")) {
+            found++;
+        }
+    }
+    double elapsed = now_sec() - start;
+    *hits = found;
+    return elapsed * 1e9 / iterations;
+}
+
+static double bench_match(uvhttp_router_t* router, char paths[][256],
+                          int iterations, int* hits) {
+    int found = 0;
+    uvhttp_route_match_t match;
+    double start = now_sec();
+    for (int i = 0; i < iterations; i++) {
+        if (uvhttp_router_match(router, paths[i % PATH_COUNT], "GET",
+                                &match) == UVHTTP_OK) {
+            found++;
+        }
+    }
+    double elapsed = now_sec() - start;
+    *hits = found;
+    return elapsed * 1e9 / iterations;
+}
+
+static void run_lookups(uvhttp_router_t* router, char hit_paths[][256],
+                        char static_paths[][256], char miss_paths[][256],
+                        int iterations) {
+    int hits = 0;
+    double ns = bench_find(router, hit_paths, iterations, &hits);
+    printf("  find_handler hit:    %8.1f ns/lookup (%d/%d found)\n", ns, hits,
+           iterations);
+    ns = bench_find(router, static_paths, iterations, &hits);
+    printf("  find_handler static: %8.1f ns/lookup (%d/%d found)\n", ns, hits,
+           iterations);
+    ns = bench_match(router, hit_paths, iterations, &hits);
+    printf("  match hit:           %8.1f ns/lookup (%d/%d found)\n", ns, hits,
+           iterations);
+    ns = bench_find(router, miss_paths, iterations, &hits);
+    printf("  find_handler miss:   %8.1f ns/lookup (%d/%d found)\n", ns, hits,
+           iterations);
+}
+
+int main(int argc, char** argv) {
+    int routes = argc > 1 ? atoi(argv[1]) : DEFAULT_ROUTES;
+    int iterations = argc > 2 ? atoi(argv[2]) : DEFAULT_ITERATIONS;
+    if (routes <= 0 || iterations <= 0) {
+        fprintf(stderr, "usage: %s [routes] [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    uvhttp_router_t* router = NULL;
+    if (uvhttp_router_new(&router) != UVHTTP_OK) {
+        fprintf(stderr, "router creation failed\n");
+        return 1;
+    }
+
+    char route[256];
+    char path[256];
+    static char hit_paths[PATH_COUNT][256];
+    static char static_paths[PATH_COUNT][256];
+    static char miss_paths[PATH_COUNT][256];
+
+    double start = now_sec();
+    for (int i = 0; i < routes; i++) {
+        make_route(i, route, path, sizeof(route));
+        if (uvhttp_router_add_route(router, route, bench_handler) !=
+            UVHTTP_OK) {
+            fprintf(stderr, "failed to add route %s\n", route);
+            uvhttp_router_free(router);
+            return 1;
+        }
+    }
+    double build_ms = (now_sec() - start) * 1e3;
+
+    /* spread lookups over the whole table */
+    for (int i = 0; i < PATH_COUNT; i++) {
+        int r = (int)((long)i * routes / PATH_COUNT);
+        make_route(r, route, hit_paths[i], sizeof(hit_paths[i]));
+        make_route(r - r % 4, route, static_paths[i], sizeof(static_paths[i]));
+        snprintf(miss_paths[i], sizeof(miss_paths[i]),
+                 "/api/v1/service%d/unknown%d", r / 40, i);
+    }
+
+    printf("uvhttp router benchmark: %d routes, %d lookups\n", routes,
+           iterations);
+    printf("  build: %.2f ms\n", build_ms);
+
+    run_lookups(router, hit_paths, static_paths, miss_paths, iterations);
+
+    start = now_sec();
+    if (uvhttp_router_freeze(router) != UVHTTP_OK) {
+        fprintf(stderr, "router freeze failed\n");
+        uvhttp_router_free(router);
+        return 1;
+    }
+    printf("  frozen (%.2f ms):\n", (now_sec() - start) * 1e3);
+    run_lookups(router, hit_paths, static_paths, miss_paths, iterations);
+
+    uvhttp_router_match_cache_stats_t stats;
+    if (uvhttp_router_get_match_cache_stats(router, &stats) == UVHTTP_OK &&
+        stats.capacity > 0) {
+        uint64_t lookups = stats.hits + stats.misses;
+        printf("  match cache: %zu slots, %.1f%% hit rate, %llu evictions\n",
+               stats.capacity,
+               lookups ? 100.0 * (double)stats.hits / (double)lookups : 0.0,
+               (unsigned long long)stats.evictions);
+    }
+
+    uvhttp_router_free(router);
+    return 0;
+}
@@ -2,9 +2,10 @@
  * @file sse_server.c
  * @brief Server-Sent Events (SSE) example
  *
- * Demonstrates real-time event streaming using standard HTTP/1.1.
- * Uses uv_timer to send events asynchronously without blocking the
- * event loop.
+ * Every client subscribes to the "ticks" channel; one uv_timer publishes an
+ * event there each second. The event is encoded once and shared by all
+ * streams, and the server keeps idle streams alive with heartbeats.
+ * Reconnecting browsers send Last-Event-ID and get the ticks they missed.
  *
  * Test:
  *   curl -N http://127.0.0.1:8080/events
@@ -13,97 +14,46 @@
 
 #include "uvhttp.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
-/* ========== SSE context (per-connection state) ========== */
-
-typedef struct {
-    uvhttp_response_t* resp;   /* SSE response handle */
-    uv_timer_t timer;          /* periodic event timer */
-    int count;                 /* event counter */
-    int max_events;            /* stop after this many */
-} sse_ctx_t;
-
-/* ========== SSE event sender ========== */
-
-static int sse_send_event(const char* event, const char* data,
-                           uvhttp_response_t* resp) {
-    char buf[4096];
-    int n = 0;
-
-    if (event) {
-        n += snprintf(buf + n, sizeof(buf) - n, "event: %s\n", event);
-    }
-    n += snprintf(buf + n, sizeof(buf) - n, "data: %s\n\n", data);
-
-    return uvhttp_response_send_raw(buf, n, resp->client, resp);
-}
+static uvhttp_server_t* g_server = NULL;
+static uv_timer_t g_tick_timer;
+static int g_count = 0;
 
 /* ========== Timer callback (fires every 1s) ========== */
 
-static void sse_timer_cb(uv_timer_t* timer) {
-    sse_ctx_t* ctx = (sse_ctx_t*)timer->data;
-    if (!ctx || !ctx->resp) return;
-
-    if (ctx->count >= ctx->max_events) {
-        /* Send done event and stop */
-        sse_send_event("done", "{\"reason\": \"max_events\"}", ctx->resp);
-        uv_timer_stop(timer);
-        uvhttp_free(ctx);
-        return;
-    }
-
+static void tick_cb(uv_timer_t* timer) {
+    (void)timer;
     char data[128];
-    time_t now = time(NULL);
-    snprintf(data, sizeof(data),
-             "{\"count\": %d, \"timestamp\": %ld}", ctx->count, (long)now);
-
-    if (sse_send_event("tick", data, ctx->resp) != 0) {
-        /* Client disconnected — stop timer and free context */
-        uv_timer_stop(timer);
-        uvhttp_free(ctx);
-        return;
-    }
-    ctx->count++;
+    int n = snprintf(data, sizeof(data), "{\"count\": %d, \"timestamp\": %ld}",
+                     g_count++, (long)time(NULL));
+
+    /* one encode, queued by reference on every subscriber */
+    uvhttp_sse_publish(g_server, "ticks", "tick", data, (size_t)n, NULL);
 }
 
 /* ========== SSE event handler ========== */
 
-static int events_handler(uvhttp_request_t* req, uvhttp_response_t* resp) {
-    (void)req;
-
-    /* Set SSE headers and send HTTP response head directly.
-     * We cannot use uvhttp_response_send because it sets Content-Length.
-     * SSE needs an unbounded response stream. */
-    const char* head =
-        "HTTP/1.1 200 OK\r\n"
-        "Content-Type: text/event-stream\r\n"
-        "Cache-Control: no-cache\r\n"
-        "Connection: keep-alive\r\n"
-        "\r\n";
-    uvhttp_response_send_raw(head, strlen(head), resp->client, resp);
-
-    /* Send initial comment (some proxies drop the first message) */
-    uvhttp_response_send_raw(": SSE connection established\n\n", 30, resp->client, resp);
-
-    /* Allocate per-connection context */
-    sse_ctx_t* ctx = uvhttp_alloc(sizeof(sse_ctx_t));
-    if (!ctx) return UVHTTP_ERROR_OUT_OF_MEMORY;
-
-    ctx->resp = resp;
-    ctx->count = 0;
-    ctx->max_events = 10;
+static void on_stream_close(uvhttp_sse_stream_t* stream) {
+    printf("stream closed after %llu events (%d open)\n",
+           (unsigned long long)stream->events_sent,
+           uvhttp_sse_get_stream_count(g_server));
+}
 
-    /* Start a 1-second periodic timer on the default loop */
-    uv_timer_init(uv_default_loop(), &ctx->timer);
-    ctx->timer.data = ctx;
-    uv_timer_start(&ctx->timer, sse_timer_cb, 1000, 1000);
+static int events_handler(uvhttp_request_t* req, uvhttp_response_t* resp) {
+    uvhttp_sse_stream_t* stream = NULL;
 
-    /* Send initial comment (some proxies drop the first message) */
-    uvhttp_response_send_raw(": SSE connection established\n\n", 30, resp->client, resp);
+    /* writes the text/event-stream head; the response is not sent again */
+    uvhttp_error_t err = uvhttp_sse_open(req, resp, &stream);
+    if (err != UVHTTP_OK) {
+        return err;
+    }
+    uvhttp_sse_set_close_callback(stream, on_stream_close);
 
-    return 0;
+    uvhttp_sse_send(stream, "welcome", "connected", 9);
+    return uvhttp_sse_subscribe(stream, "ticks");
 }
 
 /* ========== Index page ========== */
@@ -122,10 +72,6 @@ static int index_handler(uvhttp_request_t* req, uvhttp_response_t* resp) {
         "  var div = document.getElementById('events');"
         "  div.innerHTML += '<p>' + e.data + '</p>';"
         "});"
-        "es.addEventListener('done', function(e) {"
-        "  es.close();"
-        "  document.getElementById('events').innerHTML += '<p><strong>Done</strong></p>';"
-        "});"
         "</script>"
         "</body></html>";
 
@@ -168,6 +114,11 @@ int main(int argc, char** argv) {
     uvhttp_router_add_route(router, "/events", events_handler);
     uvhttp_server_set_router(server, router);
 
+    g_server = server;
+    uvhttp_sse_set_heartbeat_interval(server, 15000);
+    uv_timer_init(loop, &g_tick_timer);
+    uv_timer_start(&g_tick_timer, tick_cb, 1000, 1000);
+
     err = uvhttp_server_listen(server, "127.0.0.1", port);
     if (err != UVHTTP_OK) {
         fprintf(stderr, "Failed to listen: %s\n", uvhttp_error_string(err));
@@ -14,6 +14,7 @@
 #include "uvhttp_server.h"
 #include "uvhttp_utils.h"
 #include "uvhttp_version.h"
+#include "uvhttp_vhost.h"
 
 /* Conditional includes for optional features */
 
@@ -21,6 +22,10 @@
 #    include "uvhttp_websocket.h"
 #endif
 
+#if UVHTTP_FEATURE_SSE
+#    include "uvhttp_sse.h"
+#endif
+
 #if UVHTTP_FEATURE_TLS
 #    include "uvhttp_tls.h"
 #endif
@@ -64,6 +64,10 @@ typedef struct {
                                     connection detection and overhead */
     int websocket_ping_timeout;  /* Ping timeout, default 10 seconds, 3x RTT
                                     estimated value */
+    int websocket_compression; /* Negotiate permessage-deflate (RFC 7692),
+                                  default 0 (off) */
+    int websocket_compression_threshold; /* Messages below this many bytes are
+                                            sent uncompressed, default 256 */
 
     /* Network configuration */
     int tcp_keepalive_timeout; /* TCP Keep-Alive timeout, default 60 seconds,
@@ -3,6 +3,7 @@
 
 #include "uvhttp_common.h"
 #include "uvhttp_features.h"
+#include "uvhttp_middleware.h"
 #include "uvhttp_platform.h"
 #include "uvhttp_request.h"
 #include "uvhttp_response.h"
@@ -89,7 +90,9 @@ struct uvhttp_connection {
     /* Protocol upgrade related fields */
     char protocol_name[32]; /* 32 bytes - Upgraded protocol name */
     void* lifecycle;        /* 8 bytes - Lifecycle callbacks */
-    int _padding4[6];       /* 24bytes - paddingto64bytes */
+    void* sse_stream;       /* 8 bytes - Server-Sent Events stream */
+    void* static_op;        /* 8 bytes - static file being read for it */
+    int _padding4[2];       /* 8bytes - paddingto64bytes */
     /* Cache line 5 total: 64 bytes */
 
     /* ========== Cache line 6+ (320+ bytes): large buffers ========== */
@@ -97,6 +100,12 @@ struct uvhttp_connection {
     char current_header_field[UVHTTP_MAX_HEADER_NAME_SIZE]; /* blockmemory */
     void* user_data;        /* embedder data */
     void (*on_destroy)(uvhttp_connection_t* conn); /* before resources freed */
+    /* Router middleware of the current request (uvhttp_router_use); idle
+     * unless a middleware answered UVHTTP_MIDDLEWARE_ASYNC */
+    uvhttp_middleware_context_t middleware;
+    /* Router serving the current request: its virtual host's, or the
+     * server's (uvhttp_server_find_router) */
+    struct uvhttp_router* router;
     /* TLS ciphertext buffer: the socket bytes go here, mbedtls_bio_recv
      * consumes from here, while conn->read_buffer holds only decrypted
      * plaintext for llhttp. Keeping the two separate avoids ciphertext being
@@ -105,6 +114,11 @@ struct uvhttp_connection {
     char* tls_cipher_buf;
     size_t tls_cipher_used;
     size_t tls_cipher_cap;
+    /* Dynamic TLS record sizing state: plaintext bytes written since the
+     * current request began (or the last idle reset) and loop time of the
+     * previous write. */
+    uint64_t tls_record_streamed;
+    uint64_t tls_record_last_ms;
 };
 
 /* ========== Memory Layout Verification Static Assertions ========== */
@@ -203,6 +217,11 @@ void uvhttp_connection_websocket_close(uvhttp_connection_t* conn);
 
 #endif /* UVHTTP_FEATURE_WEBSOCKET */
 
+/* Server-Sent EventshandleFunction(internal) */
+#if UVHTTP_FEATURE_SSE
+uvhttp_error_t uvhttp_connection_switch_to_sse(uvhttp_connection_t* conn);
+#endif /* UVHTTP_FEATURE_SSE */
+
 #ifdef __cplusplus
 }
 #endif
@@ -470,6 +470,47 @@
 #        define UVHTTP_FILE_CHUNK_SIZE (64 * 1024) /* 64KB */
 #    endif
 
+/* Cache misses a static context reads at once (uv_fs_* chains on the libuv
+ * thread pool); later misses wait for a slot */
+#    ifndef UVHTTP_STATIC_MAX_INFLIGHT_FS
+#        define UVHTTP_STATIC_MAX_INFLIGHT_FS 16
+#    endif
+
+/* Ranges one Range request may ask for; more are answered with the whole
+ * file */
+#    ifndef UVHTTP_STATIC_MAX_RANGES
+#        define UVHTTP_STATIC_MAX_RANGES 16
+#    endif
+
+/* Bytes the ranges of a multipart/byteranges answer may add up to; a Range
+ * header asking for more is answered with the whole file (a single range
+ * is not limited) */
+#    ifndef UVHTTP_STATIC_MAX_MULTIPART_SIZE
+#        define UVHTTP_STATIC_MAX_MULTIPART_SIZE (1024 * 1024) /* 1MB */
+#    endif
+
+/* Smallest file worth sending compressed: smaller ones are sent as they
+ * are, without looking for a .gz sibling or keeping a gzip variant */
+#    ifndef UVHTTP_STATIC_COMPRESS_MIN_SIZE
+#        define UVHTTP_STATIC_COMPRESS_MIN_SIZE 512
+#    endif
+
+/* Open-file cache of a static context: requested paths remembered, seconds
+ * an entry is trusted without a change notification, descriptors of large
+ * files kept open, and directories watched for changes */
+#    ifndef UVHTTP_STATIC_OPEN_FILE_CACHE_SIZE
+#        define UVHTTP_STATIC_OPEN_FILE_CACHE_SIZE 1024
+#    endif
+#    ifndef UVHTTP_STATIC_OPEN_FILE_CACHE_TTL
+#        define UVHTTP_STATIC_OPEN_FILE_CACHE_TTL 60
+#    endif
+#    ifndef UVHTTP_STATIC_OPEN_FILE_CACHE_FDS
+#        define UVHTTP_STATIC_OPEN_FILE_CACHE_FDS 256
+#    endif
+#    ifndef UVHTTP_STATIC_OPEN_FILE_CACHE_WATCHES
+#        define UVHTTP_STATIC_OPEN_FILE_CACHE_WATCHES 128
+#    endif
+
 #    ifndef UVHTTP_SENDFILE_DEFAULT_TIMEOUT_MS
 #        define UVHTTP_SENDFILE_DEFAULT_TIMEOUT_MS 30000 /* 30 seconds */
 #    endif
@@ -616,6 +657,28 @@
 #        define UVHTTP_CACHE_MAX_TTL 86400 /* 24 hours */
 #    endif
 
+/* ETag bytes (with the NUL) kept per cache entry: a quoted "<size>-<mtime>"
+ * fits; content with a longer ETag is not cached */
+#    ifndef UVHTTP_CACHE_ETAG_SIZE
+#        define UVHTTP_CACHE_ETAG_SIZE 48
+#    endif
+
+/* W-TinyLFU: shares (percent) of the cache for the admission window, and of
+ * the main cache for its protected segment */
+#    ifndef UVHTTP_CACHE_TINYLFU_WINDOW_PERCENT
+#        define UVHTTP_CACHE_TINYLFU_WINDOW_PERCENT 1
+#    endif
+
+#    ifndef UVHTTP_CACHE_TINYLFU_PROTECTED_PERCENT
+#        define UVHTTP_CACHE_TINYLFU_PROTECTED_PERCENT 80
+#    endif
+
+/* W-TinyLFU: the frequency sketch halves its counters after this many
+ * additions per counter of a row */
+#    ifndef UVHTTP_CACHE_TINYLFU_SAMPLE_FACTOR
+#        define UVHTTP_CACHE_TINYLFU_SAMPLE_FACTOR 10
+#    endif
+
 #    ifndef UVHTTP_LRU_CACHE_MIN_BATCH_EVICTION_SIZE
 #        define UVHTTP_LRU_CACHE_MIN_BATCH_EVICTION_SIZE 1
 #    endif
@@ -1123,9 +1186,11 @@
 #    define UVHTTP_HEADER_CONTENT_LENGTH "Content-Length"
 #    define UVHTTP_HEADER_CACHE_CONTROL "Cache-Control"
 #    define UVHTTP_HEADER_CONNECTION "Connection"
+#    define UVHTTP_HEADER_HOST "Host"
 #    define UVHTTP_HEADER_UPGRADE "Upgrade"
 #    define UVHTTP_HEADER_WEBSOCKET_KEY "Sec-WebSocket-Key"
 #    define UVHTTP_HEADER_WEBSOCKET_ACCEPT "Sec-WebSocket-Accept"
+#    define UVHTTP_HEADER_WEBSOCKET_EXTENSIONS "Sec-WebSocket-Extensions"
 
 /**
  * ErrorResponsemessage
@@ -1134,6 +1199,7 @@
 #    define UVHTTP_MESSAGE_FORBIDDEN "Forbidden"
 #    define UVHTTP_MESSAGE_NOT_FOUND "File not found"
 #    define UVHTTP_MESSAGE_FILE_TOO_LARGE "File too large"
+#    define UVHTTP_MESSAGE_RANGE_NOT_SATISFIABLE "Range not satisfiable"
 #    define UVHTTP_MESSAGE_INTERNAL_ERROR "Internal server error"
 #    define UVHTTP_MESSAGE_MEMORY_FAILED "Memory allocation failed"
 #    define UVHTTP_MESSAGE_FILE_READ_ERROR "File read error"
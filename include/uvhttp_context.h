@@ -69,6 +69,10 @@ typedef struct uvhttp_context {
     int ws_drbg_initialized;
     void* ws_entropy; /* mbedtls_entropy_context* */
     void* ws_drbg;    /* mbedtls_ctr_drbg_context* */
+    void* ws_deflater; /* z_stream*, permessage-deflate compressor shared by
+                          the loop's connections */
+    void* ws_inflater; /* z_stream*, inflater for peers without context
+                          takeover */
 
     /* Configuration management */
     void* current_config;  /* uvhttp_config_t* */
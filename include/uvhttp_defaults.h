@@ -207,6 +207,101 @@ extern "C" {
 #    define UVHTTP_WEBSOCKET_DEFAULT_PING_TIMEOUT 10
 #endif
 
+/**
+ * WebSocket outbound queue limit(bytes)
+ *
+ * Frames accepted but not yet written to the socket count against this
+ * budget; past it the slow-consumer policy applies. 0 = unbounded.
+ */
+#ifndef UVHTTP_WEBSOCKET_DEFAULT_SEND_QUEUE_MAX
+#    define UVHTTP_WEBSOCKET_DEFAULT_SEND_QUEUE_MAX (4 * 1024 * 1024) /* 4MB */
+#endif
+
+/**
+ * WebSocket frames coalesced into one uv_write(bufs, n) call
+ */
+#ifndef UVHTTP_WEBSOCKET_WRITEV_MAX
+#    define UVHTTP_WEBSOCKET_WRITEV_MAX 16
+#endif
+
+/**
+ * WebSocket permessage-deflate: messages shorter than this(bytes) are sent
+ * uncompressed
+ */
+#ifndef UVHTTP_WEBSOCKET_DEFAULT_COMPRESSION_THRESHOLD
+#    define UVHTTP_WEBSOCKET_DEFAULT_COMPRESSION_THRESHOLD 256
+#endif
+
+/**
+ * WebSocket permessage-deflate compression level(1 fastest - 9 smallest)
+ */
+#ifndef UVHTTP_WEBSOCKET_COMPRESSION_LEVEL
+#    define UVHTTP_WEBSOCKET_COMPRESSION_LEVEL 3
+#endif
+
+/**
+ * Ask clients to compress every message from a fresh window
+ * (client_no_context_takeover)
+ *
+ * 1: no inflate window is kept per connection between messages(Default)
+ * 0: clients may keep their window, better ratio, one inflate window per
+ *    connection
+ */
+#ifndef UVHTTP_WEBSOCKET_DEFLATE_CLIENT_NO_CONTEXT_TAKEOVER
+#    define UVHTTP_WEBSOCKET_DEFLATE_CLIENT_NO_CONTEXT_TAKEOVER 1
+#endif
+
+/**
+ * client_max_window_bits granted to clients that offer the parameter(8-15)
+ */
+#ifndef UVHTTP_WEBSOCKET_DEFLATE_CLIENT_MAX_WINDOW_BITS
+#    define UVHTTP_WEBSOCKET_DEFLATE_CLIENT_MAX_WINDOW_BITS 15
+#endif
+
+/* ========== Server-Sent Events Configuration Default Values ========== */
+
+/**
+ * SSE heartbeat interval(milliseconds)
+ *
+ * Streams quiet for this long get a comment line so proxies keep the
+ * connection open. 0 = no heartbeat.
+ */
+#ifndef UVHTTP_SSE_DEFAULT_HEARTBEAT_INTERVAL
+#    define UVHTTP_SSE_DEFAULT_HEARTBEAT_INTERVAL 15000
+#endif
+
+/**
+ * SSE outbound queue limit per stream(bytes). 0 = unbounded.
+ */
+#ifndef UVHTTP_SSE_DEFAULT_SEND_QUEUE_MAX
+#    define UVHTTP_SSE_DEFAULT_SEND_QUEUE_MAX (1024 * 1024) /* 1MB */
+#endif
+
+/**
+ * Published events kept per channel for Last-Event-ID resume
+ */
+#ifndef UVHTTP_SSE_DEFAULT_REPLAY_SIZE
+#    define UVHTTP_SSE_DEFAULT_REPLAY_SIZE 256
+#endif
+
+/**
+ * SSE channel idle timeout(milliseconds)
+ *
+ * A channel with no subscribers that has not been published to for this
+ * long is freed with its replay ring. 0 = channels live until the server
+ * is freed.
+ */
+#ifndef UVHTTP_SSE_DEFAULT_CHANNEL_IDLE_TIMEOUT
+#    define UVHTTP_SSE_DEFAULT_CHANNEL_IDLE_TIMEOUT 300000 /* 5 minutes */
+#endif
+
+/**
+ * SSE events coalesced into one uv_write(bufs, n) call
+ */
+#ifndef UVHTTP_SSE_WRITEV_MAX
+#    define UVHTTP_SSE_WRITEV_MAX 16
+#endif
+
 /* ========== Memory Configuration Default Values ========== */
 
 /**
@@ -239,6 +334,23 @@ extern "C" {
 
 /* UVHTTP_DEFAULT_ENABLE_ACCESS_LOG delete - Use */
 
+/* ========== Router Configuration Default Values ========== */
+
+/**
+ * Route match cache slots (rounded up to a power of two)
+ */
+#ifndef UVHTTP_ROUTER_MATCH_CACHE_SIZE
+#    define UVHTTP_ROUTER_MATCH_CACHE_SIZE 256
+#endif
+
+/**
+ * Longest request path the route match cache stores(bytes); longer paths
+ * are always matched in full
+ */
+#ifndef UVHTTP_ROUTER_MATCH_CACHE_MAX_PATH
+#    define UVHTTP_ROUTER_MATCH_CACHE_MAX_PATH 112
+#endif
+
 /* ========== Hash Configuration Default Values ========== */
 
 /**
@@ -88,6 +88,7 @@ typedef enum {
     UVHTTP_ERROR_ROUTE_NOT_FOUND = -502,
     UVHTTP_ERROR_ROUTE_ALREADY_EXISTS = -503,
     UVHTTP_ERROR_INVALID_ROUTE_PATTERN = -504,
+    UVHTTP_ERROR_ROUTER_FROZEN = -505,
 
     /* Rate limit errors */
     UVHTTP_ERROR_RATE_LIMIT_EXCEEDED = -550,
@@ -106,6 +107,10 @@ typedef enum {
     UVHTTP_ERROR_WEBSOCKET_NOT_CONNECTED = -705,
     UVHTTP_ERROR_WEBSOCKET_ALREADY_CONNECTED = -706,
     UVHTTP_ERROR_WEBSOCKET_CLOSED = -707,
+    UVHTTP_ERROR_WEBSOCKET_SLOW_CONSUMER = -708,
+
+    /* Server-Sent Events errors */
+    UVHTTP_ERROR_SSE_SLOW_CONSUMER = -750,
 
     /* Configuration errors */
     UVHTTP_ERROR_CONFIG_PARSE = -900,
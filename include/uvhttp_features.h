@@ -20,6 +20,10 @@ extern "C" {
 #    define UVHTTP_FEATURE_WEBSOCKET 1 /* WebSocket functionblock */
 #endif
 
+#ifndef UVHTTP_FEATURE_SSE
+#    define UVHTTP_FEATURE_SSE 1 /* Server-Sent Events */
+#endif
+
 #ifndef UVHTTP_FEATURE_STATIC_FILES
 #    define UVHTTP_FEATURE_STATIC_FILES 1 /* Static filefunctionblock */
 #endif
@@ -32,6 +36,10 @@ extern "C" {
 #    define UVHTTP_FEATURE_ROUTER_CACHE 0 /* RouterCacheSupport */
 #endif
 
+#ifndef UVHTTP_FEATURE_ROUTER_MATCH_CACHE
+#    define UVHTTP_FEATURE_ROUTER_MATCH_CACHE 0 /* Route match cache */
+#endif
+
 #ifndef UVHTTP_FEATURE_LRU_CACHE
 #    define UVHTTP_FEATURE_LRU_CACHE 1 /* LRUCacheSupport */
 #endif
@@ -53,6 +61,10 @@ extern "C" {
 #    define UVHTTP_WEBSOCKET_ENABLED
 #endif
 
+#if UVHTTP_FEATURE_SSE
+#    define UVHTTP_SSE_ENABLED
+#endif
+
 #if UVHTTP_FEATURE_LOGGING
 #    define UVHTTP_LOGGING_ENABLED
 #endif
@@ -71,6 +83,10 @@ extern "C" {
 #    define UVHTTP_ROUTER_CACHE_ENABLED
 #endif
 
+#if UVHTTP_FEATURE_ROUTER_MATCH_CACHE
+#    define UVHTTP_ROUTER_MATCH_CACHE_ENABLED
+#endif
+
 #if UVHTTP_FEATURE_RATE_LIMIT
 #    define UVHTTP_RATE_LIMIT_ENABLED
 #endif
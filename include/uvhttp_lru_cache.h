@@ -10,6 +10,7 @@
 #    include "uvhttp_error.h"
 
 #    include <stddef.h>
+#    include <stdint.h>
 #    include <time.h>
 
 /* Include uthash header */
@@ -23,26 +24,92 @@ extern "C" {
 typedef struct cache_entry cache_entry_t;
 typedef struct cache_manager cache_manager_t;
 
-/* LRU cache entry structure */
-struct cache_entry {
-    char file_path[UVHTTP_MAX_FILE_PATH_SIZE];    /* File path */
-    char* content;                                /*  */
-    size_t content_length;                        /* Content length */
-    char mime_type[UVHTTP_MAX_HEADER_VALUE_SIZE]; /* MIMEclass */
-    time_t last_modified;                         /* lastmodifywhen */
-    char etag[UVHTTP_MAX_HEADER_VALUE_SIZE];      /* ETagvalue */
-    time_t access_time;                           /* lastaccesswhen */
-    time_t cache_time;                            /* Cachewhen */
-    size_t memory_usage;                          /* memoryUse */
-    int is_compressed;                            /* whethercompress */
-    int priority; /* Cache priority (0-255, higher = more important) */
+/* Which entries a full cache keeps */
+typedef enum {
+    /* admit every entry, evict the least recently used */
+    UVHTTP_CACHE_POLICY_LRU = 0,
+    /* W-TinyLFU: new entries go through a small LRU window; leaving it, an
+     * entry is admitted to the main cache only if it is estimated to be
+     * used more often than the main cache's victim. The main cache is a
+     * segmented LRU: a probation segment, and a protected one for entries
+     * used again while on probation */
+    UVHTTP_CACHE_POLICY_TINYLFU
+} uvhttp_cache_policy_t;
+
+/* Where an entry is linked (cache_entry_t.segment) */
+enum {
+    UVHTTP_CACHE_SEGMENT_WINDOW = 0, /* lru_head/lru_tail: the whole LRU
+                                        list, or the W-TinyLFU window */
+    UVHTTP_CACHE_SEGMENT_PROBATION,
+    UVHTTP_CACHE_SEGMENT_PROTECTED
+};
 
-    /* uthash hash handle */
+/* A segment of the W-TinyLFU main cache, most recently used first */
+typedef struct uvhttp_cache_segment {
+    cache_entry_t* head;
+    cache_entry_t* tail;
+    size_t memory_usage;
+    int entry_count;
+} uvhttp_cache_segment_t;
+
+/* Immutable bytes an entry shares with the writes still sending them:
+ * freed (or unmapped) when the entry and every write have released them.
+ * References are counted atomically, from any thread */
+typedef struct uvhttp_cache_buffer {
+    int refcount;
+    int mapped; /* data is a read-only mapping of a file */
+    size_t length;
+    struct uvhttp_cache_buffer* body; /* a head: the content it describes */
+    char* data;                       /* inline_data, or the mapping */
+    char inline_data[1];              /* length bytes, then a NUL */
+} uvhttp_cache_buffer_t;
+
+/* Content codings an entry can hold its content in, besides identity */
+typedef enum {
+    UVHTTP_CACHE_ENCODING_GZIP = 0,
+    UVHTTP_CACHE_ENCODING_COUNT
+} uvhttp_cache_encoding_t;
+
+/* The content of an entry in one content coding */
+typedef struct uvhttp_cache_variant {
+    uvhttp_cache_buffer_t* buffer; /* the encoded content */
+    uvhttp_cache_buffer_t* head;   /* as cache_entry_t.head, for buffer */
+    size_t head_keepalive_length;
+} uvhttp_cache_variant_t;
+
+/* LRU cache entry structure: a fixed header, then the key. memory_usage
+ * counts both, the content, the variants and the heads */
+struct cache_entry {
+    /* uthash hash handle, keyed by the xxhash of file_path */
     UT_hash_handle hh;
 
     /* LRU linked list handle */
     struct cache_entry* lru_prev;
     struct cache_entry* lru_next;
+
+    char* content;                 /* buffer->data */
+    size_t content_length;         /* Content length */
+    uvhttp_cache_buffer_t* buffer; /* holds content */
+    /* Pre-rendered "200 OK" status line and headers for content, with
+     * keep-alive (the first head_keepalive_length bytes) and then with
+     * Connection: close; NULL until set by uvhttp_lru_cache_set_head */
+    uvhttp_cache_buffer_t* head;
+    size_t head_keepalive_length;
+    const char* mime_type; /* interned by the cache manager */
+    time_t last_modified;  /* lastmodifywhen */
+    time_t access_time;    /* lastaccesswhen */
+    time_t cache_time;     /* Cachewhen */
+    size_t memory_usage;   /* memoryUse */
+    /* Encoded variants of content, made on demand: a bit per encoding is
+     * set in encodings_tried once one is claimed, and variants[encoding]
+     * is filled once made (and was worth keeping) */
+    uvhttp_cache_variant_t variants[UVHTTP_CACHE_ENCODING_COUNT];
+    unsigned encodings_tried;
+    int priority; /* Cache priority (0-255, higher = more important) */
+    int segment;   /* UVHTTP_CACHE_SEGMENT_* */
+    unsigned hash; /* xxhash of file_path */
+    char etag[UVHTTP_CACHE_ETAG_SIZE]; /* ETagvalue, "" for none */
+    char file_path[1]; /* File path (the key), allocated to fit */
 };
 
 /* LRU cache manager */
@@ -65,11 +132,30 @@ struct cache_manager {
     /* Cache policy */
     int enable_priority_eviction; /* Enable priority-based eviction */
     int min_priority_threshold; /* Minimum priority to protect from eviction */
+    uvhttp_cache_policy_t policy;
+
+    /* W-TinyLFU: the window is lru_head/lru_tail, the main cache these */
+    uvhttp_cache_segment_t probation;
+    uvhttp_cache_segment_t protected_segment;
+
+    /* W-TinyLFU: Count-Min sketch of how often keys are looked up, 4 rows
+     * of sketch_width saturating counters; halved every sketch_sample
+     * additions so that it forgets old popularity */
+    uint8_t* sketch;
+    size_t sketch_width; /* a power of two */
+    int sketch_additions;
+    int sketch_sample;
 
     /* Statistics */
     int hit_count;      /* times */
     int miss_count;     /* times */
     int eviction_count; /* evicttimes */
+
+    /* MIME types of the entries, each stored once until the cache is
+     * freed (there are a few dozen) */
+    char** mime_types;
+    int mime_type_count;
+    int mime_type_capacity;
 };
 
 /**
@@ -101,6 +187,17 @@ void uvhttp_lru_cache_free(cache_manager_t* cache);
 cache_entry_t* uvhttp_lru_cache_find(cache_manager_t* cache,
                                      const char* file_path);
 
+/**
+ * Find a cache entry without counting it as a use: statistics, recency,
+ * frequency and expiry are left as they are
+ *
+ * @param cache Cache manager
+ * @param file_path File path
+ * @return The entry, or NULL
+ */
+cache_entry_t* uvhttp_lru_cache_peek(cache_manager_t* cache,
+                                     const char* file_path);
+
 /**
  * addorupdateCacheentry
  *
@@ -110,8 +207,10 @@ cache_entry_t* uvhttp_lru_cache_find(cache_manager_t* cache,
  * @param content_length Content length
  * @param mime_type MIMEclass
  * @param last_modified lastmodifywhen
- * @param etag ETagvalue
- * @return UVHTTP_OKSuccess, othervaluerepresentsFailure
+ * @param etag ETagvalue (shorter than UVHTTP_CACHE_ETAG_SIZE), or NULL
+ * @return UVHTTP_OKSuccess, othervaluerepresentsFailure. Under W-TinyLFU
+ *   a full cache may decline a new entry that is used too rarely: it is
+ *   not found afterwards, though UVHTTP_OK is returned
  */
 uvhttp_error_t uvhttp_lru_cache_put(cache_manager_t* cache,
                                     const char* file_path, char* content,
@@ -119,6 +218,99 @@ uvhttp_error_t uvhttp_lru_cache_put(cache_manager_t* cache,
                                     const char* mime_type, time_t last_modified,
                                     const char* etag);
 
+/**
+ * Attach a pre-rendered response head to entry, replacing any; it is
+ * dropped with the entry or when the entry's content is replaced. The
+ * entry takes over the caller's reference to head.
+ *
+ * @param cache Cache manager
+ * @param entry Entry of cache
+ * @param head Status line and headers, keep-alive variant first
+ * @param keepalive_length Length of the keep-alive variant
+ */
+void uvhttp_lru_cache_set_head(cache_manager_t* cache, cache_entry_t* entry,
+                               uvhttp_cache_buffer_t* head,
+                               size_t keepalive_length);
+
+/**
+ * Claim the making of entry's variant in encoding: only the first caller
+ * (since the content was last replaced) is told to make it
+ *
+ * @param entry Entry of cache
+ * @param encoding Content coding
+ * @return 1 if the caller is to make the variant, 0 otherwise
+ */
+int uvhttp_lru_cache_claim_variant(cache_entry_t* entry,
+                                   uvhttp_cache_encoding_t encoding);
+
+/**
+ * Keep buffer as entry's content in encoding (a reference is taken),
+ * unless the entry has that variant already. The bytes count towards the
+ * entry's memory usage; they are dropped with the content.
+ *
+ * @param cache Cache manager
+ * @param entry Entry of cache
+ * @param encoding Content coding
+ * @param buffer Encoded content, or NULL when it was not worth keeping
+ */
+void uvhttp_lru_cache_set_variant(cache_manager_t* cache, cache_entry_t* entry,
+                                  uvhttp_cache_encoding_t encoding,
+                                  uvhttp_cache_buffer_t* buffer);
+
+/**
+ * As uvhttp_lru_cache_set_head, for entry's variant in encoding; head is
+ * released if the entry has no such variant.
+ */
+void uvhttp_lru_cache_set_variant_head(cache_manager_t* cache,
+                                       cache_entry_t* entry,
+                                       uvhttp_cache_encoding_t encoding,
+                                       uvhttp_cache_buffer_t* head,
+                                       size_t keepalive_length);
+
+/**
+ * Allocate a buffer of length bytes (plus a NUL) with one reference
+ *
+ * @return The buffer, or NULL when out of memory
+ */
+uvhttp_cache_buffer_t* uvhttp_cache_buffer_create(size_t length);
+
+/**
+ * Map length bytes of the regular file fd read-only, with one reference.
+ * The mapping outlives fd. Blocks while prefaulting: call it off the loop
+ * thread.
+ *
+ * @param fd Open file
+ * @param length Size of the file (at least 1)
+ * @param populate Prefault the pages (MAP_POPULATE) rather than only
+ *   advising the kernel to read them ahead (MADV_WILLNEED)
+ * @return The buffer, or NULL when the file cannot be mapped
+ */
+uvhttp_cache_buffer_t* uvhttp_cache_buffer_map(int fd, size_t length,
+                                               int populate);
+
+/**
+ * Take a reference to buffer
+ */
+void uvhttp_cache_buffer_retain(uvhttp_cache_buffer_t* buffer);
+
+/**
+ * Drop a reference to buffer (may be NULL), freeing it with the last one
+ */
+void uvhttp_cache_buffer_release(uvhttp_cache_buffer_t* buffer);
+
+/**
+ * Add or update an entry holding buffer (a reference is taken, nothing is
+ * copied); memory accounting counts buffer->length
+ *
+ * @return UVHTTP_OK on success, otherwise an error code
+ */
+uvhttp_error_t uvhttp_lru_cache_put_buffer(cache_manager_t* cache,
+                                           const char* file_path,
+                                           uvhttp_cache_buffer_t* buffer,
+                                           const char* mime_type,
+                                           time_t last_modified,
+                                           const char* etag);
+
 /**
  * deleteCacheentry
  *
@@ -243,6 +435,20 @@ cache_entry_t* uvhttp_lru_cache_remove_tail(cache_manager_t* cache);
  */
 double uvhttp_lru_cache_get_hit_rate(cache_manager_t* cache);
 
+/**
+ * set cache policy
+ * May be changed at any time, keeping the entries. Priority-based eviction
+ * only applies to the LRU policy.
+ *
+ * @param cache Cache manager
+ * @param policy UVHTTP_CACHE_POLICY_LRU (the default) or
+ *   UVHTTP_CACHE_POLICY_TINYLFU
+ * @return UVHTTP_OK on success, UVHTTP_ERROR_OUT_OF_MEMORY when the
+ *   frequency sketch cannot be allocated
+ */
+uvhttp_error_t uvhttp_lru_cache_set_policy(cache_manager_t* cache,
+                                           uvhttp_cache_policy_t policy);
+
 /**
  * set eviction callback
  * Called when a cache entry is evicted
@@ -6,7 +6,9 @@
  * - 编译时宏展开，无运行时注册/查找开销
  * - 短路语义：中间件返回 STOP 立即中断链
  * - 共享上下文：所有中间件共享同一个 context
- * - 运行时中间件由用户自行实现
+ * - 运行时中间件：uvhttp_router_use() 按路由前缀注册，注册时即展开为
+ *   每个路由的中间件数组，由 uvhttp_middleware_start() 依次执行，
+ *   返回 ASYNC 的中间件稍后调用 uvhttp_middleware_resume() 继续
  *
  * 核心宏：
  * - UVHTTP_EXECUTE_MIDDLEWARE(req, resp, mw1, mw2, ...)
@@ -57,18 +59,72 @@ extern "C" {
 /* Middleware return values */
 #define UVHTTP_MIDDLEWARE_CONTINUE 0
 #define UVHTTP_MIDDLEWARE_STOP 1
+/* Runtime pipelines only: the middleware will call uvhttp_middleware_resume()
+ * later, e.g. once a token has been checked with another service */
+#define UVHTTP_MIDDLEWARE_ASYNC 2
 
-/* Middleware context */
-typedef struct uvhttp_middleware_context {
-    void* data;
-    void (*cleanup)(void* data);
-} uvhttp_middleware_context_t;
+typedef struct uvhttp_middleware_context uvhttp_middleware_context_t;
 
 /* Middleware handler function type */
 typedef int (*uvhttp_middleware_handler_t)(uvhttp_request_t* request,
                                            uvhttp_response_t* response,
                                            uvhttp_middleware_context_t* ctx);
 
+/* Middleware context */
+struct uvhttp_middleware_context {
+    void* data;
+    void (*cleanup)(void* data);
+
+    /* Runtime pipeline state (uvhttp_middleware_start); the macros below
+     * leave it zero */
+    const uvhttp_middleware_handler_t* chain; /* NULL when idle */
+    size_t chain_count;
+    size_t next; /* index of the next middleware to call */
+    uvhttp_request_t* request;
+    uvhttp_response_t* response;
+    uvhttp_request_handler_t handler; /* route handler, may be NULL */
+    void (*done)(uvhttp_middleware_context_t* ctx); /* all continued */
+    void* done_data;
+};
+
+/* ========== Runtime pipelines ========== */
+
+/**
+ * Run chain[0..count) for a request, then ctx->done(ctx) if every middleware
+ * continued. A middleware returning STOP must have answered the request
+ * itself. One returning ASYNC suspends the pipeline until it calls
+ * uvhttp_middleware_resume(). data/cleanup are reset first; cleanup runs
+ * when the pipeline ends, just before done. Inside done, request, response,
+ * handler and done_data are still set.
+ */
+void uvhttp_middleware_start(uvhttp_middleware_context_t* ctx,
+                             uvhttp_request_t* request,
+                             uvhttp_response_t* response,
+                             const uvhttp_middleware_handler_t* chain,
+                             size_t count, uvhttp_request_handler_t handler,
+                             void (*done)(uvhttp_middleware_context_t* ctx),
+                             void* done_data);
+
+/**
+ * Continue a pipeline suspended by UVHTTP_MIDDLEWARE_ASYNC with the
+ * middleware's result: CONTINUE goes on with the next middleware, STOP ends
+ * the pipeline, ASYNC keeps it suspended.
+ */
+void uvhttp_middleware_resume(uvhttp_middleware_context_t* ctx, int result);
+
+/**
+ * Abandon a pending pipeline (the connection is closing): runs cleanup so a
+ * suspended middleware can cancel its work, and never calls done. The
+ * middleware must not resume afterwards. Does nothing when idle.
+ */
+void uvhttp_middleware_cancel(uvhttp_middleware_context_t* ctx);
+
+/* 1 while a pipeline is running or suspended */
+static inline int uvhttp_middleware_pending(
+    const uvhttp_middleware_context_t* ctx) {
+    return ctx->chain != NULL;
+}
+
 /* Execute middleware chain */
 #define _UVHTTP_MW_EXECUTE_IMPL_(counter, req, resp, ...)                      \
     do {                                                                        \
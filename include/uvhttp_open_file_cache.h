@@ -0,0 +1,172 @@
+/**
+ * @file uvhttp_open_file_cache.h
+ * @brief Open-file and stat cache for static file serving
+ *
+ * Remembers, per requested path, what a cache miss found on disk: the
+ * resolved file with its size, mtime and inode, whether a pre-compressed
+ * "<file>.gz" sits next to it, and (for files large enough to be sent with
+ * sendfile) an open descriptor. Paths that do not name a servable file are
+ * remembered too (negative entries). A repeated miss then skips realpath,
+ * stat and, for large files, open.
+ *
+ * Entries are dropped precisely when the directories they were found in
+ * change (uv_fs_event_t: inotify on Linux, kqueue/FSEvents elsewhere), and
+ * in any case after a TTL, which also covers changes no watch can see (a
+ * directory that could not be watched, a symlink further up the path).
+ *
+ * @note Only compiled when UVHTTP_FEATURE_STATIC_FILES is enabled.
+ * @note Not thread-safe: one cache belongs to the loop it was used on first.
+ * @note Entry pointers are owned by the cache and stay valid until the next
+ *   call that may insert, invalidate or expire entries (or until the loop
+ *   runs a watch callback).
+ */
+
+#ifndef UVHTTP_OPEN_FILE_CACHE_H
+#define UVHTTP_OPEN_FILE_CACHE_H
+
+#include "uvhttp_error.h"
+#include "uvhttp_features.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <uv.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if UVHTTP_FEATURE_STATIC_FILES
+
+typedef struct uvhttp_open_file_cache uvhttp_open_file_cache_t;
+
+/* What a requested path led to */
+typedef struct {
+    const char* path; /* resolved regular file (NULL when negative) */
+    size_t size;
+    time_t mtime;
+    uint64_t ino;
+    uv_file fd;   /* cache-owned descriptor of path, -1 if not kept */
+    int negative; /* the requested path names no servable file */
+
+    /* "<path>.gz": -1 not looked for yet, 0 absent, 1 present */
+    int has_gz;
+    size_t gz_size;
+    time_t gz_mtime;
+    uv_file gz_fd; /* -1 if not kept */
+} uvhttp_open_file_t;
+
+/* Counters since creation */
+typedef struct {
+    uint64_t hits;          /* lookups answered by a file entry */
+    uint64_t negative_hits; /* lookups answered by a negative entry */
+    uint64_t misses;        /* lookups with no (or an expired) entry */
+    uint64_t invalidations; /* entries dropped because their files changed */
+    size_t entries;         /* entries currently held */
+    size_t open_fds;        /* descriptors currently held */
+    size_t watches;         /* directories currently watched */
+} uvhttp_open_file_cache_stats_t;
+
+/* Called for every key dropped by a change notification, so that content
+ * cached under the same key can be dropped with it */
+typedef void (*uvhttp_open_file_invalidate_cb)(void* data, const char* key);
+
+/**
+ * Create an open-file cache.
+ *
+ * @param max_entries Entries kept, least recently used dropped first
+ *   (0 = UVHTTP_STATIC_OPEN_FILE_CACHE_SIZE)
+ * @param ttl Seconds an entry is trusted (0 = UVHTTP_STATIC_OPEN_FILE_CACHE_TTL)
+ * @param max_fds Descriptors kept open at most
+ *   (0 = UVHTTP_STATIC_OPEN_FILE_CACHE_FDS)
+ * @param cache Output parameter, receives the created cache
+ * @return UVHTTP_OK on success, otherwise an error code
+ */
+uvhttp_error_t uvhttp_open_file_cache_create(int max_entries, int ttl,
+                                             int max_fds,
+                                             uvhttp_open_file_cache_t** cache);
+
+/**
+ * Release the cache: its descriptors are closed and its watches stopped.
+ * The watch handles finish closing on the next loop iteration.
+ *
+ * @param cache Cache to release (may be NULL)
+ */
+void uvhttp_open_file_cache_free(uvhttp_open_file_cache_t* cache);
+
+/**
+ * Set the function told about keys dropped by change notifications.
+ */
+void uvhttp_open_file_cache_set_invalidate_cb(
+    uvhttp_open_file_cache_t* cache, uvhttp_open_file_invalidate_cb cb,
+    void* data);
+
+/**
+ * Look up a requested path, counting a hit, negative hit or miss. Expired
+ * entries are dropped.
+ *
+ * @return The entry, or NULL on miss
+ */
+uvhttp_open_file_t* uvhttp_open_file_cache_find(uvhttp_open_file_cache_t* cache,
+                                                const char* key);
+
+/**
+ * uvhttp_open_file_cache_find without counting or expiring, for a miss
+ * that is filling in its entry.
+ */
+uvhttp_open_file_t* uvhttp_open_file_cache_peek(uvhttp_open_file_cache_t* cache,
+                                                const char* key);
+
+/**
+ * Remember that key resolved to the regular file path described by st.
+ * Replaces any entry for key.
+ *
+ * @param loop Loop watching the directories of key and path
+ * @param key Requested path
+ * @param path Resolved path
+ * @return The entry (has_gz -1, no descriptors), or NULL when out of memory
+ */
+uvhttp_open_file_t* uvhttp_open_file_cache_put(uvhttp_open_file_cache_t* cache,
+                                               uv_loop_t* loop, const char* key,
+                                               const char* path,
+                                               const uv_stat_t* st);
+
+/**
+ * Remember that key names no servable file (missing, outside the root, not
+ * a regular file). Replaces any entry for key.
+ */
+uvhttp_open_file_t* uvhttp_open_file_cache_put_negative(
+    uvhttp_open_file_cache_t* cache, uv_loop_t* loop, const char* key);
+
+/**
+ * Keep a duplicate of fd, the descriptor of entry's file (or, with gz, of
+ * its .gz variant), unless the descriptor budget is spent or one is kept
+ * already. The caller keeps fd.
+ *
+ * @return 1 if kept
+ */
+int uvhttp_open_file_cache_keep_fd(uvhttp_open_file_cache_t* cache,
+                                   uvhttp_open_file_t* entry, int gz,
+                                   uv_file fd);
+
+/**
+ * Drop every entry (without counting invalidations).
+ */
+void uvhttp_open_file_cache_clear(uvhttp_open_file_cache_t* cache);
+
+/**
+ * Counters and sizes.
+ *
+ * @param cache Cache to inspect (NULL gives zeroes)
+ * @param stats Output
+ */
+void uvhttp_open_file_cache_get_stats(uvhttp_open_file_cache_t* cache,
+                                      uvhttp_open_file_cache_stats_t* stats);
+
+#endif /* UVHTTP_FEATURE_STATIC_FILES */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UVHTTP_OPEN_FILE_CACHE_H */
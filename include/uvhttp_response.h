@@ -118,6 +118,21 @@ uvhttp_error_t uvhttp_response_send_raw(const char* data, size_t length,
                                         void* client,
                                         uvhttp_response_t* response);
 
+/* Called once a uvhttp_response_send_iov write no longer needs its buffers */
+typedef void (*uvhttp_response_release_cb)(void* data);
+
+/* Send a complete response (status line, headers and body) that is already
+ * serialized in bufs, without copying it: bufs must stay valid until
+ * release(data) is called, after the write completes. Marks the response
+ * sent and handles keep-alive like uvhttp_response_send. On error release
+ * is not called, and nothing was written unless the response is marked sent
+ * (a TLS record failed after the first). */
+uvhttp_error_t uvhttp_response_send_iov(uvhttp_response_t* response,
+                                        const uv_buf_t* bufs,
+                                        unsigned int nbufs,
+                                        uvhttp_response_release_cb release,
+                                        void* data);
+
 /* ============ Compression API ============ */
 #if UVHTTP_FEATURE_COMPRESSION
 /**
@@ -162,6 +177,20 @@ uvhttp_error_t uvhttp_response_set_compress_algorithm(uvhttp_response_t* respons
  */
 uvhttp_error_t uvhttp_response_set_compress_threshold(uvhttp_response_t* response,
                                                        size_t threshold);
+
+/**
+ * @brief Compress input into a gzip stream (RFC 1952)
+ *
+ * @param input Data to compress (input_len > 0)
+ * @param input_len Data length
+ * @param output Output parameter, receives the stream (free with uvhttp_free)
+ * @param output_len Output parameter, receives the stream length
+ * @return uvhttp_error_t UVHTTP_OK on success, otherwise an error code
+ *
+ * @note Thread-safe: the static file service runs it on the thread pool
+ */
+uvhttp_error_t uvhttp_compress_gzip(const char* input, size_t input_len,
+                                    char** output, size_t* output_len);
 #else
 /* 零开销空实现：编译期优化完全移除压缩相关代码 */
 static inline uvhttp_error_t uvhttp_response_set_compress(uvhttp_response_t* response, 
@@ -4,8 +4,10 @@
 #include "uvhttp_common.h"
 #include "uvhttp_constants.h"
 #include "uvhttp_error.h"
+#include "uvhttp_middleware.h"
 #include "uvhttp_platform.h"
 #include "uvhttp_request.h"
+#include "uvhttp_router_frozen.h"
 
 #include <assert.h>
 #include <stddef.h>
@@ -31,34 +33,90 @@ typedef struct {
     char value[MAX_PARAM_VALUE_LEN];
 } uvhttp_param_t;
 
-// Route match result
+// Route parameter captured by a match: the name is a slice of the route's
+// name table (match->param_names), the value a slice of the matched path
+typedef struct {
+    uint16_t name_offset;  /* into match->param_names */
+    uint16_t name_len;     /* name length */
+    uint32_t value_offset; /* into match->path */
+    uint32_t value_len;    /* raw (still percent-encoded) value length */
+} uvhttp_param_slice_t;
+
+// Route match result - refers into the path passed to uvhttp_router_match
+// and into the router, so it is valid while both are unchanged
 typedef struct {
     uvhttp_request_handler_t handler;
-    uvhttp_param_t params[MAX_PARAMS];
+    const char* path;        /* matched path */
+    const char* param_names; /* route's parameter name table */
+    uvhttp_param_slice_t params[MAX_PARAMS];
     size_t param_count;
+    const uvhttp_middleware_handler_t* middleware; /* uvhttp_router_use chain */
+    size_t middleware_count;
 } uvhttp_route_match_t;
 
-// Route node - optimized for CPU cache (128 bytes = 2 cache lines)
+/* Number of uvhttp_method_t values; endpoints keep one handler per method */
+#define UVHTTP_ROUTE_METHOD_COUNT (UVHTTP_PATCH + 1)
+
+/* Node index meaning "no node" / "no endpoint" */
+#define UVHTTP_ROUTE_NONE UINT32_MAX
+
+/* Route node kinds */
+#define UVHTTP_ROUTE_NODE_STATIC 0    /* matches prefix byte for byte */
+#define UVHTTP_ROUTE_NODE_PARAM 1     /* ":name" - one non-empty segment */
+#define UVHTTP_ROUTE_NODE_CATCH_ALL 2 /* "*name" - the rest of the path */
+
+// Route node - path-compressed radix tree node, indices into node_pool.
+// Static children have distinct first bytes and are kept sorted by them in
+// indices[], so a lookup is one binary search per node. Parameter and
+// catch-all children are held apart and tried after the static child.
 typedef struct uvhttp_route_node {
-    /* Cache line 1: Hot path fields (64 bytes) */
-    uvhttp_method_t method;           /* 4 bytes - HTTP method */
-    uvhttp_request_handler_t handler; /* 8 bytes - Request handler */
-    size_t child_count;               /* 8 bytes - Number of children */
-    int is_param;                     /* 4 bytes - Is parameter node */
-    uint8_t segment_len;              /* 1 byte - Segment length */
-    uint8_t param_name_len;           /* 1 byte - Parameter name length */
-    uint16_t _padding1;               /* 2 bytes - Padding to 32 bytes */
-    uint32_t child_indices[12];       /* 48 bytes - Compact child storage */
-
-    /* Cache line 2: Variable length data (64 bytes) */
-    char segment_data[32];    /* 32 bytes - Path segment */
-    char param_name_data[32]; /* 32 bytes - Parameter name */
+    /* Cache line 1: Hot path fields */
+    char* prefix;             /* 8 bytes - static bytes (not terminated) */
+    uint8_t* indices;         /* 8 bytes - first byte of each static child */
+    uint32_t* children;       /* 8 bytes - static children, same order */
+    uint32_t prefix_len;      /* 4 bytes - prefix length */
+    uint32_t child_count;     /* 4 bytes - number of static children */
+    uint32_t param_child;     /* 4 bytes - ":name" child or NONE */
+    uint32_t catch_all_child; /* 4 bytes - "*name" child or NONE */
+    uint32_t endpoint;        /* 4 bytes - route ending here or NONE */
+    uint32_t child_capacity;  /* 4 bytes - children/indices capacity */
+    uint8_t kind;             /* 1 byte - UVHTTP_ROUTE_NODE_* */
+    uint8_t _padding1[15];    /* 15 bytes - Padding to 64 bytes */
 } uvhttp_route_node_t;
 
+// Route endpoint - handlers of the route patterns ending at one node.
+// Parameter names belong to the endpoint, not the tree, so "/a/:id" and
+// "/a/:name/x" share a node; they are kept per method next to the handler,
+// so GET "/u/:id" and DELETE "/u/:uid" each read their own names.
+typedef struct {
+    /* per method; handlers[UVHTTP_ANY] serves methods without their own */
+    uvhttp_request_handler_t handlers[UVHTTP_ROUTE_METHOD_COUNT];
+    /* "name\0name\0..." in path order, per method */
+    char* param_names[UVHTTP_ROUTE_METHOD_COUNT];
+    uint8_t param_counts[UVHTTP_ROUTE_METHOD_COUNT]; /* names per method */
+    uint32_t chain; /* middleware chain id (uvhttp_router_use) */
+} uvhttp_route_endpoint_t;
+
+// Route match cache (UVHTTP_FEATURE_ROUTER_MATCH_CACHE)
+typedef struct uvhttp_router_match_cache uvhttp_router_match_cache_t;
+
+// Route match cache counters
+typedef struct {
+    uint64_t hits;          /* lookups answered from the cache */
+    uint64_t misses;        /* lookups that walked the routes */
+    uint64_t evictions;     /* entries replaced by a different path */
+    uint64_t invalidations; /* times a route change emptied the cache */
+    size_t capacity;        /* slots; 0 when the cache is not built in */
+} uvhttp_router_match_cache_stats_t;
+
+// Middleware registered with uvhttp_router_use, flattened per route
+typedef struct uvhttp_router_middleware uvhttp_router_middleware_t;
+
 // Array routing structure
 typedef struct {
     char path[MAX_ROUTE_PATH_LEN];
     uvhttp_method_t method;
+    uint32_t chain; /* middleware chain id (uvhttp_router_use) */
     uvhttp_request_handler_t handler;
 } array_route_t;
 
@@ -66,14 +124,19 @@ typedef struct {
 struct uvhttp_router {
     /* Hot path fields (frequently accessed) - optimize memory locality */
     int use_trie;       /* 4 bytes - whether to use Trie */
+    int frozen_partial; /* 4 bytes - frozen table misses go on to the tree */
     size_t route_count; /* 8 bytes - total route count */
+    uvhttp_router_frozen_t* frozen; /* 8 bytes - static routes, once frozen */
+    uvhttp_router_match_cache_t* match_cache; /* 8 bytes - recent matches */
 
-    /* Trie routing related (8-byte aligned) - compact node pool */
+    /* Radix tree routing related (8-byte aligned) - compact node pool */
     uvhttp_route_node_t* node_pool; /* 8 bytes - Compact node pool */
     uint32_t root_index;            /* 4 bytes - Root node index */
     uint32_t node_pool_size;        /* 4 bytes - Pool capacity */
     uint32_t node_pool_used;        /* 4 bytes - Pool usage */
-    uint32_t _padding1;             /* 4 bytes - Padding */
+    uint32_t endpoint_count;        /* 4 bytes - Endpoints in use */
+    uvhttp_route_endpoint_t* endpoints; /* 8 bytes - Route endpoints */
+    size_t endpoint_capacity;           /* 8 bytes - Endpoint capacity */
 
     /* Array routing related (8-byte aligned) */
     array_route_t* array_routes; /* 8 bytes */
@@ -90,6 +153,9 @@ struct uvhttp_router {
     /* Fallback routing support (8-byte aligned) */
     void* fallback_context;                    /* 8 bytes */
     uvhttp_request_handler_t fallback_handler; /* 8 bytes */
+
+    /* Middleware pipelines, NULL until uvhttp_router_use */
+    uvhttp_router_middleware_t* middleware; /* 8 bytes */
 };
 
 typedef struct uvhttp_router uvhttp_router_t;
@@ -119,7 +185,13 @@ UVHTTP_CHECK_ALIGNMENT(uvhttp_router_t, route_count, UVHTTP_SIZE_T_ALIGNMENT);
 uvhttp_error_t uvhttp_router_new(uvhttp_router_t** router);
 void uvhttp_router_free(uvhttp_router_t* router);
 
-/* Route addition (supports HTTP methods) */
+/* Route addition (supports HTTP methods)
+ *
+ * A segment starting with ':' captures one path segment, and a final segment
+ * starting with '*' ("*name" or a bare "*") captures the rest of the path,
+ * possibly empty. Static text wins over a parameter, and a parameter over a catch-all; matching
+ * backtracks when the preferred branch fails deeper down. Adding the same
+ * pattern and method again replaces the handler. */
 uvhttp_error_t uvhttp_router_add_route(uvhttp_router_t* router,
                                        const char* path,
                                        uvhttp_request_handler_t handler);
@@ -128,10 +200,51 @@ uvhttp_error_t uvhttp_router_add_route_method(uvhttp_router_t* router,
                                               uvhttp_method_t method,
                                               uvhttp_request_handler_t handler);
 
+/* Freeze the route table
+ *
+ * Compiles every static route (no ":name" or "*name") into a minimal
+ * perfect hash, so looking one up costs one hash and one memcmp; routes with
+ * parameters are still matched by the tree. Afterwards adding routes fails
+ * with UVHTTP_ERROR_ROUTER_FROZEN. Call once after registering all routes;
+ * calling it again does nothing. */
+uvhttp_error_t uvhttp_router_freeze(uvhttp_router_t* router);
+
+/* Route match cache statistics
+ *
+ * With UVHTTP_FEATURE_ROUTER_MATCH_CACHE every router keeps a direct-mapped
+ * cache of recent matches in front of the tree, keyed by method and path;
+ * adding a route empties it. Without the feature all counters are zero.
+ * Hit rate is hits / (hits + misses). */
+uvhttp_error_t uvhttp_router_get_match_cache_stats(
+    const uvhttp_router_t* router, uvhttp_router_match_cache_stats_t* stats);
+
 /* Route lookup */
 uvhttp_request_handler_t uvhttp_router_find_handler(
     const uvhttp_router_t* router, const char* path, const char* method);
 
+/* Attach middleware to a group of routes
+ *
+ * middleware runs before the handler of every route, existing or added
+ * later, whose pattern lies under prefix at a segment boundary: "/api"
+ * covers "/api", "/api/users" and "/api/:id" but not "/apix" or "/:any".
+ * A NULL, "" or "/" prefix covers every route. Requests no route matches
+ * (static files, fallback, 404) run the middleware whose prefix covers
+ * their path, ignoring the query and empty or "." segments, so "/admin"
+ * also guards files served under it. Middleware run in registration order.
+ * Each route's chain is flattened when it is registered, so a route lookup
+ * does no prefix matching.
+ * Not allowed after uvhttp_router_freeze (UVHTTP_ERROR_ROUTER_FROZEN). */
+uvhttp_error_t uvhttp_router_use(uvhttp_router_t* router, const char* prefix,
+                                 uvhttp_middleware_handler_t middleware);
+
+/* Route lookup with the route's middleware chain: like
+ * uvhttp_router_find_handler, and *middleware / *middleware_count receive
+ * the chain to run first (NULL / 0 if none). Run it with
+ * uvhttp_middleware_start(); the chain is valid until the router changes. */
+uvhttp_request_handler_t uvhttp_router_find_pipeline(
+    const uvhttp_router_t* router, const char* path, const char* method,
+    const uvhttp_middleware_handler_t** middleware, size_t* middleware_count);
+
 /* Binary data route — for embedded devices without a filesystem.
  * Registers a route that returns a static binary blob with the given
  * MIME type. The data pointer must remain valid for the lifetime of
@@ -148,6 +261,27 @@ uvhttp_error_t uvhttp_router_match(const uvhttp_router_t* router,
                                    const char* path, const char* method,
                                    uvhttp_route_match_t* match);
 
+/* Match parameter access
+ *
+ * uvhttp_route_match_param returns the raw value of parameter name as it
+ * appears in the path (not terminated, not decoded) and stores its length in
+ * *len, or returns NULL if the route has no such parameter. */
+const char* uvhttp_route_match_param(const uvhttp_route_match_t* match,
+                                     const char* name, size_t* len);
+
+/* Name of the index-th parameter in path order (not terminated), or NULL */
+const char* uvhttp_route_match_param_name(const uvhttp_route_match_t* match,
+                                          size_t index, size_t* len);
+
+/* Percent-decode the value of parameter name into buf and terminate it.
+ * Returns UVHTTP_ERROR_NOT_FOUND if there is no such parameter and
+ * UVHTTP_ERROR_BUFFER_TOO_SMALL if the decoded value and its terminator do
+ * not fit; values are never truncated. out_len (optional) receives the
+ * decoded length. */
+uvhttp_error_t uvhttp_route_match_param_copy(const uvhttp_route_match_t* match,
+                                             const char* name, char* buf,
+                                             size_t buf_size, size_t* out_len);
+
 /* Parameter parsing */
 uvhttp_error_t uvhttp_parse_path_params(const char* path,
                                         uvhttp_param_t* params,
@@ -0,0 +1,79 @@
+/**
+ * @file uvhttp_router_frozen.h
+ * @brief Minimal perfect hash table of static routes (uvhttp_router_freeze)
+ *
+ * Built once from a fixed set of static paths. Every path owns exactly one
+ * slot, found with one xxhash64 of the path, a per-bucket pilot and one
+ * memcmp against the key blob; each slot holds one handler per method.
+ *
+ * @note Used by both router backends (uvhttp_router.c and
+ *   uvhttp_router_cache.c); applications call uvhttp_router_freeze().
+ * @note The table is immutable once built and safe to read concurrently.
+ */
+
+#ifndef UVHTTP_ROUTER_FROZEN_H
+#define UVHTTP_ROUTER_FROZEN_H
+
+#include "uvhttp_error.h"
+#include "uvhttp_request.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct uvhttp_router_frozen uvhttp_router_frozen_t;
+
+/**
+ * Create an empty table to add routes to.
+ *
+ * @param frozen Output parameter, receives the table
+ * @return UVHTTP_OK on success, otherwise an error code
+ */
+uvhttp_error_t uvhttp_router_frozen_new(uvhttp_router_frozen_t** frozen);
+
+/**
+ * Release a table (may be NULL).
+ */
+void uvhttp_router_frozen_free(uvhttp_router_frozen_t* frozen);
+
+/**
+ * Add a static route with its middleware chain id. The path is copied.
+ * Adding a path and method again replaces the handler. Not allowed after
+ * uvhttp_router_frozen_build().
+ */
+uvhttp_error_t uvhttp_router_frozen_add(uvhttp_router_frozen_t* frozen,
+                                        const char* path, size_t path_len,
+                                        uvhttp_method_t method,
+                                        uvhttp_request_handler_t handler,
+                                        uint32_t chain);
+
+/**
+ * Compute the perfect hash over the added routes.
+ *
+ * @return UVHTTP_OK on success, UVHTTP_ERROR_OUT_OF_MEMORY, or
+ *   UVHTTP_ERROR_ROUTER_INIT if no hash function could be found
+ */
+uvhttp_error_t uvhttp_router_frozen_build(uvhttp_router_frozen_t* frozen);
+
+/**
+ * Look up path for method; the UVHTTP_ANY handler serves methods without
+ * their own. Returns NULL if the path is not in the table. chain (optional)
+ * receives the path's middleware chain id when the path is found.
+ */
+uvhttp_request_handler_t uvhttp_router_frozen_lookup(
+    const uvhttp_router_frozen_t* frozen, const char* path, size_t path_len,
+    uvhttp_method_t method, uint32_t* chain);
+
+/**
+ * Number of distinct paths in the table.
+ */
+size_t uvhttp_router_frozen_count(const uvhttp_router_frozen_t* frozen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UVHTTP_ROUTER_FROZEN_H */
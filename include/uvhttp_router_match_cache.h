@@ -0,0 +1,73 @@
+/**
+ * @file uvhttp_router_match_cache.h
+ * @brief Direct-mapped cache of recent route matches
+ *
+ * Maps (method, path) to the resolved handler, the route's parameter name
+ * table, its middleware chain and the captured parameter slices, so repeated requests for the same
+ * parameterized path skip the tree walk. One xxhash64 picks the slot; the
+ * stored path is compared in full, so a hit never depends on the hash alone.
+ *
+ * @note Used by both router backends when UVHTTP_FEATURE_ROUTER_MATCH_CACHE
+ *   is enabled; applications only read uvhttp_router_get_match_cache_stats().
+ * @note Cached matches point into the router, so the backend must call
+ *   uvhttp_router_match_cache_clear() whenever its routes change.
+ * @note Lookups update the cache: one event loop thread per router.
+ */
+
+#ifndef UVHTTP_ROUTER_MATCH_CACHE_H
+#define UVHTTP_ROUTER_MATCH_CACHE_H
+
+#include "uvhttp_error.h"
+#include "uvhttp_router.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Create a cache with at least capacity slots (rounded up to a power of two).
+ *
+ * @param capacity Number of slots, must be non-zero
+ * @param cache Output parameter, receives the cache
+ * @return UVHTTP_OK on success, otherwise an error code
+ */
+uvhttp_error_t uvhttp_router_match_cache_new(
+    size_t capacity, uvhttp_router_match_cache_t** cache);
+
+/**
+ * Release a cache (may be NULL).
+ */
+void uvhttp_router_match_cache_free(uvhttp_router_match_cache_t* cache);
+
+/**
+ * Drop every entry (may be NULL). Counts one invalidation if anything was
+ * cached, so clearing on every route added at startup costs nothing.
+ */
+void uvhttp_router_match_cache_clear(uvhttp_router_match_cache_t* cache);
+
+/**
+ * Look up path for method. On a hit, fills match->handler, param_names,
+ * params, param_count and the middleware chain (match->path is left to the
+ * caller) and returns 1; returns 0 on a miss.
+ */
+int uvhttp_router_match_cache_get(uvhttp_router_match_cache_t* cache,
+                                  const char* path, size_t path_len,
+                                  uvhttp_method_t method,
+                                  uvhttp_route_match_t* match);
+
+/**
+ * Remember a successful match of path for method. Matches of long paths or
+ * with many parameters are not stored.
+ */
+void uvhttp_router_match_cache_put(uvhttp_router_match_cache_t* cache,
+                                   const char* path, size_t path_len,
+                                   uvhttp_method_t method,
+                                   const uvhttp_route_match_t* match);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UVHTTP_ROUTER_MATCH_CACHE_H */
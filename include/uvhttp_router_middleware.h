@@ -0,0 +1,100 @@
+/**
+ * @file uvhttp_router_middleware.h
+ * @brief Middleware registered per route prefix (uvhttp_router_use)
+ *
+ * Keeps the uvhttp_router_use() registrations and flattens them into one
+ * handler array per distinct chain. Every route stores the id of its chain,
+ * resolved from the route's leading static text when the route or the
+ * middleware is registered, so a lookup hands back the chain without any
+ * prefix matching. Routes with equal chains share one id.
+ *
+ * @note Used by both router backends; chain id UVHTTP_ROUTE_CHAIN_NONE (0)
+ *   is always the empty chain.
+ * @note Chain arrays move when chains are added; pointers obtained from
+ *   uvhttp_router_middleware_chain() are valid until the router changes.
+ */
+
+#ifndef UVHTTP_ROUTER_MIDDLEWARE_H
+#define UVHTTP_ROUTER_MIDDLEWARE_H
+
+#include "uvhttp_error.h"
+#include "uvhttp_middleware.h"
+#include "uvhttp_router.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Chain id of routes no middleware applies to */
+#define UVHTTP_ROUTE_CHAIN_NONE 0
+
+/**
+ * Create a registry with no middleware.
+ *
+ * @param middleware Output parameter, receives the registry
+ * @return UVHTTP_OK on success, otherwise an error code
+ */
+uvhttp_error_t uvhttp_router_middleware_new(
+    uvhttp_router_middleware_t** middleware);
+
+/**
+ * Release a registry (may be NULL).
+ */
+void uvhttp_router_middleware_free(uvhttp_router_middleware_t* middleware);
+
+/**
+ * Register handler for routes under prefix (NULL or "" means every route).
+ * Resolved chains are dropped, so the caller must resolve every route again.
+ *
+ * @return UVHTTP_OK, UVHTTP_ERROR_INVALID_PARAM for a prefix that does not
+ *   start with '/' or contains ':', '*' or '?', or UVHTTP_ERROR_OUT_OF_MEMORY
+ */
+uvhttp_error_t uvhttp_router_middleware_add(
+    uvhttp_router_middleware_t* middleware, const char* prefix,
+    uvhttp_middleware_handler_t handler);
+
+/**
+ * Chain id for a route whose patterns all start with lead[0..lead_len) (the
+ * text before the first ":name" or "*name"): the middleware whose prefix is
+ * a whole-segment prefix of lead, in registration order.
+ */
+uvhttp_error_t uvhttp_router_middleware_resolve(
+    uvhttp_router_middleware_t* middleware, const char* lead,
+    size_t lead_len, uint32_t* chain);
+
+/**
+ * Chain id for a request for path no route matched (static files,
+ * fallback, 404): the middleware whose prefix covers path, with empty and
+ * "." segments and the query left out, as resolved for the longest such
+ * prefix when it was registered.
+ */
+uint32_t uvhttp_router_middleware_unmatched(
+    const uvhttp_router_middleware_t* middleware, const char* path);
+
+/**
+ * Handlers of chain and their count, or NULL and 0 for an empty chain.
+ */
+const uvhttp_middleware_handler_t* uvhttp_router_middleware_chain(
+    const uvhttp_router_middleware_t* middleware, uint32_t chain,
+    size_t* count);
+
+/* Length of the static text before the first ":name" or "*name" segment */
+static inline size_t uvhttp_route_lead_len(const char* pattern) {
+    size_t i = 0;
+    for (; pattern[i]; i++) {
+        if ((pattern[i] == ':' || pattern[i] == '*') &&
+            (i == 0 || pattern[i - 1] == '/')) {
+            break;
+        }
+    }
+    return i;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UVHTTP_ROUTER_MIDDLEWARE_H */
@@ -32,20 +32,51 @@ typedef struct uvhttp_tls_context uvhttp_tls_context_t;
 #if UVHTTP_FEATURE_WEBSOCKET
 typedef struct uvhttp_ws_connection uvhttp_ws_connection_t;
 
+struct ws_topic;
+
+/* Topic a connection is subscribed to, and the connection's slot in that
+ * topic's member array */
+typedef struct {
+    struct ws_topic* topic;
+    uint32_t slot;
+} ws_topic_ref_t;
+
 /* WebSocket connection node */
 typedef struct ws_connection_node {
     uvhttp_ws_connection_t* ws_conn;
-    char path[4096];
     uint64_t last_activity;  /* lastwhen(seconds) */
     uint64_t last_ping_sent; /* lastsend Ping when(seconds) */
     int ping_pending;        /* usependinghandle Ping */
-    struct ws_connection_node* next;
+    uint32_t index;          /* slot in manager->connections */
+    ws_topic_ref_t* topics;  /* subscribed topics (upgrade path first) */
+    uint32_t topic_count;
+    uint32_t topic_capacity;
 } ws_connection_node_t;
 
+/* Topic subscriber: the node and the index of its matching ws_topic_ref_t */
+typedef struct {
+    ws_connection_node_t* node;
+    uint32_t ref;
+} ws_topic_member_t;
+
+/* Interned topic (upgrade paths are topics too) with a dense member array */
+typedef struct ws_topic {
+    uint64_t hash; /* xxhash of name */
+    char* name;
+    size_t name_len;
+    ws_topic_member_t* members;
+    uint32_t count;
+    uint32_t capacity;
+} ws_topic_t;
+
 /* WebSocket connection manager */
 typedef struct {
-    ws_connection_node_t* connections; /* Connection */
-    int connection_count;              /* Connectioncount */
+    ws_connection_node_t** connections; /* dense, every connection */
+    int connection_count;               /* Connectioncount */
+    uint32_t connection_capacity;
+    ws_topic_t** topic_table;  /* open addressing by topic hash */
+    uint32_t topic_table_size; /* power of two, 0 until first topic */
+    uint32_t topic_count;
     uv_timer_t timeout_timer;          /* Timeoutwhen */
     uv_timer_t heartbeat_timer;        /* when */
     int timeout_seconds;               /* Timeoutwhen(seconds) */
@@ -154,11 +185,13 @@ struct uvhttp_server {
 
     /* ========== Cache line 6 (320-383 bytes): protocol upgrade ========== */
     void* protocol_registry; /* 8 bytes - Protocol upgrade registry */
+    void* sse_manager;       /* 8 bytes - Server-Sent Events streams */
+    void* vhosts;            /* 8 bytes - Virtual hosts (uvhttp_vhost.h) */
 #if UVHTTP_FEATURE_COMPRESSION
     void* gzip_cache; /* 8 bytes - Gzip compression cache (uvhttp_gzip_cache_t*) */
-    int _padding6[12]; /* 48bytes - paddingto64bytes */
+    int _padding6[8]; /* 32bytes - paddingto64bytes */
 #else
-    int _padding6[14];       /* 56bytes - paddingto64bytes */
+    int _padding6[10];       /* 40bytes - paddingto64bytes */
 #endif
     /* Cache line 6 total: 64 bytes */
 };
@@ -424,6 +457,18 @@ uvhttp_error_t uvhttp_server_ws_broadcast(uvhttp_server_t* server,
 uvhttp_error_t uvhttp_server_ws_close_all(uvhttp_server_t* server,
                                           const char* path);
 
+/* Topics: every connection starts subscribed to its upgrade path. Broadcast,
+ * close_all and get_connection_count_by_path accept any topic name and cost
+ * O(subscribers). Callbacks fired during a broadcast must not subscribe or
+ * unsubscribe connections on the topic being broadcast. */
+uvhttp_error_t uvhttp_server_ws_subscribe(uvhttp_server_t* server,
+                                          uvhttp_ws_connection_t* ws_conn,
+                                          const char* topic);
+
+uvhttp_error_t uvhttp_server_ws_unsubscribe(uvhttp_server_t* server,
+                                            uvhttp_ws_connection_t* ws_conn,
+                                            const char* topic);
+
 /* internalFunction( uvhttp_connection )
  *
  * NOTE: these functions borrow the ws_conn pointer — the library never
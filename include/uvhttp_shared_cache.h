@@ -0,0 +1,236 @@
+/**
+ * @file uvhttp_shared_cache.h
+ * @brief Static file cache shared by worker loops, sharded and thread-safe
+ *
+ * One instance can be attached to the static contexts of every worker loop
+ * (uvhttp_static_set_shared_cache) so that a hot file is held once per
+ * process instead of once per loop. Entries are spread over lock-striped
+ * shards selected by xxhash of the key, each an LRU cache manager of its
+ * own, so concurrent loops only contend when they hit the same shard; the
+ * critical sections do no allocation or I/O.
+ *
+ * A hit hands out references to the entry's content and pre-rendered head
+ * buffers (counted atomically) and a copy of its metadata, so an entry
+ * evicted by another loop stays valid under the writes still sending it.
+ *
+ * @note Compiled together with the static file module
+ *   (UVHTTP_FEATURE_STATIC_FILES).
+ * @note Thread-safe: every public function may be called from any loop.
+ * @note The cache must outlive every static context it is attached to.
+ */
+
+#ifndef UVHTTP_SHARED_CACHE_H
+#define UVHTTP_SHARED_CACHE_H
+
+#if UVHTTP_FEATURE_STATIC_FILES
+
+#    include "uvhttp_error.h"
+#    include "uvhttp_lru_cache.h"
+
+#    include <stddef.h>
+#    include <time.h>
+
+#    ifdef __cplusplus
+extern "C" {
+#    endif
+
+/* Default lock stripe count */
+#    define UVHTTP_SHARED_CACHE_DEFAULT_SHARDS 16
+
+typedef struct uvhttp_shared_cache uvhttp_shared_cache_t;
+
+/* A cache hit, valid until uvhttp_cache_hit_release: the buffers are held,
+ * the metadata copied */
+typedef struct uvhttp_cache_hit {
+    uvhttp_cache_buffer_t* buffer; /* the content */
+    uvhttp_cache_buffer_t* head;   /* as cache_entry_t.head; may be NULL */
+    size_t head_keepalive_length;
+    const char* mime_type; /* interned, valid as long as the cache */
+    time_t last_modified;
+    char etag[UVHTTP_CACHE_ETAG_SIZE];
+    /* as cache_entry_t: the encoded variants made so far, held too */
+    uvhttp_cache_variant_t variants[UVHTTP_CACHE_ENCODING_COUNT];
+    unsigned encodings_tried;
+} uvhttp_cache_hit_t;
+
+/**
+ * Create a shared cache.
+ *
+ * @param shard_count Number of lock stripes, rounded up to a power of two
+ *   (0 = UVHTTP_SHARED_CACHE_DEFAULT_SHARDS)
+ * @param max_memory_usage Memory budget in bytes, split evenly across shards
+ * @param max_entries Entry budget, split evenly across shards
+ * @param cache_ttl Entry lifetime in seconds (0 = never expires)
+ * @param cache Output parameter, receives the created cache
+ * @return UVHTTP_OK on success, otherwise an error code
+ */
+uvhttp_error_t uvhttp_shared_cache_create(size_t shard_count,
+                                          size_t max_memory_usage,
+                                          int max_entries, int cache_ttl,
+                                          uvhttp_shared_cache_t** cache);
+
+/**
+ * Release a shared cache and its entries; buffers still held by hits or
+ * writes are freed with their last reference.
+ *
+ * @param cache Cache to release (may be NULL)
+ */
+void uvhttp_shared_cache_free(uvhttp_shared_cache_t* cache);
+
+/**
+ * Set the policy of every shard (see uvhttp_lru_cache_set_policy).
+ *
+ * @return UVHTTP_OK on success, otherwise an error code
+ */
+uvhttp_error_t uvhttp_shared_cache_set_policy(uvhttp_shared_cache_t* cache,
+                                              uvhttp_cache_policy_t policy);
+
+/**
+ * Look up key.
+ *
+ * @param cache Cache to query
+ * @param key Cache key
+ * @param hit Output parameter, filled on a hit; release it when done
+ * @return UVHTTP_OK on a hit, UVHTTP_ERROR_NOT_FOUND on a miss or expiry,
+ *   otherwise an error code
+ */
+uvhttp_error_t uvhttp_shared_cache_get(uvhttp_shared_cache_t* cache,
+                                       const char* key,
+                                       uvhttp_cache_hit_t* hit);
+
+/**
+ * Whether key has a live entry. Unlike uvhttp_shared_cache_get this counts
+ * no hit or miss and leaves the entry's recency and frequency alone.
+ *
+ * @param cache Cache to query
+ * @param key Cache key
+ * @return 1 if a get of key would hit, otherwise 0
+ */
+int uvhttp_shared_cache_contains(uvhttp_shared_cache_t* cache,
+                                 const char* key);
+
+/**
+ * Fill hit from entry of any cache, taking references to its buffers.
+ * The caller serializes this with changes to entry.
+ *
+ * @param hit Hit to fill; release it when done
+ * @param entry Entry found
+ */
+void uvhttp_cache_hit_init(uvhttp_cache_hit_t* hit,
+                           const cache_entry_t* entry);
+
+/**
+ * Drop the references a hit holds.
+ *
+ * @param hit Hit filled by uvhttp_shared_cache_get (may be NULL)
+ */
+void uvhttp_cache_hit_release(uvhttp_cache_hit_t* hit);
+
+/**
+ * Add or update an entry with a copy of content (made outside the lock).
+ *
+ * @return UVHTTP_OK on success, otherwise an error code (see
+ *   uvhttp_lru_cache_put)
+ */
+uvhttp_error_t uvhttp_shared_cache_put(uvhttp_shared_cache_t* cache,
+                                       const char* key, const char* content,
+                                       size_t content_length,
+                                       const char* mime_type,
+                                       time_t last_modified, const char* etag);
+
+/**
+ * Add or update an entry holding buffer (a reference is taken).
+ *
+ * @return UVHTTP_OK on success, otherwise an error code
+ */
+uvhttp_error_t uvhttp_shared_cache_put_buffer(uvhttp_shared_cache_t* cache,
+                                              const char* key,
+                                              uvhttp_cache_buffer_t* buffer,
+                                              const char* mime_type,
+                                              time_t last_modified,
+                                              const char* etag);
+
+/**
+ * Attach a pre-rendered response head to the entry at key, if it still
+ * holds content (another loop may have replaced or dropped it). Takes over
+ * the caller's reference to head either way.
+ *
+ * @param cache Cache to update
+ * @param key Cache key
+ * @param content The content head describes, as handed out by a hit
+ * @param head Status line and headers, keep-alive variant first
+ * @param keepalive_length Length of the keep-alive variant
+ */
+void uvhttp_shared_cache_set_head(uvhttp_shared_cache_t* cache,
+                                  const char* key,
+                                  const uvhttp_cache_buffer_t* content,
+                                  uvhttp_cache_buffer_t* head,
+                                  size_t keepalive_length);
+
+/**
+ * Claim the making of a variant of the entry at key (see
+ * uvhttp_lru_cache_claim_variant), if it still holds content.
+ *
+ * @return 1 if the caller is to make the variant, 0 otherwise
+ */
+int uvhttp_shared_cache_claim_variant(uvhttp_shared_cache_t* cache,
+                                      const char* key,
+                                      const uvhttp_cache_buffer_t* content,
+                                      uvhttp_cache_encoding_t encoding);
+
+/**
+ * Keep buffer as the variant in encoding of the entry at key (see
+ * uvhttp_lru_cache_set_variant), if it still holds content.
+ */
+void uvhttp_shared_cache_set_variant(uvhttp_shared_cache_t* cache,
+                                     const char* key,
+                                     const uvhttp_cache_buffer_t* content,
+                                     uvhttp_cache_encoding_t encoding,
+                                     uvhttp_cache_buffer_t* buffer);
+
+/**
+ * As uvhttp_shared_cache_set_head, for the variant in encoding that head
+ * describes (head->body): attached only if the entry at key still holds
+ * that variant without a head. Takes over the caller's reference to head.
+ */
+void uvhttp_shared_cache_set_variant_head(uvhttp_shared_cache_t* cache,
+                                          const char* key,
+                                          uvhttp_cache_encoding_t encoding,
+                                          uvhttp_cache_buffer_t* head,
+                                          size_t keepalive_length);
+
+/**
+ * Drop the entry at key.
+ *
+ * @return UVHTTP_OK if removed, UVHTTP_ERROR_NOT_FOUND if absent
+ */
+uvhttp_error_t uvhttp_shared_cache_remove(uvhttp_shared_cache_t* cache,
+                                          const char* key);
+
+/**
+ * Drop every entry.
+ */
+void uvhttp_shared_cache_clear(uvhttp_shared_cache_t* cache);
+
+/**
+ * Drop expired entries.
+ *
+ * @return Number of entries dropped
+ */
+int uvhttp_shared_cache_cleanup_expired(uvhttp_shared_cache_t* cache);
+
+/**
+ * Retrieve statistics summed over the shards; any output may be NULL.
+ */
+void uvhttp_shared_cache_get_stats(uvhttp_shared_cache_t* cache,
+                                   size_t* total_memory_usage,
+                                   int* entry_count, int* hit_count,
+                                   int* miss_count, int* eviction_count);
+
+#    ifdef __cplusplus
+}
+#    endif
+
+#endif /* UVHTTP_FEATURE_STATIC_FILES */
+
+#endif /* UVHTTP_SHARED_CACHE_H */
@@ -0,0 +1,284 @@
+/*
+ * UVHTTP Server-Sent Events
+ * text/event-stream responses (WHATWG HTML, "Server-sent events")
+ */
+
+#if UVHTTP_FEATURE_SSE
+
+#    ifndef UVHTTP_SSE_H
+#        define UVHTTP_SSE_H
+
+#        include "uvhttp_connection.h"
+#        include "uvhttp_error.h"
+#        include "uvhttp_request.h"
+#        include "uvhttp_response.h"
+
+#        include <stddef.h>
+#        include <stdint.h>
+
+#        ifdef __cplusplus
+extern "C" {
+#        endif
+
+struct uvhttp_server;
+
+/* Slow-consumer policy: what a send does once the outbound queue is full */
+typedef enum {
+    UVHTTP_SSE_SLOW_CONSUMER_CLOSE = 0, /* fail the send, close the stream */
+    UVHTTP_SSE_SLOW_CONSUMER_DROP = 1   /* drop the event, keep the stream */
+} uvhttp_sse_slow_consumer_policy_t;
+
+/* Refcounted, pre-encoded event (see uvhttp_sse_event_create) */
+typedef struct uvhttp_sse_event uvhttp_sse_event_t;
+
+struct uvhttp_sse_stream;
+struct uvhttp_sse_out;
+struct uvhttp_sse_write_req;
+struct uvhttp_sse_channel;
+
+typedef void (*uvhttp_sse_on_close_callback)(struct uvhttp_sse_stream* stream);
+
+/* Channel a stream is subscribed to, and the stream's slot in that
+ * channel's member array */
+typedef struct {
+    struct uvhttp_sse_channel* channel;
+    uint32_t slot;
+} uvhttp_sse_channel_ref_t;
+
+/* Open event stream. Owned by the library: it is freed when its connection
+ * closes, right after on_close fires. */
+typedef struct uvhttp_sse_stream {
+    uvhttp_connection_t* conn; /* NULL once the connection is gone */
+    struct uvhttp_server* server;
+    int closing; /* close scheduled after a slow-consumer or write error */
+
+    /* Outbound queue, written through the connection's libuv stream */
+    struct uvhttp_sse_out* send_head;
+    struct uvhttp_sse_out* send_tail;
+    size_t send_queued_bytes;              /* queued + in-flight bytes */
+    struct uvhttp_sse_write_req* send_req; /* in-flight uv_write, or NULL */
+    size_t send_queue_max;                 /* 0 = unbounded */
+    uvhttp_sse_slow_consumer_policy_t slow_consumer_policy;
+
+    /* Last-Event-ID sent by the client, 0 when absent. Subscribing replays
+     * the channel's buffered events newer than this. */
+    uint64_t last_event_id;
+    uint64_t last_write_ms; /* loop time of the last queued event */
+
+    /* Registry state (server SSE manager) */
+    uint32_t index; /* slot in the manager's stream array */
+    uvhttp_sse_channel_ref_t* channels;
+    uint32_t channel_count;
+    uint32_t channel_capacity;
+
+    /* Statistics */
+    uint64_t events_sent;
+    uint64_t events_dropped;
+    uint64_t bytes_sent;
+
+    uvhttp_sse_on_close_callback on_close;
+    void* user_data;
+} uvhttp_sse_stream_t;
+
+/**
+ * @brief Turn the current request into an event stream
+ *
+ * Call from a request handler instead of uvhttp_response_send(). Writes the
+ * response head (200, Content-Type: text/event-stream, Cache-Control:
+ * no-cache, X-Accel-Buffering: no, plus any headers already set on
+ * response), stops the connection's idle timeout and registers the stream
+ * for the server's heartbeat. A numeric Last-Event-ID request header is
+ * kept in stream->last_event_id for uvhttp_sse_subscribe() replay.
+ *
+ * The response must not be sent afterwards; everything else goes through
+ * the stream until the client disconnects or uvhttp_sse_close() is called.
+ *
+ * @param request Request being handled
+ * @param response Its response (not yet sent)
+ * @param stream Output parameter, receives the stream
+ * @return UVHTTP_OK on success, otherwise an error code
+ */
+uvhttp_error_t uvhttp_sse_open(uvhttp_request_t* request,
+                               uvhttp_response_t* response,
+                               uvhttp_sse_stream_t** stream);
+
+/**
+ * @brief Close a stream
+ *
+ * Drops queued events and closes the connection. on_close fires and the
+ * stream is freed during the close; the pointer is invalid afterwards.
+ */
+void uvhttp_sse_close(uvhttp_sse_stream_t* stream);
+
+/**
+ * @brief Set the callback fired when the stream ends (either side)
+ *
+ * The stream is freed right after the callback returns.
+ */
+void uvhttp_sse_set_close_callback(uvhttp_sse_stream_t* stream,
+                                   uvhttp_sse_on_close_callback on_close);
+
+/**
+ * @brief Bound the stream's outbound queue
+ *
+ * Events accepted but not yet written to the socket count against
+ * max_bytes. Past it, DROP refuses the event (events_dropped counts them)
+ * and CLOSE closes the stream. Streams start with
+ * UVHTTP_SSE_DEFAULT_SEND_QUEUE_MAX and the DROP policy.
+ *
+ * @param stream Event stream
+ * @param max_bytes Queue budget in bytes (0 = unbounded)
+ * @param policy Action taken when the budget is exceeded
+ * @return UVHTTP_OK on success, otherwise an error code
+ */
+uvhttp_error_t uvhttp_sse_set_send_queue(
+    uvhttp_sse_stream_t* stream, size_t max_bytes,
+    uvhttp_sse_slow_consumer_policy_t policy);
+
+/**
+ * @brief Bytes accepted for sending but not yet written to the socket
+ */
+size_t uvhttp_sse_get_buffered_amount(const uvhttp_sse_stream_t* stream);
+
+/**
+ * @brief Encode an event once for any number of streams
+ *
+ * The wire form (event:, one data: line per line of data, blank line) is
+ * built here; every send queues a reference instead of a copy. The caller
+ * owns one reference and releases it once it has sent the event
+ * everywhere.
+ *
+ * @param event Event name, or NULL for the default "message" event. Must
+ *              not contain CR or LF.
+ * @param data Event data (may be NULL when len is 0). LF, CRLF and CR all
+ *             start a new data: line.
+ * @param len Data length
+ * @param out Output parameter, receives the event
+ * @return UVHTTP_OK on success, otherwise an error code
+ */
+uvhttp_error_t uvhttp_sse_event_create(const char* event, const char* data,
+                                       size_t len, uvhttp_sse_event_t** out);
+
+/**
+ * @brief Drop a reference to an event (may be NULL)
+ */
+void uvhttp_sse_event_release(uvhttp_sse_event_t* event);
+
+/**
+ * @brief Encoded size of an event in bytes
+ */
+size_t uvhttp_sse_event_size(const uvhttp_sse_event_t* event);
+
+/**
+ * @brief Queue an encoded event on one stream
+ *
+ * @return UVHTTP_OK on success, UVHTTP_ERROR_SSE_SLOW_CONSUMER when the
+ *         queue budget refused it, UVHTTP_ERROR_CONNECTION_BROKEN once
+ *         the stream is closing, otherwise an error code
+ */
+uvhttp_error_t uvhttp_sse_send_event(uvhttp_sse_stream_t* stream,
+                                     uvhttp_sse_event_t* event);
+
+/**
+ * @brief Encode and queue an event on one stream
+ */
+uvhttp_error_t uvhttp_sse_send(uvhttp_sse_stream_t* stream, const char* event,
+                               const char* data, size_t len);
+
+/**
+ * @brief Subscribe a stream to a channel
+ *
+ * When the client resumed with Last-Event-ID, the channel's buffered events
+ * newer than that id are queued first.
+ *
+ * @return UVHTTP_OK on success, UVHTTP_ERROR_ALREADY_EXISTS when already
+ *         subscribed, otherwise an error code
+ */
+uvhttp_error_t uvhttp_sse_subscribe(uvhttp_sse_stream_t* stream,
+                                    const char* channel);
+
+/**
+ * @brief Unsubscribe a stream from a channel
+ *
+ * @return UVHTTP_OK on success, UVHTTP_ERROR_NOT_FOUND when not subscribed
+ */
+uvhttp_error_t uvhttp_sse_unsubscribe(uvhttp_sse_stream_t* stream,
+                                      const char* channel);
+
+/**
+ * @brief Publish an event to every subscriber of a channel
+ *
+ * The event gets the next server-wide id, is encoded once, kept in the
+ * channel's replay ring (the last UVHTTP_SSE_DEFAULT_REPLAY_SIZE events)
+ * and queued by reference on each subscriber. Subscribers whose queue is
+ * full are handled by their slow-consumer policy and do not fail the
+ * publish.
+ *
+ * @param server Server instance
+ * @param channel Channel name
+ * @param event Event name, or NULL
+ * @param data Event data
+ * @param len Data length
+ * @param id Output parameter, receives the event id (may be NULL)
+ * @return UVHTTP_OK on success, otherwise an error code
+ */
+uvhttp_error_t uvhttp_sse_publish(struct uvhttp_server* server,
+                                  const char* channel, const char* event,
+                                  const char* data, size_t len, uint64_t* id);
+
+/**
+ * @brief Number of streams subscribed to a channel
+ */
+int uvhttp_sse_get_channel_count(struct uvhttp_server* server,
+                                 const char* channel);
+
+/**
+ * @brief Number of channels a server keeps, subscribed to or idle
+ */
+int uvhttp_sse_get_channel_total(struct uvhttp_server* server);
+
+/**
+ * @brief Number of open streams on a server
+ */
+int uvhttp_sse_get_stream_count(struct uvhttp_server* server);
+
+/**
+ * @brief Set the heartbeat interval for a server's streams
+ *
+ * One server timer sends a comment line to every stream that has been
+ * quiet for at least interval_ms, keeping proxies from timing the
+ * connection out. 0 disables heartbeats.
+ */
+uvhttp_error_t uvhttp_sse_set_heartbeat_interval(struct uvhttp_server* server,
+                                                 uint64_t interval_ms);
+
+/**
+ * @brief Set how long a channel with no subscribers is kept
+ *
+ * A channel that has had no subscribers and no publishes for timeout_ms
+ * is freed with its replay ring when a new channel is created, so
+ * Last-Event-ID resume only reaches back that far on a quiet channel.
+ * Defaults to UVHTTP_SSE_DEFAULT_CHANNEL_IDLE_TIMEOUT. 0 keeps channels
+ * until the server is freed.
+ */
+uvhttp_error_t uvhttp_sse_set_channel_idle_timeout(
+    struct uvhttp_server* server, uint64_t timeout_ms);
+
+/**
+ * @brief Release a server's SSE state
+ *
+ * Closes every open stream and frees channels and replay rings. Called by
+ * uvhttp_server_free().
+ */
+void uvhttp_sse_server_cleanup(struct uvhttp_server* server);
+
+/* Connection teardown hook: fires on_close and frees the stream */
+void uvhttp_sse_detach(uvhttp_connection_t* conn);
+
+#        ifdef __cplusplus
+}
+#        endif
+
+#    endif /* UVHTTP_SSE_H */
+
+#endif /* UVHTTP_FEATURE_SSE */
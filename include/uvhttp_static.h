@@ -9,6 +9,7 @@
 #    include "uvhttp_constants.h"
 #    include "uvhttp_error.h"
 #    include "uvhttp_middleware.h"
+#    include "uvhttp_open_file_cache.h"
 
 #    include <stddef.h>
 #    include <time.h>
@@ -16,11 +17,13 @@
 /* LRU cache conditional compilation support */
 #    if UVHTTP_FEATURE_LRU_CACHE
 #        include "uvhttp_lru_cache.h"
+#        include "uvhttp_shared_cache.h"
 #    endif
 
 /* Forward declarations */
 typedef struct cache_manager cache_manager_t;
 typedef struct cache_entry cache_entry_t;
+typedef struct uvhttp_shared_cache uvhttp_shared_cache_t;
 
 #    ifdef __cplusplus
 extern "C" {
@@ -32,6 +35,8 @@ typedef struct uvhttp_static_config {
     size_t max_cache_size;      /* Maximum cache size (bytes) */
     size_t sendfile_chunk_size; /* sendfile chunk size (bytes) */
     size_t max_file_size;       /* Maximum file size (bytes) */
+    size_t mmap_cache_size;     /* Bytes of files over 64KB kept mapped
+                                   (0 = off) */
 
     /* 4-byte aligned fields - medium access frequency */
     int cache_ttl;                /* Cache TTL (seconds) */
@@ -42,6 +47,15 @@ typedef struct uvhttp_static_config {
     int enable_etag;              /* Enable ETag */
     int enable_last_modified;     /* Enable Last-Modified */
     int enable_sendfile;          /* Enable sendfile zero-copy optimization */
+    int max_inflight_fs; /* Cache misses read at once (0 = default) */
+    int open_file_cache_size; /* Paths whose lookups are remembered
+                                 (0 = default, < 0 = off) */
+    int open_file_cache_ttl;  /* Seconds a lookup is trusted (0 = default) */
+    int mmap_populate; /* Prefault mappings instead of advising read-ahead */
+    int cache_policy;  /* uvhttp_cache_policy_t of both cache tiers
+                          (0 = LRU) */
+    int compress_cache; /* Keep gzip variants of cached text files for
+                           clients accepting them (0 = off) */
 
     /* String fields - cold path */
     char root_directory[UVHTTP_MAX_FILE_PATH_SIZE];    /* Root directory path */
@@ -50,10 +64,23 @@ typedef struct uvhttp_static_config {
                                                           headers */
 } uvhttp_static_config_t;
 
+/* A cache miss being answered off the loop thread */
+typedef struct uvhttp_static_op uvhttp_static_op_t;
+
 /* Static file serving context */
 typedef struct uvhttp_static_context {
     uvhttp_static_config_t config; /*  */
     cache_manager_t* cache;        /* LRUCachemanage */
+    cache_manager_t* mapped;       /* mapped files, NULL when off */
+    uvhttp_shared_cache_t* shared; /* used instead of cache when set */
+    uvhttp_open_file_cache_t* open_files; /* lookups of cache misses */
+    /* Cache misses: fs_running at a time, the others wait in order */
+    uvhttp_static_op_t* fs_waiting;
+    uvhttp_static_op_t* fs_waiting_tail;
+    int fs_running;
+    int fs_pending; /* running + waiting */
+    int freed;      /* uvhttp_static_free called while misses pending */
+    char root_realpath[UVHTTP_MAX_FILE_PATH_SIZE]; /* resolved on first miss */
 } uvhttp_static_context_t;
 
 /* MIME type mapping entry */
@@ -62,6 +89,12 @@ typedef struct uvhttp_mime_mapping {
     const char* mime_type; /* MIMEclass */
 } uvhttp_mime_mapping_t;
 
+/* One satisfiable byte range of a Range header */
+typedef struct uvhttp_static_range {
+    size_t start;  /* first byte */
+    size_t length; /* bytes from start, at least 1 */
+} uvhttp_static_range_t;
+
 /**
  * createStatic file
  *
@@ -71,6 +104,21 @@ typedef struct uvhttp_mime_mapping {
  */
 uvhttp_error_t uvhttp_static_create(const uvhttp_static_config_t* config,
                                     uvhttp_static_context_t** context);
+/**
+ * Share the in-memory cache with other contexts (typically one per worker
+ * loop): lookups, misses, prewarming, invalidation and clearing go to
+ * shared instead of the context's own cache, so a file is held once per
+ * process. The mapped tier stays per context (its pages are the kernel's
+ * page cache, shared anyway). Configure the shared cache when creating it;
+ * uvhttp_static_set_cache_config only changes the context's own cache.
+ *
+ * @param ctx Static file context
+ * @param shared Cache outliving ctx, or NULL to use the context's own again
+ * @return UVHTTP_OK Success, other values represent Failure
+ */
+uvhttp_error_t uvhttp_static_set_shared_cache(uvhttp_static_context_t* ctx,
+                                              uvhttp_shared_cache_t* shared);
+
 /**
  * set sendfile Configuration parameter
  *
@@ -111,27 +159,52 @@ uvhttp_error_t uvhttp_static_set_cache_config(uvhttp_static_context_t* ctx,
  * releaseStatic file
  *
  * @param ctx Static file
+ * @note With cache misses still in flight, the context is released when the
+ * last of them completes
  */
 void uvhttp_static_free(uvhttp_static_context_t* ctx);
 
 /**
  * handleStatic fileRequest
  *
+ * Cache hits are answered before returning. A miss is answered later, from
+ * uv_fs_* callbacks (stat, open, read or sendfile, close run on the libuv
+ * thread pool), so the loop never waits on the disk.
+ *
  * @param ctx Static file
  * @param request HTTPRequest
- * @param response HTTPResponse
- * @return UVHTTP_OKSuccess, othervaluerepresentsFailure
+ * @param response HTTPResponse (of a connected client)
+ * @return UVHTTP_OK when the request is answered or will be (also with 404,
+ * 413...), othervaluerepresentsFailure and nothing was sent
  */
 uvhttp_result_t uvhttp_static_handle_request(uvhttp_static_context_t* ctx,
                                              void* request, void* response);
 
+/**
+ * uvhttp_static_handle_request, with fallback answering requests for files
+ * that do not exist (or lie outside the root) instead of a 404
+ *
+ * @param fallback May be NULL
+ */
+uvhttp_result_t uvhttp_static_serve(uvhttp_static_context_t* ctx,
+                                    void* request, void* response,
+                                    uvhttp_request_handler_t fallback);
+
+/**
+ * Forget the request of op (its connection is closing); op then only closes
+ * its file. NULL is ignored. Used by the connection.
+ */
+void uvhttp_static_cancel(uvhttp_static_op_t* op);
+
 /**
  * Nginx optimization: Use sendfile zerosendStatic file(strategy)
  *
  * rootFile sizeAutomaticstrategy:
- * -  (< 4KB): Use( sendfile )
- * -  (4KB - 10MB): UseAsynchronous sendfile
- * -  (> 10MB): Usechunked sendfile
+ * -  (<= 64KB): read into the response body
+ * -  (> 64KB): Asynchronous chunked sendfile (reads and writes over TLS)
+ *
+ * The file is stat'ed and opened on the thread pool; a missing file is
+ * answered with 404.
  *
  * @param file_path File path
  * @param response HTTPResponse
@@ -179,6 +252,45 @@ uvhttp_result_t uvhttp_static_prewarm_cache(uvhttp_static_context_t* ctx,
 int uvhttp_static_prewarm_directory(uvhttp_static_context_t* ctx,
                                     const char* dir_path, int max_files);
 
+/* What an asynchronous prewarm did */
+typedef struct {
+    int files;           /* files put into the cache */
+    int skipped;         /* not regular files, or over max_file_size */
+    int failed;          /* files or directories that could not be read */
+    int directories;     /* directories enumerated */
+    size_t bytes;        /* content bytes put into the cache */
+    uint64_t elapsed_ms; /* from the call to the callback */
+} uvhttp_static_prewarm_stats_t;
+
+/* Called on the loop once an asynchronous prewarm is done. status is
+ * UVHTTP_OK, UVHTTP_ERROR_NOT_FOUND if the directory could not be
+ * enumerated, or UVHTTP_ERROR_CANCELLED if ctx was freed meanwhile (ctx
+ * must not be used then) */
+typedef void (*uvhttp_static_prewarm_cb)(
+    uvhttp_static_context_t* ctx, uvhttp_error_t status,
+    const uvhttp_static_prewarm_stats_t* stats, void* data);
+
+/**
+ * Cache prewarm without blocking the loop: enumerate dir_path and its
+ * subdirectories with uv_fs_scandir (symbolic links to directories are not
+ * followed) and read the files on the libuv thread pool, at most
+ * max_inflight_fs at a time. With compress_cache set, gzip variants are
+ * made on the thread pool too. Files are put into the cache on the loop,
+ * as uvhttp_static_prewarm_cache does; on_done follows the last one, so it
+ * can mark the server ready.
+ *
+ * @param ctx Static file context
+ * @param loop Loop to run on (the one ctx serves)
+ * @param dir_path Directory relative to the root ("" or "/" for the root)
+ * @param max_files Most files to read (0 = no limit)
+ * @param on_done Called once when done, unless an error is returned
+ * @param data Passed to on_done
+ * @return UVHTTP_OK if started, otherwise an error code
+ */
+uvhttp_error_t uvhttp_static_prewarm_directory_async(
+    uvhttp_static_context_t* ctx, uv_loop_t* loop, const char* dir_path,
+    int max_files, uvhttp_static_prewarm_cb on_done, void* data);
+
 /**
  * File pathwhether(preventPathtraverse)
  *
@@ -217,6 +329,36 @@ uvhttp_result_t uvhttp_static_generate_etag(const char* file_path,
 int uvhttp_static_check_conditional_request(void* request, const char* etag,
                                             time_t last_modified);
 
+/**
+ * Quality an Accept-Encoding header gives a content coding: the coding's
+ * q-value, else that of "*", else 0 ("identity" is acceptable unless
+ * excluded). Codings compare case-insensitively; a malformed q-value
+ * counts as 0.
+ *
+ * @param accept_encoding Accept-Encoding header value, or NULL
+ * @param coding Content coding ("gzip", "identity", ...)
+ * @return Quality in thousandths, 0 (not acceptable) to 1000
+ */
+int uvhttp_static_accepts_encoding(const char* accept_encoding,
+                                   const char* coding);
+
+/**
+ * Parse a Range header ("bytes=0-499, -500, 9500-") against a
+ * representation of file_size bytes. Ranges are kept in request order,
+ * clamped to the file; those starting past its end are dropped.
+ *
+ * @param header Range header value
+ * @param file_size Size of the representation
+ * @param ranges Output, room for max_ranges entries
+ * @param max_ranges More ranges than this, ranges adding up to more than
+ *   the file (overlaps), or several adding up to more than
+ *   UVHTTP_STATIC_MAX_MULTIPART_SIZE, make the header ignored
+ * @return Number of ranges; 0 when the header is to be ignored (not bytes,
+ *   malformed, too many ranges); -1 when no range is satisfiable (416)
+ */
+int uvhttp_static_parse_range(const char* header, size_t file_size,
+                              uvhttp_static_range_t* ranges, int max_ranges);
+
 /**
  * setStatic fileResponse
  *
@@ -248,6 +390,32 @@ void uvhttp_static_get_cache_stats(uvhttp_static_context_t* ctx,
                                    int* hit_count, int* miss_count,
                                    int* eviction_count);
 
+/**
+ * Open-file cache counters: lookups of cache misses answered without
+ * realpath/stat (hits, negative hits for missing files), and entries
+ * dropped because their files changed. All zero when the cache is off.
+ *
+ * @param ctx Static file context
+ * @param stats Output
+ */
+void uvhttp_static_get_open_file_stats(uvhttp_static_context_t* ctx,
+                                       uvhttp_open_file_cache_stats_t* stats);
+
+/**
+ * Mapped-file tier counters: bytes the tier holds (its mappings, plus
+ * entry overhead and rendered heads; none of it is counted by
+ * uvhttp_static_get_cache_stats), files mapped, and hits answered from a
+ * mapping. All zero when the tier is off.
+ *
+ * @param ctx Static file context
+ * @param mapped_bytes Output
+ * @param entry_count Output
+ * @param hit_count Output
+ */
+void uvhttp_static_get_mapped_stats(uvhttp_static_context_t* ctx,
+                                    size_t* mapped_bytes, int* entry_count,
+                                    int* hit_count);
+
 /**
  * getCacherate
  *
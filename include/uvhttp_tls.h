@@ -2,6 +2,7 @@
 #define UVHTTP_TLS_H
 
 #include "uvhttp_error.h"
+#include "uvhttp_tls_session_cache.h"
 
 #include <mbedtls/ctr_drbg.h>
 #include <mbedtls/debug.h>
@@ -61,11 +62,29 @@ uvhttp_error_t uvhttp_tls_context_enable_session_tickets(
     uvhttp_tls_context_t* ctx, int enable);
 uvhttp_error_t uvhttp_tls_context_set_session_cache(uvhttp_tls_context_t* ctx,
                                                     int max_sessions);
+/**
+ * @brief Back session ID resumption with a cache shared across workers
+ * @param ctx TLS context (one per worker loop)
+ * @param cache Shared cache, or NULL to return to the per-context cache
+ * @return UVHTTP_OK Success, othervaluerepresentsFailure
+ * @note The cache is not owned by ctx and must outlive it
+ * @note Also makes uvhttp_tls_context_rotate_ticket_key() adopt the ticket
+ * key published in the cache, so tickets resume on any worker
+ */
+uvhttp_error_t uvhttp_tls_context_set_shared_session_cache(
+    uvhttp_tls_context_t* ctx, uvhttp_tls_session_cache_t* cache);
 uvhttp_error_t uvhttp_tls_context_set_dh_parameters(uvhttp_tls_context_t* ctx,
                                                     const char* dh_file);
 
 /* TLSConnectionmanage */
 mbedtls_ssl_context* uvhttp_tls_create_ssl(uvhttp_tls_context_t* ctx);
+/**
+ * @brief Context a connection negotiated with
+ * @param ssl Made by uvhttp_tls_create_ssl
+ * @return The context whose certificate the handshake presented: the one
+ * the SNI callback picked, else the one ssl was made from
+ */
+uvhttp_tls_context_t* uvhttp_tls_ssl_get_context(mbedtls_ssl_context* ssl);
 uvhttp_error_t uvhttp_tls_setup_ssl(mbedtls_ssl_context* ssl, int fd);
 uvhttp_error_t uvhttp_tls_handshake(mbedtls_ssl_context* ssl);
 uvhttp_error_t uvhttp_tls_read(mbedtls_ssl_context* ssl, void* buf, size_t len);
@@ -99,13 +118,120 @@ uvhttp_error_t uvhttp_tls_context_enable_early_data(uvhttp_tls_context_t* ctx,
                                                     int enable);
 
 /* Sessionoptimization */
+/* Rotation timer ticks per interval; bounds how long workers disagree on the
+ * active ticket key after an epoch change */
+#define UVHTTP_TLS_TICKET_ROTATION_POLLS 8
+
+/**
+ * @brief Encrypt session tickets with a key of the caller's
+ * @param ctx TLS context
+ * @param key Key material; the first UVHTTP_TLS_TICKET_KEY_LEN (32) bytes
+ * are the AES-256-GCM key
+ * @param key_len Length of key, at least 1
+ * @return UVHTTP_OK Success, othervaluerepresentsFailure
+ * @note Shorter material is still accepted, with a warning: the key is its
+ * SHA-256, so every process given the same material uses the same key.
+ * Pass 32 random bytes
+ * @note The key name is derived from the key, so tickets issued by one
+ * process decrypt in any other given the same key
+ */
 uvhttp_error_t uvhttp_tls_context_set_ticket_key(uvhttp_tls_context_t* ctx,
                                                  const unsigned char* key,
                                                  size_t key_len);
 uvhttp_error_t uvhttp_tls_context_rotate_ticket_key(uvhttp_tls_context_t* ctx);
+/**
+ * @brief Rotate the session ticket key automatically on a loop timer
+ * @param ctx TLS context
+ * @param loop Loop that drives the timer (the worker's loop)
+ * @param interval_seconds Rotation interval, 0 stops automatic rotation
+ * @return UVHTTP_OK Success, othervaluerepresentsFailure
+ * @note Rotates immediately, then once per wall-clock epoch of
+ * interval_seconds. The previous key keeps decrypting tickets for one more
+ * interval (overlap window), so rotation never forces full handshakes
+ * @note The timer is unref'd and does not keep the loop alive
+ */
+uvhttp_error_t uvhttp_tls_context_enable_ticket_rotation(
+    uvhttp_tls_context_t* ctx, uv_loop_t* loop, int interval_seconds);
+/**
+ * @brief Set the lifetime of resumed sessions, by session ID or ticket
+ * @param ctx TLS context
+ * @param lifetime_seconds Lifetime in seconds (> 0)
+ * @return UVHTTP_OK Success, othervaluerepresentsFailure
+ * @note May be called after the first handshake: an attached shared session
+ * cache takes the new timeout, and ticket keys already installed are
+ * installed again with the new lifetime (timed rotation keeps two intervals)
+ */
 uvhttp_error_t uvhttp_tls_context_set_ticket_lifetime(uvhttp_tls_context_t* ctx,
                                                       int lifetime_seconds);
 
+/* Dynamic record sizing */
+/* 1400-byte record on the wire: 1369 plaintext + header, nonce and tag */
+#define UVHTTP_TLS_RECORD_SMALL_DEFAULT 1369
+#define UVHTTP_TLS_RECORD_BOOST_THRESHOLD_DEFAULT (64 * 1024)
+#define UVHTTP_TLS_RECORD_IDLE_RESET_MS_DEFAULT 1000
+
+/**
+ * @brief Configure dynamic TLS record sizing
+ * @param ctx TLS context
+ * @param enable 0 lets mbedtls emit full (16KB) records from the first byte
+ * @param small_record_size Plaintext bytes per record while ramping up
+ * (0 = UVHTTP_TLS_RECORD_SMALL_DEFAULT)
+ * @param boost_threshold Bytes written in small records before switching to
+ * full-size records (0 = UVHTTP_TLS_RECORD_BOOST_THRESHOLD_DEFAULT)
+ * @param idle_reset_ms Idle time after which a connection starts over with
+ * small records (0 = UVHTTP_TLS_RECORD_IDLE_RESET_MS_DEFAULT)
+ * @return UVHTTP_OK Success, othervaluerepresentsFailure
+ * @note Enabled with the defaults on every new context. Small records fit one
+ * TCP segment, so the browser can decrypt and render the first bytes of a
+ * response without waiting for a whole 16KB record on a lossy link
+ */
+uvhttp_error_t uvhttp_tls_context_set_dynamic_record_sizing(
+    uvhttp_tls_context_t* ctx, int enable, size_t small_record_size,
+    size_t boost_threshold, unsigned int idle_reset_ms);
+
+/**
+ * @brief Plaintext limit for the next record written on a connection
+ * @param ctx TLS context holding the sizing policy
+ * @param streamed Bytes written since the last reset; zeroed here when the
+ * connection was idle longer than the reset window, and by the connection
+ * when a new request begins
+ * @param last_write_ms Loop time of the previous write; set to now_ms
+ * @param now_ms Current loop time (uv_now)
+ * @return Maximum bytes to pass to mbedtls_ssl_write, 0 = no limit
+ * @note The caller adds the bytes actually written to *streamed
+ */
+size_t uvhttp_tls_context_next_record_size(uvhttp_tls_context_t* ctx,
+                                           uint64_t* streamed,
+                                           uint64_t* last_write_ms,
+                                           uint64_t now_ms);
+
+/**
+ * @brief Pick the context whose certificate answers a ClientHello
+ * @param data Value given to uvhttp_tls_context_set_sni_callback
+ * @param name Server name sent by the client (not NUL-terminated)
+ * @param name_len Length of name
+ * @return Context whose certificate and key to present, or NULL to present
+ * the default context's own
+ */
+typedef uvhttp_tls_context_t* (*uvhttp_tls_sni_callback_t)(void* data,
+                                                           const char* name,
+                                                           size_t name_len);
+
+/**
+ * @brief Select the server certificate by SNI (server name indication)
+ * @param ctx Context the server listens with
+ * @param callback Called once per handshake that carries a server name; NULL
+ * turns selection off
+ * @param data Passed to callback
+ * @return UVHTTP_OK Success, UVHTTP_ERROR_NOT_SUPPORTED when mbedtls is built
+ * without MBEDTLS_SSL_SERVER_NAME_INDICATION
+ * @note Only the certificate and key come from the selected context; every
+ * other setting (ciphers, session cache, client auth) stays ctx's
+ */
+uvhttp_error_t uvhttp_tls_context_set_sni_callback(
+    uvhttp_tls_context_t* ctx, uvhttp_tls_sni_callback_t callback,
+    void* data);
+
 /* validate */
 uvhttp_error_t uvhttp_tls_verify_cert_chain(mbedtls_ssl_context* ssl);
 uvhttp_error_t uvhttp_tls_context_add_extra_chain_cert(
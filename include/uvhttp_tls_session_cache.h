@@ -0,0 +1,175 @@
+/**
+ * @file uvhttp_tls_session_cache.h
+ * @brief Shared, sharded TLS session cache and ticket key store
+ *
+ * One instance can be attached to the TLS contexts of every worker loop so a
+ * session established on one worker resumes on any other. Entries are
+ * serialized sessions (mbedtls_ssl_session_save output) keyed by session ID
+ * and spread over lock-striped shards selected by xxhash of the ID, so
+ * concurrent workers only contend when they hit the same shard. Each shard
+ * indexes its entries by the same hash and evicts its oldest entry when
+ * full.
+ *
+ * The same instance also publishes the session ticket key for the current
+ * rotation epoch, letting every worker encrypt tickets with one key and
+ * accept tickets issued by its peers.
+ *
+ * @note Compiled together with the TLS module (UVHTTP_FEATURE_TLS).
+ * @note Thread-safe: every public function may be called from any loop.
+ * @note The cache must outlive every TLS context it is attached to.
+ */
+
+#ifndef UVHTTP_TLS_SESSION_CACHE_H
+#define UVHTTP_TLS_SESSION_CACHE_H
+
+#include "uvhttp_error.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Default cache limits */
+#define UVHTTP_TLS_SESSION_CACHE_DEFAULT_SHARDS 16
+#define UVHTTP_TLS_SESSION_CACHE_DEFAULT_MAX_ENTRIES 8192
+#define UVHTTP_TLS_SESSION_CACHE_DEFAULT_TIMEOUT 86400 /* seconds */
+
+/* Largest session ID accepted (TLS 1.2 session IDs are at most 32 bytes) */
+#define UVHTTP_TLS_SESSION_ID_MAX_LEN 32
+
+/* Ticket key material sizes (AES-256-GCM key, 4-byte key name) */
+#define UVHTTP_TLS_TICKET_NAME_LEN 4
+#define UVHTTP_TLS_TICKET_KEY_LEN 32
+
+typedef struct uvhttp_tls_session_cache uvhttp_tls_session_cache_t;
+
+/* Session ticket key published for one rotation epoch */
+typedef struct {
+    unsigned char name[UVHTTP_TLS_TICKET_NAME_LEN];
+    unsigned char key[UVHTTP_TLS_TICKET_KEY_LEN];
+    uint64_t epoch; /* rotation epoch the key belongs to */
+} uvhttp_tls_ticket_key_t;
+
+/* Aggregated counters across all shards */
+typedef struct {
+    uint64_t hits;      /* lookups that returned a session */
+    uint64_t misses;    /* lookups with no (or an expired) entry */
+    uint64_t stores;    /* sessions inserted or refreshed */
+    uint64_t evictions; /* entries dropped to make room */
+    size_t entries;     /* entries currently held */
+    size_t memory;      /* serialized bytes currently held */
+} uvhttp_tls_session_cache_stats_t;
+
+/**
+ * Create a shared session cache.
+ *
+ * @param shard_count Number of lock stripes, rounded up to a power of two
+ *   (0 = UVHTTP_TLS_SESSION_CACHE_DEFAULT_SHARDS)
+ * @param max_entries Total entry budget split evenly across shards
+ *   (0 = UVHTTP_TLS_SESSION_CACHE_DEFAULT_MAX_ENTRIES)
+ * @param timeout_seconds Entry lifetime in seconds
+ *   (0 = UVHTTP_TLS_SESSION_CACHE_DEFAULT_TIMEOUT)
+ * @param cache Output parameter, receives the created cache
+ * @return UVHTTP_OK on success, otherwise an error code
+ */
+uvhttp_error_t uvhttp_tls_session_cache_create(
+    size_t shard_count, size_t max_entries, uint32_t timeout_seconds,
+    uvhttp_tls_session_cache_t** cache);
+
+/**
+ * Release a shared session cache and all stored sessions.
+ *
+ * @param cache Cache to release (may be NULL)
+ */
+void uvhttp_tls_session_cache_free(uvhttp_tls_session_cache_t* cache);
+
+/**
+ * Store (or refresh) a serialized session.
+ *
+ * @param cache Cache to update
+ * @param id Session ID
+ * @param id_len Session ID length (1..UVHTTP_TLS_SESSION_ID_MAX_LEN)
+ * @param data Serialized session, copied into the cache
+ * @param data_len Serialized session length
+ * @return UVHTTP_OK on success, otherwise an error code
+ */
+uvhttp_error_t uvhttp_tls_session_cache_put(uvhttp_tls_session_cache_t* cache,
+                                            const unsigned char* id,
+                                            size_t id_len,
+                                            const unsigned char* data,
+                                            size_t data_len);
+
+/**
+ * Copy a stored session into the caller's buffer.
+ *
+ * @param cache Cache to query
+ * @param id Session ID
+ * @param id_len Session ID length
+ * @param buf Destination buffer
+ * @param buf_size Destination buffer size
+ * @param out_len Output parameter, receives the session length on hit (or the
+ *   required size when UVHTTP_ERROR_BUFFER_TOO_SMALL is returned)
+ * @return UVHTTP_OK on hit, UVHTTP_ERROR_NOT_FOUND on miss or expiry,
+ *   otherwise an error code
+ */
+uvhttp_error_t uvhttp_tls_session_cache_get(uvhttp_tls_session_cache_t* cache,
+                                            const unsigned char* id,
+                                            size_t id_len, unsigned char* buf,
+                                            size_t buf_size, size_t* out_len);
+
+/**
+ * Drop a stored session (e.g. after a failed resumption).
+ *
+ * @param cache Cache to update
+ * @param id Session ID
+ * @param id_len Session ID length
+ * @return UVHTTP_OK if removed, UVHTTP_ERROR_NOT_FOUND if absent
+ */
+uvhttp_error_t uvhttp_tls_session_cache_remove(
+    uvhttp_tls_session_cache_t* cache, const unsigned char* id, size_t id_len);
+
+/**
+ * Set the entry lifetime in seconds. Applies to lookups immediately.
+ *
+ * @param cache Cache to configure
+ * @param timeout_seconds Entry lifetime in seconds (must be > 0)
+ * @return UVHTTP_OK on success, otherwise an error code
+ */
+uvhttp_error_t uvhttp_tls_session_cache_set_timeout(
+    uvhttp_tls_session_cache_t* cache, uint32_t timeout_seconds);
+
+/**
+ * Publish or fetch the ticket key for a rotation epoch.
+ *
+ * If the stored key belongs to an older epoch, @p candidate is installed as
+ * the key for @p epoch. Either way the key now current for the cache is
+ * copied to @p out, so the first worker to reach a new epoch decides the key
+ * and every other worker adopts it.
+ *
+ * @param cache Cache holding the key
+ * @param epoch Rotation epoch the caller wants a key for
+ * @param candidate Freshly generated key offered for @p epoch
+ * @param out Output parameter, receives the current key
+ * @return UVHTTP_OK on success, otherwise an error code
+ */
+uvhttp_error_t uvhttp_tls_session_cache_sync_ticket_key(
+    uvhttp_tls_session_cache_t* cache, uint64_t epoch,
+    const uvhttp_tls_ticket_key_t* candidate, uvhttp_tls_ticket_key_t* out);
+
+/**
+ * Retrieve aggregated statistics.
+ *
+ * @param cache Cache to inspect
+ * @param stats Output parameter, receives the counters
+ * @return UVHTTP_OK on success, otherwise an error code
+ */
+uvhttp_error_t uvhttp_tls_session_cache_get_stats(
+    uvhttp_tls_session_cache_t* cache, uvhttp_tls_session_cache_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UVHTTP_TLS_SESSION_CACHE_H */
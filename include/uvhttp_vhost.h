@@ -0,0 +1,111 @@
+/**
+ * @file uvhttp_vhost.h
+ * @brief Virtual hosts: one router (and certificate) per Host name
+ *
+ * A server can serve many sites on one listener. Each request is routed by
+ * the router registered for its Host header, exact names first, then the
+ * most specific "*.suffix" wildcard; requests for other hosts use the
+ * server's own router. Names are hashed when registered, so a request costs
+ * one hash of its Host (plus one per label on a wildcard miss).
+ *
+ * With TLS, a virtual host may bring its own context; its certificate is
+ * then chosen during the handshake from the SNI server name, using the same
+ * table.
+ */
+
+#ifndef UVHTTP_VHOST_H
+#define UVHTTP_VHOST_H
+
+#include "uvhttp_error.h"
+#include "uvhttp_features.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct uvhttp_server uvhttp_server_t;
+typedef struct uvhttp_router uvhttp_router_t;
+#if UVHTTP_FEATURE_TLS
+typedef struct uvhttp_tls_context uvhttp_tls_context_t;
+#endif
+
+/* Longest host name accepted (DNS limit), without port */
+#define UVHTTP_VHOST_MAX_NAME_LEN 253
+
+typedef struct uvhttp_vhost_table uvhttp_vhost_table_t;
+
+/**
+ * @brief Serve requests for host with router
+ * @param server Server
+ * @param host "example.com", or "*.example.com" for every name below
+ * example.com (not example.com itself); case-insensitive, no port
+ * @param router Router for the host; the server frees it, like
+ * uvhttp_server_set_router. One router may serve several hosts
+ * @return UVHTTP_OK Success, UVHTTP_ERROR_INVALID_PARAM for a malformed
+ * name, UVHTTP_ERROR_ALREADY_EXISTS when host is already registered
+ * @note On failure the caller keeps ownership of router
+ */
+uvhttp_error_t uvhttp_server_add_vhost(uvhttp_server_t* server,
+                                       const char* host,
+                                       uvhttp_router_t* router);
+
+#if UVHTTP_FEATURE_TLS
+/**
+ * @brief Serve host with router and present tls_ctx's certificate to
+ * clients that ask for host via SNI
+ * @param tls_ctx Certificate and key for host (the server frees it); may be
+ * NULL to keep the default certificate
+ * @return As uvhttp_server_add_vhost, or UVHTTP_ERROR_NOT_SUPPORTED when
+ * mbedtls lacks SNI support (the host is still served, with the default
+ * certificate, and the server owns router and tls_ctx)
+ * @note TLS itself is enabled with uvhttp_server_enable_tls, whose context
+ * answers clients that send no (or an unknown) server name
+ */
+uvhttp_error_t uvhttp_server_add_vhost_tls(uvhttp_server_t* server,
+                                           const char* host,
+                                           uvhttp_router_t* router,
+                                           uvhttp_tls_context_t* tls_ctx);
+#endif
+
+/**
+ * @brief Router for a Host header value (port allowed)
+ * @return The virtual host's router, or the server's router when no
+ * virtual host matches or host is NULL
+ */
+uvhttp_router_t* uvhttp_server_find_router(const uvhttp_server_t* server,
+                                           const char* host);
+
+/* ========== Table (used by the server) ========== */
+
+uvhttp_error_t uvhttp_vhost_table_new(uvhttp_vhost_table_t** table);
+
+/**
+ * Release the table with the routers and TLS contexts it holds, each once;
+ * the server's own router and TLS context are left to the server.
+ */
+void uvhttp_vhost_table_free(uvhttp_vhost_table_t* table,
+                             const uvhttp_server_t* server);
+
+#if UVHTTP_FEATURE_TLS
+/**
+ * Let the server's TLS context pick virtual host certificates by SNI.
+ */
+uvhttp_error_t uvhttp_server_enable_vhost_sni(uvhttp_server_t* server);
+#endif
+
+/**
+ * Copy host into out (UVHTTP_VHOST_MAX_NAME_LEN bytes) in the form names
+ * are stored: lowercase, no port, no trailing dot.
+ *
+ * @return Length written, or 0 when host is empty or too long
+ */
+size_t uvhttp_vhost_normalize(const char* host, size_t len, char* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UVHTTP_VHOST_H */
@@ -65,11 +65,53 @@ typedef struct {
     int max_message_size;
     int ping_interval;
     int ping_timeout;
-    int enable_compression;
+    int enable_compression;    /* negotiate permessage-deflate */
+    int compression_threshold; /* shorter messages are sent uncompressed */
 } uvhttp_ws_config_t;
 
+/* Negotiated permessage-deflate parameters (RFC 7692 §7.1) */
+typedef struct {
+    int server_no_context_takeover;
+    int client_no_context_takeover;
+    int server_max_window_bits; /* 8-15 */
+    int client_max_window_bits; /* 8-15 */
+} uvhttp_ws_deflate_params_t;
+
+/* Incremental UTF-8 validation state, carried across text fragments */
+typedef struct {
+    uint8_t need;    /* continuation bytes still expected */
+    uint8_t lo;      /* bounds of the next continuation byte */
+    uint8_t hi;
+    uint8_t invalid; /* sticky once an error is seen */
+} uvhttp_ws_utf8_state_t;
+
+/* Payload codec implementations, in order of preference */
+typedef enum {
+    UVHTTP_WS_SIMD_SCALAR = 0, /* byte loop, reference */
+    UVHTTP_WS_SIMD_WORD,       /* 64-bit words, any CPU */
+    UVHTTP_WS_SIMD_SSE2,
+    UVHTTP_WS_SIMD_AVX2
+} uvhttp_ws_simd_level_t;
+
+/* Slow-consumer policy: what a send does once the outbound queue is full */
+typedef enum {
+    UVHTTP_WS_SLOW_CONSUMER_CLOSE = 0, /* fail the send, close the connection */
+    UVHTTP_WS_SLOW_CONSUMER_DROP = 1   /* drop the frame, keep the connection */
+} uvhttp_ws_slow_consumer_policy_t;
+
 /* Forward declarations */
 struct uvhttp_ws_connection;
+struct uvhttp_ws_write_req;
+struct ws_connection_node;
+
+/* Outbound frame waiting in (or written from) the send queue */
+typedef struct uvhttp_ws_out_frame uvhttp_ws_out_frame_t;
+
+/* Refcounted, pre-encoded server frame (see uvhttp_ws_send_shared) */
+typedef struct uvhttp_ws_shared_frame uvhttp_ws_shared_frame_t;
+
+/* permessage-deflate state of one connection */
+typedef struct uvhttp_ws_deflate uvhttp_ws_deflate_t;
 
 /* Callback function types */
 typedef int (*uvhttp_ws_on_message_callback)(struct uvhttp_ws_connection* conn,
@@ -80,6 +122,7 @@ typedef int (*uvhttp_ws_on_close_callback)(struct uvhttp_ws_connection* conn,
 typedef int (*uvhttp_ws_on_error_callback)(struct uvhttp_ws_connection* conn,
                                            int error_code,
                                            const char* error_msg);
+typedef void (*uvhttp_ws_on_drain_callback)(struct uvhttp_ws_connection* conn);
 
 /* WebSocket connection */
 typedef struct uvhttp_ws_connection {
@@ -92,7 +135,7 @@ typedef struct uvhttp_ws_connection {
     /* Original key saved during client handshake (for accept verification) */
     char client_key[64];
 
-    /* Receive buffer */
+    /* Receive buffer: stages a frame split across reads */
     uint8_t* recv_buffer;
     size_t recv_buffer_size;
     size_t recv_buffer_pos;
@@ -101,23 +144,44 @@ typedef struct uvhttp_ws_connection {
     uint8_t* send_buffer;
     size_t send_buffer_size;
 
+    /* Outbound queue. With a transport attached, frames are written through
+     * its libuv stream; without one they go straight to fd/ssl. */
+    uvhttp_connection_t* transport;
+    uvhttp_ws_out_frame_t* send_head;
+    uvhttp_ws_out_frame_t* send_tail;
+    size_t send_queued_bytes;            /* queued + in-flight frame bytes */
+    struct uvhttp_ws_write_req* send_req; /* in-flight uv_write, or NULL */
+    size_t send_queue_max;               /* 0 = unbounded */
+    uvhttp_ws_slow_consumer_policy_t slow_consumer_policy;
+    int drain_pending;
+
+    /* permessage-deflate, NULL unless negotiated */
+    uvhttp_ws_deflate_t* deflate;
+
     /* Fragment reassembly */
     uint8_t* fragmented_message;
     size_t fragmented_size;
     size_t fragmented_capacity;
     uvhttp_ws_opcode_t fragmented_opcode;
+    uvhttp_ws_utf8_state_t fragmented_utf8; /* text fragments seen so far */
 
     /* Callback functions */
     uvhttp_ws_on_message_callback on_message;
     uvhttp_ws_on_close_callback on_close;
     uvhttp_ws_on_error_callback on_error;
+    uvhttp_ws_on_drain_callback on_drain;
     void* user_data;
 
+    /* Server registry entry, NULL while unregistered */
+    struct ws_connection_node* registry_node;
+
     /* Statistics */
     uint64_t bytes_sent;
     uint64_t bytes_received;
     uint64_t frames_sent;
     uint64_t frames_received;
+    uint64_t frames_dropped; /* refused by the DROP slow-consumer policy */
+    uint64_t messages_compressed; /* sent with RSV1 set */
 } uvhttp_ws_connection_t;
 
 /* WebSocket API */
@@ -157,12 +221,6 @@ uvhttp_error_t uvhttp_ws_verify_handshake_response(
     struct uvhttp_ws_connection* conn, const char* response,
     size_t response_len);
 
-/**
- * receive WebSocket frame
- */
-uvhttp_error_t uvhttp_ws_recv_frame(struct uvhttp_ws_connection* conn,
-                                    uvhttp_ws_frame_t* frame);
-
 /**
  * send WebSocket frame
  */
@@ -212,6 +270,16 @@ uvhttp_error_t uvhttp_ws_close(uvhttp_context_t* context,
 uvhttp_error_t uvhttp_ws_process_data(struct uvhttp_ws_connection* conn,
                                       const uint8_t* data, size_t len);
 
+/**
+ * handlereceiveto, parsing in place
+ *
+ * Frames are parsed and unmasked inside data, and single-frame messages
+ * reach on_message as slices of it; only a frame split across reads is
+ * copied into recv_buffer. data is modified.
+ */
+uvhttp_error_t uvhttp_ws_process_data_inplace(
+    struct uvhttp_ws_connection* conn, uint8_t* data, size_t len);
+
 /**
  * setcallbackFunction
  */
@@ -220,6 +288,123 @@ void uvhttp_ws_set_callbacks(struct uvhttp_ws_connection* conn,
                              uvhttp_ws_on_close_callback on_close,
                              uvhttp_ws_on_error_callback on_error);
 
+/**
+ * @brief Bound the outbound queue and choose the slow-consumer policy
+ *
+ * Data frames that would push the buffered amount past @p max_bytes are
+ * refused with UVHTTP_ERROR_WEBSOCKET_SLOW_CONSUMER. With the CLOSE policy
+ * the connection also moves to CLOSING and on_error is raised with that
+ * code; the server then tears the connection down on the next loop
+ * iteration. Control frames and a frame sent into an empty queue are always
+ * accepted.
+ *
+ * @param conn WebSocket connection
+ * @param max_bytes Queue budget in bytes (0 = unbounded)
+ * @param policy Action taken when the budget is exceeded
+ * @return UVHTTP_OK on success, otherwise an error code
+ */
+uvhttp_error_t uvhttp_ws_set_send_queue(
+    struct uvhttp_ws_connection* conn, size_t max_bytes,
+    uvhttp_ws_slow_consumer_policy_t policy);
+
+/**
+ * @brief Set the callback fired when the outbound queue empties
+ *
+ * Fires from a write completion once every frame accepted by a send that
+ * left data buffered has been handed to the kernel. Producers paused by a
+ * slow-consumer refusal resume from here.
+ */
+void uvhttp_ws_set_drain_callback(struct uvhttp_ws_connection* conn,
+                                  uvhttp_ws_on_drain_callback on_drain);
+
+/**
+ * @brief Bytes accepted for sending but not yet written to the socket
+ */
+size_t uvhttp_ws_get_buffered_amount(const struct uvhttp_ws_connection* conn);
+
+/**
+ * @brief Submit queued frames and fire the drain callback if idle
+ *
+ * Called internally after every write completion; embedders only need it
+ * after writing to the transport behind the connection's back.
+ *
+ * @return UVHTTP_OK on success, UVHTTP_ERROR_CONNECTION_BROKEN if the
+ *         stream refused the write
+ */
+uvhttp_error_t uvhttp_ws_flush(struct uvhttp_ws_connection* conn);
+
+/**
+ * @brief Encode a server (unmasked) frame once for many connections
+ *
+ * The frame starts with one reference owned by the caller. Every
+ * uvhttp_ws_send_shared() takes another that is dropped when that
+ * connection's write completes, so the caller releases its own reference
+ * as soon as it has queued the frame everywhere.
+ *
+ * @param payload Frame payload (may be NULL when len is 0)
+ * @param len Payload length
+ * @param opcode Frame opcode
+ * @param frame Output parameter, receives the shared frame
+ * @return UVHTTP_OK on success, otherwise an error code
+ */
+uvhttp_error_t uvhttp_ws_shared_frame_create(const uint8_t* payload,
+                                             size_t len,
+                                             uvhttp_ws_opcode_t opcode,
+                                             uvhttp_ws_shared_frame_t** frame);
+
+/**
+ * @brief Drop a reference to a shared frame (may be NULL)
+ */
+void uvhttp_ws_shared_frame_release(uvhttp_ws_shared_frame_t* frame);
+
+/**
+ * @brief Queue a shared frame on a server connection without copying it
+ *
+ * Subject to the same queue budget as uvhttp_ws_send_frame(). TLS
+ * connections still encrypt the bytes individually.
+ *
+ * @return UVHTTP_OK on success, UVHTTP_ERROR_INVALID_PARAM for client
+ *         connections (their frames must be masked) or a non-OPEN state,
+ *         otherwise an error code
+ */
+uvhttp_error_t uvhttp_ws_send_shared(struct uvhttp_ws_connection* conn,
+                                     uvhttp_ws_shared_frame_t* frame);
+
+/**
+ * @brief Choose a permessage-deflate offer (server side)
+ *
+ * Accepts the first offer in a Sec-WebSocket-Extensions request value that
+ * can be honoured. The response always carries server_no_context_takeover:
+ * each message is compressed from a fresh window, so one compressed
+ * broadcast frame is valid for every subscriber and no compressor state is
+ * kept per connection.
+ *
+ * @param offers Sec-WebSocket-Extensions request header value
+ * @param params Output, negotiated parameters
+ * @param response Output, Sec-WebSocket-Extensions response header value
+ * @param response_len Size of @p response
+ * @return UVHTTP_OK on success, UVHTTP_ERROR_NOT_FOUND if no offer is
+ *         acceptable (reply without the extension), otherwise an error code
+ */
+uvhttp_error_t uvhttp_ws_deflate_negotiate(const char* offers,
+                                           uvhttp_ws_deflate_params_t* params,
+                                           char* response,
+                                           size_t response_len);
+
+/**
+ * @brief Turn on permessage-deflate with negotiated parameters
+ *
+ * Data messages of at least config.compression_threshold bytes are sent
+ * compressed when that makes them smaller; received messages with RSV1 set
+ * are inflated before on_message, bounded by max_message_size.
+ *
+ * @return UVHTTP_OK on success, UVHTTP_ERROR_NOT_SUPPORTED without
+ *         compression support, otherwise an error code
+ */
+uvhttp_error_t uvhttp_ws_enable_deflate(
+    struct uvhttp_ws_connection* conn,
+    const uvhttp_ws_deflate_params_t* params);
+
 /* Frame processing functions */
 
 /**
@@ -246,10 +431,48 @@ long uvhttp_ws_build_frame(uvhttp_context_t* context, uint8_t* buffer,
 
 /**
  * apply mask
+ *
+ * XORs the payload with the 4-byte key using the widest implementation the
+ * CPU supports (see uvhttp_ws_get_simd_level).
  */
 void uvhttp_ws_apply_mask(uint8_t* data, size_t len,
                           const uint8_t* masking_key);
 
+/**
+ * Reset a UTF-8 validation state to the start of a message
+ */
+void uvhttp_ws_utf8_init(uvhttp_ws_utf8_state_t* state);
+
+/**
+ * Validate the next chunk of a text message
+ *
+ * Chunks may split a character anywhere; the state carries the partial
+ * character into the next call.
+ *
+ * @return 1 while everything seen is valid UTF-8, 0 once it is not
+ */
+int uvhttp_ws_utf8_validate(uvhttp_ws_utf8_state_t* state,
+                            const uint8_t* data, size_t len);
+
+/**
+ * Whether the message validated so far ends on a complete character
+ */
+int uvhttp_ws_utf8_complete(const uvhttp_ws_utf8_state_t* state);
+
+/**
+ * Codec implementation in use, detected from the CPU on first use
+ */
+uvhttp_ws_simd_level_t uvhttp_ws_get_simd_level(void);
+
+/**
+ * Force a codec implementation, for tests and benchmarks
+ *
+ * Process-wide; call before any loop is running.
+ *
+ * @return UVHTTP_ERROR_NOT_SUPPORTED if this CPU or build lacks the level
+ */
+uvhttp_error_t uvhttp_ws_set_simd_level(uvhttp_ws_simd_level_t level);
+
 /**
  * generate Sec-WebSocket-Accept
  */
@@ -66,6 +66,9 @@ void uvhttp_config_set_defaults(uvhttp_config_t* config) {
         UVHTTP_WEBSOCKET_DEFAULT_MAX_MESSAGE_SIZE;
     config->websocket_ping_interval = UVHTTP_WEBSOCKET_DEFAULT_PING_INTERVAL;
     config->websocket_ping_timeout = UVHTTP_WEBSOCKET_DEFAULT_PING_TIMEOUT;
+    config->websocket_compression = 0;
+    config->websocket_compression_threshold =
+        UVHTTP_WEBSOCKET_DEFAULT_COMPRESSION_THRESHOLD;
 
     /* networkconfig */
     config->tcp_keepalive_timeout = UVHTTP_TCP_KEEPALIVE_TIMEOUT;
@@ -196,6 +199,12 @@ int uvhttp_config_validate(const uvhttp_config_t* config) {
         return UVHTTP_ERROR_INVALID_PARAM;
     }
 
+    if (config->websocket_compression_threshold < 0) {
+        UVHTTP_LOG_ERROR("websocket_compression_threshold=%d must be >= 0",
+                         config->websocket_compression_threshold);
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
     if (config->tcp_keepalive_timeout < UVHTTP_TCP_KEEPALIVE_MIN_TIMEOUT ||
 
         config->tcp_keepalive_timeout > UVHTTP_TCP_KEEPALIVE_MAX_TIMEOUT) {
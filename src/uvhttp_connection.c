@@ -10,6 +10,8 @@
 #include "uvhttp_response.h"
 #include "uvhttp_router.h"
 #include "uvhttp_server.h"
+#include "uvhttp_sse.h"
+#include "uvhttp_static.h"
 #include "uvhttp_tls.h"
 #include "uvhttp_utils.h"
 
@@ -193,6 +195,69 @@ static int mbedtls_bio_recv(void* ctx, unsigned char* buf, size_t len) {
     return (int)copy_len;
 }
 
+#    if UVHTTP_FEATURE_WEBSOCKET || UVHTTP_FEATURE_SSE
+/* Ciphertext the kernel did not take, queued behind earlier writes */
+typedef struct {
+    uv_write_t req;
+    size_t len;
+    unsigned char data[];
+} tls_pending_write_t;
+
+static void on_tls_pending_write(uv_write_t* req, int status) {
+    tls_pending_write_t* pending = (tls_pending_write_t*)req->data;
+    uvhttp_connection_t* conn = (uvhttp_connection_t*)req->handle->data;
+    uvhttp_free(pending);
+
+#        if UVHTTP_FEATURE_WEBSOCKET
+    /* Write callbacks run before the handle's close callback, so conn is
+     * still valid here even when the connection is being torn down. */
+    if (status == 0 && conn && conn->ws_connection &&
+        conn->state != UVHTTP_CONN_STATE_CLOSING) {
+        uvhttp_ws_flush((uvhttp_ws_connection_t*)conn->ws_connection);
+    }
+#        else
+    (void)status;
+    (void)conn;
+#        endif
+}
+
+/* WebSocket and SSE mode: never report WANT_WRITE. Whatever uv_try_write cannot
+ * push now is copied into a uv_write, which libuv orders after any earlier
+ * pending write (uv_try_write itself refuses while the queue is non-empty).
+ * Backpressure is then visible as the stream's write queue size. */
+static int mbedtls_bio_send_async(uvhttp_connection_t* conn,
+                                  const unsigned char* buf, size_t len) {
+    uv_stream_t* stream = (uv_stream_t*)&conn->tcp_handle;
+    uv_buf_t uv_buf = uv_buf_init((char*)buf, len);
+    int written = uv_try_write(stream, &uv_buf, 1);
+    if (written == UV_EAGAIN) {
+        written = 0;
+    } else if (written < 0) {
+        return MBEDTLS_ERR_SSL_INTERNAL_ERROR;
+    }
+    if ((size_t)written == len) {
+        return (int)len;
+    }
+
+    size_t rest = len - (size_t)written;
+    tls_pending_write_t* pending =
+        uvhttp_alloc(sizeof(tls_pending_write_t) + rest);
+    if (!pending) {
+        return MBEDTLS_ERR_SSL_ALLOC_FAILED;
+    }
+    memcpy(pending->data, buf + written, rest);
+    pending->len = rest;
+    pending->req.data = pending;
+    uv_buf = uv_buf_init((char*)pending->data, rest);
+    if (uv_write(&pending->req, stream, &uv_buf, 1, on_tls_pending_write) !=
+        0) {
+        uvhttp_free(pending);
+        return MBEDTLS_ERR_SSL_INTERNAL_ERROR;
+    }
+    return (int)len;
+}
+#    endif
+
 static int mbedtls_bio_send(void* ctx, const unsigned char* buf, size_t len) {
     uvhttp_connection_t* conn = (uvhttp_connection_t*)ctx;
 
@@ -205,6 +270,17 @@ static int mbedtls_bio_send(void* ctx, const unsigned char* buf, size_t len) {
         return MBEDTLS_ERR_SSL_INTERNAL_ERROR;
     }
 
+#    if UVHTTP_FEATURE_WEBSOCKET
+    if (conn->is_websocket) {
+        return mbedtls_bio_send_async(conn, buf, len);
+    }
+#    endif
+#    if UVHTTP_FEATURE_SSE
+    if (conn->sse_stream) {
+        return mbedtls_bio_send_async(conn, buf, len);
+    }
+#    endif
+
     /* Write encrypted data using libuv write */
     uv_buf_t uv_buf = uv_buf_init((char*)buf, len);
     int result = uv_try_write((uv_stream_t*)&conn->tcp_handle, &uv_buf, 1);
@@ -844,6 +920,20 @@ void uvhttp_connection_close(uvhttp_connection_t* conn) {
 
     uvhttp_connection_set_state(conn, UVHTTP_CONN_STATE_CLOSING);
 
+#if UVHTTP_FEATURE_SSE
+    /* end the event stream before its socket goes away */
+    if (conn->sse_stream) {
+        uvhttp_sse_detach(conn);
+    }
+#endif
+
+    /* a middleware still waiting must not resume into a closed connection */
+    uvhttp_middleware_cancel(&conn->middleware);
+#if UVHTTP_FEATURE_STATIC_FILES
+    /* nor a static file answer it once read */
+    uvhttp_static_cancel((uvhttp_static_op_t*)conn->static_op);
+#endif
+
     /* initialize pending close handle count */
     conn->close_pending = 0;
 
@@ -1001,13 +1091,27 @@ uvhttp_error_t uvhttp_connection_tls_write(uvhttp_connection_t* conn,
     const unsigned char* p = (const unsigned char*)data;
     size_t remaining = len;
     int retries = 0;
+    /* sized by the context the handshake picked (a virtual host's) */
+    uvhttp_tls_context_t* tls_ctx =
+        uvhttp_tls_ssl_get_context((mbedtls_ssl_context*)conn->ssl);
 
     while (remaining > 0) {
+        /* Dynamic record sizing: mbedtls emits one record per call, so
+         * capping the length caps the record. */
+        size_t chunk = remaining;
+        size_t limit = uvhttp_tls_context_next_record_size(
+            tls_ctx, &conn->tls_record_streamed, &conn->tls_record_last_ms,
+            uv_now(conn->tcp_handle.loop));
+        if (limit > 0 && chunk > limit) {
+            chunk = limit;
+        }
+
         int ret = mbedtls_ssl_write((mbedtls_ssl_context*)conn->ssl, p,
-                                    remaining);
+                                    chunk);
         if (ret > 0) {
             p += ret;
             remaining -= ret;
+            conn->tls_record_streamed += (uint64_t)ret;
             retries = 0;
             continue;
         }
@@ -1151,8 +1255,8 @@ static void on_websocket_read(uv_stream_t* stream, ssize_t nread,
              * never complete and the client stalls. The WS parser buffers
              * partial frames across chunks, so per-chunk delivery is safe and
              * frame-size independent. */
-            result = uvhttp_ws_process_data(
-                ws_conn, (const uint8_t*)conn->read_buffer, (size_t)ret);
+            result = uvhttp_ws_process_data_inplace(
+                ws_conn, (uint8_t*)conn->read_buffer, (size_t)ret);
             if (result != 0) {
                 break; /* fall through to the M5 error handling below */
             }
@@ -1160,8 +1264,8 @@ static void on_websocket_read(uv_stream_t* stream, ssize_t nread,
     } else
 #endif
     {
-        result =
-            uvhttp_ws_process_data(ws_conn, (const uint8_t*)buf->base, nread);
+        result = uvhttp_ws_process_data_inplace(ws_conn, (uint8_t*)buf->base,
+                                                (size_t)nread);
     }
     if (result != 0) {
         UVHTTP_LOG_ERROR("WebSocket data processing failed: %d\n", result);
@@ -1204,6 +1308,15 @@ static int on_websocket_close(uvhttp_ws_connection_t* ws_conn, int code,
     return UVHTTP_OK;
 }
 
+/* Deferred WebSocket teardown (slow consumer) */
+static void on_idle_websocket_close(uv_idle_t* handle) {
+    uvhttp_connection_t* conn = (uvhttp_connection_t*)handle->data;
+    uv_idle_stop(handle);
+    if (conn && conn->ws_connection) {
+        uvhttp_connection_websocket_close(conn);
+    }
+}
+
 /* WebSocketerrorcallback */
 static int on_websocket_error(uvhttp_ws_connection_t* ws_conn, int error_code,
                               const char* error_msg) {
@@ -1213,8 +1326,18 @@ static int on_websocket_error(uvhttp_ws_connection_t* ws_conn, int error_code,
 
     UVHTTP_LOG_ERROR("WebSocket error: %s (code: %d)\n", error_msg, error_code);
 
-    /* get user handler from wrapper */
+    /* Slow consumer under the CLOSE policy: the send that hit the limit is
+     * still on the caller's stack, so tear down on the next iteration. */
     uvhttp_ws_wrapper_t* wrapper = (uvhttp_ws_wrapper_t*)ws_conn->user_data;
+    if (error_code == UVHTTP_ERROR_WEBSOCKET_SLOW_CONSUMER && wrapper &&
+        wrapper->conn && wrapper->conn->state != UVHTTP_CONN_STATE_CLOSING &&
+        !uv_is_closing((uv_handle_t*)&wrapper->conn->idle_handle)) {
+        uv_idle_stop(&wrapper->conn->idle_handle);
+        wrapper->conn->idle_handle.data = wrapper->conn;
+        uv_idle_start(&wrapper->conn->idle_handle, on_idle_websocket_close);
+    }
+
+    /* get user handler from wrapper */
     if (wrapper && wrapper->user_handler) {
         /* call user-registered error callback */
         if (wrapper->user_handler->on_error) {
@@ -1350,6 +1473,24 @@ uvhttp_error_t uvhttp_connection_handle_websocket_handshake(
     /* save WebSocket Key (for verification) */
     uvhttp_safe_strncpy(ws_conn->client_key, ws_key, sizeof(ws_conn->client_key));
 
+    /* frames go out through this connection's stream (and TLS session) */
+    ws_conn->transport = conn;
+
+    /* permessage-deflate, as answered in the 101 response */
+    const char* offers =
+        uvhttp_request_get_header(conn->request,
+                                  UVHTTP_HEADER_WEBSOCKET_EXTENSIONS);
+    uvhttp_ws_deflate_params_t deflate_params;
+    char extensions[128];
+    if (offers && ws_conn->config.enable_compression &&
+        uvhttp_ws_deflate_negotiate(offers, &deflate_params, extensions,
+                                    sizeof(extensions)) ==
+            UVHTTP_OK &&
+        uvhttp_ws_enable_deflate(ws_conn, &deflate_params) != UVHTTP_OK) {
+        uvhttp_ws_connection_free(ws_conn);
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+
     /* create wrapper to save connection object and user handler */
     uvhttp_ws_wrapper_t* wrapper = uvhttp_alloc(sizeof(uvhttp_ws_wrapper_t));
     if (!wrapper) {
@@ -1471,6 +1612,83 @@ void uvhttp_connection_websocket_close(uvhttp_connection_t* conn) {
 }
 
 #endif /* UVHTTP_FEATURE_WEBSOCKET */
+
+#if UVHTTP_FEATURE_SSE
+/* Event stream read callback
+ * An event stream only flows server to client; whatever the client sends is
+ * discarded (TLS records are still decrypted so close_notify is seen). EOF
+ * or a read error ends the stream.
+ */
+static void on_sse_read(uv_stream_t* stream, ssize_t nread,
+                        const uv_buf_t* buf) {
+    (void)buf;
+    uvhttp_connection_t* conn = (uvhttp_connection_t*)stream->data;
+    if (!conn) {
+        return;
+    }
+
+    if (nread < 0) {
+        if (nread != UV_EOF) {
+            UVHTTP_LOG_ERROR("SSE read error: %s\n", uv_strerror(nread));
+        }
+        uvhttp_connection_close(conn);
+        return;
+    }
+
+#    if UVHTTP_FEATURE_TLS
+    if (nread > 0 && conn->tls_enabled && conn->ssl && conn->tls_cipher_buf) {
+        conn->tls_cipher_used += (size_t)nread;
+        for (;;) {
+            int ret = mbedtls_ssl_read(
+                (mbedtls_ssl_context*)conn->ssl,
+                (unsigned char*)conn->read_buffer, conn->read_buffer_size);
+            if (ret > 0) {
+                continue;
+            }
+            if (ret == 0 || ret == MBEDTLS_ERR_SSL_WANT_READ ||
+                ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+                break;
+            }
+            if (ret != MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) {
+                char error_buf[256];
+                mbedtls_strerror(ret, error_buf, sizeof(error_buf));
+                UVHTTP_LOG_ERROR("TLS read error: %s\n", error_buf);
+            }
+            uvhttp_connection_close(conn);
+            return;
+        }
+    }
+#    endif
+}
+
+/* switch to event stream pattern
+ * stop HTTP read and the idle timeout; the stream's heartbeat keeps the
+ * connection alive from here on
+ */
+uvhttp_error_t uvhttp_connection_switch_to_sse(uvhttp_connection_t* conn) {
+    if (!conn) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    if (conn->state == UVHTTP_CONN_STATE_CLOSING) {
+        return UVHTTP_ERROR_CONNECTION_BROKEN;
+    }
+
+    uv_read_stop((uv_stream_t*)&conn->tcp_handle);
+    if (!uv_is_closing((uv_handle_t*)&conn->timeout_timer)) {
+        uv_timer_stop(&conn->timeout_timer);
+    }
+    conn->state = UVHTTP_CONN_STATE_HTTP_PROCESSING;
+
+    if (uv_read_start((uv_stream_t*)&conn->tcp_handle, on_alloc_buffer,
+                      on_sse_read) != 0) {
+        UVHTTP_LOG_ERROR("Failed to start SSE reading\n");
+        return UVHTTP_ERROR_CONNECTION_START;
+    }
+
+    UVHTTP_LOG_DEBUG("Switched to SSE mode for connection\n");
+    return UVHTTP_OK;
+}
+#endif /* UVHTTP_FEATURE_SSE */
 /* connectiontimeoutcallbackfunction */
 static void connection_timeout_cb(uv_timer_t* handle) {
     uvhttp_connection_t* conn = (uvhttp_connection_t*)handle->data;
@@ -14,6 +14,10 @@
 #include <mbedtls/entropy.h>
 #endif
 
+#if UVHTTP_FEATURE_COMPRESSION
+#include <zlib.h>
+#endif
+
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -238,7 +242,26 @@ uvhttp_error_t uvhttp_context_init_websocket(uvhttp_context_t* context) {
 
 /* Cleanup WebSocket module state */
 void uvhttp_context_cleanup_websocket(uvhttp_context_t* context) {
-    if (!context || !context->ws_drbg_initialized) {
+    if (!context) {
+        return;
+    }
+
+#if UVHTTP_FEATURE_COMPRESSION
+    /* permessage-deflate streams are created lazily by the first message */
+    if (context->ws_deflater) {
+        deflateEnd((z_stream*)context->ws_deflater);
+        uvhttp_free(context->ws_deflater);
+        context->ws_deflater = NULL;
+    }
+
+    if (context->ws_inflater) {
+        inflateEnd((z_stream*)context->ws_inflater);
+        uvhttp_free(context->ws_inflater);
+        context->ws_inflater = NULL;
+    }
+#endif
+
+    if (!context->ws_drbg_initialized) {
         return;
     }
 
@@ -155,7 +155,7 @@ const char* uvhttp_error_category_string(uvhttp_error_t error) {
 
     /* Routing errors */
 
-    if (error >= -504 && error <= -500) {
+    if (error >= -505 && error <= -500) {
 
         return "Router Error";
     }
@@ -169,11 +169,18 @@ const char* uvhttp_error_category_string(uvhttp_error_t error) {
 
     /* WebSocket errors */
 
-    if (error >= -707 && error <= -700) {
+    if (error >= -708 && error <= -700) {
 
         return "WebSocket Error";
     }
 
+    /* Server-Sent Events errors */
+
+    if (error == -750) {
+
+        return "SSE Error";
+    }
+
     /* HTTP/2 errors */
 
     if (error >= -805 && error <= -800) {
@@ -411,6 +418,10 @@ const char* uvhttp_error_description(uvhttp_error_t error) {
 
         return "Invalid route pattern";
 
+    case UVHTTP_ERROR_ROUTER_FROZEN:
+
+        return "Router is frozen and no longer accepts routes";
+
         /* Allocator errors */
 
     case UVHTTP_ERROR_ALLOCATOR_INIT:
@@ -459,6 +470,16 @@ const char* uvhttp_error_description(uvhttp_error_t error) {
 
         return "WebSocket connection is closed";
 
+    case UVHTTP_ERROR_WEBSOCKET_SLOW_CONSUMER:
+
+        return "WebSocket send queue limit exceeded";
+
+        /* Server-Sent Events errors */
+
+    case UVHTTP_ERROR_SSE_SLOW_CONSUMER:
+
+        return "SSE send queue limit exceeded";
+
         /* Configuration errors */
 
     case UVHTTP_ERROR_CONFIG_PARSE:
@@ -717,6 +738,10 @@ const char* uvhttp_error_suggestion(uvhttp_error_t error) {
 
         return "Use a valid route pattern";
 
+    case UVHTTP_ERROR_ROUTER_FROZEN:
+
+        return "Add all routes before calling uvhttp_router_freeze";
+
         /* Allocator errors */
 
     case UVHTTP_ERROR_ALLOCATOR_INIT:
@@ -765,6 +790,16 @@ const char* uvhttp_error_suggestion(uvhttp_error_t error) {
 
         return "Re-establish WebSocket connection";
 
+    case UVHTTP_ERROR_WEBSOCKET_SLOW_CONSUMER:
+
+        return "Wait for the drain callback or raise the send queue limit";
+
+        /* Server-Sent Events errors */
+
+    case UVHTTP_ERROR_SSE_SLOW_CONSUMER:
+
+        return "Raise the stream's send queue limit or publish less often";
+
         /* Configuration errors */
 
     case UVHTTP_ERROR_CONFIG_PARSE:
@@ -826,6 +861,8 @@ int uvhttp_error_is_recoverable(uvhttp_error_t error) {
     case UVHTTP_ERROR_WEBSOCKET_FRAME:
     case UVHTTP_ERROR_WEBSOCKET_TOO_LARGE:
     case UVHTTP_ERROR_WEBSOCKET_INVALID_OPCODE:
+    case UVHTTP_ERROR_WEBSOCKET_SLOW_CONSUMER:
+    case UVHTTP_ERROR_SSE_SLOW_CONSUMER:
 
     /* Retriable errors */
     case UVHTTP_ERROR_LOG_WRITE:
@@ -866,6 +903,7 @@ int uvhttp_error_is_recoverable(uvhttp_error_t error) {
     case UVHTTP_ERROR_ROUTE_NOT_FOUND:
     case UVHTTP_ERROR_ROUTE_ALREADY_EXISTS:
     case UVHTTP_ERROR_INVALID_ROUTE_PATTERN:
+    case UVHTTP_ERROR_ROUTER_FROZEN:
     case UVHTTP_ERROR_ALLOCATOR_INIT:
     case UVHTTP_ERROR_ALLOCATOR_SET:
     case UVHTTP_ERROR_ALLOCATOR_NOT_INITIALIZED:
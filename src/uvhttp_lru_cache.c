@@ -10,11 +10,13 @@
 #    include "uvhttp_error.h"
 #    include "uvhttp_error_handler.h"
 #    include "uvhttp_error_helpers.h"
+#    include "uvhttp_hash.h"
 #    include "uvhttp_logging.h"
 #    include "uvhttp_utils.h"
 
 #    include <stdlib.h>
 #    include <string.h>
+#    include <sys/mman.h>
 #    include <time.h>
 
 /* Include uthash header file */
@@ -22,25 +24,359 @@
 
 
 /**
- * Set cache entry metadata (MIME type and ETag)
+ * xxhash of a key, the hash uthash files entries under
  */
-static void set_cache_entry_metadata(cache_entry_t* entry,
-                                     const char* mime_type,
-                                     const char* etag) {
-    if (mime_type) {
-        uvhttp_safe_strncpy(entry->mime_type, mime_type, sizeof(entry->mime_type));
+static unsigned lru_cache_hash(const char* key, size_t length) {
+    return (unsigned)uvhttp_hash_default(key, length);
+}
+
+/**
+ * Entry stored under key (of hash), if any
+ */
+static cache_entry_t* lru_cache_lookup(cache_manager_t* cache, const char* key,
+                                       unsigned hash) {
+    cache_entry_t* entry = NULL;
+    HASH_FIND_BYHASHVALUE(hh, cache->hash_table, key, strlen(key), hash,
+                          entry);
+    return entry;
+}
+
+/**
+ * Free cache entry
+ */
+/**
+ * Release entry's content, variants and heads; writes still sending them
+ * keep them alive
+ */
+static void lru_cache_release_content(cache_entry_t* entry) {
+    uvhttp_cache_buffer_release(entry->head);
+    uvhttp_cache_buffer_release(entry->buffer);
+    entry->head = NULL;
+    entry->buffer = NULL;
+    for (int i = 0; i < UVHTTP_CACHE_ENCODING_COUNT; i++) {
+        uvhttp_cache_buffer_release(entry->variants[i].head);
+        uvhttp_cache_buffer_release(entry->variants[i].buffer);
+    }
+    memset(entry->variants, 0, sizeof(entry->variants));
+    entry->encodings_tried = 0;
+}
+
+static void free_cache_entry(cache_entry_t* entry) {
+    if (!entry)
+        return;
+
+    lru_cache_release_content(entry);
+    uvhttp_free(entry);
+}
+
+/**
+ * W-TinyLFU segment entry is linked in, NULL for the LRU list (the window)
+ */
+static uvhttp_cache_segment_t* lru_cache_segment(cache_manager_t* cache,
+                                                 const cache_entry_t* entry) {
+    switch (entry->segment) {
+    case UVHTTP_CACHE_SEGMENT_PROBATION:
+        return &cache->probation;
+    case UVHTTP_CACHE_SEGMENT_PROTECTED:
+        return &cache->protected_segment;
+    default:
+        return NULL;
+    }
+}
+
+/**
+ * Link entry at the head of its list
+ */
+static void lru_cache_link(cache_manager_t* cache, cache_entry_t* entry) {
+    uvhttp_cache_segment_t* segment = lru_cache_segment(cache, entry);
+    cache_entry_t** head = segment ? &segment->head : &cache->lru_head;
+    cache_entry_t** tail = segment ? &segment->tail : &cache->lru_tail;
+
+    entry->lru_prev = NULL;
+    entry->lru_next = *head;
+    if (*head) {
+        (*head)->lru_prev = entry;
     } else {
-        uvhttp_safe_strncpy(entry->mime_type, "application/octet-stream",
-                          sizeof(entry->mime_type));
+        *tail = entry;
     }
+    *head = entry;
+    if (segment) {
+        segment->memory_usage += entry->memory_usage;
+        segment->entry_count++;
+    }
+}
 
-    if (etag) {
-        uvhttp_safe_strncpy(entry->etag, etag, sizeof(entry->etag));
+/**
+ * Unlink entry from its list
+ */
+static void lru_cache_unlink(cache_manager_t* cache, cache_entry_t* entry) {
+    uvhttp_cache_segment_t* segment = lru_cache_segment(cache, entry);
+    cache_entry_t** head = segment ? &segment->head : &cache->lru_head;
+    cache_entry_t** tail = segment ? &segment->tail : &cache->lru_tail;
+
+    if (entry->lru_prev) {
+        entry->lru_prev->lru_next = entry->lru_next;
     } else {
-        entry->etag[0] = '\0';
+        *head = entry->lru_next;
+    }
+    if (entry->lru_next) {
+        entry->lru_next->lru_prev = entry->lru_prev;
+    } else {
+        *tail = entry->lru_prev;
+    }
+    entry->lru_prev = NULL;
+    entry->lru_next = NULL;
+    if (segment) {
+        segment->memory_usage -= entry->memory_usage;
+        segment->entry_count--;
+    }
+}
+
+/**
+ * Evict a linked entry
+ */
+static void lru_cache_evict(cache_manager_t* cache, cache_entry_t* entry) {
+    UVHTTP_LOG_DEBUG("Evicting cache entry: %s (freeing memory: %zu)",
+                     entry->file_path, entry->memory_usage);
+
+    if (cache->eviction_callback) {
+        cache->eviction_callback(entry, cache->eviction_callback_data);
+    }
+    HASH_DEL(cache->hash_table, entry);
+    lru_cache_unlink(cache, entry);
+    cache->total_memory_usage -= entry->memory_usage;
+    cache->entry_count--;
+    cache->eviction_count++;
+    free_cache_entry(entry);
+}
+
+#    define LRU_CACHE_SKETCH_DEPTH 4
+#    define LRU_CACHE_SKETCH_MAX 15
+
+/**
+ * (Re)allocate the frequency sketch for max_entries keys, forgetting the
+ * frequencies counted so far
+ */
+static int lru_cache_sketch_create(cache_manager_t* cache) {
+    size_t width = 64;
+    while (width < (size_t)cache->max_entries) {
+        width <<= 1;
+    }
+    uint8_t* sketch = uvhttp_alloc(LRU_CACHE_SKETCH_DEPTH * width);
+    if (!sketch) {
+        return -1;
+    }
+    memset(sketch, 0, LRU_CACHE_SKETCH_DEPTH * width);
+    uvhttp_free(cache->sketch);
+    cache->sketch = sketch;
+    cache->sketch_width = width;
+    cache->sketch_additions = 0;
+    cache->sketch_sample = (int)width * UVHTTP_CACHE_TINYLFU_SAMPLE_FACTOR;
+    return 0;
+}
+
+/**
+ * Counter of hash in row: the rows index with independent functions
+ * derived from one 64-bit mix of the hash
+ */
+static uint8_t* lru_cache_sketch_counter(cache_manager_t* cache,
+                                         unsigned hash, int row) {
+    uint64_t mixed = (uint64_t)hash * 0x9E3779B97F4A7C15ULL;
+    uint32_t h1 = (uint32_t)mixed;
+    uint32_t h2 = (uint32_t)(mixed >> 32) | 1;
+    size_t column = (h1 + (uint32_t)row * h2) & (cache->sketch_width - 1);
+    return &cache->sketch[(size_t)row * cache->sketch_width + column];
+}
+
+/**
+ * Estimated number of recent lookups of hash
+ */
+static int lru_cache_sketch_frequency(cache_manager_t* cache, unsigned hash) {
+    int frequency = LRU_CACHE_SKETCH_MAX;
+    for (int row = 0; row < LRU_CACHE_SKETCH_DEPTH; row++) {
+        int count = *lru_cache_sketch_counter(cache, hash, row);
+        if (count < frequency) {
+            frequency = count;
+        }
+    }
+    return frequency;
+}
+
+/**
+ * Count a lookup of hash: only the smallest counters grow (conservative
+ * update), and all are halved once the sample is full
+ */
+static void lru_cache_sketch_increment(cache_manager_t* cache, unsigned hash) {
+    int frequency = lru_cache_sketch_frequency(cache, hash);
+    if (frequency == LRU_CACHE_SKETCH_MAX) {
+        return;
+    }
+    for (int row = 0; row < LRU_CACHE_SKETCH_DEPTH; row++) {
+        uint8_t* counter = lru_cache_sketch_counter(cache, hash, row);
+        if (*counter == frequency) {
+            (*counter)++;
+        }
+    }
+    if (++cache->sketch_additions >= cache->sketch_sample) {
+        for (size_t i = 0; i < LRU_CACHE_SKETCH_DEPTH * cache->sketch_width;
+             i++) {
+            cache->sketch[i] >>= 1;
+        }
+        cache->sketch_additions /= 2;
+    }
+}
+
+/**
+ * Memory the entries may use
+ */
+static size_t lru_cache_capacity(const cache_manager_t* cache) {
+    return (size_t)(cache->max_memory_usage * 0.9);
+}
+
+/**
+ * Whether the cache holds more than it may
+ */
+static int lru_cache_over_capacity(const cache_manager_t* cache) {
+    return cache->total_memory_usage > lru_cache_capacity(cache) ||
+           (cache->max_entries > 0 && cache->entry_count > cache->max_entries);
+}
+
+/**
+ * W-TinyLFU budgets: the window's share of the cache and the protected
+ * segment's share of the rest
+ */
+static size_t lru_cache_window_memory(const cache_manager_t* cache) {
+    return lru_cache_capacity(cache) * UVHTTP_CACHE_TINYLFU_WINDOW_PERCENT /
+           100;
+}
+
+static int lru_cache_window_entries(const cache_manager_t* cache) {
+    int entries =
+        cache->max_entries * UVHTTP_CACHE_TINYLFU_WINDOW_PERCENT / 100;
+    return entries > 0 ? entries : 1;
+}
+
+static int lru_cache_window_full(const cache_manager_t* cache) {
+    size_t memory_usage = cache->total_memory_usage -
+                          cache->probation.memory_usage -
+                          cache->protected_segment.memory_usage;
+    int entry_count = cache->entry_count - cache->probation.entry_count -
+                      cache->protected_segment.entry_count;
+    return memory_usage > lru_cache_window_memory(cache) ||
+           (cache->max_entries > 0 &&
+            entry_count > lru_cache_window_entries(cache));
+}
+
+static int lru_cache_protected_full(const cache_manager_t* cache) {
+    size_t memory_usage =
+        (lru_cache_capacity(cache) - lru_cache_window_memory(cache)) *
+        UVHTTP_CACHE_TINYLFU_PROTECTED_PERCENT / 100;
+    int entry_count =
+        (cache->max_entries - lru_cache_window_entries(cache)) *
+        UVHTTP_CACHE_TINYLFU_PROTECTED_PERCENT / 100;
+    return cache->protected_segment.memory_usage > memory_usage ||
+           (cache->max_entries > 0 &&
+            cache->protected_segment.entry_count > entry_count);
+}
+
+/**
+ * W-TinyLFU hit: a probation entry is promoted to the protected segment,
+ * whose least recently used entries go back on probation
+ */
+static void lru_cache_tinylfu_hit(cache_manager_t* cache,
+                                  cache_entry_t* entry) {
+    lru_cache_unlink(cache, entry);
+    if (entry->segment == UVHTTP_CACHE_SEGMENT_PROBATION) {
+        entry->segment = UVHTTP_CACHE_SEGMENT_PROTECTED;
+    }
+    lru_cache_link(cache, entry);
+
+    while (lru_cache_protected_full(cache) &&
+           cache->protected_segment.tail != entry) {
+        cache_entry_t* demoted = cache->protected_segment.tail;
+        lru_cache_unlink(cache, demoted);
+        demoted->segment = UVHTTP_CACHE_SEGMENT_PROBATION;
+        lru_cache_link(cache, demoted);
+    }
+}
+
+/**
+ * W-TinyLFU admission: the window's overflow moves on probation, then while
+ * the cache is over capacity each candidate from the window is compared
+ * with the probation victim, and the one looked up less often is evicted
+ */
+static void lru_cache_tinylfu_evict(cache_manager_t* cache) {
+    cache_entry_t* candidate = NULL;
+    while (lru_cache_window_full(cache) && cache->lru_tail) {
+        cache_entry_t* entry = cache->lru_tail;
+        lru_cache_unlink(cache, entry);
+        entry->segment = UVHTTP_CACHE_SEGMENT_PROBATION;
+        lru_cache_link(cache, entry);
+        if (!candidate) {
+            candidate = entry; /* the oldest of those moved */
+        }
+    }
+
+    while (lru_cache_over_capacity(cache)) {
+        cache_entry_t* victim = cache->probation.tail;
+        if (!victim) {
+            victim = cache->protected_segment.tail;
+        }
+        if (!victim) {
+            victim = cache->lru_tail;
+        }
+        if (!victim) {
+            break;
+        }
+
+        cache_entry_t* evicted = victim;
+        if (candidate && candidate != victim &&
+            lru_cache_sketch_frequency(cache, candidate->hash) <=
+                lru_cache_sketch_frequency(cache, victim->hash)) {
+            evicted = candidate; /* not admitted */
+        }
+        if (candidate == evicted || candidate == victim) {
+            candidate = candidate->lru_prev;
+        }
+        lru_cache_evict(cache, evicted);
     }
 }
 
+/**
+ * Intern a MIME type: the entries of a type share one copy
+ */
+static const char* lru_cache_intern_mime_type(cache_manager_t* cache,
+                                              const char* mime_type) {
+    if (!mime_type) {
+        return "application/octet-stream";
+    }
+    for (int i = 0; i < cache->mime_type_count; i++) {
+        if (strcmp(cache->mime_types[i], mime_type) == 0) {
+            return cache->mime_types[i];
+        }
+    }
+
+    if (cache->mime_type_count == cache->mime_type_capacity) {
+        int capacity =
+            cache->mime_type_capacity > 0 ? cache->mime_type_capacity * 2 : 16;
+        char** types =
+            uvhttp_realloc(cache->mime_types, sizeof(char*) * (size_t)capacity);
+        if (!types) {
+            return NULL;
+        }
+        cache->mime_types = types;
+        cache->mime_type_capacity = capacity;
+    }
+    size_t length = strlen(mime_type);
+    char* copy = uvhttp_alloc(length + 1);
+    if (!copy) {
+        return NULL;
+    }
+    memcpy(copy, mime_type, length + 1);
+    cache->mime_types[cache->mime_type_count++] = copy;
+    return copy;
+}
+
 /**
  * Create LRU cache manager
  */
@@ -93,17 +429,175 @@ uvhttp_error_t uvhttp_lru_cache_create(size_t max_memory_usage, int max_entries,
     return UVHTTP_OK;
 }
 
+uvhttp_cache_buffer_t* uvhttp_cache_buffer_create(size_t length) {
+    if (length > SIZE_MAX - sizeof(uvhttp_cache_buffer_t)) {
+        return NULL;
+    }
+    uvhttp_cache_buffer_t* buffer =
+        uvhttp_alloc(sizeof(uvhttp_cache_buffer_t) + length);
+    if (!buffer) {
+        return NULL;
+    }
+    buffer->refcount = 1;
+    buffer->mapped = 0;
+    buffer->length = length;
+    buffer->body = NULL;
+    buffer->data = buffer->inline_data;
+    buffer->data[length] = '\0';
+    return buffer;
+}
+
+uvhttp_cache_buffer_t* uvhttp_cache_buffer_map(int fd, size_t length,
+                                               int populate) {
+    if (fd < 0 || length == 0) {
+        return NULL;
+    }
+    uvhttp_cache_buffer_t* buffer = uvhttp_alloc(sizeof(uvhttp_cache_buffer_t));
+    if (!buffer) {
+        return NULL;
+    }
+    int flags = MAP_PRIVATE;
+#    ifdef MAP_POPULATE
+    if (populate) {
+        flags |= MAP_POPULATE;
+    }
+#    endif
+    void* data = mmap(NULL, length, PROT_READ, flags, fd, 0);
+    if (data == MAP_FAILED) {
+        UVHTTP_LOG_WARN("Failed to map file: %zu bytes", length);
+        uvhttp_free(buffer);
+        return NULL;
+    }
+    if (!populate) {
+        madvise(data, length, MADV_WILLNEED);
+    }
+    buffer->refcount = 1;
+    buffer->mapped = 1;
+    buffer->length = length;
+    buffer->body = NULL;
+    buffer->data = (char*)data;
+    buffer->inline_data[0] = '\0';
+    return buffer;
+}
+
+/* references may be taken and dropped by the loops sharing a cache */
+void uvhttp_cache_buffer_retain(uvhttp_cache_buffer_t* buffer) {
+    __atomic_fetch_add(&buffer->refcount, 1, __ATOMIC_RELAXED);
+}
+
+void uvhttp_cache_buffer_release(uvhttp_cache_buffer_t* buffer) {
+    if (buffer &&
+        __atomic_sub_fetch(&buffer->refcount, 1, __ATOMIC_ACQ_REL) == 0) {
+        uvhttp_cache_buffer_release(buffer->body);
+        if (buffer->mapped) {
+            munmap(buffer->data, buffer->length);
+        }
+        uvhttp_free(buffer);
+    }
+}
+
 /**
- * Free cache entry
+ * Count length more (or, with dropped, fewer) bytes held by entry
  */
-static void free_cache_entry(cache_entry_t* entry) {
-    if (!entry)
+static void lru_cache_charge(cache_manager_t* cache, cache_entry_t* entry,
+                             size_t length, int dropped) {
+    uvhttp_cache_segment_t* segment = lru_cache_segment(cache, entry);
+    if (dropped) {
+        entry->memory_usage -= length;
+        cache->total_memory_usage -= length;
+        if (segment) {
+            segment->memory_usage -= length;
+        }
+    } else {
+        entry->memory_usage += length;
+        cache->total_memory_usage += length;
+        if (segment) {
+            segment->memory_usage += length;
+        }
+    }
+}
+
+/**
+ * Put head into *slot (replacing any) as the head of body
+ */
+static void lru_cache_attach_head(cache_manager_t* cache, cache_entry_t* entry,
+                                  uvhttp_cache_buffer_t** slot,
+                                  size_t* slot_keepalive_length,
+                                  uvhttp_cache_buffer_t* body,
+                                  uvhttp_cache_buffer_t* head,
+                                  size_t keepalive_length) {
+    if (*slot) {
+        lru_cache_charge(cache, entry, (*slot)->length, 1);
+        uvhttp_cache_buffer_release(*slot);
+    }
+    /* the head stays valid for as long as the content it describes */
+    if (!head->body) {
+        uvhttp_cache_buffer_retain(body);
+        head->body = body;
+    }
+    *slot = head;
+    *slot_keepalive_length = keepalive_length;
+    lru_cache_charge(cache, entry, head->length, 0);
+}
+
+void uvhttp_lru_cache_set_head(cache_manager_t* cache, cache_entry_t* entry,
+                               uvhttp_cache_buffer_t* head,
+                               size_t keepalive_length) {
+    if (!cache || !entry || !head) {
         return;
+    }
+    lru_cache_attach_head(cache, entry, &entry->head,
+                          &entry->head_keepalive_length, entry->buffer, head,
+                          keepalive_length);
+}
 
-    if (entry->content) {
-        uvhttp_free(entry->content);
+int uvhttp_lru_cache_claim_variant(cache_entry_t* entry,
+                                   uvhttp_cache_encoding_t encoding) {
+    if (!entry || encoding < 0 || encoding >= UVHTTP_CACHE_ENCODING_COUNT) {
+        return 0;
     }
-    uvhttp_free(entry);
+    unsigned bit = 1u << encoding;
+    if (entry->encodings_tried & bit) {
+        return 0;
+    }
+    entry->encodings_tried |= bit;
+    return 1;
+}
+
+void uvhttp_lru_cache_set_variant(cache_manager_t* cache, cache_entry_t* entry,
+                                  uvhttp_cache_encoding_t encoding,
+                                  uvhttp_cache_buffer_t* buffer) {
+    if (!cache || !entry || encoding < 0 ||
+        encoding >= UVHTTP_CACHE_ENCODING_COUNT) {
+        return;
+    }
+    entry->encodings_tried |= 1u << encoding;
+    if (!buffer || entry->variants[encoding].buffer) {
+        return;
+    }
+    uvhttp_cache_buffer_retain(buffer);
+    entry->variants[encoding].buffer = buffer;
+    lru_cache_charge(cache, entry, buffer->length, 0);
+}
+
+void uvhttp_lru_cache_set_variant_head(cache_manager_t* cache,
+                                       cache_entry_t* entry,
+                                       uvhttp_cache_encoding_t encoding,
+                                       uvhttp_cache_buffer_t* head,
+                                       size_t keepalive_length) {
+    if (!head) {
+        return;
+    }
+    if (!cache || !entry || encoding < 0 ||
+        encoding >= UVHTTP_CACHE_ENCODING_COUNT ||
+        !entry->variants[encoding].buffer) {
+        uvhttp_cache_buffer_release(head);
+        return;
+    }
+    uvhttp_cache_variant_t* variant = &entry->variants[encoding];
+    lru_cache_attach_head(cache, entry, &variant->head,
+                          &variant->head_keepalive_length, variant->buffer,
+                          head, keepalive_length);
 }
 
 /**
@@ -118,6 +612,12 @@ void uvhttp_lru_cache_free(cache_manager_t* cache) {
 
     uvhttp_lru_cache_clear(cache);
 
+    for (int i = 0; i < cache->mime_type_count; i++) {
+        uvhttp_free(cache->mime_types[i]);
+    }
+    uvhttp_free(cache->mime_types);
+    uvhttp_free(cache->sketch);
+
     /* Single-threaded version: no need to destroy lock */
 
     uvhttp_free(cache);
@@ -138,11 +638,13 @@ cache_entry_t* uvhttp_lru_cache_find(cache_manager_t* cache,
 
     UVHTTP_LOG_DEBUG("Looking up cache entry: %s", file_path);
 
-    cache_entry_t* entry = NULL;
-
     /* single-thread version: no need to add locks */
 
-    HASH_FIND_STR(cache->hash_table, file_path, entry);
+    unsigned hash = lru_cache_hash(file_path, strlen(file_path));
+    cache_entry_t* entry = lru_cache_lookup(cache, file_path, hash);
+    if (cache->policy == UVHTTP_CACHE_POLICY_TINYLFU) {
+        lru_cache_sketch_increment(cache, hash);
+    }
 
     if (entry) {
         /* check if expired */
@@ -168,6 +670,18 @@ cache_entry_t* uvhttp_lru_cache_find(cache_manager_t* cache,
     return NULL;
 }
 
+/**
+ * Find cache entry without counting it as a use
+ */
+cache_entry_t* uvhttp_lru_cache_peek(cache_manager_t* cache,
+                                     const char* file_path) {
+    if (!cache || !file_path) {
+        return NULL;
+    }
+    return lru_cache_lookup(cache, file_path,
+                            lru_cache_hash(file_path, strlen(file_path)));
+}
+
 /**
  * move entry to LRU list header
  */
@@ -176,6 +690,11 @@ void uvhttp_lru_cache_move_to_head(cache_manager_t* cache,
     if (!cache || !entry)
         return;
 
+    if (cache->policy == UVHTTP_CACHE_POLICY_TINYLFU) {
+        lru_cache_tinylfu_hit(cache, entry);
+        return;
+    }
+
     /* if already header, no need to move */
     if (entry == cache->lru_head)
         return;
@@ -234,6 +753,21 @@ void uvhttp_lru_cache_move_to_head(cache_manager_t* cache,
  * remove entry from LRU list tail
  */
 cache_entry_t* uvhttp_lru_cache_remove_tail(cache_manager_t* cache) {
+    if (cache && cache->policy == UVHTTP_CACHE_POLICY_TINYLFU) {
+        /* probation first, the protected segment last */
+        cache_entry_t* entry = cache->probation.tail;
+        if (!entry) {
+            entry = cache->lru_tail;
+        }
+        if (!entry) {
+            entry = cache->protected_segment.tail;
+        }
+        if (entry) {
+            lru_cache_unlink(cache, entry);
+        }
+        return entry;
+    }
+
     if (!cache || !cache->lru_tail)
         return NULL;
 
@@ -261,6 +795,10 @@ cache_entry_t* uvhttp_lru_cache_remove_tail(cache_manager_t* cache) {
  * Skips entries with priority >= min_priority_threshold
  */
 cache_entry_t* uvhttp_lru_cache_remove_lowest_priority(cache_manager_t* cache) {
+    if (cache && cache->policy == UVHTTP_CACHE_POLICY_TINYLFU) {
+        return uvhttp_lru_cache_remove_tail(cache);
+    }
+
     if (!cache || !cache->lru_tail)
         return NULL;
 
@@ -352,29 +890,98 @@ uvhttp_error_t uvhttp_lru_cache_put(cache_manager_t* cache,
         return UVHTTP_ERROR_INVALID_PARAM;
     }
 
-    /* calculate memory usage, check integer overflow */
-    if (content_length > SIZE_MAX - sizeof(cache_entry_t)) {
+    /* allocate and copy content */
+    uvhttp_cache_buffer_t* buffer = uvhttp_cache_buffer_create(content_length);
+    if (!buffer) {
+        UVHTTP_LOG_ERROR("Failed to allocate content buffer: size=%zu",
+                         content_length);
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    memcpy(buffer->data, content, content_length);
+
+    uvhttp_error_t result = uvhttp_lru_cache_put_buffer(
+        cache, file_path, buffer, mime_type, last_modified, etag);
+    uvhttp_cache_buffer_release(buffer);
+    return result;
+}
+
+/**
+ * add or update cache entry sharing buffer - single-thread version
+ */
+uvhttp_error_t uvhttp_lru_cache_put_buffer(cache_manager_t* cache,
+                                           const char* file_path,
+                                           uvhttp_cache_buffer_t* buffer,
+                                           const char* mime_type,
+                                           time_t last_modified,
+                                           const char* etag) {
+    if (!cache || !file_path || !buffer) {
+        UVHTTP_LOG_WARN(
+            "Invalid cache add parameters: cache=%p, file_path=%p, buffer=%p",
+            cache, file_path, buffer);
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    size_t content_length = buffer->length;
+
+    /* check if file size exceeds limit */
+    if (content_length > cache->max_file_size) {
+        UVHTTP_LOG_WARN("File size exceeds limit: %s (size: %zu, limit: %zu)",
+                        file_path, content_length, cache->max_file_size);
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    /* verify file path length, prevent buffer overflow */
+    size_t key_length = strlen(file_path);
+    if (key_length >= UVHTTP_MAX_FILE_PATH_SIZE) {
+        UVHTTP_LOG_ERROR("File path too long: %s (max: %d)", file_path,
+                         UVHTTP_MAX_FILE_PATH_SIZE - 1);
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    if (etag && strlen(etag) >= UVHTTP_CACHE_ETAG_SIZE) {
+        UVHTTP_LOG_WARN("ETag too long to cache: %s", file_path);
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    const char* interned_mime_type =
+        lru_cache_intern_mime_type(cache, mime_type);
+    if (!interned_mime_type) {
+        uvhttp_handle_memory_failure("cache_mime_type", NULL, NULL);
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+
+    /* calculate memory usage (header, key, content), check integer
+     * overflow */
+    size_t entry_size = sizeof(cache_entry_t) + key_length;
+    if (content_length > SIZE_MAX - entry_size) {
         UVHTTP_LOG_ERROR(
             "Content length too large: %zu (causes integer overflow)",
             content_length);
         return UVHTTP_ERROR_INVALID_PARAM;
     }
-    size_t memory_usage = sizeof(cache_entry_t) + content_length;
+    size_t memory_usage = entry_size + content_length;
 
     UVHTTP_LOG_DEBUG("Adding cache entry: %s (size: %zu, type: %s)", file_path,
                      content_length, mime_type ? mime_type : "unknown");
 
     /* single-thread version: no need to add locks */
 
+    /* W-TinyLFU makes room once the entry is in, by admission */
+    if (cache->policy == UVHTTP_CACHE_POLICY_TINYLFU &&
+        memory_usage > lru_cache_capacity(cache)) {
+        UVHTTP_LOG_WARN("Entry larger than the cache: %s (size: %zu)",
+                        file_path, memory_usage);
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+
     /* check if need to evict entries - batch eviction optimization */
     int eviction_count = 0;
     int batch_size = cache->batch_eviction_size;
 
     while (
-        (cache->max_memory_usage > 0 &&
+        cache->policy == UVHTTP_CACHE_POLICY_LRU &&
+        ((cache->max_memory_usage > 0 &&
          cache->total_memory_usage + memory_usage >
              cache->max_memory_usage * 0.9) ||
-        (cache->max_entries > 0 && cache->entry_count >= cache->max_entries)) {
+         (cache->max_entries > 0 &&
+          cache->entry_count >= cache->max_entries))) {
 
         /* if cache is null but still need to evict, it means cannot satisfy
          * condition, return error */
@@ -444,20 +1051,27 @@ uvhttp_error_t uvhttp_lru_cache_put(cache_manager_t* cache,
 
     /* find if already exists */
     cache_entry_t* entry = NULL;
-    HASH_FIND_STR(cache->hash_table, file_path, entry);
+    unsigned hash = lru_cache_hash(file_path, key_length);
+    HASH_FIND_BYHASHVALUE(hh, cache->hash_table, file_path, key_length, hash,
+                          entry);
 
     if (entry) {
         /* updateexistingentry */
         UVHTTP_LOG_DEBUG(
             "Updating existing cache entry: %s (old size: %zu, new size: %zu)",
             file_path, entry->content_length, content_length);
-        uvhttp_free(entry->content);
+        lru_cache_release_content(entry);
+        entry->content = NULL;
+        entry->content_length = 0;
+        if (cache->policy == UVHTTP_CACHE_POLICY_TINYLFU) {
+            lru_cache_unlink(cache, entry); /* relinked as resized */
+        }
 
         /* update memory usage */
         cache->total_memory_usage -= entry->memory_usage;
     } else {
-        /* create new entry */
-        entry = uvhttp_alloc(sizeof(cache_entry_t));
+        /* create new entry: the key is stored after the header */
+        entry = uvhttp_alloc(entry_size);
         if (!entry) {
             UVHTTP_LOG_ERROR(
                 "Failed to create cache entry: memory allocation error");
@@ -465,47 +1079,31 @@ uvhttp_error_t uvhttp_lru_cache_put(cache_manager_t* cache,
             return UVHTTP_ERROR_OUT_OF_MEMORY;
         }
 
-        memset(entry, 0, sizeof(cache_entry_t));
+        memset(entry, 0, entry_size);
 
         /* Set default priority */
         entry->priority = 0; /* Default: lowest priority */
 
-        /* verify file path length, prevent buffer overflow */
-        if (strlen(file_path) >= sizeof(entry->file_path)) {
-            UVHTTP_LOG_ERROR("File path too long: %s (max: %zu)", file_path,
-                             sizeof(entry->file_path) - 1);
-            uvhttp_free(entry);
-            return UVHTTP_ERROR_INVALID_PARAM;
-        }
-
-        uvhttp_safe_strncpy(entry->file_path, file_path, sizeof(entry->file_path));
+        memcpy(entry->file_path, file_path, key_length + 1);
+        entry->hash = hash;
+        entry->segment = UVHTTP_CACHE_SEGMENT_WINDOW;
 
         /* initializeLRUlistpointer */
         entry->lru_prev = NULL;
         entry->lru_next = NULL;
 
         /* add to hash table */
-        HASH_ADD_STR(cache->hash_table, file_path, entry);
+        HASH_ADD_KEYPTR_BYHASHVALUE(hh, cache->hash_table, entry->file_path,
+                                    key_length, hash, entry);
         cache->entry_count++;
 
         UVHTTP_LOG_DEBUG("Created new cache entry: %s", file_path);
     }
 
-    /* allocate and copy content */
-    entry->content = (char*)uvhttp_alloc(content_length + 1);
-    if (!entry->content) {
-        UVHTTP_LOG_ERROR("Failed to allocate content buffer: size=%zu",
-                         content_length);
-        if (!entry->file_path[0]) {
-            /* new entry, need to remove from hash table and release */
-            HASH_DEL(cache->hash_table, entry);
-            cache->entry_count--;
-            uvhttp_free(entry);
-        }
-        return UVHTTP_ERROR_OUT_OF_MEMORY;
-    }
-    memcpy(entry->content, content, content_length);
-    entry->content[content_length] = '\0';
+    /* share content */
+    uvhttp_cache_buffer_retain(buffer);
+    entry->buffer = buffer;
+    entry->content = buffer->data;
 
     /* setentrycontent */
     entry->content_length = content_length;
@@ -513,14 +1111,27 @@ uvhttp_error_t uvhttp_lru_cache_put(cache_manager_t* cache,
     entry->last_modified = last_modified;
     entry->access_time = get_current_time();
     entry->cache_time = entry->access_time;
-    entry->is_compressed = 0;
 
     /* Set entry metadata */
-    set_cache_entry_metadata(entry, mime_type, etag);
+    entry->mime_type = interned_mime_type;
+    if (etag) {
+        memcpy(entry->etag, etag, strlen(etag) + 1);
+    } else {
+        entry->etag[0] = '\0';
+    }
 
     /* update memory usage */
     cache->total_memory_usage += memory_usage;
 
+    if (cache->policy == UVHTTP_CACHE_POLICY_TINYLFU) {
+        /* a new entry enters the window; a full cache then admits by
+         * frequency, which may evict this very entry */
+        lru_cache_link(cache, entry);
+        lru_cache_sketch_increment(cache, hash);
+        lru_cache_tinylfu_evict(cache);
+        return UVHTTP_OK;
+    }
+
     /* move to LRU header */
     uvhttp_lru_cache_move_to_head(cache, entry);
 
@@ -547,12 +1158,12 @@ uvhttp_error_t uvhttp_lru_cache_remove(cache_manager_t* cache,
 
     /* single-thread version: no need to add locks */
 
-    cache_entry_t* entry = NULL;
-    HASH_FIND_STR(cache->hash_table, file_path, entry);
+    cache_entry_t* entry = lru_cache_lookup(
+        cache, file_path, lru_cache_hash(file_path, strlen(file_path)));
 
     if (!entry) {
-        UVHTTP_LOG_WARN("Attempting to remove non-existent cache entry: %s",
-                        file_path);
+        UVHTTP_LOG_DEBUG("Attempting to remove non-existent cache entry: %s",
+                         file_path);
         return UVHTTP_ERROR_NOT_FOUND;
     }
 
@@ -560,17 +1171,7 @@ uvhttp_error_t uvhttp_lru_cache_remove(cache_manager_t* cache,
     HASH_DEL(cache->hash_table, entry);
 
     /* remove from LRU list */
-    if (entry->lru_prev) {
-        entry->lru_prev->lru_next = entry->lru_next;
-    } else {
-        cache->lru_head = entry->lru_next;
-    }
-
-    if (entry->lru_next) {
-        entry->lru_next->lru_prev = entry->lru_prev;
-    } else {
-        cache->lru_tail = entry->lru_prev;
-    }
+    lru_cache_unlink(cache, entry);
 
     /* updatestatistics */
     cache->total_memory_usage -= entry->memory_usage;
@@ -612,6 +1213,8 @@ void uvhttp_lru_cache_clear(cache_manager_t* cache) {
     cache->hash_table = NULL;
     cache->lru_head = NULL;
     cache->lru_tail = NULL;
+    memset(&cache->probation, 0, sizeof(cache->probation));
+    memset(&cache->protected_segment, 0, sizeof(cache->protected_segment));
     cache->total_memory_usage = 0;
     cache->entry_count = 0;
 
@@ -687,6 +1290,10 @@ void uvhttp_lru_cache_set_max_entries(cache_manager_t* cache, int max_entries) {
         return;
 
     cache->max_entries = max_entries;
+    if (cache->policy == UVHTTP_CACHE_POLICY_TINYLFU &&
+        lru_cache_sketch_create(cache) != 0) {
+        UVHTTP_LOG_WARN("Failed to resize the cache frequency sketch");
+    }
 }
 
 /**
@@ -735,10 +1342,8 @@ int uvhttp_lru_cache_cleanup_expired(cache_manager_t* cache) {
     size_t freed_memory = 0;
     time_t now = time(NULL);
 
-    cache_entry_t* entry = cache->lru_tail;
-    while (entry) {
-        cache_entry_t* next = entry->lru_prev;
-
+    cache_entry_t *entry, *tmp;
+    HASH_ITER(hh, cache->hash_table, entry, tmp) {
         if ((now - entry->cache_time) > cache->cache_ttl) {
             UVHTTP_LOG_DEBUG(
                 "Cleaning up expired entry: %s (expired %ld seconds ago)",
@@ -748,17 +1353,7 @@ int uvhttp_lru_cache_cleanup_expired(cache_manager_t* cache) {
             HASH_DEL(cache->hash_table, entry);
 
             /* remove from LRU list */
-            if (entry->lru_prev) {
-                entry->lru_prev->lru_next = entry->lru_next;
-            } else {
-                cache->lru_tail = entry->lru_next;
-            }
-
-            if (entry->lru_next) {
-                entry->lru_next->lru_prev = entry->lru_prev;
-            } else {
-                cache->lru_head = entry->lru_prev;
-            }
+            lru_cache_unlink(cache, entry);
 
             /* updatestatistics */
             cache->total_memory_usage -= entry->memory_usage;
@@ -769,8 +1364,6 @@ int uvhttp_lru_cache_cleanup_expired(cache_manager_t* cache) {
             /* releasememory */
             free_cache_entry(entry);
         }
-
-        entry = next;
     }
 
     if (cleaned_count > 0) {
@@ -804,6 +1397,58 @@ double uvhttp_lru_cache_get_hit_rate(cache_manager_t* cache) {
     return hit_rate;
 }
 
+/**
+ * set cache policy
+ */
+uvhttp_error_t uvhttp_lru_cache_set_policy(cache_manager_t* cache,
+                                           uvhttp_cache_policy_t policy) {
+    if (!cache || (policy != UVHTTP_CACHE_POLICY_LRU &&
+                   policy != UVHTTP_CACHE_POLICY_TINYLFU)) {
+        UVHTTP_LOG_ERROR("Failed to set cache policy: invalid parameters");
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    if (policy == cache->policy) {
+        return UVHTTP_OK;
+    }
+
+    if (policy == UVHTTP_CACHE_POLICY_TINYLFU) {
+        if (lru_cache_sketch_create(cache) != 0) {
+            uvhttp_handle_memory_failure("cache_sketch", NULL, NULL);
+            return UVHTTP_ERROR_OUT_OF_MEMORY;
+        }
+        /* the entries so far make up the window: its overflow goes on
+         * probation */
+        cache->policy = policy;
+        lru_cache_tinylfu_evict(cache);
+    } else {
+        /* one list again: the protected entries, then those on probation,
+         * behind the window */
+        uvhttp_cache_segment_t* segments[] = {&cache->protected_segment,
+                                              &cache->probation};
+        for (size_t i = 0; i < sizeof(segments) / sizeof(segments[0]); i++) {
+            while (segments[i]->head) {
+                cache_entry_t* entry = segments[i]->head;
+                lru_cache_unlink(cache, entry);
+                entry->segment = UVHTTP_CACHE_SEGMENT_WINDOW;
+                entry->lru_prev = cache->lru_tail;
+                if (cache->lru_tail) {
+                    cache->lru_tail->lru_next = entry;
+                } else {
+                    cache->lru_head = entry;
+                }
+                cache->lru_tail = entry;
+            }
+        }
+        uvhttp_free(cache->sketch);
+        cache->sketch = NULL;
+        cache->policy = policy;
+    }
+
+    UVHTTP_LOG_INFO("Cache policy set to %s",
+                    policy == UVHTTP_CACHE_POLICY_TINYLFU ? "W-TinyLFU" : "LRU");
+    return UVHTTP_OK;
+}
+
 /**
  * set eviction callback
  */
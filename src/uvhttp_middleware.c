@@ -0,0 +1,79 @@
+#include "uvhttp_middleware.h"
+
+#include <string.h>
+
+/* end the pipeline: cleanup first (as the macro chains do), then done when
+ * every middleware continued. ctx is idle again before done runs, so done
+ * may start the next pipeline on it; done sees a copy. */
+static void middleware_finish(uvhttp_middleware_context_t* ctx, int proceed) {
+    if (ctx->cleanup) {
+        ctx->cleanup(ctx->data);
+    }
+    uvhttp_middleware_context_t finished = *ctx;
+    memset(ctx, 0, sizeof(*ctx));
+
+    if (proceed && finished.done) {
+        finished.data = NULL;
+        finished.cleanup = NULL;
+        finished.chain = NULL;
+        finished.done(&finished);
+    }
+}
+
+static void middleware_run(uvhttp_middleware_context_t* ctx) {
+    while (ctx->next < ctx->chain_count) {
+        uvhttp_middleware_handler_t middleware = ctx->chain[ctx->next++];
+        int result = middleware(ctx->request, ctx->response, ctx);
+        if (result == UVHTTP_MIDDLEWARE_ASYNC) {
+            return;
+        }
+        if (result != UVHTTP_MIDDLEWARE_CONTINUE) {
+            middleware_finish(ctx, 0);
+            return;
+        }
+    }
+    middleware_finish(ctx, 1);
+}
+
+void uvhttp_middleware_start(uvhttp_middleware_context_t* ctx,
+                             uvhttp_request_t* request,
+                             uvhttp_response_t* response,
+                             const uvhttp_middleware_handler_t* chain,
+                             size_t count, uvhttp_request_handler_t handler,
+                             void (*done)(uvhttp_middleware_context_t* ctx),
+                             void* done_data) {
+    if (!ctx) {
+        return;
+    }
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->request = request;
+    ctx->response = response;
+    ctx->handler = handler;
+    ctx->done = done;
+    ctx->done_data = done_data;
+
+    if (!chain || count == 0) {
+        middleware_finish(ctx, 1);
+        return;
+    }
+    ctx->chain = chain;
+    ctx->chain_count = count;
+    middleware_run(ctx);
+}
+
+void uvhttp_middleware_resume(uvhttp_middleware_context_t* ctx, int result) {
+    if (!ctx || !ctx->chain || result == UVHTTP_MIDDLEWARE_ASYNC) {
+        return;
+    }
+    if (result != UVHTTP_MIDDLEWARE_CONTINUE) {
+        middleware_finish(ctx, 0);
+        return;
+    }
+    middleware_run(ctx);
+}
+
+void uvhttp_middleware_cancel(uvhttp_middleware_context_t* ctx) {
+    if (ctx && ctx->chain) {
+        middleware_finish(ctx, 0);
+    }
+}
@@ -0,0 +1,471 @@
+/* UVHTTP open-file cache - what static cache misses found on disk, dropped
+ * when the directories they were found in change (uv_fs_event_t) or after a
+ * TTL. Single-threaded; see uvhttp_open_file_cache.h for the contract.
+ */
+
+#if UVHTTP_FEATURE_STATIC_FILES
+
+#    include "uvhttp_open_file_cache.h"
+
+#    include "uvhttp_allocator.h"
+#    include "uvhttp_constants.h"
+#    include "uvhttp_hash.h"
+
+#    include <fcntl.h>
+#    include <string.h>
+#    include <unistd.h>
+
+/* One watched directory, shared by the entries found in it */
+typedef struct ofc_watch ofc_watch_t;
+struct ofc_watch {
+    uv_fs_event_t handle;
+    uvhttp_open_file_cache_t* cache;
+    ofc_watch_t* next;
+    size_t refs;
+    char dir[]; /* NUL-terminated */
+};
+
+typedef struct ofc_entry ofc_entry_t;
+struct ofc_entry {
+    uvhttp_open_file_t file; /* first: the public view of the entry */
+    ofc_entry_t* hash_next;
+    ofc_entry_t* lru_prev; /* towards the most recently used */
+    ofc_entry_t* lru_next;
+    uint64_t hash;
+    uint64_t expires; /* uv_now() of the cache's loop, ms */
+    /* [0]: directory of the resolved file (none for negative entries),
+     * [1]: directory of the requested path; NULL if it could not be watched.
+     * name[i] is the entry's file name within watch[i]. */
+    ofc_watch_t* watch[2];
+    const char* name[2];
+    char* path;
+    char key[]; /* NUL-terminated */
+};
+
+struct uvhttp_open_file_cache {
+    ofc_entry_t** buckets;
+    size_t bucket_mask;
+    ofc_entry_t* lru_head;
+    ofc_entry_t* lru_tail;
+    ofc_watch_t* watches;
+    uv_loop_t* loop; /* of the first insert; watches and TTLs use it */
+    size_t count;
+    size_t max_entries;
+    size_t open_fds;
+    size_t max_fds;
+    size_t watch_count;
+    uint64_t ttl_ms;
+    uvhttp_open_file_invalidate_cb on_invalidate;
+    void* on_invalidate_data;
+    uint64_t hits;
+    uint64_t negative_hits;
+    uint64_t misses;
+    uint64_t invalidations;
+};
+
+static uint64_t ofc_hash(const char* key) {
+    return uvhttp_hash_string_default(key);
+}
+
+static uint64_t ofc_now(const uvhttp_open_file_cache_t* cache) {
+    return cache->loop ? uv_now(cache->loop) : 0;
+}
+
+/* ========== watches ========== */
+
+static void ofc_invalidate_in(uvhttp_open_file_cache_t* cache,
+                              const ofc_watch_t* watch, const char* filename);
+
+static void ofc_watch_closed(uv_handle_t* handle) {
+    uvhttp_free(handle->data);
+}
+
+static void ofc_watch_event(uv_fs_event_t* handle, const char* filename,
+                            int events, int status) {
+    (void)events;
+    ofc_watch_t* watch = (ofc_watch_t*)handle->data;
+    if (watch->cache) {
+        /* without a name (or on error) anything in the directory may have
+         * changed */
+        ofc_invalidate_in(watch->cache, watch, status < 0 ? NULL : filename);
+    }
+}
+
+static ofc_watch_t* ofc_watch_get(uvhttp_open_file_cache_t* cache,
+                                  const char* dir, size_t dir_len) {
+    for (ofc_watch_t* w = cache->watches; w; w = w->next) {
+        if (strncmp(w->dir, dir, dir_len) == 0 && w->dir[dir_len] == '\0') {
+            w->refs++;
+            return w;
+        }
+    }
+    if (cache->watch_count >= UVHTTP_STATIC_OPEN_FILE_CACHE_WATCHES) {
+        return NULL; /* the TTL alone covers this directory */
+    }
+
+    ofc_watch_t* w = uvhttp_alloc(sizeof(ofc_watch_t) + dir_len + 1);
+    if (!w) {
+        return NULL;
+    }
+    memset(w, 0, sizeof(ofc_watch_t));
+    memcpy(w->dir, dir, dir_len);
+    w->dir[dir_len] = '\0';
+    if (uv_fs_event_init(cache->loop, &w->handle) != 0) {
+        uvhttp_free(w);
+        return NULL;
+    }
+    w->handle.data = w;
+    if (uv_fs_event_start(&w->handle, ofc_watch_event, w->dir, 0) != 0) {
+        /* e.g. the directory does not exist */
+        uv_close((uv_handle_t*)&w->handle, ofc_watch_closed);
+        return NULL;
+    }
+    /* a cache does not keep the loop running */
+    uv_unref((uv_handle_t*)&w->handle);
+    w->cache = cache;
+    w->refs = 1;
+    w->next = cache->watches;
+    cache->watches = w;
+    cache->watch_count++;
+    return w;
+}
+
+static void ofc_watch_put(uvhttp_open_file_cache_t* cache, ofc_watch_t* watch) {
+    if (!watch || --watch->refs > 0) {
+        return;
+    }
+    for (ofc_watch_t** link = &cache->watches; *link; link = &(*link)->next) {
+        if (*link == watch) {
+            *link = watch->next;
+            break;
+        }
+    }
+    cache->watch_count--;
+    watch->cache = NULL;
+    uv_fs_event_stop(&watch->handle);
+    uv_close((uv_handle_t*)&watch->handle, ofc_watch_closed);
+}
+
+/* Watch the directory of path; *name receives the file name within it */
+static ofc_watch_t* ofc_watch_parent(uvhttp_open_file_cache_t* cache,
+                                     const char* path, const char** name) {
+    const char* slash = strrchr(path, '/');
+    if (!slash || slash[1] == '\0') {
+        return NULL;
+    }
+    *name = slash + 1;
+    size_t dir_len = slash == path ? 1 : (size_t)(slash - path);
+    return ofc_watch_get(cache, path, dir_len);
+}
+
+/* ========== entries ========== */
+
+static void ofc_close_fd(uvhttp_open_file_cache_t* cache, uv_file* fd) {
+    if (*fd >= 0) {
+        close(*fd);
+        *fd = -1;
+        cache->open_fds--;
+    }
+}
+
+static void ofc_lru_unlink(uvhttp_open_file_cache_t* cache, ofc_entry_t* e) {
+    if (e->lru_prev) {
+        e->lru_prev->lru_next = e->lru_next;
+    } else {
+        cache->lru_head = e->lru_next;
+    }
+    if (e->lru_next) {
+        e->lru_next->lru_prev = e->lru_prev;
+    } else {
+        cache->lru_tail = e->lru_prev;
+    }
+    e->lru_prev = e->lru_next = NULL;
+}
+
+static void ofc_lru_push(uvhttp_open_file_cache_t* cache, ofc_entry_t* e) {
+    e->lru_prev = NULL;
+    e->lru_next = cache->lru_head;
+    if (cache->lru_head) {
+        cache->lru_head->lru_prev = e;
+    } else {
+        cache->lru_tail = e;
+    }
+    cache->lru_head = e;
+}
+
+static void ofc_remove(uvhttp_open_file_cache_t* cache, ofc_entry_t* e) {
+    ofc_entry_t** link = &cache->buckets[e->hash & cache->bucket_mask];
+    while (*link != e) {
+        link = &(*link)->hash_next;
+    }
+    *link = e->hash_next;
+    ofc_lru_unlink(cache, e);
+    cache->count--;
+
+    ofc_close_fd(cache, &e->file.fd);
+    ofc_close_fd(cache, &e->file.gz_fd);
+    ofc_watch_put(cache, e->watch[0]);
+    ofc_watch_put(cache, e->watch[1]);
+    uvhttp_free(e->path);
+    uvhttp_free(e);
+}
+
+/* Does filename, changed in watch's directory, concern entry e? */
+static int ofc_concerns(const ofc_entry_t* e, const ofc_watch_t* watch,
+                        const char* filename) {
+    for (int i = 0; i < 2; i++) {
+        if (e->watch[i] != watch) {
+            continue;
+        }
+        if (!filename) {
+            return 1;
+        }
+        size_t len = strlen(e->name[i]);
+        if (strncmp(filename, e->name[i], len) == 0 &&
+            (filename[len] == '\0' ||
+             (i == 0 && strcmp(filename + len, ".gz") == 0))) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void ofc_invalidate_in(uvhttp_open_file_cache_t* cache,
+                              const ofc_watch_t* watch, const char* filename) {
+    ofc_entry_t* e = cache->lru_head;
+    while (e) {
+        ofc_entry_t* next = e->lru_next;
+        if (ofc_concerns(e, watch, filename)) {
+            cache->invalidations++;
+            if (cache->on_invalidate) {
+                cache->on_invalidate(cache->on_invalidate_data, e->key);
+            }
+            /* may close watch: its memory lasts until the close callback */
+            ofc_remove(cache, e);
+        }
+        e = next;
+    }
+}
+
+static ofc_entry_t* ofc_lookup(uvhttp_open_file_cache_t* cache,
+                               const char* key, uint64_t hash) {
+    for (ofc_entry_t* e = cache->buckets[hash & cache->bucket_mask]; e;
+         e = e->hash_next) {
+        if (e->hash == hash && strcmp(e->key, key) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+/* A fresh entry for key in place of any old one, watching key's directory */
+static ofc_entry_t* ofc_insert(uvhttp_open_file_cache_t* cache,
+                               uv_loop_t* loop, const char* key) {
+    if (!cache->loop) {
+        cache->loop = loop;
+    }
+    uint64_t hash = ofc_hash(key);
+    ofc_entry_t* old = ofc_lookup(cache, key, hash);
+    if (old) {
+        ofc_remove(cache, old);
+    }
+    while (cache->count >= cache->max_entries && cache->lru_tail) {
+        ofc_remove(cache, cache->lru_tail);
+    }
+
+    size_t key_len = strlen(key);
+    ofc_entry_t* e = uvhttp_alloc(sizeof(ofc_entry_t) + key_len + 1);
+    if (!e) {
+        return NULL;
+    }
+    memset(e, 0, sizeof(ofc_entry_t));
+    memcpy(e->key, key, key_len + 1);
+    e->hash = hash;
+    e->expires = ofc_now(cache) + cache->ttl_ms;
+    e->file.fd = -1;
+    e->file.gz_fd = -1;
+    e->file.has_gz = -1;
+    e->watch[1] = ofc_watch_parent(cache, e->key, &e->name[1]);
+
+    ofc_entry_t** bucket = &cache->buckets[hash & cache->bucket_mask];
+    e->hash_next = *bucket;
+    *bucket = e;
+    ofc_lru_push(cache, e);
+    cache->count++;
+    return e;
+}
+
+/* ========== public API ========== */
+
+uvhttp_error_t uvhttp_open_file_cache_create(int max_entries, int ttl,
+                                             int max_fds,
+                                             uvhttp_open_file_cache_t** cache) {
+    if (!cache || max_entries < 0 || ttl < 0 || max_fds < 0) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    *cache = NULL;
+
+    uvhttp_open_file_cache_t* c =
+        uvhttp_calloc(1, sizeof(uvhttp_open_file_cache_t));
+    if (!c) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    c->max_entries = max_entries ? (size_t)max_entries
+                                 : UVHTTP_STATIC_OPEN_FILE_CACHE_SIZE;
+    c->max_fds = max_fds ? (size_t)max_fds : UVHTTP_STATIC_OPEN_FILE_CACHE_FDS;
+    c->ttl_ms = (uint64_t)(ttl ? ttl : UVHTTP_STATIC_OPEN_FILE_CACHE_TTL) * 1000;
+
+    size_t buckets = 16;
+    while (buckets < c->max_entries) {
+        buckets <<= 1;
+    }
+    c->buckets = uvhttp_calloc(buckets, sizeof(ofc_entry_t*));
+    if (!c->buckets) {
+        uvhttp_free(c);
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    c->bucket_mask = buckets - 1;
+    *cache = c;
+    return UVHTTP_OK;
+}
+
+void uvhttp_open_file_cache_free(uvhttp_open_file_cache_t* cache) {
+    if (!cache) {
+        return;
+    }
+    /* removing the last entry of a directory closes its watch */
+    uvhttp_open_file_cache_clear(cache);
+    uvhttp_free(cache->buckets);
+    uvhttp_free(cache);
+}
+
+void uvhttp_open_file_cache_set_invalidate_cb(
+    uvhttp_open_file_cache_t* cache, uvhttp_open_file_invalidate_cb cb,
+    void* data) {
+    if (cache) {
+        cache->on_invalidate = cb;
+        cache->on_invalidate_data = data;
+    }
+}
+
+uvhttp_open_file_t* uvhttp_open_file_cache_find(uvhttp_open_file_cache_t* cache,
+                                                const char* key) {
+    if (!cache || !key) {
+        return NULL;
+    }
+    ofc_entry_t* e = ofc_lookup(cache, key, ofc_hash(key));
+    if (e && ofc_now(cache) >= e->expires) {
+        ofc_remove(cache, e);
+        e = NULL;
+    }
+    if (!e) {
+        cache->misses++;
+        return NULL;
+    }
+    if (e->file.negative) {
+        cache->negative_hits++;
+    } else {
+        cache->hits++;
+    }
+    ofc_lru_unlink(cache, e);
+    ofc_lru_push(cache, e);
+    return &e->file;
+}
+
+uvhttp_open_file_t* uvhttp_open_file_cache_peek(uvhttp_open_file_cache_t* cache,
+                                                const char* key) {
+    if (!cache || !key) {
+        return NULL;
+    }
+    ofc_entry_t* e = ofc_lookup(cache, key, ofc_hash(key));
+    return e ? &e->file : NULL;
+}
+
+uvhttp_open_file_t* uvhttp_open_file_cache_put(uvhttp_open_file_cache_t* cache,
+                                               uv_loop_t* loop, const char* key,
+                                               const char* path,
+                                               const uv_stat_t* st) {
+    if (!cache || !loop || !key || !path || !st) {
+        return NULL;
+    }
+    size_t path_len = strlen(path);
+    char* path_copy = uvhttp_alloc(path_len + 1);
+    if (!path_copy) {
+        return NULL;
+    }
+    memcpy(path_copy, path, path_len + 1);
+
+    ofc_entry_t* e = ofc_insert(cache, loop, key);
+    if (!e) {
+        uvhttp_free(path_copy);
+        return NULL;
+    }
+    e->path = path_copy;
+    e->watch[0] = ofc_watch_parent(cache, e->path, &e->name[0]);
+    e->file.path = e->path;
+    e->file.size = (size_t)st->st_size;
+    e->file.mtime = (time_t)st->st_mtim.tv_sec;
+    e->file.ino = st->st_ino;
+    return &e->file;
+}
+
+uvhttp_open_file_t* uvhttp_open_file_cache_put_negative(
+    uvhttp_open_file_cache_t* cache, uv_loop_t* loop, const char* key) {
+    if (!cache || !loop || !key) {
+        return NULL;
+    }
+    ofc_entry_t* e = ofc_insert(cache, loop, key);
+    if (!e) {
+        return NULL;
+    }
+    e->file.negative = 1;
+    return &e->file;
+}
+
+int uvhttp_open_file_cache_keep_fd(uvhttp_open_file_cache_t* cache,
+                                   uvhttp_open_file_t* entry, int gz,
+                                   uv_file fd) {
+    if (!cache || !entry || fd < 0) {
+        return 0;
+    }
+    uv_file* slot = gz ? &entry->gz_fd : &entry->fd;
+    if (*slot >= 0 || cache->open_fds >= cache->max_fds) {
+        return 0;
+    }
+    int dup_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (dup_fd < 0) {
+        return 0;
+    }
+    *slot = dup_fd;
+    cache->open_fds++;
+    return 1;
+}
+
+void uvhttp_open_file_cache_clear(uvhttp_open_file_cache_t* cache) {
+    if (!cache) {
+        return;
+    }
+    while (cache->lru_head) {
+        ofc_remove(cache, cache->lru_head);
+    }
+}
+
+void uvhttp_open_file_cache_get_stats(uvhttp_open_file_cache_t* cache,
+                                      uvhttp_open_file_cache_stats_t* stats) {
+    if (!stats) {
+        return;
+    }
+    memset(stats, 0, sizeof(*stats));
+    if (!cache) {
+        return;
+    }
+    stats->hits = cache->hits;
+    stats->negative_hits = cache->negative_hits;
+    stats->misses = cache->misses;
+    stats->invalidations = cache->invalidations;
+    stats->entries = cache->count;
+    stats->open_fds = cache->open_fds;
+    stats->watches = cache->watch_count;
+}
+
+#endif /* UVHTTP_FEATURE_STATIC_FILES */
@@ -11,6 +11,7 @@
 #include "uvhttp_static.h"
 #include "uvhttp_utils.h"
 #include "uvhttp_validation.h"
+#include "uvhttp_vhost.h"
 
 #include "uvhttp_protocol_upgrade.h"
 
@@ -158,6 +159,9 @@ static int on_message_begin(llhttp_t* parser) {
     conn->parsing_complete = 0;
     conn->content_length = 0;
     conn->body_received = 0;
+    /* each response starts with small TLS records again, whatever the
+     * previous one on this keep-alive connection reached */
+    conn->tls_record_streamed = 0;
 
     return 0;
 }
@@ -361,6 +365,58 @@ static void ensure_valid_url(uvhttp_request_t* request) {
     }
 }
 
+/* run the route handler, or static files / server handler / 404 when no
+ * route matched */
+static void dispatch_route(uvhttp_connection_t* conn,
+                           uvhttp_request_handler_t handler) {
+    if (handler) {
+        handler(conn->request, conn->response);
+    } else if (conn->router->static_context) {
+#ifdef UVHTTP_STATIC_FILES_ENABLED
+        /* if no handler found but have static file context, attempt
+         * static file processing; a file that does not exist falls through
+         * to the server-level handler so an embedder (e.g. qwrt's JS
+         * serve()) can respond before 404 — possibly once the file system
+         * has answered, off the loop thread */
+        uvhttp_result_t result = uvhttp_static_serve(
+            (uvhttp_static_context_t*)conn->router->static_context,
+            conn->request, conn->response, conn->server->handler);
+
+        if (result != UVHTTP_OK) {
+            if (conn->server->handler) {
+                conn->server->handler(conn->request, conn->response);
+            } else {
+                uvhttp_response_set_status(conn->response, 404);
+                uvhttp_response_set_header(conn->response,
+                                           UVHTTP_HEADER_CONTENT_TYPE,
+                                           UVHTTP_CONTENT_TYPE_TEXT);
+                uvhttp_response_set_body(conn->response,
+                                         UVHTTP_MESSAGE_NOT_FOUND,
+                                         strlen(UVHTTP_MESSAGE_NOT_FOUND));
+                uvhttp_response_send(conn->response);
+            }
+        }
+#endif
+    } else if (conn->server->handler) {
+        /* no router match and no static context — server-level catch-all
+         * handler (set via uvhttp_server_set_handler) */
+        conn->server->handler(conn->request, conn->response);
+    } else {
+        uvhttp_response_set_status(conn->response, 404);
+        uvhttp_response_set_header(conn->response,
+                                   UVHTTP_HEADER_CONTENT_TYPE,
+                                   UVHTTP_CONTENT_TYPE_TEXT);
+        uvhttp_response_set_body(conn->response, UVHTTP_MESSAGE_NOT_FOUND,
+                                 strlen(UVHTTP_MESSAGE_NOT_FOUND));
+        uvhttp_response_send(conn->response);
+    }
+}
+
+/* every middleware of the route continued (possibly asynchronously) */
+static void on_middleware_done(uvhttp_middleware_context_t* ctx) {
+    dispatch_route((uvhttp_connection_t*)ctx->done_data, ctx->handler);
+}
+
 /* single-threaded event-driven HTTP request complete processing
  * executed in libuv event loop thread, process complete HTTP request
  * single-thread advantage: no race condition, request processing order is
@@ -510,53 +566,37 @@ static int on_message_complete(llhttp_t* parser) {
         }
     }
 
-    /* routerprocess */
-    if (conn->server && conn->server->router) {
+    /* routerprocess: the router of the virtual host named by Host, or the
+     * server's */
+    conn->router = NULL;
+    if (conn->server) {
+        conn->router =
+            conn->server->vhosts
+                ? uvhttp_server_find_router(
+                      conn->server,
+                      uvhttp_request_get_header(conn->request,
+                                                UVHTTP_HEADER_HOST))
+                : conn->server->router;
+    }
+    if (conn->router) {
         ensure_valid_url(conn->request);
 
-        uvhttp_request_handler_t handler = uvhttp_router_find_handler(
-            conn->server->router, conn->request->url,
-            uvhttp_method_to_string(conn->request->method));
-
-        if (handler) {
-            handler(conn->request, conn->response);
-        } else if (conn->server->router->static_context) {
-#ifdef UVHTTP_STATIC_FILES_ENABLED
-            /* if no handler found but have static file context, attempt
-             * static file processing */
-            uvhttp_result_t result = uvhttp_static_handle_request(
-                (uvhttp_static_context_t*)conn->server->router->static_context,
-                conn->request, conn->response);
-
-            if (result != UVHTTP_OK) {
-                /* static miss — fall through to the server-level handler so an
-                 * embedder (e.g. qwrt's JS serve()) can respond before 404 */
-                if (conn->server->handler) {
-                    conn->server->handler(conn->request, conn->response);
-                } else {
-                    uvhttp_response_set_status(conn->response, 404);
-                    uvhttp_response_set_header(conn->response,
-                                               UVHTTP_HEADER_CONTENT_TYPE,
-                                               UVHTTP_CONTENT_TYPE_TEXT);
-                    uvhttp_response_set_body(conn->response,
-                                             UVHTTP_MESSAGE_NOT_FOUND,
-                                             strlen(UVHTTP_MESSAGE_NOT_FOUND));
-                    uvhttp_response_send(conn->response);
-                }
-            }
-#endif
-        } else if (conn->server->handler) {
-            /* no router match and no static context — server-level catch-all
-             * handler (set via uvhttp_server_set_handler) */
-            conn->server->handler(conn->request, conn->response);
+        const uvhttp_middleware_handler_t* middleware = NULL;
+        size_t middleware_count = 0;
+        uvhttp_request_handler_t handler = uvhttp_router_find_pipeline(
+            conn->router, conn->request->url,
+            uvhttp_method_to_string(conn->request->method), &middleware,
+            &middleware_count);
+
+        if (middleware_count > 0) {
+            /* the chain was resolved with the route; it calls back into
+             * dispatch_route once every middleware has continued */
+            uvhttp_middleware_start(&conn->middleware, conn->request,
+                                    conn->response, middleware,
+                                    middleware_count, handler,
+                                    on_middleware_done, conn);
         } else {
-            uvhttp_response_set_status(conn->response, 404);
-            uvhttp_response_set_header(conn->response,
-                                       UVHTTP_HEADER_CONTENT_TYPE,
-                                       UVHTTP_CONTENT_TYPE_TEXT);
-            uvhttp_response_set_body(conn->response, UVHTTP_MESSAGE_NOT_FOUND,
-                                     strlen(UVHTTP_MESSAGE_NOT_FOUND));
-            uvhttp_response_send(conn->response);
+            dispatch_route(conn, handler);
         }
     } else {
         /* no router, send default response */
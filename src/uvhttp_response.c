@@ -40,8 +40,8 @@
  *   and standard gzip decoders reject zlib streams (magic 0x78 vs 0x1f8b).
  * @note Caller is responsible for freeing output buffer
  */
-static uvhttp_error_t uvhttp_compress_gzip(const char* input, size_t input_len,
-                                           char** output, size_t* output_len) {
+uvhttp_error_t uvhttp_compress_gzip(const char* input, size_t input_len,
+                                    char** output, size_t* output_len) {
     if (!input || !output || !output_len) {
         return UVHTTP_ERROR_INVALID_PARAM;
     }
@@ -538,6 +538,32 @@ uvhttp_error_t uvhttp_send_response_data(uvhttp_response_t* response,
     return UVHTTP_OK;
 }
 
+/* the last write of response is out: close the connection or read the
+ * next request */
+static void uvhttp_response_written(uvhttp_response_t* response) {
+    uv_tcp_t* client = (uv_tcp_t*)response->client;
+    if (client) {
+        uvhttp_connection_t* conn = (uvhttp_connection_t*)client->data;
+        if (conn) {
+            if (!response->keepalive) {
+                /* closeconnection */
+                uvhttp_connection_close(conn);
+            }
+#if UVHTTP_FEATURE_WEBSOCKET
+            else if (!conn->is_websocket) {
+#else
+            else {
+#endif
+                /* keep-alive connection, restart read to receive next
+                 * request (skip for websocket: its read callback was
+                 * already set up by switch_to_websocket; restarting
+                 * HTTP read here would override it) */
+                uvhttp_connection_schedule_restart_read(conn);
+            }
+        }
+    }
+}
+
 /* single-thread safe write complete callback
  * executed in libuv event loop thread, safely release write related resources
  * single-thread advantage: no locks needed, resource release order is
@@ -549,27 +575,7 @@ static void uvhttp_free_write_data(uv_write_t* req, int status) {
     if (write_data) {
         /* check if need to close connection or restart read */
         if (write_data->response) {
-            uv_tcp_t* client = (uv_tcp_t*)write_data->response->client;
-            if (client) {
-                uvhttp_connection_t* conn = (uvhttp_connection_t*)client->data;
-                if (conn) {
-                    if (!write_data->response->keepalive) {
-                        /* closeconnection */
-                        uvhttp_connection_close(conn);
-                    }
-#if UVHTTP_FEATURE_WEBSOCKET
-                    else if (!conn->is_websocket) {
-#else
-                    else {
-#endif
-                        /* keep-alive connection, restart read to receive next
-                         * request (skip for websocket: its read callback was
-                         * already set up by switch_to_websocket; restarting
-                         * HTTP read here would override it) */
-                        uvhttp_connection_schedule_restart_read(conn);
-                    }
-                }
-            }
+            uvhttp_response_written(write_data->response);
         }
 
         /* release write_data (data buffer is part of struct, no need to
@@ -755,6 +761,29 @@ uvhttp_error_t uvhttp_response_build_data(uvhttp_response_t* response,
     return UVHTTP_OK;
 }
 
+/* TLS writes are synchronous (mbedtls_ssl_write + uv_try_write), so the
+ * uv_write completion callback (uvhttp_free_write_data) that normally
+ * schedules restart_read for keep-alive never fires. Schedule it here or the
+ * llhttp parser stays at the completed state and the next request on this
+ * connection is never parsed. */
+static void uvhttp_response_tls_written(uvhttp_connection_t* conn,
+                                        uvhttp_response_t* response) {
+    if (!response->keepalive) {
+        uvhttp_connection_close(conn);
+    }
+#if UVHTTP_FEATURE_WEBSOCKET
+    else if (!conn->is_websocket && response->status_code != 101) {
+#else
+    else {
+#endif
+        /* 101 = WebSocket upgrade: the handshake path calls
+         * uvhttp_connection_switch_to_websocket which starts the WS
+         * read callback; scheduling restart_read here would let the
+         * idle callback restart plain HTTP reads and override it. */
+        uvhttp_connection_schedule_restart_read(conn);
+    }
+}
+
 /* ============ side-effect function: send raw data ============ */
 /* side-effect function: send raw data, contains network I/O
  * data: data to send
@@ -820,26 +849,8 @@ uvhttp_error_t uvhttp_response_send_raw(const char* data, size_t length,
             uvhttp_free(write_data);
             return tls_result;
         }
-        /* TLS writes are synchronous (mbedtls_ssl_write + uv_try_write), so
-         * the uv_write completion callback (uvhttp_free_write_data) that
-         * normally schedules restart_read for keep-alive never fires.
-         * Schedule it here or the llhttp parser stays at the completed state
-         * and the next request on this connection is never parsed. */
         if (response) {
-            if (!response->keepalive) {
-                uvhttp_connection_close(conn);
-            }
-#if UVHTTP_FEATURE_WEBSOCKET
-            else if (!conn->is_websocket && response->status_code != 101) {
-#else
-            else {
-#endif
-                /* 101 = WebSocket upgrade: the handshake path calls
-                 * uvhttp_connection_switch_to_websocket which starts the WS
-                 * read callback; scheduling restart_read here would let the
-                 * idle callback restart plain HTTP reads and override it. */
-                uvhttp_connection_schedule_restart_read(conn);
-            }
+            uvhttp_response_tls_written(conn, response);
         }
         /* TLS write succeeded, data was sent through mbedtls_bio_send callback
          */
@@ -874,6 +885,89 @@ uvhttp_error_t uvhttp_response_send_raw(const char* data, size_t length,
     return UVHTTP_OK;
 }
 
+/* a uvhttp_response_send_iov write: the buffers are the caller's */
+typedef struct {
+    uv_write_t write_req;
+    uvhttp_response_t* response;
+    uvhttp_response_release_cb release;
+    void* release_data;
+} uvhttp_iov_write_t;
+
+static void uvhttp_iov_write_done(uv_write_t* req, int status) {
+    (void)status;
+    uvhttp_iov_write_t* write = (uvhttp_iov_write_t*)req->data;
+    uvhttp_response_written(write->response);
+    if (write->release) {
+        write->release(write->release_data);
+    }
+    uvhttp_free(write);
+}
+
+uvhttp_error_t uvhttp_response_send_iov(uvhttp_response_t* response,
+                                        const uv_buf_t* bufs,
+                                        unsigned int nbufs,
+                                        uvhttp_response_release_cb release,
+                                        void* data) {
+    if (!response || !bufs || nbufs == 0 || !response->client) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    if (response->sent) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    uv_stream_t* stream = (uv_stream_t*)response->client;
+    if (stream->type != UV_TCP || !stream->loop) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    /* TLS copies into its records anyway: write each buffer in turn (once
+     * the first is out the response is sent, even if a later one fails) */
+    uvhttp_connection_t* conn = (uvhttp_connection_t*)stream->data;
+    if (conn && conn->tls_enabled && conn->ssl) {
+        response->sent = 1;
+        for (unsigned int i = 0; i < nbufs; i++) {
+            uvhttp_error_t tls_result =
+                uvhttp_connection_tls_write(conn, bufs[i].base, bufs[i].len);
+            if (tls_result != UVHTTP_OK) {
+                UVHTTP_LOG_ERROR("TLS write failed: %d\n", tls_result);
+                return tls_result;
+            }
+        }
+        response->headers_sent = 1;
+        response->finished = 1;
+        uvhttp_response_tls_written(conn, response);
+        if (release) {
+            release(data);
+        }
+        return UVHTTP_OK;
+    }
+
+    uvhttp_iov_write_t* write = uvhttp_alloc(sizeof(uvhttp_iov_write_t));
+    if (!write) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    memset(&write->write_req, 0, sizeof(uv_write_t));
+    write->write_req.data = write;
+    write->response = response;
+    write->release = release;
+    write->release_data = data;
+
+    /* uv_write copies the uv_buf_t array, not the bytes */
+    if (uv_write(&write->write_req, stream, bufs, nbufs,
+                 uvhttp_iov_write_done) < 0) {
+        uvhttp_free(write);
+        return UVHTTP_ERROR_RESPONSE_SEND;
+    }
+
+    response->headers_sent = 1;
+    response->sent = 1;
+    response->finished = 1;
+    if (!response->keepalive && conn) {
+        conn->keepalive = 0;
+    }
+    return UVHTTP_OK;
+}
+
 /* ============ responsesendfunction ============ */
 /* single-threaded event-driven HTTP response send
  * ensure HTTP response format is correct
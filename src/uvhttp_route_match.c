@@ -0,0 +1,99 @@
+#include "uvhttp_router.h"
+
+#include <string.h>
+
+/* Route match parameter accessors - shared by uvhttp_router.c and
+ * uvhttp_router_cache.c, which both fill uvhttp_route_match_t with slices */
+
+static const uvhttp_param_slice_t* find_param(
+    const uvhttp_route_match_t* match, const char* name) {
+    if (!match || !name || !match->path || !match->param_names) {
+        return NULL;
+    }
+
+    size_t name_len = strlen(name);
+    for (size_t i = 0; i < match->param_count; i++) {
+        const uvhttp_param_slice_t* param = &match->params[i];
+        if (param->name_len == name_len &&
+            memcmp(match->param_names + param->name_offset, name, name_len) ==
+                0) {
+            return param;
+        }
+    }
+    return NULL;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+const char* uvhttp_route_match_param(const uvhttp_route_match_t* match,
+                                     const char* name, size_t* len) {
+    const uvhttp_param_slice_t* param = find_param(match, name);
+    if (!param) {
+        return NULL;
+    }
+    if (len) {
+        *len = param->value_len;
+    }
+    return match->path + param->value_offset;
+}
+
+const char* uvhttp_route_match_param_name(const uvhttp_route_match_t* match,
+                                          size_t index, size_t* len) {
+    if (!match || !match->param_names || index >= match->param_count) {
+        return NULL;
+    }
+    const uvhttp_param_slice_t* param = &match->params[index];
+    if (len) {
+        *len = param->name_len;
+    }
+    return match->param_names + param->name_offset;
+}
+
+uvhttp_error_t uvhttp_route_match_param_copy(const uvhttp_route_match_t* match,
+                                             const char* name, char* buf,
+                                             size_t buf_size, size_t* out_len) {
+    if (!match || !name || !buf || buf_size == 0) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    const uvhttp_param_slice_t* param = find_param(match, name);
+    if (!param) {
+        return UVHTTP_ERROR_NOT_FOUND;
+    }
+
+    // "%XX" decodes to one byte; malformed escapes are kept as they are
+    const char* src = match->path + param->value_offset;
+    size_t n = 0;
+    for (size_t i = 0; i < param->value_len; i++) {
+        char c = src[i];
+        if (c == '%' && i + 2 < param->value_len) {
+            int hi = hex_value(src[i + 1]);
+            int lo = hex_value(src[i + 2]);
+            if (hi >= 0 && lo >= 0) {
+                c = (char)(hi << 4 | lo);
+                i += 2;
+            }
+        }
+        if (n + 1 >= buf_size) {
+            buf[0] = '\0';
+            return UVHTTP_ERROR_BUFFER_TOO_SMALL;
+        }
+        buf[n++] = c;
+    }
+    buf[n] = '\0';
+    if (out_len) {
+        *out_len = n;
+    }
+    return UVHTTP_OK;
+}
@@ -1,5 +1,7 @@
 #if !UVHTTP_FEATURE_ROUTER_CACHE
 #    include "uvhttp_router.h"
+#    include "uvhttp_router_match_cache.h"
+#    include "uvhttp_router_middleware.h"
 
 #    include "uvhttp_allocator.h"
 #    include "uvhttp_connection.h"
@@ -107,14 +109,14 @@ const char* uvhttp_method_to_string(uvhttp_method_t method) {
 }
 
 // create new router node - returns index into node pool
-static uint32_t create_route_node(uvhttp_router_t* router) {
+static uint32_t create_route_node(uvhttp_router_t* router, uint8_t kind) {
     if (router->node_pool_used >= router->node_pool_size) {
         // expand node pool
         uint32_t new_size = router->node_pool_size * 2;
         uvhttp_route_node_t* new_pool = uvhttp_realloc(
             router->node_pool, new_size * sizeof(uvhttp_route_node_t));
         if (!new_pool) {
-            return UINT32_MAX;
+            return UVHTTP_ROUTE_NONE;
         }
 
         // initialize newly added nodes
@@ -126,47 +128,164 @@ static uint32_t create_route_node(uvhttp_router_t* router) {
         router->node_pool_size = new_size;
     }
 
+    uvhttp_route_node_t* node = &router->node_pool[router->node_pool_used];
+    node->kind = kind;
+    node->param_child = UVHTTP_ROUTE_NONE;
+    node->catch_all_child = UVHTTP_ROUTE_NONE;
+    node->endpoint = UVHTTP_ROUTE_NONE;
     return router->node_pool_used++;
 }
 
-// find or create child node - returns index into node pool
-static uint32_t find_or_create_child(uvhttp_router_t* router,
-                                     uint32_t parent_index, const char* segment,
-                                     int is_param) {
-    uvhttp_route_node_t* parent = &router->node_pool[parent_index];
+// static child of node starting with byte c, or UVHTTP_ROUTE_NONE
+UVHTTP_INLINE uint32_t find_static_child(const uvhttp_route_node_t* node,
+                                         uint8_t c) {
+    uint32_t lo = 0;
+    uint32_t hi = node->child_count;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (node->indices[mid] < c) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return (lo < node->child_count && node->indices[lo] == c)
+               ? node->children[lo]
+               : UVHTTP_ROUTE_NONE;
+}
 
-    // find existing child node
-    for (size_t i = 0; i < parent->child_count; i++) {
-        uint32_t child_index = parent->child_indices[i];
-        uvhttp_route_node_t* child = &router->node_pool[child_index];
-        if (strncmp(child->segment_data, segment, child->segment_len) == 0 &&
-            strlen(segment) == child->segment_len) {
-            return child_index;
+// insert child_index into parent's sorted static children
+static int add_static_child(uvhttp_router_t* router, uint32_t parent_index,
+                            uint32_t child_index) {
+    uvhttp_route_node_t* parent = &router->node_pool[parent_index];
+    uint8_t c = (uint8_t)router->node_pool[child_index].prefix[0];
+
+    if (parent->child_count == parent->child_capacity) {
+        uint32_t capacity =
+            parent->child_capacity ? parent->child_capacity * 2 : 4;
+        uint32_t* children =
+            uvhttp_realloc(parent->children, capacity * sizeof(uint32_t));
+        if (!children) {
+            return -1;
         }
+        parent->children = children;
+        uint8_t* indices = uvhttp_realloc(parent->indices, capacity);
+        if (!indices) {
+            return -1;
+        }
+        parent->indices = indices;
+        parent->child_capacity = capacity;
     }
 
-    // create new child node
-    if (parent->child_count >= 12) {
-        return UINT32_MAX;
+    uint32_t pos = parent->child_count;
+    while (pos > 0 && parent->indices[pos - 1] > c) {
+        parent->indices[pos] = parent->indices[pos - 1];
+        parent->children[pos] = parent->children[pos - 1];
+        pos--;
     }
+    parent->indices[pos] = c;
+    parent->children[pos] = child_index;
+    parent->child_count++;
+    return 0;
+}
 
-    uint32_t child_index = create_route_node(router);
-    if (child_index == UINT32_MAX) {
-        return UINT32_MAX;
+// new static node holding a copy of text
+static uint32_t create_static_node(uvhttp_router_t* router, const char* text,
+                                   size_t len) {
+    char* prefix = uvhttp_alloc(len);
+    if (!prefix) {
+        return UVHTTP_ROUTE_NONE;
+    }
+    uint32_t index = create_route_node(router, UVHTTP_ROUTE_NODE_STATIC);
+    if (index == UVHTTP_ROUTE_NONE) {
+        uvhttp_free(prefix);
+        return UVHTTP_ROUTE_NONE;
     }
+    memcpy(prefix, text, len);
+    router->node_pool[index].prefix = prefix;
+    router->node_pool[index].prefix_len = (uint32_t)len;
+    return index;
+}
 
-    // create_route_node may uvhttp_realloc() the node pool to grow it, which
-    // can move it to a new address and free the old block. Re-fetch parent
-    // here so we never dereference a dangling pointer captured above.
-    parent = &router->node_pool[parent_index];
+// walk/extend the static path text below parent_index, splitting nodes whose
+// prefix only partly matches. Returns the node where text ends.
+static uint32_t insert_static(uvhttp_router_t* router, uint32_t parent_index,
+                              const char* text, size_t len) {
+    while (len > 0) {
+        uint32_t child_index = find_static_child(
+            &router->node_pool[parent_index], (uint8_t)text[0]);
+
+        if (child_index == UVHTTP_ROUTE_NONE) {
+            child_index = create_static_node(router, text, len);
+            if (child_index == UVHTTP_ROUTE_NONE ||
+                add_static_child(router, parent_index, child_index) != 0) {
+                return UVHTTP_ROUTE_NONE;
+            }
+            return child_index;
+        }
 
-    uvhttp_route_node_t* child = &router->node_pool[child_index];
-    size_t seg_len = strlen(segment);
-    child->segment_len = (uint8_t)(seg_len < 32 ? seg_len : 31);
-    memcpy(child->segment_data, segment, child->segment_len);
-    child->is_param = is_param;
+        uvhttp_route_node_t* child = &router->node_pool[child_index];
+        size_t common = 0;
+        while (common < len && common < child->prefix_len &&
+               child->prefix[common] == text[common]) {
+            common++;
+        }
 
-    parent->child_indices[parent->child_count++] = child_index;
+        if (common < child->prefix_len) {
+            // split: a new node takes the shared part and adopts child,
+            // keeping child's first byte so the parent's slot stays sorted
+            uint32_t mid_index = create_static_node(router, text, common);
+            if (mid_index == UVHTTP_ROUTE_NONE) {
+                return UVHTTP_ROUTE_NONE;
+            }
+            // create_static_node may uvhttp_realloc() the node pool. Re-fetch
+            // node pointers so we never dereference a dangling one.
+            child = &router->node_pool[child_index];
+            uvhttp_route_node_t* parent = &router->node_pool[parent_index];
+
+            memmove(child->prefix, child->prefix + common,
+                    child->prefix_len - common);
+            child->prefix_len -= (uint32_t)common;
+            if (add_static_child(router, mid_index, child_index) != 0) {
+                return UVHTTP_ROUTE_NONE;
+            }
+            for (uint32_t i = 0; i < parent->child_count; i++) {
+                if (parent->children[i] == child_index) {
+                    parent->children[i] = mid_index;
+                    break;
+                }
+            }
+            child_index = mid_index;
+        }
+
+        parent_index = child_index;
+        text += common;
+        len -= common;
+    }
+    return parent_index;
+}
+
+// ":name" or "*name" child of parent, created on first use
+static uint32_t get_wildcard_child(uvhttp_router_t* router,
+                                   uint32_t parent_index, uint8_t kind) {
+    uvhttp_route_node_t* parent = &router->node_pool[parent_index];
+    uint32_t child_index = kind == UVHTTP_ROUTE_NODE_PARAM
+                               ? parent->param_child
+                               : parent->catch_all_child;
+    if (child_index != UVHTTP_ROUTE_NONE) {
+        return child_index;
+    }
+
+    child_index = create_route_node(router, kind);
+    if (child_index == UVHTTP_ROUTE_NONE) {
+        return UVHTTP_ROUTE_NONE;
+    }
+    parent = &router->node_pool[parent_index];
+    if (kind == UVHTTP_ROUTE_NODE_PARAM) {
+        parent->param_child = child_index;
+    } else {
+        parent->catch_all_child = child_index;
+    }
     return child_index;
 }
 
@@ -230,7 +349,7 @@ uvhttp_error_t uvhttp_router_new(uvhttp_router_t** router) {
     }
     r->array_capacity = HYBRID_THRESHOLD;
 
-    // initialize node pool (for Trie)
+    // initialize node pool (for the radix tree)
     r->node_pool_size = 64;
     r->node_pool_used = 0;
     r->node_pool =
@@ -242,9 +361,9 @@ uvhttp_error_t uvhttp_router_new(uvhttp_router_t** router) {
         return UVHTTP_ERROR_OUT_OF_MEMORY;
     }
 
-    // create root node
-    r->root_index = create_route_node(r);
-    if (r->root_index == UINT32_MAX) {
+    // create root node (empty static prefix)
+    r->root_index = create_route_node(r, UVHTTP_ROUTE_NODE_STATIC);
+    if (r->root_index == UVHTTP_ROUTE_NONE) {
         uvhttp_free(r->node_pool);
         uvhttp_free(r->array_routes);
         uvhttp_free(r);
@@ -253,6 +372,15 @@ uvhttp_error_t uvhttp_router_new(uvhttp_router_t** router) {
 
     r->use_trie = 0; /* default use array router */
 
+#    if UVHTTP_FEATURE_ROUTER_MATCH_CACHE
+    uvhttp_error_t err = uvhttp_router_match_cache_new(
+        UVHTTP_ROUTER_MATCH_CACHE_SIZE, &r->match_cache);
+    if (err != UVHTTP_OK) {
+        uvhttp_router_free(r);
+        return err;
+    }
+#    endif
+
     *router = r;
     return UVHTTP_OK;
 }
@@ -260,9 +388,30 @@ uvhttp_error_t uvhttp_router_new(uvhttp_router_t** router) {
 void uvhttp_router_free(uvhttp_router_t* router) {
     if (router) {
         if (router->node_pool) {
+            for (uint32_t i = 0; i < router->node_pool_used; i++) {
+                uvhttp_route_node_t* node = &router->node_pool[i];
+                uvhttp_free(node->prefix);
+                uvhttp_free(node->indices);
+                uvhttp_free(node->children);
+            }
             uvhttp_free(router->node_pool);
             router->node_pool = NULL;
         }
+        uvhttp_router_frozen_free(router->frozen);
+        router->frozen = NULL;
+        uvhttp_router_match_cache_free(router->match_cache);
+        router->match_cache = NULL;
+        uvhttp_router_middleware_free(router->middleware);
+        router->middleware = NULL;
+        if (router->endpoints) {
+            for (uint32_t i = 0; i < router->endpoint_count; i++) {
+                for (int m = 0; m < UVHTTP_ROUTE_METHOD_COUNT; m++) {
+                    uvhttp_free(router->endpoints[i].param_names[m]);
+                }
+            }
+            uvhttp_free(router->endpoints);
+            router->endpoints = NULL;
+        }
         if (router->array_routes) {
             uvhttp_free(router->array_routes);
             router->array_routes = NULL;
@@ -275,6 +424,27 @@ void uvhttp_router_free(uvhttp_router_t* router) {
     }
 }
 
+// middleware chain id of a route whose patterns start with lead[0..len)
+static uvhttp_error_t resolve_chain(uvhttp_router_t* router, const char* lead,
+                                    size_t len, uint32_t* chain) {
+    *chain = UVHTTP_ROUTE_CHAIN_NONE;
+    if (UVHTTP_LIKELY(!router->middleware)) {
+        return UVHTTP_OK;
+    }
+    return uvhttp_router_middleware_resolve(router->middleware, lead, len,
+                                            chain);
+}
+
+// point match at the handlers of chain
+UVHTTP_INLINE void set_match_chain(const uvhttp_router_t* router,
+                                   uint32_t chain,
+                                   uvhttp_route_match_t* match) {
+    if (UVHTTP_UNLIKELY(router->middleware != NULL)) {
+        match->middleware = uvhttp_router_middleware_chain(
+            router->middleware, chain, &match->middleware_count);
+    }
+}
+
 // arrayrouteradd
 static uvhttp_error_t add_array_route(uvhttp_router_t* router, const char* path,
                                       uvhttp_method_t method,
@@ -291,10 +461,17 @@ static uvhttp_error_t add_array_route(uvhttp_router_t* router, const char* path,
         router->array_capacity = new_capacity;
     }
 
+    uint32_t chain;
+    uvhttp_error_t err = resolve_chain(router, path, strlen(path), &chain);
+    if (err != UVHTTP_OK) {
+        return err;
+    }
+
     array_route_t* route = &router->array_routes[router->array_route_count];
     strncpy(route->path, path, sizeof(route->path) - 1);
     route->path[sizeof(route->path) - 1] = '\0';
     route->method = method;
+    route->chain = chain;
     route->handler = handler;
     router->array_route_count++;
     router->route_count++;
@@ -305,11 +482,13 @@ static uvhttp_error_t add_array_route(uvhttp_router_t* router, const char* path,
 // arrayrouterfind
 static uvhttp_request_handler_t find_array_route(const uvhttp_router_t* router,
                                                  const char* path,
-                                                 uvhttp_method_t method) {
+                                                 uvhttp_method_t method,
+                                                 uint32_t* chain) {
     for (size_t i = 0; i < router->array_route_count; i++) {
         array_route_t* route = &router->array_routes[i];
         if (route->method == method || route->method == UVHTTP_ANY) {
             if (strcmp(route->path, path) == 0) {
+                *chain = route->chain;
                 return route->handler;
             }
         }
@@ -317,6 +496,144 @@ static uvhttp_request_handler_t find_array_route(const uvhttp_router_t* router,
     return NULL;
 }
 
+// 1 if c starts a path segment (pattern start or just after '/')
+UVHTTP_INLINE int at_segment_start(const char* path, const char* c) {
+    return c == path || c[-1] == '/';
+}
+
+// validate ":name" / "*name" placement before touching the tree
+static uvhttp_error_t check_route_pattern(const char* path) {
+    size_t param_count = 0;
+    for (const char* p = path; *p; p++) {
+        if ((*p != ':' && *p != '*') || !at_segment_start(path, p)) {
+            continue;
+        }
+        const char* name = p + 1;
+        const char* end = name;
+        while (*end && *end != '/') {
+            end++;
+        }
+        // parameters need a name, a bare "*" catch-all may go without
+        if ((*p == ':' && end == name) || ++param_count > MAX_PARAMS) {
+            return UVHTTP_ERROR_INVALID_PARAM;
+        }
+        if (*p == '*' && *end) {
+            return UVHTTP_ERROR_INVALID_PARAM;  // catch-all must be last
+        }
+        p = end - 1;
+    }
+    return UVHTTP_OK;
+}
+
+// endpoint of node, created on first use
+static uvhttp_route_endpoint_t* get_endpoint(uvhttp_router_t* router,
+                                             uint32_t node_index) {
+    uvhttp_route_node_t* node = &router->node_pool[node_index];
+    if (node->endpoint != UVHTTP_ROUTE_NONE) {
+        return &router->endpoints[node->endpoint];
+    }
+
+    if (router->endpoint_count >= router->endpoint_capacity) {
+        size_t new_capacity =
+            router->endpoint_capacity ? router->endpoint_capacity * 2 : 16;
+        uvhttp_route_endpoint_t* new_endpoints =
+            uvhttp_realloc(router->endpoints,
+                           new_capacity * sizeof(uvhttp_route_endpoint_t));
+        if (!new_endpoints) {
+            return NULL;
+        }
+        router->endpoints = new_endpoints;
+        router->endpoint_capacity = new_capacity;
+    }
+
+    uvhttp_route_endpoint_t* endpoint =
+        &router->endpoints[router->endpoint_count];
+    memset(endpoint, 0, sizeof(*endpoint));
+    node->endpoint = router->endpoint_count++;
+    return endpoint;
+}
+
+// insert route pattern into the radix tree
+static uvhttp_error_t insert_route(uvhttp_router_t* router, const char* path,
+                                   uvhttp_method_t method,
+                                   uvhttp_request_handler_t handler) {
+    uvhttp_error_t err = check_route_pattern(path);
+    if (err != UVHTTP_OK) {
+        return err;
+    }
+
+    // names are at most as long as the pattern (the sigil becomes the '\0')
+    char names[MAX_ROUTE_PATH_LEN];
+    size_t names_len = 0;
+    size_t param_count = 0;
+    uint32_t current_index = router->root_index;
+    const char* p = path;
+
+    while (*p) {
+        // static run up to the next ":name" / "*name"
+        const char* run = p;
+        while (*p && !((*p == ':' || *p == '*') && at_segment_start(path, p))) {
+            p++;
+        }
+        if (p > run) {
+            current_index =
+                insert_static(router, current_index, run, (size_t)(p - run));
+            if (current_index == UVHTTP_ROUTE_NONE) {
+                return UVHTTP_ERROR_OUT_OF_MEMORY;
+            }
+        }
+        if (!*p) {
+            break;
+        }
+
+        uint8_t kind =
+            *p == ':' ? UVHTTP_ROUTE_NODE_PARAM : UVHTTP_ROUTE_NODE_CATCH_ALL;
+        const char* name = ++p;
+        while (*p && *p != '/') {
+            p++;
+        }
+        memcpy(names + names_len, name, (size_t)(p - name));
+        names_len += (size_t)(p - name);
+        names[names_len++] = '\0';
+        param_count++;
+
+        current_index = get_wildcard_child(router, current_index, kind);
+        if (current_index == UVHTTP_ROUTE_NONE) {
+            return UVHTTP_ERROR_OUT_OF_MEMORY;
+        }
+    }
+
+    uvhttp_route_endpoint_t* endpoint = get_endpoint(router, current_index);
+    if (!endpoint) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+
+    // patterns ending here share their static text up to the first
+    // parameter, and with it the middleware chain
+    uint32_t chain;
+    err = resolve_chain(router, path, uvhttp_route_lead_len(path), &chain);
+    if (err != UVHTTP_OK) {
+        return err;
+    }
+
+    // names go with the handler: patterns ending here may name their
+    // parameters differently per method
+    char* param_names = NULL;
+    if (names_len > 0) {
+        param_names = uvhttp_alloc(names_len);
+        if (!param_names) {
+            return UVHTTP_ERROR_OUT_OF_MEMORY;
+        }
+        memcpy(param_names, names, names_len);
+    }
+    uvhttp_free(endpoint->param_names[method]);
+    endpoint->param_names[method] = param_names;
+    endpoint->param_counts[method] = (uint8_t)param_count;
+    endpoint->chain = chain;
+    endpoint->handlers[method] = handler;
+    return UVHTTP_OK;
+}
+
 // migrate array router to Trie
 static uvhttp_error_t migrate_to_trie(uvhttp_router_t* router) {
     if (UVHTTP_LIKELY(router->use_trie)) {
@@ -330,34 +647,11 @@ static uvhttp_error_t migrate_to_trie(uvhttp_router_t* router) {
     // migrate all array routers to Trie
     for (size_t i = 0; i < old_count; i++) {
         array_route_t* route = &old_routes[i];
-
-        // build router tree
-        uint32_t current_index = router->root_index;
-        char path_copy[MAX_ROUTE_PATH_LEN];
-        strncpy(path_copy, route->path, sizeof(path_copy) - 1);
-        path_copy[sizeof(path_copy) - 1] = '\0';
-
-        char* token = strtok(path_copy, "/");
-        while (token) {
-            int is_param = (token[0] == ':');
-            if (is_param) {
-                token++;
-            }
-
-            current_index =
-                find_or_create_child(router, current_index, token, is_param);
-            if (current_index == UINT32_MAX) {
-                uvhttp_free(old_routes);  // clean allocated memory
-                return UVHTTP_ERROR_OUT_OF_MEMORY;
-            }
-
-            token = strtok(NULL, "/");
+        uvhttp_error_t err =
+            insert_route(router, route->path, route->method, route->handler);
+        if (err != UVHTTP_OK) {
+            return err;  // array routes stay in place and in use
         }
-
-        // sethandler
-        uvhttp_route_node_t* current = &router->node_pool[current_index];
-        current->method = route->method;
-        current->handler = route->handler;
     }
 
     // switch to Trie pattern
@@ -393,13 +687,25 @@ uvhttp_error_t uvhttp_router_add_route_method(
         return UVHTTP_ERROR_INVALID_PARAM;
     }
 
+    if ((int)method < 0 || (int)method >= UVHTTP_ROUTE_METHOD_COUNT) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    if (router->frozen) {
+        return UVHTTP_ERROR_ROUTER_FROZEN;
+    }
+
     // check if path contains query string (not allowed)
     if (strchr(path, '?') != NULL) {
         return UVHTTP_ERROR_INVALID_PARAM;
     }
 
-    // check if contains path parameter
-    int has_params = (strchr(path, ':') != NULL);
+    // cached matches may be shadowed by the new route, and point into
+    // endpoint and node storage that may move
+    uvhttp_router_match_cache_clear(router->match_cache);
+
+    // check if contains path parameter or catch-all
+    int has_params = (strchr(path, ':') != NULL || strstr(path, "/*") != NULL);
 
     // if has parameter or router count exceeds threshold, use Trie
     if (has_params || router->array_route_count >= HYBRID_THRESHOLD ||
@@ -412,127 +718,235 @@ uvhttp_error_t uvhttp_router_add_route_method(
         }
 
         // add to Trie
-        uint32_t current_index = router->root_index;
-        char path_copy[MAX_ROUTE_PATH_LEN];
-        strncpy(path_copy, path, sizeof(path_copy) - 1);
-        path_copy[sizeof(path_copy) - 1] = '\0';
-
-        char* token = strtok(path_copy, "/");
-        while (token) {
-            int is_param = (token[0] == ':');
-            if (is_param) {
-                token++;
-                // save parameter name - optimization: only calculate strlen
-                // once
-                size_t token_len = strlen(token);
-                for (size_t i = 0; i < token_len; i++) {
-                    if (token[i] == '/') {
-                        uvhttp_route_node_t* current =
-                            &router->node_pool[current_index];
-                        size_t name_len = i < 32 ? i : 31;
-                        memcpy(current->param_name_data, token, name_len);
-                        current->param_name_data[name_len] = '\0';
-                        current->param_name_len = (uint8_t)name_len;
-                        break;
+        uvhttp_error_t err = insert_route(router, path, method, handler);
+        if (err != UVHTTP_OK) {
+            return err;
+        }
+        router->route_count++;
+    } else {
+        // add to array
+        return add_array_route(router, path, method, handler);
+    }
+
+    return UVHTTP_OK;
+}
+
+// parameter value captured during a match, as a slice of the request path
+typedef struct {
+    uint32_t offset;
+    uint32_t len;
+} route_slice_t;
+
+// backtracking state of one tree node on the match path
+typedef struct {
+    uint32_t node; /* node index */
+    uint32_t pos;  /* path offset just past this node */
+    uint8_t stage; /* next branch to try: static, param, catch-all */
+    uint8_t param_count; /* captured slices when the node was entered */
+} route_frame_t;
+
+// walk the tree iteratively over the raw path. Static children are tried
+// before the parameter child, and that before the catch-all; a dead end pops
+// back to the last node with an untried branch. Returns the endpoint index
+// and fills slices, or UVHTTP_ROUTE_NONE.
+static uint32_t match_tree(const uvhttp_router_t* router, const char* path,
+                           size_t len, uvhttp_method_t method,
+                           route_slice_t* slices, size_t* slice_count) {
+    // every node below the root consumes a byte or ends in a catch-all,
+    // and the tree is no deeper than the longest pattern
+    route_frame_t stack[MAX_ROUTE_PATH_LEN + 2];
+    size_t depth = 1;
+    const uvhttp_route_node_t* pool = router->node_pool;
+
+    stack[0].node = router->root_index;
+    stack[0].pos = 0;
+    stack[0].stage = 0;
+    stack[0].param_count = 0;
+
+    while (depth > 0) {
+        route_frame_t* frame = &stack[depth - 1];
+        const uvhttp_route_node_t* node = &pool[frame->node];
+        uint32_t pos = frame->pos;
+        uint8_t param_count = frame->param_count;
+
+        if (frame->stage == 0) {
+            frame->stage = 1;
+            if (pos == len && node->endpoint != UVHTTP_ROUTE_NONE) {
+                const uvhttp_route_endpoint_t* endpoint =
+                    &router->endpoints[node->endpoint];
+                if (endpoint->handlers[method] ||
+                    endpoint->handlers[UVHTTP_ANY]) {
+                    *slice_count = param_count;
+                    return node->endpoint;
+                }
+            }
+            if (pos < len) {
+                uint32_t child_index =
+                    find_static_child(node, (uint8_t)path[pos]);
+                if (child_index != UVHTTP_ROUTE_NONE) {
+                    const uvhttp_route_node_t* child = &pool[child_index];
+                    if (len - pos >= child->prefix_len &&
+                        memcmp(path + pos, child->prefix, child->prefix_len) ==
+                            0) {
+                        stack[depth].node = child_index;
+                        stack[depth].pos = pos + child->prefix_len;
+                        stack[depth].stage = 0;
+                        stack[depth].param_count = param_count;
+                        depth++;
+                        continue;
                     }
                 }
             }
+        }
 
-            current_index =
-                find_or_create_child(router, current_index, token, is_param);
-            if (current_index == UINT32_MAX) {
-                return UVHTTP_ERROR_OUT_OF_MEMORY;
+        if (frame->stage == 1) {
+            frame->stage = 2;
+            if (node->param_child != UVHTTP_ROUTE_NONE && pos < len &&
+                path[pos] != '/' && param_count < MAX_PARAMS) {
+                const char* end = memchr(path + pos, '/', len - pos);
+                uint32_t end_pos =
+                    end ? (uint32_t)(end - path) : (uint32_t)len;
+                slices[param_count].offset = pos;
+                slices[param_count].len = end_pos - pos;
+                stack[depth].node = node->param_child;
+                stack[depth].pos = end_pos;
+                stack[depth].stage = 0;
+                stack[depth].param_count = (uint8_t)(param_count + 1);
+                depth++;
+                continue;
             }
+        }
 
-            token = strtok(NULL, "/");
+        if (frame->stage == 2) {
+            frame->stage = 3;
+            if (node->catch_all_child != UVHTTP_ROUTE_NONE &&
+                param_count < MAX_PARAMS) {
+                slices[param_count].offset = pos;
+                slices[param_count].len = (uint32_t)len - pos;
+                stack[depth].node = node->catch_all_child;
+                stack[depth].pos = (uint32_t)len;
+                stack[depth].stage = 0;
+                stack[depth].param_count = (uint8_t)(param_count + 1);
+                depth++;
+                continue;
+            }
         }
 
-        // sethandler
-        uvhttp_route_node_t* current = &router->node_pool[current_index];
-        current->method = method;
-        current->handler = handler;
-        router->route_count++;
-    } else {
-        // add to array
-        return add_array_route(router, path, method, handler);
+        depth--;  // backtrack
     }
 
-    return UVHTTP_OK;
+    return UVHTTP_ROUTE_NONE;
 }
 
-// match route node recursively - using indices for cache optimization
-static int match_route_node(const uvhttp_router_t* router, uint32_t node_index,
-                            const char** segments, size_t segment_count,
-                            size_t segment_index, uvhttp_method_t method,
-                            uvhttp_route_match_t* match) {
-    if (node_index == UINT32_MAX || !router || !segments || !match) {
-        return -1;
+// find route in the tree; fill match (handler and params) when given
+static uvhttp_request_handler_t find_trie_route(const uvhttp_router_t* router,
+                                                const char* path, size_t len,
+                                                uvhttp_method_t method,
+                                                uvhttp_route_match_t* match) {
+    if (UVHTTP_UNLIKELY(len > UINT32_MAX)) {
+        return NULL;
     }
 
-    const uvhttp_route_node_t* node = &router->node_pool[node_index];
+    route_slice_t slices[MAX_PARAMS];
+    size_t slice_count = 0;
+    uint32_t endpoint_index =
+        match_tree(router, path, len, method, slices, &slice_count);
+    if (endpoint_index == UVHTTP_ROUTE_NONE) {
+        return NULL;
+    }
 
-    // if is leaf node
-    if (segment_index >= segment_count) {
-        if (node->handler &&
-            (node->method == UVHTTP_ANY || node->method == method)) {
-            match->handler = node->handler;
-            return 0;
-        }
-        return -1;
+    const uvhttp_route_endpoint_t* endpoint =
+        &router->endpoints[endpoint_index];
+    int slot = endpoint->handlers[method] ? (int)method : UVHTTP_ANY;
+    uvhttp_request_handler_t handler = endpoint->handlers[slot];
+    if (!match) {
+        return handler;
     }
 
-    const char* segment = segments[segment_index];
-
-    // find matching child node - use indices for better cache locality
-    for (size_t i = 0; i < node->child_count; i++) {
-        uint32_t child_index = node->child_indices[i];
-        const uvhttp_route_node_t* child = &router->node_pool[child_index];
-
-        if (child->is_param) {
-            // parameter node, match any segment
-            size_t name_len = child->param_name_len;
-            size_t name_copy_len =
-                name_len < sizeof(match->params[match->param_count].name) - 1
-                    ? name_len
-                    : sizeof(match->params[match->param_count].name) - 1;
-            memcpy(match->params[match->param_count].name,
-                   child->param_name_data, name_copy_len);
-            match->params[match->param_count].name[name_copy_len] = '\0';
-
-            size_t value_len = strlen(segment);
-            size_t value_copy_len =
-                value_len < sizeof(match->params[match->param_count].value) - 1
-                    ? value_len
-                    : sizeof(match->params[match->param_count].value) - 1;
-            memcpy(match->params[match->param_count].value, segment,
-                   value_copy_len);
-            match->params[match->param_count].value[value_copy_len] = '\0';
-
-            match->param_count++;
-
-            int result =
-                match_route_node(router, child_index, segments, segment_count,
-                                 segment_index + 1, method, match);
-            if (result == 0) {
-                return 0;
-            }
-            match->param_count--;  // backtrack
-        } else {
-            // exact match - use segment_len for faster comparison
-            size_t seg_len = strlen(segment);
-            if (seg_len == child->segment_len &&
-                strncmp(child->segment_data, segment, seg_len) == 0) {
-                int result = match_route_node(router, child_index, segments,
-                                              segment_count, segment_index + 1,
-                                              method, match);
-                if (result == 0) {
-                    return 0;
-                }
+    // record slices only once the match is final; names are located in the
+    // "name\0name\0" table of the pattern that registered the handler
+    const char* names = endpoint->param_names[slot];
+    size_t name_count = endpoint->param_counts[slot];
+    size_t name_offset = 0;
+    for (size_t i = 0; i < slice_count && i < name_count; i++) {
+        uvhttp_param_slice_t* param = &match->params[i];
+        size_t name_len = strlen(names + name_offset);
+        param->name_offset = (uint16_t)name_offset;
+        param->name_len = (uint16_t)name_len;
+        param->value_offset = slices[i].offset;
+        param->value_len = slices[i].len;
+        name_offset += name_len + 1;
+    }
+    match->param_names = names;
+    match->param_count = slice_count < name_count ? slice_count : name_count;
+    match->handler = handler;
+    set_match_chain(router, endpoint->chain, match);
+    return handler;
+}
+
+// match against the tree, or the array before the switch to the tree
+static uvhttp_request_handler_t lookup_route(const uvhttp_router_t* router,
+                                             const char* path, size_t len,
+                                             uvhttp_method_t method,
+                                             uvhttp_route_match_t* match) {
+    if (UVHTTP_LIKELY(router->use_trie)) {
+        return find_trie_route(router, path, len, method, match);
+    }
+    uint32_t chain = UVHTTP_ROUTE_CHAIN_NONE;
+    uvhttp_request_handler_t handler =
+        find_array_route(router, path, method, &chain);
+    if (match) {
+        match->handler = handler;
+        set_match_chain(router, chain, match);
+    }
+    return handler;
+}
+
+// frozen table first; the tree or array only when the table is partial
+static uvhttp_request_handler_t find_route(const uvhttp_router_t* router,
+                                           const char* path,
+                                           uvhttp_method_t method,
+                                           uvhttp_route_match_t* match) {
+    size_t len = strlen(path);
+    uvhttp_request_handler_t handler = NULL;
+
+    if (router->frozen) {
+        uint32_t chain = UVHTTP_ROUTE_CHAIN_NONE;
+        handler = uvhttp_router_frozen_lookup(router->frozen, path, len, method,
+                                              &chain);
+        if (handler || !router->frozen_partial) {
+            if (match) {
+                match->handler = handler;
+                set_match_chain(router, chain, match);
             }
+            return handler;
         }
     }
 
-    return -1;
+#    if UVHTTP_FEATURE_ROUTER_MATCH_CACHE
+    // recent matches next; find_handler passes no match, so capture into a
+    // local one to have something to cache
+    if (router->match_cache) {
+        uvhttp_route_match_t local;
+        uvhttp_route_match_t* result = match ? match : &local;
+        if (uvhttp_router_match_cache_get(router->match_cache, path, len,
+                                          method, result)) {
+            return result->handler;
+        }
+        result->param_names = NULL;
+        result->param_count = 0;
+        result->middleware = NULL;
+        result->middleware_count = 0;
+        handler = lookup_route(router, path, len, method, result);
+        if (handler) {
+            uvhttp_router_match_cache_put(router->match_cache, path, len,
+                                          method, result);
+        }
+        return handler;
+    }
+#    endif
+
+    return lookup_route(router, path, len, method, match);
 }
 
 /* static file request handler wrapper function */
@@ -554,8 +968,13 @@ static int static_file_handler_wrapper(uvhttp_request_t* request,
 
     /* validate the connection pointer — uv_handle_get_data may return
      * uninitialized (non-NULL but invalid) data from a handle whose
-     * data field was never set. Check server as a proxy for validity. */
-    if (!conn || !conn->server || !conn->server->router) {
+     * data field was never set. Check server as a proxy for validity. The
+     * router is the request's virtual host's (set by on_message_complete) */
+    uvhttp_router_t* router = NULL;
+    if (conn && conn->server) {
+        router = conn->router ? conn->router : conn->server->router;
+    }
+    if (!router) {
         uvhttp_response_set_status(response, 500);
         uvhttp_response_set_header(response, "Content-Type", "text/plain");
         uvhttp_response_set_body(response, "Internal Server Error", 21);
@@ -563,9 +982,6 @@ static int static_file_handler_wrapper(uvhttp_request_t* request,
         return -1;
     }
 
-    /* get router */
-    uvhttp_router_t* router = conn->server->router;
-
     /* call static file processing function */
     if (router->static_context) {
 #ifdef UVHTTP_STATIC_FILES_ENABLED
@@ -587,63 +1003,39 @@ static int static_file_handler_wrapper(uvhttp_request_t* request,
     return -1;
 }
 
-uvhttp_request_handler_t uvhttp_router_find_handler(
-    const uvhttp_router_t* router, const char* path, const char* method) {
-    if (UVHTTP_UNLIKELY(!router || !path || !method)) {
-        return NULL;
-    }
-
-    uvhttp_method_t method_enum = uvhttp_method_from_string(method);
-
-    // choose find method based on current pattern
-    if (UVHTTP_LIKELY(router->use_trie)) {
-        // Triefind
-        uvhttp_route_match_t match;
-        memset(&match, 0, sizeof(match));
-
-        // parse path segments
-        char path_copy[MAX_ROUTE_PATH_LEN];
-        strncpy(path_copy, path, sizeof(path_copy) - 1);
-        path_copy[sizeof(path_copy) - 1] = '\0';
-
-        const char* segments[MAX_ROUTE_PATH_LEN];
-        int segment_count = 0;
-
-        char* token = strtok(path_copy, "/");
-        while (token && segment_count < MAX_ROUTE_PATH_LEN) {
-            segments[segment_count++] = token;
-            token = strtok(NULL, "/");
-        }
-
-        // first check static router
-        if (UVHTTP_LIKELY(router->static_prefix && router->static_context)) {
-            size_t prefix_len = strlen(router->static_prefix);
-            if (strncmp(path, router->static_prefix, prefix_len) == 0) {
-                // match static router, return static file handler
-                return static_file_handler_wrapper;
+// static prefix, then the routes, then fallback. match (optional, header
+// already reset) receives the chain; requests no route matched get the
+// chain of the longest prefix covering their path.
+static uvhttp_request_handler_t route_request(const uvhttp_router_t* router,
+                                              const char* path,
+                                              uvhttp_method_t method,
+                                              uvhttp_route_match_t* match) {
+    // first check static router
+    if (UVHTTP_LIKELY(router->static_prefix && router->static_context)) {
+        size_t prefix_len = strlen(router->static_prefix);
+        if (strncmp(path, router->static_prefix, prefix_len) == 0) {
+            // match static router, return static file handler
+            if (match) {
+                set_match_chain(router,
+                                uvhttp_router_middleware_unmatched(
+                                    router->middleware, path),
+                                match);
             }
+            return static_file_handler_wrapper;
         }
+    }
 
-        // matchrouter - use root index
-        if (match_route_node(router, router->root_index, segments,
-                             segment_count, 0, method_enum, &match) == 0) {
-            return match.handler;
-        }
-    } else {
-        // arrayfind - first check static prefix
-        if (UVHTTP_LIKELY(router->static_prefix && router->static_context)) {
-            size_t prefix_len = strlen(router->static_prefix);
-            if (strncmp(path, router->static_prefix, prefix_len) == 0) {
-                // match static router, return static file handler
-                return static_file_handler_wrapper;
-            }
-        }
+    // frozen table, radix tree or array, no parameter capture without match
+    uvhttp_request_handler_t handler = find_route(router, path, method, match);
+    if (handler) {
+        return handler;
+    }
 
-        uvhttp_request_handler_t handler =
-            find_array_route(router, path, method_enum);
-        if (handler) {
-            return handler;
-        }
+    if (match) {
+        set_match_chain(router,
+                        uvhttp_router_middleware_unmatched(
+                            router->middleware, path),
+                        match);
     }
 
     // if no matching router, check fallback router
@@ -654,6 +1046,51 @@ uvhttp_request_handler_t uvhttp_router_find_handler(
     return NULL;
 }
 
+uvhttp_request_handler_t uvhttp_router_find_handler(
+    const uvhttp_router_t* router, const char* path, const char* method) {
+    if (UVHTTP_UNLIKELY(!router || !path || !method)) {
+        return NULL;
+    }
+
+    return route_request(router, path, uvhttp_method_from_string(method), NULL);
+}
+
+uvhttp_request_handler_t uvhttp_router_find_pipeline(
+    const uvhttp_router_t* router, const char* path, const char* method,
+    const uvhttp_middleware_handler_t** middleware, size_t* middleware_count) {
+    if (middleware) {
+        *middleware = NULL;
+    }
+    if (middleware_count) {
+        *middleware_count = 0;
+    }
+    if (UVHTTP_UNLIKELY(!router || !path || !method)) {
+        return NULL;
+    }
+
+    uvhttp_method_t method_enum = uvhttp_method_from_string(method);
+    if (UVHTTP_LIKELY(!router->middleware)) {
+        return route_request(router, path, method_enum, NULL);
+    }
+
+    uvhttp_route_match_t match;
+    match.handler = NULL;
+    match.path = path;
+    match.param_names = NULL;
+    match.param_count = 0;
+    match.middleware = NULL;
+    match.middleware_count = 0;
+    uvhttp_request_handler_t handler =
+        route_request(router, path, method_enum, &match);
+    if (middleware) {
+        *middleware = match.middleware;
+    }
+    if (middleware_count) {
+        *middleware_count = match.middleware_count;
+    }
+    return handler;
+}
+
 uvhttp_error_t uvhttp_router_match(const uvhttp_router_t* router,
                                    const char* path, const char* method,
                                    uvhttp_route_match_t* match) {
@@ -661,7 +1098,13 @@ uvhttp_error_t uvhttp_router_match(const uvhttp_router_t* router,
         return UVHTTP_ERROR_INVALID_PARAM;
     }
 
-    memset(match, 0, sizeof(uvhttp_route_match_t));
+    // only the header is reset; params[] is written for captured slices only
+    match->handler = NULL;
+    match->path = path;
+    match->param_names = NULL;
+    match->param_count = 0;
+    match->middleware = NULL;
+    match->middleware_count = 0;
 
     uvhttp_method_t method_enum = uvhttp_method_from_string(method);
 
@@ -678,55 +1121,211 @@ uvhttp_error_t uvhttp_router_match(const uvhttp_router_t* router,
             }
         }
 
-        uvhttp_request_handler_t handler =
-            find_array_route(router, path, method_enum);
-        if (handler) {
-            match->handler = handler;
-            return UVHTTP_OK;
+        return find_route(router, path, method_enum, match)
+                   ? UVHTTP_OK
+                   : UVHTTP_ERROR_NOT_FOUND;
+    }
+
+    /* optimization 2: frozen static table, then radix tree match over the
+     * raw path (supports parameters and catch-all) */
+    return find_route(router, path, method_enum, match)
+               ? UVHTTP_OK
+               : UVHTTP_ERROR_NOT_FOUND;
+}
+
+// add the static routes below node_index to frozen; path[0..len) spells the
+// node's position. Sets *partial when a parameter or catch-all is found.
+static uvhttp_error_t freeze_static_routes(const uvhttp_router_t* router,
+                                           uint32_t node_index, char* path,
+                                           size_t len,
+                                           uvhttp_router_frozen_t* frozen,
+                                           int* partial) {
+    const uvhttp_route_node_t* node = &router->node_pool[node_index];
+    if (len + node->prefix_len > MAX_ROUTE_PATH_LEN) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    memcpy(path + len, node->prefix, node->prefix_len);
+    len += node->prefix_len;
+
+    if (node->param_child != UVHTTP_ROUTE_NONE ||
+        node->catch_all_child != UVHTTP_ROUTE_NONE) {
+        *partial = 1;
+    }
+
+    if (node->endpoint != UVHTTP_ROUTE_NONE) {
+        const uvhttp_route_endpoint_t* endpoint =
+            &router->endpoints[node->endpoint];
+        for (int m = 0; m < UVHTTP_ROUTE_METHOD_COUNT; m++) {
+            if (!endpoint->handlers[m]) {
+                continue;
+            }
+            uvhttp_error_t err =
+                uvhttp_router_frozen_add(frozen, path, len, (uvhttp_method_t)m,
+                                         endpoint->handlers[m], endpoint->chain);
+            if (err != UVHTTP_OK) {
+                return err;
+            }
         }
-        return UVHTTP_ERROR_NOT_FOUND;
     }
 
-    /* optimization 2: fast path - check static router (no parameters) */
-    /* for paths without parameters, use fast find */
-    int has_params = 0;
-    for (const char* p = path; *p; p++) {
-        if (*p == ':' || *p == '{') {
-            has_params = 1;
-            break;
+    for (uint32_t i = 0; i < node->child_count; i++) {
+        uvhttp_error_t err = freeze_static_routes(router, node->children[i],
+                                                  path, len, frozen, partial);
+        if (err != UVHTTP_OK) {
+            return err;
         }
     }
+    return UVHTTP_OK;
+}
 
-    if (!has_params && router->array_routes && router->array_route_count > 0) {
-        /* no parameter path, use array router fast find */
-        /* but need to check if array_routes is still valid */
-        uvhttp_request_handler_t handler =
-            find_array_route(router, path, method_enum);
-        if (handler) {
-            match->handler = handler;
-            return UVHTTP_OK;
+// 1 if an earlier ANY route on the same path answers every request array
+// route i would: find_array_route stops at the first route that matches, but
+// the frozen table prefers a method's own handler over ANY
+static int array_route_shadowed(const uvhttp_router_t* router, size_t i) {
+    const array_route_t* route = &router->array_routes[i];
+    if (route->method == UVHTTP_ANY) {
+        return 0;
+    }
+    for (size_t j = 0; j < i; j++) {
+        const array_route_t* earlier = &router->array_routes[j];
+        if (earlier->method == UVHTTP_ANY &&
+            strcmp(earlier->path, route->path) == 0) {
+            return 1;
         }
     }
+    return 0;
+}
 
-    /* optimization 3: Trie tree match (supports parameters) */
-    /* parse path segments */
-    char path_copy[MAX_ROUTE_PATH_LEN];
-    strncpy(path_copy, path, sizeof(path_copy) - 1);
-    path_copy[sizeof(path_copy) - 1] = '\0';
+uvhttp_error_t uvhttp_router_freeze(uvhttp_router_t* router) {
+    if (!router) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    if (router->frozen) {
+        return UVHTTP_OK;
+    }
 
-    const char* segments[MAX_ROUTE_PATH_LEN];
-    int segment_count = 0;
+    uvhttp_router_frozen_t* frozen = NULL;
+    uvhttp_error_t err = uvhttp_router_frozen_new(&frozen);
+    if (err != UVHTTP_OK) {
+        return err;
+    }
 
-    char* token = strtok(path_copy, "/");
-    while (token && segment_count < MAX_ROUTE_PATH_LEN) {
-        segments[segment_count++] = token;
-        token = strtok(NULL, "/");
+    int partial = 0;
+    if (router->use_trie) {
+        char path[MAX_ROUTE_PATH_LEN];
+        err = freeze_static_routes(router, router->root_index, path, 0, frozen,
+                                   &partial);
+    } else {
+        // array routes are all static; the earliest registration wins there,
+        // so add them latest first
+        for (size_t i = router->array_route_count; i-- > 0 && err == UVHTTP_OK;) {
+            const array_route_t* route = &router->array_routes[i];
+            if (array_route_shadowed(router, i)) {
+                continue;
+            }
+            err = uvhttp_router_frozen_add(frozen, route->path,
+                                           strlen(route->path), route->method,
+                                           route->handler, route->chain);
+        }
+    }
+    if (err == UVHTTP_OK) {
+        err = uvhttp_router_frozen_build(frozen);
+    }
+    if (err != UVHTTP_OK) {
+        uvhttp_router_frozen_free(frozen);
+        return err;
     }
 
-    return match_route_node(router, router->root_index, segments, segment_count,
-                            0, method_enum, match) == 0
-               ? UVHTTP_OK
-               : UVHTTP_ERROR_NOT_FOUND;
+    router->frozen = frozen;
+    router->frozen_partial = partial;
+    return UVHTTP_OK;
+}
+
+// resolve the chain of every endpoint below node_index again; lead[0..len)
+// is the static text so far, fixed once a parameter node is entered
+static uvhttp_error_t resolve_tree_chains(uvhttp_router_t* router,
+                                          uint32_t node_index, char* lead,
+                                          size_t len, int in_param) {
+    const uvhttp_route_node_t* node = &router->node_pool[node_index];
+    if (node->kind != UVHTTP_ROUTE_NODE_STATIC) {
+        in_param = 1;
+    } else if (!in_param) {
+        if (len + node->prefix_len > MAX_ROUTE_PATH_LEN) {
+            return UVHTTP_ERROR_INVALID_PARAM;
+        }
+        memcpy(lead + len, node->prefix, node->prefix_len);
+        len += node->prefix_len;
+    }
+
+    uvhttp_error_t err;
+    if (node->endpoint != UVHTTP_ROUTE_NONE) {
+        err = resolve_chain(router, lead, len,
+                            &router->endpoints[node->endpoint].chain);
+        if (err != UVHTTP_OK) {
+            return err;
+        }
+    }
+
+    // node_pool does not move while resolving, so node stays valid
+    for (uint32_t i = 0; i < node->child_count; i++) {
+        err = resolve_tree_chains(router, node->children[i], lead, len,
+                                  in_param);
+        if (err != UVHTTP_OK) {
+            return err;
+        }
+    }
+    if (node->param_child != UVHTTP_ROUTE_NONE) {
+        err = resolve_tree_chains(router, node->param_child, lead, len, 1);
+        if (err != UVHTTP_OK) {
+            return err;
+        }
+    }
+    if (node->catch_all_child != UVHTTP_ROUTE_NONE) {
+        err = resolve_tree_chains(router, node->catch_all_child, lead, len, 1);
+        if (err != UVHTTP_OK) {
+            return err;
+        }
+    }
+    return UVHTTP_OK;
+}
+
+uvhttp_error_t uvhttp_router_use(uvhttp_router_t* router, const char* prefix,
+                                 uvhttp_middleware_handler_t middleware) {
+    if (!router || !middleware) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    if (router->frozen) {
+        return UVHTTP_ERROR_ROUTER_FROZEN;
+    }
+
+    if (!router->middleware) {
+        uvhttp_error_t err = uvhttp_router_middleware_new(&router->middleware);
+        if (err != UVHTTP_OK) {
+            return err;
+        }
+    }
+    uvhttp_error_t err =
+        uvhttp_router_middleware_add(router->middleware, prefix, middleware);
+    if (err != UVHTTP_OK) {
+        return err;
+    }
+
+    // cached matches point at the old chains
+    uvhttp_router_match_cache_clear(router->match_cache);
+
+    if (router->use_trie) {
+        char lead[MAX_ROUTE_PATH_LEN];
+        return resolve_tree_chains(router, router->root_index, lead, 0, 0);
+    }
+    for (size_t i = 0; i < router->array_route_count; i++) {
+        array_route_t* route = &router->array_routes[i];
+        err = resolve_chain(router, route->path, strlen(route->path),
+                            &route->chain);
+        if (err != UVHTTP_OK) {
+            return err;
+        }
+    }
+    return UVHTTP_OK;
 }
 
 uvhttp_error_t uvhttp_parse_path_params(const char* path,
@@ -791,12 +1390,15 @@ static int binary_route_handler(uvhttp_request_t* request,
      * were registered via add_binary_route, the context is valid. */
     uvhttp_router_t* r = NULL;
     /* we need to get the router from the request. This requires
-     * going through request->client->connection->server->router */
+     * going through request->client->connection->router */
     uvhttp_connection_t* conn = (uvhttp_connection_t*)request->client->data;
-    if (!conn || !conn->server || !conn->server->router) {
+    if (!conn || !conn->server) {
+        return -1;
+    }
+    r = conn->router ? conn->router : conn->server->router;
+    if (!r) {
         return -1;
     }
-    r = conn->server->router;
     if (!r->static_context) return -1;
 
     uvhttp_response_set_status(response, 200);
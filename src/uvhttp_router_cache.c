@@ -4,6 +4,8 @@
 #    include "uvhttp_constants.h"
 #    include "uvhttp_hash.h"
 #    include "uvhttp_router.h"
+#    include "uvhttp_router_match_cache.h"
+#    include "uvhttp_router_middleware.h"
 #    include "uvhttp_utils.h"
 
 #    include "uvhttp_connection.h"
@@ -29,6 +31,7 @@ typedef struct __attribute__((packed)) {
     uvhttp_method_t method;
     uvhttp_request_handler_t handler;
     uint32_t access_count;
+    uint32_t chain; /* middleware chain id (uvhttp_router_use) */
     uint8_t distance;
     uint8_t _padding[3];
 } hash_entry_t;
@@ -266,10 +269,21 @@ static uvhttp_error_t add_to_hash_table(cache_optimized_router_t* cr,
         }
     }
 
+    /* Patterns sharing their text up to the first ':' share a chain */
+    uint32_t chain = UVHTTP_ROUTE_CHAIN_NONE;
+    if (cr->router.middleware) {
+        uvhttp_error_t err = uvhttp_router_middleware_resolve(
+            cr->router.middleware, path, uvhttp_route_lead_len(path), &chain);
+        if (err != UVHTTP_OK) {
+            return err;
+        }
+    }
+
     /* Insert new entry */
     uvhttp_safe_strncpy(entry->path, path, UVHTTP_MAX_ROUTE_PATH_LEN);
     entry->method = method;
     entry->handler = handler;
+    entry->chain = chain;
     entry->access_count = 0;
     entry->distance = 0;
 
@@ -283,11 +297,12 @@ static uvhttp_error_t add_to_hash_table(cache_optimized_router_t* cr,
 /* Find handler and optionally return matched route path.
  * route_path_out (may be NULL): if non-NULL and a param route matched,
  *   set to the entry's path (e.g. "/items/:item_id").
+ * chain_out (may be NULL): set to the entry's middleware chain id.
  * Returns handler or NULL. */
 static uvhttp_request_handler_t find_in_hash_table_ex(
     cache_optimized_router_t* cr,
     const char* path, uvhttp_method_t method,
-    const char** route_path_out) {
+    const char** route_path_out, uint32_t* chain_out) {
     if (!cr || !path) {
         return NULL;
     }
@@ -303,6 +318,7 @@ static uvhttp_request_handler_t find_in_hash_table_ex(
             (entry->method == method || entry->method == UVHTTP_ANY)) {
             if (entry->access_count < UVHTTP_ACCESS_COUNTER_MAX) entry->access_count++;
             if (route_path_out) *route_path_out = entry->path;
+            if (chain_out) *chain_out = entry->chain;
             return entry->handler;
         }
         index = (index + 1) % table->size;
@@ -328,6 +344,7 @@ static uvhttp_request_handler_t find_in_hash_table_ex(
         if (matched && *rp == '\0' && *pp == '\0') {
             if (entry->access_count < UVHTTP_ACCESS_COUNTER_MAX) entry->access_count++;
             if (route_path_out) *route_path_out = entry->path;
+            if (chain_out) *chain_out = entry->chain;
             return entry->handler;
         }
     }
@@ -337,7 +354,7 @@ static uvhttp_request_handler_t find_in_hash_table_ex(
 static uvhttp_request_handler_t find_in_hash_table(cache_optimized_router_t* cr,
                                                    const char* path,
                                                    uvhttp_method_t method) {
-    return find_in_hash_table_ex(cr, path, method, NULL);
+    return find_in_hash_table_ex(cr, path, method, NULL, NULL);
 }
 
 /* ========== Public API Functions ========== */
@@ -360,7 +377,12 @@ static int static_file_handler_wrapper(uvhttp_request_t* request,
     uvhttp_connection_t* conn =
         (uvhttp_connection_t*)uv_handle_get_data((uv_handle_t*)client);
 
-    if (!conn || !conn->server || !conn->server->router) {
+    /* router of the request's virtual host (set by on_message_complete) */
+    uvhttp_router_t* router = NULL;
+    if (conn && conn->server) {
+        router = conn->router ? conn->router : conn->server->router;
+    }
+    if (!router) {
         uvhttp_response_set_status(response, 500);
         uvhttp_response_set_header(response, "Content-Type", "text/plain");
         uvhttp_response_set_body(response, "Internal Server Error", 21);
@@ -368,8 +390,6 @@ static int static_file_handler_wrapper(uvhttp_request_t* request,
         return -1;
     }
 
-    uvhttp_router_t* router = conn->server->router;
-
     /* static file processing — prefer static_context, fall back to
      * fallback_context if the static context is not installed */
     void* ctx = router->static_context ? router->static_context
@@ -432,6 +452,17 @@ uvhttp_error_t uvhttp_router_new(uvhttp_router_t** router) {
         return err;
     }
 
+#    if UVHTTP_FEATURE_ROUTER_MATCH_CACHE
+    err = uvhttp_router_match_cache_new(UVHTTP_ROUTER_MATCH_CACHE_SIZE,
+                                        &cr->router.match_cache);
+    if (err != UVHTTP_OK) {
+        uvhttp_free(cr->hash_table.entries);
+        uvhttp_free(cr);
+        *router = NULL;
+        return err;
+    }
+#    endif
+
     *router = (uvhttp_router_t*)cr;
     return UVHTTP_OK;
 }
@@ -443,6 +474,13 @@ void uvhttp_router_free(uvhttp_router_t* router) {
 
     cache_optimized_router_t* cr = (cache_optimized_router_t*)router;
 
+    uvhttp_router_frozen_free(router->frozen);
+    router->frozen = NULL;
+    uvhttp_router_match_cache_free(router->match_cache);
+    router->match_cache = NULL;
+    uvhttp_router_middleware_free(router->middleware);
+    router->middleware = NULL;
+
     /* Free hash table */
     if (cr->hash_table.entries) {
         uvhttp_free(cr->hash_table.entries);
@@ -502,10 +540,13 @@ uvhttp_error_t uvhttp_router_add_fallback_route(uvhttp_router_t* router,
 static int binary_route_handler(uvhttp_request_t* request,
                                 uvhttp_response_t* response) {
     uvhttp_connection_t* conn = (uvhttp_connection_t*)request->client->data;
-    if (!conn || !conn->server || !conn->server->router) {
+    if (!conn || !conn->server) {
+        return -1;
+    }
+    uvhttp_router_t* r = conn->router ? conn->router : conn->server->router;
+    if (!r) {
         return -1;
     }
-    uvhttp_router_t* r = conn->server->router;
     if (!r->static_context) return -1;
 
     uvhttp_response_set_status(response, 200);
@@ -554,9 +595,15 @@ uvhttp_error_t uvhttp_router_add_route_method(
     if (strchr(path, '?') != NULL) {
         return UVHTTP_ERROR_INVALID_PARAM;
     }
+    if (router->frozen) {
+        return UVHTTP_ERROR_ROUTER_FROZEN;
+    }
 
     cache_optimized_router_t* cr = (cache_optimized_router_t*)router;
 
+    /* Cached matches point into the hash table, which may be resized */
+    uvhttp_router_match_cache_clear(router->match_cache);
+
     /* Add to hash table */
     uvhttp_error_t err = add_to_hash_table(cr, path, method, handler);
     if (err != UVHTTP_OK) {
@@ -587,33 +634,187 @@ uvhttp_error_t uvhttp_router_add_route_method(
     return UVHTTP_OK;
 }
 
+/* Point match at the handlers of a middleware chain */
+static inline void set_match_chain(const uvhttp_router_t* router,
+                                   uint32_t chain,
+                                   uvhttp_route_match_t* match) {
+    if (router->middleware) {
+        match->middleware = uvhttp_router_middleware_chain(
+            router->middleware, chain, &match->middleware_count);
+    }
+}
+
+/* Hash table lookup that also records parameters as slices, by comparing
+ * the route template with the request path.
+ * Route: /items/:item_id  Request: /items/abc123
+ * Result: name = "item_id" in the template, value = "abc123" in path */
+static uvhttp_request_handler_t match_in_hash_table(
+    cache_optimized_router_t* cr, const char* path, uvhttp_method_t method,
+    uvhttp_route_match_t* match) {
+    const char* route_path = NULL;
+    uint32_t chain = UVHTTP_ROUTE_CHAIN_NONE;
+    uvhttp_request_handler_t handler =
+        find_in_hash_table_ex(cr, path, method, &route_path, &chain);
+    match->handler = handler;
+    if (!handler) {
+        return NULL;
+    }
+    set_match_chain(&cr->router, chain, match);
+
+    match->param_names = route_path;
+    if (route_path && strchr(route_path, ':')) {
+        const char* rp = route_path;
+        const char* pp = path;
+        while (*rp && *pp && match->param_count < MAX_PARAMS) {
+            if (*rp == ':') {
+                /* Param name in the route template */
+                const char* name_start = rp + 1;
+                const char* name_end = name_start;
+                while (*name_end && *name_end != '/') name_end++;
+                /* Param value in the request path */
+                const char* val_end = pp;
+                while (*val_end && *val_end != '/') val_end++;
+                if (name_end > name_start) {
+                    uvhttp_param_slice_t* param =
+                        &match->params[match->param_count++];
+                    param->name_offset = (uint16_t)(name_start - route_path);
+                    param->name_len = (uint16_t)(name_end - name_start);
+                    param->value_offset = (uint32_t)(pp - path);
+                    param->value_len = (uint32_t)(val_end - pp);
+                }
+                rp = name_end;
+                pp = val_end;
+            } else if (*rp == *pp) {
+                rp++;
+                pp++;
+            } else {
+                break;
+            }
+        }
+    }
+    return handler;
+}
+
+/* Frozen static table first, then recent matches, then the hash table (only
+ * its param routes once frozen). match may be NULL; otherwise its header
+ * must be reset by the caller. */
+static uvhttp_request_handler_t find_route(const uvhttp_router_t* router,
+                                           const char* path,
+                                           uvhttp_method_t method,
+                                           uvhttp_route_match_t* match) {
+    cache_optimized_router_t* cr = (cache_optimized_router_t*)router;
+    size_t len = strlen(path);
+
+    if (router->frozen) {
+        uint32_t chain = UVHTTP_ROUTE_CHAIN_NONE;
+        uvhttp_request_handler_t handler = uvhttp_router_frozen_lookup(
+            router->frozen, path, len, method, &chain);
+        if (handler || !router->frozen_partial) {
+            if (match) {
+                match->handler = handler;
+                set_match_chain(router, chain, match);
+            }
+            return handler;
+        }
+    }
+
+#    if UVHTTP_FEATURE_ROUTER_MATCH_CACHE
+    if (router->match_cache) {
+        uvhttp_route_match_t local;
+        uvhttp_route_match_t* result = match ? match : &local;
+        if (uvhttp_router_match_cache_get(router->match_cache, path, len,
+                                          method, result)) {
+            return result->handler;
+        }
+        result->param_names = NULL;
+        result->param_count = 0;
+        result->middleware = NULL;
+        result->middleware_count = 0;
+        uvhttp_request_handler_t handler =
+            match_in_hash_table(cr, path, method, result);
+        if (handler) {
+            uvhttp_router_match_cache_put(router->match_cache, path, len,
+                                          method, result);
+        }
+        return handler;
+    }
+#    endif
+
+    if (!match) {
+        return find_in_hash_table(cr, path, method);
+    }
+    return match_in_hash_table(cr, path, method, match);
+}
+
+/* Static prefix, then the routes, then fallback (mirrors uvhttp_router.c).
+ * match (optional, header already reset) receives the chain; requests no
+ * route matched get the chain of the longest prefix covering their path */
+static uvhttp_request_handler_t route_request(const uvhttp_router_t* router,
+                                              const char* path,
+                                              uvhttp_method_t method,
+                                              uvhttp_route_match_t* match) {
+    uvhttp_request_handler_t handler = static_prefix_handler(router, path);
+    if (!handler) {
+        handler = find_route(router, path, method, match);
+        if (handler) {
+            return handler;
+        }
+        if (router->fallback_context) {
+            handler = static_file_handler_wrapper;
+        }
+    }
+    if (match) {
+        set_match_chain(router,
+                        uvhttp_router_middleware_unmatched(
+                            router->middleware, path),
+                        match);
+    }
+    return handler;
+}
+
 uvhttp_request_handler_t uvhttp_router_find_handler(
     const uvhttp_router_t* router, const char* path, const char* method) {
     if (!router || !path || !method) {
         return NULL;
     }
 
-    /* static prefix match first (mirrors uvhttp_router.c array mode) */
-    uvhttp_request_handler_t static_h = static_prefix_handler(router, path);
-    if (static_h) {
-        return static_h;
+    return route_request(router, path, fast_method_parse(method), NULL);
+}
+
+uvhttp_request_handler_t uvhttp_router_find_pipeline(
+    const uvhttp_router_t* router, const char* path, const char* method,
+    const uvhttp_middleware_handler_t** middleware, size_t* middleware_count) {
+    if (middleware) {
+        *middleware = NULL;
+    }
+    if (middleware_count) {
+        *middleware_count = 0;
+    }
+    if (!router || !path || !method) {
+        return NULL;
     }
 
-    cache_optimized_router_t* cr = (cache_optimized_router_t*)router;
     uvhttp_method_t method_enum = fast_method_parse(method);
+    if (!router->middleware) {
+        return route_request(router, path, method_enum, NULL);
+    }
 
+    uvhttp_route_match_t match;
+    match.handler = NULL;
+    match.path = path;
+    match.param_names = NULL;
+    match.param_count = 0;
+    match.middleware = NULL;
+    match.middleware_count = 0;
     uvhttp_request_handler_t handler =
-        find_in_hash_table(cr, path, method_enum);
-    if (handler) {
-        return handler;
+        route_request(router, path, method_enum, &match);
+    if (middleware) {
+        *middleware = match.middleware;
     }
-
-    /* fallback router (mirrors uvhttp_router.c) */
-    if (router->fallback_context) {
-        return static_file_handler_wrapper;
+    if (middleware_count) {
+        *middleware_count = match.middleware_count;
     }
-
-    return NULL;
+    return handler;
 }
 
 uvhttp_error_t uvhttp_router_match(const uvhttp_router_t* router,
@@ -623,7 +824,6 @@ uvhttp_error_t uvhttp_router_match(const uvhttp_router_t* router,
         return UVHTTP_ERROR_INVALID_PARAM;
     }
 
-    cache_optimized_router_t* cr = (cache_optimized_router_t*)router;
     uvhttp_method_t method_enum = fast_method_parse(method);
 
     /* Static prefix is only checked in array mode (mirrors uvhttp_router.c:
@@ -634,59 +834,138 @@ uvhttp_error_t uvhttp_router_match(const uvhttp_router_t* router,
         size_t prefix_len = strlen(router->static_prefix);
         if (strncmp(path, router->static_prefix, prefix_len) == 0) {
             match->handler = static_file_handler_wrapper;
+            match->path = path;
+            match->param_names = NULL;
             match->param_count = 0;
+            match->middleware = NULL;
+            match->middleware_count = 0;
+            set_match_chain(router,
+                            uvhttp_router_middleware_unmatched(
+                                router->middleware, path),
+                            match);
             return UVHTTP_OK;
         }
     }
 
-    /* Search in hash table */
-    const char* route_path = NULL;
-    uvhttp_request_handler_t handler = find_in_hash_table_ex(cr, path, method_enum, &route_path);
+    match->handler = NULL;
+    match->path = path;
+    match->param_names = NULL;
+    match->param_count = 0;
+    match->middleware = NULL;
+    match->middleware_count = 0;
 
-    if (!handler) {
-        return UVHTTP_ERROR_NOT_FOUND;
+    return find_route(router, path, method_enum, match)
+               ? UVHTTP_OK
+               : UVHTTP_ERROR_NOT_FOUND;
+}
+
+/* 1 if an ANY entry for the same path comes before entry index in its
+ * probe sequence: the lookup answers with the first entry that matches, the
+ * frozen table with a method's own handler before ANY */
+static int hash_entry_shadowed(const hash_table_t* table, uint32_t index) {
+    const hash_entry_t* entry = &table->entries[index];
+    if (entry->method == UVHTTP_ANY) {
+        return 0;
     }
+    for (uint32_t i = route_hash(entry->path) % table->size; i != index;
+         i = (i + 1) % table->size) {
+        const hash_entry_t* earlier = &table->entries[i];
+        if (earlier->path[0] == '\0') {
+            break;
+        }
+        if (earlier->method == UVHTTP_ANY &&
+            strcmp(earlier->path, entry->path) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
 
-    match->handler = handler;
-    match->param_count = 0;
+uvhttp_error_t uvhttp_router_freeze(uvhttp_router_t* router) {
+    if (!router) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    if (router->frozen) {
+        return UVHTTP_OK;
+    }
 
-    /* Extract parameters by comparing route template with request path.
-     * Route: /items/:item_id  Request: /items/abc123
-     * Result: param name="item_id", value="abc123" */
-    if (route_path && strchr(route_path, ':')) {
-        const char* rp = route_path;
-        const char* pp = path;
-        while (*rp && *pp && match->param_count < MAX_PARAMS) {
-            if (*rp == ':') {
-                /* Extract param name from route template */
-                const char* name_start = rp + 1;
-                const char* name_end = name_start;
-                while (*name_end && *name_end != '/') name_end++;
-                size_t name_len = name_end - name_start;
-                /* Extract param value from request path */
-                const char* val_end = pp;
-                while (*val_end && *val_end != '/') val_end++;
-                if (name_len > 0 && name_len < sizeof(match->params[match->param_count].name)) {
-                    strncpy(match->params[match->param_count].name, name_start, name_len);
-                    match->params[match->param_count].name[name_len] = '\0';
-                    size_t val_len = val_end - pp;
-                    if (val_len < sizeof(match->params[match->param_count].value)) {
-                        strncpy(match->params[match->param_count].value, pp, val_len);
-                        match->params[match->param_count].value[val_len] = '\0';
-                        match->param_count++;
-                    }
-                }
-                rp = name_end;
-                pp = val_end;
-            } else if (*rp == *pp) {
-                rp++;
-                pp++;
-            } else {
-                break;
-            }
+    cache_optimized_router_t* cr = (cache_optimized_router_t*)router;
+    uvhttp_router_frozen_t* frozen = NULL;
+    uvhttp_error_t err = uvhttp_router_frozen_new(&frozen);
+    if (err != UVHTTP_OK) {
+        return err;
+    }
+
+    /* Static entries move to the perfect hash; param entries stay behind */
+    int partial = 0;
+    for (size_t i = 0; i < cr->hash_table.size && err == UVHTTP_OK; i++) {
+        const hash_entry_t* entry = &cr->hash_table.entries[i];
+        if (entry->path[0] == '\0') {
+            continue;
+        }
+        if (strchr(entry->path, ':')) {
+            partial = 1;
+            continue;
+        }
+        if (hash_entry_shadowed(&cr->hash_table, (uint32_t)i)) {
+            continue;
         }
+        err = uvhttp_router_frozen_add(frozen, entry->path, strlen(entry->path),
+                                       entry->method, entry->handler,
+                                       entry->chain);
+    }
+    if (err == UVHTTP_OK) {
+        err = uvhttp_router_frozen_build(frozen);
+    }
+    if (err != UVHTTP_OK) {
+        uvhttp_router_frozen_free(frozen);
+        return err;
     }
 
+    router->frozen = frozen;
+    router->frozen_partial = partial;
+    return UVHTTP_OK;
+}
+
+uvhttp_error_t uvhttp_router_use(uvhttp_router_t* router, const char* prefix,
+                                 uvhttp_middleware_handler_t middleware) {
+    if (!router || !middleware) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    if (router->frozen) {
+        return UVHTTP_ERROR_ROUTER_FROZEN;
+    }
+
+    if (!router->middleware) {
+        uvhttp_error_t err = uvhttp_router_middleware_new(&router->middleware);
+        if (err != UVHTTP_OK) {
+            return err;
+        }
+    }
+    uvhttp_error_t err =
+        uvhttp_router_middleware_add(router->middleware, prefix, middleware);
+    if (err != UVHTTP_OK) {
+        return err;
+    }
+
+    /* Cached matches point at the old chains */
+    uvhttp_router_match_cache_clear(router->match_cache);
+
+    cache_optimized_router_t* cr = (cache_optimized_router_t*)router;
+    for (size_t i = 0; i < cr->hash_table.size; i++) {
+        hash_entry_t* entry = &cr->hash_table.entries[i];
+        if (entry->path[0] == '\0') {
+            continue;
+        }
+        uint32_t chain = UVHTTP_ROUTE_CHAIN_NONE;
+        err = uvhttp_router_middleware_resolve(
+            router->middleware, entry->path, uvhttp_route_lead_len(entry->path),
+            &chain);
+        if (err != UVHTTP_OK) {
+            return err;
+        }
+        entry->chain = chain; /* entries are packed */
+    }
     return UVHTTP_OK;
 }
 
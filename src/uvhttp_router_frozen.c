@@ -0,0 +1,346 @@
+#include "uvhttp_router_frozen.h"
+
+#include "uvhttp_allocator.h"
+#include "uvhttp_hash.h"
+#include "uvhttp_router.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Hash-and-displace minimal perfect hash (the PTHash construction):
+ * a key's 64-bit hash picks a bucket from its high half; each bucket stores
+ * a pilot, and slot = mix(hash ^ pilot_mix(pilot)) % count. Buckets are
+ * placed largest first, trying pilots until all of a bucket's keys land on
+ * free slots. About four keys per bucket keeps the pilot array small while
+ * the search stays short; if a bucket cannot be placed the whole table is
+ * retried with another seed.
+ */
+
+#define FROZEN_KEYS_PER_BUCKET 4
+#define FROZEN_MAX_PILOT (1u << 20)
+#define FROZEN_MAX_SEEDS 32
+
+typedef struct {
+    uint32_t key_offset; /* into keys */
+    uint32_t key_len;
+    uvhttp_request_handler_t handlers[UVHTTP_ROUTE_METHOD_COUNT];
+    uint32_t chain; /* middleware chain id */
+} frozen_slot_t;
+
+struct uvhttp_router_frozen {
+    frozen_slot_t* slots; /* slot_count entries once built, else added */
+    uint32_t* pilots;     /* one per bucket */
+    char* keys;           /* all paths back to back */
+    uint64_t seed;
+    uint32_t slot_count;
+    uint32_t bucket_count;
+    size_t keys_len;
+    size_t keys_capacity;
+    size_t added_count;
+    size_t added_capacity;
+    int built;
+};
+
+static inline uint64_t mix64(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+static inline uint32_t bucket_of(uint64_t hash, uint32_t bucket_count) {
+    return (uint32_t)(((hash >> 32) * bucket_count) >> 32);
+}
+
+static inline uint32_t slot_of(uint64_t hash, uint32_t pilot,
+                               uint32_t slot_count) {
+    return (uint32_t)(mix64(hash ^ (pilot * 0x9E3779B97F4A7C15ULL)) %
+                      slot_count);
+}
+
+uvhttp_error_t uvhttp_router_frozen_new(uvhttp_router_frozen_t** frozen) {
+    if (!frozen) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    *frozen = uvhttp_calloc(1, sizeof(uvhttp_router_frozen_t));
+    return *frozen ? UVHTTP_OK : UVHTTP_ERROR_OUT_OF_MEMORY;
+}
+
+void uvhttp_router_frozen_free(uvhttp_router_frozen_t* frozen) {
+    if (!frozen) {
+        return;
+    }
+    uvhttp_free(frozen->slots);
+    uvhttp_free(frozen->pilots);
+    uvhttp_free(frozen->keys);
+    uvhttp_free(frozen);
+}
+
+uvhttp_error_t uvhttp_router_frozen_add(uvhttp_router_frozen_t* frozen,
+                                        const char* path, size_t path_len,
+                                        uvhttp_method_t method,
+                                        uvhttp_request_handler_t handler,
+                                        uint32_t chain) {
+    if (!frozen || !path || !handler || frozen->built ||
+        (int)method < 0 || (int)method >= UVHTTP_ROUTE_METHOD_COUNT ||
+        path_len > UINT32_MAX || frozen->keys_len + path_len > UINT32_MAX) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    if (frozen->added_count == frozen->added_capacity) {
+        size_t capacity =
+            frozen->added_capacity ? frozen->added_capacity * 2 : 16;
+        frozen_slot_t* slots =
+            uvhttp_realloc(frozen->slots, capacity * sizeof(frozen_slot_t));
+        if (!slots) {
+            return UVHTTP_ERROR_OUT_OF_MEMORY;
+        }
+        frozen->slots = slots;
+        frozen->added_capacity = capacity;
+    }
+    if (frozen->keys_len + path_len > frozen->keys_capacity) {
+        size_t capacity = frozen->keys_capacity ? frozen->keys_capacity : 256;
+        while (capacity < frozen->keys_len + path_len) {
+            capacity *= 2;
+        }
+        char* keys = uvhttp_realloc(frozen->keys, capacity);
+        if (!keys) {
+            return UVHTTP_ERROR_OUT_OF_MEMORY;
+        }
+        frozen->keys = keys;
+        frozen->keys_capacity = capacity;
+    }
+
+    frozen_slot_t* slot = &frozen->slots[frozen->added_count++];
+    memset(slot, 0, sizeof(*slot));
+    slot->key_offset = (uint32_t)frozen->keys_len;
+    slot->key_len = (uint32_t)path_len;
+    slot->handlers[method] = handler;
+    slot->chain = chain;
+    memcpy(frozen->keys + frozen->keys_len, path, path_len);
+    frozen->keys_len += path_len;
+    return UVHTTP_OK;
+}
+
+/* Merge entries that share a path, later handlers replacing earlier ones.
+ * Returns the number of distinct paths, left at the front of slots. */
+static size_t merge_duplicates(uvhttp_router_frozen_t* frozen,
+                               uint32_t* table, size_t table_size) {
+    size_t unique = 0;
+    memset(table, 0xff, table_size * sizeof(uint32_t));
+
+    for (size_t i = 0; i < frozen->added_count; i++) {
+        frozen_slot_t* entry = &frozen->slots[i];
+        const char* key = frozen->keys + entry->key_offset;
+        size_t pos = (size_t)uvhttp_hash_default(key, entry->key_len) &
+                     (table_size - 1);
+
+        while (table[pos] != UINT32_MAX) {
+            frozen_slot_t* other = &frozen->slots[table[pos]];
+            if (other->key_len == entry->key_len &&
+                memcmp(frozen->keys + other->key_offset, key,
+                       entry->key_len) == 0) {
+                break;
+            }
+            pos = (pos + 1) & (table_size - 1);
+        }
+
+        if (table[pos] == UINT32_MAX) {
+            table[pos] = (uint32_t)unique;
+            frozen->slots[unique++] = *entry;
+            continue;
+        }
+        frozen_slot_t* merged = &frozen->slots[table[pos]];
+        for (int m = 0; m < UVHTTP_ROUTE_METHOD_COUNT; m++) {
+            if (entry->handlers[m]) {
+                merged->handlers[m] = entry->handlers[m];
+            }
+        }
+        merged->chain = entry->chain;
+    }
+    return unique;
+}
+
+typedef struct {
+    uint32_t bucket;
+    uint32_t size;
+} bucket_order_t;
+
+static int compare_bucket_size(const void* a, const void* b) {
+    const bucket_order_t* x = a;
+    const bucket_order_t* y = b;
+    if (x->size != y->size) {
+        return x->size > y->size ? -1 : 1;
+    }
+    return x->bucket < y->bucket ? -1 : (x->bucket > y->bucket);
+}
+
+/* Try to place every key with one seed. On success pilots[] is filled and
+ * position[i] is the slot of key i. */
+static int place_keys(const uvhttp_router_frozen_t* frozen, uint32_t n,
+                      uint32_t bucket_count, uint64_t seed, uint64_t* hashes,
+                      uint32_t* bucket_start, uint32_t* members,
+                      bucket_order_t* order, uint8_t* taken, uint32_t* pilots,
+                      uint32_t* position) {
+    for (uint32_t i = 0; i < n; i++) {
+        const frozen_slot_t* entry = &frozen->slots[i];
+        hashes[i] =
+            uvhttp_hash(frozen->keys + entry->key_offset, entry->key_len, seed);
+    }
+
+    // counting sort of keys by bucket
+    memset(bucket_start, 0, (bucket_count + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < n; i++) {
+        bucket_start[bucket_of(hashes[i], bucket_count) + 1]++;
+    }
+    for (uint32_t b = 0; b < bucket_count; b++) {
+        order[b].bucket = b;
+        order[b].size = bucket_start[b + 1];
+        bucket_start[b + 1] += bucket_start[b];
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t b = bucket_of(hashes[i], bucket_count);
+        members[bucket_start[b] + --order[b].size] = i;
+    }
+    for (uint32_t b = 0; b < bucket_count; b++) {
+        order[b].size = bucket_start[b + 1] - bucket_start[b];
+    }
+    qsort(order, bucket_count, sizeof(bucket_order_t), compare_bucket_size);
+
+    memset(taken, 0, n);
+    memset(pilots, 0, bucket_count * sizeof(uint32_t));
+    for (uint32_t o = 0; o < bucket_count && order[o].size > 0; o++) {
+        uint32_t b = order[o].bucket;
+        const uint32_t* keys = members + bucket_start[b];
+        uint32_t size = order[o].size;
+        uint32_t pilot = 0;
+
+        for (; pilot < FROZEN_MAX_PILOT; pilot++) {
+            uint32_t placed = 0;
+            for (; placed < size; placed++) {
+                uint32_t slot = slot_of(hashes[keys[placed]], pilot, n);
+                if (taken[slot]) {
+                    break;
+                }
+                taken[slot] = 1;
+                position[keys[placed]] = slot;
+            }
+            if (placed == size) {
+                break;
+            }
+            // undo this pilot's partial placement
+            while (placed-- > 0) {
+                taken[position[keys[placed]]] = 0;
+            }
+        }
+        if (pilot == FROZEN_MAX_PILOT) {
+            return -1;
+        }
+        pilots[b] = pilot;
+    }
+    return 0;
+}
+
+uvhttp_error_t uvhttp_router_frozen_build(uvhttp_router_frozen_t* frozen) {
+    if (!frozen || frozen->built) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    size_t table_size = 16;
+    while (table_size < frozen->added_count * 2) {
+        table_size *= 2;
+    }
+    uint32_t* table = uvhttp_alloc(table_size * sizeof(uint32_t));
+    if (!table) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    uint32_t n = (uint32_t)merge_duplicates(frozen, table, table_size);
+    uvhttp_free(table);
+
+    uint32_t bucket_count = n / FROZEN_KEYS_PER_BUCKET + 1;
+    uint64_t* hashes = uvhttp_alloc((n + 1) * sizeof(uint64_t));
+    uint32_t* bucket_start =
+        uvhttp_alloc((bucket_count + 1) * sizeof(uint32_t));
+    uint32_t* members = uvhttp_alloc((n + 1) * sizeof(uint32_t));
+    uint32_t* position = uvhttp_alloc((n + 1) * sizeof(uint32_t));
+    bucket_order_t* order = uvhttp_alloc(bucket_count * sizeof(bucket_order_t));
+    uint8_t* taken = uvhttp_alloc(n + 1);
+    uint32_t* pilots = uvhttp_alloc(bucket_count * sizeof(uint32_t));
+    frozen_slot_t* slots = uvhttp_alloc((n + 1) * sizeof(frozen_slot_t));
+
+    uvhttp_error_t err = UVHTTP_ERROR_OUT_OF_MEMORY;
+    if (hashes && bucket_start && members && position && order && taken &&
+        pilots && slots) {
+        err = UVHTTP_ERROR_ROUTER_INIT;
+        uint64_t seed = UVHTTP_HASH_DEFAULT_SEED;
+        for (int attempt = 0; attempt < FROZEN_MAX_SEEDS; attempt++) {
+            if (place_keys(frozen, n, bucket_count, seed, hashes, bucket_start,
+                           members, order, taken, pilots, position) == 0) {
+                err = UVHTTP_OK;
+                break;
+            }
+            seed = mix64(seed + 0x9E3779B97F4A7C15ULL);
+        }
+
+        if (err == UVHTTP_OK) {
+            for (uint32_t i = 0; i < n; i++) {
+                slots[position[i]] = frozen->slots[i];
+            }
+            uvhttp_free(frozen->slots);
+            frozen->slots = slots;
+            frozen->pilots = pilots;
+            frozen->seed = seed;
+            frozen->slot_count = n;
+            frozen->bucket_count = bucket_count;
+            frozen->built = 1;
+            slots = NULL;
+            pilots = NULL;
+        }
+    }
+
+    uvhttp_free(hashes);
+    uvhttp_free(bucket_start);
+    uvhttp_free(members);
+    uvhttp_free(position);
+    uvhttp_free(order);
+    uvhttp_free(taken);
+    uvhttp_free(pilots);
+    uvhttp_free(slots);
+    return err;
+}
+
+uvhttp_request_handler_t uvhttp_router_frozen_lookup(
+    const uvhttp_router_frozen_t* frozen, const char* path, size_t path_len,
+    uvhttp_method_t method, uint32_t* chain) {
+    if (UVHTTP_UNLIKELY(!frozen || !frozen->built || frozen->slot_count == 0)) {
+        return NULL;
+    }
+
+    uint64_t hash = uvhttp_hash(path, path_len, frozen->seed);
+    uint32_t pilot = frozen->pilots[bucket_of(hash, frozen->bucket_count)];
+    const frozen_slot_t* slot =
+        &frozen->slots[slot_of(hash, pilot, frozen->slot_count)];
+
+    if (slot->key_len != path_len ||
+        memcmp(frozen->keys + slot->key_offset, path, path_len) != 0) {
+        return NULL;
+    }
+    if ((int)method < 0 || (int)method >= UVHTTP_ROUTE_METHOD_COUNT) {
+        method = UVHTTP_ANY;
+    }
+    if (chain) {
+        *chain = slot->chain;
+    }
+    return slot->handlers[method] ? slot->handlers[method]
+                                  : slot->handlers[UVHTTP_ANY];
+}
+
+size_t uvhttp_router_frozen_count(const uvhttp_router_frozen_t* frozen) {
+    if (!frozen) {
+        return 0;
+    }
+    return frozen->built ? frozen->slot_count : frozen->added_count;
+}
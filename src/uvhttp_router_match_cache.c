@@ -0,0 +1,163 @@
+#include "uvhttp_router_match_cache.h"
+
+#include "uvhttp_allocator.h"
+#include "uvhttp_defaults.h"
+#include "uvhttp_hash.h"
+
+#include <string.h>
+
+/*
+ * One entry per slot, no probing: a new path simply replaces whatever
+ * hashed to the same slot. Entries keep a copy of the path so that a hit is
+ * confirmed byte for byte, and at most MATCH_CACHE_PARAMS slices; routes
+ * with more parameters than that are rare and are just not cached.
+ */
+
+#define MATCH_CACHE_PARAMS 4
+
+typedef struct {
+    uint64_t hash;                    /* of method and path */
+    uvhttp_request_handler_t handler; /* NULL = empty slot */
+    const char* param_names;
+    const uvhttp_middleware_handler_t* middleware;
+    uint32_t middleware_count;
+    uint32_t path_len;
+    uint8_t method;
+    uint8_t param_count;
+    uint8_t _padding[2];
+    uvhttp_param_slice_t params[MATCH_CACHE_PARAMS];
+    char path[UVHTTP_ROUTER_MATCH_CACHE_MAX_PATH];
+} match_cache_entry_t;
+
+struct uvhttp_router_match_cache {
+    match_cache_entry_t* entries;
+    size_t mask; /* capacity - 1 */
+    int dirty;   /* entries stored since the last clear */
+    uvhttp_router_match_cache_stats_t stats;
+};
+
+static inline uint64_t match_hash(const char* path, size_t path_len,
+                                  uvhttp_method_t method) {
+    return uvhttp_hash(path, path_len,
+                       UVHTTP_HASH_DEFAULT_SEED + (uint64_t)method);
+}
+
+uvhttp_error_t uvhttp_router_match_cache_new(
+    size_t capacity, uvhttp_router_match_cache_t** cache) {
+    if (!cache) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    *cache = NULL;
+    if (capacity == 0 || capacity > ((size_t)1 << 20)) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    size_t slots = 1;
+    while (slots < capacity) {
+        slots <<= 1;
+    }
+
+    uvhttp_router_match_cache_t* c = uvhttp_calloc(1, sizeof(*c));
+    if (!c) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    c->entries = uvhttp_calloc(slots, sizeof(match_cache_entry_t));
+    if (!c->entries) {
+        uvhttp_free(c);
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    c->mask = slots - 1;
+    c->stats.capacity = slots;
+
+    *cache = c;
+    return UVHTTP_OK;
+}
+
+void uvhttp_router_match_cache_free(uvhttp_router_match_cache_t* cache) {
+    if (cache) {
+        uvhttp_free(cache->entries);
+        uvhttp_free(cache);
+    }
+}
+
+void uvhttp_router_match_cache_clear(uvhttp_router_match_cache_t* cache) {
+    if (!cache || !cache->dirty) {
+        return;
+    }
+    cache->dirty = 0;
+    memset(cache->entries, 0, (cache->mask + 1) * sizeof(match_cache_entry_t));
+    cache->stats.invalidations++;
+}
+
+int uvhttp_router_match_cache_get(uvhttp_router_match_cache_t* cache,
+                                  const char* path, size_t path_len,
+                                  uvhttp_method_t method,
+                                  uvhttp_route_match_t* match) {
+    if (path_len > UVHTTP_ROUTER_MATCH_CACHE_MAX_PATH) {
+        cache->stats.misses++;
+        return 0;
+    }
+
+    uint64_t hash = match_hash(path, path_len, method);
+    const match_cache_entry_t* entry = &cache->entries[hash & cache->mask];
+    if (!entry->handler || entry->hash != hash ||
+        entry->path_len != path_len || entry->method != (uint8_t)method ||
+        memcmp(entry->path, path, path_len) != 0) {
+        cache->stats.misses++;
+        return 0;
+    }
+
+    cache->stats.hits++;
+    match->handler = entry->handler;
+    match->param_names = entry->param_names;
+    match->param_count = entry->param_count;
+    match->middleware = entry->middleware;
+    match->middleware_count = entry->middleware_count;
+    for (size_t i = 0; i < entry->param_count; i++) {
+        match->params[i] = entry->params[i];
+    }
+    return 1;
+}
+
+void uvhttp_router_match_cache_put(uvhttp_router_match_cache_t* cache,
+                                   const char* path, size_t path_len,
+                                   uvhttp_method_t method,
+                                   const uvhttp_route_match_t* match) {
+    if (!match->handler || path_len > UVHTTP_ROUTER_MATCH_CACHE_MAX_PATH ||
+        match->param_count > MATCH_CACHE_PARAMS) {
+        return;
+    }
+
+    uint64_t hash = match_hash(path, path_len, method);
+    match_cache_entry_t* entry = &cache->entries[hash & cache->mask];
+    if (entry->handler) {
+        cache->stats.evictions++;
+    }
+
+    entry->hash = hash;
+    entry->handler = match->handler;
+    entry->param_names = match->param_names;
+    entry->middleware = match->middleware;
+    entry->middleware_count = (uint32_t)match->middleware_count;
+    entry->path_len = (uint32_t)path_len;
+    entry->method = (uint8_t)method;
+    entry->param_count = (uint8_t)match->param_count;
+    for (size_t i = 0; i < match->param_count; i++) {
+        entry->params[i] = match->params[i];
+    }
+    memcpy(entry->path, path, path_len);
+    cache->dirty = 1;
+}
+
+uvhttp_error_t uvhttp_router_get_match_cache_stats(
+    const uvhttp_router_t* router, uvhttp_router_match_cache_stats_t* stats) {
+    if (!router || !stats) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    if (router->match_cache) {
+        *stats = router->match_cache->stats;
+    } else {
+        memset(stats, 0, sizeof(*stats));
+    }
+    return UVHTTP_OK;
+}
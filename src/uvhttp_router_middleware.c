@@ -0,0 +1,270 @@
+#include "uvhttp_router_middleware.h"
+
+#include "uvhttp_allocator.h"
+
+#include <string.h>
+
+typedef struct {
+    char* prefix;
+    size_t prefix_len;
+    uvhttp_middleware_handler_t handler;
+    uint32_t chain; /* for requests no route matched under prefix */
+} middleware_use_t;
+
+typedef struct {
+    uint32_t offset; /* into handlers */
+    uint32_t count;
+} middleware_chain_t;
+
+struct uvhttp_router_middleware {
+    middleware_use_t* uses; /* registration order */
+    size_t use_count;
+    size_t use_capacity;
+    uvhttp_middleware_handler_t* handlers; /* all chains back to back */
+    size_t handler_count;
+    size_t handler_capacity;
+    middleware_chain_t* chains; /* chains[UVHTTP_ROUTE_CHAIN_NONE] is empty */
+    uint32_t chain_count;
+    uint32_t chain_capacity;
+};
+
+// 1 if prefix covers lead up to a segment boundary: "/api" covers "/api"
+// and "/api/x" but not "/apix"; "/" covers everything
+static int prefix_applies(const middleware_use_t* use, const char* lead,
+                          size_t lead_len) {
+    if (use->prefix_len > lead_len ||
+        memcmp(use->prefix, lead, use->prefix_len) != 0) {
+        return 0;
+    }
+    return use->prefix_len == lead_len ||
+           use->prefix[use->prefix_len - 1] == '/' ||
+           lead[use->prefix_len] == '/';
+}
+
+static void reset_chains(uvhttp_router_middleware_t* middleware) {
+    middleware->handler_count = 0;
+    middleware->chain_count = 1;
+    middleware->chains[UVHTTP_ROUTE_CHAIN_NONE].offset = 0;
+    middleware->chains[UVHTTP_ROUTE_CHAIN_NONE].count = 0;
+}
+
+// path up to its query, without empty and "." segments, as the file system
+// resolves it: "//admin/./x?y" is "/admin/x". Truncated to size - 1 bytes.
+static size_t normalize_path(const char* path, char* out, size_t size) {
+    size_t len = 0;
+    const char* p = path;
+    while (*p && *p != '?' && *p != '#' && len + 1 < size) {
+        if (*p == '/' && p[1] == '/') {
+            p++;
+            continue;
+        }
+        if (*p == '/' && p[1] == '.' &&
+            (p[2] == '/' || p[2] == '\0' || p[2] == '?' || p[2] == '#')) {
+            p += 2;
+            continue;
+        }
+        out[len++] = *p++;
+    }
+    if (len == 0) {
+        out[len++] = '/';
+    }
+    out[len] = '\0';
+    return len;
+}
+
+uvhttp_error_t uvhttp_router_middleware_new(
+    uvhttp_router_middleware_t** middleware) {
+    if (!middleware) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    *middleware = NULL;
+
+    uvhttp_router_middleware_t* m = uvhttp_calloc(1, sizeof(*m));
+    if (!m) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    m->chain_capacity = 8;
+    m->chains = uvhttp_calloc(m->chain_capacity, sizeof(middleware_chain_t));
+    if (!m->chains) {
+        uvhttp_free(m);
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    reset_chains(m);
+
+    *middleware = m;
+    return UVHTTP_OK;
+}
+
+void uvhttp_router_middleware_free(uvhttp_router_middleware_t* middleware) {
+    if (!middleware) {
+        return;
+    }
+    for (size_t i = 0; i < middleware->use_count; i++) {
+        uvhttp_free(middleware->uses[i].prefix);
+    }
+    uvhttp_free(middleware->uses);
+    uvhttp_free(middleware->handlers);
+    uvhttp_free(middleware->chains);
+    uvhttp_free(middleware);
+}
+
+uvhttp_error_t uvhttp_router_middleware_add(
+    uvhttp_router_middleware_t* middleware, const char* prefix,
+    uvhttp_middleware_handler_t handler) {
+    if (!middleware || !handler) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    if (!prefix || prefix[0] == '\0') {
+        prefix = "/";
+    }
+    size_t prefix_len = strlen(prefix);
+    if (prefix[0] != '/' || prefix_len >= MAX_ROUTE_PATH_LEN ||
+        strpbrk(prefix, ":*?") != NULL) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    if (middleware->use_count >= middleware->use_capacity) {
+        size_t new_capacity =
+            middleware->use_capacity ? middleware->use_capacity * 2 : 8;
+        middleware_use_t* new_uses = uvhttp_realloc(
+            middleware->uses, new_capacity * sizeof(middleware_use_t));
+        if (!new_uses) {
+            return UVHTTP_ERROR_OUT_OF_MEMORY;
+        }
+        middleware->uses = new_uses;
+        middleware->use_capacity = new_capacity;
+    }
+
+    char* copy = uvhttp_alloc(prefix_len + 1);
+    if (!copy) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    memcpy(copy, prefix, prefix_len + 1);
+
+    middleware_use_t* use = &middleware->uses[middleware->use_count++];
+    use->prefix = copy;
+    use->prefix_len = prefix_len;
+    use->handler = handler;
+    use->chain = UVHTTP_ROUTE_CHAIN_NONE;
+
+    // every route gets resolved again, and so does the chain of each prefix
+    // for unrouted requests under it
+    reset_chains(middleware);
+    for (size_t i = 0; i < middleware->use_count; i++) {
+        middleware_use_t* u = &middleware->uses[i];
+        uvhttp_error_t result = uvhttp_router_middleware_resolve(
+            middleware, u->prefix, u->prefix_len, &u->chain);
+        if (result != UVHTTP_OK) {
+            return result;
+        }
+    }
+    return UVHTTP_OK;
+}
+
+uvhttp_error_t uvhttp_router_middleware_resolve(
+    uvhttp_router_middleware_t* middleware, const char* lead,
+    size_t lead_len, uint32_t* chain) {
+    if (!middleware || !lead || !chain) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    *chain = UVHTTP_ROUTE_CHAIN_NONE;
+
+    // append the candidate chain after the existing ones
+    size_t start = middleware->handler_count;
+    for (size_t i = 0; i < middleware->use_count; i++) {
+        const middleware_use_t* use = &middleware->uses[i];
+        if (!prefix_applies(use, lead, lead_len)) {
+            continue;
+        }
+        if (middleware->handler_count >= middleware->handler_capacity) {
+            size_t new_capacity = middleware->handler_capacity
+                                      ? middleware->handler_capacity * 2
+                                      : 16;
+            uvhttp_middleware_handler_t* new_handlers =
+                uvhttp_realloc(middleware->handlers,
+                               new_capacity * sizeof(*new_handlers));
+            if (!new_handlers) {
+                middleware->handler_count = start;
+                return UVHTTP_ERROR_OUT_OF_MEMORY;
+            }
+            middleware->handlers = new_handlers;
+            middleware->handler_capacity = new_capacity;
+        }
+        middleware->handlers[middleware->handler_count++] = use->handler;
+    }
+
+    size_t count = middleware->handler_count - start;
+    if (count == 0) {
+        return UVHTTP_OK;
+    }
+
+    // routes under the same prefixes share a chain
+    const uvhttp_middleware_handler_t* candidate = middleware->handlers + start;
+    for (uint32_t c = 1; c < middleware->chain_count; c++) {
+        const middleware_chain_t* existing = &middleware->chains[c];
+        if (existing->count != count) {
+            continue;
+        }
+        size_t i = 0;
+        while (i < count &&
+               middleware->handlers[existing->offset + i] == candidate[i]) {
+            i++;
+        }
+        if (i == count) {
+            middleware->handler_count = start;
+            *chain = c;
+            return UVHTTP_OK;
+        }
+    }
+
+    if (middleware->chain_count >= middleware->chain_capacity) {
+        uint32_t new_capacity = middleware->chain_capacity * 2;
+        middleware_chain_t* new_chains = uvhttp_realloc(
+            middleware->chains, new_capacity * sizeof(middleware_chain_t));
+        if (!new_chains) {
+            middleware->handler_count = start;
+            return UVHTTP_ERROR_OUT_OF_MEMORY;
+        }
+        middleware->chains = new_chains;
+        middleware->chain_capacity = new_capacity;
+    }
+    middleware_chain_t* added = &middleware->chains[middleware->chain_count];
+    added->offset = (uint32_t)start;
+    added->count = (uint32_t)count;
+    *chain = middleware->chain_count++;
+    return UVHTTP_OK;
+}
+
+uint32_t uvhttp_router_middleware_unmatched(
+    const uvhttp_router_middleware_t* middleware, const char* path) {
+    if (!middleware || middleware->use_count == 0 || !path) {
+        return UVHTTP_ROUTE_CHAIN_NONE;
+    }
+
+    // the longest prefix covering path also covers every shorter one that
+    // does, so its chain is the whole of path's
+    char lead[MAX_ROUTE_PATH_LEN + 1];
+    size_t lead_len = normalize_path(path, lead, sizeof(lead));
+    const middleware_use_t* longest = NULL;
+    for (size_t i = 0; i < middleware->use_count; i++) {
+        const middleware_use_t* use = &middleware->uses[i];
+        if ((!longest || use->prefix_len > longest->prefix_len) &&
+            prefix_applies(use, lead, lead_len)) {
+            longest = use;
+        }
+    }
+    return longest ? longest->chain : UVHTTP_ROUTE_CHAIN_NONE;
+}
+
+const uvhttp_middleware_handler_t* uvhttp_router_middleware_chain(
+    const uvhttp_router_middleware_t* middleware, uint32_t chain,
+    size_t* count) {
+    if (!middleware || chain == UVHTTP_ROUTE_CHAIN_NONE ||
+        chain >= middleware->chain_count) {
+        *count = 0;
+        return NULL;
+    }
+    const middleware_chain_t* c = &middleware->chains[chain];
+    *count = c->count;
+    return middleware->handlers + c->offset;
+}
@@ -25,6 +25,7 @@
 #include "uvhttp_router.h"
 #include "uvhttp_tls.h"
 #include "uvhttp_utils.h"
+#include "uvhttp_vhost.h"
 
 #include <netinet/tcp.h>
 #include <signal.h>
@@ -35,6 +36,7 @@
 #include <uv.h>
 
 #if UVHTTP_FEATURE_WEBSOCKET
+#    include "uvhttp_hash.h"
 #    include "uvhttp_websocket.h"
 #endif
 
@@ -42,6 +44,10 @@
 #    include "uvhttp_gzip_cache.h"
 #endif
 
+#if UVHTTP_FEATURE_SSE
+#    include "uvhttp_sse.h"
+#endif
+
 // WebSocket route entry forward declaration
 #if UVHTTP_FEATURE_WEBSOCKET
 typedef struct ws_route_entry {
@@ -370,6 +376,11 @@ uvhttp_error_t uvhttp_server_free(uvhttp_server_t* server) {
     /* Set freed flag before releasing any resources. */
     server->freed = 1;
 
+#if UVHTTP_FEATURE_SSE
+    /* close event streams first; the loop runs below handle their closes */
+    uvhttp_sse_server_cleanup(server);
+#endif
+
     /* close TCP handle */
     if (!uv_is_closing((uv_handle_t*)&server->tcp_handle)) {
         uv_close((uv_handle_t*)&server->tcp_handle, NULL);
@@ -387,6 +398,8 @@ uvhttp_error_t uvhttp_server_free(uvhttp_server_t* server) {
     }
 
     /* Clean connection pool */
+    uvhttp_vhost_table_free((uvhttp_vhost_table_t*)server->vhosts, server);
+    server->vhosts = NULL;
     if (server->router) {
         uvhttp_router_free(server->router);
     }
@@ -686,6 +699,10 @@ uvhttp_error_t uvhttp_server_enable_tls(uvhttp_server_t* server,
     server->tls_ctx = tls_ctx;
     server->tls_enabled = 1;
 
+    /* virtual hosts registered before TLS was enabled */
+    if (server->vhosts) {
+        return uvhttp_server_enable_vhost_sni(server);
+    }
     return UVHTTP_OK;
 }
 
@@ -1321,6 +1338,273 @@ uvhttp_error_t uvhttp_server_reset_rate_limit_client(uvhttp_server_t* server,
 
 #if UVHTTP_FEATURE_WEBSOCKET
 
+/* ---- topic registry ----
+ *
+ * Every registered connection lives in the dense manager->connections array.
+ * Topics (upgrade paths included) are interned in an open-addressing table
+ * keyed by xxhash, and each topic keeps a dense array of its subscribers.
+ * A node and a topic point at each other's slots, so subscribe, unsubscribe
+ * and removal are O(1) swap-deletes and a broadcast touches only the
+ * topic's members. */
+
+#    define WS_REGISTRY_INITIAL_CAPACITY 16
+#    define WS_NODE_INITIAL_TOPICS 4
+
+static ws_topic_t* ws_topic_find(ws_connection_manager_t* manager,
+                                 const char* name, size_t len,
+                                 uint64_t hash) {
+    if (!manager->topic_table) {
+        return NULL;
+    }
+
+    uint32_t mask = manager->topic_table_size - 1;
+    for (uint32_t i = (uint32_t)hash & mask;; i = (i + 1) & mask) {
+        ws_topic_t* topic = manager->topic_table[i];
+        if (!topic) {
+            return NULL;
+        }
+        if (topic->hash == hash && topic->name_len == len &&
+            memcmp(topic->name, name, len) == 0) {
+            return topic;
+        }
+    }
+}
+
+static ws_topic_t* ws_topic_lookup(ws_connection_manager_t* manager,
+                                   const char* name) {
+    size_t len = strlen(name);
+    return ws_topic_find(manager, name, len, uvhttp_hash_default(name, len));
+}
+
+static void ws_topic_table_place(ws_topic_t** table, uint32_t size,
+                                 ws_topic_t* topic) {
+    uint32_t mask = size - 1;
+    uint32_t i = (uint32_t)topic->hash & mask;
+    while (table[i]) {
+        i = (i + 1) & mask;
+    }
+    table[i] = topic;
+}
+
+static int ws_topic_table_grow(ws_connection_manager_t* manager) {
+    uint32_t size = manager->topic_table_size
+                        ? manager->topic_table_size * 2
+                        : WS_REGISTRY_INITIAL_CAPACITY;
+    ws_topic_t** table = uvhttp_calloc(size, sizeof(ws_topic_t*));
+    if (!table) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < manager->topic_table_size; i++) {
+        if (manager->topic_table[i]) {
+            ws_topic_table_place(table, size, manager->topic_table[i]);
+        }
+    }
+
+    uvhttp_free(manager->topic_table);
+    manager->topic_table = table;
+    manager->topic_table_size = size;
+    return 0;
+}
+
+/* return the topic for name, creating it on first use */
+static ws_topic_t* ws_topic_intern(ws_connection_manager_t* manager,
+                                   const char* name) {
+    size_t len = strlen(name);
+    uint64_t hash = uvhttp_hash_default(name, len);
+
+    ws_topic_t* topic = ws_topic_find(manager, name, len, hash);
+    if (topic) {
+        return topic;
+    }
+
+    /* keep the load factor at or below 1/2 so probes stay short */
+    if ((manager->topic_count + 1) * 2 > manager->topic_table_size &&
+        ws_topic_table_grow(manager) != 0) {
+        return NULL;
+    }
+
+    topic = uvhttp_calloc(1, sizeof(ws_topic_t));
+    if (!topic) {
+        return NULL;
+    }
+    topic->name = uvhttp_alloc(len + 1);
+    if (!topic->name) {
+        uvhttp_free(topic);
+        return NULL;
+    }
+    memcpy(topic->name, name, len + 1);
+    topic->name_len = len;
+    topic->hash = hash;
+
+    ws_topic_table_place(manager->topic_table, manager->topic_table_size,
+                         topic);
+    manager->topic_count++;
+    return topic;
+}
+
+/* drop an empty topic from the table (backward-shift deletion) */
+static void ws_topic_release(ws_connection_manager_t* manager,
+                             ws_topic_t* topic) {
+    uint32_t mask = manager->topic_table_size - 1;
+    uint32_t i = (uint32_t)topic->hash & mask;
+    while (manager->topic_table[i] != topic) {
+        i = (i + 1) & mask;
+    }
+    manager->topic_table[i] = NULL;
+
+    for (uint32_t j = (i + 1) & mask; manager->topic_table[j];
+         j = (j + 1) & mask) {
+        uint32_t home = (uint32_t)manager->topic_table[j]->hash & mask;
+        /* an entry may fill the hole unless its home lies in (i, j] */
+        int stays = (i <= j) ? (home > i && home <= j)
+                             : (home > i || home <= j);
+        if (!stays) {
+            manager->topic_table[i] = manager->topic_table[j];
+            manager->topic_table[j] = NULL;
+            i = j;
+        }
+    }
+
+    manager->topic_count--;
+    uvhttp_free(topic->members);
+    uvhttp_free(topic->name);
+    uvhttp_free(topic);
+}
+
+static uvhttp_error_t ws_node_subscribe(ws_connection_manager_t* manager,
+                                        ws_connection_node_t* node,
+                                        const char* name) {
+    ws_topic_t* topic = ws_topic_intern(manager, name);
+    if (!topic) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+
+    for (uint32_t i = 0; i < node->topic_count; i++) {
+        if (node->topics[i].topic == topic) {
+            return UVHTTP_ERROR_ALREADY_EXISTS;
+        }
+    }
+
+    if (node->topic_count == node->topic_capacity) {
+        uint32_t capacity = node->topic_capacity ? node->topic_capacity * 2
+                                                 : WS_NODE_INITIAL_TOPICS;
+        ws_topic_ref_t* topics =
+            uvhttp_realloc(node->topics, capacity * sizeof(ws_topic_ref_t));
+        if (!topics) {
+            goto oom;
+        }
+        node->topics = topics;
+        node->topic_capacity = capacity;
+    }
+
+    if (topic->count == topic->capacity) {
+        uint32_t capacity = topic->capacity ? topic->capacity * 2
+                                            : WS_REGISTRY_INITIAL_CAPACITY;
+        ws_topic_member_t* members = uvhttp_realloc(
+            topic->members, capacity * sizeof(ws_topic_member_t));
+        if (!members) {
+            goto oom;
+        }
+        topic->members = members;
+        topic->capacity = capacity;
+    }
+
+    node->topics[node->topic_count].topic = topic;
+    node->topics[node->topic_count].slot = topic->count;
+    topic->members[topic->count].node = node;
+    topic->members[topic->count].ref = node->topic_count;
+    topic->count++;
+    node->topic_count++;
+    return UVHTTP_OK;
+
+oom:
+    if (topic->count == 0) {
+        ws_topic_release(manager, topic);
+    }
+    return UVHTTP_ERROR_OUT_OF_MEMORY;
+}
+
+/* remove node->topics[r], swap-deleting on both sides */
+static void ws_node_unsubscribe_at(ws_connection_manager_t* manager,
+                                   ws_connection_node_t* node, uint32_t r) {
+    ws_topic_t* topic = node->topics[r].topic;
+    uint32_t slot = node->topics[r].slot;
+
+    uint32_t last = topic->count - 1;
+    if (slot != last) {
+        ws_topic_member_t moved = topic->members[last];
+        topic->members[slot] = moved;
+        moved.node->topics[moved.ref].slot = slot;
+    }
+    topic->count--;
+
+    last = node->topic_count - 1;
+    if (r != last) {
+        ws_topic_ref_t moved = node->topics[last];
+        node->topics[r] = moved;
+        moved.topic->members[moved.slot].ref = r;
+    }
+    node->topic_count--;
+
+    if (topic->count == 0) {
+        ws_topic_release(manager, topic);
+    }
+}
+
+/* unlink a node from every topic and the connection array, then free it */
+static void ws_node_remove(ws_connection_manager_t* manager,
+                           ws_connection_node_t* node) {
+    while (node->topic_count > 0) {
+        ws_node_unsubscribe_at(manager, node, node->topic_count - 1);
+    }
+
+    uint32_t last = (uint32_t)manager->connection_count - 1;
+    if (node->index != last) {
+        ws_connection_node_t* moved = manager->connections[last];
+        manager->connections[node->index] = moved;
+        moved->index = node->index;
+    }
+    manager->connection_count--;
+
+    if (manager->connection_count == 0) {
+        uvhttp_free(manager->connections);
+        manager->connections = NULL;
+        manager->connection_capacity = 0;
+    }
+
+    if (node->ws_conn && node->ws_conn->registry_node == node) {
+        node->ws_conn->registry_node = NULL;
+    }
+    uvhttp_free(node->topics);
+    uvhttp_free(node);
+}
+
+/* close a registered connection and drop it, unless the close already
+ * removed it re-entrantly */
+static void ws_node_close(ws_connection_manager_t* manager,
+                          ws_connection_node_t* node, const char* reason) {
+    uvhttp_ws_connection_t* ws_conn = node->ws_conn;
+    if (ws_conn) {
+        uvhttp_ws_close(NULL, ws_conn, 1000, reason);
+        if (ws_conn->registry_node != node) {
+            return;
+        }
+    }
+    ws_node_remove(manager, node);
+}
+
+static ws_connection_node_t* ws_node_lookup(uvhttp_server_t* server,
+                                            uvhttp_ws_connection_t* ws_conn) {
+    ws_connection_manager_t* manager = server->ws_connection_manager;
+    ws_connection_node_t* node = ws_conn->registry_node;
+    if (!manager || !node || node->index >= (uint32_t)manager->connection_count ||
+        manager->connections[node->index] != node) {
+        return NULL;
+    }
+    return node;
+}
+
 /**
  * timeout detection timer callback
  * check all connections' activity time, close timeout connections
@@ -1334,38 +1618,18 @@ static void ws_timeout_timer_callback(uv_timer_t* handle) {
     uint64_t current_time = uv_hrtime() / 1000000; /* convert to milliseconds */
     uint64_t timeout_ms = manager->timeout_seconds * 1000;
 
-    ws_connection_node_t* current = manager->connections;
-    ws_connection_node_t* prev = NULL;
-
-    while (current) {
-        ws_connection_node_t* next = current->next;
+    /* walk backwards: swap-delete only moves entries we have already seen */
+    for (int i = manager->connection_count - 1; i >= 0; i--) {
+        if (i >= manager->connection_count) {
+            continue;
+        }
+        ws_connection_node_t* current = manager->connections[i];
 
         /* check if connection has timed out */
         if (current_time - current->last_activity > timeout_ms) {
             UVHTTP_LOG_WARN("WebSocket connection timeout, closing...\n");
-
-            /* closetimeoutconnection */
-            if (current->ws_conn) {
-                uvhttp_ws_close(NULL, current->ws_conn, 1000,
-                                "Connection timeout");
-                current->ws_conn = NULL;
-            }
-
-            /* remove from list */
-            if (prev) {
-                prev->next = next;
-            } else {
-                manager->connections = next;
-            }
-
-            /* release node */
-            uvhttp_free(current);
-            manager->connection_count--;
-        } else {
-            prev = current;
+            ws_node_close(manager, current, "Connection timeout");
         }
-
-        current = next;
     }
 }
 
@@ -1381,9 +1645,9 @@ static void ws_heartbeat_timer_callback(uv_timer_t* handle) {
     ws_connection_manager_t* manager = (ws_connection_manager_t*)handle->data;
     uint64_t current_time = uv_hrtime() / 1000000; /* convert to milliseconds */
 
-    ws_connection_node_t* current = manager->connections;
+    for (int i = 0; i < manager->connection_count; i++) {
+        ws_connection_node_t* current = manager->connections[i];
 
-    while (current) {
         if (current->ws_conn &&
             current->ws_conn->state == UVHTTP_WS_STATE_OPEN) {
             /* check if need to send Ping */
@@ -1406,8 +1670,6 @@ static void ws_heartbeat_timer_callback(uv_timer_t* handle) {
                 }
             }
         }
-
-        current = current->next;
     }
 }
 
@@ -1533,23 +1795,39 @@ uvhttp_error_t uvhttp_server_ws_disable_connection_management(
     }
 
     /* close all connections */
-    ws_connection_node_t* current = manager->connections;
-    while (current) {
-        ws_connection_node_t* next = current->next;
+    for (int i = 0; i < manager->connection_count; i++) {
+        ws_connection_node_t* current = manager->connections[i];
 
         if (current->ws_conn) {
-            /* close and null out the ws_conn pointer so a concurrent
-             * timeout/heartbeat callback does not double-close it */
+            /* close and detach so a later remove_connection is a no-op */
             uvhttp_ws_close(NULL, current->ws_conn, 1000, "Server shutdown");
+            if (current->ws_conn->registry_node == current) {
+                current->ws_conn->registry_node = NULL;
+            }
             current->ws_conn = NULL;
         }
 
+        uvhttp_free(current->topics);
         uvhttp_free(current);
-        current = next;
     }
 
+    for (uint32_t i = 0; i < manager->topic_table_size; i++) {
+        ws_topic_t* topic = manager->topic_table[i];
+        if (topic) {
+            uvhttp_free(topic->members);
+            uvhttp_free(topic->name);
+            uvhttp_free(topic);
+        }
+    }
+
+    uvhttp_free(manager->connections);
+    uvhttp_free(manager->topic_table);
     manager->connections = NULL;
     manager->connection_count = 0;
+    manager->connection_capacity = 0;
+    manager->topic_table = NULL;
+    manager->topic_table_size = 0;
+    manager->topic_count = 0;
     manager->enabled = 0;
 
     /* The timer handles are embedded in the manager struct. uv_close() above
@@ -1592,7 +1870,7 @@ int uvhttp_server_ws_get_connection_count(uvhttp_server_t* server) {
  * get WebSocket connection count for specified path
  *
  * @param server serverinstance
- * @param path path
+ * @param path path or topic name
  * @return connectioncount
  */
 int uvhttp_server_ws_get_connection_count_by_path(uvhttp_server_t* server,
@@ -1601,24 +1879,29 @@ int uvhttp_server_ws_get_connection_count_by_path(uvhttp_server_t* server,
         return 0;
     }
 
-    int count = 0;
-    ws_connection_node_t* current = server->ws_connection_manager->connections;
+    ws_topic_t* topic = ws_topic_lookup(server->ws_connection_manager, path);
+    return topic ? (int)topic->count : 0;
+}
 
-    while (current) {
-        if (strcmp(current->path, path) == 0) {
-            count++;
-        }
-        current = current->next;
+static int ws_broadcast_one(uvhttp_ws_connection_t* ws_conn,
+                            uvhttp_ws_shared_frame_t* frame, const char* data,
+                            size_t len) {
+    if (!ws_conn || ws_conn->state != UVHTTP_WS_STATE_OPEN) {
+        return 0;
     }
-
-    return count;
+    if (ws_conn->is_server) {
+        uvhttp_ws_send_shared(ws_conn, frame);
+    } else {
+        uvhttp_ws_send_text(NULL, ws_conn, data, len);
+    }
+    return 1;
 }
 
 /**
  * broadcast message to all connections on specified path
  *
  * @param server serverinstance
- * @param path path (NULL means broadcast to all connections)
+ * @param path path or topic name (NULL means broadcast to all connections)
  * @param data messagedata
  * @param len messagelength
  * @return UVHTTP_OK success, other values indicate failure
@@ -1634,22 +1917,38 @@ uvhttp_error_t uvhttp_server_ws_broadcast(uvhttp_server_t* server,
         return UVHTTP_ERROR_INVALID_PARAM;
     }
 
-    ws_connection_node_t* current = server->ws_connection_manager->connections;
-    int sent_count = 0;
-
-    while (current) {
-        /* check if path matches (if path is specified) */
-        if (!path || strcmp(current->path, path) == 0) {
-            if (current->ws_conn &&
-                current->ws_conn->state == UVHTTP_WS_STATE_OPEN) {
-                uvhttp_ws_send_text(NULL, current->ws_conn, data, len);
-                sent_count++;
-            }
+    ws_connection_manager_t* manager = server->ws_connection_manager;
+    ws_topic_t* topic = NULL;
+    if (path) {
+        topic = ws_topic_lookup(manager, path);
+        if (!topic) {
+            return UVHTTP_OK; /* no subscribers */
         }
+    }
 
-        current = current->next;
+    /* encode the frame once; every recipient queues a reference to it */
+    uvhttp_ws_shared_frame_t* frame = NULL;
+    uvhttp_error_t ret = uvhttp_ws_shared_frame_create(
+        (const uint8_t*)data, len, UVHTTP_WS_OPCODE_TEXT, &frame);
+    if (ret != UVHTTP_OK) {
+        return ret;
     }
 
+    int sent_count = 0;
+    if (topic) {
+        for (uint32_t i = 0; i < topic->count; i++) {
+            sent_count += ws_broadcast_one(topic->members[i].node->ws_conn,
+                                           frame, data, len);
+        }
+    } else {
+        for (int i = 0; i < manager->connection_count; i++) {
+            sent_count += ws_broadcast_one(manager->connections[i]->ws_conn,
+                                           frame, data, len);
+        }
+    }
+
+    uvhttp_ws_shared_frame_release(frame);
+
     UVHTTP_LOG_DEBUG("WebSocket broadcast: sent to %d connections\n",
                      sent_count);
 
@@ -1660,7 +1959,7 @@ uvhttp_error_t uvhttp_server_ws_broadcast(uvhttp_server_t* server,
  * close all connections on specified path
  *
  * @param server server instance
- * @param path path (NULL means close all connections)
+ * @param path path or topic name (NULL means close all connections)
  * @return UVHTTP_OK success, other values indicate failure
  */
 uvhttp_error_t uvhttp_server_ws_close_all(uvhttp_server_t* server,
@@ -1669,37 +1968,25 @@ uvhttp_error_t uvhttp_server_ws_close_all(uvhttp_server_t* server,
         return UVHTTP_ERROR_INVALID_PARAM;
     }
 
+    ws_connection_manager_t* manager = server->ws_connection_manager;
     int closed_count = 0;
-    ws_connection_node_t* current = server->ws_connection_manager->connections;
-    ws_connection_node_t* prev = NULL;
 
-    while (current) {
-        ws_connection_node_t* next = current->next;
-
-        /* check if path matches (if path is specified) */
-        if (!path || strcmp(current->path, path) == 0) {
-            /* closeconnection */
-            if (current->ws_conn) {
-                uvhttp_ws_close(NULL, current->ws_conn, 1000,
-                                "Server closed connection");
-            }
-
-            /* remove from list */
-            if (prev) {
-                prev->next = next;
-            } else {
-                server->ws_connection_manager->connections = next;
-            }
-
-            /* release node */
-            uvhttp_free(current);
-            server->ws_connection_manager->connection_count--;
+    if (path) {
+        /* the topic is released together with its last member, so look it
+         * up again on every round */
+        ws_topic_t* topic;
+        while ((topic = ws_topic_lookup(manager, path)) != NULL) {
+            ws_node_close(manager, topic->members[topic->count - 1].node,
+                          "Server closed connection");
+            closed_count++;
+        }
+    } else {
+        while (manager->connection_count > 0) {
+            ws_node_close(manager,
+                          manager->connections[manager->connection_count - 1],
+                          "Server closed connection");
             closed_count++;
-        } else {
-            prev = current;
         }
-
-        current = next;
     }
 
     UVHTTP_LOG_DEBUG("WebSocket close_all: closed %d connections\n",
@@ -1708,6 +1995,65 @@ uvhttp_error_t uvhttp_server_ws_close_all(uvhttp_server_t* server,
     return UVHTTP_OK;
 }
 
+/**
+ * subscribe a registered WebSocket connection to a topic
+ *
+ * @param server serverinstance
+ * @param ws_conn connection previously added by the upgrade handler
+ * @param topic topic name
+ * @return UVHTTP_OK success, UVHTTP_ERROR_NOT_FOUND if ws_conn is not
+ *         registered, UVHTTP_ERROR_ALREADY_EXISTS if already subscribed
+ */
+uvhttp_error_t uvhttp_server_ws_subscribe(uvhttp_server_t* server,
+                                          uvhttp_ws_connection_t* ws_conn,
+                                          const char* topic) {
+    if (!server || !ws_conn || !topic || !server->ws_connection_manager) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    ws_connection_node_t* node = ws_node_lookup(server, ws_conn);
+    if (!node) {
+        return UVHTTP_ERROR_NOT_FOUND;
+    }
+
+    return ws_node_subscribe(server->ws_connection_manager, node, topic);
+}
+
+/**
+ * unsubscribe a registered WebSocket connection from a topic
+ *
+ * The connection stays registered even with no topics left; it is still
+ * reached by broadcasts and close_all with a NULL path.
+ *
+ * @param server serverinstance
+ * @param ws_conn registered connection
+ * @param topic topic name
+ * @return UVHTTP_OK success, UVHTTP_ERROR_NOT_FOUND if not subscribed
+ */
+uvhttp_error_t uvhttp_server_ws_unsubscribe(uvhttp_server_t* server,
+                                            uvhttp_ws_connection_t* ws_conn,
+                                            const char* topic) {
+    if (!server || !ws_conn || !topic || !server->ws_connection_manager) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    ws_connection_manager_t* manager = server->ws_connection_manager;
+    ws_connection_node_t* node = ws_node_lookup(server, ws_conn);
+    ws_topic_t* entry = ws_topic_lookup(manager, topic);
+    if (!node || !entry) {
+        return UVHTTP_ERROR_NOT_FOUND;
+    }
+
+    for (uint32_t i = 0; i < node->topic_count; i++) {
+        if (node->topics[i].topic == entry) {
+            ws_node_unsubscribe_at(manager, node, i);
+            return UVHTTP_OK;
+        }
+    }
+
+    return UVHTTP_ERROR_NOT_FOUND;
+}
+
 /**
  * internal function: add WebSocket connection to manager
  */
@@ -1723,25 +2069,49 @@ void uvhttp_server_ws_add_connection(uvhttp_server_t* server,
         return;
     }
 
+    /* already registered: just subscribe it to the path as well */
+    ws_connection_node_t* existing = ws_node_lookup(server, ws_conn);
+    if (existing) {
+        ws_node_subscribe(manager, existing, path);
+        return;
+    }
+
+    if ((uint32_t)manager->connection_count == manager->connection_capacity) {
+        uint32_t capacity = manager->connection_capacity
+                                ? manager->connection_capacity * 2
+                                : WS_REGISTRY_INITIAL_CAPACITY;
+        ws_connection_node_t** connections = uvhttp_realloc(
+            manager->connections, capacity * sizeof(ws_connection_node_t*));
+        if (!connections) {
+            UVHTTP_LOG_ERROR("Failed to grow WebSocket connection registry\n");
+            return;
+        }
+        manager->connections = connections;
+        manager->connection_capacity = capacity;
+    }
+
     /* create connection node */
-    ws_connection_node_t* node = uvhttp_alloc(sizeof(ws_connection_node_t));
+    ws_connection_node_t* node = uvhttp_calloc(1, sizeof(ws_connection_node_t));
     if (!node) {
         UVHTTP_LOG_ERROR("Failed to allocate WebSocket connection node\n");
         return;
     }
 
-    memset(node, 0, sizeof(ws_connection_node_t));
     node->ws_conn = ws_conn;
-    uvhttp_safe_strncpy(node->path, path, sizeof(node->path));
     node->last_activity = uv_hrtime() / 1000000; /* convert to milliseconds */
     node->last_ping_sent = 0;
     node->ping_pending = 0;
-    node->next = NULL;
 
-    /* add to list header */
-    node->next = manager->connections;
-    manager->connections = node;
-    manager->connection_count++;
+    if (ws_node_subscribe(manager, node, path) != UVHTTP_OK) {
+        UVHTTP_LOG_ERROR("Failed to allocate WebSocket topic\n");
+        uvhttp_free(node->topics);
+        uvhttp_free(node);
+        return;
+    }
+
+    node->index = (uint32_t)manager->connection_count;
+    manager->connections[manager->connection_count++] = node;
+    ws_conn->registry_node = node;
 
     UVHTTP_LOG_DEBUG("WebSocket connection added: path=%s, total=%d\n", path,
                      manager->connection_count);
@@ -1761,30 +2131,15 @@ void uvhttp_server_ws_remove_connection(uvhttp_server_t* server,
         return;
     }
 
-    ws_connection_node_t* current = manager->connections;
-    ws_connection_node_t* prev = NULL;
-
-    while (current) {
-        if (current->ws_conn == ws_conn) {
-            /* remove from list */
-            if (prev) {
-                prev->next = current->next;
-            } else {
-                manager->connections = current->next;
-            }
-
-            /* release node */
-            uvhttp_free(current);
-            manager->connection_count--;
+    ws_connection_node_t* node = ws_node_lookup(server, ws_conn);
+    if (!node) {
+        return;
+    }
 
-            UVHTTP_LOG_DEBUG("WebSocket connection removed: total=%d\n",
-                             manager->connection_count);
-            return;
-        }
+    ws_node_remove(manager, node);
 
-        prev = current;
-        current = current->next;
-    }
+    UVHTTP_LOG_DEBUG("WebSocket connection removed: total=%d\n",
+                     manager->connection_count);
 }
 
 /**
@@ -1801,17 +2156,11 @@ void uvhttp_server_ws_update_activity(uvhttp_server_t* server,
         return;
     }
 
-    ws_connection_node_t* current = manager->connections;
-
-    while (current) {
-        if (current->ws_conn == ws_conn) {
-            current->last_activity =
-                uv_hrtime() / 1000000; /* convert to milliseconds */
-            current->ping_pending = 0; /* clear pending Ping flag */
-            return;
-        }
-
-        current = current->next;
+    ws_connection_node_t* node = ws_node_lookup(server, ws_conn);
+    if (node) {
+        node->last_activity =
+            uv_hrtime() / 1000000; /* convert to milliseconds */
+        node->ping_pending = 0;    /* clear pending Ping flag */
     }
 }
 
@@ -0,0 +1,409 @@
+/* UVHTTP shared static file cache - sharded, lock-striped, thread-safe.
+ * Each shard is an LRU cache manager behind its own mutex; see
+ * uvhttp_shared_cache.h for the contract.
+ */
+
+#if UVHTTP_FEATURE_STATIC_FILES
+
+#    include "uvhttp_shared_cache.h"
+
+#    include "uvhttp_allocator.h"
+#    include "uvhttp_hash.h"
+#    include "uvhttp_platform.h"
+
+#    include <string.h>
+#    include <uv.h>
+
+/* One lock stripe. Trailing pad keeps neighbouring shards' locks on
+ * different cache lines. */
+typedef struct {
+    uv_mutex_t lock;
+    cache_manager_t* cache;
+    UVHTTP_CACHE_LINE_PAD;
+} shared_cache_shard_t;
+
+struct uvhttp_shared_cache {
+    shared_cache_shard_t* shards;
+    size_t shard_count; /* initialized shards */
+    size_t shard_mask;  /* stripe count - 1 (power of two) */
+};
+
+static shared_cache_shard_t* shared_cache_shard(uvhttp_shared_cache_t* cache,
+                                                const char* key) {
+    /* the shard's hash table files entries under the low bits */
+    uint64_t hash = uvhttp_hash_default(key, strlen(key));
+    return &cache->shards[(hash >> 32) & cache->shard_mask];
+}
+
+uvhttp_error_t uvhttp_shared_cache_create(size_t shard_count,
+                                          size_t max_memory_usage,
+                                          int max_entries, int cache_ttl,
+                                          uvhttp_shared_cache_t** cache) {
+    if (!cache) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    *cache = NULL;
+    if (max_memory_usage == 0 || max_entries <= 0) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    if (shard_count == 0) {
+        shard_count = UVHTTP_SHARED_CACHE_DEFAULT_SHARDS;
+    }
+    size_t shards = 1;
+    while (shards < shard_count) {
+        shards <<= 1;
+    }
+    size_t per_shard_memory = max_memory_usage / shards;
+    int per_shard_entries = (int)(((size_t)max_entries + shards - 1) / shards);
+    if (per_shard_memory == 0) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    uvhttp_shared_cache_t* c = uvhttp_calloc(1, sizeof(uvhttp_shared_cache_t));
+    if (!c) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+
+    c->shards = uvhttp_calloc(shards, sizeof(shared_cache_shard_t));
+    if (!c->shards) {
+        uvhttp_free(c);
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    c->shard_mask = shards - 1;
+
+    for (size_t i = 0; i < shards; i++) {
+        shared_cache_shard_t* s = &c->shards[i];
+        uvhttp_error_t result = uvhttp_lru_cache_create(
+            per_shard_memory, per_shard_entries, cache_ttl, &s->cache);
+        if (result != UVHTTP_OK || uv_mutex_init(&s->lock) != 0) {
+            uvhttp_lru_cache_free(s->cache);
+            uvhttp_shared_cache_free(c);
+            return result != UVHTTP_OK ? result : UVHTTP_ERROR_OUT_OF_MEMORY;
+        }
+        c->shard_count++;
+    }
+
+    *cache = c;
+    return UVHTTP_OK;
+}
+
+void uvhttp_shared_cache_free(uvhttp_shared_cache_t* cache) {
+    if (!cache) {
+        return;
+    }
+
+    /* shard_count only covers shards whose mutex was initialized, which also
+     * makes this safe on the create() failure path. */
+    for (size_t i = 0; i < cache->shard_count; i++) {
+        uvhttp_lru_cache_free(cache->shards[i].cache);
+        uv_mutex_destroy(&cache->shards[i].lock);
+    }
+    uvhttp_free(cache->shards);
+    uvhttp_free(cache);
+}
+
+uvhttp_error_t uvhttp_shared_cache_set_policy(uvhttp_shared_cache_t* cache,
+                                              uvhttp_cache_policy_t policy) {
+    if (!cache) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    uvhttp_error_t result = UVHTTP_OK;
+    for (size_t i = 0; i < cache->shard_count && result == UVHTTP_OK; i++) {
+        shared_cache_shard_t* s = &cache->shards[i];
+        uv_mutex_lock(&s->lock);
+        result = uvhttp_lru_cache_set_policy(s->cache, policy);
+        uv_mutex_unlock(&s->lock);
+    }
+    return result;
+}
+
+uvhttp_error_t uvhttp_shared_cache_get(uvhttp_shared_cache_t* cache,
+                                       const char* key,
+                                       uvhttp_cache_hit_t* hit) {
+    if (!cache || !key || !hit) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    shared_cache_shard_t* shard = shared_cache_shard(cache, key);
+
+    uv_mutex_lock(&shard->lock);
+    cache_entry_t* entry = uvhttp_lru_cache_find(shard->cache, key);
+    if (entry) {
+        uvhttp_cache_hit_init(hit, entry);
+    }
+    uv_mutex_unlock(&shard->lock);
+
+    return entry ? UVHTTP_OK : UVHTTP_ERROR_NOT_FOUND;
+}
+
+int uvhttp_shared_cache_contains(uvhttp_shared_cache_t* cache,
+                                 const char* key) {
+    if (!cache || !key) {
+        return 0;
+    }
+
+    shared_cache_shard_t* shard = shared_cache_shard(cache, key);
+
+    uv_mutex_lock(&shard->lock);
+    cache_entry_t* entry = uvhttp_lru_cache_peek(shard->cache, key);
+    int live = entry && !uvhttp_lru_cache_is_expired(
+                            entry, shard->cache->cache_ttl);
+    uv_mutex_unlock(&shard->lock);
+
+    return live;
+}
+
+void uvhttp_cache_hit_init(uvhttp_cache_hit_t* hit,
+                           const cache_entry_t* entry) {
+    if (!hit || !entry) {
+        return;
+    }
+
+    hit->buffer = entry->buffer;
+    hit->head = entry->head;
+    hit->head_keepalive_length = entry->head_keepalive_length;
+    hit->mime_type = entry->mime_type;
+    hit->last_modified = entry->last_modified;
+    memcpy(hit->etag, entry->etag, sizeof(hit->etag));
+    memcpy(hit->variants, entry->variants, sizeof(hit->variants));
+    hit->encodings_tried = entry->encodings_tried;
+
+    uvhttp_cache_buffer_retain(hit->buffer);
+    if (hit->head) {
+        uvhttp_cache_buffer_retain(hit->head);
+    }
+    for (int i = 0; i < UVHTTP_CACHE_ENCODING_COUNT; i++) {
+        if (hit->variants[i].buffer) {
+            uvhttp_cache_buffer_retain(hit->variants[i].buffer);
+        }
+        if (hit->variants[i].head) {
+            uvhttp_cache_buffer_retain(hit->variants[i].head);
+        }
+    }
+}
+
+void uvhttp_cache_hit_release(uvhttp_cache_hit_t* hit) {
+    if (!hit) {
+        return;
+    }
+
+    uvhttp_cache_buffer_release(hit->head);
+    uvhttp_cache_buffer_release(hit->buffer);
+    hit->head = NULL;
+    hit->buffer = NULL;
+    for (int i = 0; i < UVHTTP_CACHE_ENCODING_COUNT; i++) {
+        uvhttp_cache_buffer_release(hit->variants[i].head);
+        uvhttp_cache_buffer_release(hit->variants[i].buffer);
+        hit->variants[i].head = NULL;
+        hit->variants[i].buffer = NULL;
+    }
+}
+
+uvhttp_error_t uvhttp_shared_cache_put(uvhttp_shared_cache_t* cache,
+                                       const char* key, const char* content,
+                                       size_t content_length,
+                                       const char* mime_type,
+                                       time_t last_modified, const char* etag) {
+    if (!cache || !key || !content) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    /* Copy outside the lock; the shard critical section stays short. */
+    uvhttp_cache_buffer_t* buffer = uvhttp_cache_buffer_create(content_length);
+    if (!buffer) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    memcpy(buffer->data, content, content_length);
+
+    uvhttp_error_t result = uvhttp_shared_cache_put_buffer(
+        cache, key, buffer, mime_type, last_modified, etag);
+    uvhttp_cache_buffer_release(buffer);
+    return result;
+}
+
+uvhttp_error_t uvhttp_shared_cache_put_buffer(uvhttp_shared_cache_t* cache,
+                                              const char* key,
+                                              uvhttp_cache_buffer_t* buffer,
+                                              const char* mime_type,
+                                              time_t last_modified,
+                                              const char* etag) {
+    if (!cache || !key || !buffer) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    shared_cache_shard_t* shard = shared_cache_shard(cache, key);
+
+    uv_mutex_lock(&shard->lock);
+    uvhttp_error_t result = uvhttp_lru_cache_put_buffer(
+        shard->cache, key, buffer, mime_type, last_modified, etag);
+    uv_mutex_unlock(&shard->lock);
+    return result;
+}
+
+void uvhttp_shared_cache_set_head(uvhttp_shared_cache_t* cache,
+                                  const char* key,
+                                  const uvhttp_cache_buffer_t* content,
+                                  uvhttp_cache_buffer_t* head,
+                                  size_t keepalive_length) {
+    if (!cache || !key || !head) {
+        uvhttp_cache_buffer_release(head);
+        return;
+    }
+
+    shared_cache_shard_t* shard = shared_cache_shard(cache, key);
+
+    uv_mutex_lock(&shard->lock);
+    cache_entry_t* entry = uvhttp_lru_cache_peek(shard->cache, key);
+    if (entry && entry->buffer == content && !entry->head) {
+        uvhttp_lru_cache_set_head(shard->cache, entry, head, keepalive_length);
+        head = NULL;
+    }
+    uv_mutex_unlock(&shard->lock);
+
+    /* another loop rendered it first, or the content changed */
+    uvhttp_cache_buffer_release(head);
+}
+
+int uvhttp_shared_cache_claim_variant(uvhttp_shared_cache_t* cache,
+                                      const char* key,
+                                      const uvhttp_cache_buffer_t* content,
+                                      uvhttp_cache_encoding_t encoding) {
+    if (!cache || !key) {
+        return 0;
+    }
+
+    shared_cache_shard_t* shard = shared_cache_shard(cache, key);
+
+    uv_mutex_lock(&shard->lock);
+    cache_entry_t* entry = uvhttp_lru_cache_peek(shard->cache, key);
+    int claimed = entry && entry->buffer == content &&
+                  uvhttp_lru_cache_claim_variant(entry, encoding);
+    uv_mutex_unlock(&shard->lock);
+    return claimed;
+}
+
+void uvhttp_shared_cache_set_variant(uvhttp_shared_cache_t* cache,
+                                     const char* key,
+                                     const uvhttp_cache_buffer_t* content,
+                                     uvhttp_cache_encoding_t encoding,
+                                     uvhttp_cache_buffer_t* buffer) {
+    if (!cache || !key) {
+        return;
+    }
+
+    shared_cache_shard_t* shard = shared_cache_shard(cache, key);
+
+    uv_mutex_lock(&shard->lock);
+    cache_entry_t* entry = uvhttp_lru_cache_peek(shard->cache, key);
+    if (entry && entry->buffer == content) {
+        uvhttp_lru_cache_set_variant(shard->cache, entry, encoding, buffer);
+    }
+    uv_mutex_unlock(&shard->lock);
+}
+
+void uvhttp_shared_cache_set_variant_head(uvhttp_shared_cache_t* cache,
+                                          const char* key,
+                                          uvhttp_cache_encoding_t encoding,
+                                          uvhttp_cache_buffer_t* head,
+                                          size_t keepalive_length) {
+    if (!cache || !key || !head || encoding < 0 ||
+        encoding >= UVHTTP_CACHE_ENCODING_COUNT) {
+        uvhttp_cache_buffer_release(head);
+        return;
+    }
+
+    shared_cache_shard_t* shard = shared_cache_shard(cache, key);
+
+    uv_mutex_lock(&shard->lock);
+    cache_entry_t* entry = uvhttp_lru_cache_peek(shard->cache, key);
+    if (entry && head->body && entry->variants[encoding].buffer == head->body &&
+        !entry->variants[encoding].head) {
+        uvhttp_lru_cache_set_variant_head(shard->cache, entry, encoding, head,
+                                          keepalive_length);
+        head = NULL;
+    }
+    uv_mutex_unlock(&shard->lock);
+
+    /* another loop rendered it first, or the content changed */
+    uvhttp_cache_buffer_release(head);
+}
+
+uvhttp_error_t uvhttp_shared_cache_remove(uvhttp_shared_cache_t* cache,
+                                          const char* key) {
+    if (!cache || !key) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    shared_cache_shard_t* shard = shared_cache_shard(cache, key);
+
+    uv_mutex_lock(&shard->lock);
+    uvhttp_error_t result = uvhttp_lru_cache_remove(shard->cache, key);
+    uv_mutex_unlock(&shard->lock);
+    return result;
+}
+
+void uvhttp_shared_cache_clear(uvhttp_shared_cache_t* cache) {
+    if (!cache) {
+        return;
+    }
+
+    for (size_t i = 0; i < cache->shard_count; i++) {
+        shared_cache_shard_t* s = &cache->shards[i];
+        uv_mutex_lock(&s->lock);
+        uvhttp_lru_cache_clear(s->cache);
+        uv_mutex_unlock(&s->lock);
+    }
+}
+
+int uvhttp_shared_cache_cleanup_expired(uvhttp_shared_cache_t* cache) {
+    if (!cache) {
+        return 0;
+    }
+
+    int cleaned = 0;
+    for (size_t i = 0; i < cache->shard_count; i++) {
+        shared_cache_shard_t* s = &cache->shards[i];
+        uv_mutex_lock(&s->lock);
+        cleaned += uvhttp_lru_cache_cleanup_expired(s->cache);
+        uv_mutex_unlock(&s->lock);
+    }
+    return cleaned;
+}
+
+void uvhttp_shared_cache_get_stats(uvhttp_shared_cache_t* cache,
+                                   size_t* total_memory_usage,
+                                   int* entry_count, int* hit_count,
+                                   int* miss_count, int* eviction_count) {
+    size_t memory = 0;
+    int entries = 0, hits = 0, misses = 0, evictions = 0;
+    for (size_t i = 0; cache && i < cache->shard_count; i++) {
+        shared_cache_shard_t* s = &cache->shards[i];
+        uv_mutex_lock(&s->lock);
+        memory += s->cache->total_memory_usage;
+        entries += s->cache->entry_count;
+        hits += s->cache->hit_count;
+        misses += s->cache->miss_count;
+        evictions += s->cache->eviction_count;
+        uv_mutex_unlock(&s->lock);
+    }
+
+    if (total_memory_usage) {
+        *total_memory_usage = memory;
+    }
+    if (entry_count) {
+        *entry_count = entries;
+    }
+    if (hit_count) {
+        *hit_count = hits;
+    }
+    if (miss_count) {
+        *miss_count = misses;
+    }
+    if (eviction_count) {
+        *eviction_count = evictions;
+    }
+}
+
+#endif /* UVHTTP_FEATURE_STATIC_FILES */
@@ -0,0 +1,1152 @@
+/*
+ * uvhttp Server-Sent Events
+ * text/event-stream responses with encode-once fan-out, per-stream queue
+ * budgets, one heartbeat timer per server and an in-memory replay ring per
+ * channel for Last-Event-ID resume
+ */
+
+#include "uvhttp_sse.h"
+
+#include "uvhttp_allocator.h"
+#include "uvhttp_constants.h"
+#include "uvhttp_defaults.h"
+#include "uvhttp_hash.h"
+#include "uvhttp_logging.h"
+#include "uvhttp_server.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/* Encoded event shared by every stream it is queued on. Refcounted from
+ * the loop thread only. */
+struct uvhttp_sse_event {
+    size_t refcount;
+    uint64_t id; /* 0 = no id: line */
+    size_t len;
+    char data[];
+};
+
+/* Outbound queue entry holding a reference to its event */
+struct uvhttp_sse_out {
+    struct uvhttp_sse_out* next;
+    uvhttp_sse_event_t* event;
+};
+
+/* One uv_write covering up to UVHTTP_SSE_WRITEV_MAX queued events. The
+ * request owns its entries so it can outlive the stream: detaching the
+ * stream only clears stream, and the completion releases the events. */
+typedef struct uvhttp_sse_write_req {
+    uv_write_t req;
+    uvhttp_sse_stream_t* stream;
+    struct uvhttp_sse_out* events;
+    size_t bytes;
+    uv_buf_t bufs[UVHTTP_SSE_WRITEV_MAX];
+} uvhttp_sse_write_req_t;
+
+/* Channel subscriber: the stream and the index of its matching ref */
+typedef struct {
+    uvhttp_sse_stream_t* stream;
+    uint32_t ref;
+} sse_member_t;
+
+/* Channel with a dense member array and a ring of its latest events.
+ * The ring survives the last subscriber leaving (that is exactly when
+ * clients reconnect); the channel is freed once it has had no subscribers
+ * and no publishes for the idle timeout. */
+typedef struct uvhttp_sse_channel {
+    uint64_t hash; /* xxhash of name */
+    char* name;
+    size_t name_len;
+    sse_member_t* members;
+    uint32_t count;
+    uint32_t capacity;
+    uvhttp_sse_event_t** ring; /* oldest at ring_head */
+    uint32_t ring_head;
+    uint32_t ring_count;
+    uint64_t last_used; /* loop time of the last publish or unsubscribe */
+} sse_channel_t;
+
+/* Per-server registry, created with the first stream or publish */
+typedef struct {
+    struct uvhttp_server* server;
+    uv_timer_t heartbeat_timer;
+    uint64_t heartbeat_interval; /* ms, 0 = off */
+    int heartbeat_running;
+    uvhttp_sse_event_t* heartbeat; /* shared comment line */
+    uvhttp_sse_stream_t** streams; /* dense, every open stream */
+    uint32_t stream_count;
+    uint32_t stream_capacity;
+    sse_channel_t** channel_table; /* open addressing by channel hash */
+    uint32_t channel_table_size;   /* power of two, 0 until first channel */
+    uint32_t channel_count;
+    uint64_t channel_idle_timeout; /* ms, 0 = keep channels */
+    uint64_t last_sweep;           /* loop time of the last idle sweep */
+    uint64_t last_event_id;
+} sse_manager_t;
+
+#define SSE_REGISTRY_INITIAL_CAPACITY 16
+#define SSE_STREAM_INITIAL_CHANNELS 4
+
+#define SSE_FIELD_ID "id: "
+#define SSE_FIELD_EVENT "event: "
+#define SSE_FIELD_DATA "data: "
+#define SSE_HEARTBEAT ":\n\n"
+
+static const char SSE_RESPONSE_HEAD[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: text/event-stream\r\n"
+    "Cache-Control: no-cache\r\n"
+    "Connection: keep-alive\r\n"
+    "X-Accel-Buffering: no\r\n";
+
+/* ========== Events ========== */
+
+static uvhttp_sse_event_t* sse_event_alloc(size_t len) {
+    if (len > SIZE_MAX - sizeof(uvhttp_sse_event_t)) {
+        return NULL;
+    }
+    uvhttp_sse_event_t* ev = uvhttp_alloc(sizeof(uvhttp_sse_event_t) + len);
+    if (!ev) {
+        return NULL;
+    }
+    ev->refcount = 1;
+    ev->id = 0;
+    ev->len = len;
+    return ev;
+}
+
+static uvhttp_sse_event_t* sse_event_raw(const char* data, size_t len) {
+    uvhttp_sse_event_t* ev = sse_event_alloc(len);
+    if (ev) {
+        memcpy(ev->data, data, len);
+    }
+    return ev;
+}
+
+/* next CR or LF at or after data, or end */
+static const char* sse_line_end(const char* data, const char* end) {
+    while (data < end && *data != '\n' && *data != '\r') {
+        data++;
+    }
+    return data;
+}
+
+static uvhttp_error_t sse_event_build(uint64_t id, const char* event,
+                                      const char* data, size_t len,
+                                      uvhttp_sse_event_t** out) {
+    if (!out || (!data && len > 0)) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    *out = NULL;
+
+    size_t event_len = event ? strlen(event) : 0;
+    if (event && sse_line_end(event, event + event_len) != event + event_len) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    /* every line of data costs "data: " and a LF in place of its break */
+    size_t lines = 1;
+    size_t breaks = 0;
+    const char* end = data + len;
+    for (const char* p = sse_line_end(data, end); p < end;
+         p = sse_line_end(p, end)) {
+        size_t brk = (p[0] == '\r' && p + 1 < end && p[1] == '\n') ? 2 : 1;
+        lines++;
+        breaks += brk;
+        p += brk;
+    }
+
+    char id_buf[24];
+    int id_len = 0;
+    if (id) {
+        id_len = snprintf(id_buf, sizeof(id_buf), "%llu",
+                          (unsigned long long)id);
+    }
+
+    if (lines > (SIZE_MAX - len) / (sizeof(SSE_FIELD_DATA) + 1)) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    size_t total = (len - breaks) + lines * sizeof(SSE_FIELD_DATA) + 1;
+    if (id) {
+        total += sizeof(SSE_FIELD_ID) - 1 + (size_t)id_len + 1;
+    }
+    if (event_len > 0) {
+        total += sizeof(SSE_FIELD_EVENT) - 1 + event_len + 1;
+    }
+
+    uvhttp_sse_event_t* ev = sse_event_alloc(total);
+    if (!ev) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    ev->id = id;
+
+    char* w = ev->data;
+    if (id) {
+        memcpy(w, SSE_FIELD_ID, sizeof(SSE_FIELD_ID) - 1);
+        w += sizeof(SSE_FIELD_ID) - 1;
+        memcpy(w, id_buf, (size_t)id_len);
+        w += id_len;
+        *w++ = '\n';
+    }
+    if (event_len > 0) {
+        memcpy(w, SSE_FIELD_EVENT, sizeof(SSE_FIELD_EVENT) - 1);
+        w += sizeof(SSE_FIELD_EVENT) - 1;
+        memcpy(w, event, event_len);
+        w += event_len;
+        *w++ = '\n';
+    }
+    const char* p = data;
+    for (;;) {
+        const char* eol = sse_line_end(p, end);
+        memcpy(w, SSE_FIELD_DATA, sizeof(SSE_FIELD_DATA) - 1);
+        w += sizeof(SSE_FIELD_DATA) - 1;
+        memcpy(w, p, (size_t)(eol - p));
+        w += eol - p;
+        *w++ = '\n';
+        if (eol == end) {
+            break;
+        }
+        p = eol + ((eol[0] == '\r' && eol + 1 < end && eol[1] == '\n') ? 2 : 1);
+    }
+    *w++ = '\n';
+
+    *out = ev;
+    return UVHTTP_OK;
+}
+
+uvhttp_error_t uvhttp_sse_event_create(const char* event, const char* data,
+                                       size_t len, uvhttp_sse_event_t** out) {
+    return sse_event_build(0, event, data, len, out);
+}
+
+void uvhttp_sse_event_release(uvhttp_sse_event_t* event) {
+    if (event && --event->refcount == 0) {
+        uvhttp_free(event);
+    }
+}
+
+size_t uvhttp_sse_event_size(const uvhttp_sse_event_t* event) {
+    return event ? event->len : 0;
+}
+
+/* ========== Send queue ========== */
+
+static void sse_free_out(struct uvhttp_sse_out* out) {
+    while (out) {
+        struct uvhttp_sse_out* next = out->next;
+        uvhttp_sse_event_release(out->event);
+        uvhttp_free(out);
+        out = next;
+    }
+}
+
+/* Drop events that have not been handed to uv_write yet */
+static void sse_discard_queue(uvhttp_sse_stream_t* stream) {
+    for (struct uvhttp_sse_out* o = stream->send_head; o; o = o->next) {
+        stream->send_queued_bytes -= o->event->len;
+    }
+    sse_free_out(stream->send_head);
+    stream->send_head = NULL;
+    stream->send_tail = NULL;
+}
+
+static void sse_idle_close(uv_idle_t* handle) {
+    uvhttp_connection_t* conn = (uvhttp_connection_t*)handle->data;
+    uv_idle_stop(handle);
+    uvhttp_connection_close(conn);
+}
+
+/* Close the stream's connection on the next loop iteration. Senders
+ * iterating streams (publish, heartbeat, replay) never see one vanish. */
+static void sse_close_later(uvhttp_sse_stream_t* stream) {
+    uvhttp_connection_t* conn = stream->conn;
+    stream->closing = 1;
+    sse_discard_queue(stream);
+    if (conn && !uv_is_closing((uv_handle_t*)&conn->idle_handle)) {
+        conn->idle_handle.data = conn;
+        uv_idle_start(&conn->idle_handle, sse_idle_close);
+    }
+}
+
+size_t uvhttp_sse_get_buffered_amount(const uvhttp_sse_stream_t* stream) {
+    if (!stream) {
+        return 0;
+    }
+    size_t buffered = stream->send_queued_bytes;
+    /* TLS events are encrypted on send; whatever the kernel did not take
+     * waits in the stream's own write queue. */
+    if (stream->conn && stream->conn->ssl) {
+        buffered += uv_stream_get_write_queue_size(
+            (const uv_stream_t*)&stream->conn->tcp_handle);
+    }
+    return buffered;
+}
+
+uvhttp_error_t uvhttp_sse_set_send_queue(
+    uvhttp_sse_stream_t* stream, size_t max_bytes,
+    uvhttp_sse_slow_consumer_policy_t policy) {
+    if (!stream || (policy != UVHTTP_SSE_SLOW_CONSUMER_CLOSE &&
+                    policy != UVHTTP_SSE_SLOW_CONSUMER_DROP)) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    stream->send_queue_max = max_bytes;
+    stream->slow_consumer_policy = policy;
+    return UVHTTP_OK;
+}
+
+void uvhttp_sse_set_close_callback(uvhttp_sse_stream_t* stream,
+                                   uvhttp_sse_on_close_callback on_close) {
+    if (stream) {
+        stream->on_close = on_close;
+    }
+}
+
+static void sse_flush(uvhttp_sse_stream_t* stream);
+
+static void sse_write_cb(uv_write_t* req, int status) {
+    uvhttp_sse_write_req_t* wreq = (uvhttp_sse_write_req_t*)req->data;
+    uvhttp_sse_stream_t* stream = wreq->stream;
+
+    sse_free_out(wreq->events);
+    if (stream) {
+        stream->send_req = NULL;
+        stream->send_queued_bytes -= wreq->bytes;
+    }
+    uvhttp_free(wreq);
+
+    if (!stream) {
+        return; /* stream detached while the write was in flight */
+    }
+    if (status < 0) {
+        if (status != UV_ECANCELED) {
+            UVHTTP_LOG_ERROR("SSE write failed: %s\n", uv_strerror(status));
+        }
+        sse_close_later(stream);
+        return;
+    }
+    sse_flush(stream);
+}
+
+/* Hand queued events to the stream, coalescing them into one writev */
+static uvhttp_error_t sse_submit(uvhttp_sse_stream_t* stream) {
+    if (stream->send_req || !stream->send_head) {
+        return UVHTTP_OK;
+    }
+
+    uv_stream_t* handle = (uv_stream_t*)&stream->conn->tcp_handle;
+    if (uv_is_closing((uv_handle_t*)handle)) {
+        sse_discard_queue(stream);
+        return UVHTTP_ERROR_CONNECTION_BROKEN;
+    }
+
+    uvhttp_sse_write_req_t* wreq = uvhttp_calloc(1, sizeof(*wreq));
+    if (!wreq) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+
+    unsigned int nbufs = 0;
+    struct uvhttp_sse_out* last = NULL;
+    struct uvhttp_sse_out* out = stream->send_head;
+    while (out && nbufs < UVHTTP_SSE_WRITEV_MAX) {
+        wreq->bufs[nbufs++] = uv_buf_init(out->event->data, out->event->len);
+        wreq->bytes += out->event->len;
+        last = out;
+        out = out->next;
+    }
+    wreq->events = stream->send_head;
+    last->next = NULL;
+    stream->send_head = out;
+    if (!out) {
+        stream->send_tail = NULL;
+    }
+
+    wreq->stream = stream;
+    wreq->req.data = wreq;
+    if (uv_write(&wreq->req, handle, wreq->bufs, nbufs, sse_write_cb) != 0) {
+        stream->send_queued_bytes -= wreq->bytes;
+        sse_free_out(wreq->events);
+        uvhttp_free(wreq);
+        sse_discard_queue(stream);
+        return UVHTTP_ERROR_CONNECTION_BROKEN;
+    }
+    stream->send_req = wreq;
+    return UVHTTP_OK;
+}
+
+static void sse_flush(uvhttp_sse_stream_t* stream) {
+    if (stream && stream->conn && !stream->closing) {
+        sse_submit(stream);
+    }
+}
+
+/* Apply the queue budget, then queue a reference to ev. Budget refusals
+ * with the CLOSE policy close the stream on the next loop iteration. */
+static uvhttp_error_t sse_dispatch(uvhttp_sse_stream_t* stream,
+                                   uvhttp_sse_event_t* ev, int count_event) {
+    if (!stream->conn || stream->closing) {
+        return UVHTTP_ERROR_CONNECTION_BROKEN;
+    }
+
+    if (stream->send_queue_max > 0) {
+        size_t buffered = uvhttp_sse_get_buffered_amount(stream);
+        if (buffered > 0 && (buffered > stream->send_queue_max ||
+                             ev->len > stream->send_queue_max - buffered)) {
+            if (stream->slow_consumer_policy == UVHTTP_SSE_SLOW_CONSUMER_DROP) {
+                stream->events_dropped++;
+            } else {
+                UVHTTP_LOG_WARN("SSE slow consumer: %zu bytes buffered, "
+                                "closing\n",
+                                buffered);
+                sse_close_later(stream);
+            }
+            return UVHTTP_ERROR_SSE_SLOW_CONSUMER;
+        }
+    }
+
+    uvhttp_connection_t* conn = stream->conn;
+    uvhttp_error_t ret;
+    if (conn->ssl) {
+        /* The connection's TLS BIO hands ciphertext the kernel cannot take
+         * yet to uv_write, so this never waits on the socket. */
+        ret = uvhttp_connection_tls_write(conn, ev->data, ev->len);
+    } else {
+        struct uvhttp_sse_out* out = uvhttp_alloc(sizeof(*out));
+        if (!out) {
+            return UVHTTP_ERROR_OUT_OF_MEMORY;
+        }
+        ev->refcount++;
+        out->next = NULL;
+        out->event = ev;
+        if (stream->send_tail) {
+            stream->send_tail->next = out;
+        } else {
+            stream->send_head = out;
+        }
+        stream->send_tail = out;
+        stream->send_queued_bytes += ev->len;
+        ret = sse_submit(stream);
+    }
+
+    if (ret == UVHTTP_OK) {
+        stream->bytes_sent += ev->len;
+        stream->events_sent += count_event ? 1 : 0;
+        stream->last_write_ms = uv_now(conn->tcp_handle.loop);
+    }
+    return ret;
+}
+
+uvhttp_error_t uvhttp_sse_send_event(uvhttp_sse_stream_t* stream,
+                                     uvhttp_sse_event_t* event) {
+    if (!stream || !event) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    return sse_dispatch(stream, event, 1);
+}
+
+uvhttp_error_t uvhttp_sse_send(uvhttp_sse_stream_t* stream, const char* event,
+                               const char* data, size_t len) {
+    if (!stream) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    uvhttp_sse_event_t* ev = NULL;
+    uvhttp_error_t ret = uvhttp_sse_event_create(event, data, len, &ev);
+    if (ret != UVHTTP_OK) {
+        return ret;
+    }
+    ret = sse_dispatch(stream, ev, 1);
+    uvhttp_sse_event_release(ev);
+    return ret;
+}
+
+/* ========== Registry ==========
+ *
+ * Streams live in a dense array for the heartbeat sweep. Channels are
+ * interned in an open-addressing table keyed by xxhash; a stream and a
+ * channel point at each other's slots, so subscribe, unsubscribe and
+ * removal are O(1) swap-deletes and a publish touches only the channel's
+ * members. */
+
+static void sse_heartbeat_cb(uv_timer_t* handle);
+
+static sse_manager_t* sse_manager_get(struct uvhttp_server* server,
+                                      int create) {
+    sse_manager_t* manager = (sse_manager_t*)server->sse_manager;
+    if (manager || !create) {
+        return manager;
+    }
+
+    manager = uvhttp_calloc(1, sizeof(sse_manager_t));
+    if (!manager) {
+        return NULL;
+    }
+    manager->heartbeat = sse_event_raw(SSE_HEARTBEAT, sizeof(SSE_HEARTBEAT) - 1);
+    if (!manager->heartbeat ||
+        uv_timer_init(server->loop, &manager->heartbeat_timer) != 0) {
+        uvhttp_sse_event_release(manager->heartbeat);
+        uvhttp_free(manager);
+        return NULL;
+    }
+    manager->heartbeat_timer.data = manager;
+    manager->heartbeat_interval = UVHTTP_SSE_DEFAULT_HEARTBEAT_INTERVAL;
+    manager->channel_idle_timeout = UVHTTP_SSE_DEFAULT_CHANNEL_IDLE_TIMEOUT;
+    manager->server = server;
+    server->sse_manager = manager;
+    return manager;
+}
+
+/* run the heartbeat timer only while there are streams to keep alive; it
+ * ticks at half the interval so no stream stays quiet much past it */
+static void sse_heartbeat_update(sse_manager_t* manager) {
+    int want = manager->stream_count > 0 && manager->heartbeat_interval > 0;
+    if (want && !manager->heartbeat_running) {
+        uint64_t tick = manager->heartbeat_interval / 2;
+        if (tick == 0) {
+            tick = 1;
+        }
+        if (uv_timer_start(&manager->heartbeat_timer, sse_heartbeat_cb, tick,
+                           tick) == 0) {
+            manager->heartbeat_running = 1;
+        }
+    } else if (!want && manager->heartbeat_running) {
+        uv_timer_stop(&manager->heartbeat_timer);
+        manager->heartbeat_running = 0;
+    }
+}
+
+static void sse_heartbeat_cb(uv_timer_t* handle) {
+    sse_manager_t* manager = (sse_manager_t*)handle->data;
+    uint64_t now = uv_now(handle->loop);
+
+    for (uint32_t i = 0; i < manager->stream_count; i++) {
+        uvhttp_sse_stream_t* stream = manager->streams[i];
+        /* a stream with bytes still buffered is not idle on the wire */
+        if (now - stream->last_write_ms >= manager->heartbeat_interval &&
+            uvhttp_sse_get_buffered_amount(stream) == 0) {
+            sse_dispatch(stream, manager->heartbeat, 0);
+        }
+    }
+}
+
+uvhttp_error_t uvhttp_sse_set_heartbeat_interval(struct uvhttp_server* server,
+                                                 uint64_t interval_ms) {
+    if (!server) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    sse_manager_t* manager = sse_manager_get(server, 1);
+    if (!manager) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    manager->heartbeat_interval = interval_ms;
+    if (manager->heartbeat_running) {
+        uv_timer_stop(&manager->heartbeat_timer);
+        manager->heartbeat_running = 0;
+    }
+    sse_heartbeat_update(manager);
+    return UVHTTP_OK;
+}
+
+uvhttp_error_t uvhttp_sse_set_channel_idle_timeout(
+    struct uvhttp_server* server, uint64_t timeout_ms) {
+    if (!server) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    sse_manager_t* manager = sse_manager_get(server, 1);
+    if (!manager) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    manager->channel_idle_timeout = timeout_ms;
+    return UVHTTP_OK;
+}
+
+static sse_channel_t* sse_channel_find(sse_manager_t* manager,
+                                       const char* name, size_t len,
+                                       uint64_t hash) {
+    if (!manager->channel_table) {
+        return NULL;
+    }
+
+    uint32_t mask = manager->channel_table_size - 1;
+    for (uint32_t i = (uint32_t)hash & mask;; i = (i + 1) & mask) {
+        sse_channel_t* channel = manager->channel_table[i];
+        if (!channel) {
+            return NULL;
+        }
+        if (channel->hash == hash && channel->name_len == len &&
+            memcmp(channel->name, name, len) == 0) {
+            return channel;
+        }
+    }
+}
+
+static sse_channel_t* sse_channel_lookup(sse_manager_t* manager,
+                                         const char* name) {
+    size_t len = strlen(name);
+    return sse_channel_find(manager, name, len, uvhttp_hash_default(name, len));
+}
+
+static void sse_channel_table_place(sse_channel_t** table, uint32_t size,
+                                    sse_channel_t* channel) {
+    uint32_t mask = size - 1;
+    uint32_t i = (uint32_t)channel->hash & mask;
+    while (table[i]) {
+        i = (i + 1) & mask;
+    }
+    table[i] = channel;
+}
+
+static int sse_channel_table_grow(sse_manager_t* manager) {
+    uint32_t size = manager->channel_table_size
+                        ? manager->channel_table_size * 2
+                        : SSE_REGISTRY_INITIAL_CAPACITY;
+    sse_channel_t** table = uvhttp_calloc(size, sizeof(sse_channel_t*));
+    if (!table) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < manager->channel_table_size; i++) {
+        if (manager->channel_table[i]) {
+            sse_channel_table_place(table, size, manager->channel_table[i]);
+        }
+    }
+
+    uvhttp_free(manager->channel_table);
+    manager->channel_table = table;
+    manager->channel_table_size = size;
+    return 0;
+}
+
+static void sse_channel_free(sse_channel_t* channel) {
+    for (uint32_t i = 0; i < channel->ring_count; i++) {
+        uvhttp_sse_event_release(
+            channel->ring[(channel->ring_head + i) %
+                          UVHTTP_SSE_DEFAULT_REPLAY_SIZE]);
+    }
+    uvhttp_free(channel->ring);
+    uvhttp_free(channel->members);
+    uvhttp_free(channel->name);
+    uvhttp_free(channel);
+}
+
+/* free the channels that have been idle for the timeout; the survivors
+ * are placed in a fresh table so no probe chain is left broken */
+static void sse_channel_sweep(sse_manager_t* manager, uint64_t now) {
+    manager->last_sweep = now;
+    sse_channel_t** table =
+        uvhttp_calloc(manager->channel_table_size, sizeof(sse_channel_t*));
+    if (!table) {
+        return; /* try again at the next sweep */
+    }
+
+    for (uint32_t i = 0; i < manager->channel_table_size; i++) {
+        sse_channel_t* channel = manager->channel_table[i];
+        if (!channel) {
+            continue;
+        }
+        if (channel->count == 0 &&
+            now - channel->last_used >= manager->channel_idle_timeout) {
+            sse_channel_free(channel);
+            manager->channel_count--;
+        } else {
+            sse_channel_table_place(table, manager->channel_table_size,
+                                    channel);
+        }
+    }
+
+    uvhttp_free(manager->channel_table);
+    manager->channel_table = table;
+}
+
+/* return the channel for name, creating it on first use */
+static sse_channel_t* sse_channel_intern(sse_manager_t* manager,
+                                         const char* name) {
+    size_t len = strlen(name);
+    uint64_t hash = uvhttp_hash_default(name, len);
+
+    sse_channel_t* channel = sse_channel_find(manager, name, len, hash);
+    if (channel) {
+        return channel;
+    }
+
+    /* only new channels take memory: sweep idle ones at most once per
+     * timeout, and before growing the table */
+    uint64_t now = uv_now(manager->server->loop);
+    if (manager->channel_table && manager->channel_idle_timeout > 0 &&
+        (now - manager->last_sweep >= manager->channel_idle_timeout ||
+         (manager->channel_count + 1) * 2 > manager->channel_table_size)) {
+        sse_channel_sweep(manager, now);
+    }
+
+    /* keep the load factor at or below 1/2 so probes stay short */
+    if ((manager->channel_count + 1) * 2 > manager->channel_table_size &&
+        sse_channel_table_grow(manager) != 0) {
+        return NULL;
+    }
+
+    channel = uvhttp_calloc(1, sizeof(sse_channel_t));
+    if (!channel) {
+        return NULL;
+    }
+    channel->name = uvhttp_alloc(len + 1);
+    if (!channel->name) {
+        uvhttp_free(channel);
+        return NULL;
+    }
+    memcpy(channel->name, name, len + 1);
+    channel->name_len = len;
+    channel->hash = hash;
+    channel->last_used = now;
+
+    sse_channel_table_place(manager->channel_table,
+                            manager->channel_table_size, channel);
+    manager->channel_count++;
+    return channel;
+}
+
+/* keep a reference to ev in the channel's replay ring */
+static void sse_channel_remember(sse_channel_t* channel,
+                                 uvhttp_sse_event_t* ev) {
+    if (UVHTTP_SSE_DEFAULT_REPLAY_SIZE == 0) {
+        return;
+    }
+    if (!channel->ring) {
+        channel->ring = uvhttp_calloc(UVHTTP_SSE_DEFAULT_REPLAY_SIZE,
+                                      sizeof(uvhttp_sse_event_t*));
+        if (!channel->ring) {
+            return; /* replay is best effort */
+        }
+    }
+
+    ev->refcount++;
+    if (channel->ring_count == UVHTTP_SSE_DEFAULT_REPLAY_SIZE) {
+        uvhttp_sse_event_release(channel->ring[channel->ring_head]);
+        channel->ring[channel->ring_head] = ev;
+        channel->ring_head =
+            (channel->ring_head + 1) % UVHTTP_SSE_DEFAULT_REPLAY_SIZE;
+    } else {
+        channel->ring[(channel->ring_head + channel->ring_count) %
+                      UVHTTP_SSE_DEFAULT_REPLAY_SIZE] = ev;
+        channel->ring_count++;
+    }
+}
+
+/* queue the channel's buffered events the stream has not seen */
+static void sse_channel_replay(sse_channel_t* channel,
+                               uvhttp_sse_stream_t* stream) {
+    for (uint32_t i = 0; i < channel->ring_count; i++) {
+        uvhttp_sse_event_t* ev =
+            channel->ring[(channel->ring_head + i) %
+                          UVHTTP_SSE_DEFAULT_REPLAY_SIZE];
+        if (ev->id > stream->last_event_id &&
+            sse_dispatch(stream, ev, 1) == UVHTTP_ERROR_CONNECTION_BROKEN) {
+            return;
+        }
+    }
+}
+
+static uvhttp_error_t sse_register(sse_manager_t* manager,
+                                   uvhttp_sse_stream_t* stream) {
+    if (manager->stream_count == manager->stream_capacity) {
+        uint32_t capacity = manager->stream_capacity
+                                ? manager->stream_capacity * 2
+                                : SSE_REGISTRY_INITIAL_CAPACITY;
+        uvhttp_sse_stream_t** streams = uvhttp_realloc(
+            manager->streams, capacity * sizeof(uvhttp_sse_stream_t*));
+        if (!streams) {
+            return UVHTTP_ERROR_OUT_OF_MEMORY;
+        }
+        manager->streams = streams;
+        manager->stream_capacity = capacity;
+    }
+    stream->index = manager->stream_count;
+    manager->streams[manager->stream_count++] = stream;
+    sse_heartbeat_update(manager);
+    return UVHTTP_OK;
+}
+
+/* remove stream->channels[r], swap-deleting on both sides */
+static void sse_unsubscribe_at(uvhttp_sse_stream_t* stream, uint32_t r) {
+    sse_channel_t* channel = stream->channels[r].channel;
+    uint32_t slot = stream->channels[r].slot;
+
+    uint32_t last = channel->count - 1;
+    if (slot != last) {
+        sse_member_t moved = channel->members[last];
+        channel->members[slot] = moved;
+        moved.stream->channels[moved.ref].slot = slot;
+    }
+    if (--channel->count == 0 && stream->server) {
+        channel->last_used = uv_now(stream->server->loop);
+    }
+
+    last = stream->channel_count - 1;
+    if (r != last) {
+        uvhttp_sse_channel_ref_t moved = stream->channels[last];
+        stream->channels[r] = moved;
+        moved.channel->members[moved.slot].ref = r;
+    }
+    stream->channel_count--;
+}
+
+/* unlink a stream from every channel and the stream array */
+static void sse_unregister(uvhttp_sse_stream_t* stream) {
+    sse_manager_t* manager =
+        stream->server ? (sse_manager_t*)stream->server->sse_manager : NULL;
+
+    while (stream->channel_count > 0) {
+        sse_unsubscribe_at(stream, stream->channel_count - 1);
+    }
+
+    if (!manager || stream->index >= manager->stream_count ||
+        manager->streams[stream->index] != stream) {
+        return;
+    }
+    uint32_t last = manager->stream_count - 1;
+    if (stream->index != last) {
+        uvhttp_sse_stream_t* moved = manager->streams[last];
+        manager->streams[stream->index] = moved;
+        moved->index = stream->index;
+    }
+    manager->stream_count--;
+    sse_heartbeat_update(manager);
+}
+
+uvhttp_error_t uvhttp_sse_subscribe(uvhttp_sse_stream_t* stream,
+                                    const char* name) {
+    if (!stream || !name) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    if (!stream->conn || stream->closing) {
+        return UVHTTP_ERROR_CONNECTION_BROKEN;
+    }
+    sse_manager_t* manager = sse_manager_get(stream->server, 1);
+    if (!manager) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    sse_channel_t* channel = sse_channel_intern(manager, name);
+    if (!channel) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+
+    for (uint32_t i = 0; i < stream->channel_count; i++) {
+        if (stream->channels[i].channel == channel) {
+            return UVHTTP_ERROR_ALREADY_EXISTS;
+        }
+    }
+
+    if (stream->channel_count == stream->channel_capacity) {
+        uint32_t capacity = stream->channel_capacity
+                                ? stream->channel_capacity * 2
+                                : SSE_STREAM_INITIAL_CHANNELS;
+        uvhttp_sse_channel_ref_t* refs = uvhttp_realloc(
+            stream->channels, capacity * sizeof(uvhttp_sse_channel_ref_t));
+        if (!refs) {
+            return UVHTTP_ERROR_OUT_OF_MEMORY;
+        }
+        stream->channels = refs;
+        stream->channel_capacity = capacity;
+    }
+
+    if (channel->count == channel->capacity) {
+        uint32_t capacity = channel->capacity ? channel->capacity * 2
+                                              : SSE_REGISTRY_INITIAL_CAPACITY;
+        sse_member_t* members =
+            uvhttp_realloc(channel->members, capacity * sizeof(sse_member_t));
+        if (!members) {
+            return UVHTTP_ERROR_OUT_OF_MEMORY;
+        }
+        channel->members = members;
+        channel->capacity = capacity;
+    }
+
+    stream->channels[stream->channel_count].channel = channel;
+    stream->channels[stream->channel_count].slot = channel->count;
+    channel->members[channel->count].stream = stream;
+    channel->members[channel->count].ref = stream->channel_count;
+    channel->count++;
+    stream->channel_count++;
+
+    if (stream->last_event_id > 0) {
+        sse_channel_replay(channel, stream);
+    }
+    return UVHTTP_OK;
+}
+
+uvhttp_error_t uvhttp_sse_unsubscribe(uvhttp_sse_stream_t* stream,
+                                      const char* name) {
+    if (!stream || !name) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    sse_manager_t* manager = sse_manager_get(stream->server, 0);
+    sse_channel_t* channel =
+        manager ? sse_channel_lookup(manager, name) : NULL;
+    for (uint32_t i = 0; channel && i < stream->channel_count; i++) {
+        if (stream->channels[i].channel == channel) {
+            sse_unsubscribe_at(stream, i);
+            return UVHTTP_OK;
+        }
+    }
+    return UVHTTP_ERROR_NOT_FOUND;
+}
+
+uvhttp_error_t uvhttp_sse_publish(struct uvhttp_server* server,
+                                  const char* name, const char* event,
+                                  const char* data, size_t len, uint64_t* id) {
+    if (!server || !name) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    sse_manager_t* manager = sse_manager_get(server, 1);
+    if (!manager) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    sse_channel_t* channel = sse_channel_intern(manager, name);
+    if (!channel) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+
+    /* encode once; every subscriber and the replay ring share it */
+    uvhttp_sse_event_t* ev = NULL;
+    uvhttp_error_t ret =
+        sse_event_build(manager->last_event_id + 1, event, data, len, &ev);
+    if (ret != UVHTTP_OK) {
+        return ret;
+    }
+    manager->last_event_id++;
+    channel->last_used = uv_now(server->loop);
+    sse_channel_remember(channel, ev);
+
+    for (uint32_t i = 0; i < channel->count; i++) {
+        sse_dispatch(channel->members[i].stream, ev, 1);
+    }
+
+    if (id) {
+        *id = ev->id;
+    }
+    uvhttp_sse_event_release(ev);
+    return UVHTTP_OK;
+}
+
+int uvhttp_sse_get_channel_count(struct uvhttp_server* server,
+                                 const char* name) {
+    if (!server || !name) {
+        return 0;
+    }
+    sse_manager_t* manager = sse_manager_get(server, 0);
+    sse_channel_t* channel =
+        manager ? sse_channel_lookup(manager, name) : NULL;
+    return channel ? (int)channel->count : 0;
+}
+
+int uvhttp_sse_get_channel_total(struct uvhttp_server* server) {
+    sse_manager_t* manager = server ? sse_manager_get(server, 0) : NULL;
+    return manager ? (int)manager->channel_count : 0;
+}
+
+int uvhttp_sse_get_stream_count(struct uvhttp_server* server) {
+    sse_manager_t* manager = server ? sse_manager_get(server, 0) : NULL;
+    return manager ? (int)manager->stream_count : 0;
+}
+
+/* ========== Stream lifecycle ========== */
+
+/* Last-Event-ID as issued by uvhttp_sse_publish; anything else is 0 */
+static uint64_t sse_parse_event_id(const char* value) {
+    uint64_t id = 0;
+    if (!value || !*value) {
+        return 0;
+    }
+    for (const char* p = value; *p; p++) {
+        if (*p < '0' || *p > '9' || id > (UINT64_MAX - 9) / 10) {
+            return 0;
+        }
+        id = id * 10 + (uint64_t)(*p - '0');
+    }
+    return id;
+}
+
+/* headers the stream sets itself */
+static int sse_reserved_header(const char* name) {
+    return strcasecmp(name, UVHTTP_HEADER_CONTENT_TYPE) == 0 ||
+           strcasecmp(name, UVHTTP_HEADER_CONTENT_LENGTH) == 0 ||
+           strcasecmp(name, UVHTTP_HEADER_CACHE_CONTROL) == 0 ||
+           strcasecmp(name, UVHTTP_HEADER_CONNECTION) == 0 ||
+           strcasecmp(name, "Transfer-Encoding") == 0 ||
+           strcasecmp(name, "X-Accel-Buffering") == 0;
+}
+
+/* the fixed SSE head plus the headers the handler already set */
+static uvhttp_sse_event_t* sse_build_head(uvhttp_response_t* response) {
+    size_t count = uvhttp_response_get_header_count(response);
+    size_t len = sizeof(SSE_RESPONSE_HEAD) - 1 + 2;
+    for (size_t i = 0; i < count; i++) {
+        uvhttp_header_t* h = uvhttp_response_get_header_at(response, i);
+        if (h && !sse_reserved_header(h->name)) {
+            len += strlen(h->name) + 2 + strlen(h->value) + 2;
+        }
+    }
+
+    uvhttp_sse_event_t* head = sse_event_alloc(len);
+    if (!head) {
+        return NULL;
+    }
+    char* w = head->data;
+    memcpy(w, SSE_RESPONSE_HEAD, sizeof(SSE_RESPONSE_HEAD) - 1);
+    w += sizeof(SSE_RESPONSE_HEAD) - 1;
+    for (size_t i = 0; i < count; i++) {
+        uvhttp_header_t* h = uvhttp_response_get_header_at(response, i);
+        if (h && !sse_reserved_header(h->name)) {
+            size_t n = strlen(h->name);
+            size_t v = strlen(h->value);
+            memcpy(w, h->name, n);
+            w += n;
+            *w++ = ':';
+            *w++ = ' ';
+            memcpy(w, h->value, v);
+            w += v;
+            *w++ = '\r';
+            *w++ = '\n';
+        }
+    }
+    *w++ = '\r';
+    *w++ = '\n';
+    return head;
+}
+
+uvhttp_error_t uvhttp_sse_open(uvhttp_request_t* request,
+                               uvhttp_response_t* response,
+                               uvhttp_sse_stream_t** stream) {
+    if (!stream) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    *stream = NULL;
+    if (!request || !response || !response->client || response->sent) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    uvhttp_connection_t* conn = (uvhttp_connection_t*)response->client->data;
+    if (!conn || !conn->server || conn->sse_stream) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    sse_manager_t* manager = sse_manager_get(conn->server, 1);
+    if (!manager) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    uvhttp_sse_stream_t* s = uvhttp_calloc(1, sizeof(uvhttp_sse_stream_t));
+    if (!s) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    s->conn = conn;
+    s->server = conn->server;
+    s->send_queue_max = UVHTTP_SSE_DEFAULT_SEND_QUEUE_MAX;
+    s->slow_consumer_policy = UVHTTP_SSE_SLOW_CONSUMER_DROP;
+    s->last_event_id =
+        sse_parse_event_id(uvhttp_request_get_header(request, "Last-Event-ID"));
+
+    uvhttp_sse_event_t* head = sse_build_head(response);
+    if (!head) {
+        uvhttp_free(s);
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+
+    uvhttp_error_t ret = uvhttp_connection_switch_to_sse(conn);
+    if (ret == UVHTTP_OK) {
+        ret = sse_register(manager, s);
+    }
+    if (ret == UVHTTP_OK) {
+        /* from here on the connection's close tears the stream down */
+        conn->sse_stream = s;
+        ret = sse_dispatch(s, head, 0);
+    }
+    uvhttp_sse_event_release(head);
+    if (ret != UVHTTP_OK) {
+        if (conn->sse_stream == s) {
+            uvhttp_connection_close(conn); /* detaches and frees s */
+        } else {
+            uvhttp_free(s);
+            uvhttp_connection_close(conn);
+        }
+        return ret;
+    }
+
+    /* the stream owns the wire now; later sends on response are no-ops */
+    response->headers_sent = 1;
+    response->sent = 1;
+    response->finished = 1;
+
+    *stream = s;
+    return UVHTTP_OK;
+}
+
+void uvhttp_sse_close(uvhttp_sse_stream_t* stream) {
+    if (stream && stream->conn) {
+        uvhttp_connection_close(stream->conn);
+    }
+}
+
+void uvhttp_sse_detach(uvhttp_connection_t* conn) {
+    uvhttp_sse_stream_t* stream =
+        conn ? (uvhttp_sse_stream_t*)conn->sse_stream : NULL;
+    if (!stream) {
+        return;
+    }
+    conn->sse_stream = NULL;
+    stream->conn = NULL;
+
+    /* the in-flight write completes with ECANCELED and frees its events */
+    if (stream->send_req) {
+        stream->send_req->stream = NULL;
+        stream->send_req = NULL;
+    }
+    sse_discard_queue(stream);
+    sse_unregister(stream);
+
+    if (stream->on_close) {
+        stream->on_close(stream);
+    }
+    uvhttp_free(stream->channels);
+    uvhttp_free(stream);
+}
+
+static void sse_manager_free_cb(uv_handle_t* handle) {
+    uvhttp_free(handle->data);
+}
+
+void uvhttp_sse_server_cleanup(struct uvhttp_server* server) {
+    sse_manager_t* manager = server ? sse_manager_get(server, 0) : NULL;
+    if (!manager) {
+        return;
+    }
+
+    while (manager->stream_count > 0) {
+        uint32_t before = manager->stream_count;
+        uvhttp_sse_stream_t* stream = manager->streams[before - 1];
+        uvhttp_connection_t* conn = stream->conn;
+        if (conn) {
+            uvhttp_connection_close(conn);
+        }
+        if (manager->stream_count == before) {
+            /* the connection was already closing: detach directly */
+            if (conn && conn->sse_stream == stream) {
+                uvhttp_sse_detach(conn);
+            } else {
+                sse_unregister(stream);
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < manager->channel_table_size; i++) {
+        if (manager->channel_table[i]) {
+            sse_channel_free(manager->channel_table[i]);
+        }
+    }
+    uvhttp_free(manager->channel_table);
+    uvhttp_free(manager->streams);
+    uvhttp_sse_event_release(manager->heartbeat);
+    server->sse_manager = NULL;
+
+    /* the timer is embedded in the manager: free it from the close
+     * callback */
+    uv_timer_stop(&manager->heartbeat_timer);
+    uv_close((uv_handle_t*)&manager->heartbeat_timer, sse_manager_free_cb);
+}
@@ -9,6 +9,7 @@
 #    include "uvhttp_static.h"
 
 #    include "uvhttp_allocator.h"
+#    include "uvhttp_connection.h"
 #    include "uvhttp_constants.h"
 #    include "uvhttp_error_handler.h"
 #    include "uvhttp_error_helpers.h"
@@ -212,9 +213,11 @@ static const char* get_file_extension(const char* file_path) {
 }
 
 /* forward declaration */
-static uvhttp_result_t uvhttp_static_sendfile_with_config(
-    const char* file_path, void* response,
-    const uvhttp_static_config_t* config);
+static uvhttp_result_t static_op_serve(uvhttp_static_context_t* ctx,
+                                       uvhttp_request_t* request,
+                                       uvhttp_response_t* response,
+                                       const char* url_path, int accepts_gzip,
+                                       uvhttp_request_handler_t fallback);
 
 /**
  * HTML escape function - prevent XSS attack
@@ -386,136 +389,6 @@ static char* read_file_content(const char* file_path, size_t* file_size) {
     return content;
 }
 
-/**
- * chunked file transfer context
- * - used for streaming large files in chunks
- * - avoids loading entire file into memory
- */
-typedef struct {
-    FILE* file;
-    size_t file_size;
-    size_t bytes_sent;
-    size_t chunk_size;
-    char* chunk_buffer;
-    uvhttp_response_t* response;
-    char etag[UVHTTP_MAX_HEADER_VALUE_SIZE];
-    time_t last_modified;
-    char safe_path[UVHTTP_MAX_PATH_SIZE];
-} chunked_transfer_context_t;
-
-/**
- * send file in chunks (for large files when sendfile is not available)
- * - avoids loading entire file into memory
- * - uses fixed-size chunks to balance memory and performance
- */
-static int send_file_chunked(const char* file_path, size_t file_size,
-                             time_t last_modified, uvhttp_response_t* response,
-                             const char* etag, const char* safe_path) {
-    if (!file_path || !response)
-        return UVHTTP_ERROR_INVALID_PARAM;
-
-    /* open file */
-    FILE* file = fopen(file_path, "rb");
-    if (!file) {
-        return UVHTTP_ERROR_NOT_FOUND;
-    }
-
-    /* allocate chunk buffer */
-    char* chunk_buffer = uvhttp_alloc(UVHTTP_FILE_CHUNK_SIZE);
-    if (!chunk_buffer) {
-        fclose(file);
-        return UVHTTP_ERROR_OUT_OF_MEMORY;
-    }
-
-    /* set response headers (only once) */
-    uvhttp_static_set_response_headers(response, safe_path, file_size,
-                                       last_modified, etag);
-    uvhttp_response_set_status(response, 200);
-
-    /* send headers first */
-    char* response_data = NULL;
-    size_t response_length = 0;
-    uvhttp_error_t err =
-        uvhttp_response_build_data(response, &response_data, &response_length);
-
-    if (err != UVHTTP_OK) {
-        uvhttp_free(chunk_buffer);
-        fclose(file);
-        return err;
-    }
-
-    /* send headers with NULL response to avoid connection restart */
-    err = uvhttp_response_send_raw(response_data, response_length,
-                                   response->client, NULL);
-    uvhttp_free(response_data);
-
-    if (err != UVHTTP_OK) {
-        uvhttp_free(chunk_buffer);
-        fclose(file);
-        return err;
-    }
-
-    /* send file in chunks */
-    size_t bytes_sent = 0;
-    while (bytes_sent < file_size) {
-        size_t bytes_to_read = UVHTTP_FILE_CHUNK_SIZE;
-        size_t remaining = file_size - bytes_sent;
-
-        if (bytes_to_read > remaining) {
-            bytes_to_read = remaining;
-        }
-
-        size_t bytes_read = fread(chunk_buffer, 1, bytes_to_read, file);
-        if (bytes_read != bytes_to_read) {
-            uvhttp_free(chunk_buffer);
-            fclose(file);
-            return UVHTTP_ERROR_IO_ERROR;
-        }
-
-        /* send chunk with NULL response to avoid connection restart */
-        err = uvhttp_response_send_raw(chunk_buffer, bytes_read,
-                                       response->client, NULL);
-        if (err != UVHTTP_OK) {
-            uvhttp_free(chunk_buffer);
-            fclose(file);
-            return err;
-        }
-
-        bytes_sent += bytes_read;
-    }
-
-    /* cleanup */
-    uvhttp_free(chunk_buffer);
-    fclose(file);
-
-    return UVHTTP_OK;
-}
-
-/**
- * getfileinfo
- */
-static int get_file_info(const char* file_path, size_t* file_size,
-                         time_t* last_modified) {
-    if (!file_path)
-        return -1;
-
-    struct stat st;
-    if (stat(file_path, &st) != 0) {
-        return -1;
-    }
-
-    if (!S_ISREG(st.st_mode)) {
-        return -1; /* not a regular file */
-    }
-
-    if (file_size)
-        *file_size = st.st_size;
-    if (last_modified)
-        *last_modified = st.st_mtime;
-
-    return 0;
-}
-
 /**
  * calculate buffer size needed for directory list
  */
@@ -722,8 +595,11 @@ static char* generate_directory_listing(const char* dir_path,
         /* format modification time */
         char time_str[64];
         if (dir_entry->mtime > 0) {
-            struct tm* tm_info = localtime(&dir_entry->mtime);
-            strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
+            /* runs on the thread pool: localtime_r, not localtime */
+            struct tm tm_info;
+            localtime_r(&dir_entry->mtime, &tm_info);
+            strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S",
+                     &tm_info);
         } else {
             time_str[0] = '-';
             time_str[1] = '\0';
@@ -784,6 +660,41 @@ uvhttp_result_t uvhttp_static_generate_etag(const char* file_path,
     return UVHTTP_OK;
 }
 
+/* Last-Modified, ETag, Cache-Control and Accept-Ranges: the headers of a
+ * file answer that do not depend on how much of it is sent */
+static void static_set_validator_headers(void* response, time_t last_modified,
+                                         const char* etag) {
+    /* setLast-Modified */
+    if (last_modified > 0) {
+        char time_str[64];
+        strftime(time_str, sizeof(time_str), "%a, %d %b %Y %H:%M:%S GMT",
+                 gmtime(&last_modified));
+        uvhttp_response_set_header(response, "Last-Modified", time_str);
+    }
+
+    /* setETag */
+    if (etag && *etag) {
+        uvhttp_response_set_header(response, "ETag", etag);
+    }
+
+    /* setCache-Control */
+    uvhttp_response_set_header(
+        response, "Cache-Control",
+        "public, max-age=" UVHTTP_STRINGIFY(UVHTTP_CACHE_DEFAULT_TTL));
+
+    uvhttp_response_set_header(response, "Accept-Ranges", "bytes");
+}
+
+/* Content codings of cache variants, by uvhttp_cache_encoding_t: the
+ * Content-Encoding token, and the suffix of a pre-compressed file (and of
+ * the key a variant's headers are rendered for) */
+static const struct {
+    const char* coding;
+    const char* suffix;
+} static_encodings[UVHTTP_CACHE_ENCODING_COUNT] = {
+    {"gzip", ".gz"},
+};
+
 /**
  * set static file related response headers
  */
@@ -795,20 +706,21 @@ uvhttp_result_t uvhttp_static_set_response_headers(void* response,
     if (!response || !file_path)
         return UVHTTP_ERROR_INVALID_PARAM;
 
-    /* setContent-Type — strip .gz suffix for pre-compressed files */
+    /* setContent-Type — strip the suffix of pre-compressed files (.gz) */
     char mime_path[UVHTTP_MAX_FILE_PATH_SIZE];
     const char* mime_source = file_path;
-    int is_precompressed = 0;
+    const char* coding = NULL;
     size_t path_len = strlen(file_path);
-    if (path_len > 3 && strcmp(file_path + path_len - 3, ".gz") == 0) {
-        /* for .gz files, use the original file's MIME type and add
-         * Content-Encoding: gzip. The .gz suffix is stripped for MIME lookup. */
-        size_t base_len = path_len - 3;
-        if (base_len < sizeof(mime_path)) {
+    for (int i = 0; i < UVHTTP_CACHE_ENCODING_COUNT && !coding; i++) {
+        /* use the original file's MIME type and add Content-Encoding */
+        size_t suffix_len = strlen(static_encodings[i].suffix);
+        size_t base_len = path_len - suffix_len;
+        if (path_len > suffix_len && base_len < sizeof(mime_path) &&
+            strcmp(file_path + base_len, static_encodings[i].suffix) == 0) {
             memcpy(mime_path, file_path, base_len);
             mime_path[base_len] = '\0';
             mime_source = mime_path;
-            is_precompressed = 1;
+            coding = static_encodings[i].coding;
         }
     }
 
@@ -818,9 +730,17 @@ uvhttp_result_t uvhttp_static_set_response_headers(void* response,
         uvhttp_response_set_header(response, "Content-Type", mime_type);
     }
 
-    /* set Content-Encoding for pre-compressed files */
-    if (is_precompressed) {
-        uvhttp_response_set_header(response, "Content-Encoding", "gzip");
+    /* set Content-Encoding for pre-compressed files; shared caches keep
+     * the answers of files that may be sent compressed apart */
+    if (coding) {
+        uvhttp_response_set_header(response, "Content-Encoding", coding);
+    }
+#    if UVHTTP_FEATURE_COMPRESSION
+    if (coding || uvhttp_should_compress_by_extension(mime_source)) {
+#    else
+    if (coding) {
+#    endif
+        uvhttp_response_set_header(response, "Vary", "Accept-Encoding");
     }
 
     /* setContent-Length */
@@ -828,23 +748,7 @@ uvhttp_result_t uvhttp_static_set_response_headers(void* response,
     snprintf(content_length, sizeof(content_length), "%zu", file_size);
     uvhttp_response_set_header(response, "Content-Length", content_length);
 
-    /* setLast-Modified */
-    if (last_modified > 0) {
-        char time_str[64];
-        strftime(time_str, sizeof(time_str), "%a, %d %b %Y %H:%M:%S GMT",
-                 gmtime(&last_modified));
-        uvhttp_response_set_header(response, "Last-Modified", time_str);
-    }
-
-    /* setETag */
-    if (etag && *etag) {
-        uvhttp_response_set_header(response, "ETag", etag);
-    }
-
-    /* setCache-Control */
-    uvhttp_response_set_header(
-        response, "Cache-Control",
-        "public, max-age=" UVHTTP_STRINGIFY(UVHTTP_CACHE_DEFAULT_TTL));
+    static_set_validator_headers(response, last_modified, etag);
 
     return UVHTTP_OK;
 }
@@ -880,6 +784,126 @@ int uvhttp_static_check_conditional_request(void* request, const char* etag,
     return 0; /* need to return complete content */
 }
 
+/* the decimal number at *p, saturating at SIZE_MAX; 0 if there is none */
+static int static_parse_size(const char** p, size_t* value) {
+    const char* s = *p;
+    size_t v = 0;
+    if (*s < '0' || *s > '9') {
+        return 0;
+    }
+    while (*s >= '0' && *s <= '9') {
+        size_t digit = (size_t)(*s - '0');
+        v = v > (SIZE_MAX - digit) / 10 ? SIZE_MAX : v * 10 + digit;
+        s++;
+    }
+    *p = s;
+    *value = v;
+    return 1;
+}
+
+int uvhttp_static_parse_range(const char* header, size_t file_size,
+                              uvhttp_static_range_t* ranges, int max_ranges) {
+    if (!header || !ranges || max_ranges <= 0) {
+        return 0;
+    }
+    while (*header == ' ' || *header == '\t') {
+        header++;
+    }
+    if (strncasecmp(header, "bytes=", 6) != 0) {
+        return 0; /* a unit we do not know: send the whole file */
+    }
+
+    const char* p = header + 6;
+    int count = 0;
+    int specs = 0;
+    size_t total = 0;
+    for (;;) {
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        size_t first = 0;
+        size_t last = 0;
+        int has_first = static_parse_size(&p, &first);
+        if (*p != '-') {
+            return 0;
+        }
+        p++;
+        int has_last = static_parse_size(&p, &last);
+        if ((!has_first && !has_last) || (has_first && has_last && last < first)) {
+            return 0;
+        }
+        if (++specs > max_ranges) {
+            return 0;
+        }
+
+        size_t start = 0;
+        size_t length = 0;
+        if (!has_first) {
+            /* "-N": the last N bytes */
+            length = last < file_size ? last : file_size;
+            start = file_size - length;
+        } else if (first < file_size) {
+            size_t end = has_last && last < file_size ? last : file_size - 1;
+            start = first;
+            length = end - first + 1;
+        }
+        if (length > 0) {
+            /* overlapping ranges would make us send the file several times
+             * over */
+            if (length > file_size - total) {
+                return 0;
+            }
+            total += length;
+            ranges[count].start = start;
+            ranges[count].length = length;
+            count++;
+        }
+
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        if (*p == '\0') {
+            break;
+        }
+        if (*p != ',') {
+            return 0;
+        }
+        p++;
+    }
+    if (count > 1 && total > UVHTTP_STATIC_MAX_MULTIPART_SIZE) {
+        return 0;
+    }
+    return count > 0 ? count : -1;
+}
+
+/* A file behind key (root + URL path) changed: so did its cached content */
+static void static_on_file_changed(void* data, const char* key) {
+    uvhttp_static_context_t* ctx = (uvhttp_static_context_t*)data;
+    size_t root_len = strlen(ctx->config.root_directory);
+    if (strncmp(key, ctx->config.root_directory, root_len) != 0) {
+        return;
+    }
+    char url_path[UVHTTP_MAX_PATH_SIZE + 3];
+    char gz_path[UVHTTP_MAX_PATH_SIZE + 3];
+    if (snprintf(url_path, sizeof(url_path), "%s", key + root_len) >=
+        (int)sizeof(url_path) - 3) {
+        return;
+    }
+    snprintf(gz_path, sizeof(gz_path), "%s.gz", url_path);
+    /* a mapping still being written is unmapped once the write is done */
+    cache_manager_t* tiers[2] = {ctx->cache, ctx->mapped};
+    for (int i = 0; i < 2; i++) {
+        if (tiers[i]) {
+            uvhttp_lru_cache_remove(tiers[i], url_path);
+            uvhttp_lru_cache_remove(tiers[i], gz_path);
+        }
+    }
+    if (ctx->shared) {
+        uvhttp_shared_cache_remove(ctx->shared, url_path);
+        uvhttp_shared_cache_remove(ctx->shared, gz_path);
+    }
+}
+
 /**
  * create static file service context
  */
@@ -941,6 +965,61 @@ uvhttp_error_t uvhttp_static_create(const uvhttp_static_config_t* config,
         return UVHTTP_ERROR_IO_ERROR;
     }
 
+    /* mapped files: counted apart from the heap cache, each up to half of
+     * the tier */
+    if (config->mmap_cache_size > 0) {
+        result = uvhttp_lru_cache_create(config->mmap_cache_size,
+                                         UVHTTP_CACHE_DEFAULT_MAX_ENTRIES,
+                                         config->cache_ttl, &ctx->mapped);
+        if (result != UVHTTP_OK) {
+            UVHTTP_LOG_ERROR("Failed to create mapped file cache: %s",
+                             uvhttp_error_string(result));
+            uvhttp_lru_cache_free(ctx->cache);
+            uvhttp_free(ctx);
+            return result;
+        }
+        size_t max_mapped = config->mmap_cache_size / 2;
+        uvhttp_lru_cache_set_max_file_size(
+            ctx->mapped, max_mapped < UVHTTP_FILE_SIZE_MEDIUM
+                             ? max_mapped
+                             : UVHTTP_FILE_SIZE_MEDIUM);
+    }
+
+    /* which files the tiers keep when full */
+    uvhttp_cache_policy_t policy = (uvhttp_cache_policy_t)config->cache_policy;
+    result = uvhttp_lru_cache_set_policy(ctx->cache, policy);
+    if (result == UVHTTP_OK && ctx->mapped) {
+        result = uvhttp_lru_cache_set_policy(ctx->mapped, policy);
+    }
+    if (result != UVHTTP_OK) {
+        UVHTTP_LOG_ERROR("Failed to set cache policy: %s",
+                         uvhttp_error_string(result));
+        uvhttp_lru_cache_free(ctx->cache);
+        if (ctx->mapped) {
+            uvhttp_lru_cache_free(ctx->mapped);
+        }
+        uvhttp_free(ctx);
+        return result;
+    }
+
+    if (config->open_file_cache_size >= 0) {
+        result = uvhttp_open_file_cache_create(
+            config->open_file_cache_size, config->open_file_cache_ttl, 0,
+            &ctx->open_files);
+        if (result != UVHTTP_OK) {
+            UVHTTP_LOG_ERROR("Failed to create open-file cache: %s",
+                             uvhttp_error_string(result));
+            uvhttp_lru_cache_free(ctx->cache);
+            if (ctx->mapped) {
+                uvhttp_lru_cache_free(ctx->mapped);
+            }
+            uvhttp_free(ctx);
+            return result;
+        }
+        uvhttp_open_file_cache_set_invalidate_cb(ctx->open_files,
+                                                 static_on_file_changed, ctx);
+    }
+
     *context = ctx;
     return UVHTTP_OK;
 }
@@ -952,9 +1031,19 @@ void uvhttp_static_free(uvhttp_static_context_t* ctx) {
     if (!ctx)
         return;
 
+    /* the last cache miss in flight releases the context */
+    if (ctx->fs_pending > 0) {
+        ctx->freed = 1;
+        return;
+    }
+
     if (ctx->cache) {
         uvhttp_lru_cache_free(ctx->cache);
     }
+    if (ctx->mapped) {
+        uvhttp_lru_cache_free(ctx->mapped);
+    }
+    uvhttp_open_file_cache_free(ctx->open_files);
 
     uvhttp_free(ctx);
 }
@@ -1053,246 +1142,925 @@ int uvhttp_static_resolve_safe_path(const char* root_dir, const char* file_path,
 }
 
 /**
- * main function to process static file request
+ * send a short text/plain response with status
  */
-uvhttp_result_t uvhttp_static_handle_request(uvhttp_static_context_t* ctx,
-                                             void* request, void* response) {
-    if (!ctx || !request || !response) {
-        return UVHTTP_ERROR_INVALID_PARAM;
-    }
+static void static_send_status(uvhttp_response_t* response, int status,
+                               const char* message) {
+    uvhttp_response_set_status(response, status);
+    uvhttp_response_set_header(response, "Content-Type",
+                               UVHTTP_CONTENT_TYPE_TEXT);
+    uvhttp_response_set_body(response, message, strlen(message));
+    uvhttp_response_send(response);
+}
 
-    const char* url = uvhttp_request_get_url(request);
-    if (!url) {
-        uvhttp_response_set_status(response, 400);
-        return UVHTTP_ERROR_MALFORMED_REQUEST;
+/* a q-value ("0.5", "1", "0.125") in thousandths; -1 when malformed */
+static int static_parse_qvalue(const char* p, const char** end) {
+    if (*p != '0' && *p != '1') {
+        return -1;
     }
-
-    /* parse URL path, remove query parameters */
-    char clean_path[UVHTTP_MAX_PATH_SIZE];
-    const char* query_start = strchr(url, '?');
-    size_t path_len = query_start ? (size_t)(query_start - url) : strlen(url);
-
-    if (path_len >= sizeof(clean_path)) {
-        uvhttp_response_set_status(response, 414); /* URI Too Long */
-        return UVHTTP_ERROR_HEADER_TOO_LARGE;
+    int q = (*p++ - '0') * 1000;
+    if (*p == '.') {
+        p++;
+        for (int scale = 100; scale > 0 && *p >= '0' && *p <= '9';
+             scale /= 10) {
+            q += (*p++ - '0') * scale;
+        }
     }
+    *end = p;
+    return q <= 1000 ? q : -1;
+}
 
-    /* use safe string copy */
-    memcpy(clean_path, url, path_len);
-    clean_path[path_len] = '\0';
-
-    /* process root path */
-    if (strcmp(clean_path, "/") == 0) {
-        /* index_file must keep the leading '/' — uvhttp_validate_url_path()
-         * rejects paths that do not start with '/' */
-        char buf[UVHTTP_MAX_PATH_SIZE];
-        if (uvhttp_safe_strncpy(buf, ctx->config.index_file, sizeof(buf)) ==
-            0) {
-            if (buf[0] == '/') {
-                uvhttp_safe_strncpy(clean_path, buf, sizeof(clean_path));
-            } else {
-                size_t blen = strlen(buf);
-                if (blen + 1 >= sizeof(clean_path)) {
-                    blen = sizeof(clean_path) - 2; /* keep room for '/' + NUL */
+int uvhttp_static_accepts_encoding(const char* accept_encoding,
+                                   const char* coding) {
+    int identity = coding && strcasecmp(coding, "identity") == 0;
+    if (!accept_encoding || !coding) {
+        return identity ? 1000 : 0;
+    }
+    size_t coding_len = strlen(coding);
+    int quality = -1;
+    int wildcard = -1;
+    const char* p = accept_encoding;
+    while (*p) {
+        while (*p == ',' || *p == ' ' || *p == '\t') {
+            p++;
+        }
+        const char* token = p;
+        while (*p && *p != ',' && *p != ';' && *p != ' ' && *p != '\t') {
+            p++;
+        }
+        size_t token_len = (size_t)(p - token);
+        int q = 1000;
+        while (*p && *p != ',') {
+            /* parameters: only q means anything */
+            if (*p == ';') {
+                p++;
+                while (*p == ' ' || *p == '\t') {
+                    p++;
                 }
-                clean_path[0] = '/';
-                memcpy(clean_path + 1, buf, blen);
-                clean_path[blen + 1] = '\0';
+                if ((*p == 'q' || *p == 'Q') && p[1] == '=') {
+                    const char* end = p + 2;
+                    q = static_parse_qvalue(p + 2, &end);
+                    p = end;
+                    if (q < 0 || (*p && *p != ',' && *p != ';' && *p != ' ' &&
+                                  *p != '\t')) {
+                        q = 0;
+                    }
+                }
+            } else {
+                p++;
             }
-        } else {
-            /* index_file too long, use default value */
-            uvhttp_safe_strncpy(clean_path, "/index.html",
-                                sizeof(clean_path));
+        }
+        if (token_len == coding_len &&
+            strncasecmp(token, coding, coding_len) == 0) {
+            quality = q > quality ? q : quality;
+        } else if (token_len == 1 && *token == '*') {
+            wildcard = q;
         }
     }
-
-    /* build safe file path */
-    char safe_path[UVHTTP_MAX_FILE_PATH_SIZE];
-    if (!uvhttp_static_resolve_safe_path(ctx->config.root_directory, clean_path,
-                                         safe_path, sizeof(safe_path))) {
-        uvhttp_response_set_status(response, 403); /* Forbidden */
-        return UVHTTP_ERROR_NOT_FOUND;
+    if (quality >= 0) {
+        return quality;
     }
+    if (wildcard >= 0) {
+        return wildcard;
+    }
+    return identity ? 1000 : 0;
+}
 
-    /* checkcache */
-    cache_entry_t* cache_entry = uvhttp_lru_cache_find(ctx->cache, safe_path);
+static int static_accepts_gzip(uvhttp_request_t* request) {
+    return uvhttp_static_accepts_encoding(
+               uvhttp_request_get_header(request, "Accept-Encoding"),
+               "gzip") > 0;
+}
 
-    if (cache_entry) {
-        /* send response from cache */
-        if (uvhttp_static_check_conditional_request(
-                request, cache_entry->etag, cache_entry->last_modified)) {
-            uvhttp_response_set_status(response, 304); /* Not Modified */
-        } else {
-            uvhttp_static_set_response_headers(
-                response, cache_entry->file_path, cache_entry->content_length,
-                cache_entry->last_modified, cache_entry->etag);
-            uvhttp_response_set_body(response, cache_entry->content,
-                                     cache_entry->content_length);
-            uvhttp_response_set_status(response, 200);
-        }
-        uvhttp_response_send(response);
-        return UVHTTP_OK;
+/**
+ * answer a request for a file that does not exist (or is outside the root)
+ */
+static void static_not_found(uvhttp_request_t* request,
+                             uvhttp_response_t* response,
+                             uvhttp_request_handler_t fallback) {
+    if (fallback) {
+        fallback(request, response);
+        return;
     }
+    static_send_status(response, 404, UVHTTP_MESSAGE_NOT_FOUND);
+}
 
-    /* cache miss, read file */
-    size_t file_size;
-    time_t last_modified;
+/* a GET with a Range header: answered from the identity file, as byte
+ * offsets into a .gz variant are of no use to a client seeking in (or
+ * resuming) the file */
+static int static_wants_range(uvhttp_request_t* request) {
+    return request && request->method == UVHTTP_GET &&
+           uvhttp_request_get_header(request, "Range") != NULL;
+}
 
-    /* getfileinfo */
-    if (get_file_info(safe_path, &file_size, &last_modified) != 0) {
-        /* check if it's a directory */
-        struct stat st;
-        if (stat(safe_path, &st) == 0 && S_ISDIR(st.st_mode)) {
-            if (ctx->config.enable_directory_listing) {
-                /* generate directory list */
-                char* dir_html =
-                    generate_directory_listing(safe_path, clean_path);
-                if (dir_html) {
-                    uvhttp_response_set_status(response, 200);
-                    uvhttp_response_set_header(response, "Content-Type",
-                                               "text/html");
-                    uvhttp_response_set_body(response, dir_html,
-                                             strlen(dir_html));
-                    uvhttp_free(dir_html);
-                    return UVHTTP_OK;
-                }
-            }
-            /* attemptaddindexfile */
-            char index_path[UVHTTP_MAX_FILE_PATH_SIZE];
-            int result = snprintf(index_path, sizeof(index_path), "%s/%s",
-                                  safe_path, ctx->config.index_file);
-            if (result >= (int)sizeof(index_path)) {
-                uvhttp_response_set_status(response, 414); /* URI Too Long */
-                return UVHTTP_ERROR_HEADER_TOO_LARGE;
-            }
+/* If-Range: the partial copy the client holds must still be current. Only
+ * a strong ETag, or the exact Last-Modified date, validates it */
+static int static_if_range_matches(const char* if_range, const char* etag,
+                                   time_t last_modified) {
+    if (if_range[0] == '"') {
+        return etag && strcmp(if_range, etag) == 0;
+    }
+    if (strncmp(if_range, "W/", 2) == 0 || last_modified <= 0) {
+        return 0;
+    }
+    char time_str[64];
+    strftime(time_str, sizeof(time_str), "%a, %d %b %Y %H:%M:%S GMT",
+             gmtime(&last_modified));
+    return strcmp(if_range, time_str) == 0;
+}
 
-            if (get_file_info(index_path, &file_size, &last_modified) == 0) {
-                /* use safe string copy, auto-truncate if path too long */
-                uvhttp_safe_strncpy(safe_path, index_path, sizeof(safe_path));
-            } else {
-                uvhttp_response_set_status(response, 404); /* Not Found */
-                return UVHTTP_ERROR_NOT_FOUND;
-            }
-        } else {
-            uvhttp_response_set_status(response, 404); /* Not Found */
-            return UVHTTP_ERROR_NOT_FOUND;
-        }
+/* the ranges request asks for of a file of file_size bytes with the given
+ * validators: 0 to send it whole, -1 when none is satisfiable */
+static int static_request_ranges(uvhttp_request_t* request, size_t file_size,
+                                 const char* etag, time_t last_modified,
+                                 uvhttp_static_range_t* ranges) {
+    if (!static_wants_range(request)) {
+        return 0;
+    }
+    const char* if_range = uvhttp_request_get_header(request, "If-Range");
+    if (if_range && !static_if_range_matches(if_range, etag, last_modified)) {
+        return 0;
     }
+    return uvhttp_static_parse_range(
+        uvhttp_request_get_header(request, "Range"), file_size, ranges,
+        UVHTTP_STATIC_MAX_RANGES);
+}
 
-    /* check file size limit to prevent DoS attacks */
-    if (file_size > ctx->config.max_file_size) {
-        UVHTTP_LOG_WARN("File too large: %s (size: %zu, limit: %zu)", safe_path,
-                        file_size, ctx->config.max_file_size);
-        uvhttp_response_set_status(response, 413); /* Payload Too Large */
-        return UVHTTP_ERROR_FILE_TOO_LARGE;
-    }
-
-    /* check if a pre-compressed .gz version exists and client accepts gzip */
-    if (file_size >= 512) {  /* only precompress files >= 512 bytes */
-        const char* accept_encoding = uvhttp_request_get_header(request, "Accept-Encoding");
-        if (accept_encoding && strstr(accept_encoding, "gzip")) {
-            char gz_path[UVHTTP_MAX_FILE_PATH_SIZE];
-            int ret = snprintf(gz_path, sizeof(gz_path), "%s.gz", safe_path);
-            if (ret > 0 && ret < (int)sizeof(gz_path)) {
-                size_t gz_size;
-                time_t gz_mtime;
-                if (get_file_info(gz_path, &gz_size, &gz_mtime) == 0 && gz_size > 0) {
-                    uvhttp_safe_strncpy(safe_path, gz_path, sizeof(safe_path));
-                    file_size = gz_size;
-                    last_modified = gz_mtime;
-                }
-            }
-        }
+/* Content-Range of range (NULL: of a 416) */
+static void static_set_content_range(uvhttp_response_t* response,
+                                     const uvhttp_static_range_t* range,
+                                     size_t file_size) {
+    char value[96];
+    if (range) {
+        snprintf(value, sizeof(value), "bytes %zu-%zu/%zu", range->start,
+                 range->start + range->length - 1, file_size);
+    } else {
+        snprintf(value, sizeof(value), "bytes */%zu", file_size);
     }
+    uvhttp_response_set_header(response, "Content-Range", value);
+}
 
-    /* for medium and large files (> 64KB), use sendfile zero-copy optimization
-     * - performance optimization */
-    if (file_size > UVHTTP_SENDFILE_MIN_FILE_SIZE) {
-        /* getMIMEtype */
-        char mime_type[UVHTTP_MAX_HEADER_VALUE_SIZE];
-        uvhttp_static_get_mime_type(safe_path, mime_type, sizeof(mime_type));
+static void static_send_unsatisfiable(uvhttp_response_t* response,
+                                      size_t file_size) {
+    static_set_content_range(response, NULL, file_size);
+    static_send_status(response, 416, UVHTTP_MESSAGE_RANGE_NOT_SATISFIABLE);
+}
 
-        /* generateETag */
-        char etag[UVHTTP_MAX_HEADER_VALUE_SIZE];
-        uvhttp_static_generate_etag(safe_path, last_modified, file_size, etag,
-                                    sizeof(etag));
+/*
+ * multipart/byteranges: each part is "\r\n--<boundary>\r\n", its
+ * Content-Type and Content-Range, a blank line and its bytes; the body ends
+ * with "\r\n--<boundary>--\r\n".
+ */
+#    define STATIC_BOUNDARY_SIZE 32
 
-        /* checkconditionrequest */
-        if (uvhttp_static_check_conditional_request(request, etag,
-                                                    last_modified)) {
-            uvhttp_response_set_status(response, 304); /* Not Modified */
-            return 0;
+static void static_new_boundary(char* boundary) {
+    snprintf(boundary, STATIC_BOUNDARY_SIZE, "uvhttp-%016llx",
+             (unsigned long long)uv_hrtime());
+}
+
+static int static_part_header(char* buf, size_t size, const char* boundary,
+                              const char* mime_type,
+                              const uvhttp_static_range_t* range,
+                              size_t file_size) {
+    return snprintf(buf, size,
+                    "\r\n--%s\r\nContent-Type: %s\r\n"
+                    "Content-Range: bytes %zu-%zu/%zu\r\n\r\n",
+                    boundary, mime_type, range->start,
+                    range->start + range->length - 1, file_size);
+}
+
+static int static_part_end(char* buf, size_t size, const char* boundary) {
+    return snprintf(buf, size, "\r\n--%s--\r\n", boundary);
+}
+
+static size_t static_multipart_length(const char* boundary,
+                                      const char* mime_type,
+                                      const uvhttp_static_range_t* ranges,
+                                      int count, size_t file_size) {
+    size_t length = (size_t)static_part_end(NULL, 0, boundary);
+    for (int i = 0; i < count; i++) {
+        length += (size_t)static_part_header(NULL, 0, boundary, mime_type,
+                                             &ranges[i], file_size) +
+                  ranges[i].length;
+    }
+    return length;
+}
+
+static void static_set_multipart_headers(uvhttp_response_t* response,
+                                         const char* boundary, size_t length,
+                                         time_t last_modified,
+                                         const char* etag) {
+    char value[64];
+    snprintf(value, sizeof(value), "multipart/byteranges; boundary=%s",
+             boundary);
+    uvhttp_response_set_header(response, "Content-Type", value);
+    snprintf(value, sizeof(value), "%zu", length);
+    uvhttp_response_set_header(response, "Content-Length", value);
+    static_set_validator_headers(response, last_modified, etag);
+}
+
+static void static_release_head(void* data) {
+    uvhttp_cache_buffer_release((uvhttp_cache_buffer_t*)data);
+}
+
+/* send the head built for response, then length bytes of buffer from
+ * start as they are: buffer is held until the write is done. Returns 0
+ * when the body needs copying instead */
+static int static_send_shared(uvhttp_response_t* response,
+                              uvhttp_cache_buffer_t* buffer, size_t start,
+                              size_t length) {
+    if (!buffer || response->compress || response->sent || !response->client) {
+        return 0;
+    }
+    char* head_data = NULL;
+    size_t head_length = 0;
+    if (uvhttp_response_build_data(response, &head_data, &head_length) !=
+        UVHTTP_OK) {
+        return 0;
+    }
+    uvhttp_cache_buffer_t* head = uvhttp_cache_buffer_create(head_length);
+    if (!head) {
+        uvhttp_free(head_data);
+        return 0;
+    }
+    memcpy(head->data, head_data, head_length);
+    uvhttp_free(head_data);
+    uvhttp_cache_buffer_retain(buffer);
+    head->body = buffer;
+
+    uv_buf_t bufs[2];
+    bufs[0] = uv_buf_init(head->data, (unsigned int)head_length);
+    bufs[1] = uv_buf_init(buffer->data + start, (unsigned int)length);
+    if (uvhttp_response_send_iov(response, bufs, length > 0 ? 2 : 1,
+                                 static_release_head, head) != UVHTTP_OK) {
+        uvhttp_cache_buffer_release(head);
+        return 0;
+    }
+    return 1;
+}
+
+/* answer with content, the file_size bytes of the file at path: whole
+ * (200), or the ranges of it request asks for (206, 416). When content is
+ * the data of buffer, a whole or single-range answer is sent from it
+ * without a copy */
+static void static_send_content(uvhttp_request_t* request,
+                                uvhttp_response_t* response, const char* path,
+                                const char* content, size_t file_size,
+                                time_t last_modified, const char* etag,
+                                uvhttp_cache_buffer_t* buffer) {
+    uvhttp_static_range_t ranges[UVHTTP_STATIC_MAX_RANGES];
+    int count = static_request_ranges(request, file_size, etag, last_modified,
+                                      ranges);
+    if (count < 0) {
+        static_send_unsatisfiable(response, file_size);
+        return;
+    }
+
+    if (count == 0) {
+        uvhttp_static_set_response_headers(response, path, file_size,
+                                           last_modified, etag);
+        uvhttp_response_set_status(response, 200);
+        if (static_send_shared(response, buffer, 0, file_size)) {
+            return;
         }
+        if (file_size > 0) {
+            uvhttp_response_set_body(response, content, file_size);
+        }
+    } else if (count == 1) {
+        /* a slice of content: set_body copies just that */
+        uvhttp_static_set_response_headers(response, path, ranges[0].length,
+                                           last_modified, etag);
+        static_set_content_range(response, &ranges[0], file_size);
+        uvhttp_response_set_status(response, 206);
+        if (static_send_shared(response, buffer, ranges[0].start,
+                               ranges[0].length)) {
+            return;
+        }
+        uvhttp_response_set_body(response, content + ranges[0].start,
+                                 ranges[0].length);
+    } else {
+        char boundary[STATIC_BOUNDARY_SIZE];
+        char mime_type[UVHTTP_MAX_HEADER_VALUE_SIZE];
+        static_new_boundary(boundary);
+        uvhttp_static_get_mime_type(path, mime_type, sizeof(mime_type));
+        size_t length = static_multipart_length(boundary, mime_type, ranges,
+                                                count, file_size);
+        char* body = uvhttp_alloc(length + 1); /* + snprintf's NUL */
+        if (!body) {
+            static_send_status(response, 500, UVHTTP_MESSAGE_MEMORY_FAILED);
+            return;
+        }
+        size_t pos = 0;
+        for (int i = 0; i < count; i++) {
+            pos += (size_t)static_part_header(body + pos, length + 1 - pos,
+                                              boundary, mime_type, &ranges[i],
+                                              file_size);
+            memcpy(body + pos, content + ranges[i].start, ranges[i].length);
+            pos += ranges[i].length;
+        }
+        static_part_end(body + pos, length + 1 - pos, boundary);
+        static_set_multipart_headers(response, boundary, length, last_modified,
+                                     etag);
+        uvhttp_response_set_body(response, body, length);
+        uvhttp_free(body);
+        uvhttp_response_set_status(response, 206);
+    }
+    uvhttp_response_send(response);
+}
+
+/* render the head of a whole-file answer for the content_length bytes
+ * cached under key, both with keep-alive and with Connection: close */
+static uvhttp_cache_buffer_t* static_render_head(uvhttp_response_t* response,
+                                                 const char* key,
+                                                 size_t content_length,
+                                                 time_t last_modified,
+                                                 const char* etag,
+                                                 size_t* keepalive_length) {
+    /* a scratch response on the same client: only built, never sent */
+    uvhttp_response_t* scratch = uvhttp_alloc(sizeof(uvhttp_response_t));
+    if (!scratch) {
+        return NULL;
+    }
+    char* heads[2] = {NULL, NULL};
+    size_t lengths[2] = {0, 0};
+    int ok = uvhttp_response_init(scratch, response->client) == UVHTTP_OK &&
+             uvhttp_static_set_response_headers(scratch, key, content_length,
+                                                last_modified,
+                                                etag) == UVHTTP_OK;
+    for (int i = 0; ok && i < 2; i++) {
+        scratch->keepalive = i == 0;
+        ok = uvhttp_response_build_data(scratch, &heads[i], &lengths[i]) ==
+             UVHTTP_OK;
+    }
+    uvhttp_cache_buffer_t* head =
+        ok ? uvhttp_cache_buffer_create(lengths[0] + lengths[1]) : NULL;
+    if (head) {
+        memcpy(head->data, heads[0], lengths[0]);
+        memcpy(head->data + lengths[0], heads[1], lengths[1]);
+        *keepalive_length = lengths[0];
+    }
+    uvhttp_free(heads[0]);
+    uvhttp_free(heads[1]);
+    uvhttp_response_cleanup(scratch);
+    uvhttp_free(scratch);
+    return head;
+}
+
+/* whether a cache hit can be answered with its pre-rendered head: not for
+ * ranges, headers set by the caller or compression */
+static int static_can_send_head(uvhttp_request_t* request,
+                                uvhttp_response_t* response) {
+    return !static_wants_range(request) && response->header_count == 0 &&
+           !response->compress && !response->sent && response->client;
+}
+
+/* write head (its keep-alive or close variant) and content as they are:
+ * two iovecs, no copy, held until the write is done */
+static int static_send_head(uvhttp_response_t* response,
+                            uvhttp_cache_buffer_t* head,
+                            size_t keepalive_length,
+                            uvhttp_cache_buffer_t* content) {
+    uv_buf_t bufs[2];
+    if (response->keepalive) {
+        bufs[0] = uv_buf_init(head->data, (unsigned int)keepalive_length);
+    } else {
+        bufs[0] = uv_buf_init(head->data + keepalive_length,
+                              (unsigned int)(head->length - keepalive_length));
+    }
+    bufs[1] = uv_buf_init(content->data, (unsigned int)content->length);
+
+    /* the head holds the content it describes */
+    uvhttp_cache_buffer_retain(head);
+    if (uvhttp_response_send_iov(response, bufs, content->length > 0 ? 2 : 1,
+                                 static_release_head, head) != UVHTTP_OK) {
+        uvhttp_cache_buffer_release(head);
+        return 0;
+    }
+    return 1;
+}
 
-        /* use sendfile to send (pass config) */
-        uvhttp_result_t sendfile_result = uvhttp_static_sendfile_with_config(
-            safe_path, response, &ctx->config);
-        if (sendfile_result != UVHTTP_OK) {
-            UVHTTP_LOG_ERROR("sendfile failed: %s",
-                             uvhttp_error_string(sendfile_result));
-            /* fallback to chunked transfer for large files */
-            /* chunked transfer avoids loading entire file into memory */
-            int chunked_result = send_file_chunked(
-                safe_path, file_size, last_modified, response, etag, safe_path);
-            return chunked_result;
+/* The cache entries of a hit are looked up by key in owner, or in
+ * ctx->shared when owner is NULL; an entry whose content is no longer the
+ * one the hit holds has been replaced, and is left alone */
+
+/* keep head (taken over) as the head of the hit's content in encoding
+ * (-1 for identity), or drop it */
+static void static_keep_head(uvhttp_static_context_t* ctx,
+                             cache_manager_t* owner, const char* key,
+                             const uvhttp_cache_buffer_t* content,
+                             int encoding, uvhttp_cache_buffer_t* head,
+                             size_t keepalive_length) {
+    if (!owner) {
+        if (encoding < 0) {
+            uvhttp_shared_cache_set_head(ctx->shared, key, content, head,
+                                         keepalive_length);
         } else {
-            /* sendfilesuccess, return */
-            return UVHTTP_OK;
+            uvhttp_shared_cache_set_variant_head(
+                ctx->shared, key, (uvhttp_cache_encoding_t)encoding, head,
+                keepalive_length);
+        }
+        return;
+    }
+    cache_entry_t* entry = uvhttp_lru_cache_peek(owner, key);
+    if (!entry || entry->buffer != content) {
+        uvhttp_cache_buffer_release(head);
+    } else if (encoding < 0) {
+        uvhttp_lru_cache_set_head(owner, entry, head, keepalive_length);
+    } else if (entry->variants[encoding].buffer == head->body) {
+        uvhttp_lru_cache_set_variant_head(
+            owner, entry, (uvhttp_cache_encoding_t)encoding, head,
+            keepalive_length);
+    } else {
+        uvhttp_cache_buffer_release(head);
+    }
+}
+
+/* work on the thread pool holds the context like a cache miss; the last
+ * to finish after uvhttp_static_free destroys it */
+static void static_context_destroy(uvhttp_static_context_t* ctx);
+static int static_op_max_inflight(const uvhttp_static_context_t* ctx);
+
+#    if UVHTTP_FEATURE_COMPRESSION
+
+typedef uvhttp_error_t (*static_encoder_t)(const char* input,
+                                           size_t input_len, char** output,
+                                           size_t* output_len);
+
+/* the encoder of each uvhttp_cache_encoding_t */
+static const static_encoder_t static_encoders[UVHTTP_CACHE_ENCODING_COUNT] =
+    {
+        uvhttp_compress_gzip,
+};
+
+/* A cache entry's content being encoded on the thread pool */
+typedef struct static_encode_job {
+    uv_work_t work;
+    uvhttp_static_context_t* ctx;
+    cache_manager_t* owner;          /* NULL for ctx->shared */
+    uvhttp_cache_buffer_t* content;  /* held until done */
+    uvhttp_cache_buffer_t* encoded;  /* NULL when not worth keeping */
+    uvhttp_cache_encoding_t encoding;
+    char key[1]; /* allocated to fit */
+} static_encode_job_t;
+
+/* whether ctx keeps encoded variants of length bytes of mime_type */
+static int static_encodable(uvhttp_static_context_t* ctx,
+                            const char* mime_type, size_t length) {
+    return ctx->config.compress_cache &&
+           length >= UVHTTP_STATIC_COMPRESS_MIN_SIZE &&
+           uvhttp_should_compress_by_content_type(mime_type);
+}
+
+/* content in encoding, or NULL when that is no smaller */
+static uvhttp_cache_buffer_t* static_encode(uvhttp_cache_encoding_t encoding,
+                                            const uvhttp_cache_buffer_t* content) {
+    char* output = NULL;
+    size_t output_len = 0;
+    uvhttp_cache_buffer_t* encoded = NULL;
+    if (static_encoders[encoding](content->data, content->length, &output,
+                                  &output_len) == UVHTTP_OK &&
+        output_len < content->length) {
+        encoded = uvhttp_cache_buffer_create(output_len);
+        if (encoded) {
+            memcpy(encoded->data, output, output_len);
         }
     }
+    uvhttp_free(output);
+    return encoded;
+}
 
-    /* read file content (small file or fallback when sendfile fails) */
-    char* file_content = read_file_content(safe_path, &file_size);
-    if (!file_content) {
-        uvhttp_response_set_status(response, 500); /* Internal Server Error */
-        return UVHTTP_ERROR_IO_ERROR;
+/* claim the making of the variant in encoding of the content at key */
+static int static_claim_variant(uvhttp_static_context_t* ctx,
+                                cache_manager_t* owner, const char* key,
+                                const uvhttp_cache_buffer_t* content,
+                                uvhttp_cache_encoding_t encoding) {
+    if (!owner) {
+        return uvhttp_shared_cache_claim_variant(ctx->shared, key, content,
+                                                 encoding);
     }
+    cache_entry_t* entry = uvhttp_lru_cache_peek(owner, key);
+    return entry && entry->buffer == content &&
+           uvhttp_lru_cache_claim_variant(entry, encoding);
+}
 
-    /* getMIMEtype */
-    char mime_type[UVHTTP_MAX_HEADER_VALUE_SIZE];
-    uvhttp_static_get_mime_type(safe_path, mime_type, sizeof(mime_type));
+/* keep encoded (NULL: not worth it) as the variant of the content at key */
+static void static_keep_variant(uvhttp_static_context_t* ctx,
+                                cache_manager_t* owner, const char* key,
+                                const uvhttp_cache_buffer_t* content,
+                                uvhttp_cache_encoding_t encoding,
+                                uvhttp_cache_buffer_t* encoded) {
+    if (!owner) {
+        uvhttp_shared_cache_set_variant(ctx->shared, key, content, encoding,
+                                        encoded);
+        return;
+    }
+    cache_entry_t* entry = uvhttp_lru_cache_peek(owner, key);
+    if (entry && entry->buffer == content) {
+        uvhttp_lru_cache_set_variant(owner, entry, encoding, encoded);
+    }
+}
 
-    /* generateETag */
-    char etag[UVHTTP_MAX_HEADER_VALUE_SIZE];
-    uvhttp_static_generate_etag(safe_path, last_modified, file_size, etag,
-                                sizeof(etag));
+static void static_encode_work(uv_work_t* req) {
+    static_encode_job_t* job = (static_encode_job_t*)req->data;
+    job->encoded = static_encode(job->encoding, job->content);
+}
 
-    /* checkconditionrequest */
-    if (uvhttp_static_check_conditional_request(request, etag, last_modified)) {
-        uvhttp_free(file_content);
+static void static_encode_done(uv_work_t* req, int status) {
+    static_encode_job_t* job = (static_encode_job_t*)req->data;
+    uvhttp_static_context_t* ctx = job->ctx;
+    /* the context's own cache may have been replaced meanwhile */
+    if (status == 0 && !ctx->freed &&
+        (job->owner ? job->owner == ctx->cache || job->owner == ctx->mapped
+                    : ctx->shared != NULL)) {
+        static_keep_variant(ctx, job->owner, job->key, job->content,
+                            job->encoding, job->encoded);
+    }
+    uvhttp_cache_buffer_release(job->encoded);
+    uvhttp_cache_buffer_release(job->content);
+    uvhttp_free(job);
+
+    ctx->fs_pending--;
+    if (ctx->freed && ctx->fs_pending == 0) {
+        static_context_destroy(ctx);
+    }
+}
+
+/* make the variant in encoding of content, the entry at key, on the
+ * thread pool of loop; until then the entry is answered as it is */
+static void static_encode_start(uvhttp_static_context_t* ctx,
+                                cache_manager_t* owner, const char* key,
+                                uvhttp_cache_buffer_t* content,
+                                uvhttp_cache_encoding_t encoding,
+                                uv_loop_t* loop) {
+    if (!static_claim_variant(ctx, owner, key, content, encoding)) {
+        return;
+    }
+    size_t key_len = strlen(key);
+    static_encode_job_t* job =
+        uvhttp_alloc(sizeof(static_encode_job_t) + key_len);
+    if (!job) {
+        return;
+    }
+    memset(job, 0, sizeof(static_encode_job_t));
+    job->work.data = job;
+    job->ctx = ctx;
+    job->owner = owner;
+    job->encoding = encoding;
+    memcpy(job->key, key, key_len + 1);
+    uvhttp_cache_buffer_retain(content);
+    job->content = content;
+    /* holds ctx like a cache miss */
+    ctx->fs_pending++;
+    if (uv_queue_work(loop, &job->work, static_encode_work,
+                      static_encode_done) != 0) {
+        ctx->fs_pending--;
+        uvhttp_cache_buffer_release(content);
+        uvhttp_free(job);
+    }
+}
+
+/* make every variant of content, the entry at key, now (prewarming) */
+static void static_encode_now(uvhttp_static_context_t* ctx,
+                              cache_manager_t* owner, const char* key,
+                              uvhttp_cache_buffer_t* content,
+                              const char* mime_type) {
+    if (!static_encodable(ctx, mime_type, content->length)) {
+        return;
+    }
+    for (int i = 0; i < UVHTTP_CACHE_ENCODING_COUNT; i++) {
+        uvhttp_cache_encoding_t encoding = (uvhttp_cache_encoding_t)i;
+        if (static_claim_variant(ctx, owner, key, content, encoding)) {
+            uvhttp_cache_buffer_t* encoded = static_encode(encoding, content);
+            static_keep_variant(ctx, owner, key, content, encoding, encoded);
+            uvhttp_cache_buffer_release(encoded);
+        }
+    }
+}
+
+#    endif /* UVHTTP_FEATURE_COMPRESSION */
+
+/* the content coding to answer hit in (-1 for identity): the variant the
+ * client accepts best, identity winning only with a higher q-value. An
+ * acceptable variant not made yet is started, for later hits */
+static int static_hit_encoding(uvhttp_static_context_t* ctx,
+                               cache_manager_t* owner, const char* key,
+                               uvhttp_request_t* request,
+                               uvhttp_response_t* response,
+                               uvhttp_cache_hit_t* hit) {
+#    if UVHTTP_FEATURE_COMPRESSION
+    const char* accept_encoding =
+        uvhttp_request_get_header(request, "Accept-Encoding");
+    if (!accept_encoding || static_wants_range(request) ||
+        !static_encodable(ctx, hit->mime_type, hit->buffer->length)) {
+        return -1;
+    }
+    int best = -1;
+    int best_q = uvhttp_static_accepts_encoding(accept_encoding, "identity");
+    for (int i = 0; i < UVHTTP_CACHE_ENCODING_COUNT; i++) {
+        int q = uvhttp_static_accepts_encoding(accept_encoding,
+                                               static_encodings[i].coding);
+        if (q <= 0 || q < best_q || (q == best_q && best >= 0)) {
+            continue;
+        }
+        if (hit->variants[i].buffer) {
+            best = i;
+            best_q = q;
+        } else if (!(hit->encodings_tried & (1u << i)) && response->client) {
+            static_encode_start(
+                ctx, owner, key, hit->buffer, (uvhttp_cache_encoding_t)i,
+                uv_handle_get_loop((uv_handle_t*)response->client));
+        }
+    }
+    return best;
+#    else
+    (void)ctx;
+    (void)owner;
+    (void)key;
+    (void)request;
+    (void)response;
+    (void)hit;
+    return -1;
+#    endif
+}
+
+/* the ETag of a variant: the entry's with the coding appended inside the
+ * quotes, so that validators tell the representations apart */
+static void static_variant_etag(const char* etag, int encoding, char* out,
+                                size_t size) {
+    size_t len = strlen(etag);
+    if (len < 2 || etag[len - 1] != '"') {
+        snprintf(out, size, "%s", etag);
+        return;
+    }
+    snprintf(out, size, "%.*s-%s\"", (int)(len - 1), etag,
+             static_encodings[encoding].coding);
+}
+
+/* answer request from hit, the entry at key: 304, or the content in the
+ * best coding the client accepts. A whole answer is written from the
+ * pre-rendered head, rendered and offered to the cache on the first hit */
+static void static_send_hit(uvhttp_static_context_t* ctx,
+                            cache_manager_t* owner, const char* key,
+                            uvhttp_request_t* request,
+                            uvhttp_response_t* response,
+                            uvhttp_cache_hit_t* hit) {
+    int encoding = static_hit_encoding(ctx, owner, key, request, response, hit);
+    const char* path = key;
+    const char* etag = hit->etag;
+    uvhttp_cache_buffer_t* content = hit->buffer;
+    uvhttp_cache_buffer_t** head = &hit->head;
+    size_t* keepalive_length = &hit->head_keepalive_length;
+    char variant_path[UVHTTP_MAX_PATH_SIZE + 8];
+    char variant_etag[UVHTTP_CACHE_ETAG_SIZE + 16];
+    if (encoding >= 0) {
+        uvhttp_cache_variant_t* variant = &hit->variants[encoding];
+        snprintf(variant_path, sizeof(variant_path), "%s%s", key,
+                 static_encodings[encoding].suffix);
+        static_variant_etag(hit->etag, encoding, variant_etag,
+                            sizeof(variant_etag));
+        path = variant_path;
+        etag = variant_etag;
+        content = variant->buffer;
+        head = &variant->head;
+        keepalive_length = &variant->head_keepalive_length;
+    }
+
+    if (uvhttp_static_check_conditional_request(request, etag,
+                                                hit->last_modified)) {
         uvhttp_response_set_status(response, 304); /* Not Modified */
+        uvhttp_response_send(response);
+        return;
+    }
+    if (static_can_send_head(request, response)) {
+        if (!*head) {
+            *head = static_render_head(response, path, content->length,
+                                       hit->last_modified, etag,
+                                       keepalive_length);
+            if (*head) {
+                uvhttp_cache_buffer_retain(content);
+                (*head)->body = content;
+                /* one reference for the hit, one for the cache */
+                uvhttp_cache_buffer_retain(*head);
+                static_keep_head(ctx, owner, key, hit->buffer, encoding,
+                                 *head, *keepalive_length);
+            }
+        }
+        if (*head &&
+            static_send_head(response, *head, *keepalive_length, content)) {
+            return;
+        }
+    }
+    static_send_content(request, response, path, content->data,
+                        content->length, hit->last_modified, etag, content);
+}
+
+/* whether tier (NULL for the shared cache) has a live entry for key,
+ * without counting a lookup */
+static int static_cache_holds(uvhttp_static_context_t* ctx,
+                              cache_manager_t* tier, const char* key) {
+    if (!tier) {
+        return ctx->shared && uvhttp_shared_cache_contains(ctx->shared, key);
+    }
+    cache_entry_t* entry = uvhttp_lru_cache_peek(tier, key);
+    return entry && !uvhttp_lru_cache_is_expired(entry, tier->cache_ttl);
+}
+
+/* the key and cache (NULL for the shared cache) a request for path is
+ * looked up in: the first that holds the pre-compressed variant, then the
+ * file itself, trying the shared cache, memory and a mapping in turn. The
+ * caches are only peeked, so the lookup that follows is the one hit or
+ * miss the request counts. On a miss it is where the answer will be
+ * cached, as far as the open-file cache knows the file. Returns 0 when
+ * there is no cache to look in */
+static int static_cache_probe(uvhttp_static_context_t* ctx, const char* path,
+                              int accepts_gzip, char* key, size_t key_size,
+                              cache_manager_t** owner) {
+    const uvhttp_open_file_t* file = NULL;
+    char file_key[UVHTTP_MAX_FILE_PATH_SIZE];
+    int len = snprintf(file_key, sizeof(file_key), "%s%s",
+                       ctx->config.root_directory, path);
+    if (ctx->open_files && len > 0 && (size_t)len < sizeof(file_key)) {
+        file = uvhttp_open_file_cache_peek(ctx->open_files, file_key);
+        if (file && file->negative) {
+            file = NULL;
+        }
+    }
+    /* known to have no pre-compressed file: not worth a probe */
+    int gzip = accepts_gzip && (!file || file->has_gz != 0);
+
+    cache_manager_t* tiers[3] = {NULL, ctx->cache, ctx->mapped};
+    int first = ctx->shared ? 0 : 1;
+    for (int k = gzip ? 0 : 1; k < 2; k++) {
+        snprintf(key, key_size, k == 0 ? "%s.gz" : "%s", path);
+        for (int i = first; i < 3; i++) {
+            if ((i == 0 || tiers[i]) &&
+                static_cache_holds(ctx, tiers[i], key)) {
+                *owner = tiers[i];
+                return 1;
+            }
+        }
+    }
+
+    /* a miss: where the file will be kept */
+    int gz = gzip && file && file->has_gz == 1;
+    size_t size = file ? (gz ? file->gz_size : file->size) : 0;
+    snprintf(key, key_size, gz ? "%s.gz" : "%s", path);
+    if (size > UVHTTP_SENDFILE_MIN_FILE_SIZE && ctx->mapped) {
+        *owner = ctx->mapped;
+        return 1;
+    }
+    for (int i = first; i < 3; i++) {
+        if (i == 0 || tiers[i]) {
+            *owner = tiers[i];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * main function to process static file request
+ */
+uvhttp_result_t uvhttp_static_handle_request(uvhttp_static_context_t* ctx,
+                                             void* request, void* response) {
+    return uvhttp_static_serve(ctx, request, response, NULL);
+}
+
+uvhttp_result_t uvhttp_static_serve(uvhttp_static_context_t* ctx,
+                                    void* request, void* response,
+                                    uvhttp_request_handler_t fallback) {
+    if (!ctx || !request || !response) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    const char* url = uvhttp_request_get_url(request);
+    if (!url) {
+        uvhttp_response_set_status(response, 400);
+        return UVHTTP_ERROR_MALFORMED_REQUEST;
+    }
+
+    /* parse URL path, remove query parameters */
+    char clean_path[UVHTTP_MAX_PATH_SIZE];
+    const char* query_start = strchr(url, '?');
+    size_t path_len = query_start ? (size_t)(query_start - url) : strlen(url);
+
+    if (path_len >= sizeof(clean_path)) {
+        static_send_status(response, 414, "URI Too Long");
         return UVHTTP_OK;
     }
 
-    /* add to cache */
-    if (uvhttp_lru_cache_put(ctx->cache, safe_path, file_content, file_size,
-                             mime_type, last_modified, etag) != 0) {
-        /* cache add failure, but still need to return content */
-        uvhttp_log_safe_error(0, "static_cache", "Failed to cache file");
+    /* use safe string copy */
+    memcpy(clean_path, url, path_len);
+    clean_path[path_len] = '\0';
+
+    /* process root path */
+    if (strcmp(clean_path, "/") == 0) {
+        /* index_file must keep the leading '/' — uvhttp_validate_url_path()
+         * rejects paths that do not start with '/' */
+        char buf[UVHTTP_MAX_PATH_SIZE];
+        if (uvhttp_safe_strncpy(buf, ctx->config.index_file, sizeof(buf)) ==
+            0) {
+            if (buf[0] == '/') {
+                uvhttp_safe_strncpy(clean_path, buf, sizeof(clean_path));
+            } else {
+                size_t blen = strlen(buf);
+                if (blen + 1 >= sizeof(clean_path)) {
+                    blen = sizeof(clean_path) - 2; /* keep room for '/' + NUL */
+                }
+                clean_path[0] = '/';
+                memcpy(clean_path + 1, buf, blen);
+                clean_path[blen + 1] = '\0';
+            }
+        } else {
+            /* index_file too long, use default value */
+            uvhttp_safe_strncpy(clean_path, "/index.html",
+                                sizeof(clean_path));
+        }
     }
 
-    /* sendresponse */
-    uvhttp_static_set_response_headers(response, safe_path, file_size,
-                                       last_modified, etag);
-    uvhttp_response_set_body(response, file_content, file_size);
-    uvhttp_response_set_status(response, 200);
-    uvhttp_response_send(response);
+    if (!uvhttp_validate_url_path(clean_path)) {
+        static_not_found(request, response, fallback);
+        return UVHTTP_OK;
+    }
 
-    /* cache_put and response_set_body both copy the content, so the
-     * read_file_content buffer is owned by this function */
-    uvhttp_free(file_content);
+    /* checkcache — keyed by URL path, so a hit needs no file system call;
+     * the pre-compressed variant of a file is cached under "<path>.gz" */
+    int accepts_gzip =
+        static_accepts_gzip(request) && !static_wants_range(request);
+    char key[UVHTTP_MAX_PATH_SIZE + 3];
+    cache_manager_t* owner = NULL;
+    if (static_cache_probe(ctx, clean_path, accepts_gzip, key, sizeof(key),
+                           &owner)) {
+        uvhttp_cache_hit_t hit;
+        int found = 0;
+        if (!owner) {
+            found = uvhttp_shared_cache_get(ctx->shared, key, &hit) ==
+                    UVHTTP_OK;
+        } else {
+            cache_entry_t* cache_entry = uvhttp_lru_cache_find(owner, key);
+            if (cache_entry) {
+                uvhttp_cache_hit_init(&hit, cache_entry);
+                found = 1;
+            }
+        }
+        if (found) {
+            /* send response from cache */
+            static_send_hit(ctx, owner, key, request, response, &hit);
+            uvhttp_cache_hit_release(&hit);
+            return UVHTTP_OK;
+        }
+    }
 
-    return 0;
+    /* cache miss: the file is found and read on the thread pool */
+    return static_op_serve(ctx, request, response, clean_path, accepts_gzip,
+                           fallback);
 }
 
 /**
  * cleanfilecache
  */
 void uvhttp_static_clear_cache(uvhttp_static_context_t* ctx) {
-    if (!ctx || !ctx->cache)
+    if (!ctx)
+        return;
+
+    uvhttp_open_file_cache_clear(ctx->open_files);
+    if (ctx->cache)
+        uvhttp_lru_cache_clear(ctx->cache);
+    if (ctx->mapped)
+        uvhttp_lru_cache_clear(ctx->mapped);
+    if (ctx->shared)
+        uvhttp_shared_cache_clear(ctx->shared);
+}
+
+uvhttp_error_t uvhttp_static_set_shared_cache(uvhttp_static_context_t* ctx,
+                                              uvhttp_shared_cache_t* shared) {
+    if (!ctx) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    ctx->shared = shared;
+    return UVHTTP_OK;
+}
+
+void uvhttp_static_get_mapped_stats(uvhttp_static_context_t* ctx,
+                                    size_t* mapped_bytes, int* entry_count,
+                                    int* hit_count) {
+    if (!ctx || !ctx->mapped) {
+        if (mapped_bytes)
+            *mapped_bytes = 0;
+        if (entry_count)
+            *entry_count = 0;
+        if (hit_count)
+            *hit_count = 0;
         return;
+    }
 
-    uvhttp_lru_cache_clear(ctx->cache);
+    uvhttp_lru_cache_get_stats(ctx->mapped, mapped_bytes, entry_count,
+                               hit_count, NULL, NULL);
+}
+
+void uvhttp_static_get_open_file_stats(uvhttp_static_context_t* ctx,
+                                       uvhttp_open_file_cache_stats_t* stats) {
+    uvhttp_open_file_cache_get_stats(ctx ? ctx->open_files : NULL, stats);
 }
 
 /**
@@ -1316,6 +2084,12 @@ void uvhttp_static_get_cache_stats(uvhttp_static_context_t* ctx,
         return;
     }
 
+    if (ctx->shared) {
+        uvhttp_shared_cache_get_stats(ctx->shared, total_memory_usage,
+                                      entry_count, hit_count, miss_count,
+                                      eviction_count);
+        return;
+    }
     uvhttp_lru_cache_get_stats(ctx->cache, total_memory_usage, entry_count,
                                hit_count, miss_count, eviction_count);
 }
@@ -1331,8 +2105,8 @@ double uvhttp_static_get_cache_hit_rate(uvhttp_static_context_t* ctx) {
     size_t total_memory_usage;
     int entry_count, hit_count, miss_count, eviction_count;
 
-    uvhttp_lru_cache_get_stats(ctx->cache, &total_memory_usage, &entry_count,
-                               &hit_count, &miss_count, &eviction_count);
+    uvhttp_static_get_cache_stats(ctx, &total_memory_usage, &entry_count,
+                                  &hit_count, &miss_count, &eviction_count);
 
     if (hit_count + miss_count == 0) {
         return 0.0;
@@ -1349,6 +2123,9 @@ int uvhttp_static_cleanup_expired_cache(uvhttp_static_context_t* ctx) {
         return 0;
     }
 
+    if (ctx->shared) {
+        return uvhttp_shared_cache_cleanup_expired(ctx->shared);
+    }
     return uvhttp_lru_cache_cleanup_expired(ctx->cache);
 }
 
@@ -1360,6 +2137,75 @@ int uvhttp_static_cleanup_expired_cache(uvhttp_static_context_t* ctx) {
 
  */
 
+/* the cache key of file_path, relative to the root: the URL path requests
+ * look it up by ("/" first, no empty or "." segments; "" for the root).
+ * Returns 0 if it does not fit */
+static int static_prewarm_key(const char* file_path, char* key, size_t size) {
+    size_t len = 0;
+    const char* p = file_path;
+    while (*p) {
+        while (*p == '/') {
+            p++;
+        }
+        const char* segment = p;
+        while (*p && *p != '/') {
+            p++;
+        }
+        size_t segment_len = (size_t)(p - segment);
+        if (segment_len == 0 || (segment_len == 1 && *segment == '.')) {
+            continue;
+        }
+        if (len + 1 + segment_len >= size) {
+            return 0;
+        }
+        key[len++] = '/';
+        memcpy(key + len, segment, segment_len);
+        len += segment_len;
+    }
+    key[len] = '\0';
+    return 1;
+}
+
+/* put buffer, the content of the file at key, into the cache with its
+ * encoded variants: those in variants (made already, NULL when not worth
+ * keeping), or made now when variants is NULL */
+static uvhttp_error_t static_prewarm_put(uvhttp_static_context_t* ctx,
+                                         const char* key,
+                                         uvhttp_cache_buffer_t* buffer,
+                                         time_t last_modified,
+                                         uvhttp_cache_buffer_t** variants) {
+    char mime_type[UVHTTP_MAX_HEADER_VALUE_SIZE];
+    uvhttp_static_get_mime_type(key, mime_type, sizeof(mime_type));
+    char etag[UVHTTP_MAX_HEADER_VALUE_SIZE];
+    uvhttp_static_generate_etag(key, last_modified, buffer->length, etag,
+                                sizeof(etag));
+
+    uvhttp_error_t result =
+        ctx->shared
+            ? uvhttp_shared_cache_put_buffer(ctx->shared, key, buffer,
+                                             mime_type, last_modified, etag)
+            : uvhttp_lru_cache_put_buffer(ctx->cache, key, buffer,
+                                          mime_type, last_modified, etag);
+#    if UVHTTP_FEATURE_COMPRESSION
+    /* variants are made now rather than on the first hits */
+    cache_manager_t* owner = ctx->shared ? NULL : ctx->cache;
+    if (result == UVHTTP_OK && !variants) {
+        static_encode_now(ctx, owner, key, buffer, mime_type);
+    } else if (result == UVHTTP_OK) {
+        for (int i = 0; i < UVHTTP_CACHE_ENCODING_COUNT; i++) {
+            uvhttp_cache_encoding_t encoding = (uvhttp_cache_encoding_t)i;
+            if (static_claim_variant(ctx, owner, key, buffer, encoding)) {
+                static_keep_variant(ctx, owner, key, buffer, encoding,
+                                    variants[i]);
+            }
+        }
+    }
+#    else
+    (void)variants;
+#    endif
+    return result;
+}
+
 uvhttp_result_t uvhttp_static_prewarm_cache(uvhttp_static_context_t* ctx,
 
                                             const char* file_path) {
@@ -1406,22 +2252,26 @@ uvhttp_result_t uvhttp_static_prewarm_cache(uvhttp_static_context_t* ctx,
         return UVHTTP_ERROR_SERVER_INIT;
     }
 
-    /* getMIMEtype */
-    char mime_type[UVHTTP_MAX_HEADER_VALUE_SIZE];
-    uvhttp_static_get_mime_type(full_path, mime_type, sizeof(mime_type));
-
-    /* generateETag */
-    char etag[UVHTTP_MAX_HEADER_VALUE_SIZE];
-    uvhttp_static_generate_etag(full_path, last_modified, file_size, etag,
-                                sizeof(etag));
-
-    /* add to cache */
-    uvhttp_error_t cache_result =
-        uvhttp_lru_cache_put(ctx->cache, full_path, file_content, file_size,
-                             mime_type, last_modified, etag);
-    if (cache_result != UVHTTP_OK) {
-        UVHTTP_LOG_WARN("Failed to cache file for prewarming: %s", file_path);
+    /* add to cache, under the URL path requests look it up by */
+    char cache_key[UVHTTP_MAX_FILE_PATH_SIZE];
+    if (!static_prewarm_key(file_path, cache_key, sizeof(cache_key))) {
         uvhttp_free(file_content);
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    uvhttp_cache_buffer_t* buffer = uvhttp_cache_buffer_create(file_size);
+    if (!buffer) {
+        uvhttp_free(file_content);
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    memcpy(buffer->data, file_content, file_size);
+    uvhttp_free(file_content);
+
+    uvhttp_error_t cache_result =
+        static_prewarm_put(ctx, cache_key, buffer, last_modified, NULL);
+    uvhttp_cache_buffer_release(buffer);
+    if (cache_result != UVHTTP_OK) {
+        UVHTTP_LOG_WARN("Failed to cache file for prewarming: %s", file_path);
         return cache_result;
     }
 
@@ -1515,6 +2365,356 @@ int uvhttp_static_prewarm_directory(uvhttp_static_context_t* ctx,
     return prewarmed_count;
 }
 
+/* ============ asynchronous cache prewarm ============ */
+
+struct static_prewarm;
+
+/* A directory to enumerate */
+typedef struct static_prewarm_dir {
+    uv_fs_t req;
+    struct static_prewarm* prewarm;
+    struct static_prewarm_dir* next;
+    int top;     /* the directory asked for */
+    char key[1]; /* allocated to fit; "" for the root */
+} static_prewarm_dir_t;
+
+/* A file to read on the thread pool, then put into the cache */
+typedef struct static_prewarm_file {
+    uv_work_t work;
+    struct static_prewarm* prewarm;
+    struct static_prewarm_file* next;
+    uvhttp_cache_buffer_t* buffer; /* the content, once read */
+    time_t last_modified;
+    uvhttp_error_t result;
+#    if UVHTTP_FEATURE_COMPRESSION
+    int encoded; /* variants made (each NULL when not worth keeping) */
+    uvhttp_cache_buffer_t* variants[UVHTTP_CACHE_ENCODING_COUNT];
+#    endif
+    char key[1]; /* allocated to fit */
+} static_prewarm_file_t;
+
+typedef struct static_prewarm {
+    uvhttp_static_context_t* ctx;
+    uv_loop_t* loop;
+    uvhttp_static_prewarm_cb on_done;
+    void* data;
+    static_prewarm_dir_t* dirs;   /* found, not enumerated yet */
+    static_prewarm_file_t* files; /* found, not read yet, in order */
+    static_prewarm_file_t* files_tail;
+    int found;     /* files found so far */
+    int max_files; /* 0 = no limit */
+    int running;   /* enumerations and reads in flight */
+    uvhttp_error_t status;
+    uint64_t start;
+    uvhttp_static_prewarm_stats_t stats;
+} static_prewarm_t;
+
+static void static_prewarm_next(static_prewarm_t* prewarm);
+
+static int static_prewarm_full(const static_prewarm_t* prewarm) {
+    return prewarm->max_files > 0 && prewarm->found >= prewarm->max_files;
+}
+
+/* queue what dirent names in the directory at dir */
+static void static_prewarm_found(static_prewarm_t* prewarm, const char* dir,
+                                 const uv_dirent_t* dirent) {
+    if (dirent->type != UV_DIRENT_FILE && dirent->type != UV_DIRENT_DIR &&
+        dirent->type != UV_DIRENT_LINK && dirent->type != UV_DIRENT_UNKNOWN) {
+        prewarm->stats.skipped++; /* fifos, sockets, devices */
+        return;
+    }
+    size_t key_len = strlen(dir) + 1 + strlen(dirent->name);
+    if (key_len >= UVHTTP_MAX_FILE_PATH_SIZE) {
+        prewarm->stats.failed++;
+        return;
+    }
+    if (dirent->type == UV_DIRENT_DIR) {
+        static_prewarm_dir_t* child =
+            uvhttp_alloc(sizeof(static_prewarm_dir_t) + key_len);
+        if (!child) {
+            prewarm->stats.failed++;
+            return;
+        }
+        memset(child, 0, sizeof(static_prewarm_dir_t));
+        child->prewarm = prewarm;
+        snprintf(child->key, key_len + 1, "%s/%s", dir, dirent->name);
+        child->next = prewarm->dirs;
+        prewarm->dirs = child;
+        return;
+    }
+    /* files, and links or entries of unknown type: the read tells */
+    static_prewarm_file_t* file =
+        uvhttp_alloc(sizeof(static_prewarm_file_t) + key_len);
+    if (!file) {
+        prewarm->stats.failed++;
+        return;
+    }
+    memset(file, 0, sizeof(static_prewarm_file_t));
+    file->work.data = file;
+    file->prewarm = prewarm;
+    snprintf(file->key, key_len + 1, "%s/%s", dir, dirent->name);
+    if (prewarm->files_tail) {
+        prewarm->files_tail->next = file;
+    } else {
+        prewarm->files = file;
+    }
+    prewarm->files_tail = file;
+    prewarm->found++;
+}
+
+static void static_prewarm_on_scan(uv_fs_t* req) {
+    static_prewarm_dir_t* dir = (static_prewarm_dir_t*)req->data;
+    static_prewarm_t* prewarm = dir->prewarm;
+    prewarm->running--;
+    if (req->result < 0) {
+        if (dir->top) {
+            prewarm->status = UVHTTP_ERROR_NOT_FOUND;
+        } else {
+            prewarm->stats.failed++;
+        }
+    } else {
+        prewarm->stats.directories++;
+        uv_dirent_t dirent;
+        while (!prewarm->ctx->freed && !static_prewarm_full(prewarm) &&
+               uv_fs_scandir_next(req, &dirent) != UV_EOF) {
+            static_prewarm_found(prewarm, dir->key, &dirent);
+        }
+    }
+    uv_fs_req_cleanup(req);
+    uvhttp_free(dir);
+    static_prewarm_next(prewarm);
+}
+
+static int static_prewarm_scan(static_prewarm_t* prewarm,
+                               static_prewarm_dir_t* dir) {
+    char path[UVHTTP_MAX_FILE_PATH_SIZE];
+    int len = snprintf(path, sizeof(path), "%s%s",
+                       prewarm->ctx->config.root_directory, dir->key);
+    if (len < 0 || (size_t)len >= sizeof(path)) {
+        return UV_ENAMETOOLONG;
+    }
+    dir->req.data = dir;
+    return uv_fs_scandir(prewarm->loop, &dir->req, path, 0,
+                         static_prewarm_on_scan);
+}
+
+/* on the thread pool: read the file, and encode it as prewarming does */
+static void static_prewarm_read(uv_work_t* work) {
+    static_prewarm_file_t* file = (static_prewarm_file_t*)work->data;
+    uvhttp_static_context_t* ctx = file->prewarm->ctx;
+    char path[UVHTTP_MAX_FILE_PATH_SIZE];
+    int len = snprintf(path, sizeof(path), "%s%s", ctx->config.root_directory,
+                       file->key);
+    if (len < 0 || (size_t)len >= sizeof(path)) {
+        file->result = UVHTTP_ERROR_INVALID_PARAM;
+        return;
+    }
+    /* a link may name a fifo: never wait for a writer */
+    int fd = open(path, O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+    if (fd < 0) {
+        file->result = UVHTTP_ERROR_IO_ERROR;
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        file->result = UVHTTP_ERROR_IO_ERROR;
+    } else if (!S_ISREG(st.st_mode)) {
+        file->result = UVHTTP_ERROR_NOT_FOUND;
+    } else if ((size_t)st.st_size > ctx->config.max_file_size) {
+        file->result = UVHTTP_ERROR_FILE_TOO_LARGE;
+    } else if (!(file->buffer =
+                     uvhttp_cache_buffer_create((size_t)st.st_size))) {
+        file->result = UVHTTP_ERROR_OUT_OF_MEMORY;
+    } else {
+        size_t done = 0;
+        while (done < file->buffer->length) {
+            ssize_t n = pread(fd, file->buffer->data + done,
+                              file->buffer->length - done, (off_t)done);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                break;
+            }
+            done += (size_t)n;
+        }
+        if (done == file->buffer->length) {
+            file->last_modified = st.st_mtime;
+            file->result = UVHTTP_OK;
+        } else {
+            /* truncated while read */
+            uvhttp_cache_buffer_release(file->buffer);
+            file->buffer = NULL;
+            file->result = UVHTTP_ERROR_IO_ERROR;
+        }
+    }
+    close(fd);
+
+#    if UVHTTP_FEATURE_COMPRESSION
+    char mime_type[UVHTTP_MAX_HEADER_VALUE_SIZE];
+    if (file->buffer &&
+        uvhttp_static_get_mime_type(file->key, mime_type,
+                                    sizeof(mime_type)) == UVHTTP_OK &&
+        static_encodable(ctx, mime_type, file->buffer->length)) {
+        for (int i = 0; i < UVHTTP_CACHE_ENCODING_COUNT; i++) {
+            file->variants[i] =
+                static_encode((uvhttp_cache_encoding_t)i, file->buffer);
+        }
+        file->encoded = 1;
+    }
+#    endif
+}
+
+static void static_prewarm_read_done(uv_work_t* work, int status) {
+    static_prewarm_file_t* file = (static_prewarm_file_t*)work->data;
+    static_prewarm_t* prewarm = file->prewarm;
+    uvhttp_static_context_t* ctx = prewarm->ctx;
+    prewarm->running--;
+
+    uvhttp_cache_buffer_t** variants = NULL;
+#    if UVHTTP_FEATURE_COMPRESSION
+    variants = file->encoded ? file->variants : NULL;
+#    endif
+    if (ctx->freed) {
+        /* counted no more */
+    } else if (status != 0) {
+        prewarm->stats.failed++;
+    } else if (file->result == UVHTTP_ERROR_NOT_FOUND ||
+               file->result == UVHTTP_ERROR_FILE_TOO_LARGE) {
+        prewarm->stats.skipped++;
+    } else if (file->result != UVHTTP_OK ||
+               static_prewarm_put(ctx, file->key, file->buffer,
+                                  file->last_modified,
+                                  variants) != UVHTTP_OK) {
+        prewarm->stats.failed++;
+    } else {
+        prewarm->stats.files++;
+        prewarm->stats.bytes += file->buffer->length;
+    }
+
+    uvhttp_cache_buffer_release(file->buffer);
+#    if UVHTTP_FEATURE_COMPRESSION
+    for (int i = 0; i < UVHTTP_CACHE_ENCODING_COUNT; i++) {
+        uvhttp_cache_buffer_release(file->variants[i]);
+    }
+#    endif
+    uvhttp_free(file);
+    static_prewarm_next(prewarm);
+}
+
+/* everything found is read: report, and let go of the context */
+static void static_prewarm_finish(static_prewarm_t* prewarm) {
+    uvhttp_static_context_t* ctx = prewarm->ctx;
+    while (prewarm->dirs) {
+        static_prewarm_dir_t* dir = prewarm->dirs;
+        prewarm->dirs = dir->next;
+        uvhttp_free(dir);
+    }
+    while (prewarm->files) {
+        static_prewarm_file_t* file = prewarm->files;
+        prewarm->files = file->next;
+        uvhttp_free(file);
+    }
+
+    prewarm->stats.elapsed_ms = (uv_hrtime() - prewarm->start) / 1000000;
+    uvhttp_error_t status =
+        ctx->freed ? UVHTTP_ERROR_CANCELLED : prewarm->status;
+    UVHTTP_LOG_INFO("Prewarmed %d files (%zu bytes) in %llu ms",
+                    prewarm->stats.files, prewarm->stats.bytes,
+                    (unsigned long long)prewarm->stats.elapsed_ms);
+    if (prewarm->on_done) {
+        prewarm->on_done(ctx, status, &prewarm->stats, prewarm->data);
+    }
+    uvhttp_free(prewarm);
+
+    ctx->fs_pending--;
+    if (ctx->freed && ctx->fs_pending == 0) {
+        static_context_destroy(ctx);
+    }
+}
+
+/* start reading files, then enumerating directories, up to the context's
+ * in-flight limit; files first, so that few wait at a time */
+static void static_prewarm_next(static_prewarm_t* prewarm) {
+    uvhttp_static_context_t* ctx = prewarm->ctx;
+    int limit = static_op_max_inflight(ctx);
+    while (!ctx->freed && prewarm->running < limit) {
+        if (prewarm->files) {
+            static_prewarm_file_t* file = prewarm->files;
+            prewarm->files = file->next;
+            if (!prewarm->files) {
+                prewarm->files_tail = NULL;
+            }
+            if (uv_queue_work(prewarm->loop, &file->work, static_prewarm_read,
+                              static_prewarm_read_done) == 0) {
+                prewarm->running++;
+            } else {
+                prewarm->stats.failed++;
+                uvhttp_free(file);
+            }
+        } else if (prewarm->dirs && !static_prewarm_full(prewarm)) {
+            static_prewarm_dir_t* dir = prewarm->dirs;
+            prewarm->dirs = dir->next;
+            if (static_prewarm_scan(prewarm, dir) == 0) {
+                prewarm->running++;
+            } else {
+                prewarm->stats.failed++;
+                uvhttp_free(dir);
+            }
+        } else {
+            break;
+        }
+    }
+    if (prewarm->running == 0) {
+        static_prewarm_finish(prewarm);
+    }
+}
+
+uvhttp_error_t uvhttp_static_prewarm_directory_async(
+    uvhttp_static_context_t* ctx, uv_loop_t* loop, const char* dir_path,
+    int max_files, uvhttp_static_prewarm_cb on_done, void* data) {
+    if (!ctx || !loop || !dir_path || ctx->freed ||
+        (!ctx->cache && !ctx->shared)) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    char key[UVHTTP_MAX_FILE_PATH_SIZE];
+    if (!static_prewarm_key(dir_path, key, sizeof(key))) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    size_t key_len = strlen(key);
+    static_prewarm_t* prewarm = uvhttp_alloc(sizeof(static_prewarm_t));
+    static_prewarm_dir_t* dir =
+        uvhttp_alloc(sizeof(static_prewarm_dir_t) + key_len);
+    if (!prewarm || !dir) {
+        uvhttp_free(prewarm);
+        uvhttp_free(dir);
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    memset(prewarm, 0, sizeof(static_prewarm_t));
+    prewarm->ctx = ctx;
+    prewarm->loop = loop;
+    prewarm->on_done = on_done;
+    prewarm->data = data;
+    prewarm->max_files = max_files > 0 ? max_files : 0;
+    prewarm->status = UVHTTP_OK;
+    prewarm->start = uv_hrtime();
+    memset(dir, 0, sizeof(static_prewarm_dir_t));
+    dir->prewarm = prewarm;
+    dir->top = 1;
+    memcpy(dir->key, key, key_len + 1);
+
+    if (static_prewarm_scan(prewarm, dir) != 0) {
+        uvhttp_free(dir);
+        uvhttp_free(prewarm);
+        return UVHTTP_ERROR_IO_ERROR;
+    }
+    prewarm->running = 1;
+    /* holds ctx like a cache miss */
+    ctx->fs_pending++;
+    return UVHTTP_OK;
+}
+
 /* ============ zero-copy optimization: sendfile implementation ============ */
 
 /* sendfile contextstructure */
@@ -1812,343 +3012,1093 @@ uvhttp_error_t uvhttp_static_set_cache_config(uvhttp_static_context_t* ctx,
     return UVHTTP_OK;
 }
 
-/* internal function: sendfile with config */
-static uvhttp_result_t uvhttp_static_sendfile_with_config(
-    const char* file_path, void* response,
-    const uvhttp_static_config_t* config) {
-    uvhttp_response_t* resp = (uvhttp_response_t*)response;
+/**
+ * start sending length bytes of in_fd, from offset on, to the client of resp
+ * with chunked async sendfile; resp's status and headers are set by the
+ * caller and go out first. Once they are out (resp->headers_sent), in_fd belongs to the
+ * transfer, which closes it; before that, on failure, in_fd is still the
+ * caller's.
+ */
+static uvhttp_result_t sendfile_start(uvhttp_response_t* resp, uv_file in_fd,
+                                      const char* file_path, size_t offset,
+                                      size_t length,
+                                      const uvhttp_static_config_t* config) {
+    UVHTTP_LOG_DEBUG("Using chunked async sendfile: %s (%zu bytes at %zu)",
+                     file_path, length, offset);
 
-    /* getfilesize */
-    struct stat st;
-    if (stat(file_path, &st) != 0) {
-        UVHTTP_LOG_ERROR("Failed to stat file: %s", file_path);
-        return UVHTTP_ERROR_NOT_FOUND;
+    /* getevent loop */
+    uv_loop_t* loop = uv_handle_get_loop((uv_handle_t*)resp->client);
+
+    /* create sendfile context */
+    sendfile_context_t* ctx =
+        (sendfile_context_t*)uvhttp_alloc(sizeof(sendfile_context_t));
+    if (!ctx) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
     }
 
-    size_t file_size = (size_t)st.st_size;
+    memset(ctx, 0, sizeof(sendfile_context_t));
+    ctx->response = resp;
+    ctx->loop = loop;
+    ctx->in_fd = in_fd;
+    ctx->file_size = offset + length; /* where the transfer stops */
+    ctx->offset = (int64_t)offset;
+    ctx->bytes_sent = 0;
+    ctx->completed = 0;
+    ctx->start_time = uv_now(loop);
+    ctx->retry_count = 0;
+    ctx->cork_enabled = 0;        /* initialize as disabled */
+    ctx->sendfile_req.data = ctx; /* setcallbackdata */
+    ctx->close_req.data = ctx;    /* on_file_close releases ctx via this */
+
+    /* initializeconfigparameter */
+    init_sendfile_config(ctx, length, config);
+
+    /* allocatefilepathmemory */
+    size_t path_len = strlen(file_path);
+    ctx->file_path = (char*)uvhttp_alloc(path_len + 1);
+    if (!ctx->file_path) {
+        uvhttp_free(ctx);
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    memcpy(ctx->file_path, file_path, path_len);
+    ctx->file_path[path_len] = '\0';
+
+    /* get output file descriptor */
+    int fd_result = uv_fileno((uv_handle_t*)resp->client, &ctx->out_fd);
+    if (fd_result < 0) {
+        UVHTTP_LOG_ERROR("Failed to get client fd: %s",
+                         uv_strerror(fd_result));
+        uvhttp_free(ctx->file_path);
+        uvhttp_free(ctx);
+        return UVHTTP_ERROR_SERVER_INIT;
+    }
+
+    /* build response header data */
+    char* header_data = NULL;
+    size_t header_length = 0;
+    uvhttp_error_t build_result =
+        uvhttp_response_build_data(resp, &header_data, &header_length);
+    if (build_result != UVHTTP_OK) {
+        UVHTTP_LOG_ERROR("Failed to build response headers: %s",
+                         uvhttp_error_string(build_result));
+        uvhttp_free(ctx->file_path);
+        uvhttp_free(ctx);
+        return build_result;
+    }
+
+    /* send response headers (using send_raw, don't mark response as
+     * complete) */
+    uvhttp_error_t send_result = uvhttp_response_send_raw(
+        header_data, header_length, resp->client, resp);
+    uvhttp_free(header_data); /* release built response header data */
+
+    if (send_result != UVHTTP_OK) {
+        UVHTTP_LOG_ERROR("Failed to send response headers: %s",
+                         uvhttp_error_string(send_result));
+        uvhttp_free(ctx->file_path);
+        uvhttp_free(ctx);
+        return send_result;
+    }
+    resp->headers_sent = 1;
+    resp->sent = 1;
+
+    /* performance optimization: enable TCP_CORK to optimize large file
+     * transmission */
+    int cork = 1;
+    setsockopt(ctx->out_fd, IPPROTO_TCP, TCP_CORK, &cork, sizeof(cork));
+    ctx->cork_enabled = 1;
+
+    /* initialize timeout timer */
+    int timer_result = uv_timer_init(loop, &ctx->timeout_timer);
+    if (timer_result != 0) {
+        UVHTTP_LOG_ERROR("Failed to init timeout timer: %s",
+                         uv_strerror(timer_result));
+        uv_fs_close(loop, &ctx->close_req, ctx->in_fd, on_file_close);
+        return UVHTTP_ERROR_SERVER_INIT;
+    }
+    ctx->timeout_timer.data = ctx;
+
+    /* start chunked sendfile (send config's chunk size each time) */
+    size_t chunk_size = length < ctx->chunk_size ? length : ctx->chunk_size;
+
+    uv_timer_start(&ctx->timeout_timer, on_sendfile_timeout, ctx->timeout_ms,
+                   0);
+
+    int sendfile_result =
+        uv_fs_sendfile(loop, &ctx->sendfile_req, ctx->out_fd, ctx->in_fd,
+                       ctx->offset, chunk_size, on_sendfile_complete);
+
+    /* check if sendfile failed synchronously */
+    if (sendfile_result < 0) {
+        UVHTTP_LOG_ERROR("Failed to start sendfile: %s",
+                         uv_strerror(sendfile_result));
+        /* clean resources */
+        uv_timer_stop(&ctx->timeout_timer);
+        uv_close((uv_handle_t*)&ctx->timeout_timer, NULL);
+        /* on_file_close (close_req.data == ctx) frees file_path + ctx */
+        uv_fs_close(loop, &ctx->close_req, ctx->in_fd, on_file_close);
+        return UVHTTP_ERROR_RESPONSE_SEND;
+    }
+
+    return UVHTTP_OK;
+}
+
+/* ============ cache misses: uv_fs_* off the loop thread ============ */
+
+/*
+ * A cache miss is answered by a chain of uv_fs requests, each started from
+ * the callback of the one before:
+ *
+ *   realpath (of the root, once) -> realpath -> stat [-> stat index]
+ *     [-> stat .gz] -> open -> read (<= 64KB, then cached)
+ *                              | sendfile | chunked read/write (TLS)
+ *     -> close
+ *
+ * A context runs at most max_inflight_fs of these chains at a time, so a
+ * burst of misses cannot take every thread of the pool (which libuv shares
+ * with DNS and user work); the others wait in arrival order.
+ *
+ * What the realpath and stat steps find is kept in the open-file cache,
+ * keyed by the requested path: a repeated miss for a missing file is
+ * answered at once, one for an existing file starts at open (or, with the
+ * descriptor kept for a large file, at sendfile).
+ */
+
+typedef enum {
+    STATIC_OP_ROOT,
+    STATIC_OP_REALPATH,
+    STATIC_OP_STAT,
+    STATIC_OP_STAT_INDEX,
+    STATIC_OP_STAT_GZIP,
+    STATIC_OP_OPEN,
+    STATIC_OP_READ,
+    STATIC_OP_CHUNK,
+    STATIC_OP_CLOSE
+} static_op_state_t;
+
+struct uvhttp_static_op {
+    uv_fs_t fs;
+    uv_work_t work;                /* listing or mapping, on the pool */
+    uv_write_t write;              /* of a chunk, from buffer */
+    uv_loop_t* loop;
+    uvhttp_static_context_t* ctx;  /* NULL for uvhttp_static_sendfile */
+    uvhttp_request_t* request;     /* NULL once cancelled */
+    uvhttp_response_t* response;   /* NULL once cancelled */
+    uvhttp_connection_t* conn;     /* conn->static_op == this op */
+    uvhttp_request_handler_t fallback;
+    uvhttp_static_op_t* next;      /* while waiting for a slot */
+    static_op_state_t state;
+    uv_file fd;                    /* -1 while not open */
+    int accepts_gzip;
+    int gzip;                      /* path is the .gz variant */
+    int cached;                    /* path, size and mtime from open_files */
+    size_t dir_len;                /* of path, while looking for the index */
+    size_t file_size;
+    time_t last_modified;
+    size_t offset;
+    size_t range_end;              /* of the range being read in chunks */
+    uvhttp_static_range_t ranges[UVHTTP_STATIC_MAX_RANGES];
+    int range_count;               /* 0: the whole file */
+    int range_index;               /* range being read in chunks */
+    char boundary[STATIC_BOUNDARY_SIZE]; /* multipart/byteranges, or "" */
+    char* buffer;
+    char* listing;
+    uvhttp_cache_buffer_t* mapping; /* the file, mapped on the pool */
+    char etag[64]; /* "<size>-<mtime>" */
+    char url_path[UVHTTP_MAX_PATH_SIZE]; /* cache key */
+    char path[UVHTTP_MAX_FILE_PATH_SIZE];
+};
+
+static void static_op_on_fs(uv_fs_t* req);
+static void static_op_run(uvhttp_static_op_t* op);
+static void static_op_on_file(uvhttp_static_op_t* op, const uv_stat_t* st);
+static void static_op_open(uvhttp_static_op_t* op);
+
+static int static_op_max_inflight(const uvhttp_static_context_t* ctx) {
+    return ctx->config.max_inflight_fs > 0 ? ctx->config.max_inflight_fs
+                                           : UVHTTP_STATIC_MAX_INFLIGHT_FS;
+}
+
+/* the open-file cache key of op: the path before realpath */
+static int static_op_key(const uvhttp_static_op_t* op, char* key,
+                         size_t size) {
+    int len = snprintf(key, size, "%s%s", op->ctx->config.root_directory,
+                       op->url_path);
+    return len > 0 && (size_t)len < size;
+}
 
-    /* strategy selection */
-    if (file_size < UVHTTP_STATIC_SMALL_FILE_THRESHOLD) {
-        /* small file: use optimized system call (open + read + close), avoid
-         * stdio overhead */
-        UVHTTP_LOG_DEBUG(
-            "Small file detected, using optimized I/O: %s (%zu bytes)",
-            file_path, file_size);
+/* op's open-file cache entry, if it still describes the file op resolved
+ * to (path without a ".gz" of plain_len bytes) */
+static uvhttp_open_file_t* static_op_entry(const uvhttp_static_op_t* op,
+                                           size_t plain_len) {
+    char key[UVHTTP_MAX_FILE_PATH_SIZE];
+    if (!op->ctx || !op->ctx->open_files ||
+        !static_op_key(op, key, sizeof(key))) {
+        return NULL;
+    }
+    uvhttp_open_file_t* entry =
+        uvhttp_open_file_cache_peek(op->ctx->open_files, key);
+    if (!entry || entry->negative || strlen(entry->path) != plain_len ||
+        strncmp(entry->path, op->path, plain_len) != 0) {
+        return NULL;
+    }
+    return entry;
+}
+
+static size_t static_op_plain_len(const uvhttp_static_op_t* op) {
+    return strlen(op->path) - (op->gzip ? 3 : 0);
+}
+
+/* the requested path names nothing to serve: say so next time at once */
+static void static_op_remember_missing(uvhttp_static_op_t* op) {
+    char key[UVHTTP_MAX_FILE_PATH_SIZE];
+    if (op->ctx && op->ctx->open_files && !op->ctx->freed &&
+        static_op_key(op, key, sizeof(key))) {
+        uvhttp_open_file_cache_put_negative(op->ctx->open_files, op->loop,
+                                            key);
+    }
+}
+
+/* forget the request: nothing is sent for it any more */
+static void static_op_detach(uvhttp_static_op_t* op) {
+    if (op->conn && op->conn->static_op == op) {
+        op->conn->static_op = NULL;
+    }
+    op->conn = NULL;
+    op->request = NULL;
+    op->response = NULL;
+}
 
-        /* use open() instead of fopen(), reduce system call overhead */
-        int fd = open(file_path, O_RDONLY);
-        if (fd < 0) {
-            UVHTTP_LOG_ERROR("Failed to open file: %s", file_path);
-            return UVHTTP_ERROR_NOT_FOUND;
+static void static_context_destroy(uvhttp_static_context_t* ctx) {
+    ctx->fs_pending = 0;
+    uvhttp_static_free(ctx);
+}
+
+/* op is done: give its slot to the next waiting miss */
+static void static_op_release(uvhttp_static_op_t* op) {
+    uvhttp_static_context_t* ctx = op->ctx;
+    static_op_detach(op);
+    uvhttp_free(op->buffer);
+    uvhttp_free(op->listing);
+    uvhttp_free(op);
+
+    if (!ctx) {
+        return;
+    }
+    /* ctx->fs_pending keeps holding ctx while waiting misses start (one may
+     * fail, and release, at once) */
+    ctx->fs_running--;
+    while (ctx->fs_waiting &&
+           ctx->fs_running < static_op_max_inflight(ctx)) {
+        uvhttp_static_op_t* next = ctx->fs_waiting;
+        ctx->fs_waiting = next->next;
+        if (!ctx->fs_waiting) {
+            ctx->fs_waiting_tail = NULL;
         }
+        if (next->response) {
+            static_op_run(next);
+        } else {
+            /* its connection closed while it waited */
+            ctx->fs_pending--;
+            uvhttp_free(next);
+        }
+    }
+    ctx->fs_pending--;
+    if (ctx->freed && ctx->fs_pending == 0) {
+        static_context_destroy(ctx);
+    }
+}
 
-        /* readfilecontent */
-        char* buffer = (char*)uvhttp_alloc(file_size + 1);
-        if (!buffer) {
-            close(fd);
-            return UVHTTP_ERROR_OUT_OF_MEMORY;
+/* the request is answered: close the file (if open), then release op */
+static void static_op_finish(uvhttp_static_op_t* op) {
+    static_op_detach(op);
+    if (op->fd >= 0) {
+        uv_file fd = op->fd;
+        op->fd = -1;
+        op->state = STATIC_OP_CLOSE;
+        if (uv_fs_close(op->loop, &op->fs, fd, static_op_on_fs) == 0) {
+            return;
         }
+    }
+    static_op_release(op);
+}
 
-        ssize_t bytes_read = read(fd, buffer, (size_t)file_size);
-        close(fd);
+/* the body cannot reach its Content-Length any more: close the connection
+ * too, or the client would take the next response for the rest of it */
+static void static_op_abort(uvhttp_static_op_t* op) {
+    uvhttp_connection_t* conn =
+        op->response ? (uvhttp_connection_t*)uv_handle_get_data(
+                           (uv_handle_t*)op->response->client)
+                     : NULL;
+    static_op_finish(op);
+    if (conn) {
+        uvhttp_connection_close(conn);
+    }
+}
 
-        if (bytes_read < 0) {
-            UVHTTP_LOG_ERROR("Failed to read file: %s", file_path);
-            uvhttp_free(buffer);
-            return UVHTTP_ERROR_RESPONSE_SEND;
+static void static_op_fail(uvhttp_static_op_t* op, int status,
+                           const char* message) {
+    if (status == 404) {
+        static_not_found(op->request, op->response, op->fallback);
+    } else {
+        static_send_status(op->response, status, message);
+    }
+    static_op_finish(op);
+}
+
+static void static_op_fs_error(uvhttp_static_op_t* op, int result) {
+    if (result == UV_ENOMEM) {
+        static_op_fail(op, 500, UVHTTP_MESSAGE_MEMORY_FAILED);
+    } else if (result == UV_ENOENT || result == UV_ENOTDIR ||
+               result == UV_EACCES || result == UV_ELOOP ||
+               result == UV_ENAMETOOLONG) {
+        if (op->state == STATIC_OP_REALPATH || op->state == STATIC_OP_STAT) {
+            static_op_remember_missing(op);
         }
+        static_op_fail(op, 404, NULL);
+    } else {
+        UVHTTP_LOG_ERROR("Static file %s: %s", op->path, uv_strerror(result));
+        static_op_fail(op, 500, UVHTTP_MESSAGE_FILE_READ_ERROR);
+    }
+}
 
-        /* setresponse */
-        char mime_type[UVHTTP_MAX_HEADER_VALUE_SIZE];
-        uvhttp_static_get_mime_type(file_path, mime_type, sizeof(mime_type));
+static void static_op_stat(uvhttp_static_op_t* op, static_op_state_t state) {
+    op->state = state;
+    int result = uv_fs_stat(op->loop, &op->fs, op->path, static_op_on_fs);
+    if (result < 0) {
+        static_op_fs_error(op, result);
+    }
+}
 
-        uvhttp_response_set_status(resp, 200);
-        uvhttp_response_set_header(resp, "Content-Type", mime_type);
-        uvhttp_response_set_header(resp, "Content-Length", "");
-        uvhttp_response_set_body(resp, buffer, (size_t)bytes_read);
+static void static_op_realpath(uvhttp_static_op_t* op) {
+    op->state = STATIC_OP_REALPATH;
+    int result = uv_fs_realpath(op->loop, &op->fs, op->path, static_op_on_fs);
+    if (result < 0) {
+        static_op_fs_error(op, result);
+    }
+}
 
-        uvhttp_free(buffer);
-        return UVHTTP_OK;
-    } else if (file_size <= UVHTTP_FILE_SIZE_MEDIUM) {
-        /* medium file: use chunked async sendfile (same as large file) */
-        UVHTTP_LOG_DEBUG("Medium file detected, using chunked async sendfile: "
-                         "%s (%zu bytes)",
-                         file_path, file_size);
-
-        /* getevent loop */
-        uv_loop_t* loop = uv_handle_get_loop((uv_handle_t*)resp->client);
-
-        /* create sendfile context */
-        sendfile_context_t* ctx =
-            (sendfile_context_t*)uvhttp_alloc(sizeof(sendfile_context_t));
-        if (!ctx) {
-            return UVHTTP_ERROR_OUT_OF_MEMORY;
-        }
-
-        memset(ctx, 0, sizeof(sendfile_context_t));
-        ctx->response = resp;
-        ctx->loop = loop;
-        ctx->file_size = file_size;
-        ctx->offset = 0;
-        ctx->bytes_sent = 0;
-        ctx->completed = 0;
-        ctx->start_time = uv_now(loop);
-        ctx->retry_count = 0;
-        ctx->sendfile_req.data = ctx;  /* setcallbackdata */
-        ctx->close_req.data = ctx;     /* on_file_close releases ctx via this */
-        ctx->cork_enabled = 0;         /* initialize as disabled */
-
-        /* initializeconfigparameter */
-        init_sendfile_config(ctx, file_size, config);
-
-        /* allocatefilepathmemory */
-        size_t path_len = strlen(file_path);
-        ctx->file_path = (char*)uvhttp_alloc(path_len + 1);
-        if (!ctx->file_path) {
-            uvhttp_free(ctx);
-            return UVHTTP_ERROR_OUT_OF_MEMORY;
+static void static_op_run(uvhttp_static_op_t* op) {
+    if (!op->ctx) {
+        /* uvhttp_static_sendfile: path is the caller's */
+        static_op_stat(op, STATIC_OP_STAT);
+        return;
+    }
+    op->ctx->fs_running++;
+    if (op->cached) {
+        static_op_on_file(op, NULL);
+    } else if (!op->ctx->root_realpath[0]) {
+        op->state = STATIC_OP_ROOT;
+        int result = uv_fs_realpath(op->loop, &op->fs,
+                                    op->ctx->config.root_directory,
+                                    static_op_on_fs);
+        if (result < 0) {
+            static_op_fs_error(op, result);
         }
-        memcpy(ctx->file_path, file_path, path_len);
-        ctx->file_path[path_len] = '\0';
+    } else {
+        static_op_realpath(op);
+    }
+}
 
-        /* get output file descriptor */
-        int fd_result = uv_fileno((uv_handle_t*)resp->client, &ctx->out_fd);
-        if (fd_result < 0) {
-            UVHTTP_LOG_ERROR("Failed to get client fd: %s",
-                             uv_strerror(fd_result));
-            uvhttp_free(ctx->file_path);
-            uvhttp_free(ctx);
-            return UVHTTP_ERROR_SERVER_INIT;
+/* the cache key of what op sends: its URL path, + ".gz" for the variant */
+static void static_op_cache_key(const uvhttp_static_op_t* op, char* key,
+                                size_t size) {
+    snprintf(key, size, "%s%s", op->url_path, op->gzip ? ".gz" : "");
+}
+
+/* the response is fully in memory */
+static void static_op_send_buffer(uvhttp_static_op_t* op) {
+    if (op->ctx && op->ctx->cache && !op->ctx->freed) {
+        char mime_type[UVHTTP_MAX_HEADER_VALUE_SIZE];
+        uvhttp_static_get_mime_type(op->path, mime_type, sizeof(mime_type));
+
+        char cache_key[UVHTTP_MAX_PATH_SIZE + 3];
+        static_op_cache_key(op, cache_key, sizeof(cache_key));
+        uvhttp_error_t result =
+            op->ctx->shared
+                ? uvhttp_shared_cache_put(op->ctx->shared, cache_key,
+                                          op->buffer ? op->buffer : "",
+                                          op->offset, mime_type,
+                                          op->last_modified, op->etag)
+                : uvhttp_lru_cache_put(op->ctx->cache, cache_key,
+                                       op->buffer ? op->buffer : "",
+                                       op->offset, mime_type,
+                                       op->last_modified, op->etag);
+        /* cache add failure, but still need to return content */
+        if (result != UVHTTP_OK) {
+            uvhttp_log_safe_error(0, "static_cache", "Failed to cache file");
         }
+    }
 
-        /* openinputfile */
-        ctx->in_fd = open(file_path, O_RDONLY);
-        if (ctx->in_fd < 0) {
-            UVHTTP_LOG_ERROR("Failed to open file for sendfile: %s", file_path);
-            uvhttp_free(ctx->file_path);
-            uvhttp_free(ctx);
-            return UVHTTP_ERROR_NOT_FOUND;
+    /* cache_put and response_set_body both copy the content; ranges are
+     * taken from what was read, in case the file shrank */
+    static_send_content(op->ctx ? op->request : NULL, op->response, op->path,
+                        op->buffer, op->offset, op->last_modified, op->etag,
+                        NULL);
+    static_op_finish(op);
+}
+
+static void static_op_read(uvhttp_static_op_t* op, static_op_state_t state,
+                           size_t length) {
+    op->state = state;
+    uv_buf_t buf = uv_buf_init(op->buffer + (state == STATIC_OP_READ
+                                                 ? op->offset
+                                                 : 0),
+                               (unsigned int)length);
+    int result = uv_fs_read(op->loop, &op->fs, op->fd, &buf, 1,
+                            (int64_t)op->offset, static_op_on_fs);
+    if (result < 0) {
+        static_op_fs_error(op, result);
+    }
+}
+
+static void static_op_next_chunk(uvhttp_static_op_t* op) {
+    size_t remaining = op->range_end - op->offset;
+    static_op_read(op, STATIC_OP_CHUNK,
+                   remaining < UVHTTP_FILE_CHUNK_SIZE ? remaining
+                                                      : UVHTTP_FILE_CHUNK_SIZE);
+}
+
+/* read the next range in chunks, after its part header when multipart;
+ * after the last part, end the body with the response */
+static void static_op_next_range(uvhttp_static_op_t* op) {
+    uvhttp_response_t* resp = op->response;
+    char part[UVHTTP_MAX_HEADER_VALUE_SIZE + 128];
+    int length;
+
+    if (op->range_index == op->range_count) {
+        length = static_part_end(part, sizeof(part), op->boundary);
+        if (uvhttp_response_send_raw(part, (size_t)length, resp->client,
+                                     resp) != UVHTTP_OK) {
+            static_op_abort(op);
+            return;
         }
+        resp->finished = 1;
+        static_op_finish(op);
+        return;
+    }
 
-        /* getMIMEtype */
+    const uvhttp_static_range_t* range = &op->ranges[op->range_index];
+    if (op->boundary[0]) {
         char mime_type[UVHTTP_MAX_HEADER_VALUE_SIZE];
-        uvhttp_static_get_mime_type(file_path, mime_type, sizeof(mime_type));
+        uvhttp_static_get_mime_type(op->path, mime_type, sizeof(mime_type));
+        length = static_part_header(part, sizeof(part), op->boundary,
+                                    mime_type, range, op->file_size);
+        if (length < 0 || (size_t)length >= sizeof(part) ||
+            uvhttp_response_send_raw(part, (size_t)length, resp->client,
+                                     NULL) != UVHTTP_OK) {
+            UVHTTP_LOG_ERROR("Failed to send %s", op->path);
+            static_op_abort(op);
+            return;
+        }
+    }
+    op->offset = range->start;
+    op->range_end = range->start + range->length;
+    static_op_next_chunk(op);
+}
 
-        char content_length[64];
-        snprintf(content_length, sizeof(content_length), "%zu", file_size);
+/* the file is too large to keep: hand it to sendfile, or read it in
+ * chunks */
+static void static_op_send_file(uvhttp_static_op_t* op) {
+    uvhttp_response_t* resp = op->response;
 
+    if (op->range_count > 1) {
+        char mime_type[UVHTTP_MAX_HEADER_VALUE_SIZE];
+        uvhttp_static_get_mime_type(op->path, mime_type, sizeof(mime_type));
+        static_new_boundary(op->boundary);
+        static_set_multipart_headers(
+            resp, op->boundary,
+            static_multipart_length(op->boundary, mime_type, op->ranges,
+                                    op->range_count, op->file_size),
+            op->last_modified, op->etag);
+        uvhttp_response_set_status(resp, 206);
+    } else if (op->range_count == 1) {
+        uvhttp_static_set_response_headers(resp, op->path, op->ranges[0].length,
+                                           op->last_modified, op->etag);
+        static_set_content_range(resp, &op->ranges[0], op->file_size);
+        uvhttp_response_set_status(resp, 206);
+    } else {
+        uvhttp_static_set_response_headers(resp, op->path, op->file_size,
+                                           op->last_modified, op->etag);
         uvhttp_response_set_status(resp, 200);
-        uvhttp_response_set_header(resp, "Content-Type", mime_type);
-        uvhttp_response_set_header(resp, "Content-Length", content_length);
-
-        /* build response header data */
-        char* header_data = NULL;
-        size_t header_length = 0;
-        uvhttp_error_t build_result =
-            uvhttp_response_build_data(resp, &header_data, &header_length);
-        if (build_result != UVHTTP_OK) {
-            UVHTTP_LOG_ERROR("Failed to build response headers: %s",
-                             uvhttp_error_string(build_result));
-            uv_fs_close(loop, &ctx->close_req, ctx->in_fd, on_file_close);
-            return build_result;
+        op->ranges[0].start = 0;
+        op->ranges[0].length = op->file_size;
+        op->range_count = 1;
+    }
+
+    /* sendfile would bypass TLS: read and write those in chunks, as the
+     * parts of a multipart answer */
+    if ((!op->conn || !op->conn->tls_enabled) && !op->boundary[0]) {
+        uvhttp_result_t result = sendfile_start(
+            resp, op->fd, op->path, op->ranges[0].start, op->ranges[0].length,
+            op->ctx ? &op->ctx->config : NULL);
+        if (resp->headers_sent) {
+            op->fd = -1; /* the transfer closes it */
+            static_op_release(op);
+            return;
         }
+        UVHTTP_LOG_WARN("sendfile unavailable (%s), reading %s in chunks",
+                        uvhttp_error_string(result), op->path);
+    }
 
-        /* send response headers (using send_raw, don't mark response as
-         * complete) */
-        uvhttp_error_t send_result = uvhttp_response_send_raw(
-            header_data, header_length, resp->client, resp);
-        uvhttp_free(header_data); /* release built response header data */
+    char* header_data = NULL;
+    size_t header_length = 0;
+    op->buffer = uvhttp_alloc(UVHTTP_FILE_CHUNK_SIZE);
+    if (!op->buffer ||
+        uvhttp_response_build_data(resp, &header_data, &header_length) !=
+            UVHTTP_OK ||
+        uvhttp_response_send_raw(header_data, header_length, resp->client,
+                                 NULL) != UVHTTP_OK) {
+        uvhttp_free(header_data);
+        static_op_fail(op, 500, UVHTTP_MESSAGE_INTERNAL_ERROR);
+        return;
+    }
+    uvhttp_free(header_data);
+    resp->headers_sent = 1;
+    resp->sent = 1;
+    static_op_next_range(op);
+}
 
-        if (send_result != UVHTTP_OK) {
-            UVHTTP_LOG_ERROR("Failed to send response headers: %s",
-                             uvhttp_error_string(send_result));
-            uv_fs_close(loop, &ctx->close_req, ctx->in_fd, on_file_close);
-            return send_result;
-        }
+static void static_map_work(uv_work_t* work) {
+    uvhttp_static_op_t* op = (uvhttp_static_op_t*)work->data;
+    /* a file that changed size since its stat would fault past its end */
+    struct stat st;
+    if (fstat(op->fd, &st) == 0 && (size_t)st.st_size == op->file_size) {
+        op->mapping = uvhttp_cache_buffer_map(op->fd, op->file_size,
+                                              op->ctx->config.mmap_populate);
+    }
+}
 
-        /* performance optimization: enable TCP_CORK to optimize large file
-         * transmission */
-        int cork = 1;
-        setsockopt(ctx->out_fd, IPPROTO_TCP, TCP_CORK, &cork, sizeof(cork));
-        ctx->cork_enabled = 1;
+static void static_map_done(uv_work_t* work, int status) {
+    uvhttp_static_op_t* op = (uvhttp_static_op_t*)work->data;
+    uvhttp_cache_buffer_t* mapping = op->mapping;
+    op->mapping = NULL;
+    (void)status;
 
-        /* initialize timeout timer */
-        int timer_result = uv_timer_init(loop, &ctx->timeout_timer);
-        if (timer_result != 0) {
-            UVHTTP_LOG_ERROR("Failed to init timeout timer: %s",
-                             uv_strerror(timer_result));
-            uvhttp_free(ctx->file_path);
-            uvhttp_free(ctx);
-            return UVHTTP_ERROR_SERVER_INIT;
+    if (!op->response) {
+        uvhttp_cache_buffer_release(mapping);
+        static_op_finish(op);
+        return;
+    }
+    if (!mapping) {
+        static_op_send_file(op);
+        return;
+    }
+
+    if (!op->ctx->freed) {
+        char mime_type[UVHTTP_MAX_HEADER_VALUE_SIZE];
+        char cache_key[UVHTTP_MAX_PATH_SIZE + 3];
+        uvhttp_static_get_mime_type(op->path, mime_type, sizeof(mime_type));
+        static_op_cache_key(op, cache_key, sizeof(cache_key));
+        if (uvhttp_lru_cache_put_buffer(op->ctx->mapped, cache_key, mapping,
+                                        mime_type, op->last_modified,
+                                        op->etag) != UVHTTP_OK) {
+            uvhttp_log_safe_error(0, "static_cache", "Failed to cache file");
+        }
+    }
+    static_send_content(op->request, op->response, op->path, mapping->data,
+                        op->file_size, op->last_modified, op->etag, mapping);
+    uvhttp_cache_buffer_release(mapping);
+    static_op_finish(op);
+}
+
+/* the file is open: read it, map it, or hand it to sendfile */
+static void static_op_on_open(uvhttp_static_op_t* op) {
+    if (op->file_size <= UVHTTP_SENDFILE_MIN_FILE_SIZE) {
+        if (op->file_size == 0) {
+            static_op_send_buffer(op);
+            return;
         }
-        ctx->timeout_timer.data = ctx;
+        op->buffer = uvhttp_alloc(op->file_size);
+        if (!op->buffer) {
+            static_op_fail(op, 500, UVHTTP_MESSAGE_MEMORY_FAILED);
+            return;
+        }
+        static_op_read(op, STATIC_OP_READ, op->file_size);
+        return;
+    }
 
-        /* start chunked sendfile (send config's chunk size each time) */
-        size_t chunk_size = ctx->chunk_size;
+    /* up to the mapped tier's file size, the file is mapped on the pool:
+     * this answer and later hits are written from the mapping */
+    if (op->ctx && op->ctx->mapped && !op->ctx->freed &&
+        op->file_size <= op->ctx->mapped->max_file_size) {
+        op->work.data = op;
+        if (uv_queue_work(op->loop, &op->work, static_map_work,
+                          static_map_done) == 0) {
+            return;
+        }
+    }
+    static_op_send_file(op);
+}
 
-        uv_timer_start(&ctx->timeout_timer, on_sendfile_timeout,
-                       ctx->timeout_ms, 0);
+/* a chunk is out: read the next one */
+static void static_op_on_written(uvhttp_static_op_t* op) {
+    if (op->offset >= op->range_end) {
+        op->range_index++;
+        static_op_next_range(op);
+        return;
+    }
+    static_op_next_chunk(op);
+}
 
-        int sendfile_result =
-            uv_fs_sendfile(loop, &ctx->sendfile_req, ctx->out_fd, ctx->in_fd,
-                           ctx->offset, chunk_size, on_sendfile_complete);
+static void static_op_on_write(uv_write_t* req, int status) {
+    uvhttp_static_op_t* op = (uvhttp_static_op_t*)req->data;
+    if (!op->response) {
+        /* cancelled: its connection is gone */
+        static_op_finish(op);
+    } else if (status < 0) {
+        UVHTTP_LOG_ERROR("Failed to send %s: %s", op->path,
+                         uv_strerror(status));
+        static_op_abort(op);
+    } else {
+        static_op_on_written(op);
+    }
+}
 
-        /* check if sendfile failed synchronously or no data */
-        if (sendfile_result < 0) {
-            UVHTTP_LOG_ERROR("Failed to start sendfile: %s",
-                             uv_strerror(sendfile_result));
-            /* clean resources */
-            uv_timer_stop(&ctx->timeout_timer);
-            uv_close((uv_handle_t*)&ctx->timeout_timer, NULL);
-            /* on_file_close (close_req.data == ctx) frees file_path + ctx */
-            uv_fs_close(loop, &ctx->close_req, ctx->in_fd, on_file_close);
-            return UVHTTP_ERROR_RESPONSE_SEND;
+/* one chunk read: write it, the last one with the response so that a
+ * keep-alive connection reads the next request once it is out. The next
+ * chunk is only read once this one is written, so a slow client holds one
+ * chunk of the file in memory, not all of it */
+static void static_op_on_chunk(uvhttp_static_op_t* op, size_t length) {
+    uv_stream_t* client = (uv_stream_t*)op->response->client;
+    op->offset += length;
+    int last = op->offset >= op->range_end && !op->boundary[0];
+    if (last) {
+        if (uvhttp_response_send_raw(op->buffer, length, client,
+                                     op->response) != UVHTTP_OK) {
+            UVHTTP_LOG_ERROR("Failed to send %s", op->path);
+            static_op_abort(op);
+            return;
         }
+        op->response->finished = 1;
+        static_op_finish(op);
+        return;
+    }
 
-        return UVHTTP_OK;
-    } else {
-        /* large file: use sendfile zero-copy optimization */
-        UVHTTP_LOG_DEBUG("Large file detected, using sendfile: %s (%zu bytes)",
-                         file_path, file_size);
-
-        /* getevent loop */
-        uv_loop_t* loop = uv_handle_get_loop((uv_handle_t*)resp->client);
-
-        /* create sendfile context */
-        sendfile_context_t* ctx =
-            (sendfile_context_t*)uvhttp_alloc(sizeof(sendfile_context_t));
-        if (!ctx) {
-            return UVHTTP_ERROR_OUT_OF_MEMORY;
-        }
-
-        memset(ctx, 0, sizeof(sendfile_context_t));
-        ctx->response = resp;
-        ctx->loop = loop;
-        ctx->file_size = file_size;
-        ctx->offset = 0;
-        ctx->bytes_sent = 0;
-        ctx->completed = 0;
-        ctx->start_time = uv_now(loop);
-        ctx->retry_count = 0;
-        ctx->cork_enabled = 0;        /* initialize as disabled */
-        ctx->sendfile_req.data = ctx; /* setcallbackdata */
-        ctx->close_req.data = ctx;    /* on_file_close releases ctx via this */
-
-        /* initializeconfigparameter */
-        init_sendfile_config(ctx, file_size, config);
-
-        /* allocatefilepathmemory */
-        size_t path_len = strlen(file_path);
-        ctx->file_path = (char*)uvhttp_alloc(path_len + 1);
-        if (!ctx->file_path) {
-            uvhttp_free(ctx);
-            return UVHTTP_ERROR_OUT_OF_MEMORY;
+    /* TLS writes are done when they return */
+    uvhttp_connection_t* conn =
+        (uvhttp_connection_t*)uv_handle_get_data((uv_handle_t*)client);
+    if (conn && conn->tls_enabled && conn->ssl) {
+        if (uvhttp_response_send_raw(op->buffer, length, client, NULL) !=
+            UVHTTP_OK) {
+            UVHTTP_LOG_ERROR("Failed to send %s", op->path);
+            static_op_abort(op);
+            return;
         }
-        memcpy(ctx->file_path, file_path, path_len);
-        ctx->file_path[path_len] = '\0';
+        static_op_on_written(op);
+        return;
+    }
 
-        /* get output file descriptor */
-        int fd_result = uv_fileno((uv_handle_t*)resp->client, &ctx->out_fd);
-        if (fd_result < 0) {
-            UVHTTP_LOG_ERROR("Failed to get client fd: %s",
-                             uv_strerror(fd_result));
-            uvhttp_free(ctx->file_path);
-            uvhttp_free(ctx);
-            return UVHTTP_ERROR_SERVER_INIT;
+    /* buffer is not touched again before the write is done */
+    uv_buf_t buf = uv_buf_init(op->buffer, (unsigned int)length);
+    op->write.data = op;
+    int result = uv_write(&op->write, client, &buf, 1, static_op_on_write);
+    if (result < 0) {
+        UVHTTP_LOG_ERROR("Failed to send %s: %s", op->path,
+                         uv_strerror(result));
+        static_op_abort(op);
+    }
+}
+
+/* path names a regular file, described by st (or, when NULL, by the
+ * open-file cache) */
+static void static_op_on_file(uvhttp_static_op_t* op, const uv_stat_t* st) {
+    uvhttp_open_file_t* entry = NULL;
+    if (st) {
+        op->file_size = (size_t)st->st_size;
+        op->last_modified = (time_t)st->st_mtim.tv_sec;
+
+        char key[UVHTTP_MAX_FILE_PATH_SIZE];
+        if (op->ctx && op->ctx->open_files && !op->ctx->freed &&
+            static_op_key(op, key, sizeof(key))) {
+            entry = uvhttp_open_file_cache_put(op->ctx->open_files, op->loop,
+                                               key, op->path, st);
         }
+    } else {
+        entry = static_op_entry(op, strlen(op->path));
+    }
 
-        /* openinputfile */
-        ctx->in_fd = open(file_path, O_RDONLY);
-        if (ctx->in_fd < 0) {
-            UVHTTP_LOG_ERROR("Failed to open file for sendfile: %s", file_path);
-            uvhttp_free(ctx->file_path);
-            uvhttp_free(ctx);
-            return UVHTTP_ERROR_NOT_FOUND;
+    /* check file size limit to prevent DoS attacks */
+    if (op->ctx && op->file_size > op->ctx->config.max_file_size) {
+        UVHTTP_LOG_WARN("File too large: %s (size: %zu, limit: %zu)", op->path,
+                        op->file_size, op->ctx->config.max_file_size);
+        static_op_fail(op, 413, UVHTTP_MESSAGE_FILE_TOO_LARGE);
+        return;
+    }
+
+    /* check if a pre-compressed .gz version exists and client accepts gzip
+     * (only for files worth compressing); the cache may know already */
+    size_t path_len = strlen(op->path);
+    if (op->accepts_gzip && op->file_size >= UVHTTP_STATIC_COMPRESS_MIN_SIZE &&
+        path_len + 3 < sizeof(op->path)) {
+        int has_gz = entry ? entry->has_gz : -1;
+        if (has_gz != 0) {
+            memcpy(op->path + path_len, ".gz", 4);
         }
+        if (has_gz == 1) {
+            op->gzip = 1;
+            op->file_size = entry->gz_size;
+            op->last_modified = entry->gz_mtime;
+        } else if (has_gz == -1) {
+            static_op_stat(op, STATIC_OP_STAT_GZIP);
+            return;
+        }
+    }
+    static_op_open(op);
+}
 
-        /* getMIMEtype */
-        char mime_type[UVHTTP_MAX_HEADER_VALUE_SIZE];
-        uvhttp_static_get_mime_type(file_path, mime_type, sizeof(mime_type));
+/* the file to send is decided: answer 304, or open it */
+static void static_op_open(uvhttp_static_op_t* op) {
+    uvhttp_static_generate_etag(op->path, op->last_modified, op->file_size,
+                                op->etag, sizeof(op->etag));
 
-        char content_length[64];
-        snprintf(content_length, sizeof(content_length), "%zu", file_size);
+    /* checkconditionrequest */
+    if (op->ctx && uvhttp_static_check_conditional_request(
+                       op->request, op->etag, op->last_modified)) {
+        uvhttp_response_set_status(op->response, 304); /* Not Modified */
+        uvhttp_response_send(op->response);
+        static_op_finish(op);
+        return;
+    }
 
-        uvhttp_response_set_status(resp, 200);
-        uvhttp_response_set_header(resp, "Content-Type", mime_type);
-        uvhttp_response_set_header(resp, "Content-Length", content_length);
-
-        /* build response header data */
-        char* header_data = NULL;
-        size_t header_length = 0;
-        uvhttp_error_t build_result =
-            uvhttp_response_build_data(resp, &header_data, &header_length);
-        if (build_result != UVHTTP_OK) {
-            UVHTTP_LOG_ERROR("Failed to build response headers: %s",
-                             uvhttp_error_string(build_result));
-            uv_fs_close(loop, &ctx->close_req, ctx->in_fd, on_file_close);
-            return build_result;
+    /* ranges past the end need no open */
+    if (op->ctx) {
+        op->range_count = static_request_ranges(
+            op->request, op->file_size, op->etag, op->last_modified,
+            op->ranges);
+        if (op->range_count < 0) {
+            static_send_unsatisfiable(op->response, op->file_size);
+            static_op_finish(op);
+            return;
         }
+    }
 
-        /* send response headers (using send_raw, don't mark response as
-         * complete) */
-        uvhttp_error_t send_result = uvhttp_response_send_raw(
-            header_data, header_length, resp->client, resp);
-        uvhttp_free(header_data); /* release built response header data */
-
-        if (send_result != UVHTTP_OK) {
-            UVHTTP_LOG_ERROR("Failed to send response headers: %s",
-                             uvhttp_error_string(send_result));
-            uv_fs_close(loop, &ctx->close_req, ctx->in_fd, on_file_close);
-            return send_result;
+    /* a descriptor kept open by the open-file cache saves the open */
+    uvhttp_open_file_t* entry = static_op_entry(op, static_op_plain_len(op));
+    uv_file kept = entry ? (op->gzip ? entry->gz_fd : entry->fd) : -1;
+    if (kept >= 0 &&
+        op->file_size == (op->gzip ? entry->gz_size : entry->size) &&
+        op->last_modified == (op->gzip ? entry->gz_mtime : entry->mtime)) {
+        /* the transfer closes its own duplicate */
+        op->fd = fcntl(kept, F_DUPFD_CLOEXEC, 0);
+        if (op->fd >= 0) {
+            static_op_on_open(op);
+            return;
         }
+    }
 
-        /* performance optimization: enable TCP_CORK to optimize large file
-         * transmission */
-        int cork = 1;
-        setsockopt(ctx->out_fd, IPPROTO_TCP, TCP_CORK, &cork, sizeof(cork));
-        ctx->cork_enabled = 1;
+    op->state = STATIC_OP_OPEN;
+    int result =
+        uv_fs_open(op->loop, &op->fs, op->path, O_RDONLY, 0, static_op_on_fs);
+    if (result < 0) {
+        static_op_fs_error(op, result);
+    }
+}
 
-        /* initialize timeout timer */
-        int timer_result = uv_timer_init(loop, &ctx->timeout_timer);
-        if (timer_result != 0) {
-            UVHTTP_LOG_ERROR("Failed to init timeout timer: %s",
-                             uv_strerror(timer_result));
-            uvhttp_free(ctx->file_path);
-            uvhttp_free(ctx);
-            return UVHTTP_ERROR_SERVER_INIT;
-        }
-        ctx->timeout_timer.data = ctx;
+static void static_listing_work(uv_work_t* work) {
+    uvhttp_static_op_t* op = (uvhttp_static_op_t*)work->data;
+    op->path[op->dir_len] = '\0';
+    op->listing = generate_directory_listing(op->path, op->url_path);
+}
 
-        /* start chunked sendfile (send config's chunk size each time) */
-        size_t chunk_size = ctx->chunk_size;
+static void static_listing_done(uv_work_t* work, int status) {
+    uvhttp_static_op_t* op = (uvhttp_static_op_t*)work->data;
+    if (!op->response) {
+        static_op_finish(op);
+    } else if (status < 0 || !op->listing) {
+        static_op_fail(op, 404, NULL);
+    } else {
+        uvhttp_response_set_status(op->response, 200);
+        uvhttp_response_set_header(op->response, "Content-Type", "text/html");
+        uvhttp_response_set_body(op->response, op->listing,
+                                 strlen(op->listing));
+        uvhttp_response_send(op->response);
+        static_op_finish(op);
+    }
+}
 
-        uv_timer_start(&ctx->timeout_timer, on_sendfile_timeout,
-                       ctx->timeout_ms, 0);
+/* path is a directory: serve its index file, or list it */
+static void static_op_on_directory(uvhttp_static_op_t* op) {
+    size_t dir_len = strlen(op->path);
+    int result = snprintf(op->path + dir_len, sizeof(op->path) - dir_len,
+                          "/%s", op->ctx->config.index_file);
+    if (result < 0 || (size_t)result >= sizeof(op->path) - dir_len) {
+        static_op_fail(op, 414, "URI Too Long");
+        return;
+    }
+    op->dir_len = dir_len;
+    static_op_stat(op, STATIC_OP_STAT_INDEX);
+}
 
-        int sendfile_result =
-            uv_fs_sendfile(loop, &ctx->sendfile_req, ctx->out_fd, ctx->in_fd,
-                           ctx->offset, chunk_size, on_sendfile_complete);
+static int static_op_within_root(uvhttp_static_op_t* op, const char* path) {
+    const char* root = op->ctx->root_realpath;
+    size_t root_len = strlen(root);
+    return strncmp(path, root, root_len) == 0 &&
+           (path[root_len] == '/' || path[root_len] == '\0' ||
+            (root_len > 0 && root[root_len - 1] == '/'));
+}
 
-        /* check if sendfile failed synchronously */
-        if (sendfile_result < 0) {
-            UVHTTP_LOG_ERROR("Failed to start sendfile: %s",
-                             uv_strerror(sendfile_result));
-            /* clean resources */
-            uv_timer_stop(&ctx->timeout_timer);
-            uv_close((uv_handle_t*)&ctx->timeout_timer, NULL);
-            /* on_file_close (close_req.data == ctx) frees file_path + ctx */
-            uv_fs_close(loop, &ctx->close_req, ctx->in_fd, on_file_close);
-            return UVHTTP_ERROR_RESPONSE_SEND;
+static void static_op_on_fs(uv_fs_t* req) {
+    uvhttp_static_op_t* op = (uvhttp_static_op_t*)req->data;
+    int result = (int)req->result;
+
+    if (op->state == STATIC_OP_CLOSE) {
+        uv_fs_req_cleanup(req);
+        static_op_release(op);
+        return;
+    }
+    if (op->state == STATIC_OP_OPEN && result >= 0) {
+        op->fd = (uv_file)result;
+    }
+    if (!op->response) {
+        /* cancelled: its connection is gone */
+        uv_fs_req_cleanup(req);
+        static_op_finish(op);
+        return;
+    }
+
+    switch (op->state) {
+    case STATIC_OP_ROOT:
+    case STATIC_OP_REALPATH: {
+        const char* resolved = result == 0 ? (const char*)req->ptr : NULL;
+        int fits = resolved && strlen(resolved) < sizeof(op->path);
+        if (op->state == STATIC_OP_ROOT && fits) {
+            uvhttp_safe_strcpy(op->ctx->root_realpath,
+                               sizeof(op->ctx->root_realpath), resolved);
+        } else if (fits && static_op_within_root(op, resolved)) {
+            uvhttp_safe_strcpy(op->path, sizeof(op->path), resolved);
+        } else {
+            fits = 0; /* outside the root: treated as missing */
+        }
+        int was_root = op->state == STATIC_OP_ROOT;
+        uv_fs_req_cleanup(req);
+        if (!fits) {
+            if (result < 0) {
+                static_op_fs_error(op, result);
+            } else {
+                static_op_remember_missing(op);
+                static_op_fail(op, 404, NULL);
+            }
+        } else if (was_root) {
+            static_op_realpath(op);
+        } else {
+            static_op_stat(op, STATIC_OP_STAT);
+        }
+        break;
+    }
+    case STATIC_OP_STAT: {
+        uv_stat_t st = req->statbuf;
+        uv_fs_req_cleanup(req);
+        if (result < 0) {
+            static_op_fs_error(op, result);
+        } else if (S_ISDIR(st.st_mode) && op->ctx) {
+            static_op_on_directory(op);
+        } else if (!S_ISREG(st.st_mode)) {
+            static_op_remember_missing(op);
+            static_op_fail(op, 404, NULL);
+        } else {
+            static_op_on_file(op, &st);
+        }
+        break;
+    }
+    case STATIC_OP_STAT_INDEX: {
+        uv_stat_t st = req->statbuf;
+        uv_fs_req_cleanup(req);
+        if (result == 0 && S_ISREG(st.st_mode)) {
+            op->dir_len = 0;
+            static_op_on_file(op, &st);
+        } else if (op->ctx->config.enable_directory_listing) {
+            op->work.data = op;
+            if (uv_queue_work(op->loop, &op->work,
+                              static_listing_work, static_listing_done) < 0) {
+                static_op_fail(op, 500, UVHTTP_MESSAGE_INTERNAL_ERROR);
+            }
+        } else {
+            static_op_fail(op, 404, NULL);
+        }
+        break;
+    }
+    case STATIC_OP_STAT_GZIP: {
+        uv_stat_t st = req->statbuf;
+        uv_fs_req_cleanup(req);
+        int found = result == 0 && S_ISREG(st.st_mode) && st.st_size > 0;
+        uvhttp_open_file_t* entry = static_op_entry(op, strlen(op->path) - 3);
+        if (entry) {
+            entry->has_gz = found;
+            entry->gz_size = (size_t)st.st_size;
+            entry->gz_mtime = (time_t)st.st_mtim.tv_sec;
+        }
+        if (found) {
+            op->gzip = 1;
+            op->file_size = (size_t)st.st_size;
+            op->last_modified = (time_t)st.st_mtim.tv_sec;
+        } else {
+            op->path[strlen(op->path) - 3] = '\0';
+        }
+        static_op_open(op);
+        break;
+    }
+    case STATIC_OP_OPEN:
+        uv_fs_req_cleanup(req);
+        if (result < 0) {
+            static_op_fs_error(op, result);
+            break;
+        }
+        if (op->file_size > UVHTTP_SENDFILE_MIN_FILE_SIZE && op->ctx &&
+            !op->ctx->freed) {
+            /* large files are sent from the descriptor: keep it for the next
+             * request (small ones are kept in the content cache instead) */
+            uvhttp_open_file_t* entry =
+                static_op_entry(op, static_op_plain_len(op));
+            if (entry) {
+                uvhttp_open_file_cache_keep_fd(op->ctx->open_files, entry,
+                                               op->gzip, op->fd);
+            }
+        }
+        static_op_on_open(op);
+        break;
+    case STATIC_OP_READ:
+        uv_fs_req_cleanup(req);
+        if (result < 0) {
+            static_op_fs_error(op, result);
+        } else if (result > 0 && op->offset + (size_t)result < op->file_size) {
+            op->offset += (size_t)result;
+            static_op_read(op, STATIC_OP_READ, op->file_size - op->offset);
+        } else {
+            /* complete, or the file shrank since it was stat'ed */
+            op->offset += (size_t)result;
+            static_op_send_buffer(op);
         }
+        break;
+    case STATIC_OP_CHUNK:
+        uv_fs_req_cleanup(req);
+        if (result <= 0) {
+            /* headers are out: the body ends short of its length */
+            UVHTTP_LOG_ERROR("Failed to read %s: %s", op->path,
+                             result < 0 ? uv_strerror(result) : "EOF");
+            static_op_abort(op);
+        } else {
+            static_op_on_chunk(op, (size_t)result);
+        }
+        break;
+    case STATIC_OP_CLOSE:
+        break;
+    }
+}
+
+/* queue op, or run it if the context has a free slot */
+static uvhttp_result_t static_op_start(uvhttp_static_op_t* op) {
+    if (op->conn) {
+        op->conn->static_op = op;
+    }
+    uvhttp_static_context_t* ctx = op->ctx;
+    if (!ctx) {
+        static_op_run(op);
+        return UVHTTP_OK;
+    }
+    ctx->fs_pending++;
+    if (ctx->fs_running < static_op_max_inflight(ctx)) {
+        static_op_run(op);
+    } else if (ctx->fs_waiting_tail) {
+        ctx->fs_waiting_tail->next = op;
+        ctx->fs_waiting_tail = op;
+    } else {
+        ctx->fs_waiting = ctx->fs_waiting_tail = op;
+    }
+    return UVHTTP_OK;
+}
 
+static uvhttp_static_op_t* static_op_new(uvhttp_static_context_t* ctx,
+                                         uvhttp_request_t* request,
+                                         uvhttp_response_t* response) {
+    if (!response->client) {
+        return NULL;
+    }
+    uvhttp_static_op_t* op = uvhttp_calloc(1, sizeof(uvhttp_static_op_t));
+    if (!op) {
+        uvhttp_handle_memory_failure("static_op", NULL, NULL);
+        return NULL;
+    }
+    op->fs.data = op;
+    op->loop = uv_handle_get_loop((uv_handle_t*)response->client);
+    op->ctx = ctx;
+    op->request = request;
+    op->response = response;
+    op->fd = -1;
+
+    /* the client's connection, to be told when it closes first */
+    uvhttp_connection_t* conn =
+        (uvhttp_connection_t*)uv_handle_get_data((uv_handle_t*)response->client);
+    if (conn && conn->response == response) {
+        op->conn = conn;
+    }
+    return op;
+}
+
+static uvhttp_result_t static_op_serve(uvhttp_static_context_t* ctx,
+                                       uvhttp_request_t* request,
+                                       uvhttp_response_t* response,
+                                       const char* url_path, int accepts_gzip,
+                                       uvhttp_request_handler_t fallback) {
+    char path[UVHTTP_MAX_FILE_PATH_SIZE];
+    int len = snprintf(path, sizeof(path), "%s%s", ctx->config.root_directory,
+                       url_path);
+    if (len < 0 || (size_t)len >= sizeof(path)) {
+        static_send_status(response, 414, "URI Too Long");
+        return UVHTTP_OK;
+    }
+
+    /* looked up before: a missing file is answered now, an existing one
+     * read without resolving it again */
+    const uvhttp_open_file_t* entry =
+        uvhttp_open_file_cache_find(ctx->open_files, path);
+    if (entry && entry->negative) {
+        static_not_found(request, response, fallback);
         return UVHTTP_OK;
     }
+
+    uvhttp_static_op_t* op = static_op_new(ctx, request, response);
+    if (!op) {
+        return response->client ? UVHTTP_ERROR_OUT_OF_MEMORY
+                                : UVHTTP_ERROR_INVALID_PARAM;
+    }
+    op->fallback = fallback;
+    op->accepts_gzip = accepts_gzip;
+    if (entry) {
+        op->cached = 1;
+        uvhttp_safe_strcpy(op->path, sizeof(op->path), entry->path);
+        op->file_size = entry->size;
+        op->last_modified = entry->mtime;
+    } else {
+        memcpy(op->path, path, (size_t)len + 1);
+    }
+    uvhttp_safe_strcpy(op->url_path, sizeof(op->url_path), url_path);
+    return static_op_start(op);
+}
+
+void uvhttp_static_cancel(uvhttp_static_op_t* op) {
+    if (op) {
+        static_op_detach(op);
+    }
 }
 
 /* zero-copy send static file (mixed strategy) - use default config */
 uvhttp_result_t uvhttp_static_sendfile(const char* file_path, void* response) {
-    /* call internal function, use NULL config (use default value) */
-    return uvhttp_static_sendfile_with_config(file_path, response, NULL);
+    if (!file_path || !response || !*file_path) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    if (strlen(file_path) >= UVHTTP_MAX_FILE_PATH_SIZE) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    uvhttp_static_op_t* op = static_op_new(NULL, NULL, response);
+    if (!op) {
+        return ((uvhttp_response_t*)response)->client
+                   ? UVHTTP_ERROR_OUT_OF_MEMORY
+                   : UVHTTP_ERROR_INVALID_PARAM;
+    }
+    uvhttp_safe_strcpy(op->path, sizeof(op->path), file_path);
+    return static_op_start(op);
 }
 
 #endif /* UVHTTP_FEATURE_STATIC_FILES */
@@ -6,12 +6,17 @@
 
 #include "uvhttp_allocator.h"
 #include "uvhttp_context.h"
+#include "uvhttp_hash.h"
 #include "uvhttp_platform.h"
 
 #include <errno.h>
+#include <mbedtls/platform_util.h>
+#include <mbedtls/sha256.h>
+#include <mbedtls/ssl_ticket.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 struct uvhttp_tls_context {
     mbedtls_ssl_config conf;
@@ -22,11 +27,39 @@ struct uvhttp_tls_context {
     mbedtls_entropy_context entropy;
     mbedtls_ctr_drbg_context ctr_drbg;
     mbedtls_ssl_cache_context cache;
+    mbedtls_ssl_ticket_context ticket;
+    uvhttp_tls_session_cache_t* shared_cache; /* not owned; NULL = use cache */
+    uv_timer_t* ticket_timer;                 /* rotation timer, heap-owned */
+    uint64_t ticket_epoch;                    /* epoch of the active key */
+    uint32_t ticket_lifetime;                 /* seconds */
+    uint32_t ticket_rotation_interval;        /* seconds, 0 = manual */
+    int tickets_ready;                        /* ticket context set up */
+    /* the keys we installed, previous then active, to install them again
+     * with a new lifetime */
+    uvhttp_tls_ticket_key_t ticket_keys[2];
+    int ticket_keys_held; /* how many of ticket_keys are set */
+    int record_sizing;                        /* dynamic record sizing on */
+    uint32_t record_idle_reset_ms;
+    size_t record_small;           /* plaintext bytes per small record */
+    size_t record_boost_threshold; /* bytes before full-size records */
+    uvhttp_tls_sni_callback_t sni_callback; /* NULL = always own cert */
+    void* sni_data;
     int is_server;
     int initialized;
     uvhttp_tls_stats_t stats;
 };
 
+/* Connection state made by uvhttp_tls_create_ssl. ssl comes first: the
+ * mbedtls_ssl_context* handed out is the allocation callers free. */
+typedef struct {
+    mbedtls_ssl_context ssl;
+    uvhttp_tls_context_t* ctx; /* whose certificate the handshake presents */
+} uvhttp_tls_ssl_t;
+
+/* Serialized sessions are a few hundred bytes unless the peer certificate is
+ * kept; larger ones fall back to a heap buffer. */
+#define UVHTTP_TLS_SESSION_STACK_BUF 1024
+
 // Custom network callback function
 static int mbedtls_net_send(void* ctx, const unsigned char* buf, size_t len) {
     int fd = *(int*)ctx;
@@ -52,6 +85,205 @@ static int mbedtls_net_recv(void* ctx, unsigned char* buf, size_t len) {
     return ret;
 }
 
+// session resumption callbacks
+/* Session ID cache lookup. Routes to the shared cache when one is attached so
+ * any worker can resume a session another worker established. */
+static int tls_session_cache_get(void* data, unsigned char const* session_id,
+                                 size_t session_id_len,
+                                 mbedtls_ssl_session* session) {
+    uvhttp_tls_context_t* ctx = (uvhttp_tls_context_t*)data;
+    int ret;
+
+    if (!ctx->shared_cache) {
+        ret = mbedtls_ssl_cache_get(&ctx->cache, session_id, session_id_len,
+                                    session);
+    } else {
+        unsigned char stack_buf[UVHTTP_TLS_SESSION_STACK_BUF];
+        unsigned char* buf = stack_buf;
+        size_t len = 0;
+
+        uvhttp_error_t err = uvhttp_tls_session_cache_get(
+            ctx->shared_cache, session_id, session_id_len, buf,
+            sizeof(stack_buf), &len);
+        if (err == UVHTTP_ERROR_BUFFER_TOO_SMALL) {
+            buf = uvhttp_alloc(len);
+            err = buf ? uvhttp_tls_session_cache_get(ctx->shared_cache,
+                                                     session_id, session_id_len,
+                                                     buf, len, &len)
+                      : UVHTTP_ERROR_OUT_OF_MEMORY;
+        }
+
+        ret = err == UVHTTP_OK ? mbedtls_ssl_session_load(session, buf, len)
+                               : MBEDTLS_ERR_SSL_CACHE_ENTRY_NOT_FOUND;
+        if (buf != stack_buf) {
+            uvhttp_free(buf);
+        }
+    }
+
+    if (ret == 0) {
+        ctx->stats.session_hits++;
+    } else {
+        ctx->stats.session_misses++;
+    }
+    return ret;
+}
+
+static int tls_session_cache_set(void* data, unsigned char const* session_id,
+                                 size_t session_id_len,
+                                 const mbedtls_ssl_session* session) {
+    uvhttp_tls_context_t* ctx = (uvhttp_tls_context_t*)data;
+
+    if (!ctx->shared_cache) {
+        return mbedtls_ssl_cache_set(&ctx->cache, session_id, session_id_len,
+                                     session);
+    }
+
+    size_t len = 0;
+    int ret = mbedtls_ssl_session_save(session, NULL, 0, &len);
+    if (ret != MBEDTLS_ERR_SSL_BUFFER_TOO_SMALL) {
+        return ret;
+    }
+
+    unsigned char* buf = uvhttp_alloc(len);
+    if (!buf) {
+        return MBEDTLS_ERR_SSL_ALLOC_FAILED;
+    }
+
+    ret = mbedtls_ssl_session_save(session, buf, len, &len);
+    if (ret == 0 &&
+        uvhttp_tls_session_cache_put(ctx->shared_cache, session_id,
+                                     session_id_len, buf, len) != UVHTTP_OK) {
+        ret = MBEDTLS_ERR_SSL_ALLOC_FAILED;
+    }
+
+    uvhttp_free(buf);
+    return ret;
+}
+
+static int tls_ticket_write(void* p_ticket, const mbedtls_ssl_session* session,
+                            unsigned char* start, const unsigned char* end,
+                            size_t* tlen, uint32_t* lifetime) {
+    uvhttp_tls_context_t* ctx = (uvhttp_tls_context_t*)p_ticket;
+    return mbedtls_ssl_ticket_write(&ctx->ticket, session, start, end, tlen,
+                                    lifetime);
+}
+
+static int tls_ticket_parse(void* p_ticket, mbedtls_ssl_session* session,
+                            unsigned char* buf, size_t len) {
+    uvhttp_tls_context_t* ctx = (uvhttp_tls_context_t*)p_ticket;
+    int ret = mbedtls_ssl_ticket_parse(&ctx->ticket, session, buf, len);
+    if (ret == 0) {
+        ctx->stats.session_hits++;
+    } else {
+        ctx->stats.session_misses++;
+    }
+    return ret;
+}
+
+/* Lazily set up the ticket context; mbedtls generates an initial key. */
+static uvhttp_error_t tls_ticket_setup(uvhttp_tls_context_t* ctx) {
+    if (ctx->tickets_ready) {
+        return UVHTTP_OK;
+    }
+
+    int ret = mbedtls_ssl_ticket_setup(&ctx->ticket, mbedtls_ctr_drbg_random,
+                                       &ctx->ctr_drbg,
+                                       MBEDTLS_CIPHER_AES_256_GCM,
+                                       ctx->ticket_lifetime);
+    if (ret != 0) {
+        return UVHTTP_ERROR_TLS_INIT;
+    }
+
+    ctx->tickets_ready = 1;
+    return UVHTTP_OK;
+}
+
+/* Hand key to mbedtls as the active key. Key lifetime covers two intervals
+ * so mbedtls never rotates on its own behind our back. */
+static uvhttp_error_t tls_ticket_load(uvhttp_tls_context_t* ctx,
+                                      const uvhttp_tls_ticket_key_t* key) {
+    uint32_t lifetime = ctx->ticket_lifetime;
+    if (ctx->ticket_rotation_interval > 0) {
+        lifetime = ctx->ticket_rotation_interval * 2;
+    }
+
+    int ret = mbedtls_ssl_ticket_rotate(&ctx->ticket, key->name,
+                                        sizeof(key->name), key->key,
+                                        sizeof(key->key), lifetime);
+    return ret == 0 ? UVHTTP_OK : UVHTTP_ERROR_TLS_CONTEXT;
+}
+
+/* Make key the active ticket key. The previous key stays in mbedtls's second
+ * slot, so tickets it issued keep decrypting until the next rotation: that is
+ * the overlap window. */
+static uvhttp_error_t tls_ticket_install(uvhttp_tls_context_t* ctx,
+                                         const uvhttp_tls_ticket_key_t* key) {
+    uvhttp_error_t err = tls_ticket_load(ctx, key);
+    if (err != UVHTTP_OK) {
+        return err;
+    }
+
+    ctx->ticket_keys[0] = ctx->ticket_keys[1];
+    ctx->ticket_keys[1] = *key;
+    if (ctx->ticket_keys_held < 2) {
+        ctx->ticket_keys_held++;
+    }
+    ctx->ticket_epoch = key->epoch;
+    return UVHTTP_OK;
+}
+
+/* Give the keys in mbedtls's two slots the current ticket lifetime: load the
+ * previous key, then the active one, so the overlap window survives. The key
+ * mbedtls made at setup is not known to us; it is replaced by a fresh one,
+ * the same way a rotation would. */
+static uvhttp_error_t tls_ticket_reinstall(uvhttp_tls_context_t* ctx) {
+    if (!ctx->tickets_ready || ctx->ticket_rotation_interval > 0) {
+        return UVHTTP_OK; /* rotation sets the key lifetime itself */
+    }
+    if (ctx->ticket_keys_held == 0) {
+        return uvhttp_tls_context_rotate_ticket_key(ctx);
+    }
+    if (ctx->ticket_keys_held == 2) {
+        uvhttp_error_t err = tls_ticket_load(ctx, &ctx->ticket_keys[0]);
+        if (err != UVHTTP_OK) {
+            return err;
+        }
+    }
+    return tls_ticket_load(ctx, &ctx->ticket_keys[1]);
+}
+
+/* Rotation epoch for the current wall-clock time. Workers sharing a cache
+ * agree on the epoch without talking to each other. */
+static uint64_t tls_ticket_current_epoch(uvhttp_tls_context_t* ctx) {
+    if (ctx->ticket_rotation_interval == 0) {
+        return ctx->ticket_epoch + 1;
+    }
+    return (uint64_t)time(NULL) / ctx->ticket_rotation_interval;
+}
+
+static void tls_ticket_timer_cb(uv_timer_t* handle) {
+    uvhttp_tls_context_t* ctx = (uvhttp_tls_context_t*)handle->data;
+    if (!ctx || !ctx->tickets_ready) {
+        return;
+    }
+
+    /* The timer polls faster than the interval so every worker picks up a
+     * peer's new key within one tick; only an epoch change rotates. */
+    if (tls_ticket_current_epoch(ctx) != ctx->ticket_epoch) {
+        uvhttp_tls_context_rotate_ticket_key(ctx);
+    }
+}
+
+static void tls_ticket_timer_stop(uvhttp_tls_context_t* ctx) {
+    if (!ctx->ticket_timer) {
+        return;
+    }
+    uv_timer_stop(ctx->ticket_timer);
+    ctx->ticket_timer->data = NULL;
+    uv_close((uv_handle_t*)ctx->ticket_timer, (uv_close_cb)uvhttp_free);
+    ctx->ticket_timer = NULL;
+}
+
 // TLS module lock management
 uvhttp_error_t uvhttp_tls_init(uvhttp_context_t* context) {
     /* v2.0.0: force require context, no longer support NULL */
@@ -121,6 +353,7 @@ uvhttp_error_t uvhttp_tls_context_new(uvhttp_tls_context_t** ctx) {
     mbedtls_pk_init(&c->pkey);
     mbedtls_x509_crt_init(&c->cacert);
     mbedtls_ssl_cache_init(&c->cache);
+    mbedtls_ssl_ticket_init(&c->ticket);
 
     mbedtls_entropy_init(&c->entropy);
     mbedtls_ctr_drbg_init(&c->ctr_drbg);
@@ -152,10 +385,18 @@ uvhttp_error_t uvhttp_tls_context_new(uvhttp_tls_context_t** ctx) {
      * Users can override via uvhttp_tls_context_set_session_cache() and
      * uvhttp_tls_context_set_ticket_lifetime().
      */
-    mbedtls_ssl_conf_session_cache(&c->conf, &c->cache,
-        mbedtls_ssl_cache_get, mbedtls_ssl_cache_set);
+    /* Lookups go through tls_session_cache_get/set so resumption is counted
+     * and a shared cache can be attached later without reconfiguring. */
+    mbedtls_ssl_conf_session_cache(&c->conf, c, tls_session_cache_get,
+                                   tls_session_cache_set);
     mbedtls_ssl_cache_set_max_entries(&c->cache, 2048);
     mbedtls_ssl_cache_set_timeout(&c->cache, 86400);
+    c->ticket_lifetime = 86400;
+
+    c->record_sizing = 1;
+    c->record_small = UVHTTP_TLS_RECORD_SMALL_DEFAULT;
+    c->record_boost_threshold = UVHTTP_TLS_RECORD_BOOST_THRESHOLD_DEFAULT;
+    c->record_idle_reset_ms = UVHTTP_TLS_RECORD_IDLE_RESET_MS_DEFAULT;
 
     c->is_server = 1;
     c->initialized = 1;
@@ -169,12 +410,16 @@ void uvhttp_tls_context_free(uvhttp_tls_context_t* ctx) {
         return;
     }
 
+    tls_ticket_timer_stop(ctx);
+
     mbedtls_ssl_config_free(&ctx->conf);
     mbedtls_x509_crt_free(&ctx->srvcert);
     mbedtls_pk_free(&ctx->pkey);
     mbedtls_x509_crt_free(&ctx->cacert);
     mbedtls_x509_crl_free(&ctx->crl);
     mbedtls_ssl_cache_free(&ctx->cache);
+    mbedtls_ssl_ticket_free(&ctx->ticket);
+    mbedtls_platform_zeroize(ctx->ticket_keys, sizeof(ctx->ticket_keys));
     mbedtls_entropy_free(&ctx->entropy);
     mbedtls_ctr_drbg_free(&ctx->ctr_drbg);
 
@@ -277,11 +522,18 @@ uvhttp_error_t uvhttp_tls_context_enable_session_tickets(
     }
 
     if (enable) {
+        uvhttp_error_t err = tls_ticket_setup(ctx);
+        if (err != UVHTTP_OK) {
+            return err;
+        }
         mbedtls_ssl_conf_session_tickets(&ctx->conf,
             MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+        mbedtls_ssl_conf_session_tickets_cb(&ctx->conf, tls_ticket_write,
+                                            tls_ticket_parse, ctx);
     } else {
         mbedtls_ssl_conf_session_tickets(&ctx->conf,
             MBEDTLS_SSL_SESSION_TICKETS_DISABLED);
+        mbedtls_ssl_conf_session_tickets_cb(&ctx->conf, NULL, NULL, NULL);
     }
 
     return UVHTTP_OK;
@@ -298,6 +550,17 @@ uvhttp_error_t uvhttp_tls_context_set_session_cache(uvhttp_tls_context_t* ctx,
     return UVHTTP_OK;
 }
 
+uvhttp_error_t uvhttp_tls_context_set_shared_session_cache(
+    uvhttp_tls_context_t* ctx, uvhttp_tls_session_cache_t* cache) {
+    if (!ctx) {
+        return UVHTTP_ERROR_TLS_INVALID_PARAM;
+    }
+
+    ctx->shared_cache = cache;
+
+    return UVHTTP_OK;
+}
+
 uvhttp_error_t uvhttp_tls_context_set_dh_parameters(uvhttp_tls_context_t* ctx,
                                                     const char* dh_file) {
     if (!ctx || !dh_file) {
@@ -321,23 +584,29 @@ mbedtls_ssl_context* uvhttp_tls_create_ssl(uvhttp_tls_context_t* ctx) {
         return NULL;
     }
 
-    mbedtls_ssl_context* ssl = uvhttp_calloc(1, sizeof(mbedtls_ssl_context));
-    if (!ssl) {
+    uvhttp_tls_ssl_t* tls_ssl = uvhttp_calloc(1, sizeof(uvhttp_tls_ssl_t));
+    if (!tls_ssl) {
         return NULL;
     }
+    mbedtls_ssl_context* ssl = &tls_ssl->ssl;
+    tls_ssl->ctx = ctx;
 
     mbedtls_ssl_init(ssl);
 
     int ret = mbedtls_ssl_setup(ssl, &ctx->conf);
     if (ret != 0) {
         mbedtls_ssl_free(ssl);
-        uvhttp_free(ssl);
+        uvhttp_free(tls_ssl);
         return NULL;
     }
 
     return ssl;
 }
 
+uvhttp_tls_context_t* uvhttp_tls_ssl_get_context(mbedtls_ssl_context* ssl) {
+    return ssl ? ((uvhttp_tls_ssl_t*)ssl)->ctx : NULL;
+}
+
 uvhttp_error_t uvhttp_tls_setup_ssl(mbedtls_ssl_context* ssl, int fd) {
     if (!ssl) {
         return UVHTTP_ERROR_TLS_INVALID_PARAM;
@@ -596,11 +865,35 @@ uvhttp_error_t uvhttp_tls_context_set_ticket_key(uvhttp_tls_context_t* ctx,
         return UVHTTP_ERROR_TLS_INVALID_PARAM;
     }
 
-    // session resume in mbedTLS 3.x implemented via session cache
-    // session ticket key managed internally, no need to manually set
-    // use mbedtls_ssl_cache_context for session cache
+    uvhttp_error_t err = tls_ticket_setup(ctx);
+    if (err != UVHTTP_OK) {
+        return err;
+    }
 
-    return UVHTTP_OK;
+    /* Shorter material is still accepted, as it always was: a key is
+     * derived from it (SHA-256), the same in every process */
+    uvhttp_tls_ticket_key_t k;
+    if (key_len < UVHTTP_TLS_TICKET_KEY_LEN) {
+        UVHTTP_LOG_WARN("Ticket key of %zu bytes, deriving a %d-byte key; "
+                        "pass %d random bytes instead\n",
+                        key_len, UVHTTP_TLS_TICKET_KEY_LEN,
+                        UVHTTP_TLS_TICKET_KEY_LEN);
+        if (mbedtls_sha256(key, key_len, k.key, 0) != 0) {
+            return UVHTTP_ERROR_TLS_INIT;
+        }
+    } else {
+        memcpy(k.key, key, sizeof(k.key));
+    }
+
+    /* The key name only has to differ between keys; derive it from the key
+     * so every process handed the same key produces the same name. */
+    uint64_t name = uvhttp_hash_default(k.key, sizeof(k.key));
+    memcpy(k.name, &name, sizeof(k.name));
+    k.epoch = ctx->ticket_epoch;
+
+    err = tls_ticket_install(ctx, &k);
+    mbedtls_platform_zeroize(&k, sizeof(k));
+    return err;
 }
 
 uvhttp_error_t uvhttp_tls_context_rotate_ticket_key(uvhttp_tls_context_t* ctx) {
@@ -608,8 +901,81 @@ uvhttp_error_t uvhttp_tls_context_rotate_ticket_key(uvhttp_tls_context_t* ctx) {
         return UVHTTP_ERROR_TLS_INVALID_PARAM;
     }
 
-    // session ticket key rotation in mbedTLS 3.x managed internally
-    // session cache will automatically process key rotation
+    uvhttp_error_t err = tls_ticket_setup(ctx);
+    if (err != UVHTTP_OK) {
+        return err;
+    }
+
+    uvhttp_tls_ticket_key_t candidate;
+    uvhttp_tls_ticket_key_t key;
+    uint64_t epoch = tls_ticket_current_epoch(ctx);
+
+    if (mbedtls_ctr_drbg_random(&ctx->ctr_drbg, candidate.name,
+                                sizeof(candidate.name)) != 0 ||
+        mbedtls_ctr_drbg_random(&ctx->ctr_drbg, candidate.key,
+                                sizeof(candidate.key)) != 0) {
+        return UVHTTP_ERROR_TLS_INIT;
+    }
+    candidate.epoch = epoch;
+
+    /* With a shared cache the first worker to reach the epoch publishes its
+     * candidate and the rest adopt it, so tickets stay portable. */
+    if (ctx->shared_cache) {
+        err = uvhttp_tls_session_cache_sync_ticket_key(ctx->shared_cache,
+                                                       epoch, &candidate, &key);
+    } else {
+        key = candidate;
+    }
+
+    if (err == UVHTTP_OK) {
+        err = tls_ticket_install(ctx, &key);
+    }
+
+    mbedtls_platform_zeroize(&candidate, sizeof(candidate));
+    mbedtls_platform_zeroize(&key, sizeof(key));
+    return err;
+}
+
+uvhttp_error_t uvhttp_tls_context_enable_ticket_rotation(
+    uvhttp_tls_context_t* ctx, uv_loop_t* loop, int interval_seconds) {
+    if (!ctx || interval_seconds < 0 || (interval_seconds > 0 && !loop)) {
+        return UVHTTP_ERROR_TLS_INVALID_PARAM;
+    }
+
+    tls_ticket_timer_stop(ctx);
+    ctx->ticket_rotation_interval = (uint32_t)interval_seconds;
+    if (interval_seconds == 0) {
+        return UVHTTP_OK;
+    }
+
+    uvhttp_error_t err = uvhttp_tls_context_rotate_ticket_key(ctx);
+    if (err != UVHTTP_OK) {
+        return err;
+    }
+
+    uv_timer_t* timer = uvhttp_alloc(sizeof(uv_timer_t));
+    if (!timer) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    if (uv_timer_init(loop, timer) != 0) {
+        uvhttp_free(timer);
+        return UVHTTP_ERROR_TLS_INIT;
+    }
+    timer->data = ctx;
+
+    uint64_t poll_ms = (uint64_t)interval_seconds * 1000 /
+                       UVHTTP_TLS_TICKET_ROTATION_POLLS;
+    if (poll_ms == 0) {
+        poll_ms = 1;
+    }
+    if (uv_timer_start(timer, tls_ticket_timer_cb, poll_ms, poll_ms) != 0) {
+        uv_close((uv_handle_t*)timer, (uv_close_cb)uvhttp_free);
+        return UVHTTP_ERROR_TLS_INIT;
+    }
+
+    /* Rotation must not keep an otherwise idle loop alive. */
+    uv_unref((uv_handle_t*)timer);
+    ctx->ticket_timer = timer;
 
     return UVHTTP_OK;
 }
@@ -622,8 +988,101 @@ uvhttp_error_t uvhttp_tls_context_set_ticket_lifetime(uvhttp_tls_context_t* ctx,
 
     // set session cache timeout time
     mbedtls_ssl_cache_set_timeout(&ctx->cache, lifetime_seconds);
+    ctx->ticket_lifetime = (uint32_t)lifetime_seconds;
+
+    /* an attached shared cache serves the session ID lookups instead */
+    if (ctx->shared_cache) {
+        uvhttp_error_t err = uvhttp_tls_session_cache_set_timeout(
+            ctx->shared_cache, (uint32_t)lifetime_seconds);
+        if (err != UVHTTP_OK) {
+            return err;
+        }
+    }
+
+    /* keys already installed still carry the old lifetime */
+    return tls_ticket_reinstall(ctx);
+}
+
+// dynamic record sizing
+uvhttp_error_t uvhttp_tls_context_set_dynamic_record_sizing(
+    uvhttp_tls_context_t* ctx, int enable, size_t small_record_size,
+    size_t boost_threshold, unsigned int idle_reset_ms) {
+    if (!ctx || small_record_size > MBEDTLS_SSL_OUT_CONTENT_LEN) {
+        return UVHTTP_ERROR_TLS_INVALID_PARAM;
+    }
+
+    ctx->record_sizing = enable ? 1 : 0;
+    ctx->record_small =
+        small_record_size ? small_record_size : UVHTTP_TLS_RECORD_SMALL_DEFAULT;
+    ctx->record_boost_threshold =
+        boost_threshold ? boost_threshold
+                        : UVHTTP_TLS_RECORD_BOOST_THRESHOLD_DEFAULT;
+    ctx->record_idle_reset_ms =
+        idle_reset_ms ? idle_reset_ms : UVHTTP_TLS_RECORD_IDLE_RESET_MS_DEFAULT;
+
+    return UVHTTP_OK;
+}
 
+size_t uvhttp_tls_context_next_record_size(uvhttp_tls_context_t* ctx,
+                                           uint64_t* streamed,
+                                           uint64_t* last_write_ms,
+                                           uint64_t now_ms) {
+    if (!ctx || !streamed || !last_write_ms || !ctx->record_sizing) {
+        return 0;
+    }
+
+    /* An idle connection has likely lost its congestion window, so start
+     * over with segment-sized records. */
+    if (now_ms - *last_write_ms > ctx->record_idle_reset_ms) {
+        *streamed = 0;
+    }
+    *last_write_ms = now_ms;
+
+    if (*streamed >= ctx->record_boost_threshold) {
+        return 0;
+    }
+    return ctx->record_small;
+}
+
+#if defined(MBEDTLS_SSL_SERVER_NAME_INDICATION)
+/* ClientHello carried a server name: hand this handshake the certificate of
+ * the context the callback picks. Returning nonzero would abort the
+ * handshake, so unknown names simply keep the default certificate. */
+static int tls_sni_select(void* data, mbedtls_ssl_context* ssl,
+                          const unsigned char* name, size_t name_len) {
+    uvhttp_tls_context_t* ctx = (uvhttp_tls_context_t*)data;
+    uvhttp_tls_context_t* selected =
+        ctx->sni_callback(ctx->sni_data, (const char*)name, name_len);
+    if (!selected || selected == ctx) {
+        return 0;
+    }
+    if (mbedtls_ssl_set_hs_own_cert(ssl, &selected->srvcert,
+                                    &selected->pkey) != 0) {
+        return -1;
+    }
+    /* its settings (record sizing) now apply to the connection */
+    ((uvhttp_tls_ssl_t*)ssl)->ctx = selected;
+    return 0;
+}
+#endif
+
+uvhttp_error_t uvhttp_tls_context_set_sni_callback(
+    uvhttp_tls_context_t* ctx, uvhttp_tls_sni_callback_t callback,
+    void* data) {
+    if (!ctx) {
+        return UVHTTP_ERROR_TLS_INVALID_PARAM;
+    }
+#if defined(MBEDTLS_SSL_SERVER_NAME_INDICATION)
+    ctx->sni_callback = callback;
+    ctx->sni_data = data;
+    mbedtls_ssl_conf_sni(&ctx->conf, callback ? tls_sni_select : NULL,
+                         callback ? ctx : NULL);
     return UVHTTP_OK;
+#else
+    (void)callback;
+    (void)data;
+    return UVHTTP_ERROR_NOT_SUPPORTED;
+#endif
 }
 
 // certificate chain verification
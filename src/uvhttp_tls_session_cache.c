@@ -0,0 +1,400 @@
+/* UVHTTP shared TLS session cache - sharded, lock-striped, thread-safe.
+ * Stores serialized sessions so one instance can back the TLS contexts of
+ * several worker loops; see uvhttp_tls_session_cache.h for the contract.
+ */
+
+#include "uvhttp_tls_session_cache.h"
+
+#include "uvhttp_allocator.h"
+#include "uvhttp_hash.h"
+#include "uvhttp_platform.h"
+
+#include "uthash.h"
+
+#include <string.h>
+#include <time.h>
+#include <uv.h>
+
+/* One stored session, filed in its shard's uthash index under the xxhash
+ * of its ID and linked into the shard's age list (oldest first), so lookup
+ * and choosing a victim take O(1) under the shard lock. */
+typedef struct tls_session_entry {
+    unsigned char id[UVHTTP_TLS_SESSION_ID_MAX_LEN];
+    unsigned char id_len;
+    unsigned char* data; /* serialized session (cache-owned) */
+    size_t data_len;
+    time_t stored_at;
+    struct tls_session_entry* older;
+    struct tls_session_entry* newer; /* also links the free slots */
+    UT_hash_handle hh;
+} tls_session_entry_t;
+
+/* One lock stripe. Trailing pad keeps neighbouring shards' locks and
+ * counters on different cache lines. */
+typedef struct {
+    uv_mutex_t lock;
+    tls_session_entry_t* index;   /* uthash head, keyed by ID */
+    tls_session_entry_t* entries; /* capacity slots, allocated up front */
+    tls_session_entry_t* free;    /* unused slots */
+    tls_session_entry_t* oldest;
+    tls_session_entry_t* newest;
+    size_t capacity;
+    size_t count;
+    size_t memory;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stores;
+    uint64_t evictions;
+    UVHTTP_CACHE_LINE_PAD;
+} tls_session_shard_t;
+
+struct uvhttp_tls_session_cache {
+    tls_session_shard_t* shards;
+    size_t shard_count; /* initialized shards */
+    size_t shard_mask;  /* stripe count - 1 (power of two) */
+    uint32_t timeout;   /* seconds, read without the shard lock */
+
+    uv_mutex_t ticket_lock;
+    uvhttp_tls_ticket_key_t ticket_key;
+    int has_ticket_key;
+};
+
+static uint64_t tls_session_hash(const unsigned char* id, size_t id_len) {
+    return uvhttp_hash_default(id, id_len);
+}
+
+static tls_session_shard_t* tls_session_shard(uvhttp_tls_session_cache_t* cache,
+                                              uint64_t hash) {
+    /* uthash buckets use the low bits, so pick the stripe from the high
+     * ones. */
+    return &cache->shards[(hash >> 32) & cache->shard_mask];
+}
+
+static tls_session_entry_t* tls_session_find(tls_session_shard_t* shard,
+                                             uint64_t hash,
+                                             const unsigned char* id,
+                                             size_t id_len) {
+    tls_session_entry_t* e = NULL;
+    HASH_FIND_BYHASHVALUE(hh, shard->index, id, id_len, (unsigned)hash, e);
+    return e;
+}
+
+static void tls_session_unlink(tls_session_shard_t* shard,
+                               tls_session_entry_t* e) {
+    if (e->older) {
+        e->older->newer = e->newer;
+    } else {
+        shard->oldest = e->newer;
+    }
+    if (e->newer) {
+        e->newer->older = e->older;
+    } else {
+        shard->newest = e->older;
+    }
+    e->older = NULL;
+    e->newer = NULL;
+}
+
+static void tls_session_link_newest(tls_session_shard_t* shard,
+                                    tls_session_entry_t* e) {
+    e->older = shard->newest;
+    e->newer = NULL;
+    if (shard->newest) {
+        shard->newest->newer = e;
+    } else {
+        shard->oldest = e;
+    }
+    shard->newest = e;
+}
+
+/* Take e out of the index and age list; its data is returned for the
+ * caller to free once the lock is dropped. */
+static unsigned char* tls_session_detach(tls_session_shard_t* shard,
+                                         tls_session_entry_t* e) {
+    unsigned char* data = e->data;
+    HASH_DEL(shard->index, e);
+    tls_session_unlink(shard, e);
+    shard->memory -= e->data_len;
+    shard->count--;
+    e->data = NULL;
+    e->data_len = 0;
+    return data;
+}
+
+static unsigned char* tls_session_release(tls_session_shard_t* shard,
+                                          tls_session_entry_t* e) {
+    unsigned char* data = tls_session_detach(shard, e);
+    e->newer = shard->free;
+    shard->free = e;
+    return data;
+}
+
+/* Slot for a new entry: a free one, else the oldest entry's (expired ones
+ * are always the oldest). Its old data goes to *stale. */
+static tls_session_entry_t* tls_session_victim(tls_session_shard_t* shard,
+                                               unsigned char** stale) {
+    tls_session_entry_t* e = shard->free;
+    if (e) {
+        shard->free = e->newer;
+        e->newer = NULL;
+        return e;
+    }
+    e = shard->oldest;
+    *stale = tls_session_detach(shard, e);
+    shard->evictions++;
+    return e;
+}
+
+uvhttp_error_t uvhttp_tls_session_cache_create(
+    size_t shard_count, size_t max_entries, uint32_t timeout_seconds,
+    uvhttp_tls_session_cache_t** cache) {
+    if (!cache) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    *cache = NULL;
+
+    if (shard_count == 0) {
+        shard_count = UVHTTP_TLS_SESSION_CACHE_DEFAULT_SHARDS;
+    }
+    if (max_entries == 0) {
+        max_entries = UVHTTP_TLS_SESSION_CACHE_DEFAULT_MAX_ENTRIES;
+    }
+    if (timeout_seconds == 0) {
+        timeout_seconds = UVHTTP_TLS_SESSION_CACHE_DEFAULT_TIMEOUT;
+    }
+
+    size_t shards = 1;
+    while (shards < shard_count) {
+        shards <<= 1;
+    }
+    size_t per_shard = (max_entries + shards - 1) / shards;
+
+    uvhttp_tls_session_cache_t* c =
+        uvhttp_calloc(1, sizeof(uvhttp_tls_session_cache_t));
+    if (!c) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+
+    c->shards = uvhttp_calloc(shards, sizeof(tls_session_shard_t));
+    if (!c->shards) {
+        uvhttp_free(c);
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    c->shard_mask = shards - 1;
+    c->timeout = timeout_seconds;
+
+    if (uv_mutex_init(&c->ticket_lock) != 0) {
+        uvhttp_free(c->shards);
+        uvhttp_free(c);
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+
+    for (size_t i = 0; i < shards; i++) {
+        tls_session_shard_t* s = &c->shards[i];
+        s->entries = uvhttp_calloc(per_shard, sizeof(tls_session_entry_t));
+        if (!s->entries || uv_mutex_init(&s->lock) != 0) {
+            uvhttp_free(s->entries);
+            uvhttp_tls_session_cache_free(c);
+            return UVHTTP_ERROR_OUT_OF_MEMORY;
+        }
+        for (size_t j = per_shard; j > 0; j--) {
+            s->entries[j - 1].newer = s->free;
+            s->free = &s->entries[j - 1];
+        }
+        s->capacity = per_shard;
+        c->shard_count++;
+    }
+
+    *cache = c;
+    return UVHTTP_OK;
+}
+
+void uvhttp_tls_session_cache_free(uvhttp_tls_session_cache_t* cache) {
+    if (!cache) {
+        return;
+    }
+
+    /* shard_count only covers shards whose mutex was initialized, which also
+     * makes this safe on the create() failure path. */
+    for (size_t i = 0; i < cache->shard_count; i++) {
+        tls_session_shard_t* s = &cache->shards[i];
+        for (size_t j = 0; j < s->capacity; j++) {
+            uvhttp_free(s->entries[j].data);
+        }
+        HASH_CLEAR(hh, s->index);
+        uvhttp_free(s->entries);
+        uv_mutex_destroy(&s->lock);
+    }
+
+    uv_mutex_destroy(&cache->ticket_lock);
+    uvhttp_free(cache->shards);
+    uvhttp_free(cache);
+}
+
+uvhttp_error_t uvhttp_tls_session_cache_put(uvhttp_tls_session_cache_t* cache,
+                                            const unsigned char* id,
+                                            size_t id_len,
+                                            const unsigned char* data,
+                                            size_t data_len) {
+    if (!cache || !id || id_len == 0 ||
+        id_len > UVHTTP_TLS_SESSION_ID_MAX_LEN || !data || data_len == 0) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    /* Copy outside the lock; the shard critical section stays short. */
+    unsigned char* copy = uvhttp_alloc(data_len);
+    if (!copy) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    memcpy(copy, data, data_len);
+
+    uint64_t hash = tls_session_hash(id, id_len);
+    tls_session_shard_t* shard = tls_session_shard(cache, hash);
+    time_t now = time(NULL);
+    unsigned char* stale = NULL;
+
+    uv_mutex_lock(&shard->lock);
+
+    /* A refreshed ID is filed again as the newest entry. */
+    tls_session_entry_t* e = tls_session_find(shard, hash, id, id_len);
+    if (e) {
+        stale = tls_session_detach(shard, e);
+    } else {
+        e = tls_session_victim(shard, &stale);
+        memcpy(e->id, id, id_len);
+        e->id_len = (unsigned char)id_len;
+    }
+
+    e->data = copy;
+    e->data_len = data_len;
+    e->stored_at = now;
+    HASH_ADD_KEYPTR_BYHASHVALUE(hh, shard->index, e->id, e->id_len,
+                                (unsigned)hash, e);
+    tls_session_link_newest(shard, e);
+    shard->count++;
+    shard->memory += data_len;
+    shard->stores++;
+
+    uv_mutex_unlock(&shard->lock);
+
+    uvhttp_free(stale);
+    return UVHTTP_OK;
+}
+
+uvhttp_error_t uvhttp_tls_session_cache_get(uvhttp_tls_session_cache_t* cache,
+                                            const unsigned char* id,
+                                            size_t id_len, unsigned char* buf,
+                                            size_t buf_size, size_t* out_len) {
+    if (!cache || !id || id_len == 0 ||
+        id_len > UVHTTP_TLS_SESSION_ID_MAX_LEN || !out_len) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    uint64_t hash = tls_session_hash(id, id_len);
+    tls_session_shard_t* shard = tls_session_shard(cache, hash);
+    uvhttp_error_t result = UVHTTP_OK;
+    time_t now = time(NULL);
+    unsigned char* stale = NULL;
+
+    uv_mutex_lock(&shard->lock);
+
+    tls_session_entry_t* e = tls_session_find(shard, hash, id, id_len);
+    if (e && now - e->stored_at >= (time_t)cache->timeout) {
+        stale = tls_session_release(shard, e);
+        e = NULL;
+    }
+
+    if (!e) {
+        shard->misses++;
+        result = UVHTTP_ERROR_NOT_FOUND;
+    } else {
+        *out_len = e->data_len;
+        if (!buf || buf_size < e->data_len) {
+            result = UVHTTP_ERROR_BUFFER_TOO_SMALL;
+        } else {
+            memcpy(buf, e->data, e->data_len);
+            shard->hits++;
+        }
+    }
+
+    uv_mutex_unlock(&shard->lock);
+
+    uvhttp_free(stale);
+    return result;
+}
+
+uvhttp_error_t uvhttp_tls_session_cache_remove(
+    uvhttp_tls_session_cache_t* cache, const unsigned char* id, size_t id_len) {
+    if (!cache || !id || id_len == 0 ||
+        id_len > UVHTTP_TLS_SESSION_ID_MAX_LEN) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    uint64_t hash = tls_session_hash(id, id_len);
+    tls_session_shard_t* shard = tls_session_shard(cache, hash);
+
+    unsigned char* stale = NULL;
+
+    uv_mutex_lock(&shard->lock);
+    tls_session_entry_t* e = tls_session_find(shard, hash, id, id_len);
+    if (e) {
+        stale = tls_session_release(shard, e);
+    }
+    uv_mutex_unlock(&shard->lock);
+
+    uvhttp_free(stale);
+    return e ? UVHTTP_OK : UVHTTP_ERROR_NOT_FOUND;
+}
+
+uvhttp_error_t uvhttp_tls_session_cache_set_timeout(
+    uvhttp_tls_session_cache_t* cache, uint32_t timeout_seconds) {
+    if (!cache || timeout_seconds == 0) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    /* Word-sized store; readers see either the old or the new value. */
+    cache->timeout = timeout_seconds;
+    return UVHTTP_OK;
+}
+
+uvhttp_error_t uvhttp_tls_session_cache_sync_ticket_key(
+    uvhttp_tls_session_cache_t* cache, uint64_t epoch,
+    const uvhttp_tls_ticket_key_t* candidate, uvhttp_tls_ticket_key_t* out) {
+    if (!cache || !candidate || !out) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    uv_mutex_lock(&cache->ticket_lock);
+    if (!cache->has_ticket_key || cache->ticket_key.epoch < epoch) {
+        cache->ticket_key = *candidate;
+        cache->ticket_key.epoch = epoch;
+        cache->has_ticket_key = 1;
+    }
+    *out = cache->ticket_key;
+    uv_mutex_unlock(&cache->ticket_lock);
+
+    return UVHTTP_OK;
+}
+
+uvhttp_error_t uvhttp_tls_session_cache_get_stats(
+    uvhttp_tls_session_cache_t* cache,
+    uvhttp_tls_session_cache_stats_t* stats) {
+    if (!cache || !stats) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    for (size_t i = 0; i < cache->shard_count; i++) {
+        tls_session_shard_t* s = &cache->shards[i];
+        uv_mutex_lock(&s->lock);
+        stats->hits += s->hits;
+        stats->misses += s->misses;
+        stats->stores += s->stores;
+        stats->evictions += s->evictions;
+        stats->entries += s->count;
+        stats->memory += s->memory;
+        uv_mutex_unlock(&s->lock);
+    }
+
+    return UVHTTP_OK;
+}
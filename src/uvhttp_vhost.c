@@ -0,0 +1,323 @@
+#include "uvhttp_vhost.h"
+
+#include "uvhttp_allocator.h"
+#include "uvhttp_defaults.h"
+#include "uvhttp_hash.h"
+#include "uvhttp_router.h"
+#include "uvhttp_server.h"
+
+#if UVHTTP_FEATURE_TLS
+#    include "uvhttp_tls.h"
+#endif
+
+#include <string.h>
+
+/*
+ * Exact names are stored as they are ("example.com"), wildcards without
+ * the star (".example.com"). No exact name starts with '.', so both live in
+ * one open-addressed table: a lookup hashes the full name, and on a miss
+ * each suffix that starts at a '.', longest first.
+ */
+
+typedef struct {
+    char* name;
+    size_t name_len;
+    uint64_t hash;
+    uvhttp_router_t* router;
+#if UVHTTP_FEATURE_TLS
+    uvhttp_tls_context_t* tls_ctx; /* NULL = default certificate */
+#endif
+} vhost_entry_t;
+
+struct uvhttp_vhost_table {
+    vhost_entry_t* entries;
+    size_t count;
+    size_t capacity;
+    uint32_t* slots; /* entry index + 1, 0 = empty */
+    size_t slot_mask;
+};
+
+size_t uvhttp_vhost_normalize(const char* host, size_t len, char* out) {
+    size_t end = len;
+    if (len > 0 && host[0] == '[') {
+        /* IPv6 literal, "[::1]:8080" */
+        const char* close = memchr(host, ']', len);
+        if (close) {
+            end = (size_t)(close - host) + 1;
+        }
+    } else {
+        const char* colon = memchr(host, ':', len);
+        if (colon) {
+            end = (size_t)(colon - host);
+        }
+    }
+    if (end > 0 && host[end - 1] == '.') {
+        end--;
+    }
+    if (end == 0 || end > UVHTTP_VHOST_MAX_NAME_LEN) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < end; i++) {
+        char c = host[i];
+        out[i] = (c >= 'A' && c <= 'Z') ? (char)(c + ('a' - 'A')) : c;
+    }
+    return end;
+}
+
+static inline uint64_t vhost_hash(const char* name, size_t len) {
+    return uvhttp_hash(name, len, UVHTTP_HASH_DEFAULT_SEED);
+}
+
+static const vhost_entry_t* table_get(const uvhttp_vhost_table_t* table,
+                                      const char* name, size_t len) {
+    uint64_t hash = vhost_hash(name, len);
+    for (size_t i = hash & table->slot_mask;; i = (i + 1) & table->slot_mask) {
+        uint32_t slot = table->slots[i];
+        if (slot == 0) {
+            return NULL;
+        }
+        const vhost_entry_t* entry = &table->entries[slot - 1];
+        if (entry->hash == hash && entry->name_len == len &&
+            memcmp(entry->name, name, len) == 0) {
+            return entry;
+        }
+    }
+}
+
+/* Exact name, then the longest wildcard suffix */
+static const vhost_entry_t* table_find(const uvhttp_vhost_table_t* table,
+                                       const char* name, size_t len) {
+    if (!table || table->count == 0) {
+        return NULL;
+    }
+    const vhost_entry_t* entry = table_get(table, name, len);
+    for (size_t i = 0; !entry && i < len; i++) {
+        if (name[i] == '.' && i + 1 < len) {
+            entry = table_get(table, name + i, len - i);
+        }
+    }
+    return entry;
+}
+
+/* Room for one more entry; slots stay at twice the entry capacity, so the
+ * load factor never exceeds 1/2 */
+static uvhttp_error_t table_reserve(uvhttp_vhost_table_t* table) {
+    if (table->count < table->capacity) {
+        return UVHTTP_OK;
+    }
+
+    size_t capacity = table->capacity ? table->capacity * 2 : 8;
+    size_t slot_count = capacity * 2;
+    uint32_t* slots = uvhttp_calloc(slot_count, sizeof(uint32_t));
+    if (!slots) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    vhost_entry_t* entries =
+        uvhttp_realloc(table->entries, capacity * sizeof(vhost_entry_t));
+    if (!entries) {
+        uvhttp_free(slots);
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    table->entries = entries;
+    table->capacity = capacity;
+
+    for (size_t e = 0; e < table->count; e++) {
+        size_t i = table->entries[e].hash & (slot_count - 1);
+        while (slots[i] != 0) {
+            i = (i + 1) & (slot_count - 1);
+        }
+        slots[i] = (uint32_t)(e + 1);
+    }
+    uvhttp_free(table->slots);
+    table->slots = slots;
+    table->slot_mask = slot_count - 1;
+    return UVHTTP_OK;
+}
+
+uvhttp_error_t uvhttp_vhost_table_new(uvhttp_vhost_table_t** table) {
+    if (!table) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    *table = uvhttp_calloc(1, sizeof(uvhttp_vhost_table_t));
+    return *table ? UVHTTP_OK : UVHTTP_ERROR_OUT_OF_MEMORY;
+}
+
+void uvhttp_vhost_table_free(uvhttp_vhost_table_t* table,
+                             const uvhttp_server_t* server) {
+    if (!table) {
+        return;
+    }
+    for (size_t e = 0; e < table->count; e++) {
+        vhost_entry_t* entry = &table->entries[e];
+
+        /* a router or context shared by several hosts is freed by the
+         * first entry holding it */
+        int router_shared = server && entry->router == server->router;
+#if UVHTTP_FEATURE_TLS
+        int tls_shared = !entry->tls_ctx ||
+                         (server && entry->tls_ctx == server->tls_ctx);
+#endif
+        for (size_t prev = 0; prev < e; prev++) {
+            router_shared |= table->entries[prev].router == entry->router;
+#if UVHTTP_FEATURE_TLS
+            tls_shared |= table->entries[prev].tls_ctx == entry->tls_ctx;
+#endif
+        }
+        if (!router_shared) {
+            uvhttp_router_free(entry->router);
+        }
+#if UVHTTP_FEATURE_TLS
+        if (!tls_shared) {
+            uvhttp_tls_context_free(entry->tls_ctx);
+        }
+#endif
+        uvhttp_free(entry->name);
+    }
+    uvhttp_free(table->entries);
+    uvhttp_free(table->slots);
+    uvhttp_free(table);
+}
+
+#if UVHTTP_FEATURE_TLS
+/* SNI: certificate of the virtual host the client asked for */
+static uvhttp_tls_context_t* vhost_sni(void* data, const char* name,
+                                       size_t name_len) {
+    const uvhttp_server_t* server = (const uvhttp_server_t*)data;
+    char normalized[UVHTTP_VHOST_MAX_NAME_LEN];
+    size_t len = uvhttp_vhost_normalize(name, name_len, normalized);
+    if (len == 0) {
+        return NULL;
+    }
+    const vhost_entry_t* entry =
+        table_find((const uvhttp_vhost_table_t*)server->vhosts, normalized, len);
+    return entry ? entry->tls_ctx : NULL;
+}
+#endif
+
+static uvhttp_error_t vhost_add(uvhttp_server_t* server, const char* host,
+                                uvhttp_router_t* router, void* tls_ctx) {
+    if (!server || !host || !router) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    /* "*." prefix, then a plain name without port */
+    const char* name = host;
+    if (name[0] == '*') {
+        if (name[1] != '.') {
+            return UVHTTP_ERROR_INVALID_PARAM;
+        }
+        name++;
+    }
+    size_t host_len = strlen(name);
+    if (strchr(name, '*') || strchr(name, '/') ||
+        (name[0] != '[' && strchr(name, ':'))) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    char normalized[UVHTTP_VHOST_MAX_NAME_LEN];
+    size_t len = uvhttp_vhost_normalize(name, host_len, normalized);
+    /* a leading '.' is what marks a wildcard */
+    if (len == 0 || (name == host && normalized[0] == '.') ||
+        (len == 1 && normalized[0] == '.')) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    if (!server->vhosts) {
+        uvhttp_vhost_table_t* created = NULL;
+        uvhttp_error_t err = uvhttp_vhost_table_new(&created);
+        if (err != UVHTTP_OK) {
+            return err;
+        }
+        server->vhosts = created;
+    }
+    uvhttp_vhost_table_t* table = (uvhttp_vhost_table_t*)server->vhosts;
+    if (table->count > 0 && table_get(table, normalized, len)) {
+        return UVHTTP_ERROR_ALREADY_EXISTS;
+    }
+    uvhttp_error_t err = table_reserve(table);
+    if (err != UVHTTP_OK) {
+        return err;
+    }
+
+    char* copy = uvhttp_alloc(len + 1);
+    if (!copy) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    memcpy(copy, normalized, len);
+    copy[len] = '\0';
+
+    vhost_entry_t* entry = &table->entries[table->count];
+    entry->name = copy;
+    entry->name_len = len;
+    entry->hash = vhost_hash(copy, len);
+    entry->router = router;
+#if UVHTTP_FEATURE_TLS
+    entry->tls_ctx = (uvhttp_tls_context_t*)tls_ctx;
+#else
+    (void)tls_ctx;
+#endif
+
+    size_t i = entry->hash & table->slot_mask;
+    while (table->slots[i] != 0) {
+        i = (i + 1) & table->slot_mask;
+    }
+    table->slots[i] = (uint32_t)(++table->count);
+    return UVHTTP_OK;
+}
+
+uvhttp_error_t uvhttp_server_add_vhost(uvhttp_server_t* server,
+                                       const char* host,
+                                       uvhttp_router_t* router) {
+    return vhost_add(server, host, router, NULL);
+}
+
+#if UVHTTP_FEATURE_TLS
+uvhttp_error_t uvhttp_server_add_vhost_tls(uvhttp_server_t* server,
+                                           const char* host,
+                                           uvhttp_router_t* router,
+                                           uvhttp_tls_context_t* tls_ctx) {
+    uvhttp_error_t err = vhost_add(server, host, router, tls_ctx);
+    if (err != UVHTTP_OK || !tls_ctx || !server->tls_ctx) {
+        return err;
+    }
+    /* SNI goes on the listening context; uvhttp_server_enable_tls installs
+     * it when TLS is enabled later. The entry stays (and is owned by the
+     * server) even if mbedtls cannot do SNI. */
+    return uvhttp_server_enable_vhost_sni(server);
+}
+
+uvhttp_error_t uvhttp_server_enable_vhost_sni(uvhttp_server_t* server) {
+    if (!server || !server->tls_ctx) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    const uvhttp_vhost_table_t* table =
+        (const uvhttp_vhost_table_t*)server->vhosts;
+    size_t with_cert = 0;
+    for (size_t e = 0; table && e < table->count; e++) {
+        with_cert += table->entries[e].tls_ctx != NULL;
+    }
+    if (with_cert == 0) {
+        return UVHTTP_OK;
+    }
+    return uvhttp_tls_context_set_sni_callback(server->tls_ctx, vhost_sni,
+                                               server);
+}
+#endif
+
+uvhttp_router_t* uvhttp_server_find_router(const uvhttp_server_t* server,
+                                           const char* host) {
+    if (!server) {
+        return NULL;
+    }
+    if (!server->vhosts || !host) {
+        return server->router;
+    }
+
+    char normalized[UVHTTP_VHOST_MAX_NAME_LEN];
+    size_t len = uvhttp_vhost_normalize(host, strlen(host), normalized);
+    const vhost_entry_t* entry =
+        len ? table_find((const uvhttp_vhost_table_t*)server->vhosts,
+                         normalized, len)
+            : NULL;
+    return entry ? entry->router : server->router;
+}
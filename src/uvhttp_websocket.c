@@ -28,6 +28,11 @@
 #error "WebSocket requires TLS support (BUILD_WITH_HTTPS=ON)"
 #endif
 
+#if UVHTTP_FEATURE_COMPRESSION
+#include <zlib.h>
+#endif
+
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -67,6 +72,514 @@ static int uvhttp_ws_random_bytes(uvhttp_context_t* context, unsigned char* buf,
     return UVHTTP_ERROR_INVALID_PARAM;
 }
 
+/* Encoded server frame shared by every connection it is queued on.
+ * Refcounted from the loop thread only. */
+struct uvhttp_ws_shared_frame {
+    size_t refcount;
+    uvhttp_ws_opcode_t opcode;
+    size_t len;
+    size_t header_len;
+    /* permessage-deflate variant, built by the first recipient that
+     * negotiated it and shared by the rest */
+    struct uvhttp_ws_shared_frame* deflated;
+    int deflate_tried;
+    uint8_t data[];
+};
+
+/* Outbound queue entry. The frame bytes are either stored inline after the
+ * entry or borrowed from a shared frame the entry holds a reference to. */
+struct uvhttp_ws_out_frame {
+    struct uvhttp_ws_out_frame* next;
+    uvhttp_ws_shared_frame_t* shared;
+    const uint8_t* data;
+    size_t len;
+    uint8_t inline_data[];
+};
+
+/* One uv_write covering up to UVHTTP_WEBSOCKET_WRITEV_MAX queued frames.
+ * The request owns its frames so it can outlive the connection: freeing the
+ * connection only clears conn, and the completion releases the frames. */
+typedef struct uvhttp_ws_write_req {
+    uv_write_t req;
+    struct uvhttp_ws_connection* conn;
+    uvhttp_ws_out_frame_t* frames;
+    size_t bytes;
+    uv_buf_t bufs[UVHTTP_WEBSOCKET_WRITEV_MAX];
+} uvhttp_ws_write_req_t;
+
+void uvhttp_ws_shared_frame_release(uvhttp_ws_shared_frame_t* frame) {
+    if (frame && --frame->refcount == 0) {
+        uvhttp_ws_shared_frame_release(frame->deflated);
+        uvhttp_free(frame);
+    }
+}
+
+static void uvhttp_ws_free_frames(uvhttp_ws_out_frame_t* frame) {
+    while (frame) {
+        uvhttp_ws_out_frame_t* next = frame->next;
+        uvhttp_ws_shared_frame_release(frame->shared);
+        uvhttp_free(frame);
+        frame = next;
+    }
+}
+
+/* Drop frames that have not been handed to uv_write yet */
+static void uvhttp_ws_discard_queue(struct uvhttp_ws_connection* conn) {
+    for (uvhttp_ws_out_frame_t* f = conn->send_head; f; f = f->next) {
+        conn->send_queued_bytes -= f->len;
+    }
+    uvhttp_ws_free_frames(conn->send_head);
+    conn->send_head = NULL;
+    conn->send_tail = NULL;
+}
+
+/* ========== permessage-deflate (RFC 7692) ========== */
+
+#if UVHTTP_FEATURE_COMPRESSION
+
+/* Every compressed message ends with an empty stored block; the last four
+ * bytes are stripped on the wire and restored before inflating (§7.2.1) */
+static const uint8_t WS_DEFLATE_TAIL[4] = {0x00, 0x00, 0xff, 0xff};
+
+/* Raw deflate with the 32 KB window (miniz supports no other size) */
+#    define WS_DEFLATE_WINDOW_BITS 15
+
+struct uvhttp_ws_deflate {
+    uvhttp_ws_deflate_params_t params;
+    int peer_context_takeover; /* peer keeps its window across messages */
+    z_stream* tx;              /* compressor when no loop context exists */
+    z_stream* rx;              /* inflater (kept for peer context takeover) */
+    int rx_message_compressed; /* RSV1 of the fragmented message */
+};
+
+static z_stream* uvhttp_ws_zstream_new(int deflater) {
+    z_stream* zs = uvhttp_calloc(1, sizeof(z_stream));
+    if (!zs) {
+        return NULL;
+    }
+    int ret = deflater
+                  ? deflateInit2(zs, UVHTTP_WEBSOCKET_COMPRESSION_LEVEL,
+                                 Z_DEFLATED, -WS_DEFLATE_WINDOW_BITS, 8,
+                                 Z_DEFAULT_STRATEGY)
+                  : inflateInit2(zs, -WS_DEFLATE_WINDOW_BITS);
+    if (ret != Z_OK) {
+        uvhttp_free(zs);
+        return NULL;
+    }
+    return zs;
+}
+
+static void uvhttp_ws_zstream_free(z_stream* zs, int deflater) {
+    if (!zs) {
+        return;
+    }
+    if (deflater) {
+        deflateEnd(zs);
+    } else {
+        inflateEnd(zs);
+    }
+    uvhttp_free(zs);
+}
+
+static void uvhttp_ws_deflate_free(uvhttp_ws_deflate_t* deflate) {
+    if (!deflate) {
+        return;
+    }
+    uvhttp_ws_zstream_free(deflate->tx, 1);
+    uvhttp_ws_zstream_free(deflate->rx, 0);
+    uvhttp_free(deflate);
+}
+
+/* Stream for one message. Our side never takes over context, so the
+ * compressor (and the inflater for peers that do not either) is the loop's
+ * shared stream, reset per message. Only peers keeping their window need an
+ * inflater of their own. */
+static z_stream* uvhttp_ws_zstream(struct uvhttp_ws_connection* conn,
+                                   uvhttp_context_t* context, int deflater) {
+    uvhttp_ws_deflate_t* deflate = conn->deflate;
+    if (!context && conn->transport && conn->transport->server) {
+        context = conn->transport->server->context;
+    }
+
+    if (!deflater && deflate->peer_context_takeover) {
+        if (!deflate->rx) {
+            deflate->rx = uvhttp_ws_zstream_new(0);
+        }
+        return deflate->rx;
+    }
+
+    z_stream* zs;
+    if (context) {
+        void** slot = deflater ? &context->ws_deflater : &context->ws_inflater;
+        if (!*slot) {
+            *slot = uvhttp_ws_zstream_new(deflater);
+        }
+        zs = (z_stream*)*slot;
+    } else {
+        z_stream** slot = deflater ? &deflate->tx : &deflate->rx;
+        if (!*slot) {
+            *slot = uvhttp_ws_zstream_new(deflater);
+        }
+        zs = *slot;
+    }
+
+    if (zs) {
+        if (deflater) {
+            deflateReset(zs);
+        } else {
+            inflateReset(zs);
+        }
+    }
+    return zs;
+}
+
+/* Compress a message payload. Returns 1 and a buffer the caller frees when
+ * the result is smaller than the input, 0 to send the payload as is. */
+static int uvhttp_ws_deflate_payload(z_stream* zs, const uint8_t* in,
+                                     size_t len, uint8_t** out,
+                                     size_t* out_len) {
+    if (len > UINT_MAX / 2) {
+        return 0; /* z_stream counts in uInt */
+    }
+    size_t cap = (size_t)deflateBound(zs, (uLong)len) + 16;
+    uint8_t* buf = uvhttp_alloc(cap);
+    if (!buf) {
+        return 0;
+    }
+
+    zs->next_in = (unsigned char*)in;
+    zs->avail_in = (unsigned int)len;
+    zs->next_out = buf;
+    zs->avail_out = (unsigned int)cap;
+    int ret = deflate(zs, Z_SYNC_FLUSH);
+    size_t n = cap - zs->avail_out;
+
+    if (ret != Z_OK || zs->avail_in != 0 || n < sizeof(WS_DEFLATE_TAIL) ||
+        memcmp(buf + n - sizeof(WS_DEFLATE_TAIL), WS_DEFLATE_TAIL,
+               sizeof(WS_DEFLATE_TAIL)) != 0 ||
+        n - sizeof(WS_DEFLATE_TAIL) >= len) {
+        uvhttp_free(buf);
+        return 0;
+    }
+
+    *out = buf;
+    *out_len = n - sizeof(WS_DEFLATE_TAIL);
+    return 1;
+}
+
+/* Inflate a received message into a new buffer, bounded by
+ * max_message_size so a small frame cannot expand without limit */
+static uvhttp_error_t uvhttp_ws_inflate_payload(
+    struct uvhttp_ws_connection* conn, const uint8_t* in, size_t len,
+    uint8_t** out, size_t* out_len) {
+    if (len > UINT_MAX) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    z_stream* zs = uvhttp_ws_zstream(conn, NULL, 0);
+    if (!zs) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+
+    size_t limit = conn->config.max_message_size > 0
+                       ? (size_t)conn->config.max_message_size
+                       : SIZE_MAX - 1;
+    size_t cap = len < 256 ? 1024 : len * 4;
+    if (cap > limit + 1) {
+        cap = limit + 1;
+    }
+    uint8_t* buf = uvhttp_alloc(cap);
+    if (!buf) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+
+    uvhttp_error_t result = UVHTTP_OK;
+    int stream_end = 0;
+    size_t n = 0;
+    for (int part = 0; part < 2 && !stream_end && result == UVHTTP_OK;
+         part++) {
+        zs->next_in = (unsigned char*)(part ? WS_DEFLATE_TAIL : in);
+        zs->avail_in = part ? sizeof(WS_DEFLATE_TAIL) : (unsigned int)len;
+
+        for (;;) {
+            if (n == cap) {
+                /* one byte past the limit proves the message is too big */
+                if (cap > limit) {
+                    result = UVHTTP_ERROR_INVALID_PARAM;
+                    break;
+                }
+                size_t new_cap = cap > (limit + 1) / 2 ? limit + 1 : cap * 2;
+                uint8_t* grown = uvhttp_realloc(buf, new_cap);
+                if (!grown) {
+                    result = UVHTTP_ERROR_OUT_OF_MEMORY;
+                    break;
+                }
+                buf = grown;
+                cap = new_cap;
+            }
+
+            size_t room = cap - n;
+            zs->next_out = buf + n;
+            zs->avail_out = room > UINT_MAX ? UINT_MAX : (unsigned int)room;
+            int ret = inflate(zs, Z_SYNC_FLUSH);
+            n = (size_t)(zs->next_out - buf);
+
+            if (ret == Z_STREAM_END) {
+                stream_end = 1;
+                break;
+            }
+            if (ret != Z_OK && ret != Z_BUF_ERROR) {
+                result = UVHTTP_ERROR_INVALID_PARAM;
+                break;
+            }
+            if (n < cap && zs->avail_in == 0) {
+                break; /* input consumed, output not exhausted */
+            }
+            if (ret == Z_BUF_ERROR && n < cap) {
+                result = UVHTTP_ERROR_INVALID_PARAM; /* no progress */
+                break;
+            }
+        }
+    }
+
+    if (stream_end) {
+        inflateReset(zs); /* a final block ends the peer's window too */
+    }
+    if (result == UVHTTP_OK && n > limit) {
+        result = UVHTTP_ERROR_INVALID_PARAM;
+    }
+    if (result != UVHTTP_OK) {
+        uvhttp_free(buf);
+        return result;
+    }
+
+    *out = buf;
+    *out_len = n;
+    return UVHTTP_OK;
+}
+
+/* Parse one Sec-WebSocket-Extensions element. Window bits are 0 when
+ * absent and -1 for a client_max_window_bits offer without a value.
+ * Returns 0 for a well-formed permessage-deflate element. */
+static int uvhttp_ws_deflate_parse(const char* s, size_t len,
+                                   uvhttp_ws_deflate_params_t* params) {
+    memset(params, 0, sizeof(*params));
+    const char* end = s + len;
+    int first = 1;
+    int seen_server_nct = 0, seen_client_nct = 0;
+
+    while (s < end) {
+        const char* sep = memchr(s, ';', (size_t)(end - s));
+        const char* tok_end = sep ? sep : end;
+
+        /* trim */
+        while (s < tok_end && (*s == ' ' || *s == '\t')) {
+            s++;
+        }
+        const char* t = tok_end;
+        while (t > s && (t[-1] == ' ' || t[-1] == '\t')) {
+            t--;
+        }
+
+        const char* eq = memchr(s, '=', (size_t)(t - s));
+        const char* name_end = eq ? eq : t;
+        while (name_end > s && (name_end[-1] == ' ' || name_end[-1] == '\t')) {
+            name_end--;
+        }
+        size_t name_len = (size_t)(name_end - s);
+
+        if (first) {
+            if (eq || name_len != 18 ||
+                strncasecmp(s, "permessage-deflate", 18) != 0) {
+                return -1;
+            }
+            first = 0;
+        } else {
+            int bits = 0;
+            if (eq) {
+                const char* v = eq + 1;
+                while (v < t && (*v == ' ' || *v == '\t')) {
+                    v++;
+                }
+                const char* v_end = t;
+                if (v_end - v >= 2 && *v == '"' && v_end[-1] == '"') {
+                    v++;
+                    v_end--;
+                }
+                if (v_end - v < 1 || v_end - v > 2) {
+                    return -1;
+                }
+                for (const char* c = v; c < v_end; c++) {
+                    if (*c < '0' || *c > '9') {
+                        return -1;
+                    }
+                    bits = bits * 10 + (*c - '0');
+                }
+                if ((v_end - v == 2 && *v == '0') || bits < 8 || bits > 15) {
+                    return -1;
+                }
+            }
+
+#    define WS_PARAM_IS(lit) \
+        (name_len == sizeof(lit) - 1 && strncasecmp(s, lit, name_len) == 0)
+            if (WS_PARAM_IS("server_no_context_takeover")) {
+                if (eq || seen_server_nct++) {
+                    return -1;
+                }
+                params->server_no_context_takeover = 1;
+            } else if (WS_PARAM_IS("client_no_context_takeover")) {
+                if (eq || seen_client_nct++) {
+                    return -1;
+                }
+                params->client_no_context_takeover = 1;
+            } else if (WS_PARAM_IS("server_max_window_bits")) {
+                if (!eq || params->server_max_window_bits) {
+                    return -1;
+                }
+                params->server_max_window_bits = bits;
+            } else if (WS_PARAM_IS("client_max_window_bits")) {
+                if (params->client_max_window_bits) {
+                    return -1;
+                }
+                params->client_max_window_bits = eq ? bits : -1;
+            } else {
+                return -1;
+            }
+#    undef WS_PARAM_IS
+        }
+
+        s = sep ? sep + 1 : end;
+    }
+
+    return first ? -1 : 0;
+}
+
+uvhttp_error_t uvhttp_ws_deflate_negotiate(const char* offers,
+                                           uvhttp_ws_deflate_params_t* params,
+                                           char* response,
+                                           size_t response_len) {
+    if (!offers || !params || !response || response_len == 0) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    const char* s = offers;
+    while (*s) {
+        const char* comma = strchr(s, ',');
+        size_t len = comma ? (size_t)(comma - s) : strlen(s);
+
+        uvhttp_ws_deflate_params_t offer;
+        /* our compressor cannot shrink its window below 2^15 */
+        if (uvhttp_ws_deflate_parse(s, len, &offer) == 0 &&
+            (offer.server_max_window_bits == 0 ||
+             offer.server_max_window_bits == 15)) {
+            int client_bits = 15;
+            if (offer.client_max_window_bits != 0) {
+                client_bits = UVHTTP_WEBSOCKET_DEFLATE_CLIENT_MAX_WINDOW_BITS;
+                if (offer.client_max_window_bits > 0 &&
+                    offer.client_max_window_bits < client_bits) {
+                    client_bits = offer.client_max_window_bits;
+                }
+            }
+
+            params->server_no_context_takeover = 1;
+            params->client_no_context_takeover =
+                offer.client_no_context_takeover ||
+                UVHTTP_WEBSOCKET_DEFLATE_CLIENT_NO_CONTEXT_TAKEOVER;
+            params->server_max_window_bits = 15;
+            params->client_max_window_bits = client_bits;
+
+            int n = snprintf(
+                response, response_len, "permessage-deflate; %s%s",
+                "server_no_context_takeover",
+                params->client_no_context_takeover
+                    ? "; client_no_context_takeover"
+                    : "");
+            if (n > 0 && (size_t)n < response_len && client_bits < 15) {
+                n += snprintf(response + n, response_len - (size_t)n,
+                              "; client_max_window_bits=%d", client_bits);
+            }
+            if (n < 0 || (size_t)n >= response_len) {
+                return UVHTTP_ERROR_INVALID_PARAM;
+            }
+            return UVHTTP_OK;
+        }
+
+        if (!comma) {
+            break;
+        }
+        s = comma + 1;
+    }
+
+    return UVHTTP_ERROR_NOT_FOUND;
+}
+
+uvhttp_error_t uvhttp_ws_enable_deflate(
+    struct uvhttp_ws_connection* conn,
+    const uvhttp_ws_deflate_params_t* params) {
+    if (!conn || !params) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    uvhttp_ws_deflate_t* deflate = uvhttp_calloc(1, sizeof(uvhttp_ws_deflate_t));
+    if (!deflate) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    deflate->params = *params;
+    deflate->peer_context_takeover =
+        conn->is_server ? !params->client_no_context_takeover
+                        : !params->server_no_context_takeover;
+
+    uvhttp_ws_deflate_free(conn->deflate);
+    conn->deflate = deflate;
+    conn->config.enable_compression = 1;
+    return UVHTTP_OK;
+}
+
+/* Value of a header in a raw HTTP message, or 0 if absent */
+static size_t uvhttp_ws_header_value(const char* msg, const char* name,
+                                     char* out, size_t out_len) {
+    const char* p = uvhttp_ws_strcasestr(msg, name);
+    if (!p || out_len == 0) {
+        return 0;
+    }
+    p += strlen(name);
+    if (*p != ':') {
+        return 0;
+    }
+    p++;
+    while (*p == ' ' || *p == '\t') {
+        p++;
+    }
+    size_t n = 0;
+    while (p[n] != '\r' && p[n] != '\n' && p[n] != '\0' && n < out_len - 1) {
+        out[n] = p[n];
+        n++;
+    }
+    out[n] = '\0';
+    return n;
+}
+
+#else /* !UVHTTP_FEATURE_COMPRESSION */
+
+uvhttp_error_t uvhttp_ws_deflate_negotiate(const char* offers,
+                                           uvhttp_ws_deflate_params_t* params,
+                                           char* response,
+                                           size_t response_len) {
+    if (!offers || !params || !response || response_len == 0) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    return UVHTTP_ERROR_NOT_FOUND;
+}
+
+uvhttp_error_t uvhttp_ws_enable_deflate(
+    struct uvhttp_ws_connection* conn,
+    const uvhttp_ws_deflate_params_t* params) {
+    (void)conn;
+    (void)params;
+    return UVHTTP_ERROR_NOT_SUPPORTED;
+}
+
+#endif /* UVHTTP_FEATURE_COMPRESSION */
+
 /* Create WebSocket connection */
 struct uvhttp_ws_connection* uvhttp_ws_connection_create(
     int fd, mbedtls_ssl_context* ssl, int is_server,
@@ -81,6 +594,8 @@ struct uvhttp_ws_connection* uvhttp_ws_connection_create(
     conn->ssl = ssl;
     conn->is_server = is_server;
     conn->state = UVHTTP_WS_STATE_CONNECTING;
+    conn->send_queue_max = UVHTTP_WEBSOCKET_DEFAULT_SEND_QUEUE_MAX;
+    conn->slow_consumer_policy = UVHTTP_WS_SLOW_CONSUMER_CLOSE;
 
     /* setconfig */
     if (config) {
@@ -88,6 +603,9 @@ struct uvhttp_ws_connection* uvhttp_ws_connection_create(
         conn->config.max_message_size = config->websocket_max_message_size;
         conn->config.ping_interval = config->websocket_ping_interval;
         conn->config.ping_timeout = config->websocket_ping_timeout;
+        conn->config.enable_compression = config->websocket_compression;
+        conn->config.compression_threshold =
+            config->websocket_compression_threshold;
     } else {
         /* use default config */
         conn->config.max_frame_size = UVHTTP_WEBSOCKET_DEFAULT_MAX_FRAME_SIZE;
@@ -95,6 +613,8 @@ struct uvhttp_ws_connection* uvhttp_ws_connection_create(
             UVHTTP_WEBSOCKET_DEFAULT_MAX_MESSAGE_SIZE;
         conn->config.ping_interval = UVHTTP_WEBSOCKET_DEFAULT_PING_INTERVAL;
         conn->config.ping_timeout = UVHTTP_WEBSOCKET_DEFAULT_PING_TIMEOUT;
+        conn->config.compression_threshold =
+            UVHTTP_WEBSOCKET_DEFAULT_COMPRESSION_THRESHOLD;
     }
 
     /* allocatereceivebuffer */
@@ -122,10 +642,21 @@ void uvhttp_ws_connection_free(struct uvhttp_ws_connection* conn) {
         uvhttp_free(conn->send_buffer);
     }
 
+    /* An in-flight write keeps its frames and releases them on completion;
+     * only detach it from this connection. */
+    if (conn->send_req) {
+        conn->send_req->conn = NULL;
+    }
+    uvhttp_ws_discard_queue(conn);
+
     if (conn->fragmented_message) {
         uvhttp_free(conn->fragmented_message);
     }
 
+#if UVHTTP_FEATURE_COMPRESSION
+    uvhttp_ws_deflate_free(conn->deflate);
+#endif
+
     uvhttp_free(conn);
 }
 
@@ -184,17 +715,7 @@ uvhttp_error_t uvhttp_ws_parse_frame_header(const uint8_t* data, size_t len,
     return UVHTTP_OK;
 }
 
-/* application masking */
-void uvhttp_ws_apply_mask(uint8_t* data, size_t len,
-                          const uint8_t* masking_key) {
-    if (!data || !masking_key) {
-        return;
-    }
-
-    for (size_t i = 0; i < len; i++) {
-        data[i] ^= masking_key[i % 4];
-    }
-}
+/* uvhttp_ws_apply_mask is in uvhttp_websocket_simd.c */
 
 /* build WebSocket frame
  * Returns the total wire size of the built frame on success (>= 0), or a
@@ -364,19 +885,43 @@ uvhttp_error_t uvhttp_ws_handshake_server(struct uvhttp_ws_connection* conn,
         return UVHTTP_ERROR_INVALID_PARAM;
     }
 
+    /* answer a permessage-deflate offer (RFC 7692) */
+    char extensions[192] = "";
+#if UVHTTP_FEATURE_COMPRESSION
+    uvhttp_ws_deflate_params_t deflate_params;
+    char offers[512];
+    char accepted[128];
+    if (conn->config.enable_compression &&
+        uvhttp_ws_header_value(request, UVHTTP_HEADER_WEBSOCKET_EXTENSIONS,
+                               offers, sizeof(offers)) > 0 &&
+        uvhttp_ws_deflate_negotiate(offers, &deflate_params, accepted,
+                                    sizeof(accepted)) == UVHTTP_OK) {
+        snprintf(extensions, sizeof(extensions), "%s: %s\r\n",
+                 UVHTTP_HEADER_WEBSOCKET_EXTENSIONS, accepted);
+    }
+#endif
+
     /* buildresponse */
     int len = snprintf(response, *response_len,
                        "HTTP/1.1 101 Switching Protocols\r\n"
                        "Upgrade: websocket\r\n"
                        "Connection: Upgrade\r\n"
                        "Sec-WebSocket-Accept: %s\r\n"
+                       "%s"
                        "\r\n",
-                       accept);
+                       accept, extensions);
 
     if (len < 0 || (size_t)len >= *response_len) {
         return UVHTTP_ERROR_INVALID_PARAM;
     }
 
+#if UVHTTP_FEATURE_COMPRESSION
+    if (extensions[0] != '\0' &&
+        uvhttp_ws_enable_deflate(conn, &deflate_params) != UVHTTP_OK) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+#endif
+
     *response_len = len;
     conn->state = UVHTTP_WS_STATE_OPEN;
 
@@ -407,6 +952,15 @@ uvhttp_error_t uvhttp_ws_handshake_client(uvhttp_context_t* context,
     /* save key to connection (for subsequent verification) */
     uvhttp_safe_strncpy(conn->client_key, (char*)base64_key, sizeof(conn->client_key));
 
+    /* offer permessage-deflate; we never keep our window across messages */
+    const char* extensions = "";
+#if UVHTTP_FEATURE_COMPRESSION
+    if (conn->config.enable_compression) {
+        extensions = UVHTTP_HEADER_WEBSOCKET_EXTENSIONS
+            ": permessage-deflate; client_no_context_takeover\r\n";
+    }
+#endif
+
     /* buildrequest */
     int len = snprintf(request, *request_len,
                        "GET %s HTTP/1.1\r\n"
@@ -415,8 +969,9 @@ uvhttp_error_t uvhttp_ws_handshake_client(uvhttp_context_t* context,
                        "Connection: Upgrade\r\n"
                        "Sec-WebSocket-Key: %s\r\n"
                        "Sec-WebSocket-Version: 13\r\n"
+                       "%s"
                        "\r\n",
-                       path, host, (char*)base64_key);
+                       path, host, (char*)base64_key, extensions);
 
     if (len < 0 || (size_t)len >= *request_len) {
         return UVHTTP_ERROR_INVALID_PARAM;
@@ -500,275 +1055,540 @@ uvhttp_error_t uvhttp_ws_verify_handshake_response(
         }
     }
 
+#if UVHTTP_FEATURE_COMPRESSION
+    /* the server may only accept what we offered: permessage-deflate
+     * without a client window limit */
+    char extensions[256];
+    if (uvhttp_ws_header_value(response, UVHTTP_HEADER_WEBSOCKET_EXTENSIONS,
+                               extensions, sizeof(extensions)) > 0) {
+        uvhttp_ws_deflate_params_t params;
+        if (!conn->config.enable_compression ||
+            uvhttp_ws_deflate_parse(extensions, strlen(extensions),
+                                    &params) != 0 ||
+            params.client_max_window_bits != 0) {
+            return UVHTTP_ERROR_INVALID_PARAM;
+        }
+        params.client_no_context_takeover = 1;
+        params.client_max_window_bits = 15;
+        if (params.server_max_window_bits == 0) {
+            params.server_max_window_bits = 15;
+        }
+        if (uvhttp_ws_enable_deflate(conn, &params) != UVHTTP_OK) {
+            return UVHTTP_ERROR_OUT_OF_MEMORY;
+        }
+    }
+#endif
+
     conn->state = UVHTTP_WS_STATE_OPEN;
 
     return UVHTTP_OK;
 }
 
-/* send WebSocket frame */
-uvhttp_error_t uvhttp_ws_send_frame(uvhttp_context_t* context,
-                                    struct uvhttp_ws_connection* conn,
-                                    const uint8_t* data, size_t len,
-                                    uvhttp_ws_opcode_t opcode) {
-    if (!conn || conn->state != UVHTTP_WS_STATE_OPEN) {
-        return UVHTTP_ERROR_INVALID_PARAM;
+size_t uvhttp_ws_get_buffered_amount(const struct uvhttp_ws_connection* conn) {
+    if (!conn) {
+        return 0;
     }
-
-    /* allocatesendbuffer (guard the 10+len+4 sum against overflow) */
-    if (len > SIZE_MAX - 14) {
-        return UVHTTP_ERROR_INVALID_PARAM;
+    size_t buffered = conn->send_queued_bytes;
+    /* TLS frames are encrypted on send; whatever the kernel did not take
+     * waits in the stream's own write queue. */
+    if (conn->transport && conn->ssl) {
+        buffered += uv_stream_get_write_queue_size(
+            (const uv_stream_t*)&conn->transport->tcp_handle);
     }
-    size_t buffer_size =
-        10 + len + 4; /* maximum frame header + payload + masking */
-    uint8_t* buffer = uvhttp_alloc(buffer_size);
-    if (!buffer) {
+    return buffered;
+}
+
+uvhttp_error_t uvhttp_ws_set_send_queue(
+    struct uvhttp_ws_connection* conn, size_t max_bytes,
+    uvhttp_ws_slow_consumer_policy_t policy) {
+    if (!conn || (policy != UVHTTP_WS_SLOW_CONSUMER_CLOSE &&
+                  policy != UVHTTP_WS_SLOW_CONSUMER_DROP)) {
         return UVHTTP_ERROR_INVALID_PARAM;
     }
+    conn->send_queue_max = max_bytes;
+    conn->slow_consumer_policy = policy;
+    return UVHTTP_OK;
+}
 
-    /* build frame (client needs masking) */
-    long frame_len_long =
-        uvhttp_ws_build_frame(context, buffer, buffer_size, data, len, opcode,
-                              conn->is_server ? 0 : 1, 1);
-    if (frame_len_long < 0) {
-        uvhttp_free(buffer);
-        return UVHTTP_ERROR_INVALID_PARAM;
+void uvhttp_ws_set_drain_callback(struct uvhttp_ws_connection* conn,
+                                  uvhttp_ws_on_drain_callback on_drain) {
+    if (conn) {
+        conn->on_drain = on_drain;
     }
-    /* frame_len fits in int here because buffer_size is capped by the
-     * allocator and len is bounded by SIZE_MAX - 14; keep the arithmetic
-     * below in size_t where possible. */
-    size_t frame_len = (size_t)frame_len_long;
+}
 
-    /* senddata */
-    int ret;
-    if (conn->ssl) {
-        /* mbedtls_ssl_write emits at most one TLS record (~16KB) per call;
-         * loop until the whole frame is flushed. Without this, frames larger
-         * than one record are truncated on the wire (clients stall waiting
-         * for the missing tail). */
-        size_t sent = 0;
-        int want_retries = 0;
-        while (sent < (size_t)frame_len) {
-            ret = mbedtls_ssl_write(conn->ssl, buffer + sent,
-                                    (size_t)frame_len - sent);
-            if (ret > 0) {
-                sent += (size_t)ret;
-                want_retries = 0;
-                continue;
-            }
-            if (ret == MBEDTLS_ERR_SSL_WANT_READ ||
-                ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
-                if (++want_retries > 100) {
-                    break;
-                }
-                struct timespec ts;
-                ts.tv_sec = 0;
-                ts.tv_nsec = 1000000; /* 1ms */
-                nanosleep(&ts, NULL);
-                continue;
-            }
-            break;
-        }
-        if (sent == 0) {
-            uvhttp_free(buffer);
-            return UVHTTP_ERROR_INVALID_PARAM;
-        }
-        ret = (int)sent;
-    } else {
-        ret = send(conn->fd, buffer, frame_len, 0);
-        if (ret < 0) {
-            uvhttp_free(buffer);
-            return UVHTTP_ERROR_CONNECTION_BROKEN;
-        }
+/* Apply the queue budget to a frame about to be sent */
+static uvhttp_error_t uvhttp_ws_admit(struct uvhttp_ws_connection* conn,
+                                      size_t frame_len,
+                                      uvhttp_ws_opcode_t opcode) {
+    if (conn->send_queue_max == 0 || opcode >= UVHTTP_WS_OPCODE_CLOSE) {
+        return UVHTTP_OK;
+    }
+    size_t buffered = uvhttp_ws_get_buffered_amount(conn);
+    if (buffered == 0 || (buffered <= conn->send_queue_max &&
+                          frame_len <= conn->send_queue_max - buffered)) {
+        return UVHTTP_OK;
     }
 
-    conn->bytes_sent += ret;
-    conn->frames_sent++;
+    conn->drain_pending = 1;
+    if (conn->slow_consumer_policy == UVHTTP_WS_SLOW_CONSUMER_DROP) {
+        conn->frames_dropped++;
+        return UVHTTP_ERROR_WEBSOCKET_SLOW_CONSUMER;
+    }
 
-    /* Release the send buffer on the success path too. Previously the
-     * buffer leaked on every successful send (review S2); only the two
-     * error paths freed it. */
-    uvhttp_free(buffer);
-    return UVHTTP_OK;
+    UVHTTP_LOG_WARN("WebSocket slow consumer: %zu bytes buffered, closing\n",
+                    buffered);
+    uvhttp_ws_discard_queue(conn);
+    conn->state = UVHTTP_WS_STATE_CLOSING;
+    if (conn->on_error) {
+        conn->on_error(conn, UVHTTP_ERROR_WEBSOCKET_SLOW_CONSUMER,
+                       "send queue limit exceeded");
+    }
+    return UVHTTP_ERROR_WEBSOCKET_SLOW_CONSUMER;
 }
 
-/* sendtextmessage */
-uvhttp_error_t uvhttp_ws_send_text(uvhttp_context_t* context,
-                                   struct uvhttp_ws_connection* conn,
-                                   const char* text, size_t len) {
-    return uvhttp_ws_send_frame(context, conn, (const uint8_t*)text, len,
-                                UVHTTP_WS_OPCODE_TEXT);
-}
+static void uvhttp_ws_write_cb(uv_write_t* req, int status) {
+    uvhttp_ws_write_req_t* wreq = (uvhttp_ws_write_req_t*)req->data;
+    struct uvhttp_ws_connection* conn = wreq->conn;
 
-/* sendbinarymessage */
-uvhttp_error_t uvhttp_ws_send_binary(uvhttp_context_t* context,
-                                     struct uvhttp_ws_connection* conn,
-                                     const uint8_t* data, size_t len) {
-    return uvhttp_ws_send_frame(context, conn, data, len,
-                                UVHTTP_WS_OPCODE_BINARY);
-}
+    uvhttp_ws_free_frames(wreq->frames);
+    if (conn) {
+        conn->send_req = NULL;
+        conn->send_queued_bytes -= wreq->bytes;
+    }
+    uvhttp_free(wreq);
 
-/* send Ping */
-uvhttp_error_t uvhttp_ws_send_ping(uvhttp_context_t* context,
-                                   struct uvhttp_ws_connection* conn,
-                                   const uint8_t* data, size_t len) {
-    return uvhttp_ws_send_frame(context, conn, data, len,
-                                UVHTTP_WS_OPCODE_PING);
+    if (!conn) {
+        return; /* connection freed while the write was in flight */
+    }
+    if (status < 0) {
+        if (status != UV_ECANCELED) {
+            UVHTTP_LOG_ERROR("WebSocket write failed: %s\n",
+                             uv_strerror(status));
+        }
+        uvhttp_ws_discard_queue(conn);
+        return;
+    }
+    uvhttp_ws_flush(conn);
 }
 
-/* send Pong */
-uvhttp_error_t uvhttp_ws_send_pong(uvhttp_context_t* context,
-                                   struct uvhttp_ws_connection* conn,
-                                   const uint8_t* data, size_t len) {
-    return uvhttp_ws_send_frame(context, conn, data, len,
-                                UVHTTP_WS_OPCODE_PONG);
+/* Hand queued frames to the stream, coalescing them into one writev */
+static uvhttp_error_t uvhttp_ws_submit(struct uvhttp_ws_connection* conn) {
+    if (conn->send_req || !conn->send_head) {
+        return UVHTTP_OK;
+    }
+
+    uv_stream_t* stream = (uv_stream_t*)&conn->transport->tcp_handle;
+    if (uv_is_closing((uv_handle_t*)stream)) {
+        uvhttp_ws_discard_queue(conn);
+        return UVHTTP_ERROR_CONNECTION_BROKEN;
+    }
+
+    uvhttp_ws_write_req_t* wreq = uvhttp_calloc(1, sizeof(*wreq));
+    if (!wreq) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+
+    unsigned int nbufs = 0;
+    uvhttp_ws_out_frame_t* last = NULL;
+    uvhttp_ws_out_frame_t* frame = conn->send_head;
+    while (frame && nbufs < UVHTTP_WEBSOCKET_WRITEV_MAX) {
+        wreq->bufs[nbufs++] = uv_buf_init((char*)frame->data, frame->len);
+        wreq->bytes += frame->len;
+        last = frame;
+        frame = frame->next;
+    }
+    wreq->frames = conn->send_head;
+    last->next = NULL;
+    conn->send_head = frame;
+    if (!frame) {
+        conn->send_tail = NULL;
+    }
+
+    wreq->conn = conn;
+    wreq->req.data = wreq;
+    if (uv_write(&wreq->req, stream, wreq->bufs, nbufs, uvhttp_ws_write_cb) !=
+        0) {
+        conn->send_queued_bytes -= wreq->bytes;
+        uvhttp_ws_free_frames(wreq->frames);
+        uvhttp_free(wreq);
+        uvhttp_ws_discard_queue(conn);
+        return UVHTTP_ERROR_CONNECTION_BROKEN;
+    }
+    conn->send_req = wreq;
+    return UVHTTP_OK;
 }
 
-/* closeconnection */
-uvhttp_error_t uvhttp_ws_close(uvhttp_context_t* context,
-                               struct uvhttp_ws_connection* conn, int code,
-                               const char* reason) {
+uvhttp_error_t uvhttp_ws_flush(struct uvhttp_ws_connection* conn) {
     if (!conn) {
         return UVHTTP_ERROR_INVALID_PARAM;
     }
+    if (!conn->transport) {
+        return UVHTTP_OK;
+    }
 
-    /* send_frame requires state == OPEN; move to CLOSING only after the
-     * close frame has been handed to the send path (setting it first made
-     * this function always fail with UVHTTP_ERROR_INVALID_PARAM) */
+    uvhttp_error_t ret = uvhttp_ws_submit(conn);
+    if (ret != UVHTTP_OK) {
+        return ret;
+    }
 
-    /* buildcloseframe — use heap to avoid ASan false positive where the
-     * conn parameter parameter is misidentified as underflowing a stack
-     * array (ASan confuses the two due to stack frame reuse) */
-    uint8_t* payload = (uint8_t*)uvhttp_alloc(128);
-    if (!payload) {
-        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    if (conn->drain_pending && uvhttp_ws_get_buffered_amount(conn) == 0) {
+        conn->drain_pending = 0;
+        if (conn->on_drain) {
+            conn->on_drain(conn);
+        }
     }
-    payload[0] = (code >> 8) & 0xFF;
-    payload[1] = code & 0xFF;
+    return UVHTTP_OK;
+}
+
+/* Write a frame directly to fd/ssl (connections without a transport) */
+static uvhttp_error_t uvhttp_ws_write_direct(struct uvhttp_ws_connection* conn,
+                                             const uint8_t* buf, size_t len) {
+    size_t sent = 0;
+    while (sent < len) {
+        ssize_t ret;
+        if (conn->ssl) {
+            /* mbedtls_ssl_write emits at most one record per call */
+            ret = mbedtls_ssl_write(conn->ssl, buf + sent, len - sent);
+            if (ret == MBEDTLS_ERR_SSL_WANT_READ ||
+                ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+                break;
+            }
+        } else {
+            ret = send(conn->fd, buf + sent, len - sent, 0);
+            if (ret < 0 && errno == EINTR) {
+                continue;
+            }
+        }
+        if (ret <= 0) {
+            break;
+        }
+        sent += (size_t)ret;
+    }
+
+    if (sent == 0) {
+        return conn->ssl ? UVHTTP_ERROR_INVALID_PARAM
+                         : UVHTTP_ERROR_CONNECTION_BROKEN;
+    }
+    conn->bytes_sent += sent;
+    return sent == len ? UVHTTP_OK : UVHTTP_ERROR_CONNECTION_BROKEN;
+}
 
+/* Hand an encoded frame to the connection's write path. Takes ownership
+ * of the queue entry. */
+static uvhttp_error_t uvhttp_ws_dispatch(struct uvhttp_ws_connection* conn,
+                                         uvhttp_ws_out_frame_t* frame) {
     uvhttp_error_t ret;
-    if (reason) {
-        size_t reason_len = strlen(reason);
-        if (reason_len > 125) {
-            reason_len = 125;
+
+    if (!conn->transport) {
+        ret = uvhttp_ws_write_direct(conn, frame->data, frame->len);
+        uvhttp_ws_free_frames(frame);
+        if (ret == UVHTTP_OK) {
+            conn->frames_sent++;
         }
-        memcpy(payload + 2, reason, reason_len);
+        return ret;
+    }
 
-        ret = uvhttp_ws_send_frame(context, conn, payload, 2 + reason_len,
-                                   UVHTTP_WS_OPCODE_CLOSE);
+    if (conn->ssl) {
+        /* The transport's TLS BIO hands ciphertext the kernel cannot take
+         * yet to uv_write, so this never waits on the socket. */
+        ret = uvhttp_connection_tls_write(conn->transport, frame->data,
+                                          frame->len);
+        if (ret == UVHTTP_OK) {
+            conn->bytes_sent += frame->len;
+            conn->frames_sent++;
+        }
+        uvhttp_ws_free_frames(frame);
     } else {
-        ret = uvhttp_ws_send_frame(context, conn, payload, 2,
-                                   UVHTTP_WS_OPCODE_CLOSE);
+        if (conn->send_tail) {
+            conn->send_tail->next = frame;
+        } else {
+            conn->send_head = frame;
+        }
+        conn->send_tail = frame;
+        conn->send_queued_bytes += frame->len;
+        conn->bytes_sent += frame->len;
+        conn->frames_sent++;
+        ret = uvhttp_ws_submit(conn);
     }
 
-    conn->state = UVHTTP_WS_STATE_CLOSING;
-    uvhttp_free(payload);
+    if (ret == UVHTTP_OK && uvhttp_ws_get_buffered_amount(conn) > 0) {
+        conn->drain_pending = 1;
+    }
     return ret;
 }
 
-/* receive WebSocket frame */
-uvhttp_error_t uvhttp_ws_recv_frame(struct uvhttp_ws_connection* conn,
-                                    uvhttp_ws_frame_t* frame) {
-    if (!conn || !frame) {
+#if UVHTTP_FEATURE_COMPRESSION
+/* data messages at or above the threshold go out compressed once
+ * permessage-deflate is negotiated */
+static int uvhttp_ws_should_deflate(const struct uvhttp_ws_connection* conn,
+                                    uvhttp_ws_opcode_t opcode, size_t len) {
+    return conn->deflate && len > 0 &&
+           (opcode == UVHTTP_WS_OPCODE_TEXT ||
+            opcode == UVHTTP_WS_OPCODE_BINARY) &&
+           len >= (size_t)conn->config.compression_threshold;
+}
+#endif
+
+static uvhttp_error_t uvhttp_ws_send_built(uvhttp_context_t* context,
+                                           struct uvhttp_ws_connection* conn,
+                                           const uint8_t* data, size_t len,
+                                           uvhttp_ws_opcode_t opcode,
+                                           int rsv1);
+
+/* send WebSocket frame */
+uvhttp_error_t uvhttp_ws_send_frame(uvhttp_context_t* context,
+                                    struct uvhttp_ws_connection* conn,
+                                    const uint8_t* data, size_t len,
+                                    uvhttp_ws_opcode_t opcode) {
+    if (!conn || conn->state != UVHTTP_WS_STATE_OPEN) {
         return UVHTTP_ERROR_INVALID_PARAM;
     }
 
-    memset(frame, 0, sizeof(uvhttp_ws_frame_t));
+#if UVHTTP_FEATURE_COMPRESSION
+    if (uvhttp_ws_should_deflate(conn, opcode, len)) {
+        z_stream* zs = uvhttp_ws_zstream(conn, context, 1);
+        uint8_t* compressed = NULL;
+        size_t compressed_len = 0;
+        if (zs && uvhttp_ws_deflate_payload(zs, data, len, &compressed,
+                                            &compressed_len)) {
+            uvhttp_error_t ret = uvhttp_ws_send_built(
+                context, conn, compressed, compressed_len, opcode, 1);
+            uvhttp_free(compressed);
+            if (ret == UVHTTP_OK) {
+                conn->messages_compressed++;
+            }
+            return ret;
+        }
+    }
+#endif
+
+    return uvhttp_ws_send_built(context, conn, data, len, opcode, 0);
+}
 
-    /* read first two bytes of the header */
-    uint8_t header[10];
-    int ret;
+/* frame one payload into a queue entry and hand it to the transport */
+static uvhttp_error_t uvhttp_ws_send_built(uvhttp_context_t* context,
+                                           struct uvhttp_ws_connection* conn,
+                                           const uint8_t* data, size_t len,
+                                           uvhttp_ws_opcode_t opcode,
+                                           int rsv1) {
+    /* guard the 10+len+4 sum (maximum header + payload + masking key)
+     * against overflow */
+    if (len > SIZE_MAX - 14 - sizeof(uvhttp_ws_out_frame_t)) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    size_t buffer_size = 10 + len + 4;
 
-    if (conn->ssl) {
-        ret = mbedtls_ssl_read(conn->ssl, header, 2);
-    } else {
-        ret = recv(conn->fd, header, 2, 0);
+    if (conn->transport) {
+        uvhttp_error_t ret = uvhttp_ws_admit(conn, buffer_size, opcode);
+        if (ret != UVHTTP_OK) {
+            return ret;
+        }
     }
 
-    if (ret != 2) {
+    /* The frame is built straight into a queue entry so the plain-socket
+     * path can hand it to uv_write without another copy. */
+    uvhttp_ws_out_frame_t* frame =
+        uvhttp_alloc(sizeof(uvhttp_ws_out_frame_t) + buffer_size);
+    if (!frame) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+
+    /* build frame (client needs masking) */
+    long frame_len_long =
+        uvhttp_ws_build_frame(context, frame->inline_data, buffer_size, data,
+                              len, opcode, conn->is_server ? 0 : 1, 1);
+    if (frame_len_long < 0) {
+        uvhttp_free(frame);
         return UVHTTP_ERROR_INVALID_PARAM;
     }
+    if (rsv1) {
+        frame->inline_data[0] |= 0x40;
+    }
+    frame->next = NULL;
+    frame->shared = NULL;
+    frame->data = frame->inline_data;
+    frame->len = (size_t)frame_len_long;
 
-    /* Determine the full header size from the length code before parsing:
-     * parsing with only the first 2 bytes would reject 126/127 frames
-     * outright (uvhttp_ws_parse_frame_header requires len >= 4/10). */
-    size_t header_size = 2;
-    uint8_t len_code = header[1] & 0x7F;
-    if (len_code == 126) {
-        header_size = 4;
-    } else if (len_code == 127) {
-        header_size = 10;
+    return uvhttp_ws_dispatch(conn, frame);
+}
+
+/* build a shared server frame */
+uvhttp_error_t uvhttp_ws_shared_frame_create(const uint8_t* payload,
+                                             size_t len,
+                                             uvhttp_ws_opcode_t opcode,
+                                             uvhttp_ws_shared_frame_t** frame) {
+    if (!frame || (!payload && len > 0) ||
+        len > SIZE_MAX - 10 - sizeof(uvhttp_ws_shared_frame_t)) {
+        return UVHTTP_ERROR_INVALID_PARAM;
     }
+    *frame = NULL;
 
-    /* read the extended payload length, if any */
-    if (header_size > 2) {
-        if (conn->ssl) {
-            ret = mbedtls_ssl_read(conn->ssl, header + 2, header_size - 2);
-        } else {
-            ret = recv(conn->fd, header + 2, header_size - 2, 0);
-        }
+    size_t buffer_size = 10 + len;
+    uvhttp_ws_shared_frame_t* shared =
+        uvhttp_alloc(sizeof(uvhttp_ws_shared_frame_t) + buffer_size);
+    if (!shared) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
 
-        if (ret != (int)(header_size - 2)) {
-            return UVHTTP_ERROR_INVALID_PARAM;
-        }
+    /* server frames are never masked, so no context is needed */
+    long frame_len = uvhttp_ws_build_frame(NULL, shared->data, buffer_size,
+                                           payload, len, opcode, 0, 1);
+    if (frame_len < 0) {
+        uvhttp_free(shared);
+        return UVHTTP_ERROR_INVALID_PARAM;
     }
+    shared->refcount = 1;
+    shared->opcode = opcode;
+    shared->len = (size_t)frame_len;
+    shared->header_len = (size_t)frame_len - len;
+    shared->deflated = NULL;
+    shared->deflate_tried = 0;
 
-    /* parse frame header */
-    if (uvhttp_ws_parse_frame_header(header, header_size, &frame->header,
-                                     &header_size) != 0) {
+    *frame = shared;
+    return UVHTTP_OK;
+}
+
+/* queue a shared frame on one connection */
+uvhttp_error_t uvhttp_ws_send_shared(struct uvhttp_ws_connection* conn,
+                                     uvhttp_ws_shared_frame_t* frame) {
+    if (!conn || !frame || conn->state != UVHTTP_WS_STATE_OPEN ||
+        !conn->is_server) {
         return UVHTTP_ERROR_INVALID_PARAM;
     }
 
-    /* read masking key (if any) */
-    if (frame->header.mask) {
-        if (conn->ssl) {
-            ret = mbedtls_ssl_read(conn->ssl, frame->masking_key, 4);
-        } else {
-            ret = recv(conn->fd, frame->masking_key, 4, 0);
+#if UVHTTP_FEATURE_COMPRESSION
+    /* every deflate recipient shares one compressed copy: our side never
+     * takes over context, so the compressed bytes do not depend on the
+     * connection */
+    size_t payload_len = frame->len - frame->header_len;
+    if (uvhttp_ws_should_deflate(conn, frame->opcode, payload_len)) {
+        if (!frame->deflate_tried) {
+            frame->deflate_tried = 1;
+            z_stream* zs = uvhttp_ws_zstream(conn, NULL, 1);
+            uint8_t* compressed = NULL;
+            size_t compressed_len = 0;
+            if (zs && uvhttp_ws_deflate_payload(
+                          zs, frame->data + frame->header_len, payload_len,
+                          &compressed, &compressed_len)) {
+                if (uvhttp_ws_shared_frame_create(
+                        compressed, compressed_len, frame->opcode,
+                        &frame->deflated) == UVHTTP_OK) {
+                    frame->deflated->data[0] |= 0x40;
+                }
+                uvhttp_free(compressed);
+            }
         }
-
-        if (ret != 4) {
-            return UVHTTP_ERROR_INVALID_PARAM;
+        if (frame->deflated) {
+            conn->messages_compressed++;
+            frame = frame->deflated;
         }
     }
+#endif
 
-    /* read payload */
-    if (frame->header.payload_length > 0) {
-        if (frame->header.payload_length > (uint64_t)conn->config.max_frame_size) {
-            return UVHTTP_ERROR_INVALID_PARAM;
+    if (conn->transport) {
+        uvhttp_error_t ret = uvhttp_ws_admit(conn, frame->len, frame->opcode);
+        if (ret != UVHTTP_OK) {
+            return ret;
         }
+    }
 
-        frame->payload = uvhttp_alloc((size_t)frame->header.payload_length);
-        if (!frame->payload) {
-            return UVHTTP_ERROR_INVALID_PARAM;
-        }
+    uvhttp_ws_out_frame_t* entry = uvhttp_alloc(sizeof(uvhttp_ws_out_frame_t));
+    if (!entry) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    frame->refcount++;
+    entry->next = NULL;
+    entry->shared = frame;
+    entry->data = frame->data;
+    entry->len = frame->len;
 
-        frame->payload_size = (size_t)frame->header.payload_length;
+    return uvhttp_ws_dispatch(conn, entry);
+}
 
-        if (conn->ssl) {
-            ret = mbedtls_ssl_read(conn->ssl, frame->payload,
-                                   frame->header.payload_length);
-        } else {
-            ret = recv(conn->fd, frame->payload, frame->header.payload_length,
-                       0);
-        }
+/* sendtextmessage */
+uvhttp_error_t uvhttp_ws_send_text(uvhttp_context_t* context,
+                                   struct uvhttp_ws_connection* conn,
+                                   const char* text, size_t len) {
+    return uvhttp_ws_send_frame(context, conn, (const uint8_t*)text, len,
+                                UVHTTP_WS_OPCODE_TEXT);
+}
 
-        if (ret != (int)frame->header.payload_length) {
-            uvhttp_free(frame->payload);
-            frame->payload = NULL;
-            return UVHTTP_ERROR_INVALID_PARAM;
-        }
+/* sendbinarymessage */
+uvhttp_error_t uvhttp_ws_send_binary(uvhttp_context_t* context,
+                                     struct uvhttp_ws_connection* conn,
+                                     const uint8_t* data, size_t len) {
+    return uvhttp_ws_send_frame(context, conn, data, len,
+                                UVHTTP_WS_OPCODE_BINARY);
+}
+
+/* send Ping */
+uvhttp_error_t uvhttp_ws_send_ping(uvhttp_context_t* context,
+                                   struct uvhttp_ws_connection* conn,
+                                   const uint8_t* data, size_t len) {
+    return uvhttp_ws_send_frame(context, conn, data, len,
+                                UVHTTP_WS_OPCODE_PING);
+}
+
+/* send Pong */
+uvhttp_error_t uvhttp_ws_send_pong(uvhttp_context_t* context,
+                                   struct uvhttp_ws_connection* conn,
+                                   const uint8_t* data, size_t len) {
+    return uvhttp_ws_send_frame(context, conn, data, len,
+                                UVHTTP_WS_OPCODE_PONG);
+}
+
+/* closeconnection */
+uvhttp_error_t uvhttp_ws_close(uvhttp_context_t* context,
+                               struct uvhttp_ws_connection* conn, int code,
+                               const char* reason) {
+    if (!conn) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    /* send_frame requires state == OPEN; move to CLOSING only after the
+     * close frame has been handed to the send path (setting it first made
+     * this function always fail with UVHTTP_ERROR_INVALID_PARAM) */
 
-        /* application masking (if any) */
-        if (frame->header.mask) {
-            uvhttp_ws_apply_mask(frame->payload, frame->header.payload_length,
-                                 frame->masking_key);
+    /* buildcloseframe — use heap to avoid ASan false positive where the
+     * conn parameter parameter is misidentified as underflowing a stack
+     * array (ASan confuses the two due to stack frame reuse) */
+    uint8_t* payload = (uint8_t*)uvhttp_alloc(128);
+    if (!payload) {
+        return UVHTTP_ERROR_OUT_OF_MEMORY;
+    }
+    payload[0] = (code >> 8) & 0xFF;
+    payload[1] = code & 0xFF;
+
+    uvhttp_error_t ret;
+    if (reason) {
+        size_t reason_len = strlen(reason);
+        if (reason_len > 125) {
+            reason_len = 125;
         }
+        memcpy(payload + 2, reason, reason_len);
+
+        ret = uvhttp_ws_send_frame(context, conn, payload, 2 + reason_len,
+                                   UVHTTP_WS_OPCODE_CLOSE);
+    } else {
+        ret = uvhttp_ws_send_frame(context, conn, payload, 2,
+                                   UVHTTP_WS_OPCODE_CLOSE);
     }
 
-    conn->bytes_received += frame->header.payload_length;
-    conn->frames_received++;
+    conn->state = UVHTTP_WS_STATE_CLOSING;
+    uvhttp_free(payload);
+    return ret;
+}
 
-    return UVHTTP_OK;
+/* whether the fragmented message in progress was sent compressed */
+static int uvhttp_ws_fragment_compressed(
+    const struct uvhttp_ws_connection* conn) {
+#if UVHTTP_FEATURE_COMPRESSION
+    return conn->deflate && conn->deflate->rx_message_compressed;
+#else
+    (void)conn;
+    return 0;
+#endif
 }
 
 /* Append payload_len bytes to the in-progress fragmented message.
@@ -818,276 +1638,396 @@ static uvhttp_error_t uvhttp_ws_fragment_append(
     memcpy(conn->fragmented_message + conn->fragmented_size, payload,
            payload_len);
     conn->fragmented_size += payload_len;
-    return UVHTTP_OK;
-}
 
-/* process received data */
-uvhttp_error_t uvhttp_ws_process_data(struct uvhttp_ws_connection* conn,
-                                      const uint8_t* data, size_t len) {
-    if (!conn || !data) {
+    /* validate text as it arrives so a bad first fragment closes the
+     * connection before the rest is buffered; compressed text is checked
+     * once inflated */
+    if (conn->fragmented_opcode == UVHTTP_WS_OPCODE_TEXT &&
+        !uvhttp_ws_fragment_compressed(conn) &&
+        !uvhttp_ws_utf8_validate(&conn->fragmented_utf8, payload,
+                                 payload_len)) {
         return UVHTTP_ERROR_INVALID_PARAM;
     }
+    return UVHTTP_OK;
+}
 
-    /* add data to receive buffer */
-    if (conn->recv_buffer_pos + len > conn->recv_buffer_size) {
-        /* buffer insufficient, need to expand */
-        size_t new_size = conn->recv_buffer_size;
-
-        /* check if exceeds maximum limit */
-        if (new_size > SIZE_MAX / 2) {
-            return UVHTTP_ERROR_INVALID_PARAM; /* overflow protection */
-        }
-
-        new_size *= 2;
-
-        /* check if meets requirement */
-        while (conn->recv_buffer_pos + len > new_size) {
-            if (new_size > SIZE_MAX / 2) {
-                return UVHTTP_ERROR_INVALID_PARAM; /* overflow protection */
-            }
-            new_size *= 2;
-        }
+/* Text must be valid UTF-8 (RFC 6455 §8.1) */
+static int uvhttp_ws_text_valid(const uint8_t* data, size_t len) {
+    uvhttp_ws_utf8_state_t utf8;
+    uvhttp_ws_utf8_init(&utf8);
+    return uvhttp_ws_utf8_validate(&utf8, data, len) &&
+           uvhttp_ws_utf8_complete(&utf8);
+}
 
-        /* check if exceeds config's maximum size */
-        if (new_size > (size_t)conn->config.max_frame_size) {
-            new_size = (size_t)conn->config.max_frame_size;
-            if (conn->recv_buffer_pos + len > new_size) {
-                return UVHTTP_ERROR_INVALID_PARAM; /* exceeds maximum limit */
-            }
+/* Hand a complete message to on_message, inflating it first when it was
+ * sent compressed. Fails when the payload does not inflate, inflates past
+ * max_message_size, or is text that is not UTF-8. Uncompressed text is
+ * expected to be validated by the caller. */
+static uvhttp_error_t uvhttp_ws_deliver_message(
+    struct uvhttp_ws_connection* conn, const uint8_t* payload, size_t len,
+    uvhttp_ws_opcode_t opcode, int compressed) {
+#if UVHTTP_FEATURE_COMPRESSION
+    if (compressed) {
+        uint8_t* message = NULL;
+        size_t message_len = 0;
+        uvhttp_error_t ret = uvhttp_ws_inflate_payload(conn, payload, len,
+                                                       &message, &message_len);
+        if (ret != UVHTTP_OK) {
+            return ret;
         }
-
-        uint8_t* new_buffer = uvhttp_realloc(conn->recv_buffer, new_size);
-        if (!new_buffer) {
+        if (opcode == UVHTTP_WS_OPCODE_TEXT &&
+            !uvhttp_ws_text_valid(message, message_len)) {
+            uvhttp_free(message);
             return UVHTTP_ERROR_INVALID_PARAM;
         }
-
-        conn->recv_buffer = new_buffer;
-        conn->recv_buffer_size = new_size;
+        if (conn->on_message) {
+            conn->on_message(conn, (const char*)message, message_len, opcode);
+        }
+        uvhttp_free(message);
+        return UVHTTP_OK;
+    }
+#else
+    (void)compressed;
+#endif
+    if (conn->on_message) {
+        conn->on_message(conn, (const char*)payload, len, opcode);
     }
+    return UVHTTP_OK;
+}
 
-    memcpy(conn->recv_buffer + conn->recv_buffer_pos, data, len);
-    conn->recv_buffer_pos += len;
+/* Reject a frame the connection cannot accept, before its payload is read */
+static uvhttp_error_t uvhttp_ws_check_header(
+    const struct uvhttp_ws_connection* conn,
+    const uvhttp_ws_frame_header_t* header) {
+    /* RFC 6455 §5.2: an RSV bit no negotiated extension defines is a
+     * protocol error and the connection MUST be closed (review M1).
+     * permessage-deflate defines RSV1 on the first frame of a data
+     * message only (RFC 7692 §6). */
+    if (header->rsv2 || header->rsv3) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    if (header->rsv1 &&
+        (!conn->deflate || (header->opcode != UVHTTP_WS_OPCODE_TEXT &&
+                            header->opcode != UVHTTP_WS_OPCODE_BINARY))) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
 
-    /* process complete frame */
-    while (conn->recv_buffer_pos >= 2) {
-        uvhttp_ws_frame_header_t header;
-        size_t header_size;
-
-        if (uvhttp_ws_parse_frame_header(conn->recv_buffer,
-                                         conn->recv_buffer_pos, &header,
-                                         &header_size) != 0) {
-            /* Distinguish "need more data" (partial header buffered) from a
-             * genuine protocol error (e.g. the length-code-127 high bit being
-             * set — review M3). With a partial header we must wait for the
-             * rest of the frame; otherwise the frame is malformed and the
-             * connection must be closed rather than silently skipping it. */
-            uint8_t len_code = conn->recv_buffer[1] & 0x7F;
-            size_t need =
-                (len_code == 126) ? 4 : (len_code == 127) ? 10 : 2;
-            if (conn->recv_buffer_pos < need) {
-                break;
-            }
+    /* RFC 6455 §5.5/§5.6: control frames (CLOSE/PING/PONG) MUST have a
+     * payload <= 125 bytes and MUST NOT be fragmented (FIN must be set);
+     * violations are protocol errors (review M2). */
+    if (header->opcode >= UVHTTP_WS_OPCODE_CLOSE) {
+        if (header->payload_length > 125 || !header->fin) {
             return UVHTTP_ERROR_INVALID_PARAM;
         }
+    }
 
-        /* RFC 6455 §5.2: when no extension is in use, a nonzero RSV bit is
-         * a protocol error and the connection MUST be closed (review M1). */
-        if (header.rsv1 || header.rsv2 || header.rsv3) {
-            return UVHTTP_ERROR_INVALID_PARAM;
-        }
+    /* RFC 6455 §5.1: client-to-server frames MUST be masked; a server
+     * receiving an unmasked frame MUST close the connection. */
+    if (conn->is_server && !header->mask) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
 
-        /* RFC 6455 §5.5/§5.6: control frames (CLOSE/PING/PONG) MUST have a
-         * payload <= 125 bytes and MUST NOT be fragmented (FIN must be set);
-         * violations are protocol errors (review M2). */
-        if (header.opcode >= UVHTTP_WS_OPCODE_CLOSE) {
-            if (header.payload_length > 125 || !header.fin) {
-                return UVHTTP_ERROR_INVALID_PARAM;
-            }
-        }
+    /* Reject frames whose declared payload exceeds the configured limit.
+     * Without this, a 64-bit (length code 127) wire length such as
+     * 2^64-1 makes the frame size wrap around size_t, the "enough data"
+     * check passes with only the header present, and
+     * uvhttp_ws_apply_mask runs an out-of-bounds write. */
+    if (header->payload_length > (uint64_t)conn->config.max_frame_size) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    return UVHTTP_OK;
+}
 
-        /* RFC 6455 §5.1: client-to-server frames MUST be masked; a server
-         * receiving an unmasked frame MUST close the connection. */
-        if (conn->is_server && !header.mask) {
-            return UVHTTP_ERROR_INVALID_PARAM;
+/* Size up the frame at the start of buf, of which avail bytes are present.
+ * Returns 0 with *frame_len set to its wire size when the whole frame is
+ * present, 1 with *frame_len set to the bytes needed before it can be sized
+ * further, or -1 on a protocol error. */
+static int uvhttp_ws_frame_extent(const struct uvhttp_ws_connection* conn,
+                                  const uint8_t* buf, size_t avail,
+                                  uvhttp_ws_frame_header_t* header,
+                                  size_t* header_size, size_t* frame_len) {
+    if (avail < 2) {
+        *frame_len = 2;
+        return 1;
+    }
+
+    if (uvhttp_ws_parse_frame_header(buf, avail, header, header_size) != 0) {
+        /* Distinguish "need more data" (partial header) from a genuine
+         * protocol error (e.g. the length-code-127 high bit being set —
+         * review M3). With a partial header we must wait for the rest of
+         * the frame; otherwise the frame is malformed and the connection
+         * must be closed rather than silently skipping it. */
+        uint8_t len_code = buf[1] & 0x7F;
+        size_t need = (len_code == 126) ? 4 : (len_code == 127) ? 10 : 2;
+        if (avail < need) {
+            *frame_len = need;
+            return 1;
         }
+        return -1;
+    }
 
-        /* Reject frames whose declared payload exceeds the configured limit.
-         * Without this, a 64-bit (length code 127) wire length such as
-         * 2^64-1 makes header_size + payload_length wrap around size_t, the
-         * "enough data" check below passes with only the header buffered,
-         * and uvhttp_ws_apply_mask runs an out-of-bounds write. */
-        if (header.payload_length > (uint64_t)conn->config.max_frame_size) {
-            return UVHTTP_ERROR_INVALID_PARAM;
-        }
+    if (uvhttp_ws_check_header(conn, header) != UVHTTP_OK) {
+        return -1;
+    }
 
-        /* check if has enough data (payload_length is bounded by
-         * max_frame_size above, so this sum cannot overflow) */
-        size_t total_frame_size = header_size + (size_t)header.payload_length;
-        if (header.mask) {
-            total_frame_size += 4;
-        }
+    /* payload_length is bounded by max_frame_size above, so this sum cannot
+     * overflow */
+    *frame_len = *header_size + (header->mask ? 4 : 0) +
+                 (size_t)header->payload_length;
+    return avail < *frame_len ? 1 : 0;
+}
 
-        if (conn->recv_buffer_pos < total_frame_size) {
-            break;
+/* Act on one complete frame. frame points at its first byte in a buffer
+ * the parser owns for the duration of the call: a masked payload is
+ * unmasked where it lies, and a single-frame message reaches on_message as
+ * a slice of that buffer. */
+static uvhttp_error_t uvhttp_ws_handle_frame(
+    struct uvhttp_ws_connection* conn, const uvhttp_ws_frame_header_t* header,
+    uint8_t* frame, size_t header_size) {
+    uint8_t* payload = NULL;
+
+    if (header->payload_length > 0) {
+        payload = frame + header_size;
+
+        if (header->mask) {
+            uint8_t masking_key[4];
+            memcpy(masking_key, payload, 4);
+            payload += 4;
+            uvhttp_ws_apply_mask(payload, header->payload_length,
+                                 masking_key);
         }
+    }
 
-        /* extract payload */
-        uint8_t* payload = NULL;
-
-        if (header.payload_length > 0) {
-            payload = conn->recv_buffer + header_size;
-
-            if (header.mask) {
-                uint8_t masking_key[4] = {0};
-                memcpy(masking_key, conn->recv_buffer + header_size, 4);
-                payload += 4;
-                uvhttp_ws_apply_mask(payload, header.payload_length,
-                                     masking_key);
+    if (header->opcode == UVHTTP_WS_OPCODE_TEXT ||
+        header->opcode == UVHTTP_WS_OPCODE_BINARY ||
+        header->opcode == UVHTTP_WS_OPCODE_CONTINUATION) {
+        /* RFC 6455 §5.4 fragment state machine (review S3: CONTINUATION
+         * frames used to be silently dropped, so multi-frame messages
+         * never completed):
+         * - fresh TEXT/BINARY with FIN=1 and no pending fragment is a
+         *   complete message;
+         * - fresh TEXT/BINARY with FIN=0 starts a fragmented message;
+         * - CONTINUATION frames extend the pending message; FIN=1
+         *   completes it;
+         * - CONTINUATION with no pending message, or a fresh TEXT/BINARY
+         *   while a fragment is pending, is a protocol error (§5.6) and
+         *   the connection must be closed. */
+        if (conn->fragmented_message == NULL) {
+            if (header->opcode == UVHTTP_WS_OPCODE_CONTINUATION) {
+                /* continuation with no initial fragment — protocol
+                 * violation */
+                return UVHTTP_ERROR_INVALID_PARAM;
             }
-        }
-
-        /* processframe */
-        if (header.opcode == UVHTTP_WS_OPCODE_TEXT ||
-            header.opcode == UVHTTP_WS_OPCODE_BINARY ||
-            header.opcode == UVHTTP_WS_OPCODE_CONTINUATION) {
-            /* RFC 6455 §5.4 fragment state machine (review S3: CONTINUATION
-             * frames used to be silently dropped, so multi-frame messages
-             * never completed):
-             * - fresh TEXT/BINARY with FIN=1 and no pending fragment is a
-             *   complete message;
-             * - fresh TEXT/BINARY with FIN=0 starts a fragmented message;
-             * - CONTINUATION frames extend the pending message; FIN=1
-             *   completes it;
-             * - CONTINUATION with no pending message, or a fresh TEXT/BINARY
-             *   while a fragment is pending, is a protocol error (§5.6) and
-             *   the connection must be closed. */
-            if (conn->fragmented_message == NULL) {
-                if (header.opcode == UVHTTP_WS_OPCODE_CONTINUATION) {
-                    /* continuation with no initial fragment — protocol
-                     * violation */
-                    return UVHTTP_ERROR_INVALID_PARAM;
+            if (!header->fin) {
+                /* start a new fragmented message */
+#if UVHTTP_FEATURE_COMPRESSION
+                if (conn->deflate) {
+                    conn->deflate->rx_message_compressed = header->rsv1;
                 }
-                if (!header.fin) {
-                    /* start a new fragmented message */
-                    conn->fragmented_opcode = header.opcode;
-                    conn->fragmented_size = 0;
-                    conn->fragmented_capacity = 0;
-                    conn->fragmented_message = NULL;
-                    if (uvhttp_ws_fragment_append(
-                            conn, payload,
-                            (size_t)header.payload_length) != UVHTTP_OK) {
-                        return UVHTTP_ERROR_INVALID_PARAM;
-                    }
-                } else {
-                    /* complete message */
-                    if (conn->on_message) {
-                        conn->on_message(conn, (const char*)payload,
-                                         (size_t)header.payload_length,
-                                         header.opcode);
-                    }
+#endif
+                uvhttp_ws_utf8_init(&conn->fragmented_utf8);
+                conn->fragmented_opcode = header->opcode;
+                conn->fragmented_size = 0;
+                conn->fragmented_capacity = 0;
+                conn->fragmented_message = NULL;
+                if (uvhttp_ws_fragment_append(
+                        conn, payload, (size_t)header->payload_length) !=
+                    UVHTTP_OK) {
+                    return UVHTTP_ERROR_INVALID_PARAM;
                 }
             } else {
-                /* a fragmented message is in progress; only CONTINUATION
-                 * frames may extend it */
-                if (header.opcode != UVHTTP_WS_OPCODE_CONTINUATION) {
-                    /* a fresh data frame interrupting a fragmented message
-                     * — protocol violation */
+                /* complete message */
+                if (header->opcode == UVHTTP_WS_OPCODE_TEXT &&
+                    !header->rsv1 &&
+                    !uvhttp_ws_text_valid(payload,
+                                          (size_t)header->payload_length)) {
                     return UVHTTP_ERROR_INVALID_PARAM;
                 }
-                if (uvhttp_ws_fragment_append(
-                        conn, payload,
-                        (size_t)header.payload_length) != UVHTTP_OK) {
+                if (uvhttp_ws_deliver_message(
+                        conn, payload, (size_t)header->payload_length,
+                        header->opcode, header->rsv1) != UVHTTP_OK) {
                     return UVHTTP_ERROR_INVALID_PARAM;
                 }
-                if (header.fin) {
-                    /* message complete — deliver and reset */
-                    if (conn->on_message) {
-                        conn->on_message(
-                            conn, (const char*)conn->fragmented_message,
-                            conn->fragmented_size,
-                            conn->fragmented_opcode);
-                    }
-                    uvhttp_free(conn->fragmented_message);
-                    conn->fragmented_message = NULL;
-                    conn->fragmented_size = 0;
-                    conn->fragmented_capacity = 0;
-                }
             }
-        } else if (header.opcode == UVHTTP_WS_OPCODE_CLOSE) {
-            /* closeframe */
-            int close_code = 1000;
-            const char* close_reason = "";
-
-            if (header.payload_length >= 2) {
-                close_code = (payload[0] << 8) | payload[1];
-                if (header.payload_length > 2) {
-                    close_reason = (const char*)(payload + 2);
+        } else {
+            /* a fragmented message is in progress; only CONTINUATION
+             * frames may extend it */
+            if (header->opcode != UVHTTP_WS_OPCODE_CONTINUATION) {
+                /* a fresh data frame interrupting a fragmented message
+                 * — protocol violation */
+                return UVHTTP_ERROR_INVALID_PARAM;
+            }
+            if (uvhttp_ws_fragment_append(conn, payload,
+                                          (size_t)header->payload_length) !=
+                UVHTTP_OK) {
+                return UVHTTP_ERROR_INVALID_PARAM;
+            }
+            if (header->fin) {
+                /* message complete — deliver and reset */
+                int compressed = uvhttp_ws_fragment_compressed(conn);
+                uvhttp_error_t delivered = UVHTTP_ERROR_INVALID_PARAM;
+                if (compressed ||
+                    conn->fragmented_opcode != UVHTTP_WS_OPCODE_TEXT ||
+                    uvhttp_ws_utf8_complete(&conn->fragmented_utf8)) {
+                    delivered = uvhttp_ws_deliver_message(
+                        conn, conn->fragmented_message, conn->fragmented_size,
+                        conn->fragmented_opcode, compressed);
+                }
+                uvhttp_free(conn->fragmented_message);
+                conn->fragmented_message = NULL;
+                conn->fragmented_size = 0;
+                conn->fragmented_capacity = 0;
+                if (delivered != UVHTTP_OK) {
+                    return UVHTTP_ERROR_INVALID_PARAM;
                 }
             }
-
-            /* Capture the server context BEFORE on_close runs: the close
-             * callback (on_websocket_close) frees the wrapper and nulls
-             * user_data, so reading user_data after it would return NULL and
-             * the close-frame echo below could never fire. */
-            uvhttp_ws_wrapper_t* wrapper =
-                (uvhttp_ws_wrapper_t*)conn->user_data;
-            uvhttp_context_t* srv_ctx = NULL;
-            if (wrapper && wrapper->conn && wrapper->conn->server &&
-                wrapper->conn->server->context) {
-                srv_ctx = wrapper->conn->server->context;
+        }
+    } else if (header->opcode == UVHTTP_WS_OPCODE_CLOSE) {
+        /* closeframe */
+        int close_code = 1000;
+        const char* close_reason = "";
+
+        if (header->payload_length >= 2) {
+            close_code = (payload[0] << 8) | payload[1];
+            if (header->payload_length > 2) {
+                close_reason = (const char*)(payload + 2);
             }
+        }
 
-            if (conn->on_close) {
-                conn->on_close(conn, close_code, close_reason);
-            }
+        /* Capture the server context BEFORE on_close runs: the close
+         * callback (on_websocket_close) frees the wrapper and nulls
+         * user_data, so reading user_data after it would return NULL and
+         * the close-frame echo below could never fire. */
+        uvhttp_ws_wrapper_t* wrapper = (uvhttp_ws_wrapper_t*)conn->user_data;
+        uvhttp_context_t* srv_ctx = NULL;
+        if (wrapper && wrapper->conn && wrapper->conn->server &&
+            wrapper->conn->server->context) {
+            srv_ctx = wrapper->conn->server->context;
+        }
 
-            /* Echo a close frame back (RFC 6455 §5.5.1) so the peer is not
-             * left waiting for the close handshake; best effort, only when
-             * the connection is wired to a server context. */
-            if (srv_ctx) {
-                uint8_t close_payload[2 + 125];
-                size_t close_len = 0;
-                if (header.payload_length >= 2) {
-                    close_payload[0] = payload[0];
-                    close_payload[1] = payload[1];
-                    close_len = 2;
-                    size_t reason_len =
-                        (size_t)header.payload_length - 2;
-                    if (reason_len > 125) {
-                        reason_len = 125;
-                    }
-                    if (reason_len > 0) {
-                        memcpy(close_payload + 2, payload + 2,
-                               reason_len);
-                        close_len = 2 + reason_len;
-                    }
+        if (conn->on_close) {
+            conn->on_close(conn, close_code, close_reason);
+        }
+
+        /* Echo a close frame back (RFC 6455 §5.5.1) so the peer is not
+         * left waiting for the close handshake; best effort, only when
+         * the connection is wired to a server context. */
+        if (srv_ctx) {
+            uint8_t close_payload[2 + 125];
+            size_t close_len = 0;
+            if (header->payload_length >= 2) {
+                close_payload[0] = payload[0];
+                close_payload[1] = payload[1];
+                close_len = 2;
+                size_t reason_len = (size_t)header->payload_length - 2;
+                if (reason_len > 125) {
+                    reason_len = 125;
+                }
+                if (reason_len > 0) {
+                    memcpy(close_payload + 2, payload + 2, reason_len);
+                    close_len = 2 + reason_len;
                 }
-                uvhttp_ws_send_frame(srv_ctx, conn, close_payload,
-                                     close_len, UVHTTP_WS_OPCODE_CLOSE);
             }
+            uvhttp_ws_send_frame(srv_ctx, conn, close_payload, close_len,
+                                 UVHTTP_WS_OPCODE_CLOSE);
+        }
 
-            conn->state = UVHTTP_WS_STATE_CLOSED;
-        } else if (header.opcode == UVHTTP_WS_OPCODE_PING) {
-            /* automatically reply Pong */
-            /* get wrapper from conn->user_data, then get conn, then get */
-            /* server->context */
-            uvhttp_ws_wrapper_t* wrapper =
-                (uvhttp_ws_wrapper_t*)conn->user_data;
-            if (wrapper && wrapper->conn) {
-                uvhttp_connection_t* http_conn = wrapper->conn;
-                if (http_conn && http_conn->server &&
-                    http_conn->server->context) {
-                    uvhttp_ws_send_pong(http_conn->server->context, conn,
-                                        payload, header.payload_length);
-                }
+        conn->state = UVHTTP_WS_STATE_CLOSED;
+    } else if (header->opcode == UVHTTP_WS_OPCODE_PING) {
+        /* automatically reply Pong */
+        /* get wrapper from conn->user_data, then get conn, then get */
+        /* server->context */
+        uvhttp_ws_wrapper_t* wrapper = (uvhttp_ws_wrapper_t*)conn->user_data;
+        if (wrapper && wrapper->conn) {
+            uvhttp_connection_t* http_conn = wrapper->conn;
+            if (http_conn && http_conn->server &&
+                http_conn->server->context) {
+                uvhttp_ws_send_pong(http_conn->server->context, conn, payload,
+                                    header->payload_length);
             }
         }
-        /* PONG frame usually does not need special processing */
+    }
+    /* PONG frame usually does not need special processing */
+
+    return UVHTTP_OK;
+}
+
+/* Make room for need bytes in recv_buffer. It holds at most one frame, so
+ * check_header bounds it by max_frame_size plus the largest header. */
+static uvhttp_error_t uvhttp_ws_stage_reserve(struct uvhttp_ws_connection* conn,
+                                              size_t need) {
+    if (need <= conn->recv_buffer_size) {
+        return UVHTTP_OK;
+    }
+
+    size_t new_size = conn->recv_buffer_size ? conn->recv_buffer_size : need;
+    while (new_size < need) {
+        if (new_size > SIZE_MAX / 2) {
+            return UVHTTP_ERROR_INVALID_PARAM; /* overflow protection */
+        }
+        new_size *= 2;
+    }
+    if (new_size > (size_t)conn->config.max_frame_size +
+                       UVHTTP_WEBSOCKET_FRAME_HEADER_SIZE + 4) {
+        new_size = need;
+    }
+
+    uint8_t* new_buffer = uvhttp_realloc(conn->recv_buffer, new_size);
+    if (!new_buffer) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    conn->recv_buffer = new_buffer;
+    conn->recv_buffer_size = new_size;
+    return UVHTTP_OK;
+}
+
+/* Complete the frame staged in recv_buffer from the front of *data,
+ * advancing *data and *len past what was taken. With stage_all set every
+ * frame passes through recv_buffer, for input the parser may not write to;
+ * otherwise this returns once nothing is staged so the rest of the input
+ * can be parsed where it lies. */
+static uvhttp_error_t uvhttp_ws_process_staged(
+    struct uvhttp_ws_connection* conn, const uint8_t** data, size_t* len,
+    int stage_all) {
+    while (conn->recv_buffer_pos > 0 || (stage_all && *len > 0)) {
+        uvhttp_ws_frame_header_t header;
+        size_t header_size = 0;
+        size_t frame_len = 0;
+
+        int extent = uvhttp_ws_frame_extent(conn, conn->recv_buffer,
+                                            conn->recv_buffer_pos, &header,
+                                            &header_size, &frame_len);
+        if (extent < 0) {
+            return UVHTTP_ERROR_INVALID_PARAM;
+        }
+        if (extent > 0) {
+            if (*len == 0) {
+                break;
+            }
+            /* take only what this frame still needs */
+            size_t take = frame_len - conn->recv_buffer_pos;
+            if (take > *len) {
+                take = *len;
+            }
+            if (uvhttp_ws_stage_reserve(conn, frame_len) != UVHTTP_OK) {
+                return UVHTTP_ERROR_INVALID_PARAM;
+            }
+            memcpy(conn->recv_buffer + conn->recv_buffer_pos, *data, take);
+            conn->recv_buffer_pos += take;
+            *data += take;
+            *len -= take;
+            continue;
+        }
+
+        if (uvhttp_ws_handle_frame(conn, &header, conn->recv_buffer,
+                                   header_size) != UVHTTP_OK) {
+            return UVHTTP_ERROR_INVALID_PARAM;
+        }
 
         /* remove processed frame from buffer */
-        size_t remaining = conn->recv_buffer_pos - total_frame_size;
+        size_t remaining = conn->recv_buffer_pos - frame_len;
         if (remaining > 0) {
-            memmove(conn->recv_buffer, conn->recv_buffer + total_frame_size,
+            memmove(conn->recv_buffer, conn->recv_buffer + frame_len,
                     remaining);
         }
         conn->recv_buffer_pos = remaining;
@@ -1096,6 +2036,68 @@ uvhttp_error_t uvhttp_ws_process_data(struct uvhttp_ws_connection* conn,
     return UVHTTP_OK;
 }
 
+/* process received data */
+uvhttp_error_t uvhttp_ws_process_data(struct uvhttp_ws_connection* conn,
+                                      const uint8_t* data, size_t len) {
+    if (!conn || !data) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    if (uvhttp_ws_process_staged(conn, &data, &len, 1) != UVHTTP_OK) {
+        /* the connection is failed; drop the offending frame */
+        conn->recv_buffer_pos = 0;
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    return UVHTTP_OK;
+}
+
+/* process received data, parsing and unmasking it in the caller's buffer */
+uvhttp_error_t uvhttp_ws_process_data_inplace(
+    struct uvhttp_ws_connection* conn, uint8_t* data, size_t len) {
+    if (!conn || !data) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    /* finish a frame split across reads first */
+    const uint8_t* rest = data;
+    size_t rest_len = len;
+    if (uvhttp_ws_process_staged(conn, &rest, &rest_len, 0) != UVHTTP_OK) {
+        conn->recv_buffer_pos = 0;
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+
+    uint8_t* frame = data + (len - rest_len);
+    while (rest_len > 0) {
+        uvhttp_ws_frame_header_t header;
+        size_t header_size = 0;
+        size_t frame_len = 0;
+
+        int extent = uvhttp_ws_frame_extent(conn, frame, rest_len, &header,
+                                            &header_size, &frame_len);
+        if (extent < 0) {
+            return UVHTTP_ERROR_INVALID_PARAM;
+        }
+        if (extent > 0) {
+            /* the frame continues in the next read: stage what arrived */
+            if (uvhttp_ws_stage_reserve(conn, frame_len) != UVHTTP_OK) {
+                return UVHTTP_ERROR_INVALID_PARAM;
+            }
+            memcpy(conn->recv_buffer, frame, rest_len);
+            conn->recv_buffer_pos = rest_len;
+            break;
+        }
+
+        if (uvhttp_ws_handle_frame(conn, &header, frame, header_size) !=
+            UVHTTP_OK) {
+            return UVHTTP_ERROR_INVALID_PARAM;
+        }
+        frame += frame_len;
+        rest_len -= frame_len;
+    }
+
+    return UVHTTP_OK;
+}
+
 /* setcallbackfunction */
 void uvhttp_ws_set_callbacks(struct uvhttp_ws_connection* conn,
                              uvhttp_ws_on_message_callback on_message,
@@ -1217,6 +2219,21 @@ static uvhttp_error_t websocket_upgrade_handler(uvhttp_connection_t* conn,
 
     uvhttp_response_set_header(conn->response, UVHTTP_HEADER_WEBSOCKET_ACCEPT,
                                accept);
+
+    /* Answer a permessage-deflate offer; the handshake below negotiates the
+     * same parameters again for the connection object */
+    const char* offers = uvhttp_request_get_header(
+        conn->request, UVHTTP_HEADER_WEBSOCKET_EXTENSIONS);
+    char extensions[128];
+    uvhttp_ws_deflate_params_t deflate_params;
+    if (offers && conn->server && conn->server->config &&
+        conn->server->config->websocket_compression &&
+        uvhttp_ws_deflate_negotiate(offers, &deflate_params, extensions,
+                                    sizeof(extensions)) == UVHTTP_OK) {
+        uvhttp_response_set_header(conn->response,
+                                   UVHTTP_HEADER_WEBSOCKET_EXTENSIONS,
+                                   extensions);
+    }
     uvhttp_response_send(conn->response);
 
     /* Call WebSocket handshake handling */
@@ -0,0 +1,440 @@
+/* UVHTTP WebSocket payload codecs - frame unmasking and UTF-8 validation.
+ * Every client frame is masked and every text message must be valid UTF-8,
+ * so both run over each inbound byte. Implementations are picked once from
+ * the CPU: AVX2, SSE2, or a portable 64-bit word loop.
+ */
+
+#include "uvhttp_websocket.h"
+
+#include "uvhttp_platform.h"
+
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#    define UVHTTP_WS_X86 1
+#    include <immintrin.h>
+#    define UVHTTP_WS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+typedef void (*uvhttp_ws_mask_fn)(uint8_t* data, size_t len, uint32_t key);
+typedef int (*uvhttp_ws_utf8_fn)(const uint8_t* data, size_t len,
+                                 size_t* valid);
+
+/* ========== Unmasking ========== */
+
+/* key is the masking key as it sits in memory, so XOR-ing a native word
+ * applies key byte i to data byte i whatever the byte order */
+
+static void uvhttp_ws_mask_scalar(uint8_t* data, size_t len, uint32_t key) {
+    uint8_t k[4];
+    memcpy(k, &key, 4);
+    for (size_t i = 0; i < len; i++) {
+        data[i] ^= k[i & 3];
+    }
+}
+
+static void uvhttp_ws_mask_word(uint8_t* data, size_t len, uint32_t key) {
+    uint64_t key64 = ((uint64_t)key << 32) | key;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        word ^= key64;
+        memcpy(data + i, &word, 8);
+    }
+    uvhttp_ws_mask_scalar(data + i, len - i, key);
+}
+
+#if defined(UVHTTP_WS_X86) && defined(__SSE2__)
+static void uvhttp_ws_mask_sse2(uint8_t* data, size_t len, uint32_t key) {
+    __m128i key128 = _mm_set1_epi32((int)key);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        _mm_storeu_si128((__m128i*)(data + i), _mm_xor_si128(v, key128));
+    }
+    uvhttp_ws_mask_word(data + i, len - i, key);
+}
+#endif
+
+#ifdef UVHTTP_WS_X86
+UVHTTP_WS_TARGET_AVX2
+static void uvhttp_ws_mask_avx2(uint8_t* data, size_t len, uint32_t key) {
+    __m256i key256 = _mm256_set1_epi32((int)key);
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(data + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(data + i + 32));
+        _mm256_storeu_si256((__m256i*)(data + i), _mm256_xor_si256(a, key256));
+        _mm256_storeu_si256((__m256i*)(data + i + 32),
+                            _mm256_xor_si256(b, key256));
+    }
+    for (; i + 32 <= len; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(data + i));
+        _mm256_storeu_si256((__m256i*)(data + i), _mm256_xor_si256(a, key256));
+    }
+    uvhttp_ws_mask_word(data + i, len - i, key);
+}
+#endif
+
+/* ========== UTF-8 validation ========== */
+
+/* Byte-at-a-time automaton shared by every level. need is the number of
+ * continuation bytes still expected; lo/hi bound the next one, which rules
+ * out overlongs, surrogates and code points past U+10FFFF (RFC 3629 §4). */
+static int uvhttp_ws_utf8_step(uvhttp_ws_utf8_state_t* st, uint8_t b) {
+    if (st->need) {
+        if (b < st->lo || b > st->hi) {
+            return 0;
+        }
+        st->need--;
+        st->lo = 0x80;
+        st->hi = 0xBF;
+        return 1;
+    }
+    if (b < 0x80) {
+        return 1;
+    }
+    st->lo = 0x80;
+    st->hi = 0xBF;
+    if (b >= 0xC2 && b <= 0xDF) {
+        st->need = 1;
+    } else if (b == 0xE0) {
+        st->need = 2;
+        st->lo = 0xA0;
+    } else if (b == 0xED) {
+        st->need = 2;
+        st->hi = 0x9F;
+    } else if (b >= 0xE1 && b <= 0xEF) {
+        st->need = 2;
+    } else if (b == 0xF0) {
+        st->need = 3;
+        st->lo = 0x90;
+    } else if (b >= 0xF1 && b <= 0xF3) {
+        st->need = 3;
+    } else if (b == 0xF4) {
+        st->need = 3;
+        st->hi = 0x8F;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+static int uvhttp_ws_utf8_scalar(uvhttp_ws_utf8_state_t* st,
+                                 const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (!uvhttp_ws_utf8_step(st, data[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* The fast paths store in *valid how many leading bytes they proved valid
+ * and return 0 if they found an error. They start on a character boundary
+ * and stop on one, leaving whatever follows to the automaton. */
+
+/* leading ASCII run, 8 bytes at a time */
+static int uvhttp_ws_utf8_ascii_word(const uint8_t* data, size_t len,
+                                     size_t* valid) {
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        if (word & 0x8080808080808080ULL) {
+            break;
+        }
+    }
+    *valid = i;
+    return 1;
+}
+
+#if defined(UVHTTP_WS_X86) && defined(__SSE2__)
+static int uvhttp_ws_utf8_ascii_sse2(const uint8_t* data, size_t len,
+                                     size_t* valid) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        if (_mm_movemask_epi8(v)) {
+            break;
+        }
+    }
+    *valid = i;
+    return 1;
+}
+#endif
+
+#ifdef UVHTTP_WS_X86
+/* Lookup-table validator after Keiser and Lemire, "Validating UTF-8 In Less
+ * Than One Instruction Per Byte" (2021). Each byte is classified from the
+ * nibbles of itself and its predecessor; the bits that survive the AND of
+ * the three lookups are errors. */
+#    define UTF8_TOO_SHORT (1 << 0)
+#    define UTF8_TOO_LONG (1 << 1)
+#    define UTF8_OVERLONG_3 (1 << 2)
+#    define UTF8_TOO_LARGE (1 << 3)
+#    define UTF8_SURROGATE (1 << 4)
+#    define UTF8_OVERLONG_2 (1 << 5)
+#    define UTF8_TOO_LARGE_1000 (1 << 6)
+#    define UTF8_OVERLONG_4 (1 << 6)
+#    define UTF8_TWO_CONTS (1 << 7)
+#    define UTF8_CARRY (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+#    define UTF8_TABLE(...) _mm256_setr_epi8(__VA_ARGS__, __VA_ARGS__)
+
+UVHTTP_WS_TARGET_AVX2
+static __m256i uvhttp_ws_utf8_prev(__m256i input, __m256i prev_input,
+                                   int n) {
+    __m256i joined = _mm256_permute2x128_si256(prev_input, input, 0x21);
+    switch (n) {
+    case 1:
+        return _mm256_alignr_epi8(input, joined, 15);
+    case 2:
+        return _mm256_alignr_epi8(input, joined, 14);
+    default:
+        return _mm256_alignr_epi8(input, joined, 13);
+    }
+}
+
+UVHTTP_WS_TARGET_AVX2
+static __m256i uvhttp_ws_utf8_check_block(__m256i input, __m256i prev_input) {
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    const __m256i byte_1_high_table = UTF8_TABLE(
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        (char)UTF8_TWO_CONTS, (char)UTF8_TWO_CONTS, (char)UTF8_TWO_CONTS,
+        (char)UTF8_TWO_CONTS, UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+        UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 |
+            UTF8_OVERLONG_4);
+    const __m256i byte_1_low_table = UTF8_TABLE(
+        (char)(UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 |
+               UTF8_OVERLONG_4),
+        (char)(UTF8_CARRY | UTF8_OVERLONG_2), (char)UTF8_CARRY,
+        (char)UTF8_CARRY, (char)(UTF8_CARRY | UTF8_TOO_LARGE),
+        (char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+        (char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+        (char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+        (char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+        (char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+        (char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+        (char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+        (char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+        (char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 |
+               UTF8_SURROGATE),
+        (char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+        (char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000));
+    const __m256i byte_2_high_table = UTF8_TABLE(
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        (char)(UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS |
+               UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4),
+        (char)(UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS |
+               UTF8_OVERLONG_3 | UTF8_TOO_LARGE),
+        (char)(UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS |
+               UTF8_SURROGATE | UTF8_TOO_LARGE),
+        (char)(UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS |
+               UTF8_SURROGATE | UTF8_TOO_LARGE),
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT);
+
+    __m256i prev1 = uvhttp_ws_utf8_prev(input, prev_input, 1);
+    __m256i byte_1_high = _mm256_shuffle_epi8(
+        byte_1_high_table,
+        _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble));
+    __m256i byte_1_low =
+        _mm256_shuffle_epi8(byte_1_low_table, _mm256_and_si256(prev1, nibble));
+    __m256i byte_2_high = _mm256_shuffle_epi8(
+        byte_2_high_table,
+        _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble));
+    __m256i special = _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low),
+                                       byte_2_high);
+
+    /* third and fourth bytes of a sequence must be continuations, which is
+     * exactly where TWO_CONTS is allowed */
+    __m256i prev2 = uvhttp_ws_utf8_prev(input, prev_input, 2);
+    __m256i prev3 = uvhttp_ws_utf8_prev(input, prev_input, 3);
+    __m256i third = _mm256_subs_epu8(prev2, _mm256_set1_epi8((char)(0xE0 - 0x80)));
+    __m256i fourth =
+        _mm256_subs_epu8(prev3, _mm256_set1_epi8((char)(0xF0 - 0x80)));
+    __m256i must23_80 = _mm256_and_si256(_mm256_or_si256(third, fourth),
+                                         _mm256_set1_epi8((char)0x80));
+    return _mm256_xor_si256(must23_80, special);
+}
+
+UVHTTP_WS_TARGET_AVX2
+static int uvhttp_ws_utf8_avx2(const uint8_t* data, size_t len,
+                               size_t* valid) {
+    /* a block ending mid-sequence is an error only if the next block does
+     * not finish it */
+    const __m256i max_complete = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, (char)(0xF0 - 1),
+        (char)(0xE0 - 1), (char)(0xC0 - 1));
+    __m256i prev_input = _mm256_setzero_si256();
+    __m256i prev_incomplete = _mm256_setzero_si256();
+    __m256i error = _mm256_setzero_si256();
+    size_t i = 0;
+    int last_ascii = 1;
+
+    for (; i + 32 <= len; i += 32) {
+        __m256i input = _mm256_loadu_si256((const __m256i*)(data + i));
+        if (!_mm256_movemask_epi8(input)) {
+            error = _mm256_or_si256(error, prev_incomplete);
+            last_ascii = 1;
+        } else {
+            error = _mm256_or_si256(
+                error, uvhttp_ws_utf8_check_block(input, prev_input));
+            prev_incomplete = _mm256_subs_epu8(input, max_complete);
+            prev_input = input;
+            last_ascii = 0;
+        }
+        if ((i & 1023) == 992 && !_mm256_testz_si256(error, error)) {
+            return 0; /* fail fast on long messages */
+        }
+    }
+
+    if (!_mm256_testz_si256(error, error)) {
+        return 0;
+    }
+    /* the last character may run past the final block: hand it to the
+     * automaton from its lead byte */
+    *valid = i;
+    if (!last_ascii) {
+        for (size_t back = 1; back <= 3 && back <= i; back++) {
+            if (data[i - back] >= 0xC0) {
+                *valid = i - back;
+                break;
+            }
+        }
+    }
+    return 1;
+}
+#endif
+
+/* ========== Dispatch ========== */
+
+typedef struct {
+    uvhttp_ws_mask_fn mask;
+    uvhttp_ws_utf8_fn utf8;
+} uvhttp_ws_codec_t;
+
+static const uvhttp_ws_codec_t uvhttp_ws_codecs[UVHTTP_WS_SIMD_AVX2 + 1] = {
+    [UVHTTP_WS_SIMD_SCALAR] = {uvhttp_ws_mask_scalar, NULL},
+    [UVHTTP_WS_SIMD_WORD] = {uvhttp_ws_mask_word, uvhttp_ws_utf8_ascii_word},
+#if defined(UVHTTP_WS_X86) && defined(__SSE2__)
+    [UVHTTP_WS_SIMD_SSE2] = {uvhttp_ws_mask_sse2, uvhttp_ws_utf8_ascii_sse2},
+#endif
+#ifdef UVHTTP_WS_X86
+    [UVHTTP_WS_SIMD_AVX2] = {uvhttp_ws_mask_avx2, uvhttp_ws_utf8_avx2},
+#endif
+};
+
+/* Resolved on first use. Concurrent first calls store the same value, and
+ * the codecs are pure functions, so loops on several threads may share it. */
+static int uvhttp_ws_simd_resolved = -1;
+
+static int uvhttp_ws_simd_supported(uvhttp_ws_simd_level_t level) {
+    switch (level) {
+    case UVHTTP_WS_SIMD_SCALAR:
+    case UVHTTP_WS_SIMD_WORD:
+        return 1;
+#if defined(UVHTTP_WS_X86) && defined(__SSE2__)
+    case UVHTTP_WS_SIMD_SSE2:
+        return 1;
+#endif
+#ifdef UVHTTP_WS_X86
+    case UVHTTP_WS_SIMD_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return 0;
+    }
+}
+
+static const uvhttp_ws_codec_t* uvhttp_ws_codec(void) {
+    int level = uvhttp_ws_simd_resolved;
+    if (UVHTTP_UNLIKELY(level < 0)) {
+        level = (int)uvhttp_ws_get_simd_level();
+    }
+    return &uvhttp_ws_codecs[level];
+}
+
+uvhttp_ws_simd_level_t uvhttp_ws_get_simd_level(void) {
+    if (uvhttp_ws_simd_resolved < 0) {
+        int level = UVHTTP_WS_SIMD_AVX2;
+        while (!uvhttp_ws_simd_supported((uvhttp_ws_simd_level_t)level)) {
+            level--;
+        }
+        uvhttp_ws_simd_resolved = level;
+    }
+    return (uvhttp_ws_simd_level_t)uvhttp_ws_simd_resolved;
+}
+
+uvhttp_error_t uvhttp_ws_set_simd_level(uvhttp_ws_simd_level_t level) {
+    if ((int)level < UVHTTP_WS_SIMD_SCALAR ||
+        (int)level > UVHTTP_WS_SIMD_AVX2) {
+        return UVHTTP_ERROR_INVALID_PARAM;
+    }
+    if (!uvhttp_ws_simd_supported(level)) {
+        return UVHTTP_ERROR_NOT_SUPPORTED;
+    }
+    uvhttp_ws_simd_resolved = (int)level;
+    return UVHTTP_OK;
+}
+
+/* ========== Public entry points ========== */
+
+void uvhttp_ws_apply_mask(uint8_t* data, size_t len,
+                          const uint8_t* masking_key) {
+    if (!data || !masking_key) {
+        return;
+    }
+    uint32_t key;
+    memcpy(&key, masking_key, 4);
+    uvhttp_ws_codec()->mask(data, len, key);
+}
+
+void uvhttp_ws_utf8_init(uvhttp_ws_utf8_state_t* state) {
+    if (state) {
+        memset(state, 0, sizeof(*state));
+    }
+}
+
+int uvhttp_ws_utf8_validate(uvhttp_ws_utf8_state_t* state,
+                            const uint8_t* data, size_t len) {
+    if (!state || (!data && len > 0) || state->invalid) {
+        return 0;
+    }
+
+    /* finish a character split across calls before the fast path, which
+     * only starts on a boundary */
+    size_t i = 0;
+    while (state->need && i < len) {
+        if (!uvhttp_ws_utf8_step(state, data[i++])) {
+            state->invalid = 1;
+            return 0;
+        }
+    }
+
+    uvhttp_ws_utf8_fn fast = uvhttp_ws_codec()->utf8;
+    if (fast && i < len) {
+        size_t valid = 0;
+        if (!fast(data + i, len - i, &valid)) {
+            state->invalid = 1;
+            return 0;
+        }
+        i += valid;
+    }
+
+    if (!uvhttp_ws_utf8_scalar(state, data + i, len - i)) {
+        state->invalid = 1;
+        return 0;
+    }
+    return 1;
+}
+
+int uvhttp_ws_utf8_complete(const uvhttp_ws_utf8_state_t* state) {
+    return state && !state->invalid && state->need == 0;
+}
@@ -10,6 +10,8 @@
  *   clang -g -O1 -fsanitize=fuzzer,address -fno-omit-frame-pointer \
  *     -Iinclude -Ideps/llhttp/include \
  *     test/fuzz/fuzz_router.c src/uvhttp_router.c src/uvhttp_router_cache.c \
+ *     src/uvhttp_route_match.c src/uvhttp_router_frozen.c \
+ *     src/uvhttp_router_match_cache.c src/uvhttp_router_middleware.c \
  *     src/uvhttp_utils.c src/uvhttp_error.c deps/xxhash/xxhash.c \
  *     -o fuzz_router
  *
@@ -64,20 +66,40 @@ int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
     path[size] = '\0';
 
     static uvhttp_router_t* router = NULL;
+    static uvhttp_router_t* frozen = NULL;
     if (!router) {
         router = build_router();
-        if (!router) {
-            free(path);
-            return 0;
+        frozen = build_router();
+        if (!router || !frozen || uvhttp_router_freeze(frozen) != UVHTTP_OK) {
+            abort();
         }
     }
 
     /* Exercise the lookup + match paths. These must not read past the
-     * null terminator, leak, or corrupt memory for any input. */
-    (void)uvhttp_router_find_handler(router, path, "GET");
+     * null terminator, leak, or corrupt memory for any input. A frozen
+     * copy of the same routes must resolve every path identically. */
+    if (uvhttp_router_find_handler(router, path, "GET") !=
+        uvhttp_router_find_handler(frozen, path, "GET")) {
+        abort();
+    }
 
     uvhttp_route_match_t match;
-    (void)uvhttp_router_match(router, path, "GET", &match);
+    if (uvhttp_router_match(router, path, "GET", &match) == UVHTTP_OK) {
+        /* Decode every captured slice, including malformed escapes */
+        char value[64];
+        for (size_t i = 0; i < match.param_count; i++) {
+            size_t name_len = 0;
+            const char* name =
+                uvhttp_route_match_param_name(&match, i, &name_len);
+            char name_buf[64];
+            if (name && name_len < sizeof(name_buf)) {
+                memcpy(name_buf, name, name_len);
+                name_buf[name_len] = '\0';
+                (void)uvhttp_route_match_param_copy(&match, name_buf, value,
+                                                    sizeof(value), NULL);
+            }
+        }
+    }
 
     uvhttp_param_t params[16];
     size_t param_count = 0;
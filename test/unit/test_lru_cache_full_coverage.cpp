@@ -6,6 +6,7 @@
 #include "uvhttp_lru_cache.h"
 #include "uvhttp_error.h"
 #include <string.h>
+#include <string>
 #include <time.h>
 
 /* 测试LRU缓存创建和释放 */
@@ -221,7 +222,7 @@ TEST(UvhttpLruCacheFullCoverageTest, CacheCleanupExpired) {
 TEST(UvhttpLruCacheFullCoverageTest, CacheMemoryLimit) {
     cache_manager_t* cache = NULL;
     /* 创建足够大的缓存以容纳2-3个条目，但不足以容纳5个 */
-    uvhttp_error_t result = uvhttp_lru_cache_create(32 * 1024, 10, 3600, &cache);
+    uvhttp_error_t result = uvhttp_lru_cache_create(2 * 1024, 10, 3600, &cache);
     ASSERT_EQ(result, UVHTTP_OK);
 
     /* 添加多个条目，触发驱逐 */
@@ -1055,7 +1056,7 @@ TEST(UvhttpLruCacheFullCoverageTest, ForceEvictionPriorityProtected) {
 /* Test: multiple batched evictions (more than one batch needed) */
 TEST(UvhttpLruCacheFullCoverageTest, MultiBatchEviction) {
     cache_manager_t* cache = NULL;
-    /* Small but reasonable max memory (each entry is ~2.5KB due to file_path) */
+    /* Small but reasonable max memory; 100 entries at most */
     uvhttp_error_t result = uvhttp_lru_cache_create(512 * 1024, 100, 0, &cache);
     ASSERT_EQ(result, UVHTTP_OK);
 
@@ -1064,10 +1065,8 @@ TEST(UvhttpLruCacheFullCoverageTest, MultiBatchEviction) {
     char content[64];
     memset(content, 'E', sizeof(content));
 
-    /* Add many entries to trigger multiple batches of eviction.
-     * With 512KB max memory and entries ~2.5KB each, we can fit
-     * roughly 200 entries before memory eviction kicks in.
-     * Use a higher max_entries to let memory be the constraint. */
+    /* Add many entries to trigger multiple batches of eviction: the
+     * entry limit is reached long before the memory limit. */
     for (int i = 0; i < 200; i++) {
         char path[64];
         snprintf(path, sizeof(path), "/b%d.txt", i);
@@ -1169,4 +1168,331 @@ TEST(UvhttpLruCacheFullCoverageTest, ResetStatsNullCache) {
     /* Should not crash */
 }
 
+/* Test: an entry is a small header plus its key */
+TEST(UvhttpLruCacheFullCoverageTest, EntryIsCompact) {
+    cache_manager_t* cache = NULL;
+    ASSERT_EQ(uvhttp_lru_cache_create(1024 * 1024, 100, 0, &cache), UVHTTP_OK);
+
+    char content[] = "0123456789";
+    ASSERT_EQ(uvhttp_lru_cache_put(cache, "/icon.png", content, 10,
+                                   "image/png", time(NULL), "\"10-1\""),
+              UVHTTP_OK);
+    cache_entry_t* entry = uvhttp_lru_cache_find(cache, "/icon.png");
+    ASSERT_NE(entry, nullptr);
+    EXPECT_LT(sizeof(cache_entry_t), 512u);
+    EXPECT_EQ(entry->memory_usage,
+              sizeof(cache_entry_t) + strlen("/icon.png") + 10);
+    EXPECT_EQ(cache->total_memory_usage, entry->memory_usage);
+    EXPECT_STREQ(entry->file_path, "/icon.png");
+    EXPECT_STREQ(entry->etag, "\"10-1\"");
+
+    /* keys are told apart by content, not by hash alone */
+    EXPECT_EQ(uvhttp_lru_cache_find(cache, "/icon.pn"), nullptr);
+    EXPECT_EQ(uvhttp_lru_cache_remove(cache, "/icon.png"), UVHTTP_OK);
+    EXPECT_EQ(cache->total_memory_usage, 0u);
+
+    uvhttp_lru_cache_free(cache);
+}
+
+/* Test: entries of a MIME type share one copy of it */
+TEST(UvhttpLruCacheFullCoverageTest, MimeTypesAreInterned) {
+    cache_manager_t* cache = NULL;
+    ASSERT_EQ(uvhttp_lru_cache_create(1024 * 1024, 100, 0, &cache), UVHTTP_OK);
+
+    char content[] = "x";
+    char type[] = "application/json";
+    for (int i = 0; i < 3; i++) {
+        char path[32];
+        snprintf(path, sizeof(path), "/f%d.json", i);
+        ASSERT_EQ(uvhttp_lru_cache_put(cache, path, content, 1, type,
+                                       time(NULL), NULL),
+                  UVHTTP_OK);
+    }
+    ASSERT_EQ(uvhttp_lru_cache_put(cache, "/f.bin", content, 1, NULL,
+                                   time(NULL), NULL),
+              UVHTTP_OK);
+    cache_entry_t* a = uvhttp_lru_cache_find(cache, "/f0.json");
+    cache_entry_t* b = uvhttp_lru_cache_find(cache, "/f2.json");
+    ASSERT_NE(a, nullptr);
+    ASSERT_NE(b, nullptr);
+    EXPECT_EQ(a->mime_type, b->mime_type);
+    EXPECT_NE(a->mime_type, type);
+    EXPECT_STREQ(a->mime_type, "application/json");
+    EXPECT_EQ(cache->mime_type_count, 1);
+    EXPECT_STREQ(uvhttp_lru_cache_find(cache, "/f.bin")->mime_type,
+                 "application/octet-stream");
+
+    uvhttp_lru_cache_free(cache);
+}
+
+/* Test: an ETag that does not fit is not cached rather than cut short */
+TEST(UvhttpLruCacheFullCoverageTest, LongEtagIsNotCached) {
+    cache_manager_t* cache = NULL;
+    ASSERT_EQ(uvhttp_lru_cache_create(1024 * 1024, 100, 0, &cache), UVHTTP_OK);
+
+    char content[] = "x";
+    std::string etag(UVHTTP_CACHE_ETAG_SIZE, 'e');
+    EXPECT_EQ(uvhttp_lru_cache_put(cache, "/long.txt", content, 1,
+                                   "text/plain", time(NULL), etag.c_str()),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(cache->entry_count, 0);
+    etag.resize(UVHTTP_CACHE_ETAG_SIZE - 1);
+    EXPECT_EQ(uvhttp_lru_cache_put(cache, "/long.txt", content, 1,
+                                   "text/plain", time(NULL), etag.c_str()),
+              UVHTTP_OK);
+
+    uvhttp_lru_cache_free(cache);
+}
+
+/* Replay one request: a lookup, and a put on a miss */
+static void lru_cache_touch(cache_manager_t* cache, const char* path) {
+    char content[] = "0123456789";
+    if (!uvhttp_lru_cache_find(cache, path)) {
+        ASSERT_EQ(uvhttp_lru_cache_put(cache, path, content, 10, "text/plain",
+                                       time(NULL), NULL),
+                  UVHTTP_OK);
+    }
+}
+
+/* Entries linked from lru_head, the W-TinyLFU window */
+static int lru_cache_list_length(cache_manager_t* cache, size_t* memory) {
+    int count = 0;
+    *memory = 0;
+    for (cache_entry_t* e = cache->lru_head; e; e = e->lru_next) {
+        count++;
+        *memory += e->memory_usage;
+    }
+    return count;
+}
+
+/* Test: a scan of one-off files flushes the hot ones from an LRU cache,
+ * not from a W-TinyLFU one */
+TEST(UvhttpLruCacheFullCoverageTest, TinyLfuKeepsHotEntriesThroughAScan) {
+    const uvhttp_cache_policy_t policies[] = {UVHTTP_CACHE_POLICY_LRU,
+                                              UVHTTP_CACHE_POLICY_TINYLFU};
+    for (uvhttp_cache_policy_t policy : policies) {
+        cache_manager_t* cache = NULL;
+        ASSERT_EQ(uvhttp_lru_cache_create(64 * 1024 * 1024, 100, 0, &cache),
+                  UVHTTP_OK);
+        ASSERT_EQ(uvhttp_lru_cache_set_policy(cache, policy), UVHTTP_OK);
+
+        char path[32];
+        for (int round = 0; round < 5; round++) {
+            for (int i = 0; i < 50; i++) {
+                snprintf(path, sizeof(path), "/hot%d", i);
+                lru_cache_touch(cache, path);
+            }
+        }
+        /* the hot files are still in use, sparsely, during the scan */
+        for (int i = 0; i < 1000; i++) {
+            snprintf(path, sizeof(path), "/scan%d", i);
+            lru_cache_touch(cache, path);
+            if (i % 5 == 0) {
+                snprintf(path, sizeof(path), "/hot%d", i / 5 % 50);
+                lru_cache_touch(cache, path);
+            }
+        }
+        EXPECT_LE(cache->entry_count, 100);
+
+        int hot = 0;
+        for (int i = 0; i < 50; i++) {
+            snprintf(path, sizeof(path), "/hot%d", i);
+            hot += uvhttp_lru_cache_find(cache, path) != NULL;
+        }
+        if (policy == UVHTTP_CACHE_POLICY_TINYLFU) {
+            EXPECT_EQ(hot, 50);
+            EXPECT_GE(cache->protected_segment.entry_count, 50);
+        } else {
+            EXPECT_LT(hot, 25);
+        }
+        uvhttp_lru_cache_free(cache);
+    }
+}
+
+/* Test: W-TinyLFU segments, and their accounting */
+TEST(UvhttpLruCacheFullCoverageTest, TinyLfuSegments) {
+    cache_manager_t* cache = NULL;
+    ASSERT_EQ(uvhttp_lru_cache_create(1024 * 1024, 100, 0, &cache), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_lru_cache_set_policy(cache, UVHTTP_CACHE_POLICY_TINYLFU),
+              UVHTTP_OK);
+    ASSERT_NE(cache->sketch, nullptr);
+
+    /* new entries enter the window, its overflow goes on probation */
+    lru_cache_touch(cache, "/a");
+    cache_entry_t* a = uvhttp_lru_cache_find(cache, "/a");
+    ASSERT_NE(a, nullptr);
+    EXPECT_EQ(a->segment, UVHTTP_CACHE_SEGMENT_WINDOW);
+    lru_cache_touch(cache, "/b");
+    EXPECT_EQ(a->segment, UVHTTP_CACHE_SEGMENT_PROBATION);
+    EXPECT_EQ(cache->lru_head, uvhttp_lru_cache_find(cache, "/b"));
+
+    /* used again on probation: protected */
+    EXPECT_EQ(uvhttp_lru_cache_find(cache, "/a"), a);
+    EXPECT_EQ(a->segment, UVHTTP_CACHE_SEGMENT_PROTECTED);
+    EXPECT_EQ(cache->protected_segment.head, a);
+    EXPECT_EQ(cache->protected_segment.entry_count, 1);
+    EXPECT_EQ(cache->probation.entry_count, 0);
+
+    /* updated in place, accounted in its segment */
+    char bigger[100] = {0};
+    ASSERT_EQ(uvhttp_lru_cache_put(cache, "/a", bigger, sizeof(bigger),
+                                   "text/plain", time(NULL), NULL),
+              UVHTTP_OK);
+    EXPECT_EQ(a->segment, UVHTTP_CACHE_SEGMENT_PROTECTED);
+    EXPECT_EQ(cache->protected_segment.memory_usage, a->memory_usage);
+    size_t window_memory = 0;
+    EXPECT_EQ(lru_cache_list_length(cache, &window_memory), 1);
+    EXPECT_EQ(cache->total_memory_usage, window_memory + a->memory_usage);
+
+    EXPECT_EQ(uvhttp_lru_cache_remove(cache, "/a"), UVHTTP_OK);
+    EXPECT_EQ(cache->protected_segment.entry_count, 0);
+    EXPECT_EQ(cache->protected_segment.memory_usage, 0u);
+    EXPECT_EQ(cache->protected_segment.head, nullptr);
+    EXPECT_EQ(uvhttp_lru_cache_force_eviction(cache, 5), 1);
+    EXPECT_EQ(cache->entry_count, 0);
+    EXPECT_EQ(cache->total_memory_usage, 0u);
+
+    uvhttp_lru_cache_free(cache);
+}
+
+/* Test: leaving the window of a full W-TinyLFU cache, an entry used no more
+ * than the ones it holds is declined */
+TEST(UvhttpLruCacheFullCoverageTest, TinyLfuDeclinesRareEntries) {
+    cache_manager_t* cache = NULL;
+    ASSERT_EQ(uvhttp_lru_cache_create(1024 * 1024, 10, 0, &cache), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_lru_cache_set_policy(cache, UVHTTP_CACHE_POLICY_TINYLFU),
+              UVHTTP_OK);
+
+    char path[32];
+    for (int i = 0; i < 10; i++) {
+        snprintf(path, sizeof(path), "/f%d", i);
+        for (int n = 0; n < 3; n++) {
+            lru_cache_touch(cache, path);
+        }
+    }
+    EXPECT_EQ(cache->entry_count, 10);
+    EXPECT_EQ(cache->eviction_count, 0);
+
+    /* each put pushes the previous window entry out: /f9 first, which ties
+     * with the victim, then the rare ones */
+    char content[] = "x";
+    for (int i = 0; i < 5; i++) {
+        snprintf(path, sizeof(path), "/rare%d", i);
+        EXPECT_EQ(uvhttp_lru_cache_put(cache, path, content, 1, "text/plain",
+                                       time(NULL), NULL),
+                  UVHTTP_OK);
+    }
+    EXPECT_EQ(cache->entry_count, 10);
+    EXPECT_EQ(cache->eviction_count, 5);
+    EXPECT_EQ(uvhttp_lru_cache_find(cache, "/f9"), nullptr);
+    for (int i = 0; i < 4; i++) {
+        snprintf(path, sizeof(path), "/rare%d", i);
+        EXPECT_EQ(uvhttp_lru_cache_find(cache, path), nullptr) << path;
+    }
+    EXPECT_EQ(cache->lru_head, uvhttp_lru_cache_find(cache, "/rare4"));
+    for (int i = 0; i < 9; i++) {
+        snprintf(path, sizeof(path), "/f%d", i);
+        EXPECT_NE(uvhttp_lru_cache_find(cache, path), nullptr) << path;
+    }
+
+    uvhttp_lru_cache_free(cache);
+}
+
+/* Test: switching policies keeps every entry */
+TEST(UvhttpLruCacheFullCoverageTest, SetPolicyKeepsEntries) {
+    cache_manager_t* cache = NULL;
+    ASSERT_EQ(uvhttp_lru_cache_create(1024 * 1024, 100, 0, &cache), UVHTTP_OK);
+    EXPECT_EQ(cache->policy, UVHTTP_CACHE_POLICY_LRU);
+    EXPECT_EQ(uvhttp_lru_cache_set_policy(NULL, UVHTTP_CACHE_POLICY_LRU),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_lru_cache_set_policy(cache, (uvhttp_cache_policy_t)7),
+              UVHTTP_ERROR_INVALID_PARAM);
+
+    char path[32];
+    for (int i = 0; i < 20; i++) {
+        snprintf(path, sizeof(path), "/f%d", i);
+        lru_cache_touch(cache, path);
+    }
+    size_t memory = 0;
+    ASSERT_EQ(uvhttp_lru_cache_set_policy(cache, UVHTTP_CACHE_POLICY_TINYLFU),
+              UVHTTP_OK);
+    EXPECT_EQ(cache->entry_count, 20);
+    EXPECT_EQ(lru_cache_list_length(cache, &memory), 1);
+    EXPECT_EQ(cache->probation.entry_count, 19);
+    EXPECT_EQ(cache->total_memory_usage,
+              memory + cache->probation.memory_usage);
+    EXPECT_NE(uvhttp_lru_cache_find(cache, "/f3"), nullptr);
+
+    ASSERT_EQ(uvhttp_lru_cache_set_policy(cache, UVHTTP_CACHE_POLICY_LRU),
+              UVHTTP_OK);
+    EXPECT_EQ(cache->sketch, nullptr);
+    EXPECT_EQ(cache->probation.entry_count, 0);
+    EXPECT_EQ(cache->protected_segment.entry_count, 0);
+    EXPECT_EQ(lru_cache_list_length(cache, &memory), 20);
+    EXPECT_EQ(memory, cache->total_memory_usage);
+    for (cache_entry_t* e = cache->lru_head; e; e = e->lru_next) {
+        EXPECT_EQ(e->segment, UVHTTP_CACHE_SEGMENT_WINDOW);
+        EXPECT_EQ(e->lru_next ? e->lru_next->lru_prev : cache->lru_tail, e);
+    }
+
+    uvhttp_lru_cache_free(cache);
+}
+
+/* Test: an encoded variant is claimed once, counted with its entry and
+ * dropped with the content */
+TEST(UvhttpLruCacheFullCoverageTest, VariantsAreClaimedOnceAndCounted) {
+    cache_manager_t* cache = NULL;
+    ASSERT_EQ(uvhttp_lru_cache_create(1024 * 1024, 100, 0, &cache), UVHTTP_OK);
+    char content[] = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
+    ASSERT_EQ(uvhttp_lru_cache_put(cache, "/a.css", content, 32, "text/css",
+                                   0, NULL),
+              UVHTTP_OK);
+    cache_entry_t* entry = uvhttp_lru_cache_peek(cache, "/a.css");
+    ASSERT_NE(entry, nullptr);
+    size_t base = entry->memory_usage;
+
+    EXPECT_EQ(uvhttp_lru_cache_claim_variant(entry, UVHTTP_CACHE_ENCODING_GZIP),
+              1);
+    EXPECT_EQ(uvhttp_lru_cache_claim_variant(entry, UVHTTP_CACHE_ENCODING_GZIP),
+              0);
+    EXPECT_EQ(uvhttp_lru_cache_claim_variant(entry, UVHTTP_CACHE_ENCODING_COUNT),
+              0);
+
+    uvhttp_cache_buffer_t* gz = uvhttp_cache_buffer_create(12);
+    ASSERT_NE(gz, nullptr);
+    uvhttp_lru_cache_set_variant(cache, entry, UVHTTP_CACHE_ENCODING_GZIP, gz);
+    EXPECT_EQ(entry->variants[UVHTTP_CACHE_ENCODING_GZIP].buffer, gz);
+    EXPECT_EQ(gz->refcount, 2);
+    EXPECT_EQ(entry->memory_usage, base + 12);
+
+    /* a head for the variant describes (and holds) it */
+    uvhttp_cache_buffer_t* head = uvhttp_cache_buffer_create(20);
+    ASSERT_NE(head, nullptr);
+    uvhttp_lru_cache_set_variant_head(cache, entry, UVHTTP_CACHE_ENCODING_GZIP,
+                                      head, 10);
+    EXPECT_EQ(head->body, gz);
+    EXPECT_EQ(entry->memory_usage, base + 32);
+    EXPECT_EQ(cache->total_memory_usage, entry->memory_usage);
+
+    /* replaced content starts over */
+    ASSERT_EQ(uvhttp_lru_cache_put(cache, "/a.css", content, 32, "text/css",
+                                   0, NULL),
+              UVHTTP_OK);
+    EXPECT_EQ(entry->variants[UVHTTP_CACHE_ENCODING_GZIP].buffer, nullptr);
+    EXPECT_EQ(entry->encodings_tried, 0u);
+    EXPECT_EQ(entry->memory_usage, base);
+    EXPECT_EQ(cache->total_memory_usage, base);
+    EXPECT_EQ(gz->refcount, 1);
+    uvhttp_cache_buffer_release(gz);
+
+    /* not worth keeping: tried, nothing held */
+    uvhttp_lru_cache_set_variant(cache, entry, UVHTTP_CACHE_ENCODING_GZIP,
+                                 NULL);
+    EXPECT_EQ(uvhttp_lru_cache_claim_variant(entry, UVHTTP_CACHE_ENCODING_GZIP),
+              0);
+    EXPECT_EQ(entry->memory_usage, base);
+
+    uvhttp_lru_cache_free(cache);
+}
+
 #endif /* UVHTTP_FEATURE_STATIC_FILES */
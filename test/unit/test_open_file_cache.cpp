@@ -0,0 +1,268 @@
+/* UVHTTP open-file cache: lookups of static cache misses, invalidated by
+ * directory change notifications and a TTL */
+
+#if UVHTTP_FEATURE_STATIC_FILES
+
+#include <gtest/gtest.h>
+#include "test_static_helper.h"
+#include "uvhttp_open_file_cache.h"
+
+class OpenFileCacheTest : public StaticTestFixture {
+  protected:
+    OpenFileCacheTest() : StaticTestFixture("ofc") {}
+
+    void TearDown() override {
+        /* the loop run of the fixture's teardown closes the watches */
+        uvhttp_open_file_cache_free(cache);
+        StaticTestFixture::TearDown();
+    }
+
+    uvhttp_open_file_t* put(const char* name) {
+        uv_stat_t st;
+        uv_fs_t req;
+        EXPECT_EQ(uv_fs_stat(&loop, &req, path(name).c_str(), NULL), 0);
+        st = req.statbuf;
+        uv_fs_req_cleanup(&req);
+        return uvhttp_open_file_cache_put(cache, &loop, path(name).c_str(),
+                                          path(name).c_str(), &st);
+    }
+
+    /* lets the loop deliver pending change notifications (the watches do
+     * not keep it running: a timer does) */
+    void settle() {
+        uv_timer_t timer;
+        uv_timer_init(&loop, &timer);
+        uv_timer_start(&timer, [](uv_timer_t*) {}, 50, 0);
+        uv_run(&loop, UV_RUN_DEFAULT);
+        uv_close((uv_handle_t*)&timer, NULL);
+        uv_run(&loop, UV_RUN_NOWAIT);
+    }
+
+    uvhttp_open_file_cache_stats_t stats() {
+        uvhttp_open_file_cache_stats_t s;
+        uvhttp_open_file_cache_get_stats(cache, &s);
+        return s;
+    }
+
+    uvhttp_open_file_cache_t* cache = nullptr;
+};
+
+TEST_F(OpenFileCacheTest, CreateValidatesArguments) {
+    EXPECT_EQ(uvhttp_open_file_cache_create(0, 0, 0, NULL),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_open_file_cache_create(-1, 0, 0, &cache),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(cache, nullptr);
+    EXPECT_EQ(uvhttp_open_file_cache_find(NULL, "/x"), nullptr);
+    uvhttp_open_file_cache_free(NULL);
+}
+
+TEST_F(OpenFileCacheTest, RemembersFilesAndMissingPaths) {
+    ASSERT_EQ(uvhttp_open_file_cache_create(0, 0, 0, &cache), UVHTTP_OK);
+    write_file("a.txt", "hello");
+
+    EXPECT_EQ(uvhttp_open_file_cache_find(cache, path("a.txt").c_str()),
+              nullptr);
+    uvhttp_open_file_t* entry = put("a.txt");
+    ASSERT_NE(entry, nullptr);
+    EXPECT_EQ(entry->size, 5u);
+    EXPECT_EQ(entry->has_gz, -1);
+    EXPECT_EQ(entry->fd, -1);
+
+    ASSERT_NE(uvhttp_open_file_cache_put_negative(
+                  cache, &loop, path("missing").c_str()),
+              nullptr);
+
+    uvhttp_open_file_t* found =
+        uvhttp_open_file_cache_find(cache, path("a.txt").c_str());
+    ASSERT_NE(found, nullptr);
+    EXPECT_STREQ(found->path, path("a.txt").c_str());
+    const uvhttp_open_file_t* missing =
+        uvhttp_open_file_cache_find(cache, path("missing").c_str());
+    ASSERT_NE(missing, nullptr);
+    EXPECT_TRUE(missing->negative);
+
+    uvhttp_open_file_cache_stats_t s = stats();
+    EXPECT_EQ(s.hits, 1u);
+    EXPECT_EQ(s.negative_hits, 1u);
+    EXPECT_EQ(s.misses, 1u);
+    EXPECT_EQ(s.entries, 2u);
+    EXPECT_EQ(s.watches, 1u); /* both live in root */
+}
+
+TEST_F(OpenFileCacheTest, ChangeInWatchedDirectoryInvalidates) {
+    ASSERT_EQ(uvhttp_open_file_cache_create(0, 0, 0, &cache), UVHTTP_OK);
+    write_file("a.txt", "hello");
+    write_file("b.txt", "other");
+    ASSERT_NE(put("a.txt"), nullptr);
+    ASSERT_NE(put("b.txt"), nullptr);
+    ASSERT_NE(uvhttp_open_file_cache_put_negative(cache, &loop,
+                                                  path("new.txt").c_str()),
+              nullptr);
+
+    std::vector<std::string> dropped;
+    uvhttp_open_file_cache_set_invalidate_cb(
+        cache,
+        [](void* data, const char* key) {
+            static_cast<std::vector<std::string>*>(data)->push_back(key);
+        },
+        &dropped);
+
+    write_file("new.txt", "created");
+    write_file("a.txt", "changed");
+    settle();
+
+    EXPECT_EQ(uvhttp_open_file_cache_peek(cache, path("new.txt").c_str()),
+              nullptr);
+    EXPECT_EQ(uvhttp_open_file_cache_peek(cache, path("a.txt").c_str()),
+              nullptr);
+    /* b.txt did not change */
+    EXPECT_NE(uvhttp_open_file_cache_peek(cache, path("b.txt").c_str()),
+              nullptr);
+    EXPECT_EQ(stats().invalidations, 2u);
+    EXPECT_EQ(dropped.size(), 2u);
+}
+
+TEST_F(OpenFileCacheTest, GzipSiblingInvalidatesItsFile) {
+    ASSERT_EQ(uvhttp_open_file_cache_create(0, 0, 0, &cache), UVHTTP_OK);
+    write_file("app.js", "js");
+    uvhttp_open_file_t* entry = put("app.js");
+    ASSERT_NE(entry, nullptr);
+    entry->has_gz = 0;
+
+    write_file("app.js.gz", "gz");
+    settle();
+    EXPECT_EQ(uvhttp_open_file_cache_peek(cache, path("app.js").c_str()),
+              nullptr);
+}
+
+TEST_F(OpenFileCacheTest, KeptDescriptorsAreBoundedAndClosed) {
+    ASSERT_EQ(uvhttp_open_file_cache_create(0, 0, 1, &cache), UVHTTP_OK);
+    write_file("a.txt", "a");
+    write_file("b.txt", "b");
+    uvhttp_open_file_t* a = put("a.txt");
+    uvhttp_open_file_t* b = put("b.txt");
+
+    int fd = open(path("a.txt").c_str(), O_RDONLY);
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(uvhttp_open_file_cache_keep_fd(cache, a, 0, fd), 1);
+    EXPECT_EQ(uvhttp_open_file_cache_keep_fd(cache, a, 0, fd), 0); /* has one */
+    EXPECT_EQ(uvhttp_open_file_cache_keep_fd(cache, b, 0, fd), 0); /* budget */
+    close(fd);
+
+    ASSERT_GE(a->fd, 0);
+    char c = 0;
+    EXPECT_EQ(pread(a->fd, &c, 1, 0), 1);
+    EXPECT_EQ(c, 'a');
+    EXPECT_EQ(stats().open_fds, 1u);
+
+    int kept = a->fd;
+    uvhttp_open_file_cache_clear(cache);
+    EXPECT_EQ(stats().open_fds, 0u);
+    EXPECT_EQ(fcntl(kept, F_GETFD), -1); /* closed with its entry */
+}
+
+TEST_F(OpenFileCacheTest, LeastRecentlyUsedIsEvicted) {
+    ASSERT_EQ(uvhttp_open_file_cache_create(2, 0, 0, &cache), UVHTTP_OK);
+    write_file("a", "a");
+    write_file("b", "b");
+    write_file("c", "c");
+    put("a");
+    put("b");
+    ASSERT_NE(uvhttp_open_file_cache_find(cache, path("a").c_str()), nullptr);
+    put("c");
+
+    EXPECT_NE(uvhttp_open_file_cache_peek(cache, path("a").c_str()), nullptr);
+    EXPECT_EQ(uvhttp_open_file_cache_peek(cache, path("b").c_str()), nullptr);
+    EXPECT_NE(uvhttp_open_file_cache_peek(cache, path("c").c_str()), nullptr);
+    EXPECT_EQ(stats().entries, 2u);
+}
+
+TEST_F(OpenFileCacheTest, EntriesExpire) {
+    ASSERT_EQ(uvhttp_open_file_cache_create(0, 1, 0, &cache), UVHTTP_OK);
+    ASSERT_NE(uvhttp_open_file_cache_put_negative(cache, &loop,
+                                                  "/nonexistent/dir/file"),
+              nullptr);
+    EXPECT_EQ(stats().watches, 0u); /* nothing to watch: the TTL decides */
+    ASSERT_NE(uvhttp_open_file_cache_find(cache, "/nonexistent/dir/file"),
+              nullptr);
+
+    usleep(1100 * 1000);
+    uv_update_time(&loop);
+    EXPECT_EQ(uvhttp_open_file_cache_find(cache, "/nonexistent/dir/file"),
+              nullptr);
+    EXPECT_EQ(stats().entries, 0u);
+}
+
+/* ========== through uvhttp_static_handle_request ========== */
+
+class StaticOpenFileTest : public OpenFileCacheTest {
+  protected:
+    void SetUp() override {
+        OpenFileCacheTest::SetUp();
+        write_file("small.txt", "hello static");
+        write_file("big.bin", std::string(100 * 1024, 'b'));
+
+        create_context(static_config());
+    }
+
+    /* serve url over a socketpair and return what the client received */
+    std::string get(const char* url) { return fetch(client(url)); }
+
+    uvhttp_open_file_cache_stats_t static_stats() {
+        uvhttp_open_file_cache_stats_t s;
+        uvhttp_static_get_open_file_stats(ctx, &s);
+        return s;
+    }
+
+};
+
+TEST_F(StaticOpenFileTest, MissingFileIsAnsweredFromTheCache) {
+    EXPECT_NE(get("/missing.txt").find(" 404 "), std::string::npos);
+    EXPECT_EQ(static_stats().entries, 1u);
+
+    /* answered without touching the disk */
+    EXPECT_NE(get("/missing.txt").find(" 404 "), std::string::npos);
+    EXPECT_EQ(static_stats().negative_hits, 1u);
+
+    write_file("missing.txt", "now here");
+    settle();
+    EXPECT_EQ(static_stats().invalidations, 1u);
+    std::string response = get("/missing.txt");
+    EXPECT_NE(response.find(" 200 "), std::string::npos);
+    EXPECT_NE(response.find("now here"), std::string::npos);
+}
+
+TEST_F(StaticOpenFileTest, LargeFileKeepsItsDescriptor) {
+    std::string first = get("/big.bin");
+    EXPECT_NE(first.find("Content-Length: 102400"), std::string::npos);
+    EXPECT_EQ(static_stats().open_fds, 1u);
+
+    std::string second = get("/big.bin");
+    EXPECT_EQ(second, first);
+    EXPECT_EQ(static_stats().hits, 1u);
+    EXPECT_EQ(static_stats().open_fds, 1u);
+}
+
+TEST_F(StaticOpenFileTest, ChangedFileDropsCachedContent) {
+    EXPECT_NE(get("/small.txt").find("hello static"), std::string::npos);
+    /* replaced: the content cache must not answer with the old bytes */
+    write_file("small.txt", "new content");
+    settle();
+    std::string response = get("/small.txt");
+    EXPECT_NE(response.find("new content"), std::string::npos) << response;
+}
+
+TEST_F(StaticOpenFileTest, CacheCanBeTurnedOff) {
+    uvhttp_static_config_t config = ctx->config;
+    config.open_file_cache_size = -1;
+    uvhttp_static_context_t* off = NULL;
+    ASSERT_EQ(uvhttp_static_create(&config, &off), UVHTTP_OK);
+    EXPECT_EQ(off->open_files, nullptr);
+    uvhttp_open_file_cache_stats_t s;
+    uvhttp_static_get_open_file_stats(off, &s);
+    EXPECT_EQ(s.entries, 0u);
+    uvhttp_static_free(off);
+}
+
+#endif /* UVHTTP_FEATURE_STATIC_FILES */
@@ -886,18 +886,23 @@ TEST_F(RouterBoostCoverageTest, Match_ExtractsMultipleParams) {
         UVHTTP_OK);
     EXPECT_EQ(match.handler, dummy_handler);
     EXPECT_EQ(match.param_count, 3u);
-    // Param values are extracted from the matched path segments
-    EXPECT_STREQ(match.params[0].value, "acme");
-    EXPECT_STREQ(match.params[1].value, "john");
-    EXPECT_STREQ(match.params[2].value, "123");
-    // Param names may be empty due to strtok not preserving '/' in tokens
-    // (the name-saving loop in add_route_method looks for '/' which strtok
-    // already stripped). Values are always correct.
+    // Param values are slices of the matched path segments
+    char value[16];
+    EXPECT_EQ(uvhttp_route_match_param_copy(&match, "org_id", value,
+                                            sizeof(value), NULL),
+              UVHTTP_OK);
+    EXPECT_STREQ(value, "acme");
+    EXPECT_EQ(uvhttp_route_match_param_copy(&match, "user_id", value,
+                                            sizeof(value), NULL),
+              UVHTTP_OK);
+    EXPECT_STREQ(value, "john");
+    EXPECT_EQ(uvhttp_route_match_param_copy(&match, "post_id", value,
+                                            sizeof(value), NULL),
+              UVHTTP_OK);
+    EXPECT_STREQ(value, "123");
 }
 
 TEST_F(RouterBoostCoverageTest, Match_ParamNameOverflow) {
-    // Param name with a very long token - exercises segment length capping.
-    // The segment data is capped at 31 chars (segment_len = min(len, 31)).
     uvhttp_router_add_route_method(router, "/test/:id", UVHTTP_GET,
                                    dummy_handler);
 
@@ -906,7 +911,10 @@ TEST_F(RouterBoostCoverageTest, Match_ParamNameOverflow) {
               UVHTTP_OK);
     EXPECT_EQ(match.handler, dummy_handler);
     EXPECT_EQ(match.param_count, 1u);
-    EXPECT_STREQ(match.params[0].value, "value123");
+    size_t len = 0;
+    const char* value = uvhttp_route_match_param(&match, "id", &len);
+    ASSERT_NE(value, nullptr);
+    EXPECT_EQ(std::string(value, len), "value123");
 }
 
 // ============================================================================
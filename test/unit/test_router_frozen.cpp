@@ -0,0 +1,221 @@
+/* UVHTTP frozen router tests: perfect-hash dispatch of static routes */
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <string.h>
+#include "uvhttp.h"
+#include "uvhttp_router.h"
+#include "uvhttp_router_frozen.h"
+
+static int handler_a(uvhttp_request_t* request, uvhttp_response_t* response) {
+    (void)request;
+    (void)response;
+    return 1;
+}
+
+static int handler_b(uvhttp_request_t* request, uvhttp_response_t* response) {
+    (void)request;
+    (void)response;
+    return 2;
+}
+
+static int handler_c(uvhttp_request_t* request, uvhttp_response_t* response) {
+    (void)request;
+    (void)response;
+    return 3;
+}
+
+class RouterFrozenTest : public ::testing::Test {
+  protected:
+    void SetUp() override { ASSERT_EQ(uvhttp_router_new(&router), UVHTTP_OK); }
+    void TearDown() override { uvhttp_router_free(router); }
+
+    uvhttp_request_handler_t find(const char* path,
+                                  const char* method = "GET") {
+        return uvhttp_router_find_handler(router, path, method);
+    }
+
+    uvhttp_router_t* router = NULL;
+};
+
+TEST_F(RouterFrozenTest, NullRouter) {
+    EXPECT_EQ(uvhttp_router_freeze(NULL), UVHTTP_ERROR_INVALID_PARAM);
+}
+
+TEST_F(RouterFrozenTest, EmptyRouter) {
+    ASSERT_EQ(uvhttp_router_freeze(router), UVHTTP_OK);
+    EXPECT_EQ(find("/"), nullptr);
+    EXPECT_EQ(find(""), nullptr);
+}
+
+TEST_F(RouterFrozenTest, StaticRoutesInArrayMode) {
+    ASSERT_EQ(uvhttp_router_add_route(router, "/", handler_a), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route(router, "/health", handler_b), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_freeze(router), UVHTTP_OK);
+    ASSERT_NE(router->frozen, nullptr);
+    EXPECT_EQ(uvhttp_router_frozen_count(router->frozen), 2u);
+
+    EXPECT_EQ(find("/"), handler_a);
+    EXPECT_EQ(find("/health"), handler_b);
+    EXPECT_EQ(find("/health/"), nullptr);
+    EXPECT_EQ(find("/healt"), nullptr);
+
+    uvhttp_route_match_t match;
+    ASSERT_EQ(uvhttp_router_match(router, "/health", "GET", &match),
+              UVHTTP_OK);
+    EXPECT_EQ(match.handler, handler_b);
+    EXPECT_EQ(match.param_count, 0u);
+    EXPECT_EQ(uvhttp_router_match(router, "/nope", "GET", &match),
+              UVHTTP_ERROR_NOT_FOUND);
+}
+
+TEST_F(RouterFrozenTest, MethodsAndAnyFallback) {
+    ASSERT_EQ(uvhttp_router_add_route_method(router, "/items", UVHTTP_GET,
+                                             handler_a),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route_method(router, "/items", UVHTTP_POST,
+                                             handler_b),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route(router, "/any", handler_c), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_freeze(router), UVHTTP_OK);
+
+    EXPECT_EQ(find("/items", "GET"), handler_a);
+    EXPECT_EQ(find("/items", "POST"), handler_b);
+    EXPECT_EQ(find("/items", "DELETE"), nullptr);
+    EXPECT_EQ(find("/any", "DELETE"), handler_c);
+    EXPECT_EQ(find("/any", "PATCH"), handler_c);
+}
+
+TEST_F(RouterFrozenTest, FreezingKeepsArrayModeOrder) {
+    /* an earlier ANY route shadows a later method route on its path */
+    ASSERT_EQ(uvhttp_router_add_route(router, "/a", handler_a), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route_method(router, "/a", UVHTTP_GET,
+                                             handler_b),
+              UVHTTP_OK);
+    /* but not an earlier method route */
+    ASSERT_EQ(uvhttp_router_add_route_method(router, "/b", UVHTTP_POST,
+                                             handler_b),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route(router, "/b", handler_c), UVHTTP_OK);
+
+    const char* paths[] = {"/a", "/b"};
+    const char* methods[] = {"GET", "POST", "DELETE"};
+    uvhttp_request_handler_t before[2][3];
+    for (int p = 0; p < 2; p++) {
+        for (int m = 0; m < 3; m++) {
+            before[p][m] = find(paths[p], methods[m]);
+        }
+    }
+    EXPECT_EQ(before[0][0], handler_a);
+    EXPECT_EQ(before[1][1], handler_b);
+    EXPECT_EQ(before[1][0], handler_c);
+
+    ASSERT_EQ(uvhttp_router_freeze(router), UVHTTP_OK);
+    for (int p = 0; p < 2; p++) {
+        for (int m = 0; m < 3; m++) {
+            EXPECT_EQ(find(paths[p], methods[m]), before[p][m])
+                << methods[m] << " " << paths[p];
+        }
+    }
+}
+
+TEST_F(RouterFrozenTest, ParamRoutesStillMatch) {
+    ASSERT_EQ(uvhttp_router_add_route(router, "/users/me", handler_a),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route(router, "/users/:id", handler_b),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_freeze(router), UVHTTP_OK);
+    EXPECT_NE(router->frozen_partial, 0);
+
+    EXPECT_EQ(find("/users/me"), handler_a);
+    EXPECT_EQ(find("/users/42"), handler_b);
+
+    uvhttp_route_match_t match;
+    ASSERT_EQ(uvhttp_router_match(router, "/users/42", "GET", &match),
+              UVHTTP_OK);
+    EXPECT_EQ(match.handler, handler_b);
+    size_t len = 0;
+    const char* id = uvhttp_route_match_param(&match, "id", &len);
+    ASSERT_NE(id, nullptr);
+    EXPECT_EQ(std::string(id, len), "42");
+}
+
+TEST_F(RouterFrozenTest, StaticMethodMissFallsBackToParamRoute) {
+    ASSERT_EQ(uvhttp_router_add_route_method(router, "/users/me", UVHTTP_GET,
+                                             handler_a),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route_method(router, "/users/:id",
+                                             UVHTTP_DELETE, handler_b),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_freeze(router), UVHTTP_OK);
+
+    EXPECT_EQ(find("/users/me", "GET"), handler_a);
+    EXPECT_EQ(find("/users/me", "DELETE"), handler_b);
+}
+
+TEST_F(RouterFrozenTest, AddAfterFreezeFails) {
+    ASSERT_EQ(uvhttp_router_add_route(router, "/a", handler_a), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_freeze(router), UVHTTP_OK);
+    EXPECT_EQ(uvhttp_router_freeze(router), UVHTTP_OK);
+
+    EXPECT_EQ(uvhttp_router_add_route(router, "/b", handler_b),
+              UVHTTP_ERROR_ROUTER_FROZEN);
+    EXPECT_EQ(find("/b"), nullptr);
+    EXPECT_EQ(find("/a"), handler_a);
+    EXPECT_STRNE(uvhttp_error_description(UVHTTP_ERROR_ROUTER_FROZEN), "");
+}
+
+TEST_F(RouterFrozenTest, TwoThousandStaticRoutes) {
+    char path[128];
+    for (int i = 0; i < 2000; i++) {
+        snprintf(path, sizeof(path), "/api/v1/service%d/resource%d", i / 40,
+                 i % 40);
+        ASSERT_EQ(uvhttp_router_add_route(router, path,
+                                          i % 2 ? handler_a : handler_b),
+                  UVHTTP_OK);
+    }
+    ASSERT_EQ(uvhttp_router_freeze(router), UVHTTP_OK);
+    EXPECT_EQ(uvhttp_router_frozen_count(router->frozen), 2000u);
+    EXPECT_EQ(router->frozen_partial, 0);
+
+    for (int i = 0; i < 2000; i++) {
+        snprintf(path, sizeof(path), "/api/v1/service%d/resource%d", i / 40,
+                 i % 40);
+        EXPECT_EQ(find(path), i % 2 ? handler_a : handler_b) << path;
+        snprintf(path, sizeof(path), "/api/v1/service%d/resource%d/x", i / 40,
+                 i % 40);
+        EXPECT_EQ(find(path), nullptr) << path;
+    }
+}
+
+TEST(RouterFrozenTableTest, DuplicatePathsMerge) {
+    uvhttp_router_frozen_t* frozen = NULL;
+    ASSERT_EQ(uvhttp_router_frozen_new(&frozen), UVHTTP_OK);
+    ASSERT_EQ(
+        uvhttp_router_frozen_add(frozen, "/x", 2, UVHTTP_GET, handler_a, 0),
+        UVHTTP_OK);
+    ASSERT_EQ(
+        uvhttp_router_frozen_add(frozen, "/x", 2, UVHTTP_POST, handler_b, 0),
+        UVHTTP_OK);
+    ASSERT_EQ(
+        uvhttp_router_frozen_add(frozen, "/x", 2, UVHTTP_GET, handler_c, 0),
+        UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_frozen_build(frozen), UVHTTP_OK);
+    EXPECT_EQ(uvhttp_router_frozen_count(frozen), 1u);
+
+    EXPECT_EQ(uvhttp_router_frozen_lookup(frozen, "/x", 2, UVHTTP_GET, NULL),
+              handler_c);
+    EXPECT_EQ(uvhttp_router_frozen_lookup(frozen, "/x", 2, UVHTTP_POST, NULL),
+              handler_b);
+    EXPECT_EQ(uvhttp_router_frozen_lookup(frozen, "/x", 2, UVHTTP_PUT, NULL),
+              nullptr);
+    EXPECT_EQ(uvhttp_router_frozen_lookup(frozen, "/xy", 3, UVHTTP_GET, NULL),
+              nullptr);
+
+    /* the table is immutable once built */
+    EXPECT_EQ(
+        uvhttp_router_frozen_add(frozen, "/y", 2, UVHTTP_GET, handler_a, 0),
+        UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_router_frozen_build(frozen), UVHTTP_ERROR_INVALID_PARAM);
+    uvhttp_router_frozen_free(frozen);
+}
@@ -0,0 +1,271 @@
+/* UVHTTP route match cache tests: direct-mapped cache of recent matches */
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <string.h>
+#include "uvhttp.h"
+#include "uvhttp_router.h"
+#include "uvhttp_router_match_cache.h"
+
+static int handler_a(uvhttp_request_t* request, uvhttp_response_t* response) {
+    (void)request;
+    (void)response;
+    return 1;
+}
+
+static int handler_b(uvhttp_request_t* request, uvhttp_response_t* response) {
+    (void)request;
+    (void)response;
+    return 2;
+}
+
+static std::string param(const uvhttp_route_match_t* match, const char* name) {
+    size_t len = 0;
+    const char* value = uvhttp_route_match_param(match, name, &len);
+    return value ? std::string(value, len) : std::string("<none>");
+}
+
+static uvhttp_route_match_t make_match(const char* path,
+                                       uvhttp_request_handler_t handler,
+                                       const char* names) {
+    uvhttp_route_match_t match;
+    memset(&match, 0, sizeof(match));
+    match.handler = handler;
+    match.path = path;
+    match.param_names = names;
+    return match;
+}
+
+TEST(RouterMatchCacheTest, NewRejectsBadArguments) {
+    uvhttp_router_match_cache_t* cache = NULL;
+    EXPECT_EQ(uvhttp_router_match_cache_new(16, NULL),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_router_match_cache_new(0, &cache),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(cache, nullptr);
+    uvhttp_router_match_cache_free(NULL);
+    uvhttp_router_match_cache_clear(NULL);
+}
+
+TEST(RouterMatchCacheTest, PutThenGet) {
+    uvhttp_router_match_cache_t* cache = NULL;
+    ASSERT_EQ(uvhttp_router_match_cache_new(8, &cache), UVHTTP_OK);
+
+    const char* path = "/users/42";
+    uvhttp_route_match_t stored = make_match(path, handler_a, "id");
+    stored.params[0].name_offset = 0;
+    stored.params[0].name_len = 2;
+    stored.params[0].value_offset = 7;
+    stored.params[0].value_len = 2;
+    stored.param_count = 1;
+
+    uvhttp_route_match_t match = make_match(path, NULL, NULL);
+    EXPECT_EQ(uvhttp_router_match_cache_get(cache, path, strlen(path),
+                                            UVHTTP_GET, &match),
+              0);
+    uvhttp_router_match_cache_put(cache, path, strlen(path), UVHTTP_GET,
+                                  &stored);
+
+    ASSERT_EQ(uvhttp_router_match_cache_get(cache, path, strlen(path),
+                                            UVHTTP_GET, &match),
+              1);
+    EXPECT_EQ(match.handler, handler_a);
+    EXPECT_EQ(match.param_count, 1u);
+    EXPECT_EQ(param(&match, "id"), "42");
+
+    /* method and path are both part of the key */
+    EXPECT_EQ(uvhttp_router_match_cache_get(cache, path, strlen(path),
+                                            UVHTTP_POST, &match),
+              0);
+    EXPECT_EQ(uvhttp_router_match_cache_get(cache, "/users/43", 9,
+                                            UVHTTP_GET, &match),
+              0);
+    EXPECT_EQ(uvhttp_router_match_cache_get(cache, path, 8, UVHTTP_GET,
+                                            &match),
+              0);
+
+    uvhttp_router_match_cache_free(cache);
+}
+
+TEST(RouterMatchCacheTest, ClearDropsEntries) {
+    uvhttp_router_match_cache_t* cache = NULL;
+    ASSERT_EQ(uvhttp_router_match_cache_new(8, &cache), UVHTTP_OK);
+
+    uvhttp_route_match_t stored = make_match("/a", handler_a, NULL);
+    uvhttp_route_match_t match = make_match("/a", NULL, NULL);
+    uvhttp_router_match_cache_put(cache, "/a", 2, UVHTTP_GET, &stored);
+    ASSERT_EQ(uvhttp_router_match_cache_get(cache, "/a", 2, UVHTTP_GET, &match),
+              1);
+
+    uvhttp_router_match_cache_clear(cache);
+    EXPECT_EQ(uvhttp_router_match_cache_get(cache, "/a", 2, UVHTTP_GET, &match),
+              0);
+
+    uvhttp_router_match_cache_free(cache);
+}
+
+TEST(RouterMatchCacheTest, SkipsLongPathsAndManyParams) {
+    uvhttp_router_match_cache_t* cache = NULL;
+    ASSERT_EQ(uvhttp_router_match_cache_new(8, &cache), UVHTTP_OK);
+
+    char long_path[UVHTTP_ROUTER_MATCH_CACHE_MAX_PATH + 2];
+    memset(long_path, 'a', sizeof(long_path) - 1);
+    long_path[0] = '/';
+    long_path[sizeof(long_path) - 1] = '\0';
+    size_t long_len = strlen(long_path);
+    uvhttp_route_match_t stored = make_match(long_path, handler_a, NULL);
+    uvhttp_route_match_t match = make_match(long_path, NULL, NULL);
+    uvhttp_router_match_cache_put(cache, long_path, long_len, UVHTTP_GET,
+                                  &stored);
+    EXPECT_EQ(uvhttp_router_match_cache_get(cache, long_path, long_len,
+                                            UVHTTP_GET, &match),
+              0);
+
+    const char* path = "/a/b/c/d/e";
+    stored = make_match(path, handler_a, "a\0b\0c\0d\0e\0");
+    for (size_t i = 0; i < 5; i++) {
+        stored.params[i].name_offset = (uint16_t)(2 * i);
+        stored.params[i].name_len = 1;
+        stored.params[i].value_offset = (uint32_t)(2 * i + 1);
+        stored.params[i].value_len = 1;
+    }
+    stored.param_count = 5;
+    uvhttp_router_match_cache_put(cache, path, strlen(path), UVHTTP_GET,
+                                  &stored);
+    EXPECT_EQ(uvhttp_router_match_cache_get(cache, path, strlen(path),
+                                            UVHTTP_GET, &match),
+              0);
+
+    uvhttp_router_match_cache_free(cache);
+}
+
+TEST(RouterMatchCacheTest, StatsArguments) {
+    uvhttp_router_match_cache_stats_t stats;
+    EXPECT_EQ(uvhttp_router_get_match_cache_stats(NULL, &stats),
+              UVHTTP_ERROR_INVALID_PARAM);
+
+    uvhttp_router_t* router = NULL;
+    ASSERT_EQ(uvhttp_router_new(&router), UVHTTP_OK);
+    EXPECT_EQ(uvhttp_router_get_match_cache_stats(router, NULL),
+              UVHTTP_ERROR_INVALID_PARAM);
+    ASSERT_EQ(uvhttp_router_get_match_cache_stats(router, &stats), UVHTTP_OK);
+    EXPECT_EQ(stats.hits, 0u);
+    EXPECT_EQ(stats.misses, 0u);
+#if UVHTTP_FEATURE_ROUTER_MATCH_CACHE
+    EXPECT_GE(stats.capacity, (size_t)UVHTTP_ROUTER_MATCH_CACHE_SIZE);
+#else
+    EXPECT_EQ(stats.capacity, 0u);
+#endif
+    uvhttp_router_free(router);
+}
+
+#if UVHTTP_FEATURE_ROUTER_MATCH_CACHE
+
+class RouterWithMatchCacheTest : public ::testing::Test {
+  protected:
+    void SetUp() override { ASSERT_EQ(uvhttp_router_new(&router), UVHTTP_OK); }
+    void TearDown() override { uvhttp_router_free(router); }
+
+    uvhttp_router_match_cache_stats_t stats() {
+        uvhttp_router_match_cache_stats_t s;
+        EXPECT_EQ(uvhttp_router_get_match_cache_stats(router, &s), UVHTTP_OK);
+        return s;
+    }
+
+    uvhttp_router_t* router = NULL;
+};
+
+TEST_F(RouterWithMatchCacheTest, RepeatedMatchHits) {
+    ASSERT_EQ(uvhttp_router_add_route(router, "/users/:id/posts/:post",
+                                      handler_a),
+              UVHTTP_OK);
+
+    for (int i = 0; i < 3; i++) {
+        uvhttp_route_match_t match;
+        ASSERT_EQ(uvhttp_router_match(router, "/users/7/posts/99", "GET",
+                                      &match),
+                  UVHTTP_OK);
+        EXPECT_EQ(match.handler, handler_a);
+        EXPECT_EQ(param(&match, "id"), "7");
+        EXPECT_EQ(param(&match, "post"), "99");
+    }
+
+    uvhttp_router_match_cache_stats_t s = stats();
+    EXPECT_EQ(s.misses, 1u);
+    EXPECT_EQ(s.hits, 2u);
+
+    /* find_handler shares the cache */
+    EXPECT_EQ(uvhttp_router_find_handler(router, "/users/7/posts/99", "GET"),
+              handler_a);
+    EXPECT_EQ(stats().hits, 3u);
+}
+
+TEST_F(RouterWithMatchCacheTest, SlicesReferToTheNewPath) {
+    ASSERT_EQ(uvhttp_router_add_route(router, "/items/:id", handler_a),
+              UVHTTP_OK);
+
+    char first[] = "/items/abc";
+    char second[] = "/items/abc";
+    uvhttp_route_match_t match;
+    ASSERT_EQ(uvhttp_router_match(router, first, "GET", &match), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_match(router, second, "GET", &match), UVHTTP_OK);
+    EXPECT_EQ(stats().hits, 1u);
+
+    size_t len = 0;
+    const char* value = uvhttp_route_match_param(&match, "id", &len);
+    EXPECT_EQ(value, second + 7);
+    EXPECT_EQ(len, 3u);
+}
+
+TEST_F(RouterWithMatchCacheTest, AddingRouteInvalidates) {
+    ASSERT_EQ(uvhttp_router_add_route(router, "/files/:name", handler_a),
+              UVHTTP_OK);
+
+    uvhttp_route_match_t match;
+    ASSERT_EQ(uvhttp_router_match(router, "/files/readme", "GET", &match),
+              UVHTTP_OK);
+    EXPECT_EQ(match.handler, handler_a);
+
+    /* the static route must win over the cached parameter match */
+    ASSERT_EQ(uvhttp_router_add_route(router, "/files/readme", handler_b),
+              UVHTTP_OK);
+    EXPECT_EQ(stats().invalidations, 1u);
+    ASSERT_EQ(uvhttp_router_match(router, "/files/readme", "GET", &match),
+              UVHTTP_OK);
+    EXPECT_EQ(match.handler, handler_b);
+    EXPECT_EQ(match.param_count, 0u);
+}
+
+TEST_F(RouterWithMatchCacheTest, MethodIsPartOfTheKey) {
+    ASSERT_EQ(uvhttp_router_add_route_method(router, "/orders/:id", UVHTTP_GET,
+                                             handler_a),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route_method(router, "/orders/:id",
+                                             UVHTTP_POST, handler_b),
+              UVHTTP_OK);
+
+    uvhttp_route_match_t match;
+    ASSERT_EQ(uvhttp_router_match(router, "/orders/1", "GET", &match),
+              UVHTTP_OK);
+    EXPECT_EQ(match.handler, handler_a);
+    ASSERT_EQ(uvhttp_router_match(router, "/orders/1", "POST", &match),
+              UVHTTP_OK);
+    EXPECT_EQ(match.handler, handler_b);
+    ASSERT_EQ(uvhttp_router_match(router, "/orders/1", "GET", &match),
+              UVHTTP_OK);
+    EXPECT_EQ(match.handler, handler_a);
+}
+
+TEST_F(RouterWithMatchCacheTest, MissesAreNotCached) {
+    ASSERT_EQ(uvhttp_router_add_route(router, "/a/:id", handler_a), UVHTTP_OK);
+
+    uvhttp_route_match_t match;
+    EXPECT_EQ(uvhttp_router_match(router, "/b/1", "GET", &match),
+              UVHTTP_ERROR_NOT_FOUND);
+    EXPECT_EQ(uvhttp_router_match(router, "/b/1", "GET", &match),
+              UVHTTP_ERROR_NOT_FOUND);
+    EXPECT_EQ(stats().hits, 0u);
+    EXPECT_EQ(stats().misses, 2u);
+}
+
+#endif /* UVHTTP_FEATURE_ROUTER_MATCH_CACHE */
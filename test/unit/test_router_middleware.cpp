@@ -0,0 +1,432 @@
+/* UVHTTP router middleware tests: per-prefix chains resolved at registration
+ * and the runtime pipeline that runs them */
+
+#include <gtest/gtest.h>
+#include <string.h>
+#include <string>
+#include "uvhttp.h"
+#include "uvhttp_middleware.h"
+#include "uvhttp_router.h"
+#include "uvhttp_router_middleware.h"
+
+/* defined in uvhttp_router.c, not in a public header */
+extern "C" {
+uvhttp_error_t uvhttp_router_add_static_route(uvhttp_router_t* router,
+                                              const char* prefix_path,
+                                              void* static_context);
+uvhttp_error_t uvhttp_router_add_fallback_route(uvhttp_router_t* router,
+                                                void* static_context);
+}
+
+static int handler_a(uvhttp_request_t* request, uvhttp_response_t* response) {
+    (void)request;
+    (void)response;
+    return 1;
+}
+
+static int handler_b(uvhttp_request_t* request, uvhttp_response_t* response) {
+    (void)request;
+    (void)response;
+    return 2;
+}
+
+static std::string trace;
+
+static int mw_auth(uvhttp_request_t* request, uvhttp_response_t* response,
+                   uvhttp_middleware_context_t* ctx) {
+    (void)request;
+    (void)response;
+    (void)ctx;
+    trace += "auth,";
+    return UVHTTP_MIDDLEWARE_CONTINUE;
+}
+
+static int mw_log(uvhttp_request_t* request, uvhttp_response_t* response,
+                  uvhttp_middleware_context_t* ctx) {
+    (void)request;
+    (void)response;
+    (void)ctx;
+    trace += "log,";
+    return UVHTTP_MIDDLEWARE_CONTINUE;
+}
+
+static int mw_stop(uvhttp_request_t* request, uvhttp_response_t* response,
+                   uvhttp_middleware_context_t* ctx) {
+    (void)request;
+    (void)response;
+    (void)ctx;
+    trace += "stop,";
+    return UVHTTP_MIDDLEWARE_STOP;
+}
+
+static int mw_async(uvhttp_request_t* request, uvhttp_response_t* response,
+                    uvhttp_middleware_context_t* ctx) {
+    (void)request;
+    (void)response;
+    (void)ctx;
+    trace += "async,";
+    return UVHTTP_MIDDLEWARE_ASYNC;
+}
+
+static void note_cleanup(void* data) {
+    (void)data;
+    trace += "cleanup,";
+}
+
+static int mw_with_cleanup(uvhttp_request_t* request,
+                           uvhttp_response_t* response,
+                           uvhttp_middleware_context_t* ctx) {
+    (void)request;
+    (void)response;
+    ctx->data = &trace;
+    ctx->cleanup = note_cleanup;
+    trace += "data,";
+    return UVHTTP_MIDDLEWARE_ASYNC;
+}
+
+static void on_done(uvhttp_middleware_context_t* ctx) {
+    trace += "done,";
+    if (ctx->handler) {
+        trace += ctx->handler(NULL, NULL) == 1 ? "a," : "b,";
+    }
+}
+
+/* names of the middleware of a chain, in order */
+static std::string chain_of(const uvhttp_middleware_handler_t* chain,
+                            size_t count) {
+    std::string names;
+    for (size_t i = 0; i < count; i++) {
+        if (chain[i] == mw_auth) {
+            names += "auth,";
+        } else if (chain[i] == mw_log) {
+            names += "log,";
+        } else {
+            names += "?,";
+        }
+    }
+    return names;
+}
+
+class RouterMiddlewareTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        trace.clear();
+        ASSERT_EQ(uvhttp_router_new(&router), UVHTTP_OK);
+    }
+    void TearDown() override { uvhttp_router_free(router); }
+
+    std::string pipeline(const char* path, const char* method = "GET",
+                         uvhttp_request_handler_t* handler = NULL) {
+        const uvhttp_middleware_handler_t* chain = NULL;
+        size_t count = 0;
+        uvhttp_request_handler_t h = uvhttp_router_find_pipeline(
+            router, path, method, &chain, &count);
+        if (handler) {
+            *handler = h;
+        }
+        return chain_of(chain, count);
+    }
+
+    uvhttp_router_t* router = NULL;
+};
+
+TEST_F(RouterMiddlewareTest, RejectsBadArguments) {
+    EXPECT_EQ(uvhttp_router_use(NULL, "/api", mw_auth),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_router_use(router, "/api", NULL),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_router_use(router, "api", mw_auth),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_router_use(router, "/users/:id", mw_auth),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_router_use(router, "/files/*", mw_auth),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_router_use(router, "/a?b=1", mw_auth),
+              UVHTTP_ERROR_INVALID_PARAM);
+}
+
+TEST_F(RouterMiddlewareTest, NoMiddlewareMeansEmptyChain) {
+    ASSERT_EQ(uvhttp_router_add_route(router, "/api/users", handler_a),
+              UVHTTP_OK);
+
+    uvhttp_request_handler_t handler = NULL;
+    EXPECT_EQ(pipeline("/api/users", "GET", &handler), "");
+    EXPECT_EQ(handler, handler_a);
+
+    uvhttp_route_match_t match;
+    ASSERT_EQ(uvhttp_router_match(router, "/api/users", "GET", &match),
+              UVHTTP_OK);
+    EXPECT_EQ(match.middleware, nullptr);
+    EXPECT_EQ(match.middleware_count, 0u);
+}
+
+TEST_F(RouterMiddlewareTest, PrefixAppliesAtSegmentBoundary) {
+    ASSERT_EQ(uvhttp_router_use(router, "/api", mw_auth), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route(router, "/api", handler_a), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route(router, "/api/users", handler_a),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route(router, "/apix", handler_b), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route(router, "/home", handler_b), UVHTTP_OK);
+
+    EXPECT_EQ(pipeline("/api"), "auth,");
+    EXPECT_EQ(pipeline("/api/users"), "auth,");
+    EXPECT_EQ(pipeline("/apix"), "");
+    EXPECT_EQ(pipeline("/home"), "");
+}
+
+TEST_F(RouterMiddlewareTest, ChainsFollowRegistrationOrder) {
+    ASSERT_EQ(uvhttp_router_use(router, "/api", mw_auth), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_use(router, NULL, mw_log), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route(router, "/api/users", handler_a),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route(router, "/home", handler_b), UVHTTP_OK);
+
+    EXPECT_EQ(pipeline("/api/users"), "auth,log,");
+    EXPECT_EQ(pipeline("/home"), "log,");
+}
+
+TEST_F(RouterMiddlewareTest, ParameterRoutesUseTheirStaticLead) {
+    ASSERT_EQ(uvhttp_router_use(router, "/users", mw_auth), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route(router, "/users/:id/posts", handler_a),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route(router, "/:section/about", handler_b),
+              UVHTTP_OK);
+
+    uvhttp_request_handler_t handler = NULL;
+    EXPECT_EQ(pipeline("/users/7/posts", "GET", &handler), "auth,");
+    EXPECT_EQ(handler, handler_a);
+    /* the matched path starts with /users but the route does not */
+    EXPECT_EQ(pipeline("/users/about", "GET", &handler), "");
+    EXPECT_EQ(handler, handler_b);
+
+    uvhttp_route_match_t match;
+    ASSERT_EQ(uvhttp_router_match(router, "/users/7/posts", "GET", &match),
+              UVHTTP_OK);
+    EXPECT_EQ(chain_of(match.middleware, match.middleware_count), "auth,");
+    size_t len = 0;
+    const char* id = uvhttp_route_match_param(&match, "id", &len);
+    ASSERT_NE(id, nullptr);
+    EXPECT_EQ(std::string(id, len), "7");
+}
+
+TEST_F(RouterMiddlewareTest, UseAfterRoutesReresolves) {
+    ASSERT_EQ(uvhttp_router_add_route(router, "/api/users", handler_a),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route(router, "/api/items/:id", handler_a),
+              UVHTTP_OK);
+    EXPECT_EQ(pipeline("/api/users"), "");
+
+    ASSERT_EQ(uvhttp_router_use(router, "/api", mw_auth), UVHTTP_OK);
+    EXPECT_EQ(pipeline("/api/users"), "auth,");
+    EXPECT_EQ(pipeline("/api/items/3"), "auth,");
+
+    ASSERT_EQ(uvhttp_router_use(router, "/api/items", mw_log), UVHTTP_OK);
+    EXPECT_EQ(pipeline("/api/users"), "auth,");
+    EXPECT_EQ(pipeline("/api/items/3"), "auth,log,");
+}
+
+TEST_F(RouterMiddlewareTest, ArrayModeRoutesReresolve) {
+    /* static routes only: the default backend keeps them in its array */
+    for (int i = 0; i < 10; i++) {
+        char path[32];
+        snprintf(path, sizeof(path), "/api/r%d", i);
+        ASSERT_EQ(uvhttp_router_add_route(router, path, handler_a), UVHTTP_OK);
+    }
+    ASSERT_EQ(uvhttp_router_use(router, "/api", mw_auth), UVHTTP_OK);
+    EXPECT_EQ(pipeline("/api/r0"), "auth,");
+    EXPECT_EQ(pipeline("/api/r9"), "auth,");
+}
+
+TEST_F(RouterMiddlewareTest, UnmatchedRequestsRunTheirPrefixChain) {
+    ASSERT_EQ(uvhttp_router_use(router, "/", mw_log), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_use(router, "/api", mw_auth), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route_method(router, "/api/users", UVHTTP_GET,
+                                             handler_a),
+              UVHTTP_OK);
+
+    uvhttp_request_handler_t handler = handler_a;
+    EXPECT_EQ(pipeline("/missing", "GET", &handler), "log,");
+    EXPECT_EQ(handler, nullptr);
+    EXPECT_EQ(pipeline("/api/missing", "GET", &handler), "log,auth,");
+    EXPECT_EQ(pipeline("/api/users", "POST", &handler), "log,auth,");
+    EXPECT_EQ(pipeline("/apix/missing"), "log,");
+}
+
+TEST_F(RouterMiddlewareTest, PrefixGuardsStaticFilesUnderIt) {
+    int static_context = 0;
+    ASSERT_EQ(uvhttp_router_use(router, "/admin", mw_auth), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_use(router, "/admin/reports", mw_log), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route(router, "/home", handler_a), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_static_route(router, "/admin/files/",
+                                             &static_context),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_fallback_route(router, &static_context),
+              UVHTTP_OK);
+
+    uvhttp_request_handler_t handler = NULL;
+    EXPECT_EQ(pipeline("/admin/files/secret.txt", "GET", &handler), "auth,");
+    EXPECT_NE(handler, nullptr);
+    /* the fallback serves files from the root too */
+    EXPECT_EQ(pipeline("/admin/secret.txt", "GET", &handler), "auth,");
+    EXPECT_NE(handler, nullptr);
+    EXPECT_EQ(pipeline("/admin/reports/q1.pdf"), "auth,log,");
+    EXPECT_EQ(pipeline("/admin?download=1"), "auth,");
+    /* spellings the file system resolves under the prefix */
+    EXPECT_EQ(pipeline("//admin/secret.txt"), "auth,");
+    EXPECT_EQ(pipeline("/./admin/secret.txt"), "auth,");
+    EXPECT_EQ(pipeline("/admin//reports/q1.pdf"), "auth,log,");
+    EXPECT_EQ(pipeline("/administrator.txt"), "");
+    EXPECT_EQ(pipeline("/public/logo.png"), "");
+    EXPECT_EQ(pipeline("/home"), "");
+}
+
+TEST_F(RouterMiddlewareTest, RoutesUnderEqualPrefixesShareAChain) {
+    ASSERT_EQ(uvhttp_router_use(router, "/api", mw_auth), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route(router, "/api/a", handler_a), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route(router, "/api/b", handler_b), UVHTTP_OK);
+
+    const uvhttp_middleware_handler_t* first = NULL;
+    const uvhttp_middleware_handler_t* second = NULL;
+    size_t count = 0;
+    uvhttp_router_find_pipeline(router, "/api/a", "GET", &first, &count);
+    uvhttp_router_find_pipeline(router, "/api/b", "GET", &second, &count);
+    EXPECT_EQ(count, 1u);
+    EXPECT_EQ(first, second);
+}
+
+TEST_F(RouterMiddlewareTest, FrozenRoutesKeepTheirChains) {
+    ASSERT_EQ(uvhttp_router_use(router, "/api", mw_auth), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_use(router, NULL, mw_log), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route(router, "/api/users", handler_a),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route(router, "/api/users/:id", handler_b),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route(router, "/home", handler_b), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_freeze(router), UVHTTP_OK);
+
+    EXPECT_EQ(uvhttp_router_use(router, "/x", mw_auth),
+              UVHTTP_ERROR_ROUTER_FROZEN);
+
+    uvhttp_request_handler_t handler = NULL;
+    EXPECT_EQ(pipeline("/api/users", "GET", &handler), "auth,log,");
+    EXPECT_EQ(handler, handler_a);
+    EXPECT_EQ(pipeline("/api/users/9", "GET", &handler), "auth,log,");
+    EXPECT_EQ(handler, handler_b);
+    EXPECT_EQ(pipeline("/home"), "log,");
+    EXPECT_EQ(pipeline("/nowhere"), "log,");
+}
+
+TEST_F(RouterMiddlewareTest, RepeatedLookupsKeepTheChain) {
+    /* with the match cache on, the second lookup is a cache hit */
+    ASSERT_EQ(uvhttp_router_use(router, "/api", mw_auth), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route(router, "/api/items/:id", handler_a),
+              UVHTTP_OK);
+    EXPECT_EQ(pipeline("/api/items/1"), "auth,");
+    EXPECT_EQ(pipeline("/api/items/1"), "auth,");
+
+    ASSERT_EQ(uvhttp_router_use(router, "/api/items", mw_log), UVHTTP_OK);
+    EXPECT_EQ(pipeline("/api/items/1"), "auth,log,");
+}
+
+/* ========== Runtime pipeline ========== */
+
+TEST(MiddlewarePipelineTest, RunsChainThenDone) {
+    trace.clear();
+    uvhttp_middleware_handler_t chain[] = {mw_auth, mw_log};
+    uvhttp_middleware_context_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+
+    uvhttp_middleware_start(&ctx, NULL, NULL, chain, 2, handler_a, on_done,
+                            NULL);
+    EXPECT_EQ(trace, "auth,log,done,a,");
+    EXPECT_FALSE(uvhttp_middleware_pending(&ctx));
+}
+
+TEST(MiddlewarePipelineTest, EmptyChainGoesStraightToDone) {
+    trace.clear();
+    uvhttp_middleware_context_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+
+    uvhttp_middleware_start(&ctx, NULL, NULL, NULL, 0, handler_b, on_done,
+                            NULL);
+    EXPECT_EQ(trace, "done,b,");
+}
+
+TEST(MiddlewarePipelineTest, StopSkipsTheRest) {
+    trace.clear();
+    uvhttp_middleware_handler_t chain[] = {mw_auth, mw_stop, mw_log};
+    uvhttp_middleware_context_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+
+    uvhttp_middleware_start(&ctx, NULL, NULL, chain, 3, handler_a, on_done,
+                            NULL);
+    EXPECT_EQ(trace, "auth,stop,");
+    EXPECT_FALSE(uvhttp_middleware_pending(&ctx));
+}
+
+TEST(MiddlewarePipelineTest, AsyncSuspendsUntilResumed) {
+    trace.clear();
+    uvhttp_middleware_handler_t chain[] = {mw_auth, mw_async, mw_log};
+    uvhttp_middleware_context_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+
+    uvhttp_middleware_start(&ctx, NULL, NULL, chain, 3, handler_a, on_done,
+                            NULL);
+    EXPECT_EQ(trace, "auth,async,");
+    EXPECT_TRUE(uvhttp_middleware_pending(&ctx));
+
+    uvhttp_middleware_resume(&ctx, UVHTTP_MIDDLEWARE_ASYNC);
+    EXPECT_EQ(trace, "auth,async,");
+    EXPECT_TRUE(uvhttp_middleware_pending(&ctx));
+
+    uvhttp_middleware_resume(&ctx, UVHTTP_MIDDLEWARE_CONTINUE);
+    EXPECT_EQ(trace, "auth,async,log,done,a,");
+    EXPECT_FALSE(uvhttp_middleware_pending(&ctx));
+
+    /* resuming an idle context is ignored */
+    uvhttp_middleware_resume(&ctx, UVHTTP_MIDDLEWARE_CONTINUE);
+    EXPECT_EQ(trace, "auth,async,log,done,a,");
+}
+
+TEST(MiddlewarePipelineTest, ResumeWithStopEndsThePipeline) {
+    trace.clear();
+    uvhttp_middleware_handler_t chain[] = {mw_async, mw_log};
+    uvhttp_middleware_context_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+
+    uvhttp_middleware_start(&ctx, NULL, NULL, chain, 2, handler_a, on_done,
+                            NULL);
+    uvhttp_middleware_resume(&ctx, UVHTTP_MIDDLEWARE_STOP);
+    EXPECT_EQ(trace, "async,");
+    EXPECT_FALSE(uvhttp_middleware_pending(&ctx));
+}
+
+TEST(MiddlewarePipelineTest, CancelRunsCleanupWithoutDone) {
+    trace.clear();
+    uvhttp_middleware_handler_t chain[] = {mw_with_cleanup, mw_log};
+    uvhttp_middleware_context_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+
+    uvhttp_middleware_start(&ctx, NULL, NULL, chain, 2, handler_a, on_done,
+                            NULL);
+    EXPECT_EQ(trace, "data,");
+    uvhttp_middleware_cancel(&ctx);
+    EXPECT_EQ(trace, "data,cleanup,");
+    EXPECT_FALSE(uvhttp_middleware_pending(&ctx));
+
+    uvhttp_middleware_cancel(&ctx);
+    uvhttp_middleware_resume(&ctx, UVHTTP_MIDDLEWARE_CONTINUE);
+    EXPECT_EQ(trace, "data,cleanup,");
+}
+
+TEST(MiddlewarePipelineTest, CleanupRunsBeforeDone) {
+    trace.clear();
+    uvhttp_middleware_handler_t chain[] = {mw_with_cleanup};
+    uvhttp_middleware_context_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+
+    uvhttp_middleware_start(&ctx, NULL, NULL, chain, 1, handler_b, on_done,
+                            NULL);
+    uvhttp_middleware_resume(&ctx, UVHTTP_MIDDLEWARE_CONTINUE);
+    EXPECT_EQ(trace, "data,cleanup,done,b,");
+}
@@ -0,0 +1,280 @@
+/* UVHTTP radix tree router tests: fan-out, long segments, priority,
+ * backtracking, catch-all and per-method handlers */
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "uvhttp.h"
+#include "uvhttp_router.h"
+
+#if !UVHTTP_FEATURE_ROUTER_CACHE
+
+static int handler_a(uvhttp_request_t* request, uvhttp_response_t* response) {
+    (void)request;
+    (void)response;
+    return 1;
+}
+
+static int handler_b(uvhttp_request_t* request, uvhttp_response_t* response) {
+    (void)request;
+    (void)response;
+    return 2;
+}
+
+static int handler_c(uvhttp_request_t* request, uvhttp_response_t* response) {
+    (void)request;
+    (void)response;
+    return 3;
+}
+
+class RouterRadixTest : public ::testing::Test {
+  protected:
+    void SetUp() override { ASSERT_EQ(uvhttp_router_new(&router), UVHTTP_OK); }
+    void TearDown() override { uvhttp_router_free(router); }
+
+    uvhttp_request_handler_t find(const char* path,
+                                  const char* method = "GET") {
+        return uvhttp_router_find_handler(router, path, method);
+    }
+
+    /* decoded value of parameter name, "<missing>" if absent */
+    static std::string param(const uvhttp_route_match_t& match,
+                             const char* name) {
+        char buf[512];
+        if (uvhttp_route_match_param_copy(&match, name, buf, sizeof(buf),
+                                          NULL) != UVHTTP_OK) {
+            return "<missing>";
+        }
+        return buf;
+    }
+
+    uvhttp_router_t* router = NULL;
+};
+
+TEST_F(RouterRadixTest, ManySiblingsBeyondOldFanOut) {
+    char path[64];
+    for (int i = 0; i < 200; i++) {
+        snprintf(path, sizeof(path), "/p%d/:id", i);
+        ASSERT_EQ(uvhttp_router_add_route(router, path,
+                                          i % 2 ? handler_a : handler_b),
+                  UVHTTP_OK);
+    }
+    EXPECT_EQ(router->route_count, 200u);
+    for (int i = 0; i < 200; i++) {
+        snprintf(path, sizeof(path), "/p%d/42", i);
+        EXPECT_EQ(find(path), i % 2 ? handler_a : handler_b) << path;
+    }
+    EXPECT_EQ(find("/p200/42"), nullptr);
+}
+
+TEST_F(RouterRadixTest, LongSegmentsAreComparedInFull) {
+    const char* long_a =
+        "/api/this-segment-is-well-beyond-thirty-two-bytes-long-a/:id";
+    const char* long_b =
+        "/api/this-segment-is-well-beyond-thirty-two-bytes-long-b/:id";
+    ASSERT_EQ(uvhttp_router_add_route(router, long_a, handler_a), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route(router, long_b, handler_b), UVHTTP_OK);
+
+    EXPECT_EQ(find("/api/this-segment-is-well-beyond-thirty-two-bytes-long-a/1"),
+              handler_a);
+    EXPECT_EQ(find("/api/this-segment-is-well-beyond-thirty-two-bytes-long-b/1"),
+              handler_b);
+    EXPECT_EQ(find("/api/this-segment-is-well-beyond-thirty-two-bytes-long-c/1"),
+              nullptr);
+    EXPECT_EQ(find("/api/this-segment-is-well-beyond-thirty-two-bytes/1"),
+              nullptr);
+}
+
+TEST_F(RouterRadixTest, StaticBeatsParamBeatsCatchAll) {
+    ASSERT_EQ(uvhttp_router_add_route(router, "/users/*rest", handler_c),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route(router, "/users/:id", handler_b),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route(router, "/users/me", handler_a),
+              UVHTTP_OK);
+
+    EXPECT_EQ(find("/users/me"), handler_a);
+    EXPECT_EQ(find("/users/42"), handler_b);
+    EXPECT_EQ(find("/users/mex"), handler_b);
+    EXPECT_EQ(find("/users/42/posts"), handler_c);
+    EXPECT_EQ(find("/users/"), handler_c);
+}
+
+TEST_F(RouterRadixTest, BacktracksOutOfStaticBranch) {
+    ASSERT_EQ(uvhttp_router_add_route(router, "/files/new/edit", handler_a),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route(router, "/files/:name/view", handler_b),
+              UVHTTP_OK);
+
+    /* "new" takes the static branch first, which has no "/view" */
+    EXPECT_EQ(find("/files/new/view"), handler_b);
+    EXPECT_EQ(find("/files/new/edit"), handler_a);
+
+    uvhttp_route_match_t match;
+    ASSERT_EQ(uvhttp_router_match(router, "/files/new/view", "GET", &match),
+              UVHTTP_OK);
+    ASSERT_EQ(match.param_count, 1u);
+    EXPECT_EQ(param(match, "name"), "new");
+}
+
+TEST_F(RouterRadixTest, ParamsAndCatchAllCaptureRawSlices) {
+    ASSERT_EQ(uvhttp_router_add_route(
+                  router, "/repos/:owner/:repo/blob/*path", handler_a),
+              UVHTTP_OK);
+
+    uvhttp_route_match_t match;
+    ASSERT_EQ(uvhttp_router_match(router, "/repos/uv/http/blob/src/a/b.c",
+                                  "GET", &match),
+              UVHTTP_OK);
+    EXPECT_EQ(match.handler, handler_a);
+    ASSERT_EQ(match.param_count, 3u);
+    EXPECT_EQ(param(match, "owner"), "uv");
+    EXPECT_EQ(param(match, "repo"), "http");
+    EXPECT_EQ(param(match, "path"), "src/a/b.c");
+
+    /* names in path order, values point into the matched path */
+    size_t len = 0;
+    const char* name = uvhttp_route_match_param_name(&match, 1, &len);
+    ASSERT_NE(name, nullptr);
+    EXPECT_EQ(std::string(name, len), "repo");
+    EXPECT_EQ(uvhttp_route_match_param_name(&match, 3, &len), nullptr);
+    const char* path = "/repos/uv/http/blob/src/a/b.c";
+    ASSERT_EQ(uvhttp_router_match(router, path, "GET", &match), UVHTTP_OK);
+    EXPECT_EQ(uvhttp_route_match_param(&match, "repo", &len), path + 10);
+    EXPECT_EQ(len, 4u);
+    EXPECT_EQ(uvhttp_route_match_param(&match, "missing", &len), nullptr);
+
+    /* a parameter never matches an empty segment */
+    EXPECT_EQ(uvhttp_router_match(router, "/repos//http/blob/x", "GET", &match),
+              UVHTTP_ERROR_NOT_FOUND);
+}
+
+TEST_F(RouterRadixTest, LongValuesAreNotTruncated) {
+    ASSERT_EQ(uvhttp_router_add_route(router, "/blobs/:id", handler_a),
+              UVHTTP_OK);
+
+    std::string id(1000, 'x');
+    std::string path = "/blobs/" + id;
+    uvhttp_route_match_t match;
+    ASSERT_EQ(uvhttp_router_match(router, path.c_str(), "GET", &match),
+              UVHTTP_OK);
+
+    size_t len = 0;
+    ASSERT_NE(uvhttp_route_match_param(&match, "id", &len), nullptr);
+    EXPECT_EQ(len, id.size());
+
+    /* a buffer that is too small is an error, never a silent cut */
+    char small[16];
+    EXPECT_EQ(uvhttp_route_match_param_copy(&match, "id", small, sizeof(small),
+                                            NULL),
+              UVHTTP_ERROR_BUFFER_TOO_SMALL);
+    std::string big(id.size() + 1, '\0');
+    size_t out_len = 0;
+    EXPECT_EQ(uvhttp_route_match_param_copy(&match, "id", &big[0], big.size(),
+                                            &out_len),
+              UVHTTP_OK);
+    EXPECT_EQ(out_len, id.size());
+    EXPECT_EQ(big.substr(0, out_len), id);
+    EXPECT_EQ(uvhttp_route_match_param_copy(&match, "nope", small,
+                                            sizeof(small), NULL),
+              UVHTTP_ERROR_NOT_FOUND);
+}
+
+TEST_F(RouterRadixTest, ParamCopyPercentDecodes) {
+    ASSERT_EQ(uvhttp_router_add_route(router, "/tags/:tag", handler_a),
+              UVHTTP_OK);
+
+    uvhttp_route_match_t match;
+    ASSERT_EQ(uvhttp_router_match(router, "/tags/c%2B%2b%20x%zz%4", "GET",
+                                  &match),
+              UVHTTP_OK);
+    EXPECT_EQ(param(match, "tag"), "c++ x%zz%4");
+
+    size_t len = 0;
+    const char* raw = uvhttp_route_match_param(&match, "tag", &len);
+    ASSERT_NE(raw, nullptr);
+    EXPECT_EQ(std::string(raw, len), "c%2B%2b%20x%zz%4");
+}
+
+TEST_F(RouterRadixTest, PerMethodHandlersOnOneNode) {
+    ASSERT_EQ(uvhttp_router_add_route_method(router, "/items/:id", UVHTTP_GET,
+                                             handler_a),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route_method(router, "/items/:id", UVHTTP_POST,
+                                             handler_b),
+              UVHTTP_OK);
+
+    EXPECT_EQ(find("/items/1", "GET"), handler_a);
+    EXPECT_EQ(find("/items/1", "POST"), handler_b);
+    EXPECT_EQ(find("/items/1", "DELETE"), nullptr);
+
+    /* ANY serves the methods without a handler of their own */
+    ASSERT_EQ(uvhttp_router_add_route(router, "/items/:id", handler_c),
+              UVHTTP_OK);
+    EXPECT_EQ(find("/items/1", "DELETE"), handler_c);
+    EXPECT_EQ(find("/items/1", "GET"), handler_a);
+}
+
+TEST_F(RouterRadixTest, PerMethodParamNamesOnOneNode) {
+    ASSERT_EQ(uvhttp_router_add_route_method(router, "/users/:id", UVHTTP_GET,
+                                             handler_a),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route_method(router, "/users/:uid",
+                                             UVHTTP_DELETE, handler_b),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_router_add_route(router, "/users/:user", handler_c),
+              UVHTTP_OK);
+
+    /* each handler reads the names of the pattern it was added with */
+    uvhttp_route_match_t match;
+    ASSERT_EQ(uvhttp_router_match(router, "/users/7", "GET", &match),
+              UVHTTP_OK);
+    EXPECT_EQ(match.handler, handler_a);
+    EXPECT_EQ(param(match, "id"), "7");
+    EXPECT_EQ(param(match, "uid"), "<missing>");
+
+    ASSERT_EQ(uvhttp_router_match(router, "/users/8", "DELETE", &match),
+              UVHTTP_OK);
+    EXPECT_EQ(match.handler, handler_b);
+    EXPECT_EQ(param(match, "uid"), "8");
+    EXPECT_EQ(param(match, "id"), "<missing>");
+
+    ASSERT_EQ(uvhttp_router_match(router, "/users/9", "POST", &match),
+              UVHTTP_OK);
+    EXPECT_EQ(match.handler, handler_c);
+    EXPECT_EQ(param(match, "user"), "9");
+}
+
+TEST_F(RouterRadixTest, InvalidPatterns) {
+    EXPECT_EQ(uvhttp_router_add_route(router, "/a/:/b", handler_a),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_router_add_route(router, "/a/*rest/b", handler_a),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(router->route_count, 0u);
+
+    /* ':' and '*' inside a segment are plain text */
+    ASSERT_EQ(uvhttp_router_add_route(router, "/a/b:c/d*e/:id", handler_a),
+              UVHTTP_OK);
+    EXPECT_EQ(find("/a/b:c/d*e/1"), handler_a);
+    EXPECT_EQ(find("/a/bxc/d*e/1"), nullptr);
+}
+
+TEST_F(RouterRadixTest, TwoThousandRoutes) {
+    char route[128];
+    char path[128];
+    for (int i = 0; i < 2000; i++) {
+        snprintf(route, sizeof(route), "/svc%d/res%d/:id/sub%d", i / 50, i % 50,
+                 i);
+        ASSERT_EQ(uvhttp_router_add_route(router, route, handler_a), UVHTTP_OK);
+    }
+    for (int i = 0; i < 2000; i += 7) {
+        snprintf(path, sizeof(path), "/svc%d/res%d/x/sub%d", i / 50, i % 50, i);
+        EXPECT_EQ(find(path), handler_a) << path;
+        snprintf(path, sizeof(path), "/svc%d/res%d/x/sub%d", i / 50, i % 50,
+                 i + 1);
+        EXPECT_EQ(find(path), nullptr) << path;
+    }
+}
+
+#endif /* !UVHTTP_FEATURE_ROUTER_CACHE */
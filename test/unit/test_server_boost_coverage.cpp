@@ -695,11 +695,9 @@ protected:
                 // stored ws_conn pointers so uvhttp_server_ws_disable_connection_management
                 // does not dereference them (use-after-scope) when sending close
                 // frames. (Same pattern used by the CloseAll_* tests below.)
-                ws_connection_node_t* node =
-                    server->ws_connection_manager->connections;
-                while (node) {
-                    node->ws_conn = nullptr;
-                    node = node->next;
+                ws_connection_manager_t* mgr = server->ws_connection_manager;
+                for (int i = 0; i < mgr->connection_count; i++) {
+                    mgr->connections[i]->ws_conn = nullptr;
                 }
                 uvhttp_server_ws_disable_connection_management(server);
             }
@@ -951,7 +949,7 @@ TEST_F(WSConnectionManagementTest, RemoveConnection_FromMiddle) {
     uvhttp_server_ws_add_connection(server, &fake1, "/ws");
     uvhttp_server_ws_add_connection(server, &fake2, "/ws");
     uvhttp_server_ws_add_connection(server, &fake3, "/ws");
-    // List is: fake3 -> fake2 -> fake1 (add prepends)
+    // Registry is: fake1, fake2, fake3 (add appends)
     // Remove the middle one
     uvhttp_server_ws_remove_connection(server, &fake2);
     EXPECT_EQ(server->ws_connection_manager->connection_count, 2);
@@ -962,9 +960,9 @@ TEST_F(WSConnectionManagementTest, RemoveConnection_FirstNode) {
     uvhttp_ws_connection_t fake1{}, fake2{};
     uvhttp_server_ws_add_connection(server, &fake1, "/ws");
     uvhttp_server_ws_add_connection(server, &fake2, "/ws");
-    // List is: fake2 -> fake1 (add prepends)
-    // Remove the head (most recently added)
-    uvhttp_server_ws_remove_connection(server, &fake2);
+    // Registry is: fake1, fake2 (add appends)
+    // Remove the first one (the last entry is swapped into its slot)
+    uvhttp_server_ws_remove_connection(server, &fake1);
     EXPECT_EQ(server->ws_connection_manager->connection_count, 1);
 }
 
@@ -1115,10 +1113,9 @@ TEST_F(WSConnectionManagementTest, CloseAll_WithMatchingConnections) {
 
     // Null out ws_conn pointers to prevent uvhttp_ws_close from dereferencing
     // fake pointers (the function checks ws_conn != NULL before calling close)
-    ws_connection_node_t* node = server->ws_connection_manager->connections;
-    while (node) {
-        node->ws_conn = nullptr;
-        node = node->next;
+    ws_connection_manager_t* mgr = server->ws_connection_manager;
+    for (int i = 0; i < mgr->connection_count; i++) {
+        mgr->connections[i]->ws_conn = nullptr;
     }
 
     // Close all on /chat - should remove 2 nodes, leave /other
@@ -1137,10 +1134,9 @@ TEST_F(WSConnectionManagementTest, CloseAll_NullPathClosesAll) {
     EXPECT_EQ(server->ws_connection_manager->connection_count, 3);
 
     // Null out ws_conn to prevent uvhttp_ws_close crash
-    ws_connection_node_t* node = server->ws_connection_manager->connections;
-    while (node) {
-        node->ws_conn = nullptr;
-        node = node->next;
+    ws_connection_manager_t* mgr = server->ws_connection_manager;
+    for (int i = 0; i < mgr->connection_count; i++) {
+        mgr->connections[i]->ws_conn = nullptr;
     }
 
     // NULL path closes all connections
@@ -472,7 +472,7 @@ TEST_F(WsTimeoutTimerTest, TimeoutTimer_ClosesTimedOutConnection) {
     EXPECT_EQ(mgr->connection_count, 1);
 
     // Set last_activity to 0 so current_time - 0 > timeout_ms immediately
-    mgr->connections->last_activity = 0;
+    mgr->connections[0]->last_activity = 0;
 
     // Restart the timeout timer with a very short initial delay (10ms)
     // Access the callback stored in the timer handle's private fields
@@ -555,16 +555,12 @@ TEST_F(WsTimeoutTimerTest, TimeoutTimer_MultipleConnections) {
     EXPECT_EQ(mgr->connection_count, 3);
 
     // Set first two connections' last_activity to 0 (stale)
-    // List is: ws3 -> ws2 -> ws1 (add prepends)
-    ws_connection_node_t* node = mgr->connections;
-    ASSERT_NE(node, nullptr);
-    // ws3 (head) - keep active
-    node = node->next;
-    ASSERT_NE(node, nullptr);
-    node->last_activity = 0;  // ws2 - stale
-    node = node->next;
-    ASSERT_NE(node, nullptr);
-    node->last_activity = 0;  // ws1 - stale
+    // Registry is: ws1, ws2, ws3 (add appends)
+    ASSERT_EQ(mgr->connections[0]->ws_conn, ws1);
+    ASSERT_EQ(mgr->connections[1]->ws_conn, ws2);
+    mgr->connections[0]->last_activity = 0;  // ws1 - stale
+    mgr->connections[1]->last_activity = 0;  // ws2 - stale
+    // ws3 - keep active
 
     // Restart timeout timer with short delay
     uv_timer_cb timeout_cb = mgr->timeout_timer.timer_cb;
@@ -635,7 +631,7 @@ TEST_F(WsHeartbeatTimerTest, Heartbeat_SendsPingToOpenConnection) {
 
     uvhttp_server_ws_add_connection(server, ws_conn, "/ws");
     EXPECT_EQ(mgr->connection_count, 1);
-    EXPECT_EQ(mgr->connections->ping_pending, 0);
+    EXPECT_EQ(mgr->connections[0]->ping_pending, 0);
 
     // Restart the heartbeat timer with a short delay (10ms)
     uv_timer_cb heartbeat_cb = mgr->heartbeat_timer.timer_cb;
@@ -648,7 +644,7 @@ TEST_F(WsHeartbeatTimerTest, Heartbeat_SendsPingToOpenConnection) {
     pump_loop(&loop, 200);
 
     // The heartbeat should have sent a ping and set ping_pending = 1
-    EXPECT_EQ(mgr->connections->ping_pending, 1);
+    EXPECT_EQ(mgr->connections[0]->ping_pending, 1);
 
     // Drain any data sent to the socketpair
     char buf[64];
@@ -679,8 +675,8 @@ TEST_F(WsHeartbeatTimerTest, Heartbeat_PingTimeoutClosesConnection) {
     EXPECT_EQ(mgr->connection_count, 1);
 
     // Simulate that a ping was already sent and has timed out
-    mgr->connections->ping_pending = 1;
-    mgr->connections->last_ping_sent = 0;  // very old timestamp
+    mgr->connections[0]->ping_pending = 1;
+    mgr->connections[0]->last_ping_sent = 0;  // very old timestamp
     mgr->ping_timeout_ms = 0;              // timeout immediately
 
     // Restart the heartbeat timer with a short delay
@@ -720,7 +716,7 @@ TEST_F(WsHeartbeatTimerTest, Heartbeat_SkipsNonOpenConnection) {
 
     uvhttp_server_ws_add_connection(server, ws_conn, "/ws");
     EXPECT_EQ(mgr->connection_count, 1);
-    EXPECT_EQ(mgr->connections->ping_pending, 0);
+    EXPECT_EQ(mgr->connections[0]->ping_pending, 0);
 
     // Restart heartbeat timer
     uv_timer_cb heartbeat_cb = mgr->heartbeat_timer.timer_cb;
@@ -732,7 +728,7 @@ TEST_F(WsHeartbeatTimerTest, Heartbeat_SkipsNonOpenConnection) {
     pump_loop(&loop, 200);
 
     // ping_pending should remain 0 since connection is not OPEN
-    EXPECT_EQ(mgr->connections->ping_pending, 0);
+    EXPECT_EQ(mgr->connections[0]->ping_pending, 0);
 
     // The connection is still registered. Disable management (drops the
     // borrowed reference) before freeing it.
@@ -0,0 +1,236 @@
+/**
+ * @file test_server_ws_topics.cpp
+ * @brief WebSocket connection registry and topic subscription tests
+ *
+ * Validates the topic-indexed registry in src/uvhttp_server.c:
+ * - the upgrade path is a topic and counts are per topic
+ * - subscribe/unsubscribe on arbitrary topics, duplicate and missing cases
+ * - swap-delete keeps every topic's members and the connection array intact
+ * - topics are released once their last subscriber leaves
+ * - close_all on a topic only touches its subscribers
+ * - the topic table survives growth past its initial size
+ *
+ * Build configuration: UVHTTP_FEATURE_WEBSOCKET must be enabled.
+ */
+
+#if UVHTTP_FEATURE_WEBSOCKET
+
+#include <gtest/gtest.h>
+
+extern "C" {
+#include "uvhttp_server.h"
+#include "uvhttp_websocket.h"
+}
+
+#include <string>
+#include <vector>
+
+class WsTopicRegistryTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        uv_loop_init(&loop);
+        ASSERT_EQ(uvhttp_server_new(&loop, &server), UVHTTP_OK);
+        ASSERT_EQ(uvhttp_server_ws_enable_connection_management(server, 60, 30),
+                  UVHTTP_OK);
+        mgr = server->ws_connection_manager;
+        for (auto& c : conns) {
+            c = uvhttp_ws_connection_t{};
+            c.state = UVHTTP_WS_STATE_CLOSED; /* never sent to */
+        }
+    }
+
+    void TearDown() override {
+        /* the connections are fakes: keep disable from closing them */
+        for (int i = 0; i < mgr->connection_count; i++) {
+            mgr->connections[i]->ws_conn = nullptr;
+        }
+        uvhttp_server_ws_disable_connection_management(server);
+        uvhttp_server_free(server);
+        uv_loop_close(&loop);
+    }
+
+    /* every node's topic refs and every topic's members agree */
+    void check_consistency() {
+        uint32_t refs = 0;
+        for (int i = 0; i < mgr->connection_count; i++) {
+            ws_connection_node_t* node = mgr->connections[i];
+            ASSERT_EQ(node->index, (uint32_t)i);
+            ASSERT_EQ(node->ws_conn->registry_node, node);
+            for (uint32_t r = 0; r < node->topic_count; r++) {
+                ws_topic_t* topic = node->topics[r].topic;
+                ASSERT_LT(node->topics[r].slot, topic->count);
+                ASSERT_EQ(topic->members[node->topics[r].slot].node, node);
+                ASSERT_EQ(topic->members[node->topics[r].slot].ref, r);
+                refs++;
+            }
+        }
+        uint32_t members = 0, topics = 0;
+        for (uint32_t i = 0; i < mgr->topic_table_size; i++) {
+            if (mgr->topic_table[i]) {
+                ASSERT_GT(mgr->topic_table[i]->count, 0u);
+                members += mgr->topic_table[i]->count;
+                topics++;
+            }
+        }
+        EXPECT_EQ(refs, members);
+        EXPECT_EQ(topics, mgr->topic_count);
+    }
+
+    uv_loop_t loop{};
+    uvhttp_server_t* server = nullptr;
+    ws_connection_manager_t* mgr = nullptr;
+    uvhttp_ws_connection_t conns[8];
+};
+
+TEST_F(WsTopicRegistryTest, PathIsATopic) {
+    uvhttp_server_ws_add_connection(server, &conns[0], "/chat");
+    uvhttp_server_ws_add_connection(server, &conns[1], "/chat");
+    uvhttp_server_ws_add_connection(server, &conns[2], "/feed");
+
+    EXPECT_EQ(uvhttp_server_ws_get_connection_count(server), 3);
+    EXPECT_EQ(uvhttp_server_ws_get_connection_count_by_path(server, "/chat"),
+              2);
+    EXPECT_EQ(uvhttp_server_ws_get_connection_count_by_path(server, "/feed"),
+              1);
+    EXPECT_EQ(mgr->topic_count, 2u);
+    check_consistency();
+}
+
+TEST_F(WsTopicRegistryTest, SubscribeAndUnsubscribe) {
+    uvhttp_server_ws_add_connection(server, &conns[0], "/ws");
+    uvhttp_server_ws_add_connection(server, &conns[1], "/ws");
+
+    EXPECT_EQ(uvhttp_server_ws_subscribe(server, &conns[0], "prices"),
+              UVHTTP_OK);
+    EXPECT_EQ(uvhttp_server_ws_subscribe(server, &conns[1], "prices"),
+              UVHTTP_OK);
+    EXPECT_EQ(uvhttp_server_ws_subscribe(server, &conns[1], "news"),
+              UVHTTP_OK);
+    EXPECT_EQ(uvhttp_server_ws_subscribe(server, &conns[1], "news"),
+              UVHTTP_ERROR_ALREADY_EXISTS);
+    EXPECT_EQ(uvhttp_server_ws_get_connection_count_by_path(server, "prices"),
+              2);
+    check_consistency();
+
+    EXPECT_EQ(uvhttp_server_ws_unsubscribe(server, &conns[0], "prices"),
+              UVHTTP_OK);
+    EXPECT_EQ(uvhttp_server_ws_unsubscribe(server, &conns[0], "prices"),
+              UVHTTP_ERROR_NOT_FOUND);
+    EXPECT_EQ(uvhttp_server_ws_unsubscribe(server, &conns[0], "news"),
+              UVHTTP_ERROR_NOT_FOUND);
+    EXPECT_EQ(uvhttp_server_ws_get_connection_count_by_path(server, "prices"),
+              1);
+    check_consistency();
+
+    /* the last subscriber leaving releases the topic */
+    EXPECT_EQ(uvhttp_server_ws_unsubscribe(server, &conns[1], "news"),
+              UVHTTP_OK);
+    EXPECT_EQ(mgr->topic_count, 2u);
+    EXPECT_EQ(uvhttp_server_ws_get_connection_count_by_path(server, "news"), 0);
+
+    /* a connection with no topics left stays registered */
+    EXPECT_EQ(uvhttp_server_ws_unsubscribe(server, &conns[0], "/ws"),
+              UVHTTP_OK);
+    EXPECT_EQ(uvhttp_server_ws_get_connection_count(server), 2);
+    check_consistency();
+}
+
+TEST_F(WsTopicRegistryTest, UnregisteredConnection) {
+    EXPECT_EQ(uvhttp_server_ws_subscribe(server, &conns[0], "t"),
+              UVHTTP_ERROR_NOT_FOUND);
+    EXPECT_EQ(uvhttp_server_ws_unsubscribe(server, &conns[0], "t"),
+              UVHTTP_ERROR_NOT_FOUND);
+    EXPECT_EQ(uvhttp_server_ws_subscribe(nullptr, &conns[0], "t"),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_server_ws_subscribe(server, &conns[0], nullptr),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(mgr->topic_count, 0u);
+}
+
+TEST_F(WsTopicRegistryTest, RemoveKeepsIndexesConsistent) {
+    const char* topics[] = {"a", "b", "c"};
+    for (int i = 0; i < 8; i++) {
+        uvhttp_server_ws_add_connection(server, &conns[i], "/ws");
+        for (int t = 0; t <= i % 3; t++) {
+            ASSERT_EQ(uvhttp_server_ws_subscribe(server, &conns[i], topics[t]),
+                      UVHTTP_OK);
+        }
+    }
+    check_consistency();
+
+    /* remove from the front, the middle and the back */
+    uvhttp_server_ws_remove_connection(server, &conns[0]);
+    check_consistency();
+    uvhttp_server_ws_remove_connection(server, &conns[4]);
+    check_consistency();
+    uvhttp_server_ws_remove_connection(server, &conns[7]);
+    check_consistency();
+
+    EXPECT_EQ(uvhttp_server_ws_get_connection_count(server), 5);
+    EXPECT_EQ(uvhttp_server_ws_get_connection_count_by_path(server, "/ws"), 5);
+    EXPECT_EQ(conns[0].registry_node, nullptr);
+
+    /* removing twice is a no-op */
+    uvhttp_server_ws_remove_connection(server, &conns[0]);
+    EXPECT_EQ(uvhttp_server_ws_get_connection_count(server), 5);
+}
+
+TEST_F(WsTopicRegistryTest, CloseAllByTopic) {
+    for (int i = 0; i < 4; i++) {
+        uvhttp_server_ws_add_connection(server, &conns[i], "/ws");
+    }
+    uvhttp_server_ws_subscribe(server, &conns[1], "room");
+    uvhttp_server_ws_subscribe(server, &conns[3], "room");
+    for (int i = 0; i < mgr->connection_count; i++) {
+        mgr->connections[i]->ws_conn = nullptr;
+    }
+
+    EXPECT_EQ(uvhttp_server_ws_close_all(server, "room"), UVHTTP_OK);
+    EXPECT_EQ(uvhttp_server_ws_get_connection_count(server), 2);
+    EXPECT_EQ(uvhttp_server_ws_get_connection_count_by_path(server, "/ws"), 2);
+    EXPECT_EQ(uvhttp_server_ws_get_connection_count_by_path(server, "room"), 0);
+
+    EXPECT_EQ(uvhttp_server_ws_close_all(server, nullptr), UVHTTP_OK);
+    EXPECT_EQ(uvhttp_server_ws_get_connection_count(server), 0);
+    EXPECT_EQ(mgr->topic_count, 0u);
+}
+
+TEST_F(WsTopicRegistryTest, ManyTopics) {
+    uvhttp_server_ws_add_connection(server, &conns[0], "/ws");
+    uvhttp_server_ws_add_connection(server, &conns[1], "/ws");
+
+    std::vector<std::string> names;
+    for (int i = 0; i < 200; i++) {
+        names.push_back("topic-" + std::to_string(i));
+    }
+    for (const auto& n : names) {
+        ASSERT_EQ(uvhttp_server_ws_subscribe(server, &conns[0], n.c_str()),
+                  UVHTTP_OK);
+    }
+    for (size_t i = 0; i < names.size(); i += 2) {
+        ASSERT_EQ(uvhttp_server_ws_subscribe(server, &conns[1],
+                                             names[i].c_str()),
+                  UVHTTP_OK);
+    }
+    EXPECT_EQ(mgr->topic_count, 201u);
+    check_consistency();
+
+    /* dropping conns[0] empties every odd topic; the even ones survive the
+     * backward-shift deletions */
+    uvhttp_server_ws_remove_connection(server, &conns[0]);
+    EXPECT_EQ(mgr->topic_count, 101u);
+    for (size_t i = 0; i < names.size(); i++) {
+        EXPECT_EQ(uvhttp_server_ws_get_connection_count_by_path(
+                      server, names[i].c_str()),
+                  i % 2 == 0 ? 1 : 0);
+    }
+    check_consistency();
+}
+
+TEST_F(WsTopicRegistryTest, BroadcastUnknownTopic) {
+    uvhttp_server_ws_add_connection(server, &conns[0], "/ws");
+    EXPECT_EQ(uvhttp_server_ws_broadcast(server, "nobody", "x", 1), UVHTTP_OK);
+    EXPECT_EQ(uvhttp_server_ws_broadcast(server, "/ws", "x", 1), UVHTTP_OK);
+}
+
+#endif /* UVHTTP_FEATURE_WEBSOCKET */
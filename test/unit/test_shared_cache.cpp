@@ -0,0 +1,312 @@
+/* UVHTTP static files: the sharded cache shared by worker loops */
+
+#if UVHTTP_FEATURE_STATIC_FILES
+
+#include <gtest/gtest.h>
+#include "uvhttp_lru_cache.h"
+#include "uvhttp_request.h"
+#include "uvhttp_response.h"
+#include "uvhttp_shared_cache.h"
+#include "uvhttp_static.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <uv.h>
+#include <vector>
+
+TEST(SharedCacheTest, CreateRejectsBadParameters) {
+    uvhttp_shared_cache_t* cache = NULL;
+    EXPECT_EQ(uvhttp_shared_cache_create(4, 1024, 10, 0, NULL),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_shared_cache_create(4, 0, 10, 0, &cache),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_shared_cache_create(4, 1024, 0, 0, &cache),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(cache, nullptr);
+    uvhttp_shared_cache_free(NULL);
+}
+
+TEST(SharedCacheTest, PutGetRemoveAndStats) {
+    uvhttp_shared_cache_t* cache = NULL;
+    ASSERT_EQ(uvhttp_shared_cache_create(3, 1024 * 1024, 100, 0, &cache),
+              UVHTTP_OK);
+
+    uvhttp_cache_hit_t hit;
+    EXPECT_EQ(uvhttp_shared_cache_get(cache, "/a.txt", &hit),
+              UVHTTP_ERROR_NOT_FOUND);
+    ASSERT_EQ(uvhttp_shared_cache_put(cache, "/a.txt", "alpha", 5,
+                                      "text/plain", 1000, "\"a\""),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_shared_cache_put(cache, "/b.txt", "beta", 4,
+                                      "text/plain", 2000, "\"b\""),
+              UVHTTP_OK);
+
+    /* probes are not counted */
+    EXPECT_EQ(uvhttp_shared_cache_contains(cache, "/a.txt"), 1);
+    EXPECT_EQ(uvhttp_shared_cache_contains(cache, "/c.txt"), 0);
+
+    ASSERT_EQ(uvhttp_shared_cache_get(cache, "/a.txt", &hit), UVHTTP_OK);
+    EXPECT_EQ(std::string(hit.buffer->data, hit.buffer->length), "alpha");
+    EXPECT_EQ(hit.head, nullptr);
+    EXPECT_STREQ(hit.mime_type, "text/plain");
+    EXPECT_EQ(hit.last_modified, 1000);
+    EXPECT_STREQ(hit.etag, "\"a\"");
+
+    /* the hit holds the content after the entry is dropped */
+    EXPECT_EQ(uvhttp_shared_cache_remove(cache, "/a.txt"), UVHTTP_OK);
+    EXPECT_EQ(uvhttp_shared_cache_remove(cache, "/a.txt"),
+              UVHTTP_ERROR_NOT_FOUND);
+    EXPECT_EQ(std::string(hit.buffer->data, hit.buffer->length), "alpha");
+    uvhttp_cache_hit_release(&hit);
+    EXPECT_EQ(hit.buffer, nullptr);
+
+    size_t memory = 0;
+    int entries = 0, hits = 0, misses = 0, evictions = 0;
+    uvhttp_shared_cache_get_stats(cache, &memory, &entries, &hits, &misses,
+                                  &evictions);
+    EXPECT_EQ(entries, 1);
+    EXPECT_GT(memory, 0u);
+    EXPECT_EQ(hits, 1);
+    EXPECT_EQ(misses, 1);
+
+    uvhttp_shared_cache_clear(cache);
+    uvhttp_shared_cache_get_stats(cache, &memory, &entries, NULL, NULL, NULL);
+    EXPECT_EQ(entries, 0);
+    EXPECT_EQ(memory, 0u);
+    uvhttp_shared_cache_free(cache);
+}
+
+TEST(SharedCacheTest, SetHeadOnlyAttachesToTheContentItDescribes) {
+    uvhttp_shared_cache_t* cache = NULL;
+    ASSERT_EQ(uvhttp_shared_cache_create(2, 1024 * 1024, 100, 0, &cache),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_shared_cache_put(cache, "/a.txt", "one", 3, "text/plain",
+                                      0, NULL),
+              UVHTTP_OK);
+    uvhttp_cache_hit_t stale;
+    ASSERT_EQ(uvhttp_shared_cache_get(cache, "/a.txt", &stale), UVHTTP_OK);
+
+    /* replaced by another loop: a head for the old content is dropped */
+    ASSERT_EQ(uvhttp_shared_cache_put(cache, "/a.txt", "two", 3, "text/plain",
+                                      0, NULL),
+              UVHTTP_OK);
+    uvhttp_cache_buffer_t* head = uvhttp_cache_buffer_create(8);
+    ASSERT_NE(head, nullptr);
+    uvhttp_shared_cache_set_head(cache, "/a.txt", stale.buffer, head, 4);
+    uvhttp_cache_hit_t hit;
+    ASSERT_EQ(uvhttp_shared_cache_get(cache, "/a.txt", &hit), UVHTTP_OK);
+    EXPECT_EQ(hit.head, nullptr);
+
+    head = uvhttp_cache_buffer_create(8);
+    ASSERT_NE(head, nullptr);
+    uvhttp_shared_cache_set_head(cache, "/a.txt", hit.buffer, head, 4);
+    uvhttp_cache_hit_t again;
+    ASSERT_EQ(uvhttp_shared_cache_get(cache, "/a.txt", &again), UVHTTP_OK);
+    EXPECT_EQ(again.head, head);
+    EXPECT_EQ(again.head_keepalive_length, 4u);
+
+    /* a second head for the same content is dropped too */
+    uvhttp_shared_cache_set_head(cache, "/a.txt", hit.buffer,
+                                 uvhttp_cache_buffer_create(8), 4);
+    uvhttp_cache_hit_release(&again);
+    ASSERT_EQ(uvhttp_shared_cache_get(cache, "/a.txt", &again), UVHTTP_OK);
+    EXPECT_EQ(again.head, head);
+
+    uvhttp_cache_hit_release(&again);
+    uvhttp_cache_hit_release(&hit);
+    uvhttp_cache_hit_release(&stale);
+    uvhttp_shared_cache_free(cache);
+}
+
+struct SharedCacheWorker {
+    uvhttp_shared_cache_t* cache;
+    int id;
+    int corrupt;
+};
+
+/* the content stored under /file<n> */
+static std::string shared_cache_content(int n) {
+    return std::string((size_t)(100 + n * 7 % 900), (char)('a' + n % 26));
+}
+
+static void shared_cache_worker(void* arg) {
+    SharedCacheWorker* w = (SharedCacheWorker*)arg;
+    unsigned seed = (unsigned)w->id * 2654435761u;
+    char key[32];
+    for (int i = 0; i < 20000; i++) {
+        seed = seed * 1103515245u + 12345u;
+        int n = (int)(seed >> 16) % 64;
+        snprintf(key, sizeof(key), "/file%d", n);
+        uvhttp_cache_hit_t hit;
+        if (uvhttp_shared_cache_get(w->cache, key, &hit) == UVHTTP_OK) {
+            if (std::string(hit.buffer->data, hit.buffer->length) !=
+                shared_cache_content(n)) {
+                w->corrupt++;
+            }
+            uvhttp_cache_hit_release(&hit);
+        } else if (i % 16 == 0) {
+            uvhttp_shared_cache_remove(w->cache, key);
+        } else {
+            std::string content = shared_cache_content(n);
+            uvhttp_shared_cache_put(w->cache, key, content.data(),
+                                    content.size(), "text/plain", 0, NULL);
+        }
+    }
+}
+
+TEST(SharedCacheTest, ConcurrentLoopsNeverSeeFreedOrMixedContent) {
+    /* room for about a quarter of the files: constant eviction */
+    uvhttp_shared_cache_t* cache = NULL;
+    ASSERT_EQ(uvhttp_shared_cache_create(4, 16 * 1024, 16, 0, &cache),
+              UVHTTP_OK);
+    SharedCacheWorker workers[4];
+    uv_thread_t threads[4];
+    for (int i = 0; i < 4; i++) {
+        workers[i] = {cache, i + 1, 0};
+        ASSERT_EQ(uv_thread_create(&threads[i], shared_cache_worker,
+                                   &workers[i]),
+                  0);
+    }
+    for (int i = 0; i < 4; i++) {
+        uv_thread_join(&threads[i]);
+        EXPECT_EQ(workers[i].corrupt, 0);
+    }
+
+    size_t memory = 0;
+    int entries = 0, hits = 0, misses = 0;
+    uvhttp_shared_cache_get_stats(cache, &memory, &entries, &hits, &misses,
+                                  NULL);
+    EXPECT_GT(hits, 0);
+    EXPECT_EQ(hits + misses, 4 * 20000);
+    EXPECT_LE(entries, 16);
+    EXPECT_LE(memory, (size_t)16 * 1024);
+    uvhttp_shared_cache_free(cache);
+}
+
+struct SharedClient {
+    uv_tcp_t tcp;
+    int peer;
+    uvhttp_request_t request;
+    uvhttp_response_t response;
+};
+
+class StaticSharedCacheTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        ASSERT_EQ(uv_loop_init(&loop), 0);
+        snprintf(root, sizeof(root), "/tmp/uvhttp_static_shared_XXXXXX");
+        ASSERT_NE(mkdtemp(root), nullptr);
+        FILE* f = fopen((std::string(root) + "/page.html").c_str(), "wb");
+        ASSERT_NE(f, nullptr);
+        fputs("<p>shared</p>", f);
+        fclose(f);
+        ASSERT_EQ(uvhttp_shared_cache_create(0, 1024 * 1024, 100, 3600,
+                                             &shared),
+                  UVHTTP_OK);
+        for (int i = 0; i < 2; i++) {
+            uvhttp_static_config_t config;
+            memset(&config, 0, sizeof(config));
+            config.max_cache_size = 1024 * 1024;
+            config.cache_ttl = 3600;
+            config.max_file_size = 1024 * 1024;
+            snprintf(config.root_directory, sizeof(config.root_directory),
+                     "%s", root);
+            snprintf(config.index_file, sizeof(config.index_file),
+                     "index.html");
+            ASSERT_EQ(uvhttp_static_create(&config, &ctx[i]), UVHTTP_OK);
+            ASSERT_EQ(uvhttp_static_set_shared_cache(ctx[i], shared),
+                      UVHTTP_OK);
+        }
+    }
+
+    void TearDown() override {
+        for (SharedClient* c : clients) {
+            uvhttp_response_cleanup(&c->response);
+            uv_close((uv_handle_t*)&c->tcp, NULL);
+        }
+        uvhttp_static_free(ctx[0]);
+        uvhttp_static_free(ctx[1]);
+        uv_run(&loop, UV_RUN_DEFAULT);
+        uvhttp_shared_cache_free(shared);
+        for (SharedClient* c : clients) {
+            close(c->peer);
+            delete c;
+        }
+        EXPECT_EQ(uv_loop_close(&loop), 0);
+        std::string cmd = std::string("rm -rf ") + root;
+        EXPECT_EQ(system(cmd.c_str()), 0);
+    }
+
+    SharedClient* client(const char* url) {
+        SharedClient* c = new SharedClient();
+        int fds[2];
+        EXPECT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+        fcntl(fds[1], F_SETFL, O_NONBLOCK);
+        EXPECT_EQ(uv_tcp_init(&loop, &c->tcp), 0);
+        EXPECT_EQ(uv_tcp_open(&c->tcp, fds[0]), 0);
+        c->tcp.data = NULL;
+        c->peer = fds[1];
+        c->request.method = UVHTTP_GET;
+        c->request.headers_capacity = UVHTTP_INLINE_HEADERS_CAPACITY;
+        snprintf(c->request.url, sizeof(c->request.url), "%s", url);
+        EXPECT_EQ(uvhttp_response_init(&c->response, &c->tcp), UVHTTP_OK);
+        clients.push_back(c);
+        return c;
+    }
+
+    static std::string received(SharedClient* c) {
+        std::string out;
+        char buf[4096];
+        ssize_t n;
+        while ((n = read(c->peer, buf, sizeof(buf))) > 0) {
+            out.append(buf, (size_t)n);
+        }
+        return out;
+    }
+
+    uv_loop_t loop;
+    char root[64];
+    uvhttp_shared_cache_t* shared = nullptr;
+    uvhttp_static_context_t* ctx[2] = {nullptr, nullptr};
+    std::vector<SharedClient*> clients;
+};
+
+TEST_F(StaticSharedCacheTest, FileReadByOneContextIsServedByTheOther) {
+    SharedClient* miss = client("/page.html");
+    ASSERT_EQ(uvhttp_static_handle_request(ctx[0], &miss->request,
+                                           &miss->response),
+              UVHTTP_OK);
+    uv_run(&loop, UV_RUN_DEFAULT);
+    std::string first = received(miss);
+    EXPECT_NE(first.find("<p>shared</p>"), std::string::npos);
+
+    /* held once, by the shared cache */
+    int entries = 0;
+    uvhttp_lru_cache_get_stats(ctx[0]->cache, NULL, &entries, NULL, NULL,
+                               NULL);
+    EXPECT_EQ(entries, 0);
+    uvhttp_shared_cache_get_stats(shared, NULL, &entries, NULL, NULL, NULL);
+    EXPECT_EQ(entries, 1);
+
+    for (int pass = 0; pass < 2; pass++) { /* renders the head, then reuses */
+        SharedClient* hit = client("/page.html");
+        ASSERT_EQ(uvhttp_static_handle_request(ctx[1], &hit->request,
+                                               &hit->response),
+                  UVHTTP_OK);
+        EXPECT_TRUE(hit->response.sent); /* no file system call */
+        uv_run(&loop, UV_RUN_DEFAULT);
+        EXPECT_EQ(received(hit), first);
+    }
+
+    /* invalidation through either context drops the shared entry */
+    uvhttp_static_clear_cache(ctx[1]);
+    uvhttp_cache_hit_t hit;
+    EXPECT_EQ(uvhttp_shared_cache_get(shared, "/page.html", &hit),
+              UVHTTP_ERROR_NOT_FOUND);
+}
+
+#endif /* UVHTTP_FEATURE_STATIC_FILES */
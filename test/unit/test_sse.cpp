@@ -0,0 +1,431 @@
+/**
+ * @file test_sse.cpp
+ * @brief Server-Sent Events tests
+ *
+ * Validates src/uvhttp_sse.c over a socketpair-backed connection:
+ * - event encoding: id/event fields, one data: line per LF, CRLF or CR
+ * - the response head and handler-set headers, reserved headers skipped
+ * - published events are encoded once and queued by reference
+ * - DROP refuses events past the queue budget, CLOSE closes the stream
+ * - Last-Event-ID replays only the buffered events the client missed
+ * - unsubscribe and close remove the stream from its channels
+ * - channels idle past the timeout are freed with their replay rings
+ * - heartbeats go only to streams that have been quiet for the interval
+ *
+ * Build configuration: UVHTTP_FEATURE_SSE must be enabled.
+ */
+
+#if UVHTTP_FEATURE_SSE
+
+#include <gtest/gtest.h>
+
+extern "C" {
+#include "uvhttp_allocator.h"
+#include "uvhttp_connection.h"
+#include "uvhttp_request.h"
+#include "uvhttp_response.h"
+#include "uvhttp_server.h"
+#include "uvhttp_sse.h"
+}
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+size_t encoded_size(const char* event, const std::string& data) {
+    uvhttp_sse_event_t* ev = NULL;
+    if (uvhttp_sse_event_create(event, data.data(), data.size(), &ev) !=
+        UVHTTP_OK) {
+        return 0;
+    }
+    size_t size = uvhttp_sse_event_size(ev);
+    uvhttp_sse_event_release(ev);
+    return size;
+}
+
+}  // namespace
+
+class SseTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_EQ(uv_loop_init(&loop), 0);
+        server = (uvhttp_server_t*)uvhttp_calloc(1, sizeof(uvhttp_server_t));
+        ASSERT_NE(server, nullptr);
+        server->loop = &loop;
+        closed = 0;
+    }
+
+    void TearDown() override {
+        uvhttp_sse_server_cleanup(server);
+        uv_run(&loop, UV_RUN_DEFAULT);
+        uv_loop_close(&loop);
+        uvhttp_free(server);
+        for (int fd : peers) {
+            close(fd);
+        }
+    }
+
+    /* connection on one end of a socketpair; returns the peer fd */
+    uvhttp_connection_t* connect(int* peer) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+            return nullptr;
+        }
+        fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+        uvhttp_connection_t* conn = NULL;
+        if (uvhttp_connection_new(server, &conn) != UVHTTP_OK ||
+            uv_tcp_open(&conn->tcp_handle, fds[0]) != 0) {
+            return nullptr;
+        }
+        server->active_connections++;
+        peers.push_back(fds[1]);
+        *peer = fds[1];
+        return conn;
+    }
+
+    uvhttp_sse_stream_t* open_stream(int* peer) {
+        uvhttp_connection_t* conn = connect(peer);
+        if (!conn) {
+            return nullptr;
+        }
+        uvhttp_sse_stream_t* stream = NULL;
+        if (uvhttp_sse_open(conn->request, conn->response, &stream) !=
+            UVHTTP_OK) {
+            return nullptr;
+        }
+        stream->user_data = this;
+        uvhttp_sse_set_close_callback(stream, on_close);
+        return stream;
+    }
+
+    std::string read_peer(int fd) {
+        /* let write callbacks submit whatever queued behind them */
+        for (int i = 0; i < 4; i++) {
+            uv_run(&loop, UV_RUN_NOWAIT);
+        }
+        std::string out;
+        char buf[4096];
+        ssize_t n;
+        while ((n = read(fd, buf, sizeof(buf))) > 0) {
+            out.append(buf, (size_t)n);
+        }
+        return out;
+    }
+
+    /* bytes after the response head */
+    std::string read_events(int fd) {
+        std::string out = read_peer(fd);
+        size_t end = out.find("\r\n\r\n");
+        return end == std::string::npos ? out : out.substr(end + 4);
+    }
+
+    static void on_close(uvhttp_sse_stream_t* stream) {
+        static_cast<SseTest*>(stream->user_data)->closed++;
+    }
+
+    uv_loop_t loop;
+    uvhttp_server_t* server;
+    std::vector<int> peers;
+    int closed;
+};
+
+TEST_F(SseTest, EventEncoding) {
+    /* sizes here, bytes on the wire in the stream tests */
+    EXPECT_EQ(encoded_size(NULL, "hello"), strlen("data: hello\n\n"));
+    EXPECT_EQ(encoded_size("tick", ""), strlen("event: tick\ndata: \n\n"));
+    EXPECT_EQ(encoded_size(NULL, "a\nb\r\nc\rd"),
+              strlen("data: a\ndata: b\ndata: c\ndata: d\n\n"));
+    EXPECT_EQ(encoded_size(NULL, "trailing\n"),
+              strlen("data: trailing\ndata: \n\n"));
+
+    uvhttp_sse_event_t* ev = NULL;
+    EXPECT_EQ(uvhttp_sse_event_create("bad\nname", "x", 1, &ev),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(ev, nullptr);
+    EXPECT_EQ(uvhttp_sse_event_create(NULL, NULL, 1, &ev),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_sse_event_create(NULL, "x", 1, NULL),
+              UVHTTP_ERROR_INVALID_PARAM);
+}
+
+TEST_F(SseTest, HeadAndEventsOnTheWire) {
+    int peer;
+    uvhttp_connection_t* conn = connect(&peer);
+    ASSERT_NE(conn, nullptr);
+    uvhttp_response_set_header(conn->response, "X-Stream", "prices");
+    uvhttp_response_set_header(conn->response, "Content-Type", "text/plain");
+
+    uvhttp_sse_stream_t* stream = NULL;
+    ASSERT_EQ(uvhttp_sse_open(conn->request, conn->response, &stream),
+              UVHTTP_OK);
+    uvhttp_sse_stream_t* again = NULL;
+    EXPECT_EQ(uvhttp_sse_open(conn->request, conn->response, &again),
+              UVHTTP_ERROR_INVALID_PARAM);
+
+    std::string head = read_peer(peer);
+    EXPECT_EQ(head.find("HTTP/1.1 200 OK\r\n"), 0u);
+    EXPECT_NE(head.find("Content-Type: text/event-stream\r\n"),
+              std::string::npos);
+    EXPECT_NE(head.find("Cache-Control: no-cache\r\n"), std::string::npos);
+    EXPECT_NE(head.find("X-Stream: prices\r\n"), std::string::npos);
+    EXPECT_EQ(head.find("text/plain"), std::string::npos);
+    EXPECT_EQ(head.find("Content-Length"), std::string::npos);
+    EXPECT_EQ(head.substr(head.size() - 4), "\r\n\r\n");
+
+    ASSERT_EQ(uvhttp_sse_send(stream, "quote", "{\"p\":1}\n{\"p\":2}", 15),
+              UVHTTP_OK);
+    EXPECT_EQ(read_peer(peer),
+              "event: quote\ndata: {\"p\":1}\ndata: {\"p\":2}\n\n");
+    EXPECT_EQ(stream->events_sent, 1u);
+    EXPECT_EQ(uvhttp_sse_get_stream_count(server), 1);
+}
+
+TEST_F(SseTest, PublishSharesOneEncoding) {
+    int peers_fd[3];
+    uvhttp_sse_stream_t* streams[3];
+    for (int i = 0; i < 3; i++) {
+        streams[i] = open_stream(&peers_fd[i]);
+        ASSERT_NE(streams[i], nullptr);
+        ASSERT_EQ(uvhttp_sse_subscribe(streams[i], "news"), UVHTTP_OK);
+        read_peer(peers_fd[i]);
+    }
+    EXPECT_EQ(uvhttp_sse_subscribe(streams[0], "news"),
+              UVHTTP_ERROR_ALREADY_EXISTS);
+    EXPECT_EQ(uvhttp_sse_get_channel_count(server, "news"), 3);
+
+    uint64_t id = 0;
+    ASSERT_EQ(uvhttp_sse_publish(server, "news", "headline", "hi", 2, &id),
+              UVHTTP_OK);
+    EXPECT_EQ(id, 1u);
+    ASSERT_EQ(uvhttp_sse_publish(server, "news", NULL, "again", 5, &id),
+              UVHTTP_OK);
+    EXPECT_EQ(id, 2u);
+
+    /* the second publish queued behind the first; every stream gets both
+     * from the one encoding */
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(read_peer(peers_fd[i]),
+                  "id: 1\nevent: headline\ndata: hi\n\n"
+                  "id: 2\ndata: again\n\n");
+    }
+
+    /* a publish to a channel nobody listens on still gets an id */
+    ASSERT_EQ(uvhttp_sse_publish(server, "empty", NULL, "x", 1, &id),
+              UVHTTP_OK);
+    EXPECT_EQ(id, 3u);
+}
+
+TEST_F(SseTest, DropPolicyRefusesPastBudget) {
+    int peer;
+    uvhttp_sse_stream_t* stream = open_stream(&peer);
+    ASSERT_NE(stream, nullptr);
+    ASSERT_EQ(uvhttp_sse_set_send_queue(stream, 64,
+                                        UVHTTP_SSE_SLOW_CONSUMER_DROP),
+              UVHTTP_OK);
+
+    /* the head is still in flight: events queue behind it until the budget
+     * is spent */
+    std::string data(40, 'd');
+    int refused = 0;
+    for (int i = 0; i < 4; i++) {
+        if (uvhttp_sse_send(stream, NULL, data.data(), data.size()) ==
+            UVHTTP_ERROR_SSE_SLOW_CONSUMER) {
+            refused++;
+        }
+    }
+    EXPECT_GT(refused, 0);
+    EXPECT_EQ(stream->events_dropped, (uint64_t)refused);
+    EXPECT_EQ(closed, 0);
+
+    /* once drained, sends are accepted again */
+    read_peer(peer);
+    uv_run(&loop, UV_RUN_NOWAIT);
+    EXPECT_EQ(uvhttp_sse_get_buffered_amount(stream), 0u);
+    EXPECT_EQ(uvhttp_sse_send(stream, NULL, "ok", 2), UVHTTP_OK);
+}
+
+TEST_F(SseTest, ClosePolicyClosesStream) {
+    int peer;
+    uvhttp_sse_stream_t* stream = open_stream(&peer);
+    ASSERT_NE(stream, nullptr);
+    ASSERT_EQ(uvhttp_sse_set_send_queue(stream, 16,
+                                        UVHTTP_SSE_SLOW_CONSUMER_CLOSE),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_sse_subscribe(stream, "feed"), UVHTTP_OK);
+
+    std::string data(64, 'x');
+    EXPECT_EQ(uvhttp_sse_send(stream, NULL, data.data(), data.size()),
+              UVHTTP_ERROR_SSE_SLOW_CONSUMER);
+    EXPECT_EQ(uvhttp_sse_send(stream, NULL, "x", 1),
+              UVHTTP_ERROR_CONNECTION_BROKEN);
+
+    /* the close happens on the next loop iteration */
+    EXPECT_EQ(closed, 0);
+    uv_run(&loop, UV_RUN_NOWAIT);
+    EXPECT_EQ(closed, 1);
+    EXPECT_EQ(uvhttp_sse_get_stream_count(server), 0);
+    EXPECT_EQ(uvhttp_sse_get_channel_count(server, "feed"), 0);
+}
+
+TEST_F(SseTest, LastEventIdReplaysMissedEvents) {
+    for (int i = 1; i <= 5; i++) {
+        std::string data = "e" + std::to_string(i);
+        ASSERT_EQ(uvhttp_sse_publish(server, "log", NULL, data.data(),
+                                     data.size(), NULL),
+                  UVHTTP_OK);
+    }
+
+    int peer;
+    uvhttp_connection_t* conn = connect(&peer);
+    ASSERT_NE(conn, nullptr);
+    uvhttp_request_t* req = conn->request;
+    ASSERT_EQ(uvhttp_request_add_header(req, "Last-Event-ID", "3"), UVHTTP_OK);
+
+    uvhttp_sse_stream_t* stream = NULL;
+    ASSERT_EQ(uvhttp_sse_open(req, conn->response, &stream), UVHTTP_OK);
+    EXPECT_EQ(stream->last_event_id, 3u);
+    ASSERT_EQ(uvhttp_sse_subscribe(stream, "log"), UVHTTP_OK);
+    EXPECT_EQ(read_events(peer), "id: 4\ndata: e4\n\nid: 5\ndata: e5\n\n");
+
+    /* a stream without Last-Event-ID gets only new events */
+    int fresh_peer;
+    uvhttp_sse_stream_t* fresh = open_stream(&fresh_peer);
+    ASSERT_NE(fresh, nullptr);
+    ASSERT_EQ(uvhttp_sse_subscribe(fresh, "log"), UVHTTP_OK);
+    EXPECT_EQ(read_events(fresh_peer), "");
+}
+
+TEST_F(SseTest, UnsubscribeAndClose) {
+    int pa, pb;
+    uvhttp_sse_stream_t* a = open_stream(&pa);
+    uvhttp_sse_stream_t* b = open_stream(&pb);
+    ASSERT_NE(a, nullptr);
+    ASSERT_NE(b, nullptr);
+    ASSERT_EQ(uvhttp_sse_subscribe(a, "x"), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_sse_subscribe(a, "y"), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_sse_subscribe(b, "x"), UVHTTP_OK);
+
+    EXPECT_EQ(uvhttp_sse_unsubscribe(a, "x"), UVHTTP_OK);
+    EXPECT_EQ(uvhttp_sse_unsubscribe(a, "x"), UVHTTP_ERROR_NOT_FOUND);
+    EXPECT_EQ(uvhttp_sse_unsubscribe(a, "nope"), UVHTTP_ERROR_NOT_FOUND);
+    EXPECT_EQ(uvhttp_sse_get_channel_count(server, "x"), 1);
+
+    read_peer(pa);
+    read_peer(pb);
+    ASSERT_EQ(uvhttp_sse_publish(server, "x", NULL, "only-b", 6, NULL),
+              UVHTTP_OK);
+    EXPECT_EQ(read_peer(pa), "");
+    EXPECT_EQ(read_peer(pb), "id: 1\ndata: only-b\n\n");
+
+    uvhttp_sse_close(b);
+    EXPECT_EQ(closed, 1);
+    EXPECT_EQ(uvhttp_sse_get_channel_count(server, "x"), 0);
+    EXPECT_EQ(uvhttp_sse_get_stream_count(server), 1);
+    /* the remaining stream's channel refs survived the swap-deletes */
+    ASSERT_EQ(uvhttp_sse_publish(server, "y", NULL, "a", 1, NULL), UVHTTP_OK);
+    EXPECT_EQ(read_peer(pa), "id: 2\ndata: a\n\n");
+}
+
+TEST_F(SseTest, IdleChannelsAreFreed) {
+    ASSERT_EQ(uvhttp_sse_set_channel_idle_timeout(server, 10), UVHTTP_OK);
+    int peer;
+    uvhttp_sse_stream_t* stream = open_stream(&peer);
+    ASSERT_NE(stream, nullptr);
+    ASSERT_EQ(uvhttp_sse_subscribe(stream, "kept"), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_sse_subscribe(stream, "left"), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_sse_publish(server, "unread", NULL, "x", 1, NULL),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_sse_unsubscribe(stream, "left"), UVHTTP_OK);
+    EXPECT_EQ(uvhttp_sse_get_channel_total(server), 3);
+
+    /* a new channel past the timeout sweeps the idle ones */
+    usleep(20000);
+    uv_update_time(&loop);
+    ASSERT_EQ(uvhttp_sse_publish(server, "fresh", NULL, "y", 1, NULL),
+              UVHTTP_OK);
+    EXPECT_EQ(uvhttp_sse_get_channel_total(server), 2);
+    read_peer(peer);
+    ASSERT_EQ(uvhttp_sse_publish(server, "kept", NULL, "z", 1, NULL),
+              UVHTTP_OK);
+    EXPECT_EQ(read_peer(peer), "id: 3\ndata: z\n\n");
+    EXPECT_EQ(uvhttp_sse_unsubscribe(stream, "left"), UVHTTP_ERROR_NOT_FOUND);
+
+    /* 0 keeps them */
+    ASSERT_EQ(uvhttp_sse_set_channel_idle_timeout(server, 0), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_sse_unsubscribe(stream, "kept"), UVHTTP_OK);
+    usleep(20000);
+    uv_update_time(&loop);
+    ASSERT_EQ(uvhttp_sse_publish(server, "later", NULL, "w", 1, NULL),
+              UVHTTP_OK);
+    EXPECT_EQ(uvhttp_sse_get_channel_total(server), 3);
+}
+
+TEST_F(SseTest, PeerDisconnectClosesStream) {
+    int peer;
+    uvhttp_sse_stream_t* stream = open_stream(&peer);
+    ASSERT_NE(stream, nullptr);
+    read_peer(peer);
+
+    close(peer);
+    peers.clear();
+    for (int i = 0; i < 10 && closed == 0; i++) {
+        uv_run(&loop, UV_RUN_ONCE);
+    }
+    EXPECT_EQ(closed, 1);
+    EXPECT_EQ(uvhttp_sse_get_stream_count(server), 0);
+}
+
+TEST_F(SseTest, HeartbeatOnlyForQuietStreams) {
+    ASSERT_EQ(uvhttp_sse_set_heartbeat_interval(server, 20), UVHTTP_OK);
+    int pq, pb;
+    uvhttp_sse_stream_t* quiet = open_stream(&pq);
+    uvhttp_sse_stream_t* busy = open_stream(&pb);
+    ASSERT_NE(quiet, nullptr);
+    ASSERT_NE(busy, nullptr);
+    read_peer(pq);
+    read_peer(pb);
+
+    /* keep "busy" talking more often than the interval */
+    uint64_t start = uv_now(&loop);
+    while (uv_now(&loop) - start < 60) {
+        uvhttp_sse_send(busy, NULL, "b", 1);
+        usleep(5000);
+        uv_run(&loop, UV_RUN_NOWAIT);
+    }
+
+    EXPECT_NE(read_peer(pq).find(":\n\n"), std::string::npos);
+    EXPECT_EQ(read_peer(pb).find(":\n\n"), std::string::npos);
+
+    /* disabled: nothing more arrives */
+    ASSERT_EQ(uvhttp_sse_set_heartbeat_interval(server, 0), UVHTTP_OK);
+    usleep(30000);
+    uv_run(&loop, UV_RUN_NOWAIT);
+    EXPECT_EQ(read_peer(pq), "");
+}
+
+TEST_F(SseTest, NullParameters) {
+    uvhttp_sse_stream_t* stream = NULL;
+    EXPECT_EQ(uvhttp_sse_open(NULL, NULL, &stream),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_sse_open(NULL, NULL, NULL), UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_sse_send(NULL, NULL, "x", 1), UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_sse_send_event(NULL, NULL), UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_sse_subscribe(NULL, "c"), UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_sse_publish(NULL, "c", NULL, "x", 1, NULL),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_sse_set_send_queue(NULL, 0,
+                                        UVHTTP_SSE_SLOW_CONSUMER_DROP),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_sse_get_stream_count(NULL), 0);
+    EXPECT_EQ(uvhttp_sse_get_buffered_amount(NULL), 0u);
+    uvhttp_sse_close(NULL);
+    uvhttp_sse_event_release(NULL);
+}
+
+#endif /* UVHTTP_FEATURE_SSE */
@@ -0,0 +1,324 @@
+/* UVHTTP static files: cache misses answered from uv_fs_* callbacks */
+
+#if UVHTTP_FEATURE_STATIC_FILES
+
+#include <gtest/gtest.h>
+#include "test_static_helper.h"
+#include "uvhttp_connection.h"
+#include "uvhttp_lru_cache.h"
+#include <errno.h>
+#include <stdlib.h>
+
+class StaticAsyncTest : public StaticTestFixture {
+  protected:
+    StaticAsyncTest() : StaticTestFixture("static_async") {}
+
+    void SetUp() override {
+        StaticTestFixture::SetUp();
+        write_file("small.txt", "hello static");
+        std::string big(100 * 1024, 'b');
+        write_file("big.bin", big);
+        mkdir(path("dir").c_str(), 0755);
+        write_file("dir/index.html", "<p>index</p>");
+        mkdir(path("list").c_str(), 0755);
+        write_file("list/entry.txt", "x");
+        write_file("app.js", std::string(600, 'j'));
+        write_file("app.js.gz", "GZIPPED");
+    }
+
+    void create(int max_inflight = 0, int listing = 0) {
+        uvhttp_static_config_t config = static_config();
+        config.max_inflight_fs = max_inflight;
+        config.enable_directory_listing = listing;
+        create_context(config);
+    }
+};
+
+TEST_F(StaticAsyncTest, MissIsAnsweredFromTheLoopThenHitsTheCache) {
+    create();
+    StaticClient* first = client("/small.txt");
+    ASSERT_EQ(serve(first), UVHTTP_OK);
+    /* nothing read yet: the file is stat'ed, opened and read on the pool */
+    EXPECT_FALSE(first->response.sent);
+    EXPECT_EQ(ctx->fs_pending, 1);
+
+    uv_run(&loop, UV_RUN_DEFAULT);
+    std::string response = received(first);
+    EXPECT_EQ(response.compare(0, 15, "HTTP/1.1 200 OK"), 0) << response;
+    EXPECT_EQ(body(response), "hello static");
+    EXPECT_EQ(ctx->fs_pending, 0);
+
+    /* now a cache hit, answered before returning */
+    StaticClient* second = client("/small.txt?v=2");
+    ASSERT_EQ(serve(second), UVHTTP_OK);
+    EXPECT_TRUE(second->response.sent);
+    EXPECT_EQ(ctx->fs_pending, 0);
+    uv_run(&loop, UV_RUN_DEFAULT);
+    EXPECT_EQ(body(received(second)), "hello static");
+}
+
+TEST_F(StaticAsyncTest, MissingAndOutsideFilesAre404) {
+    create();
+    std::string outside = std::string(root) + "_outside";
+    FILE* f = fopen(outside.c_str(), "w");
+    ASSERT_NE(f, nullptr);
+    fputs("secret", f);
+    fclose(f);
+    ASSERT_EQ(symlink(outside.c_str(), path("leak").c_str()), 0);
+
+    StaticClient* missing = client("/missing.txt");
+    StaticClient* leak = client("/leak");
+    StaticClient* dotdot = client("/../etc/passwd");
+    ASSERT_EQ(serve(missing), UVHTTP_OK);
+    ASSERT_EQ(serve(leak), UVHTTP_OK);
+    ASSERT_EQ(serve(dotdot), UVHTTP_OK);
+    uv_run(&loop, UV_RUN_DEFAULT);
+    unlink(outside.c_str());
+
+    for (StaticClient* c : {missing, leak, dotdot}) {
+        std::string response = received(c);
+        EXPECT_NE(response.find(" 404 "), std::string::npos) << response;
+        EXPECT_EQ(response.find("secret"), std::string::npos);
+    }
+}
+
+static int fallback_calls;
+static int answer_teapot(uvhttp_request_t* request,
+                         uvhttp_response_t* response) {
+    (void)request;
+    fallback_calls++;
+    uvhttp_response_set_status(response, 418);
+    uvhttp_response_set_body(response, "tea", 3);
+    return uvhttp_response_send(response);
+}
+
+TEST_F(StaticAsyncTest, FallbackAnswersMissingFiles) {
+    create();
+    fallback_calls = 0;
+    StaticClient* missing = client("/missing.txt");
+    StaticClient* found = client("/small.txt");
+    ASSERT_EQ(uvhttp_static_serve(ctx, &missing->request, &missing->response,
+                                  answer_teapot),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_static_serve(ctx, &found->request, &found->response,
+                                  answer_teapot),
+              UVHTTP_OK);
+    EXPECT_EQ(fallback_calls, 0);
+    uv_run(&loop, UV_RUN_DEFAULT);
+
+    EXPECT_EQ(fallback_calls, 1);
+    EXPECT_EQ(body(received(missing)), "tea");
+    EXPECT_EQ(body(received(found)), "hello static");
+}
+
+TEST_F(StaticAsyncTest, DirectoryServesIndexOrListing) {
+    create(0, 1);
+    StaticClient* dir = client("/dir");
+    StaticClient* list = client("/list");
+    ASSERT_EQ(serve(dir), UVHTTP_OK);
+    ASSERT_EQ(serve(list), UVHTTP_OK);
+    uv_run(&loop, UV_RUN_DEFAULT);
+
+    EXPECT_EQ(body(received(dir)), "<p>index</p>");
+    std::string listing = received(list);
+    EXPECT_NE(listing.find(" 200 "), std::string::npos);
+    EXPECT_NE(listing.find("entry.txt"), std::string::npos);
+}
+
+TEST_F(StaticAsyncTest, LargeFileIsSentWithSendfile) {
+    create();
+    StaticClient* c = client("/big.bin");
+    ASSERT_EQ(serve(c), UVHTTP_OK);
+    uv_run(&loop, UV_RUN_DEFAULT);
+
+    std::string response = received(c);
+    EXPECT_NE(response.find("Content-Length: 102400"), std::string::npos);
+    EXPECT_EQ(body(response), std::string(100 * 1024, 'b'));
+    EXPECT_EQ(ctx->fs_pending, 0);
+}
+
+TEST_F(StaticAsyncTest, GzipVariantIsServedAndCachedSeparately) {
+    create();
+    StaticClient* gz = client("/app.js");
+    uvhttp_request_add_header(&gz->request, "Accept-Encoding", "gzip, br");
+    ASSERT_EQ(serve(gz), UVHTTP_OK);
+    uv_run(&loop, UV_RUN_DEFAULT);
+    std::string response = received(gz);
+    EXPECT_NE(response.find("Content-Encoding: gzip"), std::string::npos);
+    EXPECT_EQ(body(response), "GZIPPED");
+
+    /* a client without gzip is not handed the cached .gz */
+    StaticClient* plain = client("/app.js");
+    ASSERT_EQ(serve(plain), UVHTTP_OK);
+    EXPECT_FALSE(plain->response.sent);
+    uv_run(&loop, UV_RUN_DEFAULT);
+    EXPECT_EQ(body(received(plain)), std::string(600, 'j'));
+
+    StaticClient* gz_again = client("/app.js");
+    uvhttp_request_add_header(&gz_again->request, "Accept-Encoding", "gzip");
+    ASSERT_EQ(serve(gz_again), UVHTTP_OK);
+    EXPECT_TRUE(gz_again->response.sent);
+    uv_run(&loop, UV_RUN_DEFAULT);
+    EXPECT_EQ(body(received(gz_again)), "GZIPPED");
+}
+
+TEST_F(StaticAsyncTest, EachRequestCountsOneLookup) {
+    create();
+    const char* encodings[] = {"gzip", NULL, "gzip", NULL};
+    for (const char* encoding : encodings) {
+        StaticClient* c = client("/app.js");
+        if (encoding) {
+            uvhttp_request_add_header(&c->request, "Accept-Encoding",
+                                      encoding);
+        }
+        ASSERT_EQ(serve(c), UVHTTP_OK);
+        uv_run(&loop, UV_RUN_DEFAULT);
+    }
+    StaticClient* missing = client("/missing.txt");
+    uvhttp_request_add_header(&missing->request, "Accept-Encoding", "gzip");
+    ASSERT_EQ(serve(missing), UVHTTP_OK);
+    uv_run(&loop, UV_RUN_DEFAULT);
+
+    /* the candidates are peeked, not each counted as a miss */
+    EXPECT_EQ(ctx->cache->hit_count, 2);
+    EXPECT_EQ(ctx->cache->miss_count, 3);
+}
+
+TEST_F(StaticAsyncTest, MatchingEtagIs304) {
+    create();
+    struct stat st;
+    ASSERT_EQ(stat(path("big.bin").c_str(), &st), 0);
+    char etag[64];
+    snprintf(etag, sizeof(etag), "\"%zu-%ld\"", (size_t)st.st_size,
+             (long)st.st_mtime);
+
+    StaticClient* c = client("/big.bin");
+    uvhttp_request_add_header(&c->request, "If-None-Match", etag);
+    ASSERT_EQ(serve(c), UVHTTP_OK);
+    uv_run(&loop, UV_RUN_DEFAULT);
+    std::string response = received(c);
+    EXPECT_NE(response.find(" 304 "), std::string::npos) << response;
+}
+
+TEST_F(StaticAsyncTest, InflightMissesAreBounded) {
+    create(2);
+    StaticClient* c[5];
+    for (int i = 0; i < 5; i++) {
+        c[i] = client(i % 2 ? "/small.txt" : "/dir/index.html");
+        ASSERT_EQ(serve(c[i]), UVHTTP_OK);
+    }
+    EXPECT_EQ(ctx->fs_running, 2);
+    EXPECT_EQ(ctx->fs_pending, 5);
+
+    uv_run(&loop, UV_RUN_DEFAULT);
+    EXPECT_EQ(ctx->fs_running, 0);
+    EXPECT_EQ(ctx->fs_pending, 0);
+    for (int i = 0; i < 5; i++) {
+        EXPECT_EQ(body(received(c[i])),
+                  i % 2 ? "hello static" : "<p>index</p>");
+    }
+}
+
+TEST_F(StaticAsyncTest, ClosedConnectionIsNotAnswered) {
+    create(1);
+    /* a connection, so that the miss registers with it */
+    uvhttp_connection_t* conn =
+        (uvhttp_connection_t*)calloc(1, sizeof(uvhttp_connection_t));
+    StaticClient* running = client("/small.txt");
+    StaticClient* waiting = client("/big.bin");
+    for (StaticClient* c : {running, waiting}) {
+        conn->response = &c->response;
+        c->tcp.data = conn;
+        ASSERT_EQ(serve(c), UVHTTP_OK);
+        ASSERT_NE(conn->static_op, nullptr);
+        /* what uvhttp_connection_close does */
+        uvhttp_static_cancel((uvhttp_static_op_t*)conn->static_op);
+        EXPECT_EQ(conn->static_op, nullptr);
+    }
+    EXPECT_EQ(ctx->fs_pending, 2);
+
+    uv_run(&loop, UV_RUN_DEFAULT);
+    EXPECT_EQ(ctx->fs_pending, 0);
+    EXPECT_EQ(received(running), "");
+    EXPECT_EQ(received(waiting), "");
+    running->tcp.data = waiting->tcp.data = NULL;
+    free(conn);
+}
+
+TEST_F(StaticAsyncTest, FreeWaitsForMissesInFlight) {
+    create();
+    StaticClient* c = client("/small.txt");
+    ASSERT_EQ(serve(c), UVHTTP_OK);
+    uvhttp_static_free(ctx);
+    ctx = nullptr; /* released by the miss (ASan checks) */
+    uv_run(&loop, UV_RUN_DEFAULT);
+    EXPECT_EQ(body(received(c)), "hello static");
+}
+
+TEST_F(StaticAsyncTest, SendfileApiIsAsynchronous) {
+    StaticClient* found = client("/");
+    StaticClient* missing = client("/");
+    ASSERT_EQ(uvhttp_static_sendfile(path("small.txt").c_str(),
+                                     &found->response),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_static_sendfile(path("nope").c_str(), &missing->response),
+              UVHTTP_OK);
+    EXPECT_FALSE(found->response.sent);
+    uv_run(&loop, UV_RUN_DEFAULT);
+
+    EXPECT_EQ(body(received(found)), "hello static");
+    EXPECT_NE(received(missing).find(" 404 "), std::string::npos);
+}
+
+TEST_F(StaticAsyncTest, CacheHitIsWrittenFromTheEntry) {
+    create();
+    StaticClient* miss = client("/small.txt");
+    ASSERT_EQ(serve(miss), UVHTTP_OK);
+    uv_run(&loop, UV_RUN_DEFAULT);
+    std::string built = received(miss);
+
+    StaticClient* hit = client("/small.txt");
+    ASSERT_EQ(serve(hit), UVHTTP_OK);
+    EXPECT_TRUE(hit->response.sent);
+    /* nothing was set on the response: the entry's head went out as is */
+    EXPECT_EQ(hit->response.header_count, 0u);
+    cache_entry_t* entry = uvhttp_lru_cache_find(ctx->cache, "/small.txt");
+    ASSERT_NE(entry, nullptr);
+    ASSERT_NE(entry->head, nullptr);
+    EXPECT_EQ(entry->head->body, entry->buffer);
+    EXPECT_EQ(entry->head->refcount, 2); /* the entry and the write */
+
+    /* dropped from the cache while the write is pending */
+    uvhttp_static_clear_cache(ctx);
+    uv_run(&loop, UV_RUN_DEFAULT);
+    EXPECT_EQ(received(hit), built);
+}
+
+TEST_F(StaticAsyncTest, CacheHitHeadFollowsKeepAlive) {
+    create();
+    StaticClient* miss = client("/small.txt");
+    ASSERT_EQ(serve(miss), UVHTTP_OK);
+    uv_run(&loop, UV_RUN_DEFAULT);
+    received(miss);
+
+    StaticClient* closing = client("/small.txt");
+    closing->response.keepalive = 0;
+    ASSERT_EQ(serve(closing), UVHTTP_OK);
+    uv_run(&loop, UV_RUN_DEFAULT);
+    std::string response = received(closing);
+    EXPECT_NE(response.find("Connection: close\r\n"), std::string::npos);
+    EXPECT_EQ(response.find("keep-alive"), std::string::npos);
+    EXPECT_EQ(body(response), "hello static");
+
+    /* headers set before serving are kept: the answer is built */
+    StaticClient* custom = client("/small.txt");
+    uvhttp_response_set_header(&custom->response, "X-Served-By", "test");
+    ASSERT_EQ(serve(custom), UVHTTP_OK);
+    uv_run(&loop, UV_RUN_DEFAULT);
+    response = received(custom);
+    EXPECT_NE(response.find("X-Served-By: test"), std::string::npos);
+    EXPECT_NE(response.find("Connection: keep-alive"), std::string::npos);
+    EXPECT_EQ(body(response), "hello static");
+}
+
+#endif /* UVHTTP_FEATURE_STATIC_FILES */
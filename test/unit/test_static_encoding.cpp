@@ -0,0 +1,236 @@
+/* UVHTTP static files: gzip variants of cached text files */
+
+#if UVHTTP_FEATURE_STATIC_FILES && UVHTTP_FEATURE_COMPRESSION
+
+#include <gtest/gtest.h>
+#include "test_static_helper.h"
+#include "uvhttp_lru_cache.h"
+#include "uvhttp_shared_cache.h"
+#include "zlib.h"
+#include <stdint.h>
+
+TEST(StaticAcceptsEncodingTest, ParsesQValues) {
+    EXPECT_EQ(uvhttp_static_accepts_encoding("gzip", "gzip"), 1000);
+    EXPECT_EQ(uvhttp_static_accepts_encoding("deflate, GZIP", "gzip"), 1000);
+    EXPECT_EQ(uvhttp_static_accepts_encoding("gzip;q=0.5", "gzip"), 500);
+    EXPECT_EQ(uvhttp_static_accepts_encoding("gzip ; q=0.125", "gzip"), 125);
+    EXPECT_EQ(uvhttp_static_accepts_encoding("gzip;q=0", "gzip"), 0);
+    EXPECT_EQ(uvhttp_static_accepts_encoding("gzip;q=1.0", "gzip"), 1000);
+    EXPECT_EQ(uvhttp_static_accepts_encoding("br, *;q=0.3", "gzip"), 300);
+    EXPECT_EQ(uvhttp_static_accepts_encoding("gzip2", "gzip"), 0);
+    EXPECT_EQ(uvhttp_static_accepts_encoding("", "gzip"), 0);
+    EXPECT_EQ(uvhttp_static_accepts_encoding(NULL, "gzip"), 0);
+    /* malformed q-values accept nothing */
+    EXPECT_EQ(uvhttp_static_accepts_encoding("gzip;q=2", "gzip"), 0);
+    EXPECT_EQ(uvhttp_static_accepts_encoding("gzip;q=0.5x", "gzip"), 0);
+
+    /* identity is acceptable unless excluded */
+    EXPECT_EQ(uvhttp_static_accepts_encoding(NULL, "identity"), 1000);
+    EXPECT_EQ(uvhttp_static_accepts_encoding("gzip", "identity"), 1000);
+    EXPECT_EQ(uvhttp_static_accepts_encoding("identity;q=0.2", "identity"),
+              200);
+    EXPECT_EQ(uvhttp_static_accepts_encoding("*;q=0", "identity"), 0);
+}
+
+class StaticEncodingTest : public StaticTestFixture {
+  protected:
+    StaticEncodingTest() : StaticTestFixture("static_enc") {}
+
+    void SetUp() override {
+        StaticTestFixture::SetUp();
+        for (int i = 0; i < 200; i++) {
+            css += "body { margin: 0; padding: " + std::to_string(i) + "px; }\n";
+        }
+        write_file("site.css", css);
+        write_file("tiny.css", "a{}");
+        /* a text file that does not compress */
+        uint32_t state = 12345;
+        for (int i = 0; i < 4096; i++) {
+            state = state * 1103515245 + 12345;
+            noise.push_back((char)(state >> 24));
+        }
+        write_file("noise.txt", noise);
+    }
+
+    void TearDown() override {
+        StaticTestFixture::TearDown();
+        uvhttp_shared_cache_free(shared);
+    }
+
+    void create(int compress_cache) {
+        uvhttp_static_config_t config = static_config();
+        config.compress_cache = compress_cache;
+        create_context(config);
+    }
+
+    StaticClient* client(const char* url, const char* accept_encoding,
+                         const char* name = NULL, const char* value = NULL) {
+        StaticClient* c = StaticTestFixture::client(url);
+        if (accept_encoding) {
+            uvhttp_request_add_header(&c->request, "Accept-Encoding",
+                                      accept_encoding);
+        }
+        if (name) {
+            uvhttp_request_add_header(&c->request, name, value);
+        }
+        return c;
+    }
+
+    /* the content of a gzip member */
+    static std::string gunzip(const std::string& gz) {
+        if (gz.size() < 18 || (unsigned char)gz[0] != 0x1f ||
+            (unsigned char)gz[1] != 0x8b) {
+            return "";
+        }
+        size_t length = 0;
+        void* out = tinfl_decompress_mem_to_heap(gz.data() + 10,
+                                                 gz.size() - 18, &length, 0);
+        std::string plain(out ? (const char*)out : "", length);
+        mz_free(out);
+        return plain;
+    }
+
+    std::string css;
+    std::string noise;
+    uvhttp_shared_cache_t* shared = nullptr;
+};
+
+TEST_F(StaticEncodingTest, VariantIsMadeAfterTheFirstHitAndServedFromThen) {
+    create(1);
+    std::string miss = fetch(client("/site.css", "gzip"));
+    EXPECT_NE(miss.find(" 200 "), std::string::npos);
+    EXPECT_EQ(header(miss, "Content-Encoding"), "");
+    EXPECT_EQ(header(miss, "Vary"), "Accept-Encoding");
+    EXPECT_EQ(body(miss), css);
+
+    /* the first hit is answered as it is and starts the encoding */
+    cache_entry_t* entry = uvhttp_lru_cache_peek(ctx->cache, "/site.css");
+    ASSERT_NE(entry, nullptr);
+    size_t plain_usage = entry->memory_usage;
+    std::string first = fetch(client("/site.css", "gzip, deflate"));
+    EXPECT_EQ(header(first, "Content-Encoding"), "");
+    EXPECT_EQ(body(first), css);
+    EXPECT_EQ(ctx->fs_pending, 0);
+    uvhttp_cache_buffer_t* gz =
+        entry->variants[UVHTTP_CACHE_ENCODING_GZIP].buffer;
+    ASSERT_NE(gz, nullptr);
+    EXPECT_LT(gz->length, css.size());
+    EXPECT_GE(entry->memory_usage, plain_usage + gz->length);
+
+    /* later hits are written from memory, compressed */
+    StaticClient* hit = client("/site.css", "gzip, deflate");
+    ASSERT_EQ(uvhttp_static_handle_request(ctx, &hit->request, &hit->response),
+              UVHTTP_OK);
+    EXPECT_TRUE(hit->response.sent);
+    uv_run(&loop, UV_RUN_DEFAULT);
+    std::string compressed = received(hit);
+    EXPECT_NE(compressed.find(" 200 "), std::string::npos);
+    EXPECT_EQ(header(compressed, "Content-Encoding"), "gzip");
+    EXPECT_EQ(header(compressed, "Vary"), "Accept-Encoding");
+    EXPECT_EQ(header(compressed, "Content-Length"),
+              std::to_string(gz->length));
+    EXPECT_EQ(header(compressed, "Content-Type").find("text/css"), 0u);
+    std::string etag = header(miss, "ETag");
+    ASSERT_GE(etag.size(), 2u);
+    EXPECT_EQ(header(compressed, "ETag"),
+              etag.substr(0, etag.size() - 1) + "-gzip\"");
+    EXPECT_EQ(gunzip(body(compressed)), css);
+    EXPECT_NE(entry->variants[UVHTTP_CACHE_ENCODING_GZIP].head, nullptr);
+
+    /* clients without gzip still get the content as it is */
+    std::string plain = fetch(client("/site.css", NULL));
+    EXPECT_EQ(header(plain, "Content-Encoding"), "");
+    EXPECT_EQ(body(plain), css);
+}
+
+TEST_F(StaticEncodingTest, IdentityWhenPreferredRangedOrNotWorthIt) {
+    create(1);
+    ASSERT_EQ(uvhttp_static_prewarm_cache(ctx, "/site.css"), UVHTTP_OK);
+    ASSERT_NE(uvhttp_lru_cache_peek(ctx->cache, "/site.css")
+                  ->variants[UVHTTP_CACHE_ENCODING_GZIP]
+                  .buffer,
+              nullptr);
+
+    std::string refused = fetch(client("/site.css", "gzip;q=0"));
+    EXPECT_EQ(header(refused, "Content-Encoding"), "");
+    EXPECT_EQ(body(refused), css);
+    std::string preferred =
+        fetch(client("/site.css", "gzip;q=0.5, identity"));
+    EXPECT_EQ(header(preferred, "Content-Encoding"), "");
+    EXPECT_EQ(body(preferred), css);
+    std::string tie = fetch(client("/site.css", "gzip, identity"));
+    EXPECT_EQ(header(tie, "Content-Encoding"), "gzip");
+
+    /* ranges are of the content as it is */
+    std::string ranged =
+        fetch(client("/site.css", "gzip", "Range", "bytes=0-9"));
+    EXPECT_NE(ranged.find(" 206 "), std::string::npos);
+    EXPECT_EQ(header(ranged, "Content-Encoding"), "");
+    EXPECT_EQ(body(ranged), css.substr(0, 10));
+
+    /* too small, or no smaller compressed: never encoded */
+    for (const char* url : {"/tiny.css", "/noise.txt"}) {
+        fetch(client(url, "gzip"));
+        std::string again = fetch(client(url, "gzip"));
+        EXPECT_EQ(header(again, "Content-Encoding"), "");
+        again = fetch(client(url, "gzip"));
+        EXPECT_EQ(header(again, "Content-Encoding"), "");
+        cache_entry_t* entry = uvhttp_lru_cache_peek(ctx->cache, url);
+        ASSERT_NE(entry, nullptr);
+        EXPECT_EQ(entry->variants[UVHTTP_CACHE_ENCODING_GZIP].buffer,
+                  nullptr);
+    }
+    EXPECT_EQ(body(fetch(client("/noise.txt", "gzip"))), noise);
+}
+
+TEST_F(StaticEncodingTest, VariantHasItsOwnValidator) {
+    create(1);
+    ASSERT_EQ(uvhttp_static_prewarm_cache(ctx, "/site.css"), UVHTTP_OK);
+    std::string compressed = fetch(client("/site.css", "gzip"));
+    std::string etag = header(compressed, "ETag");
+    ASSERT_NE(etag.find("-gzip\""), std::string::npos);
+
+    std::string unchanged =
+        fetch(client("/site.css", "gzip", "If-None-Match", etag.c_str()));
+    EXPECT_NE(unchanged.find(" 304 "), std::string::npos);
+    /* the identity representation does not match it */
+    std::string other =
+        fetch(client("/site.css", NULL, "If-None-Match", etag.c_str()));
+    EXPECT_NE(other.find(" 200 "), std::string::npos);
+    EXPECT_EQ(body(other), css);
+}
+
+TEST_F(StaticEncodingTest, OffByDefault) {
+    create(0);
+    ASSERT_EQ(uvhttp_static_prewarm_cache(ctx, "/site.css"), UVHTTP_OK);
+    for (int i = 0; i < 3; i++) {
+        std::string response = fetch(client("/site.css", "gzip"));
+        EXPECT_EQ(header(response, "Content-Encoding"), "");
+        EXPECT_EQ(body(response), css);
+    }
+    cache_entry_t* entry = uvhttp_lru_cache_peek(ctx->cache, "/site.css");
+    ASSERT_NE(entry, nullptr);
+    EXPECT_EQ(entry->variants[UVHTTP_CACHE_ENCODING_GZIP].buffer, nullptr);
+    EXPECT_EQ(entry->encodings_tried, 0u);
+}
+
+TEST_F(StaticEncodingTest, SharedCacheKeepsTheVariantForEveryLoop) {
+    ASSERT_EQ(uvhttp_shared_cache_create(4, 1024 * 1024, 100, 0, &shared),
+              UVHTTP_OK);
+    create(1);
+    ASSERT_EQ(uvhttp_static_set_shared_cache(ctx, shared), UVHTTP_OK);
+    fetch(client("/site.css", "gzip"));
+    fetch(client("/site.css", "gzip"));
+
+    uvhttp_cache_hit_t hit;
+    ASSERT_EQ(uvhttp_shared_cache_get(shared, "/site.css", &hit), UVHTTP_OK);
+    ASSERT_NE(hit.variants[UVHTTP_CACHE_ENCODING_GZIP].buffer, nullptr);
+    EXPECT_EQ(std::string(hit.buffer->data, hit.buffer->length), css);
+    uvhttp_cache_hit_release(&hit);
+
+    std::string compressed = fetch(client("/site.css", "gzip"));
+    EXPECT_EQ(header(compressed, "Content-Encoding"), "gzip");
+    EXPECT_EQ(gunzip(body(compressed)), css);
+}
+
+#endif /* UVHTTP_FEATURE_STATIC_FILES && UVHTTP_FEATURE_COMPRESSION */
@@ -0,0 +1,170 @@
+#ifndef TEST_STATIC_HELPER_H
+#define TEST_STATIC_HELPER_H
+
+/* Fixture shared by the static file tests: a loop, a scratch root directory
+ * removed with everything in it on teardown, a context serving it, and
+ * clients whose server side is a uv_tcp_t over one end of a socketpair
+ * while the test reads the response from the other end. */
+
+#include <gtest/gtest.h>
+#include "uvhttp_request.h"
+#include "uvhttp_response.h"
+#include "uvhttp_static.h"
+#include <fcntl.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <uv.h>
+#include <vector>
+
+struct StaticClient {
+    uv_tcp_t tcp;
+    int peer;
+    uvhttp_request_t request;
+    uvhttp_response_t response;
+};
+
+class StaticTestFixture : public ::testing::Test {
+  protected:
+    /* name goes into the root directory's name */
+    explicit StaticTestFixture(const char* name) : name_(name) {}
+
+    void SetUp() override {
+        ASSERT_EQ(uv_loop_init(&loop), 0);
+        snprintf(root, sizeof(root), "/tmp/uvhttp_%s_XXXXXX", name_);
+        ASSERT_NE(mkdtemp(root), nullptr);
+    }
+
+    /* closes the clients, frees ctx and removes root */
+    void TearDown() override {
+        for (StaticClient* c : clients) {
+            uvhttp_response_cleanup(&c->response);
+            uv_close((uv_handle_t*)&c->tcp, NULL);
+        }
+        /* its directory watches close with the clients */
+        uvhttp_static_free(ctx);
+        ctx = nullptr;
+        uv_run(&loop, UV_RUN_DEFAULT);
+        for (StaticClient* c : clients) {
+            close(c->peer);
+            delete c;
+        }
+        clients.clear();
+        EXPECT_EQ(uv_loop_close(&loop), 0);
+        if (root[0] != '\0') {
+            EXPECT_EQ(remove_tree(root), 0);
+        }
+    }
+
+    std::string path(const char* name) {
+        return std::string(root) + "/" + name;
+    }
+
+    void write_file(const char* name, const std::string& content) {
+        FILE* f = fopen(path(name).c_str(), "wb");
+        ASSERT_NE(f, nullptr);
+        fwrite(content.data(), 1, content.size(), f);
+        fclose(f);
+    }
+
+    /* what the tests start from: 1MB of cache and file size, an hour's
+     * TTL, serving root */
+    uvhttp_static_config_t static_config() {
+        uvhttp_static_config_t config;
+        memset(&config, 0, sizeof(config));
+        config.max_cache_size = 1024 * 1024;
+        config.cache_ttl = 3600;
+        config.max_file_size = 1024 * 1024;
+        snprintf(config.root_directory, sizeof(config.root_directory), "%s",
+                 root);
+        snprintf(config.index_file, sizeof(config.index_file), "index.html");
+        return config;
+    }
+
+    void create_context(const uvhttp_static_config_t& config) {
+        ASSERT_EQ(uvhttp_static_create(&config, &ctx), UVHTTP_OK);
+    }
+
+    StaticClient* client(const char* url) {
+        StaticClient* c = new StaticClient();
+        int fds[2];
+        EXPECT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+        int buf = 512 * 1024;
+        setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &buf, sizeof(buf));
+        setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &buf, sizeof(buf));
+        fcntl(fds[1], F_SETFL, O_NONBLOCK);
+        EXPECT_EQ(uv_tcp_init(&loop, &c->tcp), 0);
+        EXPECT_EQ(uv_tcp_open(&c->tcp, fds[0]), 0);
+        c->tcp.data = NULL;
+        c->peer = fds[1];
+        c->request.method = UVHTTP_GET;
+        c->request.headers_capacity = UVHTTP_INLINE_HEADERS_CAPACITY;
+        snprintf(c->request.url, sizeof(c->request.url), "%s", url);
+        EXPECT_EQ(uvhttp_response_init(&c->response, &c->tcp), UVHTTP_OK);
+        clients.push_back(c);
+        return c;
+    }
+
+    uvhttp_result_t serve(StaticClient* c) {
+        return uvhttp_static_handle_request(ctx, &c->request, &c->response);
+    }
+
+    static std::string received(StaticClient* c) {
+        std::string out;
+        char buf[65536];
+        ssize_t n;
+        while ((n = read(c->peer, buf, sizeof(buf))) > 0) {
+            out.append(buf, (size_t)n);
+        }
+        return out;
+    }
+
+    /* serve c, run the loop and return everything written to it */
+    std::string fetch(StaticClient* c) {
+        EXPECT_EQ(serve(c), UVHTTP_OK);
+        uv_run(&loop, UV_RUN_DEFAULT);
+        return received(c);
+    }
+
+    static std::string body(const std::string& response) {
+        size_t end = response.find("\r\n\r\n");
+        return end == std::string::npos ? "" : response.substr(end + 4);
+    }
+
+    static std::string header(const std::string& response, const char* name) {
+        std::string key = std::string("\r\n") + name + ": ";
+        size_t at = response.find(key);
+        if (at == std::string::npos) {
+            return "";
+        }
+        at += key.size();
+        return response.substr(at, response.find("\r\n", at) - at);
+    }
+
+    uv_loop_t loop;
+    char root[64] = "";
+    uvhttp_static_context_t* ctx = nullptr;
+    std::vector<StaticClient*> clients;
+
+  private:
+    static int remove_entry(const char* path, const struct stat* st, int type,
+                            struct FTW* ftw) {
+        (void)st;
+        (void)type;
+        (void)ftw;
+        return remove(path);
+    }
+
+    /* depth first, without following links */
+    static int remove_tree(const char* dir) {
+        return nftw(dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    }
+
+    const char* name_;
+};
+
+#endif /* TEST_STATIC_HELPER_H */
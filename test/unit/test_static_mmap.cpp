@@ -0,0 +1,168 @@
+/* UVHTTP static files: the mapped tier for files over 64KB */
+
+#if UVHTTP_FEATURE_STATIC_FILES
+
+#include <gtest/gtest.h>
+#include "test_static_helper.h"
+#include "uvhttp_lru_cache.h"
+#include <stdlib.h>
+
+TEST(CacheBufferMapTest, MapsTheFileAndOutlivesItsDescriptor) {
+    char name[] = "/tmp/uvhttp_map_XXXXXX";
+    int fd = mkstemp(name);
+    ASSERT_GE(fd, 0);
+    std::string content(70000, 'm');
+    ASSERT_EQ(write(fd, content.data(), content.size()),
+              (ssize_t)content.size());
+
+    for (int populate = 0; populate < 2; populate++) {
+        uvhttp_cache_buffer_t* buffer =
+            uvhttp_cache_buffer_map(fd, content.size(), populate);
+        ASSERT_NE(buffer, nullptr);
+        EXPECT_TRUE(buffer->mapped);
+        EXPECT_EQ(buffer->refcount, 1);
+        EXPECT_EQ(buffer->length, content.size());
+        if (populate) {
+            close(fd);
+            unlink(name);
+        }
+        EXPECT_EQ(std::string(buffer->data, buffer->length), content);
+        uvhttp_cache_buffer_release(buffer);
+    }
+    EXPECT_EQ(uvhttp_cache_buffer_map(-1, 10, 0), nullptr);
+}
+
+class StaticMmapTest : public StaticTestFixture {
+  protected:
+    StaticMmapTest() : StaticTestFixture("static_mmap") {}
+
+    void SetUp() override {
+        StaticTestFixture::SetUp();
+        write_file("small.txt", "hello static");
+        for (size_t i = 0; i < 200 * 1024; i++) {
+            big.push_back((char)('a' + i % 26));
+        }
+        write_file("big.bin", big);
+    }
+
+    void create(size_t mmap_cache_size) {
+        uvhttp_static_config_t config = static_config();
+        config.mmap_cache_size = mmap_cache_size;
+        create_context(config);
+    }
+
+    StaticClient* client(const char* url, const char* range = NULL) {
+        StaticClient* c = StaticTestFixture::client(url);
+        if (range) {
+            uvhttp_request_add_header(&c->request, "Range", range);
+        }
+        return c;
+    }
+
+    std::string big;
+};
+
+TEST_F(StaticMmapTest, MissIsMappedAndHitsAreWrittenFromTheMapping) {
+    create(4 * 1024 * 1024);
+    std::string miss = fetch(client("/big.bin"));
+    EXPECT_NE(miss.find(" 200 "), std::string::npos);
+    EXPECT_EQ(body(miss), big);
+    EXPECT_EQ(ctx->fs_pending, 0);
+
+    /* kept in the mapped tier, apart from the heap cache */
+    size_t mapped_bytes = 0;
+    int entries = 0, hits = 0;
+    uvhttp_static_get_mapped_stats(ctx, &mapped_bytes, &entries, &hits);
+    EXPECT_EQ(entries, 1);
+    EXPECT_GE(mapped_bytes, big.size());
+    int heap_entries = -1;
+    uvhttp_static_get_cache_stats(ctx, NULL, &heap_entries, NULL, NULL, NULL);
+    EXPECT_EQ(heap_entries, 0);
+    cache_entry_t* entry = uvhttp_lru_cache_find(ctx->mapped, "/big.bin");
+    ASSERT_NE(entry, nullptr);
+    EXPECT_TRUE(entry->buffer->mapped);
+
+    StaticClient* hit = client("/big.bin");
+    ASSERT_EQ(serve(hit), UVHTTP_OK);
+    EXPECT_TRUE(hit->response.sent); /* no file system call */
+    uv_run(&loop, UV_RUN_DEFAULT);
+    EXPECT_EQ(received(hit), miss);
+    uvhttp_static_get_mapped_stats(ctx, NULL, NULL, &hits);
+    EXPECT_EQ(hits, 2); /* the lookup above, then the hit */
+
+    /* small files still go to the heap cache */
+    fetch(client("/small.txt"));
+    uvhttp_static_get_cache_stats(ctx, NULL, &heap_entries, NULL, NULL, NULL);
+    EXPECT_EQ(heap_entries, 1);
+    uvhttp_static_get_mapped_stats(ctx, NULL, &entries, NULL);
+    EXPECT_EQ(entries, 1);
+}
+
+TEST_F(StaticMmapTest, RangesAreSentFromTheMapping) {
+    create(4 * 1024 * 1024);
+    for (int pass = 0; pass < 2; pass++) { /* miss, then hit */
+        std::string response =
+            fetch(client("/big.bin", "bytes=70000-150000"));
+        EXPECT_NE(response.find(" 206 "), std::string::npos) << pass;
+        EXPECT_EQ(header(response, "Content-Range"),
+                  "bytes 70000-150000/204800");
+        EXPECT_EQ(header(response, "Content-Length"), "80001");
+        EXPECT_EQ(body(response), big.substr(70000, 80001));
+    }
+
+    std::string parts = fetch(client("/big.bin", "bytes=0-1,-2"));
+    EXPECT_NE(parts.find(" 206 "), std::string::npos);
+    std::string content = body(parts);
+    EXPECT_NE(content.find("Content-Range: bytes 0-1/204800\r\n\r\nab"),
+              std::string::npos);
+    EXPECT_NE(content.find("Content-Range: bytes 204798-204799/204800\r\n\r\n" +
+                           big.substr(204798)),
+              std::string::npos);
+}
+
+TEST_F(StaticMmapTest, DroppedMappingOutlivesThePendingWrite) {
+    create(4 * 1024 * 1024);
+    fetch(client("/big.bin"));
+    cache_entry_t* entry = uvhttp_lru_cache_find(ctx->mapped, "/big.bin");
+    ASSERT_NE(entry, nullptr);
+    uvhttp_cache_buffer_t* mapping = entry->buffer;
+
+    StaticClient* hit = client("/big.bin");
+    ASSERT_EQ(serve(hit), UVHTTP_OK);
+    EXPECT_EQ(mapping->refcount, 2); /* the entry and the head being written */
+
+    /* dropped while the write is pending: unmapped once it is done */
+    uvhttp_static_clear_cache(ctx);
+    int entries = -1;
+    uvhttp_static_get_mapped_stats(ctx, NULL, &entries, NULL);
+    EXPECT_EQ(entries, 0);
+    EXPECT_EQ(mapping->refcount, 1);
+    uv_run(&loop, UV_RUN_DEFAULT);
+    EXPECT_EQ(body(received(hit)), big);
+
+    /* the next request maps the file again */
+    EXPECT_EQ(body(fetch(client("/big.bin"))), big);
+    uvhttp_static_get_mapped_stats(ctx, NULL, &entries, NULL);
+    EXPECT_EQ(entries, 1);
+}
+
+TEST_F(StaticMmapTest, OffByDefaultAndBoundedBySize) {
+    create(0);
+    EXPECT_EQ(ctx->mapped, nullptr);
+    EXPECT_EQ(body(fetch(client("/big.bin"))), big);
+    size_t mapped_bytes = 1;
+    int entries = -1, hits = -1;
+    uvhttp_static_get_mapped_stats(ctx, &mapped_bytes, &entries, &hits);
+    EXPECT_EQ(mapped_bytes, 0u);
+    EXPECT_EQ(entries, 0);
+    EXPECT_EQ(hits, 0);
+    uvhttp_static_free(ctx);
+
+    /* a file over half the tier is sent from disk */
+    create(256 * 1024);
+    EXPECT_EQ(body(fetch(client("/big.bin"))), big);
+    uvhttp_static_get_mapped_stats(ctx, NULL, &entries, NULL);
+    EXPECT_EQ(entries, 0);
+}
+
+#endif /* UVHTTP_FEATURE_STATIC_FILES */
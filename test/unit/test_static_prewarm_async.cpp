@@ -0,0 +1,218 @@
+/* UVHTTP static files: cache prewarm on the thread pool */
+
+#if UVHTTP_FEATURE_STATIC_FILES
+
+#include <gtest/gtest.h>
+#include "test_static_helper.h"
+#include "uvhttp_lru_cache.h"
+#include "uvhttp_shared_cache.h"
+
+struct PrewarmResult {
+    int calls = 0;
+    uvhttp_error_t status = UVHTTP_OK;
+    uvhttp_static_prewarm_stats_t stats;
+    uvhttp_static_context_t* ctx = nullptr;
+};
+
+static void on_prewarmed(uvhttp_static_context_t* ctx, uvhttp_error_t status,
+                         const uvhttp_static_prewarm_stats_t* stats,
+                         void* data) {
+    PrewarmResult* result = (PrewarmResult*)data;
+    result->calls++;
+    result->status = status;
+    result->stats = *stats;
+    result->ctx = ctx;
+}
+
+class StaticPrewarmAsyncTest : public StaticTestFixture {
+  protected:
+    StaticPrewarmAsyncTest() : StaticTestFixture("prewarm") {}
+
+    void SetUp() override {
+        StaticTestFixture::SetUp();
+        ASSERT_EQ(mkdir(path("sub").c_str(), 0755), 0);
+        ASSERT_EQ(mkdir(path("sub/deep").c_str(), 0755), 0);
+        write_file("a.txt", "alpha");
+        write_file("sub/b.css", "body { color: red; }");
+        write_file("sub/deep/c.js", "var c = 1;");
+        write_file("empty.txt", "");
+        write_file("big.bin", std::string(8192, 'b'));
+        /* neither followed nor read */
+        ASSERT_EQ(symlink(path("sub").c_str(), path("loop").c_str()), 0);
+        ASSERT_EQ(mkfifo(path("pipe").c_str(), 0644), 0);
+    }
+
+    void TearDown() override {
+        StaticTestFixture::TearDown();
+        uvhttp_shared_cache_free(shared);
+    }
+
+    void create(int max_inflight_fs = 0, int compress_cache = 0) {
+        uvhttp_static_config_t config = static_config();
+        config.max_file_size = 4096;
+        config.max_inflight_fs = max_inflight_fs;
+        config.compress_cache = compress_cache;
+        create_context(config);
+    }
+
+    std::string cached(const char* key) {
+        cache_entry_t* entry = uvhttp_lru_cache_peek(ctx->cache, key);
+        return entry ? std::string(entry->buffer->data, entry->buffer->length)
+                     : "<none>";
+    }
+
+    uvhttp_shared_cache_t* shared = nullptr;
+};
+
+TEST_F(StaticPrewarmAsyncTest, WarmsTheTreeOffTheLoopThenCallsBack) {
+    create(2);
+    PrewarmResult result;
+    ASSERT_EQ(uvhttp_static_prewarm_directory_async(ctx, &loop, "/", 0,
+                                                    on_prewarmed, &result),
+              UVHTTP_OK);
+    /* nothing is read on the calling thread */
+    EXPECT_EQ(result.calls, 0);
+    EXPECT_EQ(cached("/a.txt"), "<none>");
+    EXPECT_GT(ctx->fs_pending, 0);
+
+    uv_run(&loop, UV_RUN_DEFAULT);
+    EXPECT_EQ(result.calls, 1);
+    EXPECT_EQ(result.status, UVHTTP_OK);
+    EXPECT_EQ(result.ctx, ctx);
+    EXPECT_EQ(result.stats.files, 4);
+    EXPECT_EQ(result.stats.skipped, 3); /* big.bin, pipe, loop */
+    EXPECT_EQ(result.stats.failed, 0);
+    EXPECT_EQ(result.stats.directories, 3);
+    EXPECT_EQ(result.stats.bytes, strlen("alpha") +
+                                      strlen("body { color: red; }") +
+                                      strlen("var c = 1;"));
+    EXPECT_EQ(ctx->fs_pending, 0);
+
+    /* under the URL paths requests look them up by */
+    EXPECT_EQ(cached("/a.txt"), "alpha");
+    EXPECT_EQ(cached("/sub/b.css"), "body { color: red; }");
+    EXPECT_EQ(cached("/sub/deep/c.js"), "var c = 1;");
+    EXPECT_EQ(cached("/empty.txt"), "");
+    EXPECT_EQ(cached("/big.bin"), "<none>");
+    EXPECT_EQ(cached("/loop/b.css"), "<none>");
+    cache_entry_t* entry = uvhttp_lru_cache_peek(ctx->cache, "/sub/b.css");
+    ASSERT_NE(entry, nullptr);
+    EXPECT_STREQ(entry->mime_type, "text/css");
+    EXPECT_NE(entry->etag[0], '\0');
+}
+
+TEST_F(StaticPrewarmAsyncTest, SubdirectoryAndFileLimit) {
+    create();
+    PrewarmResult result;
+    ASSERT_EQ(uvhttp_static_prewarm_directory_async(ctx, &loop, "./sub/", 0,
+                                                    on_prewarmed, &result),
+              UVHTTP_OK);
+    uv_run(&loop, UV_RUN_DEFAULT);
+    EXPECT_EQ(result.status, UVHTTP_OK);
+    EXPECT_EQ(result.stats.files, 2);
+    EXPECT_EQ(cached("/sub/b.css"), "body { color: red; }");
+    EXPECT_EQ(cached("/sub/deep/c.js"), "var c = 1;");
+    EXPECT_EQ(cached("/a.txt"), "<none>");
+
+    uvhttp_static_clear_cache(ctx);
+    PrewarmResult limited;
+    ASSERT_EQ(uvhttp_static_prewarm_directory_async(ctx, &loop, "", 1,
+                                                    on_prewarmed, &limited),
+              UVHTTP_OK);
+    uv_run(&loop, UV_RUN_DEFAULT);
+    EXPECT_EQ(limited.calls, 1);
+    EXPECT_EQ(limited.stats.files + limited.stats.skipped, 1);
+    EXPECT_EQ(limited.stats.directories, 1);
+}
+
+TEST_F(StaticPrewarmAsyncTest, ErrorsAreReportedOnce) {
+    create();
+    PrewarmResult result;
+    EXPECT_EQ(uvhttp_static_prewarm_directory_async(NULL, &loop, "/", 0,
+                                                    on_prewarmed, &result),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_static_prewarm_directory_async(ctx, NULL, "/", 0,
+                                                    on_prewarmed, &result),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_static_prewarm_directory_async(ctx, &loop, NULL, 0,
+                                                    on_prewarmed, &result),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(result.calls, 0);
+
+    ASSERT_EQ(uvhttp_static_prewarm_directory_async(ctx, &loop, "/missing", 0,
+                                                    on_prewarmed, &result),
+              UVHTTP_OK);
+    uv_run(&loop, UV_RUN_DEFAULT);
+    EXPECT_EQ(result.calls, 1);
+    EXPECT_EQ(result.status, UVHTTP_ERROR_NOT_FOUND);
+    EXPECT_EQ(result.stats.files, 0);
+    EXPECT_EQ(ctx->fs_pending, 0);
+
+    /* no callback needed */
+    ASSERT_EQ(uvhttp_static_prewarm_directory_async(ctx, &loop, "/", 0, NULL,
+                                                    NULL),
+              UVHTTP_OK);
+    uv_run(&loop, UV_RUN_DEFAULT);
+    EXPECT_EQ(cached("/a.txt"), "alpha");
+}
+
+TEST_F(StaticPrewarmAsyncTest, FreeWhileRunningCancels) {
+    create(1);
+    PrewarmResult result;
+    ASSERT_EQ(uvhttp_static_prewarm_directory_async(ctx, &loop, "/", 0,
+                                                    on_prewarmed, &result),
+              UVHTTP_OK);
+    uvhttp_static_free(ctx); /* held until the prewarm lets go */
+    ctx = nullptr;
+    uv_run(&loop, UV_RUN_DEFAULT);
+    EXPECT_EQ(result.calls, 1);
+    EXPECT_EQ(result.status, UVHTTP_ERROR_CANCELLED);
+}
+
+TEST_F(StaticPrewarmAsyncTest, SharedCache) {
+    ASSERT_EQ(uvhttp_shared_cache_create(4, 1024 * 1024, 100, 0, &shared),
+              UVHTTP_OK);
+    create();
+    ASSERT_EQ(uvhttp_static_set_shared_cache(ctx, shared), UVHTTP_OK);
+    PrewarmResult result;
+    ASSERT_EQ(uvhttp_static_prewarm_directory_async(ctx, &loop, "/sub", 0,
+                                                    on_prewarmed, &result),
+              UVHTTP_OK);
+    uv_run(&loop, UV_RUN_DEFAULT);
+    EXPECT_EQ(result.stats.files, 2);
+    uvhttp_cache_hit_t hit;
+    ASSERT_EQ(uvhttp_shared_cache_get(shared, "/sub/deep/c.js", &hit),
+              UVHTTP_OK);
+    EXPECT_EQ(std::string(hit.buffer->data, hit.buffer->length), "var c = 1;");
+    uvhttp_cache_hit_release(&hit);
+    EXPECT_EQ(cached("/sub/deep/c.js"), "<none>");
+}
+
+#    if UVHTTP_FEATURE_COMPRESSION
+TEST_F(StaticPrewarmAsyncTest, VariantsAreMadeOnTheThreadPool) {
+    std::string css;
+    for (int i = 0; i < 100; i++) {
+        css += "p { margin: " + std::to_string(i) + "px; }\n";
+    }
+    write_file("sub/site.css", css);
+    create(0, 1);
+    PrewarmResult result;
+    ASSERT_EQ(uvhttp_static_prewarm_directory_async(ctx, &loop, "/sub", 0,
+                                                    on_prewarmed, &result),
+              UVHTTP_OK);
+    uv_run(&loop, UV_RUN_DEFAULT);
+    EXPECT_EQ(result.stats.files, 3);
+    cache_entry_t* entry = uvhttp_lru_cache_peek(ctx->cache, "/sub/site.css");
+    ASSERT_NE(entry, nullptr);
+    uvhttp_cache_buffer_t* gz =
+        entry->variants[UVHTTP_CACHE_ENCODING_GZIP].buffer;
+    ASSERT_NE(gz, nullptr);
+    EXPECT_LT(gz->length, css.size());
+    /* too small to be worth it */
+    entry = uvhttp_lru_cache_peek(ctx->cache, "/sub/b.css");
+    ASSERT_NE(entry, nullptr);
+    EXPECT_EQ(entry->variants[UVHTTP_CACHE_ENCODING_GZIP].buffer, nullptr);
+}
+#    endif
+
+#endif /* UVHTTP_FEATURE_STATIC_FILES */
@@ -0,0 +1,279 @@
+/* UVHTTP static files: Range, If-Range and multipart/byteranges */
+
+#if UVHTTP_FEATURE_STATIC_FILES
+
+#include <gtest/gtest.h>
+#include "test_static_helper.h"
+
+TEST(StaticRangeParseTest, SingleAndSuffixRanges) {
+    uvhttp_static_range_t r[4];
+    ASSERT_EQ(uvhttp_static_parse_range("bytes=0-499", 1000, r, 4), 1);
+    EXPECT_EQ(r[0].start, 0u);
+    EXPECT_EQ(r[0].length, 500u);
+
+    ASSERT_EQ(uvhttp_static_parse_range("bytes=900-", 1000, r, 4), 1);
+    EXPECT_EQ(r[0].start, 900u);
+    EXPECT_EQ(r[0].length, 100u);
+
+    ASSERT_EQ(uvhttp_static_parse_range("bytes=-100", 1000, r, 4), 1);
+    EXPECT_EQ(r[0].start, 900u);
+    EXPECT_EQ(r[0].length, 100u);
+
+    /* clamped to the file */
+    ASSERT_EQ(uvhttp_static_parse_range("bytes=990-5000", 1000, r, 4), 1);
+    EXPECT_EQ(r[0].length, 10u);
+    ASSERT_EQ(uvhttp_static_parse_range("bytes=-5000", 1000, r, 4), 1);
+    EXPECT_EQ(r[0].start, 0u);
+    EXPECT_EQ(r[0].length, 1000u);
+    ASSERT_EQ(uvhttp_static_parse_range("bytes=0-99999999999999999999999",
+                                        1000, r, 4),
+              1);
+    EXPECT_EQ(r[0].length, 1000u);
+}
+
+TEST(StaticRangeParseTest, SeveralRangesKeepTheirOrder) {
+    uvhttp_static_range_t r[4];
+    ASSERT_EQ(uvhttp_static_parse_range("Bytes= 500-599 , 0-9,-1", 1000, r, 4),
+              3);
+    EXPECT_EQ(r[0].start, 500u);
+    EXPECT_EQ(r[1].start, 0u);
+    EXPECT_EQ(r[1].length, 10u);
+    EXPECT_EQ(r[2].start, 999u);
+
+    /* unsatisfiable ranges among others are dropped */
+    ASSERT_EQ(uvhttp_static_parse_range("bytes=2000-2100,5-5", 1000, r, 4), 1);
+    EXPECT_EQ(r[0].start, 5u);
+    EXPECT_EQ(r[0].length, 1u);
+}
+
+TEST(StaticRangeParseTest, UnsatisfiableAndIgnoredHeaders) {
+    uvhttp_static_range_t r[2];
+    EXPECT_EQ(uvhttp_static_parse_range("bytes=1000-", 1000, r, 2), -1);
+    EXPECT_EQ(uvhttp_static_parse_range("bytes=-0", 1000, r, 2), -1);
+    EXPECT_EQ(uvhttp_static_parse_range("bytes=0-", 0, r, 2), -1);
+
+    EXPECT_EQ(uvhttp_static_parse_range("items=0-1", 1000, r, 2), 0);
+    EXPECT_EQ(uvhttp_static_parse_range("bytes=", 1000, r, 2), 0);
+    EXPECT_EQ(uvhttp_static_parse_range("bytes=-", 1000, r, 2), 0);
+    EXPECT_EQ(uvhttp_static_parse_range("bytes=5-4", 1000, r, 2), 0);
+    EXPECT_EQ(uvhttp_static_parse_range("bytes=0-1;", 1000, r, 2), 0);
+    EXPECT_EQ(uvhttp_static_parse_range("bytes=0-1,", 1000, r, 2), 0);
+    /* too many ranges, or overlaps adding up to more than the file */
+    EXPECT_EQ(uvhttp_static_parse_range("bytes=0-0,1-1,2-2", 1000, r, 2), 0);
+    EXPECT_EQ(uvhttp_static_parse_range("bytes=0-,0-", 1000, r, 2), 0);
+    /* several ranges adding up to more than a multipart answer may carry */
+    size_t huge = 4 * (size_t)UVHTTP_STATIC_MAX_MULTIPART_SIZE;
+    EXPECT_EQ(uvhttp_static_parse_range("bytes=0-0,1-", huge, r, 2), 0);
+    ASSERT_EQ(uvhttp_static_parse_range("bytes=1-", huge, r, 2), 1);
+    EXPECT_EQ(r[0].length, huge - 1);
+}
+
+class StaticRangeTest : public StaticTestFixture {
+  protected:
+    StaticRangeTest() : StaticTestFixture("static_range") {}
+
+    void SetUp() override {
+        StaticTestFixture::SetUp();
+        write_file("small.txt", "0123456789abcdefghij");
+        for (size_t i = 0; i < 200 * 1024; i++) {
+            big.push_back((char)('a' + i % 26));
+        }
+        write_file("big.bin", big);
+        write_file("app.js", std::string(600, 'j'));
+        write_file("app.js.gz", "GZIPPED");
+        create_context(static_config());
+    }
+
+    std::string etag_of(const char* name) {
+        struct stat st;
+        EXPECT_EQ(stat(path(name).c_str(), &st), 0);
+        char etag[64];
+        snprintf(etag, sizeof(etag), "\"%zu-%ld\"", (size_t)st.st_size,
+                 (long)st.st_mtime);
+        return etag;
+    }
+
+    StaticClient* client(const char* url, const char* range) {
+        StaticClient* c = StaticTestFixture::client(url);
+        if (range) {
+            uvhttp_request_add_header(&c->request, "Range", range);
+        }
+        return c;
+    }
+
+    /* the expected multipart/byteranges body for the given parts */
+    static std::string multipart(const std::string& response,
+                                 const char* mime_type,
+                                 const std::vector<std::string>& ranges,
+                                 const std::vector<std::string>& parts) {
+        std::string type = header(response, "Content-Type");
+        std::string prefix = "multipart/byteranges; boundary=";
+        EXPECT_EQ(type.compare(0, prefix.size(), prefix), 0) << type;
+        std::string boundary = type.substr(prefix.size());
+        std::string out;
+        for (size_t i = 0; i < parts.size(); i++) {
+            out += "\r\n--" + boundary + "\r\nContent-Type: " + mime_type +
+                   "\r\nContent-Range: bytes " + ranges[i] + "\r\n\r\n" +
+                   parts[i];
+        }
+        return out + "\r\n--" + boundary + "--\r\n";
+    }
+
+    std::string big;
+};
+
+TEST_F(StaticRangeTest, SmallFileRangeOnMissAndOnCacheHit) {
+    std::string whole = fetch(client("/small.txt", NULL));
+    EXPECT_NE(whole.find(" 200 "), std::string::npos);
+    EXPECT_EQ(header(whole, "Accept-Ranges"), "bytes");
+
+    /* now a cache hit: a slice of the cached content */
+    std::string hit = fetch(client("/small.txt", "bytes=10-14"));
+    EXPECT_NE(hit.find(" 206 "), std::string::npos) << hit;
+    EXPECT_EQ(header(hit, "Content-Range"), "bytes 10-14/20");
+    EXPECT_EQ(header(hit, "Content-Length"), "5");
+    EXPECT_EQ(body(hit), "abcde");
+
+    uvhttp_static_clear_cache(ctx);
+    std::string miss = fetch(client("/small.txt", "bytes=-3"));
+    EXPECT_NE(miss.find(" 206 "), std::string::npos) << miss;
+    EXPECT_EQ(header(miss, "Content-Range"), "bytes 17-19/20");
+    EXPECT_EQ(body(miss), "hij");
+}
+
+TEST_F(StaticRangeTest, SmallFileMultiRange) {
+    for (int pass = 0; pass < 2; pass++) { /* miss, then hit */
+        std::string response = fetch(client("/small.txt", "bytes=0-1,18-"));
+        EXPECT_NE(response.find(" 206 "), std::string::npos) << response;
+        std::string expected = multipart(response, "text/plain",
+                                         {"0-1/20", "18-19/20"}, {"01", "ij"});
+        EXPECT_EQ(body(response), expected);
+        EXPECT_EQ(header(response, "Content-Length"),
+                  std::to_string(expected.size()));
+    }
+}
+
+TEST_F(StaticRangeTest, LargeFileRangeIsSentFromItsOffset) {
+    std::string response = fetch(client("/big.bin", "bytes=70000-150000"));
+    EXPECT_NE(response.find(" 206 "), std::string::npos);
+    EXPECT_EQ(header(response, "Content-Range"), "bytes 70000-150000/204800");
+    EXPECT_EQ(header(response, "Content-Length"), "80001");
+    EXPECT_EQ(body(response), big.substr(70000, 80001));
+
+    std::string tail = fetch(client("/big.bin", "bytes=-10"));
+    EXPECT_EQ(body(tail), big.substr(big.size() - 10));
+    EXPECT_EQ(ctx->fs_pending, 0);
+}
+
+TEST_F(StaticRangeTest, LargeFileMultiRangeIsReadInParts) {
+    std::string response =
+        fetch(client("/big.bin", "bytes=100000-100099,5-9,-70000"));
+    EXPECT_NE(response.find(" 206 "), std::string::npos);
+    std::string expected = multipart(
+        response, "application/octet-stream",
+        {"100000-100099/204800", "5-9/204800", "134800-204799/204800"},
+        {big.substr(100000, 100), big.substr(5, 5), big.substr(134800)});
+    EXPECT_EQ(header(response, "Content-Length"),
+              std::to_string(expected.size()));
+    EXPECT_EQ(body(response), expected);
+    EXPECT_EQ(ctx->fs_pending, 0);
+}
+
+TEST_F(StaticRangeTest, MultipartIsReadAsTheClientTakesIt) {
+    StaticClient* c = client("/big.bin", "bytes=0-99999,100000-");
+    uv_os_fd_t fd;
+    ASSERT_EQ(uv_fileno((uv_handle_t*)&c->tcp, &fd), 0);
+    int small = 4096;
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &small, sizeof(small));
+    ASSERT_EQ(uvhttp_static_handle_request(ctx, &c->request, &c->response),
+              UVHTTP_OK);
+
+    /* the peer reads nothing: at most a chunk waits in the write queue */
+    for (int i = 0; i < 200; i++) {
+        uv_run(&loop, UV_RUN_NOWAIT);
+        usleep(1000);
+    }
+    EXPECT_LE(uv_stream_get_write_queue_size((uv_stream_t*)&c->tcp),
+              (size_t)UVHTTP_FILE_CHUNK_SIZE);
+    EXPECT_EQ(ctx->fs_pending, 1);
+
+    std::string response;
+    char buf[65536];
+    for (int i = 0; i < 10000 && (ctx->fs_pending > 0 ||
+                                  uv_stream_get_write_queue_size(
+                                      (uv_stream_t*)&c->tcp) > 0);
+         i++) {
+        ssize_t n;
+        while ((n = read(c->peer, buf, sizeof(buf))) > 0) {
+            response.append(buf, (size_t)n);
+        }
+        uv_run(&loop, UV_RUN_NOWAIT);
+        usleep(100);
+    }
+    uv_run(&loop, UV_RUN_DEFAULT);
+    ssize_t n;
+    while ((n = read(c->peer, buf, sizeof(buf))) > 0) {
+        response.append(buf, (size_t)n);
+    }
+    EXPECT_EQ(ctx->fs_pending, 0);
+    EXPECT_EQ(body(response),
+              multipart(response, "application/octet-stream",
+                        {"0-99999/204800", "100000-204799/204800"},
+                        {big.substr(0, 100000), big.substr(100000)}));
+}
+
+TEST_F(StaticRangeTest, UnsatisfiableRangeIs416) {
+    std::string large = fetch(client("/big.bin", "bytes=204800-"));
+    EXPECT_NE(large.find(" 416 "), std::string::npos) << large;
+    EXPECT_EQ(header(large, "Content-Range"), "bytes */204800");
+
+    fetch(client("/small.txt", NULL)); /* cached */
+    std::string small = fetch(client("/small.txt", "bytes=20-30"));
+    EXPECT_NE(small.find(" 416 "), std::string::npos) << small;
+    EXPECT_EQ(header(small, "Content-Range"), "bytes */20");
+
+    /* a malformed header is ignored */
+    std::string ignored = fetch(client("/small.txt", "bytes=9-2"));
+    EXPECT_NE(ignored.find(" 200 "), std::string::npos);
+    EXPECT_EQ(body(ignored), "0123456789abcdefghij");
+}
+
+TEST_F(StaticRangeTest, IfRangeMustMatchTheCurrentFile) {
+    StaticClient* stale = client("/big.bin", "bytes=0-9");
+    uvhttp_request_add_header(&stale->request, "If-Range", "\"1-1\"");
+    std::string whole = fetch(stale);
+    EXPECT_NE(whole.find(" 200 "), std::string::npos);
+    EXPECT_EQ(body(whole).size(), big.size());
+
+    StaticClient* current = client("/big.bin", "bytes=0-9");
+    uvhttp_request_add_header(&current->request, "If-Range",
+                              etag_of("big.bin").c_str());
+    std::string part = fetch(current);
+    EXPECT_NE(part.find(" 206 "), std::string::npos);
+    EXPECT_EQ(body(part), big.substr(0, 10));
+
+    /* the Last-Modified date of the file validates too */
+    std::string date = header(whole, "Last-Modified");
+    StaticClient* dated = client("/big.bin", "bytes=0-9");
+    uvhttp_request_add_header(&dated->request, "If-Range", date.c_str());
+    EXPECT_EQ(body(fetch(dated)), big.substr(0, 10));
+}
+
+TEST_F(StaticRangeTest, RangeIsServedFromTheIdentityFile) {
+    StaticClient* c = client("/app.js", "bytes=0-3");
+    uvhttp_request_add_header(&c->request, "Accept-Encoding", "gzip");
+    std::string response = fetch(c);
+    EXPECT_NE(response.find(" 206 "), std::string::npos);
+    EXPECT_EQ(response.find("Content-Encoding"), std::string::npos);
+    EXPECT_EQ(body(response), "jjjj");
+}
+
+TEST_F(StaticRangeTest, HeadIgnoresRange) {
+    StaticClient* c = client("/small.txt", "bytes=0-1");
+    c->request.method = UVHTTP_HEAD;
+    std::string response = fetch(c);
+    EXPECT_NE(response.find(" 200 "), std::string::npos);
+    EXPECT_EQ(header(response, "Content-Length"), "20");
+}
+
+#endif /* UVHTTP_FEATURE_STATIC_FILES */
@@ -0,0 +1,103 @@
+/**
+ * @file test_tls_record_sizing.cpp
+ * @brief Dynamic TLS record sizing policy tests
+ *
+ * Validates uvhttp_tls_context_next_record_size() and
+ * uvhttp_tls_context_set_dynamic_record_sizing():
+ * - new contexts start with segment-sized records
+ * - full-size records once the boost threshold is crossed
+ * - idle connections fall back to small records
+ * - disabling sizing removes the limit
+ * - parameter validation and NULL safety
+ *
+ * Build configuration: UVHTTP_FEATURE_TLS must be enabled.
+ */
+
+#include <gtest/gtest.h>
+
+extern "C" {
+#include "uvhttp_tls.h"
+}
+
+#if UVHTTP_FEATURE_TLS
+
+class TlsRecordSizingTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ctx = nullptr;
+        ASSERT_EQ(uvhttp_tls_context_new(&ctx), UVHTTP_OK);
+        streamed = 0;
+        last_ms = 0;
+    }
+    void TearDown() override { uvhttp_tls_context_free(ctx); }
+
+    uvhttp_tls_context_t* ctx;
+    uint64_t streamed;
+    uint64_t last_ms;
+};
+
+TEST_F(TlsRecordSizingTest, DefaultsStartSmall) {
+    EXPECT_EQ(uvhttp_tls_context_next_record_size(ctx, &streamed, &last_ms,
+                                                  10),
+              (size_t)UVHTTP_TLS_RECORD_SMALL_DEFAULT);
+    EXPECT_EQ(last_ms, 10u);
+}
+
+TEST_F(TlsRecordSizingTest, BoostsAfterThreshold) {
+    ASSERT_EQ(uvhttp_tls_context_set_dynamic_record_sizing(ctx, 1, 1000, 4000,
+                                                           500),
+              UVHTTP_OK);
+
+    uint64_t now = 100;
+    int small_records = 0;
+    while (uvhttp_tls_context_next_record_size(ctx, &streamed, &last_ms,
+                                               now) == 1000) {
+        streamed += 1000;
+        small_records++;
+        now += 1;
+        ASSERT_LT(small_records, 100);
+    }
+    EXPECT_EQ(small_records, 4);
+    EXPECT_EQ(uvhttp_tls_context_next_record_size(ctx, &streamed, &last_ms,
+                                                  now),
+              0u);
+}
+
+TEST_F(TlsRecordSizingTest, IdleResetsToSmall) {
+    ASSERT_EQ(uvhttp_tls_context_set_dynamic_record_sizing(ctx, 1, 1000, 4000,
+                                                           500),
+              UVHTTP_OK);
+    streamed = 10000;
+    last_ms = 1000;
+
+    /* Within the idle window the connection stays boosted. */
+    EXPECT_EQ(uvhttp_tls_context_next_record_size(ctx, &streamed, &last_ms,
+                                                  1400),
+              0u);
+    /* Past it the ramp starts over. */
+    EXPECT_EQ(uvhttp_tls_context_next_record_size(ctx, &streamed, &last_ms,
+                                                  2000),
+              1000u);
+    EXPECT_EQ(streamed, 0u);
+}
+
+TEST_F(TlsRecordSizingTest, DisabledHasNoLimit) {
+    ASSERT_EQ(uvhttp_tls_context_set_dynamic_record_sizing(ctx, 0, 0, 0, 0),
+              UVHTTP_OK);
+    EXPECT_EQ(uvhttp_tls_context_next_record_size(ctx, &streamed, &last_ms,
+                                                  10),
+              0u);
+}
+
+TEST_F(TlsRecordSizingTest, InvalidParams) {
+    EXPECT_EQ(uvhttp_tls_context_set_dynamic_record_sizing(nullptr, 1, 0, 0, 0),
+              UVHTTP_ERROR_TLS_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_tls_context_set_dynamic_record_sizing(ctx, 1, 1 << 20, 0,
+                                                           0),
+              UVHTTP_ERROR_TLS_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_tls_context_next_record_size(nullptr, &streamed, &last_ms,
+                                                  0),
+              0u);
+}
+
+#endif /* UVHTTP_FEATURE_TLS */
@@ -0,0 +1,309 @@
+/**
+ * @file test_tls_session_cache.cpp
+ * @brief uvhttp_tls_session_cache module unit tests
+ *
+ * Validates the shared TLS session cache in src/uvhttp_tls_session_cache.c:
+ * - create/free lifecycle and parameter validation
+ * - get miss, put/get round trip, refresh of an existing ID
+ * - BUFFER_TOO_SMALL reports the required size
+ * - per-shard eviction once the entry budget is exhausted, oldest first
+ * - remove and stats accounting (hits, misses, stores, entries, memory)
+ * - ticket key sync: first publisher wins an epoch, newer epochs replace it
+ * - concurrent put/get from several threads
+ * - a context's ticket lifetime reaching an attached cache and its keys
+ *
+ * Build configuration: UVHTTP_FEATURE_TLS must be enabled.
+ */
+
+#include <gtest/gtest.h>
+#include <cstring>
+#include <ctime>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "uvhttp_tls.h"
+#include "uvhttp_tls_session_cache.h"
+}
+
+#if UVHTTP_FEATURE_TLS
+
+class TlsSessionCacheTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        cache = nullptr;
+        ASSERT_EQ(uvhttp_tls_session_cache_create(4, 64, 60, &cache),
+                  UVHTTP_OK);
+    }
+    void TearDown() override { uvhttp_tls_session_cache_free(cache); }
+
+    static void make_id(unsigned char* id, unsigned int n) {
+        memset(id, 0, 32);
+        memcpy(id, &n, sizeof(n));
+    }
+
+    uvhttp_tls_session_cache_t* cache;
+};
+
+TEST_F(TlsSessionCacheTest, CreateInvalidParams) {
+    EXPECT_EQ(uvhttp_tls_session_cache_create(0, 0, 0, nullptr),
+              UVHTTP_ERROR_INVALID_PARAM);
+    uvhttp_tls_session_cache_free(nullptr);
+}
+
+TEST_F(TlsSessionCacheTest, PutGetRoundTrip) {
+    unsigned char id[32];
+    make_id(id, 1);
+    const unsigned char data[] = "serialized-session";
+    unsigned char buf[64];
+    size_t len = 0;
+
+    EXPECT_EQ(uvhttp_tls_session_cache_get(cache, id, 32, buf, sizeof(buf),
+                                           &len),
+              UVHTTP_ERROR_NOT_FOUND);
+    ASSERT_EQ(uvhttp_tls_session_cache_put(cache, id, 32, data, sizeof(data)),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_tls_session_cache_get(cache, id, 32, buf, sizeof(buf),
+                                           &len),
+              UVHTTP_OK);
+    EXPECT_EQ(len, sizeof(data));
+    EXPECT_EQ(memcmp(buf, data, len), 0);
+}
+
+TEST_F(TlsSessionCacheTest, PutRefreshesExistingId) {
+    unsigned char id[32];
+    make_id(id, 7);
+    const unsigned char a[] = "aaaa";
+    const unsigned char b[] = "bbbbbbbb";
+    unsigned char buf[32];
+    size_t len = 0;
+
+    ASSERT_EQ(uvhttp_tls_session_cache_put(cache, id, 32, a, sizeof(a)),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_tls_session_cache_put(cache, id, 32, b, sizeof(b)),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_tls_session_cache_get(cache, id, 32, buf, sizeof(buf),
+                                           &len),
+              UVHTTP_OK);
+    EXPECT_EQ(len, sizeof(b));
+
+    uvhttp_tls_session_cache_stats_t stats;
+    ASSERT_EQ(uvhttp_tls_session_cache_get_stats(cache, &stats), UVHTTP_OK);
+    EXPECT_EQ(stats.entries, 1u);
+    EXPECT_EQ(stats.memory, sizeof(b));
+    EXPECT_EQ(stats.stores, 2u);
+}
+
+TEST_F(TlsSessionCacheTest, BufferTooSmallReportsSize) {
+    unsigned char id[32];
+    make_id(id, 3);
+    unsigned char data[100];
+    memset(data, 0x5a, sizeof(data));
+    unsigned char buf[10];
+    size_t len = 0;
+
+    ASSERT_EQ(uvhttp_tls_session_cache_put(cache, id, 32, data, sizeof(data)),
+              UVHTTP_OK);
+    EXPECT_EQ(uvhttp_tls_session_cache_get(cache, id, 32, buf, sizeof(buf),
+                                           &len),
+              UVHTTP_ERROR_BUFFER_TOO_SMALL);
+    EXPECT_EQ(len, sizeof(data));
+}
+
+TEST_F(TlsSessionCacheTest, EvictsWhenFull) {
+    unsigned char id[32];
+    const unsigned char data[] = "x";
+    for (unsigned int i = 0; i < 256; i++) {
+        make_id(id, i);
+        ASSERT_EQ(uvhttp_tls_session_cache_put(cache, id, 32, data,
+                                               sizeof(data)),
+                  UVHTTP_OK);
+    }
+
+    uvhttp_tls_session_cache_stats_t stats;
+    ASSERT_EQ(uvhttp_tls_session_cache_get_stats(cache, &stats), UVHTTP_OK);
+    EXPECT_LE(stats.entries, 64u);
+    EXPECT_EQ(stats.entries + stats.evictions, 256u);
+}
+
+TEST_F(TlsSessionCacheTest, EvictsOldestFirst) {
+    uvhttp_tls_session_cache_t* one = nullptr;
+    ASSERT_EQ(uvhttp_tls_session_cache_create(1, 4, 60, &one), UVHTTP_OK);
+    unsigned char id[32];
+    const unsigned char data[] = "x";
+    unsigned char buf[8];
+    size_t len = 0;
+    for (unsigned int i = 0; i < 4; i++) {
+        make_id(id, i);
+        ASSERT_EQ(uvhttp_tls_session_cache_put(one, id, 32, data,
+                                               sizeof(data)),
+                  UVHTTP_OK);
+    }
+    /* refreshing 0 makes 1 the oldest */
+    make_id(id, 0);
+    ASSERT_EQ(uvhttp_tls_session_cache_put(one, id, 32, data, sizeof(data)),
+              UVHTTP_OK);
+    make_id(id, 4);
+    ASSERT_EQ(uvhttp_tls_session_cache_put(one, id, 32, data, sizeof(data)),
+              UVHTTP_OK);
+
+    make_id(id, 1);
+    EXPECT_EQ(uvhttp_tls_session_cache_get(one, id, 32, buf, sizeof(buf),
+                                           &len),
+              UVHTTP_ERROR_NOT_FOUND);
+    for (unsigned int i : {0u, 2u, 3u, 4u}) {
+        make_id(id, i);
+        EXPECT_EQ(uvhttp_tls_session_cache_get(one, id, 32, buf, sizeof(buf),
+                                               &len),
+                  UVHTTP_OK)
+            << i;
+    }
+
+    /* a removed entry's slot is reused before anything is evicted */
+    make_id(id, 2);
+    ASSERT_EQ(uvhttp_tls_session_cache_remove(one, id, 32), UVHTTP_OK);
+    make_id(id, 5);
+    ASSERT_EQ(uvhttp_tls_session_cache_put(one, id, 32, data, sizeof(data)),
+              UVHTTP_OK);
+    uvhttp_tls_session_cache_stats_t stats;
+    ASSERT_EQ(uvhttp_tls_session_cache_get_stats(one, &stats), UVHTTP_OK);
+    EXPECT_EQ(stats.entries, 4u);
+    EXPECT_EQ(stats.evictions, 1u);
+    uvhttp_tls_session_cache_free(one);
+}
+
+TEST_F(TlsSessionCacheTest, RemoveAndStats) {
+    unsigned char id[32];
+    make_id(id, 9);
+    const unsigned char data[] = "session";
+    unsigned char buf[32];
+    size_t len = 0;
+
+    ASSERT_EQ(uvhttp_tls_session_cache_put(cache, id, 32, data, sizeof(data)),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_tls_session_cache_get(cache, id, 32, buf, sizeof(buf),
+                                           &len),
+              UVHTTP_OK);
+    EXPECT_EQ(uvhttp_tls_session_cache_remove(cache, id, 32), UVHTTP_OK);
+    EXPECT_EQ(uvhttp_tls_session_cache_remove(cache, id, 32),
+              UVHTTP_ERROR_NOT_FOUND);
+    EXPECT_EQ(uvhttp_tls_session_cache_get(cache, id, 32, buf, sizeof(buf),
+                                           &len),
+              UVHTTP_ERROR_NOT_FOUND);
+
+    uvhttp_tls_session_cache_stats_t stats;
+    ASSERT_EQ(uvhttp_tls_session_cache_get_stats(cache, &stats), UVHTTP_OK);
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_EQ(stats.entries, 0u);
+    EXPECT_EQ(stats.memory, 0u);
+}
+
+TEST_F(TlsSessionCacheTest, InvalidIdLength) {
+    unsigned char id[64] = {0};
+    const unsigned char data[] = "x";
+    EXPECT_EQ(uvhttp_tls_session_cache_put(cache, id, 0, data, sizeof(data)),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_tls_session_cache_put(cache, id, 33, data, sizeof(data)),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_tls_session_cache_set_timeout(cache, 0),
+              UVHTTP_ERROR_INVALID_PARAM);
+}
+
+TEST_F(TlsSessionCacheTest, TicketKeyFirstPublisherWins) {
+    uvhttp_tls_ticket_key_t a, b, out;
+    memset(&a, 0xaa, sizeof(a));
+    memset(&b, 0xbb, sizeof(b));
+
+    ASSERT_EQ(uvhttp_tls_session_cache_sync_ticket_key(cache, 5, &a, &out),
+              UVHTTP_OK);
+    EXPECT_EQ(out.epoch, 5u);
+    EXPECT_EQ(memcmp(out.key, a.key, sizeof(a.key)), 0);
+
+    /* A second worker reaching the same epoch adopts the published key. */
+    ASSERT_EQ(uvhttp_tls_session_cache_sync_ticket_key(cache, 5, &b, &out),
+              UVHTTP_OK);
+    EXPECT_EQ(memcmp(out.key, a.key, sizeof(a.key)), 0);
+
+    /* A newer epoch replaces it. */
+    ASSERT_EQ(uvhttp_tls_session_cache_sync_ticket_key(cache, 6, &b, &out),
+              UVHTTP_OK);
+    EXPECT_EQ(out.epoch, 6u);
+    EXPECT_EQ(memcmp(out.key, b.key, sizeof(b.key)), 0);
+}
+
+TEST_F(TlsSessionCacheTest, ConcurrentWorkers) {
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < 4; t++) {
+        workers.emplace_back([this, t]() {
+            unsigned char id[32];
+            unsigned char buf[16];
+            size_t len = 0;
+            for (unsigned int i = 0; i < 2000; i++) {
+                make_id(id, (t << 16) | (i % 32));
+                uvhttp_tls_session_cache_put(cache, id, 32, id, 16);
+                uvhttp_tls_session_cache_get(cache, id, 32, buf, sizeof(buf),
+                                             &len);
+            }
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+
+    uvhttp_tls_session_cache_stats_t stats;
+    ASSERT_EQ(uvhttp_tls_session_cache_get_stats(cache, &stats), UVHTTP_OK);
+    EXPECT_EQ(stats.stores, 8000u);
+    EXPECT_EQ(stats.hits + stats.misses, 8000u);
+    EXPECT_LE(stats.entries, 64u);
+}
+
+TEST_F(TlsSessionCacheTest, TicketLifetimeReachesAttachedCacheAndKeys) {
+    uvhttp_tls_context_t* ctx = nullptr;
+    ASSERT_EQ(uvhttp_tls_context_new(&ctx), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_tls_context_set_shared_session_cache(ctx, cache),
+              UVHTTP_OK);
+    ASSERT_EQ(uvhttp_tls_context_enable_session_tickets(ctx, 1), UVHTTP_OK);
+
+    /* after setup, so the key mbedtls made is replaced by one published
+     * for the next epoch */
+    ASSERT_EQ(uvhttp_tls_context_set_ticket_lifetime(ctx, 1), UVHTTP_OK);
+    uvhttp_tls_ticket_key_t candidate, out;
+    memset(&candidate, 0xcc, sizeof(candidate));
+    ASSERT_EQ(uvhttp_tls_session_cache_sync_ticket_key(cache, 1, &candidate,
+                                                       &out),
+              UVHTTP_OK);
+    EXPECT_NE(memcmp(out.key, candidate.key, sizeof(out.key)), 0);
+
+    /* the shared cache now expires sessions after one second, not 60 */
+    unsigned char id[32];
+    make_id(id, 3);
+    const unsigned char data[] = "session";
+    unsigned char buf[16];
+    size_t len = 0;
+    ASSERT_EQ(uvhttp_tls_session_cache_put(cache, id, 32, data, sizeof(data)),
+              UVHTTP_OK);
+    time_t stored = time(nullptr);
+    while (time(nullptr) == stored) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    EXPECT_EQ(uvhttp_tls_session_cache_get(cache, id, 32, buf, sizeof(buf),
+                                           &len),
+              UVHTTP_ERROR_NOT_FOUND);
+
+    /* keys we installed are loaded again rather than rotated away */
+    const unsigned char key[32] = {1, 2, 3};
+    ASSERT_EQ(uvhttp_tls_context_set_ticket_key(ctx, key, sizeof(key)),
+              UVHTTP_OK);
+    EXPECT_EQ(uvhttp_tls_context_set_ticket_lifetime(ctx, 3600), UVHTTP_OK);
+    EXPECT_EQ(uvhttp_tls_session_cache_sync_ticket_key(cache, 1, &candidate,
+                                                       &out),
+              UVHTTP_OK);
+    EXPECT_EQ(out.epoch, 1u);
+    EXPECT_EQ(uvhttp_tls_context_set_ticket_lifetime(ctx, 0),
+              UVHTTP_ERROR_TLS_INVALID_PARAM);
+
+    uvhttp_tls_context_free(ctx);
+}
+
+#endif /* UVHTTP_FEATURE_TLS */
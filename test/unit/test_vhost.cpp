@@ -0,0 +1,146 @@
+/* UVHTTP virtual host tests: Host header to router selection */
+
+#include <gtest/gtest.h>
+#include <string.h>
+#include <string>
+#include "uvhttp.h"
+#include "uvhttp_server.h"
+#include "uvhttp_vhost.h"
+
+class VhostTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        memset(&server, 0, sizeof(server));
+        ASSERT_EQ(uvhttp_router_new(&server.router), UVHTTP_OK);
+    }
+    void TearDown() override {
+        uvhttp_vhost_table_free((uvhttp_vhost_table_t*)server.vhosts, &server);
+        uvhttp_router_free(server.router);
+    }
+
+    uvhttp_router_t* add(const char* host) {
+        uvhttp_router_t* router = NULL;
+        EXPECT_EQ(uvhttp_router_new(&router), UVHTTP_OK);
+        EXPECT_EQ(uvhttp_server_add_vhost(&server, host, router), UVHTTP_OK);
+        return router;
+    }
+
+    uvhttp_server_t server;
+};
+
+static std::string normalize(const char* host) {
+    char out[UVHTTP_VHOST_MAX_NAME_LEN];
+    size_t len = uvhttp_vhost_normalize(host, strlen(host), out);
+    return std::string(out, len);
+}
+
+TEST(VhostNormalizeTest, LowercasesAndStripsPortAndDot) {
+    EXPECT_EQ(normalize("Example.COM"), "example.com");
+    EXPECT_EQ(normalize("example.com:8080"), "example.com");
+    EXPECT_EQ(normalize("example.com."), "example.com");
+    EXPECT_EQ(normalize("[::1]:443"), "[::1]");
+    EXPECT_EQ(normalize(""), "");
+    EXPECT_EQ(normalize(":80"), "");
+
+    std::string too_long(UVHTTP_VHOST_MAX_NAME_LEN + 1, 'a');
+    EXPECT_EQ(normalize(too_long.c_str()), "");
+}
+
+TEST_F(VhostTest, NoVhostsUsesServerRouter) {
+    EXPECT_EQ(uvhttp_server_find_router(&server, "example.com"), server.router);
+    EXPECT_EQ(uvhttp_server_find_router(&server, NULL), server.router);
+    EXPECT_EQ(uvhttp_server_find_router(NULL, "example.com"), nullptr);
+}
+
+TEST_F(VhostTest, RejectsMalformedNames) {
+    uvhttp_router_t* router = NULL;
+    ASSERT_EQ(uvhttp_router_new(&router), UVHTTP_OK);
+    const char* bad[] = {"",          "*",        "*.",     "*example.com",
+                         "a.*.com",   ".example", "a/b",    "example.com:80",
+                         "*.*.a.com"};
+    for (const char* host : bad) {
+        EXPECT_EQ(uvhttp_server_add_vhost(&server, host, router),
+                  UVHTTP_ERROR_INVALID_PARAM)
+            << host;
+    }
+    EXPECT_EQ(uvhttp_server_add_vhost(&server, NULL, router),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_server_add_vhost(&server, "a.com", NULL),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_server_add_vhost(NULL, "a.com", router),
+              UVHTTP_ERROR_INVALID_PARAM);
+    uvhttp_router_free(router);
+}
+
+TEST_F(VhostTest, ExactNamesIgnoreCaseAndPort) {
+    uvhttp_router_t* a = add("a.example.com");
+    uvhttp_router_t* b = add("B.example.com");
+
+    EXPECT_EQ(uvhttp_server_find_router(&server, "a.example.com"), a);
+    EXPECT_EQ(uvhttp_server_find_router(&server, "A.Example.Com:8080"), a);
+    EXPECT_EQ(uvhttp_server_find_router(&server, "b.example.com."), b);
+    EXPECT_EQ(uvhttp_server_find_router(&server, "c.example.com"),
+              server.router);
+    EXPECT_EQ(uvhttp_server_find_router(&server, NULL), server.router);
+}
+
+TEST_F(VhostTest, DuplicateNameIsRejected) {
+    add("example.com");
+    uvhttp_router_t* router = NULL;
+    ASSERT_EQ(uvhttp_router_new(&router), UVHTTP_OK);
+    EXPECT_EQ(uvhttp_server_add_vhost(&server, "EXAMPLE.com", router),
+              UVHTTP_ERROR_ALREADY_EXISTS);
+    uvhttp_router_free(router);
+}
+
+TEST_F(VhostTest, WildcardMatchesSubdomainsOnly) {
+    uvhttp_router_t* wild = add("*.example.com");
+
+    EXPECT_EQ(uvhttp_server_find_router(&server, "www.example.com"), wild);
+    EXPECT_EQ(uvhttp_server_find_router(&server, "a.b.example.com"), wild);
+    EXPECT_EQ(uvhttp_server_find_router(&server, "example.com"),
+              server.router);
+    EXPECT_EQ(uvhttp_server_find_router(&server, "badexample.com"),
+              server.router);
+}
+
+TEST_F(VhostTest, MostSpecificNameWins) {
+    uvhttp_router_t* wild = add("*.example.com");
+    uvhttp_router_t* api_wild = add("*.api.example.com");
+    uvhttp_router_t* exact = add("v1.api.example.com");
+
+    EXPECT_EQ(uvhttp_server_find_router(&server, "v1.api.example.com"), exact);
+    EXPECT_EQ(uvhttp_server_find_router(&server, "v2.api.example.com"),
+              api_wild);
+    EXPECT_EQ(uvhttp_server_find_router(&server, "api.example.com"), wild);
+}
+
+TEST_F(VhostTest, ManyHostsAndSharedRouters) {
+    /* grows the table several times; one router serves every other host */
+    uvhttp_router_t* shared = NULL;
+    ASSERT_EQ(uvhttp_router_new(&shared), UVHTTP_OK);
+    uvhttp_router_t* own[100] = {NULL};
+    for (int i = 0; i < 100; i++) {
+        char host[32];
+        snprintf(host, sizeof(host), "site%d.test", i);
+        if (i % 2 == 0) {
+            ASSERT_EQ(uvhttp_server_add_vhost(&server, host, shared),
+                      UVHTTP_OK);
+        } else {
+            own[i] = add(host);
+        }
+    }
+    /* the server's own router may serve a virtual host too */
+    ASSERT_EQ(uvhttp_server_add_vhost(&server, "default.test", server.router),
+              UVHTTP_OK);
+
+    for (int i = 0; i < 100; i++) {
+        char host[32];
+        snprintf(host, sizeof(host), "SITE%d.test:80", i);
+        EXPECT_EQ(uvhttp_server_find_router(&server, host),
+                  i % 2 == 0 ? shared : own[i]);
+    }
+    EXPECT_EQ(uvhttp_server_find_router(&server, "default.test"),
+              server.router);
+    /* TearDown frees shared once and leaves server.router alone (ASan) */
+}
@@ -804,21 +804,6 @@ TEST(UvhttpWebsocketAutomatedTest, NullVerifyHandshakeResponseNullConn) {
     EXPECT_NE(result, UVHTTP_OK);
 }
 
-TEST(UvhttpWebsocketAutomatedTest, NullRecvFrameNullConn) {
-    uvhttp_ws_frame_t frame;
-    memset(&frame, 0, sizeof(frame));
-    uvhttp_error_t result = uvhttp_ws_recv_frame(NULL, &frame);
-    EXPECT_NE(result, UVHTTP_OK);
-}
-
-TEST(UvhttpWebsocketAutomatedTest, NullRecvFrameNullFrame) {
-    uvhttp_ws_connection_t* conn = create_test_conn(-1, 1);
-    ASSERT_NE(conn, nullptr);
-    uvhttp_error_t result = uvhttp_ws_recv_frame(conn, NULL);
-    EXPECT_NE(result, UVHTTP_OK);
-    uvhttp_ws_connection_free(conn);
-}
-
 TEST(UvhttpWebsocketAutomatedTest, NullSetCallbacksNullConn) {
     /* should not crash */
     uvhttp_ws_set_callbacks(NULL, NULL, NULL, NULL);
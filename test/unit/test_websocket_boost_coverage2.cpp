@@ -6,7 +6,6 @@
  * - uvhttp_ws_verify_handshake_response: whitespace skip (413), accept mismatch (450)
  * - uvhttp_ws_process_data: buffer doubling while-loop (683, 686)
  * - uvhttp_ws_send_frame: build_frame failure path (481-482)
- * - uvhttp_ws_recv_frame: socketpair-based recv tests
  * - uvhttp_ws_close: close with reason in payload
  * - build_frame: extended 127 length with masking
  * - parse_frame_header: extended 126/127 with mask
@@ -213,292 +212,6 @@ protected:
     }
 };
 
-/* ========== uvhttp_ws_recv_frame tests via socketpair ========== */
-
-class WsRecvFrameTest : public ::testing::Test {
-protected:
-    int sv[2];
-    uvhttp_ws_connection_t* conn;
-
-    void SetUp() override {
-        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
-        conn = uvhttp_ws_connection_create(sv[0], NULL, 1, NULL);
-        ASSERT_NE(conn, nullptr);
-        conn->state = UVHTTP_WS_STATE_OPEN;
-    }
-
-    void TearDown() override {
-        if (conn) {
-            uvhttp_ws_connection_free(conn);
-        }
-        close(sv[0]);
-        close(sv[1]);
-    }
-
-    /** Send data on the other end of the socketpair and have conn recv it */
-    void send_and_recv(const uint8_t* data_to_send, size_t data_len,
-                       uvhttp_ws_frame_t* frame) {
-        ssize_t n = write(sv[1], data_to_send, data_len);
-        ASSERT_EQ((size_t)n, data_len);
-
-        uvhttp_error_t ret = uvhttp_ws_recv_frame(conn, frame);
-        ASSERT_EQ(ret, UVHTTP_OK);
-    }
-};
-
-/*
- * Test basic recv_frame with an unmasked text frame.
- * Targets the core recv path (non-SSL): lines 593, 596, 601-602, 634-635,
- * 644, 646-647, 650, 653-656, 666-667, 669.
- */
-TEST_F(WsRecvFrameTest, RecvFrameTextUnmasked) {
-    uint8_t frame_data[64];
-    int frame_len = build_raw_frame(frame_data, sizeof(frame_data),
-                                    (const uint8_t*)"Hello", 5,
-                                    UVHTTP_WS_OPCODE_TEXT, 1);
-    ASSERT_GT(frame_len, 0);
-
-    uvhttp_ws_frame_t frame;
-    memset(&frame, 0, sizeof(frame));
-
-    send_and_recv(frame_data, frame_len, &frame);
-
-    EXPECT_EQ(frame.header.fin, 1);
-    EXPECT_EQ(frame.header.opcode, UVHTTP_WS_OPCODE_TEXT);
-    EXPECT_EQ(frame.header.payload_len, 5u);
-    EXPECT_EQ(frame.payload_size, 5u);
-    ASSERT_NE(frame.payload, nullptr);
-    EXPECT_EQ(memcmp(frame.payload, "Hello", 5), 0);
-    EXPECT_EQ(conn->bytes_received, 5u);
-    EXPECT_EQ(conn->frames_received, 1u);
-
-    uvhttp_free(frame.payload);
-}
-
-/*
- * Test recv_frame with a masked text frame.
- * Targets the mask reading path (lines 621-628) and mask application
- * path (lines 660-662) in recv_frame.
- */
-TEST_F(WsRecvFrameTest, RecvFrameTextMasked) {
-    uint8_t masking_key[4] = {0x12, 0x34, 0x56, 0x78};
-    uint8_t frame_data[64];
-    int frame_len = build_masked_frame(frame_data, sizeof(frame_data),
-                                        (const uint8_t*)"Hello", 5,
-                                        UVHTTP_WS_OPCODE_TEXT, 1,
-                                        masking_key);
-    ASSERT_GT(frame_len, 0);
-
-    uvhttp_ws_frame_t frame;
-    memset(&frame, 0, sizeof(frame));
-
-    send_and_recv(frame_data, frame_len, &frame);
-
-    EXPECT_EQ(frame.header.fin, 1);
-    EXPECT_EQ(frame.header.opcode, UVHTTP_WS_OPCODE_TEXT);
-    EXPECT_EQ(frame.header.mask, 1);
-    EXPECT_EQ(frame.header.payload_len, 5u);
-    ASSERT_NE(frame.payload, nullptr);
-    /* Payload should be unmasked by recv_frame */
-    EXPECT_EQ(memcmp(frame.payload, "Hello", 5), 0);
-
-    uvhttp_free(frame.payload);
-}
-
-/*
- * Test recv_frame with binary payload.
- */
-TEST_F(WsRecvFrameTest, RecvFrameBinaryPayload) {
-    uint8_t payload[100];
-    memset(payload, 'A', sizeof(payload));
-
-    uint8_t frame_data[256];
-    int frame_len = build_raw_frame(frame_data, sizeof(frame_data),
-                                    payload, sizeof(payload),
-                                    UVHTTP_WS_OPCODE_BINARY, 1);
-    ASSERT_GT(frame_len, 0);
-
-    uvhttp_ws_frame_t frame;
-    memset(&frame, 0, sizeof(frame));
-
-    send_and_recv(frame_data, frame_len, &frame);
-
-    EXPECT_EQ(frame.header.fin, 1);
-    EXPECT_EQ(frame.header.opcode, UVHTTP_WS_OPCODE_BINARY);
-    EXPECT_EQ(frame.header.payload_len, 100u);
-    ASSERT_NE(frame.payload, nullptr);
-    EXPECT_EQ(memcmp(frame.payload, payload, 100), 0);
-
-    uvhttp_free(frame.payload);
-}
-
-/*
- * Test recv_frame with a close frame (with status code and reason).
- */
-TEST_F(WsRecvFrameTest, RecvFrameCloseWithReason) {
-    uint8_t close_payload[8];
-    close_payload[0] = (1000 >> 8) & 0xFF;
-    close_payload[1] = 1000 & 0xFF;
-    memcpy(close_payload + 2, "Normal", 6);
-
-    uint8_t frame_data[64];
-    int frame_len = build_raw_frame(frame_data, sizeof(frame_data),
-                                    close_payload, 8,
-                                    UVHTTP_WS_OPCODE_CLOSE, 1);
-    ASSERT_GT(frame_len, 0);
-
-    uvhttp_ws_frame_t frame;
-    memset(&frame, 0, sizeof(frame));
-
-    send_and_recv(frame_data, frame_len, &frame);
-
-    EXPECT_EQ(frame.header.opcode, UVHTTP_WS_OPCODE_CLOSE);
-    EXPECT_EQ(frame.header.payload_len, 8u);
-
-    uvhttp_free(frame.payload);
-}
-
-/*
- * Test recv_frame with a close frame (status code only, no reason).
- */
-TEST_F(WsRecvFrameTest, RecvFrameCloseCodeOnly) {
-    uint8_t close_payload[2];
-    close_payload[0] = (1001 >> 8) & 0xFF;
-    close_payload[1] = 1001 & 0xFF;
-
-    uint8_t frame_data[64];
-    int frame_len = build_raw_frame(frame_data, sizeof(frame_data),
-                                    close_payload, 2,
-                                    UVHTTP_WS_OPCODE_CLOSE, 1);
-    ASSERT_GT(frame_len, 0);
-
-    uvhttp_ws_frame_t frame;
-    memset(&frame, 0, sizeof(frame));
-
-    send_and_recv(frame_data, frame_len, &frame);
-
-    EXPECT_EQ(frame.header.opcode, UVHTTP_WS_OPCODE_CLOSE);
-    EXPECT_EQ(frame.header.payload_len, 2u);
-
-    uvhttp_free(frame.payload);
-}
-
-/*
- * Test recv_frame with a ping frame.
- */
-TEST_F(WsRecvFrameTest, RecvFramePing) {
-    uint8_t ping_data[] = {0x01, 0x02, 0x03};
-    uint8_t frame_data[64];
-    int frame_len = build_raw_frame(frame_data, sizeof(frame_data),
-                                    ping_data, sizeof(ping_data),
-                                    UVHTTP_WS_OPCODE_PING, 1);
-    ASSERT_GT(frame_len, 0);
-
-    uvhttp_ws_frame_t frame;
-    memset(&frame, 0, sizeof(frame));
-
-    send_and_recv(frame_data, frame_len, &frame);
-
-    EXPECT_EQ(frame.header.opcode, UVHTTP_WS_OPCODE_PING);
-    EXPECT_EQ(frame.header.payload_len, 3u);
-    ASSERT_NE(frame.payload, nullptr);
-
-    uvhttp_free(frame.payload);
-}
-
-/*
- * Test recv_frame with a pong frame.
- */
-TEST_F(WsRecvFrameTest, RecvFramePong) {
-    uint8_t pong_data[] = {0xAA, 0xBB};
-    uint8_t frame_data[64];
-    int frame_len = build_raw_frame(frame_data, sizeof(frame_data),
-                                    pong_data, sizeof(pong_data),
-                                    UVHTTP_WS_OPCODE_PONG, 1);
-    ASSERT_GT(frame_len, 0);
-
-    uvhttp_ws_frame_t frame;
-    memset(&frame, 0, sizeof(frame));
-
-    send_and_recv(frame_data, frame_len, &frame);
-
-    EXPECT_EQ(frame.header.opcode, UVHTTP_WS_OPCODE_PONG);
-    EXPECT_EQ(frame.header.payload_len, 2u);
-    ASSERT_NE(frame.payload, nullptr);
-
-    uvhttp_free(frame.payload);
-}
-
-/*
- * Test recv_frame with a fragmented (FIN=0) frame.
- */
-TEST_F(WsRecvFrameTest, RecvFrameFragmented) {
-    uint8_t frame_data[64];
-    int frame_len = build_raw_frame(frame_data, sizeof(frame_data),
-                                    (const uint8_t*)"frag", 4,
-                                    UVHTTP_WS_OPCODE_TEXT, 0);
-    ASSERT_GT(frame_len, 0);
-
-    uvhttp_ws_frame_t frame;
-    memset(&frame, 0, sizeof(frame));
-
-    send_and_recv(frame_data, frame_len, &frame);
-
-    EXPECT_EQ(frame.header.fin, 0);
-    EXPECT_EQ(frame.header.opcode, UVHTTP_WS_OPCODE_TEXT);
-    EXPECT_EQ(frame.header.payload_len, 4u);
-
-    uvhttp_free(frame.payload);
-}
-
-/*
- * Test recv_frame with zero-length payload.
- */
-TEST_F(WsRecvFrameTest, RecvFrameZeroLengthPayload) {
-    uint8_t frame_data[] = {0x81, 0x00}; /* FIN=1, TEXT, len=0 */
-
-    uvhttp_ws_frame_t frame;
-    memset(&frame, 0, sizeof(frame));
-
-    send_and_recv(frame_data, sizeof(frame_data), &frame);
-
-    EXPECT_EQ(frame.header.fin, 1);
-    EXPECT_EQ(frame.header.opcode, UVHTTP_WS_OPCODE_TEXT);
-    EXPECT_EQ(frame.header.payload_len, 0u);
-    EXPECT_EQ(frame.payload, nullptr);
-    EXPECT_EQ(frame.payload_size, 0u);
-}
-
-/*
- * Test recv_frame with masking and a small payload.
- */
-TEST_F(WsRecvFrameTest, RecvFrameMaskedBinary) {
-    uint8_t masking_key[4] = {0xDE, 0xAD, 0xBE, 0xEF};
-    uint8_t payload[50];
-    memset(payload, 'C', sizeof(payload));
-
-    uint8_t frame_data[256];
-    int frame_len = build_masked_frame(frame_data, sizeof(frame_data),
-                                        payload, sizeof(payload),
-                                        UVHTTP_WS_OPCODE_TEXT, 1,
-                                        masking_key);
-    ASSERT_GT(frame_len, 0);
-
-    uvhttp_ws_frame_t frame;
-    memset(&frame, 0, sizeof(frame));
-
-    send_and_recv(frame_data, frame_len, &frame);
-
-    EXPECT_EQ(frame.header.fin, 1);
-    EXPECT_EQ(frame.header.opcode, UVHTTP_WS_OPCODE_TEXT);
-    EXPECT_EQ(frame.header.mask, 1);
-    EXPECT_EQ(frame.header.payload_len, 50u);
-    ASSERT_NE(frame.payload, nullptr);
-    EXPECT_EQ(memcmp(frame.payload, payload, 50), 0);
-
-    uvhttp_free(frame.payload);
-}
-
 /* ========== uvhttp_ws_process_data: close frame with reason ========== */
 
 /*
@@ -1177,85 +890,6 @@ TEST_F(WsBoost2Test, ProcessData_CloseFrameWithReason_NoCallback) {
     uvhttp_ws_connection_free(conn);
 }
 
-/* ========== uvhttp_ws_recv_frame: max frame size exceeded ========== */
-
-/*
- * Test recv_frame with payload exceeding max_frame_size.
- * Targets line 635: the max_frame_size check in recv_frame.
- */
-TEST_F(WsRecvFrameTest, RecvFrame_ExceedsMaxFrameSize) {
-    /* Create connection with very small max frame size */
-    uvhttp_config_t config;
-    memset(&config, 0, sizeof(config));
-    config.websocket_max_frame_size = 4;
-
-    uvhttp_ws_connection_free(conn);
-    close(sv[0]);
-    close(sv[1]);
-
-    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
-    conn = uvhttp_ws_connection_create(sv[0], NULL, 1, &config);
-    ASSERT_NE(conn, nullptr);
-    conn->state = UVHTTP_WS_STATE_OPEN;
-
-    /* Send a frame with 5-byte payload (exceeds max_frame_size=4) */
-    uint8_t frame_data[64];
-    int frame_len = build_raw_frame(frame_data, sizeof(frame_data),
-                                    (const uint8_t*)"Hello", 5,
-                                    UVHTTP_WS_OPCODE_TEXT, 1);
-    ASSERT_GT(frame_len, 0);
-
-    ssize_t n = write(sv[1], frame_data, frame_len);
-    ASSERT_EQ((size_t)n, (size_t)frame_len);
-
-    uvhttp_ws_frame_t frame;
-    memset(&frame, 0, sizeof(frame));
-
-    uvhttp_error_t ret = uvhttp_ws_recv_frame(conn, &frame);
-    EXPECT_NE(ret, UVHTTP_OK);
-}
-
-/*
- * Test recv_frame with a closed socket (recv failure).
- * Closing sv[1] causes recv to return 0, hitting the ret <= 0 path.
- */
-TEST_F(WsRecvFrameTest, RecvFrame_ClosedSocket) {
-    /* Close the write end of the socketpair */
-    close(sv[1]);
-    sv[1] = -1;
-
-    uvhttp_ws_frame_t frame;
-    memset(&frame, 0, sizeof(frame));
-
-    uvhttp_error_t ret = uvhttp_ws_recv_frame(conn, &frame);
-    EXPECT_NE(ret, UVHTTP_OK);
-}
-
-/*
- * Test recv_frame with partial header (only 1 byte received).
- * We write only 1 byte, then recv_frame reads 2 bytes for the header
- * and gets stuck (recv blocks). Since we can't easily test this with
- * blocking sockets, we test the error by closing the socket after
- * writing partial data.
- * NOTE: This test is best-effort; behavior depends on OS buffering.
- */
-TEST_F(WsRecvFrameTest, RecvFrame_PartialHeader) {
-    /* Write only 1 byte of the 2-byte header */
-    uint8_t partial[] = {0x81};
-    ssize_t n = write(sv[1], partial, sizeof(partial));
-    ASSERT_EQ(n, 1);
-
-    /* Close the write end so recv won't block */
-    close(sv[1]);
-    sv[1] = -1;
-
-    uvhttp_ws_frame_t frame;
-    memset(&frame, 0, sizeof(frame));
-
-    uvhttp_error_t ret = uvhttp_ws_recv_frame(conn, &frame);
-    EXPECT_NE(ret, UVHTTP_OK);
-}
-
 #else
 
 /* WebSocket feature disabled: empty placeholder test */
@@ -0,0 +1,311 @@
+/**
+ * @file test_websocket_deflate.cpp
+ * @brief permessage-deflate (RFC 7692) tests
+ *
+ * Validates the compression extension in src/uvhttp_websocket.c:
+ * - offer negotiation: accepted parameters, declined window sizes
+ * - compressed messages round-trip between a server and a client connection,
+ *   with RSV1 set on the wire
+ * - messages below the threshold go out uncompressed
+ * - a shared frame is compressed once for every deflate recipient
+ * - a compressed message inflating past max_message_size is refused
+ * - RSV1 without a negotiated extension is a protocol error
+ * - fragmented compressed messages and the client side of the handshake
+ *
+ * Build configuration: UVHTTP_FEATURE_WEBSOCKET and UVHTTP_FEATURE_COMPRESSION
+ * must be enabled.
+ */
+
+#if UVHTTP_FEATURE_WEBSOCKET && UVHTTP_FEATURE_COMPRESSION
+
+#include <gtest/gtest.h>
+
+extern "C" {
+#include "uvhttp_allocator.h"
+#include "uvhttp_connection.h"
+#include "uvhttp_websocket.h"
+}
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+class WsDeflateTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_EQ(uv_loop_init(&loop), 0);
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+        fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+
+        transport = (uvhttp_connection_t*)uvhttp_calloc(
+            1, sizeof(uvhttp_connection_t));
+        ASSERT_NE(transport, nullptr);
+        ASSERT_EQ(uv_tcp_init(&loop, &transport->tcp_handle), 0);
+        ASSERT_EQ(uv_tcp_open(&transport->tcp_handle, fds[0]), 0);
+
+        server = uvhttp_ws_connection_create(fds[0], NULL, 1, NULL);
+        ASSERT_NE(server, nullptr);
+        server->state = UVHTTP_WS_STATE_OPEN;
+        server->transport = transport;
+
+        client = uvhttp_ws_connection_create(-1, NULL, 0, NULL);
+        ASSERT_NE(client, nullptr);
+        client->state = UVHTTP_WS_STATE_OPEN;
+        client->on_message = on_message;
+        client->user_data = this;
+
+        params.server_no_context_takeover = 1;
+        params.client_no_context_takeover = 1;
+        params.server_max_window_bits = 15;
+        params.client_max_window_bits = 15;
+    }
+
+    void TearDown() override {
+        uvhttp_ws_connection_free(server);
+        uvhttp_ws_connection_free(client);
+        uv_close((uv_handle_t*)&transport->tcp_handle, NULL);
+        uv_run(&loop, UV_RUN_DEFAULT);
+        uv_loop_close(&loop);
+        uvhttp_free(transport);
+        close(fds[1]);
+    }
+
+    void enable_both() {
+        ASSERT_EQ(uvhttp_ws_enable_deflate(server, &params), UVHTTP_OK);
+        ASSERT_EQ(uvhttp_ws_enable_deflate(client, &params), UVHTTP_OK);
+        server->config.compression_threshold = 16;
+        client->config.compression_threshold = 16;
+    }
+
+    /* everything the server connection wrote so far */
+    std::string read_peer() {
+        uv_run(&loop, UV_RUN_DEFAULT);
+        std::string out;
+        char buf[65536];
+        ssize_t n;
+        while ((n = read(fds[1], buf, sizeof(buf))) > 0) {
+            out.append(buf, (size_t)n);
+        }
+        return out;
+    }
+
+    static int on_message(uvhttp_ws_connection_t* conn, const char* data,
+                          size_t len, int opcode) {
+        WsDeflateTest* self = static_cast<WsDeflateTest*>(conn->user_data);
+        self->messages.push_back(std::string(data, len));
+        self->opcodes.push_back(opcode);
+        return 0;
+    }
+
+    uv_loop_t loop;
+    int fds[2];
+    uvhttp_connection_t* transport;
+    uvhttp_ws_connection_t* server;
+    uvhttp_ws_connection_t* client;
+    uvhttp_ws_deflate_params_t params;
+    std::vector<std::string> messages;
+    std::vector<int> opcodes;
+};
+
+TEST_F(WsDeflateTest, NegotiateAcceptsPlainOffer) {
+    uvhttp_ws_deflate_params_t p;
+    char response[128];
+    ASSERT_EQ(uvhttp_ws_deflate_negotiate("permessage-deflate", &p, response,
+                                          sizeof(response)),
+              UVHTTP_OK);
+    EXPECT_EQ(p.server_no_context_takeover, 1);
+    EXPECT_EQ(p.server_max_window_bits, 15);
+    EXPECT_NE(strstr(response, "permessage-deflate"), nullptr);
+    EXPECT_NE(strstr(response, "server_no_context_takeover"), nullptr);
+    EXPECT_EQ(strstr(response, "client_max_window_bits"), nullptr);
+}
+
+TEST_F(WsDeflateTest, NegotiateSkipsUnusableOffers) {
+    uvhttp_ws_deflate_params_t p;
+    char response[128];
+    /* a 2^10 server window is out of reach, the fallback offer is taken */
+    ASSERT_EQ(uvhttp_ws_deflate_negotiate(
+                  "permessage-deflate; server_max_window_bits=10, "
+                  "permessage-deflate; client_max_window_bits",
+                  &p, response, sizeof(response)),
+              UVHTTP_OK);
+    EXPECT_EQ(p.client_max_window_bits, 15);
+
+    EXPECT_EQ(uvhttp_ws_deflate_negotiate(
+                  "permessage-deflate; server_max_window_bits=9", &p,
+                  response, sizeof(response)),
+              UVHTTP_ERROR_NOT_FOUND);
+    EXPECT_EQ(uvhttp_ws_deflate_negotiate("x-webkit-deflate-frame", &p,
+                                          response, sizeof(response)),
+              UVHTTP_ERROR_NOT_FOUND);
+    EXPECT_EQ(uvhttp_ws_deflate_negotiate(
+                  "permessage-deflate; bogus_param", &p, response,
+                  sizeof(response)),
+              UVHTTP_ERROR_NOT_FOUND);
+    EXPECT_EQ(uvhttp_ws_deflate_negotiate(
+                  "permessage-deflate; client_no_context_takeover; "
+                  "client_no_context_takeover",
+                  &p, response, sizeof(response)),
+              UVHTTP_ERROR_NOT_FOUND);
+    EXPECT_EQ(uvhttp_ws_deflate_negotiate(NULL, &p, response,
+                                          sizeof(response)),
+              UVHTTP_ERROR_INVALID_PARAM);
+}
+
+TEST_F(WsDeflateTest, CompressedRoundTrip) {
+    enable_both();
+    std::string text;
+    for (int i = 0; i < 200; i++) {
+        text += "the quick brown fox ";
+    }
+    ASSERT_EQ(uvhttp_ws_send_text(NULL, server, text.data(), text.size()),
+              UVHTTP_OK);
+    EXPECT_EQ(server->messages_compressed, 1u);
+
+    std::string wire = read_peer();
+    ASSERT_GT(wire.size(), 2u);
+    EXPECT_EQ((uint8_t)wire[0], 0xC1); /* FIN | RSV1 | TEXT */
+    EXPECT_LT(wire.size(), text.size() / 4);
+
+    ASSERT_EQ(uvhttp_ws_process_data(client, (const uint8_t*)wire.data(),
+                                     wire.size()),
+              UVHTTP_OK);
+    ASSERT_EQ(messages.size(), 1u);
+    EXPECT_EQ(messages[0], text);
+    EXPECT_EQ(opcodes[0], UVHTTP_WS_OPCODE_TEXT);
+}
+
+TEST_F(WsDeflateTest, SmallMessagesStayRaw) {
+    enable_both();
+    ASSERT_EQ(uvhttp_ws_send_text(NULL, server, "short", 5), UVHTTP_OK);
+    EXPECT_EQ(server->messages_compressed, 0u);
+    EXPECT_EQ(read_peer(), std::string("\x81\x05short", 7));
+}
+
+TEST_F(WsDeflateTest, SharedFrameCompressedOnce) {
+    enable_both();
+    std::string text(4096, 'a');
+    uvhttp_ws_shared_frame_t* frame = NULL;
+    ASSERT_EQ(uvhttp_ws_shared_frame_create((const uint8_t*)text.data(),
+                                            text.size(),
+                                            UVHTTP_WS_OPCODE_TEXT, &frame),
+              UVHTTP_OK);
+
+    ASSERT_EQ(uvhttp_ws_send_shared(server, frame), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_ws_send_shared(server, frame), UVHTTP_OK);
+    EXPECT_EQ(server->messages_compressed, 2u);
+    uvhttp_ws_shared_frame_release(frame);
+
+    std::string wire = read_peer();
+    ASSERT_EQ(wire.size() % 2, 0u);
+    EXPECT_EQ(wire.substr(0, wire.size() / 2), wire.substr(wire.size() / 2));
+    ASSERT_EQ(uvhttp_ws_process_data(client, (const uint8_t*)wire.data(),
+                                     wire.size()),
+              UVHTTP_OK);
+    ASSERT_EQ(messages.size(), 2u);
+    EXPECT_EQ(messages[1], text);
+}
+
+TEST_F(WsDeflateTest, InflateBoundedByMaxMessageSize) {
+    enable_both();
+    std::string text(64 * 1024, 'z');
+    ASSERT_EQ(uvhttp_ws_send_binary(NULL, server, (const uint8_t*)text.data(),
+                                    text.size()),
+              UVHTTP_OK);
+    std::string wire = read_peer();
+    ASSERT_LT(wire.size(), 1024u);
+
+    client->config.max_message_size = 1024;
+    EXPECT_EQ(uvhttp_ws_process_data(client, (const uint8_t*)wire.data(),
+                                     wire.size()),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_TRUE(messages.empty());
+}
+
+TEST_F(WsDeflateTest, Rsv1WithoutExtensionRejected) {
+    const uint8_t frame[] = {0xC1, 0x01, 'x'};
+    EXPECT_EQ(uvhttp_ws_process_data(client, frame, sizeof(frame)),
+              UVHTTP_ERROR_INVALID_PARAM);
+
+    /* control frames never carry RSV1, even with the extension */
+    enable_both();
+    const uint8_t ping[] = {0xC9, 0x00};
+    EXPECT_EQ(uvhttp_ws_process_data(client, ping, sizeof(ping)),
+              UVHTTP_ERROR_INVALID_PARAM);
+}
+
+TEST_F(WsDeflateTest, FragmentedCompressedMessage) {
+    enable_both();
+    std::string text(2000, 'q');
+    ASSERT_EQ(uvhttp_ws_send_text(NULL, server, text.data(), text.size()),
+              UVHTTP_OK);
+    std::string wire = read_peer();
+    ASSERT_GT(wire.size(), 4u);
+    ASSERT_LT((uint8_t)wire[1], 126);
+
+    /* split the payload over a RSV1 TEXT frame and a CONTINUATION */
+    std::string payload = wire.substr(2);
+    size_t half = payload.size() / 2;
+    std::string split;
+    split += (char)0x41;
+    split += (char)half;
+    split += payload.substr(0, half);
+    split += (char)0x80;
+    split += (char)(payload.size() - half);
+    split += payload.substr(half);
+
+    ASSERT_EQ(uvhttp_ws_process_data(client, (const uint8_t*)split.data(),
+                                     split.size()),
+              UVHTTP_OK);
+    ASSERT_EQ(messages.size(), 1u);
+    EXPECT_EQ(messages[0], text);
+}
+
+TEST_F(WsDeflateTest, ClientAcceptsServerResponse) {
+    /* RFC 6455 §1.3 sample key and accept */
+    const std::string head =
+        "HTTP/1.1 101 Switching Protocols\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n";
+    strcpy(client->client_key, "dGhlIHNhbXBsZSBub25jZQ==");
+
+    /* an extension we never offered */
+    std::string response = head +
+                           "Sec-WebSocket-Extensions: permessage-deflate\r\n"
+                           "\r\n";
+    EXPECT_EQ(uvhttp_ws_verify_handshake_response(client, response.c_str(),
+                                                  response.size()),
+              UVHTTP_ERROR_INVALID_PARAM);
+
+    /* a client window limit we never offered */
+    client->config.enable_compression = 1;
+    response = head +
+               "Sec-WebSocket-Extensions: permessage-deflate; "
+               "client_max_window_bits=10\r\n\r\n";
+    EXPECT_EQ(uvhttp_ws_verify_handshake_response(client, response.c_str(),
+                                                  response.size()),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(client->deflate, nullptr);
+
+    response = head +
+               "Sec-WebSocket-Extensions: permessage-deflate; "
+               "server_no_context_takeover\r\n\r\n";
+    ASSERT_EQ(uvhttp_ws_verify_handshake_response(client, response.c_str(),
+                                                  response.size()),
+              UVHTTP_OK);
+    EXPECT_NE(client->deflate, nullptr);
+}
+
+TEST_F(WsDeflateTest, EnableDeflateInvalidParams) {
+    EXPECT_EQ(uvhttp_ws_enable_deflate(NULL, &params),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_ws_enable_deflate(server, NULL),
+              UVHTTP_ERROR_INVALID_PARAM);
+}
+
+#endif /* UVHTTP_FEATURE_WEBSOCKET && UVHTTP_FEATURE_COMPRESSION */
@@ -209,24 +209,6 @@ TEST(UvhttpWebSocketEnhancedCoverageTest, WebSocketVerifyHandshake) {
     }
 }
 
-/* 测试WebSocket接收帧 */
-TEST(UvhttpWebSocketEnhancedCoverageTest, WebSocketRecvFrame) {
-    /* 测试NULL连接 */
-    uvhttp_ws_frame_t frame;
-    memset(&frame, 0, sizeof(frame));
-    int result = uvhttp_ws_recv_frame(NULL, &frame);
-    EXPECT_NE(result, UVHTTP_OK);
-    
-    /* 测试NULL帧指针 */
-    uvhttp_ws_connection_t* conn = uvhttp_ws_connection_create(10, NULL, 0, NULL);
-    if (conn) {
-        result = uvhttp_ws_recv_frame(conn, NULL);
-        EXPECT_NE(result, UVHTTP_OK);
-        
-        uvhttp_ws_connection_free(conn);
-    }
-}
-
 /* 测试WebSocket发送文本 */
 TEST(UvhttpWebSocketEnhancedCoverageTest, WebSocketSendText) {
     uvhttp_context_t context;
@@ -20,8 +20,8 @@
 #include <uvhttp.h>
 
 #include <cstring>
-#include <sys/socket.h>
-#include <unistd.h>
+#include <string>
+#include <vector>
 
 TEST(WsFrameHeaderParse, SmallPayloadLength) {
     uint8_t f[8] = {0x81, 0x85, 0, 0, 0, 0, 'a', 'b'}; /* masked, 5 bytes */
@@ -219,73 +219,53 @@ TEST(WsFrameHeaderParse, ProcessDataRejectsLengthOverMaxFrameSize) {
     uvhttp_ws_connection_free(conn);
 }
 
-/* ========== regression: recv_frame with extended payload lengths ========= */
-/* recv_frame used to read only the first 2 header bytes before parsing, so
- * 126/127 frames failed with UVHTTP_ERROR_INVALID_PARAM before the extended
- * length was ever read. Exercise the full read path over a socketpair. */
-TEST(WsRecvFrame, Extended16BitLength) {
-    int sv[2];
-    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+/* ========== regression: extended payload lengths on the read path ======== */
+/* The blocking recv_frame used to read only the first 2 header bytes before
+ * parsing, so 126/127 frames failed before the extended length was ever
+ * read. The libuv read path must size such frames even when the extended
+ * length itself is split across reads. */
+static std::string g_received;
 
+static int capture_message(uvhttp_ws_connection_t* conn, const char* data,
+                           size_t len, int opcode) {
+    (void)conn;
+    (void)opcode;
+    g_received.assign(data, len);
+    return 0;
+}
+
+static void feed_split(size_t payload_size, size_t split) {
     uvhttp_ws_connection_t* conn =
-        uvhttp_ws_connection_create(sv[0], NULL, 0, NULL);
+        uvhttp_ws_connection_create(-1, NULL, 0, NULL);
     ASSERT_NE(conn, nullptr);
+    conn->on_message = capture_message;
+    g_received.clear();
 
-    uint8_t payload[200];
-    memset(payload, 'a', sizeof(payload));
-    uint8_t wire[256];
-    int wire_len = uvhttp_ws_build_frame(NULL, wire, sizeof(wire), payload,
-                                         sizeof(payload),
-                                         UVHTTP_WS_OPCODE_BINARY, 0, 1);
+    std::vector<uint8_t> payload(payload_size, 'a');
+    std::vector<uint8_t> wire(payload_size + 16);
+    long wire_len = uvhttp_ws_build_frame(NULL, wire.data(), wire.size(),
+                                          payload.data(), payload.size(),
+                                          UVHTTP_WS_OPCODE_BINARY, 0, 1);
     ASSERT_GT(wire_len, 0);
-    ASSERT_EQ((int)write(sv[1], wire, (size_t)wire_len), wire_len);
 
-    uvhttp_ws_frame_t frame;
-    memset(&frame, 0, sizeof(frame));
-    uvhttp_error_t r = uvhttp_ws_recv_frame(conn, &frame);
-    EXPECT_EQ(r, UVHTTP_OK);
-    EXPECT_EQ(frame.header.payload_length, (uint64_t)200);
-    EXPECT_EQ(frame.payload_size, (size_t)200);
-    if (frame.payload) {
-        EXPECT_EQ(memcmp(frame.payload, payload, sizeof(payload)), 0);
-        uvhttp_free(frame.payload);
-    }
+    EXPECT_EQ(uvhttp_ws_process_data_inplace(conn, wire.data(), split),
+              UVHTTP_OK);
+    EXPECT_TRUE(g_received.empty());
+    EXPECT_EQ(uvhttp_ws_process_data_inplace(conn, wire.data() + split,
+                                             (size_t)wire_len - split),
+              UVHTTP_OK);
+    EXPECT_EQ(g_received.size(), payload_size);
+    EXPECT_EQ(g_received, std::string(payload_size, 'a'));
 
     uvhttp_ws_connection_free(conn);
-    close(sv[0]);
-    close(sv[1]);
 }
 
-TEST(WsRecvFrame, Extended64BitLength) {
-    int sv[2];
-    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
-
-    uvhttp_ws_connection_t* conn =
-        uvhttp_ws_connection_create(sv[0], NULL, 0, NULL);
-    ASSERT_NE(conn, nullptr);
-
-    uint8_t payload[70000];
-    memset(payload, 'b', sizeof(payload));
-    uint8_t wire[70016];
-    int wire_len = uvhttp_ws_build_frame(NULL, wire, sizeof(wire), payload,
-                                         sizeof(payload),
-                                         UVHTTP_WS_OPCODE_BINARY, 0, 1);
-    ASSERT_GT(wire_len, 0);
-    ASSERT_EQ((int)write(sv[1], wire, (size_t)wire_len), wire_len);
-
-    uvhttp_ws_frame_t frame;
-    memset(&frame, 0, sizeof(frame));
-    uvhttp_error_t r = uvhttp_ws_recv_frame(conn, &frame);
-    EXPECT_EQ(r, UVHTTP_OK);
-    EXPECT_EQ(frame.header.payload_length, (uint64_t)70000);
-    if (frame.payload) {
-        EXPECT_EQ(memcmp(frame.payload, payload, sizeof(payload)), 0);
-        uvhttp_free(frame.payload);
-    }
+TEST(WsReadPath, Extended16BitLength) {
+    feed_split(200, 3);
+}
 
-    uvhttp_ws_connection_free(conn);
-    close(sv[0]);
-    close(sv[1]);
+TEST(WsReadPath, Extended64BitLength) {
+    feed_split(70000, 6);
 }
 
 /* build_frame must reject a payload length that would overflow total_size. */
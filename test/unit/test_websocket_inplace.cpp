@@ -0,0 +1,180 @@
+/**
+ * @file test_websocket_inplace.cpp
+ * @brief In-place WebSocket read path tests
+ *
+ * Validates uvhttp_ws_process_data_inplace:
+ * - single-frame messages are unmasked in and delivered from the read buffer
+ * - many frames per read, frames split at every offset, byte-by-byte input
+ * - only a split frame is staged in recv_buffer, and staging is cleared once
+ *   it completes
+ * - oversized and unmasked frames are rejected from the header alone
+ * - uvhttp_ws_process_data leaves const input untouched
+ *
+ * Build configuration: UVHTTP_FEATURE_WEBSOCKET must be enabled.
+ */
+
+#if UVHTTP_FEATURE_WEBSOCKET
+
+#include <gtest/gtest.h>
+
+extern "C" {
+#include "uvhttp_websocket.h"
+}
+
+#include <string>
+#include <vector>
+
+namespace {
+
+/* masked client-to-server frame */
+std::vector<uint8_t> masked_frame(uint8_t first, const std::string& payload) {
+    const uint8_t key[4] = {0xa1, 0x5c, 0x07, 0xe3};
+    std::vector<uint8_t> out;
+    out.push_back(first);
+    size_t len = payload.size();
+    if (len < 126) {
+        out.push_back((uint8_t)(0x80 | len));
+    } else if (len <= 0xffff) {
+        out.push_back(0x80 | 126);
+        out.push_back((uint8_t)(len >> 8));
+        out.push_back((uint8_t)len);
+    } else {
+        out.push_back(0x80 | 127);
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            out.push_back((uint8_t)((uint64_t)len >> shift));
+        }
+    }
+    out.insert(out.end(), key, key + 4);
+    for (size_t i = 0; i < len; i++) {
+        out.push_back((uint8_t)payload[i] ^ key[i % 4]);
+    }
+    return out;
+}
+
+}  // namespace
+
+class WsInplaceTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        conn = uvhttp_ws_connection_create(-1, NULL, 1, NULL);
+        ASSERT_NE(conn, nullptr);
+        conn->state = UVHTTP_WS_STATE_OPEN;
+        conn->on_message = on_message;
+        conn->user_data = this;
+    }
+    void TearDown() override { uvhttp_ws_connection_free(conn); }
+
+    static int on_message(uvhttp_ws_connection_t* c, const char* data,
+                          size_t len, int opcode) {
+        (void)opcode;
+        WsInplaceTest* self = static_cast<WsInplaceTest*>(c->user_data);
+        self->messages.push_back(std::string(data, len));
+        self->last_data = data;
+        return 0;
+    }
+
+    uvhttp_ws_connection_t* conn;
+    std::vector<std::string> messages;
+    const char* last_data = nullptr;
+};
+
+TEST_F(WsInplaceTest, DeliversSliceOfReadBuffer) {
+    std::vector<uint8_t> wire = masked_frame(0x81, "hello in place");
+    ASSERT_EQ(uvhttp_ws_process_data_inplace(conn, wire.data(), wire.size()),
+              UVHTTP_OK);
+    ASSERT_EQ(messages.size(), 1u);
+    EXPECT_EQ(messages[0], "hello in place");
+    /* payload follows the 2-byte header and 4-byte key, unmasked there */
+    EXPECT_EQ(last_data, (const char*)wire.data() + 6);
+    EXPECT_EQ(conn->recv_buffer_pos, 0u);
+}
+
+TEST_F(WsInplaceTest, ManyFramesPerRead) {
+    std::vector<uint8_t> wire;
+    for (int i = 0; i < 100; i++) {
+        std::vector<uint8_t> f = masked_frame(0x82, std::to_string(i));
+        wire.insert(wire.end(), f.begin(), f.end());
+    }
+    ASSERT_EQ(uvhttp_ws_process_data_inplace(conn, wire.data(), wire.size()),
+              UVHTTP_OK);
+    ASSERT_EQ(messages.size(), 100u);
+    EXPECT_EQ(messages[42], "42");
+    EXPECT_EQ(conn->recv_buffer_pos, 0u);
+}
+
+TEST_F(WsInplaceTest, FrameSplitAtEveryOffset) {
+    std::string payload(300, 'x'); /* 16-bit extended length */
+    std::vector<uint8_t> frame = masked_frame(0x81, payload);
+    std::vector<uint8_t> pong = masked_frame(0x8A, "");
+    for (size_t split = 1; split < frame.size(); split++) {
+        messages.clear();
+        std::vector<uint8_t> wire = frame;
+        wire.insert(wire.end(), pong.begin(), pong.end());
+
+        ASSERT_EQ(uvhttp_ws_process_data_inplace(conn, wire.data(), split),
+                  UVHTTP_OK);
+        EXPECT_TRUE(messages.empty());
+        EXPECT_EQ(conn->recv_buffer_pos, split) << split;
+        ASSERT_EQ(uvhttp_ws_process_data_inplace(conn, wire.data() + split,
+                                                 wire.size() - split),
+                  UVHTTP_OK);
+        ASSERT_EQ(messages.size(), 1u) << split;
+        EXPECT_EQ(messages[0], payload);
+        EXPECT_EQ(conn->recv_buffer_pos, 0u);
+    }
+}
+
+TEST_F(WsInplaceTest, ByteByByteWithFragments) {
+    std::vector<uint8_t> wire;
+    const std::vector<uint8_t> parts[] = {
+        masked_frame(0x01, "frag"), masked_frame(0x8A, "pong"),
+        masked_frame(0x80, std::string(70000, 'm')),
+        masked_frame(0x82, "tail")};
+    for (const auto& f : parts) {
+        wire.insert(wire.end(), f.begin(), f.end());
+    }
+    for (size_t i = 0; i < wire.size(); i++) {
+        ASSERT_EQ(uvhttp_ws_process_data_inplace(conn, &wire[i], 1),
+                  UVHTTP_OK)
+            << i;
+    }
+    ASSERT_EQ(messages.size(), 2u);
+    EXPECT_EQ(messages[0], "frag" + std::string(70000, 'm'));
+    EXPECT_EQ(messages[1], "tail");
+    EXPECT_EQ(conn->recv_buffer_pos, 0u);
+}
+
+TEST_F(WsInplaceTest, OversizedFrameRejectedFromHeader) {
+    conn->config.max_frame_size = 1024;
+    /* 16-bit length announcing 2000 bytes; only the header arrives */
+    uint8_t header[] = {0x82, 0x80 | 126, 0x07, 0xd0};
+    EXPECT_EQ(uvhttp_ws_process_data_inplace(conn, header, sizeof(header)),
+              UVHTTP_ERROR_INVALID_PARAM);
+}
+
+TEST_F(WsInplaceTest, UnmaskedClientFrameRejected) {
+    uint8_t frame[] = {0x81, 0x02, 'h', 'i'};
+    EXPECT_EQ(uvhttp_ws_process_data_inplace(conn, frame, sizeof(frame)),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_TRUE(messages.empty());
+}
+
+TEST_F(WsInplaceTest, ConstInputUntouched) {
+    std::vector<uint8_t> wire = masked_frame(0x81, "staged copy");
+    const std::vector<uint8_t> original = wire;
+    ASSERT_EQ(uvhttp_ws_process_data(conn, wire.data(), wire.size()),
+              UVHTTP_OK);
+    ASSERT_EQ(messages.size(), 1u);
+    EXPECT_EQ(messages[0], "staged copy");
+    EXPECT_EQ(wire, original);
+}
+
+TEST_F(WsInplaceTest, NullParameters) {
+    uint8_t byte = 0;
+    EXPECT_EQ(uvhttp_ws_process_data_inplace(NULL, &byte, 1),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_ws_process_data_inplace(conn, NULL, 1),
+              UVHTTP_ERROR_INVALID_PARAM);
+}
+
+#endif /* UVHTTP_FEATURE_WEBSOCKET */
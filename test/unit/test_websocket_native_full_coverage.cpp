@@ -696,24 +696,6 @@ TEST(UvhttpWebSocketNativeTest, Close) {
     uvhttp_ws_connection_free(conn);
 }
 
-/* 测试接收帧 NULL 连接 */
-TEST(UvhttpWebSocketNativeTest, RecvFrameNullConn) {
-    uvhttp_ws_frame_t frame;
-    int result = uvhttp_ws_recv_frame(NULL, &frame);
-    EXPECT_EQ(result, -1);
-}
-
-/* 测试接收帧 NULL 帧 */
-TEST(UvhttpWebSocketNativeTest, RecvFrameNullFrame) {
-    struct uvhttp_ws_connection* conn = uvhttp_ws_connection_create(0, NULL, 1, NULL);
-    ASSERT_NE(conn, nullptr);
-    
-    int result = uvhttp_ws_recv_frame(conn, NULL);
-    EXPECT_EQ(result, -1);
-    
-    uvhttp_ws_connection_free(conn);
-}
-
 /* 测试处理数据 NULL 连接 */
 TEST(UvhttpWebSocketNativeTest, ProcessDataNullConn) {
     uint8_t data[] = "test";
@@ -46,13 +46,6 @@ TEST(UvhttpWebsocketNullCoverageTest, WsVerifyHandshakeResponseNull) {
     EXPECT_NE(result, 0);
 }
 
-/* 测试WebSocket接收帧NULL */
-TEST(UvhttpWebsocketNullCoverageTest, WsRecvFrameNull) {
-    uvhttp_ws_frame_t frame;
-    int result = uvhttp_ws_recv_frame(NULL, &frame);
-    EXPECT_NE(result, 0);
-}
-
 /* 测试WebSocket发送帧NULL */
 TEST(UvhttpWebsocketNullCoverageTest, WsSendFrameNull) {
     uvhttp_context_t context;
@@ -0,0 +1,257 @@
+/**
+ * @file test_websocket_send_queue.cpp
+ * @brief Non-blocking WebSocket send path tests
+ *
+ * Validates the per-connection outbound queue in src/uvhttp_websocket.c:
+ * - frames sent through a transport go out via uv_write, in order
+ * - frames queued behind an in-flight write go out in writev batches
+ * - DROP policy refuses data frames past the budget, control frames pass
+ * - CLOSE policy moves the connection to CLOSING and raises on_error
+ * - drain callback fires once the backlog is written
+ * - freeing a connection with a write in flight is safe
+ * - shared (encode-once) frames are queued by reference and released after
+ *   the last write completes
+ *
+ * Build configuration: UVHTTP_FEATURE_WEBSOCKET must be enabled.
+ */
+
+#if UVHTTP_FEATURE_WEBSOCKET
+
+#include <gtest/gtest.h>
+
+extern "C" {
+#include "uvhttp_allocator.h"
+#include "uvhttp_connection.h"
+#include "uvhttp_websocket.h"
+}
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+class WsSendQueueTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_EQ(uv_loop_init(&loop), 0);
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+        fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+
+        transport = (uvhttp_connection_t*)uvhttp_calloc(
+            1, sizeof(uvhttp_connection_t));
+        ASSERT_NE(transport, nullptr);
+        ASSERT_EQ(uv_tcp_init(&loop, &transport->tcp_handle), 0);
+        ASSERT_EQ(uv_tcp_open(&transport->tcp_handle, fds[0]), 0);
+
+        ws = uvhttp_ws_connection_create(fds[0], NULL, 1, NULL);
+        ASSERT_NE(ws, nullptr);
+        ws->state = UVHTTP_WS_STATE_OPEN;
+        ws->transport = transport;
+        ws->user_data = this;
+        drains = 0;
+        errors = 0;
+        last_error = 0;
+    }
+
+    void TearDown() override {
+        uvhttp_ws_connection_free(ws);
+        uv_close((uv_handle_t*)&transport->tcp_handle, NULL);
+        uv_run(&loop, UV_RUN_DEFAULT);
+        uv_loop_close(&loop);
+        uvhttp_free(transport);
+        close(fds[1]);
+    }
+
+    std::string read_peer() {
+        std::string out;
+        char buf[4096];
+        ssize_t n;
+        while ((n = read(fds[1], buf, sizeof(buf))) > 0) {
+            out.append(buf, (size_t)n);
+        }
+        return out;
+    }
+
+    static void on_drain(uvhttp_ws_connection_t* conn) {
+        static_cast<WsSendQueueTest*>(conn->user_data)->drains++;
+    }
+
+    static int on_error(uvhttp_ws_connection_t* conn, int code,
+                        const char* msg) {
+        (void)msg;
+        WsSendQueueTest* self = static_cast<WsSendQueueTest*>(conn->user_data);
+        self->errors++;
+        self->last_error = code;
+        return 0;
+    }
+
+    uv_loop_t loop;
+    int fds[2];
+    uvhttp_connection_t* transport;
+    uvhttp_ws_connection_t* ws;
+    int drains;
+    int errors;
+    int last_error;
+};
+
+TEST_F(WsSendQueueTest, FramesGoOutInOrder) {
+    ASSERT_EQ(uvhttp_ws_send_text(NULL, ws, "one", 3), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_ws_send_text(NULL, ws, "two", 3), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_ws_send_text(NULL, ws, "three", 5), UVHTTP_OK);
+
+    /* the first frame is in flight, the rest wait for its completion */
+    EXPECT_NE(ws->send_req, nullptr);
+    EXPECT_NE(ws->send_head, nullptr);
+    EXPECT_EQ(uvhttp_ws_get_buffered_amount(ws), 5u + 5u + 7u);
+
+    uv_run(&loop, UV_RUN_DEFAULT);
+
+    EXPECT_EQ(ws->send_req, nullptr);
+    EXPECT_EQ(ws->send_head, nullptr);
+    EXPECT_EQ(uvhttp_ws_get_buffered_amount(ws), 0u);
+    EXPECT_EQ(ws->frames_sent, 3u);
+
+    const std::string expected = std::string("\x81\x03one", 5) +
+                                 std::string("\x81\x03two", 5) +
+                                 std::string("\x81\x05three", 7);
+    EXPECT_EQ(read_peer(), expected);
+}
+
+TEST_F(WsSendQueueTest, BacklogLargerThanOneWritev) {
+    /* More queued frames than one uv_write carries: the queue is drained in
+     * UVHTTP_WEBSOCKET_WRITEV_MAX batches without reordering. */
+    const int count = UVHTTP_WEBSOCKET_WRITEV_MAX * 2 + 3;
+    std::string expected;
+    for (int i = 0; i < count; i++) {
+        char c = (char)('a' + i % 26);
+        ASSERT_EQ(uvhttp_ws_send_text(NULL, ws, &c, 1), UVHTTP_OK);
+        expected += std::string("\x81\x01", 2) + c;
+    }
+    EXPECT_EQ(uvhttp_ws_get_buffered_amount(ws), (size_t)count * 3u);
+
+    uv_run(&loop, UV_RUN_DEFAULT);
+    EXPECT_EQ(uvhttp_ws_get_buffered_amount(ws), 0u);
+    EXPECT_EQ(read_peer(), expected);
+}
+
+TEST_F(WsSendQueueTest, DropPolicyRefusesDataFrames) {
+    ASSERT_EQ(uvhttp_ws_set_send_queue(ws, 100, UVHTTP_WS_SLOW_CONSUMER_DROP),
+              UVHTTP_OK);
+    uvhttp_ws_set_drain_callback(ws, on_drain);
+
+    std::string payload(60, 'x');
+    ASSERT_EQ(uvhttp_ws_send_text(NULL, ws, payload.data(), payload.size()),
+              UVHTTP_OK);
+    EXPECT_EQ(uvhttp_ws_send_text(NULL, ws, payload.data(), payload.size()),
+              UVHTTP_ERROR_WEBSOCKET_SLOW_CONSUMER);
+    EXPECT_EQ(ws->frames_dropped, 1u);
+    EXPECT_EQ(ws->state, UVHTTP_WS_STATE_OPEN);
+
+    /* control frames bypass the budget */
+    EXPECT_EQ(uvhttp_ws_send_ping(NULL, ws, NULL, 0), UVHTTP_OK);
+
+    uv_run(&loop, UV_RUN_DEFAULT);
+    EXPECT_EQ(drains, 1);
+    EXPECT_EQ(ws->frames_sent, 2u);
+
+    /* with the backlog gone the producer can resume */
+    EXPECT_EQ(uvhttp_ws_send_text(NULL, ws, payload.data(), payload.size()),
+              UVHTTP_OK);
+    uv_run(&loop, UV_RUN_DEFAULT);
+    EXPECT_EQ(drains, 2);
+}
+
+TEST_F(WsSendQueueTest, ClosePolicyClosesConnection) {
+    ASSERT_EQ(uvhttp_ws_set_send_queue(ws, 100, UVHTTP_WS_SLOW_CONSUMER_CLOSE),
+              UVHTTP_OK);
+    ws->on_error = on_error;
+
+    std::string payload(60, 'x');
+    ASSERT_EQ(uvhttp_ws_send_text(NULL, ws, payload.data(), payload.size()),
+              UVHTTP_OK);
+    EXPECT_EQ(uvhttp_ws_send_text(NULL, ws, payload.data(), payload.size()),
+              UVHTTP_ERROR_WEBSOCKET_SLOW_CONSUMER);
+    EXPECT_EQ(ws->state, UVHTTP_WS_STATE_CLOSING);
+    EXPECT_EQ(errors, 1);
+    EXPECT_EQ(last_error, UVHTTP_ERROR_WEBSOCKET_SLOW_CONSUMER);
+
+    /* further sends are rejected */
+    EXPECT_NE(uvhttp_ws_send_text(NULL, ws, "x", 1), UVHTTP_OK);
+}
+
+TEST_F(WsSendQueueTest, FreeWithWriteInFlight) {
+    ASSERT_EQ(uvhttp_ws_send_text(NULL, ws, "one", 3), UVHTTP_OK);
+    ASSERT_EQ(uvhttp_ws_send_text(NULL, ws, "two", 3), UVHTTP_OK);
+    ASSERT_NE(ws->send_req, nullptr);
+
+    uvhttp_ws_connection_free(ws);
+    ws = NULL;
+
+    /* the completion must not touch the freed connection */
+    uv_run(&loop, UV_RUN_DEFAULT);
+    EXPECT_EQ(read_peer().size(), 5u);
+}
+
+TEST_F(WsSendQueueTest, SharedFrameQueuedByReference) {
+    uvhttp_ws_shared_frame_t* frame = NULL;
+    ASSERT_EQ(uvhttp_ws_shared_frame_create((const uint8_t*)"tick", 4,
+                                            UVHTTP_WS_OPCODE_TEXT, &frame),
+              UVHTTP_OK);
+
+    /* a second recipient without a transport writes straight to its fd */
+    int direct_fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, direct_fds), 0);
+    uvhttp_ws_connection_t* direct =
+        uvhttp_ws_connection_create(direct_fds[0], NULL, 1, NULL);
+    ASSERT_NE(direct, nullptr);
+    direct->state = UVHTTP_WS_STATE_OPEN;
+
+    EXPECT_EQ(uvhttp_ws_send_shared(ws, frame), UVHTTP_OK);
+    EXPECT_EQ(uvhttp_ws_send_shared(ws, frame), UVHTTP_OK);
+    EXPECT_EQ(uvhttp_ws_send_shared(direct, frame), UVHTTP_OK);
+
+    /* the queued entries keep the frame alive past the caller's release */
+    uvhttp_ws_shared_frame_release(frame);
+    uv_run(&loop, UV_RUN_DEFAULT);
+
+    const std::string one = std::string("\x81\x04tick", 6);
+    EXPECT_EQ(read_peer(), one + one);
+    char buf[16];
+    EXPECT_EQ(read(direct_fds[1], buf, sizeof(buf)), 6);
+    EXPECT_EQ(std::string(buf, 6), one);
+    EXPECT_EQ(direct->frames_sent, 1u);
+
+    uvhttp_ws_connection_free(direct);
+    close(direct_fds[0]);
+    close(direct_fds[1]);
+}
+
+TEST_F(WsSendQueueTest, SharedFrameRejectsClientConnections) {
+    uvhttp_ws_shared_frame_t* frame = NULL;
+    ASSERT_EQ(uvhttp_ws_shared_frame_create(NULL, 0, UVHTTP_WS_OPCODE_PING,
+                                            &frame),
+              UVHTTP_OK);
+    ws->is_server = 0;
+    EXPECT_EQ(uvhttp_ws_send_shared(ws, frame), UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_ws_send_shared(NULL, frame), UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_ws_shared_frame_create(NULL, 3, UVHTTP_WS_OPCODE_TEXT,
+                                            &frame),
+              UVHTTP_ERROR_INVALID_PARAM);
+    uvhttp_ws_shared_frame_release(frame);
+    uvhttp_ws_shared_frame_release(NULL);
+}
+
+TEST_F(WsSendQueueTest, InvalidParams) {
+    EXPECT_EQ(uvhttp_ws_set_send_queue(NULL, 0, UVHTTP_WS_SLOW_CONSUMER_DROP),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_ws_set_send_queue(ws, 0,
+                                       (uvhttp_ws_slow_consumer_policy_t)7),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_ws_flush(NULL), UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_ws_get_buffered_amount(NULL), 0u);
+    uvhttp_ws_set_drain_callback(NULL, on_drain);
+}
+
+#endif /* UVHTTP_FEATURE_WEBSOCKET */
@@ -0,0 +1,243 @@
+/**
+ * @file test_websocket_simd.cpp
+ * @brief WebSocket unmasking and UTF-8 validation tests
+ *
+ * Validates src/uvhttp_websocket_simd.c at every codec level the CPU
+ * supports:
+ * - masking matches the byte-wise reference for all lengths and offsets
+ * - UTF-8 acceptance/rejection of RFC 3629 edge cases
+ * - random input agrees with the scalar automaton, whole and in chunks
+ * - process_data closes on invalid text, single-frame and fragmented, and
+ *   accepts characters split across fragments
+ *
+ * Build configuration: UVHTTP_FEATURE_WEBSOCKET must be enabled.
+ */
+
+#if UVHTTP_FEATURE_WEBSOCKET
+
+#include <gtest/gtest.h>
+
+extern "C" {
+#include "uvhttp_websocket.h"
+}
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+const uvhttp_ws_simd_level_t kLevels[] = {
+    UVHTTP_WS_SIMD_SCALAR, UVHTTP_WS_SIMD_WORD, UVHTTP_WS_SIMD_SSE2,
+    UVHTTP_WS_SIMD_AVX2};
+
+bool utf8_ok(const std::string& s) {
+    uvhttp_ws_utf8_state_t st;
+    uvhttp_ws_utf8_init(&st);
+    return uvhttp_ws_utf8_validate(&st, (const uint8_t*)s.data(), s.size()) &&
+           uvhttp_ws_utf8_complete(&st);
+}
+
+bool utf8_ok_chunked(const std::string& s, size_t chunk) {
+    uvhttp_ws_utf8_state_t st;
+    uvhttp_ws_utf8_init(&st);
+    for (size_t i = 0; i < s.size(); i += chunk) {
+        size_t n = std::min(chunk, s.size() - i);
+        if (!uvhttp_ws_utf8_validate(&st, (const uint8_t*)s.data() + i, n)) {
+            return false;
+        }
+    }
+    return uvhttp_ws_utf8_complete(&st);
+}
+
+}  // namespace
+
+class WsSimdTest : public ::testing::TestWithParam<uvhttp_ws_simd_level_t> {
+protected:
+    void SetUp() override {
+        saved = uvhttp_ws_get_simd_level();
+        if (uvhttp_ws_set_simd_level(GetParam()) != UVHTTP_OK) {
+            GTEST_SKIP() << "level not supported on this CPU";
+        }
+    }
+    void TearDown() override { uvhttp_ws_set_simd_level(saved); }
+
+    uvhttp_ws_simd_level_t saved;
+};
+
+TEST_P(WsSimdTest, MaskMatchesReference) {
+    const uint8_t key[4] = {0x37, 0xfa, 0x21, 0x3d};
+    std::vector<uint8_t> buf(300), ref(300);
+    for (size_t offset = 0; offset < 8; offset++) {
+        for (size_t len = 0; len + offset <= buf.size(); len += 7) {
+            for (size_t i = 0; i < buf.size(); i++) {
+                buf[i] = ref[i] = (uint8_t)(i * 31 + len);
+            }
+            for (size_t i = 0; i < len; i++) {
+                ref[offset + i] ^= key[i % 4];
+            }
+            uvhttp_ws_apply_mask(buf.data() + offset, len, key);
+            ASSERT_EQ(buf, ref) << "offset " << offset << " len " << len;
+        }
+    }
+}
+
+TEST_P(WsSimdTest, Utf8EdgeCases) {
+    const std::string valid[] = {
+        "",
+        "plain ascii",
+        "\xc2\x80",                /* U+0080 */
+        "\xdf\xbf",                /* U+07FF */
+        "\xe0\xa0\x80",            /* U+0800 */
+        "\xed\x9f\xbf",            /* U+D7FF */
+        "\xee\x80\x80",            /* U+E000 */
+        "\xef\xbf\xbf",            /* U+FFFF */
+        "\xf0\x90\x80\x80",        /* U+10000 */
+        "\xf4\x8f\xbf\xbf",        /* U+10FFFF */
+        "\xce\xba\xe1\xbd\xb9\xcf\x83\xce\xbc\xce\xb5", /* kosme */
+    };
+    const std::string invalid[] = {
+        "\x80",             /* lone continuation */
+        "\xc0\x80",         /* overlong NUL */
+        "\xc1\xbf",         /* overlong */
+        "\xe0\x9f\xbf",     /* overlong 3-byte */
+        "\xed\xa0\x80",     /* surrogate U+D800 */
+        "\xf0\x8f\xbf\xbf", /* overlong 4-byte */
+        "\xf4\x90\x80\x80", /* past U+10FFFF */
+        "\xf5\x80\x80\x80",
+        "\xff",
+        "\xc2",             /* truncated */
+        "\xe1\x80",
+        "\xc2\x41",         /* lead followed by ASCII */
+    };
+    for (const auto& s : valid) {
+        EXPECT_TRUE(utf8_ok(s)) << s;
+        /* padded past the SIMD block size, at every alignment */
+        for (size_t pad = 0; pad < 40; pad++) {
+            EXPECT_TRUE(utf8_ok(std::string(pad, 'a') + s + std::string(40, 'b')))
+                << pad;
+        }
+    }
+    for (const auto& s : invalid) {
+        EXPECT_FALSE(utf8_ok(s)) << s;
+        for (size_t pad = 0; pad < 40; pad++) {
+            EXPECT_FALSE(
+                utf8_ok(std::string(pad, 'a') + s + std::string(40, 'b')))
+                << pad;
+        }
+    }
+}
+
+TEST_P(WsSimdTest, Utf8AgreesWithReference) {
+    /* mostly valid text with sparse corruption, so both outcomes occur */
+    const char* pieces[] = {"a", "bc", "\xc3\xa9", "\xe2\x82\xac",
+                            "\xf0\x9f\x98\x80", " ", "{\"k\":1}"};
+    std::mt19937 rng(12345);
+    int rejected = 0;
+    for (int round = 0; round < 400; round++) {
+        std::string s;
+        size_t target = rng() % 300;
+        while (s.size() < target) {
+            s += pieces[rng() % 7];
+        }
+        if (round % 3 == 0 && !s.empty()) {
+            s[rng() % s.size()] = (char)(rng() & 0xff);
+        }
+
+        uvhttp_ws_simd_level_t level = GetParam();
+        ASSERT_EQ(uvhttp_ws_set_simd_level(UVHTTP_WS_SIMD_SCALAR), UVHTTP_OK);
+        bool expected = utf8_ok(s);
+        ASSERT_EQ(uvhttp_ws_set_simd_level(level), UVHTTP_OK);
+
+        rejected += !expected;
+        ASSERT_EQ(utf8_ok(s), expected) << round;
+        for (size_t chunk : {1, 3, 17, 33, 64}) {
+            ASSERT_EQ(utf8_ok_chunked(s, chunk), expected)
+                << round << " chunk " << chunk;
+        }
+    }
+    EXPECT_GT(rejected, 0);
+}
+
+INSTANTIATE_TEST_SUITE_P(Levels, WsSimdTest, ::testing::ValuesIn(kLevels));
+
+class WsTextValidationTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        conn = uvhttp_ws_connection_create(-1, NULL, 0, NULL);
+        ASSERT_NE(conn, nullptr);
+        conn->state = UVHTTP_WS_STATE_OPEN;
+        conn->on_message = on_message;
+        conn->user_data = this;
+    }
+    void TearDown() override { uvhttp_ws_connection_free(conn); }
+
+    /* unmasked server-to-client frame */
+    static std::string frame(uint8_t first, const std::string& payload) {
+        return std::string(1, (char)first) +
+               std::string(1, (char)payload.size()) + payload;
+    }
+
+    uvhttp_error_t feed(const std::string& bytes) {
+        return uvhttp_ws_process_data(conn, (const uint8_t*)bytes.data(),
+                                      bytes.size());
+    }
+
+    static int on_message(uvhttp_ws_connection_t* c, const char* data,
+                          size_t len, int opcode) {
+        (void)opcode;
+        static_cast<WsTextValidationTest*>(c->user_data)
+            ->messages.push_back(std::string(data, len));
+        return 0;
+    }
+
+    uvhttp_ws_connection_t* conn;
+    std::vector<std::string> messages;
+};
+
+TEST_F(WsTextValidationTest, InvalidSingleFrameRejected) {
+    EXPECT_EQ(feed(frame(0x81, "ok \xed\xa0\x80")),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_TRUE(messages.empty());
+}
+
+TEST_F(WsTextValidationTest, BinaryIsNotValidated) {
+    EXPECT_EQ(feed(frame(0x82, "\xff\xfe")), UVHTTP_OK);
+    EXPECT_EQ(messages.size(), 1u);
+}
+
+TEST_F(WsTextValidationTest, CharacterSplitAcrossFragments) {
+    /* U+20AC split 1 + 2 bytes over TEXT and CONTINUATION */
+    EXPECT_EQ(feed(frame(0x01, "price \xe2")), UVHTTP_OK);
+    EXPECT_EQ(feed(frame(0x80, "\x82\xac")), UVHTTP_OK);
+    ASSERT_EQ(messages.size(), 1u);
+    EXPECT_EQ(messages[0], "price \xe2\x82\xac");
+}
+
+TEST_F(WsTextValidationTest, BadFragmentRejectedEarly) {
+    EXPECT_EQ(feed(frame(0x01, "\xc0\xaf")), UVHTTP_ERROR_INVALID_PARAM);
+}
+
+TEST_F(WsTextValidationTest, TruncatedFinalFragmentRejected) {
+    EXPECT_EQ(feed(frame(0x01, "abc")), UVHTTP_OK);
+    EXPECT_EQ(feed(frame(0x80, "\xf0\x9f\x98")), UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_TRUE(messages.empty());
+}
+
+TEST(WsSimdLevelTest, DetectionAndOverride) {
+    uvhttp_ws_simd_level_t level = uvhttp_ws_get_simd_level();
+    EXPECT_GE((int)level, (int)UVHTTP_WS_SIMD_WORD);
+    EXPECT_EQ(uvhttp_ws_set_simd_level((uvhttp_ws_simd_level_t)99),
+              UVHTTP_ERROR_INVALID_PARAM);
+    EXPECT_EQ(uvhttp_ws_set_simd_level(UVHTTP_WS_SIMD_SCALAR), UVHTTP_OK);
+    EXPECT_EQ(uvhttp_ws_get_simd_level(), UVHTTP_WS_SIMD_SCALAR);
+    EXPECT_EQ(uvhttp_ws_set_simd_level(level), UVHTTP_OK);
+
+    uvhttp_ws_utf8_state_t st;
+    uvhttp_ws_utf8_init(&st);
+    EXPECT_EQ(uvhttp_ws_utf8_validate(NULL, NULL, 0), 0);
+    EXPECT_EQ(uvhttp_ws_utf8_validate(&st, NULL, 3), 0);
+    EXPECT_EQ(uvhttp_ws_utf8_complete(NULL), 0);
+}
+
+#endif /* UVHTTP_FEATURE_WEBSOCKET */